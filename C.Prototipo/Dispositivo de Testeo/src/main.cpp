@@ -1,10 +1,20 @@
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WiFiClientSecure.h>
-#include <PubSubClient.h>         
+#include <mqtt_client.h>
 #include <ArduinoJson.h>
+#include <Preferences.h>
 #include <time.h>
 
+#include <RastreoHeap.h>
+#include <EsperaReintentos.h>
+#include <ParametrosRemotos.h>
+#include <ColaSPSC.h>
+#include <SimuladorGPS.h>
+#if LOGIOT_REPRODUCCION
+#include <LittleFS.h>
+#include <EscenarioGPS.h>
+#endif
+
 // Declarar serialEvent para evitar errores de compilación
 void serialEvent() {}
 
@@ -24,6 +34,18 @@ const char* DEVICE_ID = "ESP32-TEST_01";
 const char* AWS_TOPIC_UBICACION = "logistica/ubicacion/ESP32-TEST_01";  // Tracking en tiempo real
 const char* AWS_TOPIC_PEDIDOS = "logistica/pedidos";                   // Mapeo (inicio, punto, fin)
 const char* AWS_TOPIC_INFO = "logistica/info/ESP32-TEST_01";           // Diagnóstico
+const char* AWS_TOPIC_CONTROL = "logistica/control/ESP32-TEST_01";     // Comandos a este equipo
+const char* AWS_TOPIC_CONTROL_FLOTA = "logistica/control/flota";       // Comandos a todos los equipos
+const char* AWS_TOPIC_CONTROL_RESPUESTA = "logistica/control/ESP32-TEST_01/respuesta";
+
+// ====== Memoria ======
+// Con -DLOGIOT_SIN_HEAP=1 los documentos JSON salen de un bloque estático y
+// con los --wrap del enlazador (ver lib/RastreoHeap) se cuentan las
+// asignaciones del heap durante cada muestra, acumuladas desde el arranque
+// (incluye las de la red y de WiFi que corran mientras tanto en el otro
+// núcleo)
+const size_t TAMANO_POOL_JSON = 1536;  // un pool de 128 slots de ArduinoJson 7 más los strings
+const size_t TAMANO_MENSAJE_MQTT = 384;
 
 // ====== CERTIFICADOS AWS IoT ======
 const char AWS_CERT_CA[] PROGMEM = R"EOF(
@@ -121,16 +143,66 @@ struct PuntoGPS {
 };
 
 // ====== Variables de Simulación GPS ======
+// Las usa solo la tarea de muestreo; el resto lee estadoMuestreo
 PuntoGPS gpsSimulado;
 bool mapeando = false;
 int contadorCalles = 0;
-String idCalleActual = "";
+char idCalleActual[16] = "";
 
-// Coordenadas base para simulación (Córdoba, Argentina)
+// Coordenadas base para simulación (Córdoba, Argentina); el modelo está en
+// lib/SimuladorGPS, compartido con herramientas/carga_flota
 double latBase = -31.4201;
 double lonBase = -64.1888;
-double rumboActual = 0.0;
-double velocidadSimulada = 0.0;
+SimuladorGPS simulador(latBase, lonBase);
+
+// ====== Reproducción de escenarios ======
+// Con -DLOGIOT_REPRODUCCION=1 la tecla 'p' reproduce /escenario.txt de
+// LittleFS (lib/EscenarioGPS: guion, NMEA o GPX; se sube con
+// "pio run -t uploadfs" desde data/) en vez de la espiral, con mapeo
+// activo. El escenario corre con un reloj virtual de un segundo por
+// muestra: "acelerar N" acorta el período real de muestreo y los
+// intervalos y los timestamps de los mensajes siguen al reloj virtual, así
+// una hora de recorrido se reproduce igual en un minuto. Los cortes del
+// GPS frenan la ubicación y el mapeo; los del broker los cumple la tarea
+// de red. Al terminar vuelve a la espiral sin que el reloj retroceda.
+// Solo la tarea de muestreo toca el escenario.
+uint32_t adelantoRelojMs = 0;  // reloj virtual - millis()
+bool gpsConFix = true;
+#if LOGIOT_REPRODUCCION
+const char* RUTA_ESCENARIO = "/escenario.txt";
+const uint16_t ACELERACION_MAXIMA = 100;  // 10 ms por muestra
+
+// Las líneas se leen del archivo a medida que hacen falta
+class FuenteEscenarioArchivo : public FuenteEscenario {
+ public:
+  bool abrir(const char* ruta) {
+    archivo = LittleFS.open(ruta, "r");
+    return (bool)archivo;
+  }
+  void cerrar() { archivo.close(); }
+  bool leerLinea(char* destino, size_t tamano) override {
+    if (!archivo || !archivo.available()) {
+      return false;
+    }
+    size_t n = 0;
+    int c;
+    while ((c = archivo.read()) >= 0 && c != '\n') {
+      if (c != '\r' && n + 1 < tamano) destino[n++] = (char)c;
+    }
+    destino[n] = '\0';
+    return true;
+  }
+
+ private:
+  File archivo;
+};
+FuenteEscenarioArchivo fuenteEscenario;
+EscenarioGPS escenario(fuenteEscenario);
+bool reproduciendo = false;
+uint32_t muestrasEscenario = 0;
+#endif
+// La lee la tarea de red
+volatile bool brokerCaidoEscenario = false;
 
 // ====== Variables de Tiempos ======
 unsigned long ultimoPuntoMapeoEnviado = 0;
@@ -140,31 +212,185 @@ const unsigned long INTERVALO_ENVIO_UBICACION = 10000;
 const unsigned long INTERVALO_ENVIO_DIAGNOSTICO = 10000;
 const unsigned long INTERVALO_SIMULACION_GPS = 1000;
 
-unsigned long ultimoIntentoMQTT = 0;
-const unsigned long INTERVALO_RECONEXION_MQTT = 5000;
-int intentosFallidosMQTT = 0;
-const int MAX_INTENTOS_MQTT = 5;
+// Reconexión a AWS IoT: de 1 s a 5 min entre intentos, sin tope de intentos
+const ConfigReintentos CONFIG_REINTENTOS_MQTT = {1000, 300000};
+EsperaReintentos esperaMQTT(CONFIG_REINTENTOS_MQTT);
+unsigned long proximoIntentoMQTT = 0;
 
-// ====== AWS IoT MQTT Client ======
-WiFiClientSecure wifiClientSecure;
-PubSubClient awsClient(wifiClientSecure);
+// ====== AWS IoT MQTT Client (esp-mqtt de ESP-IDF) ======
+// El cliente corre en su propia tarea: publicar con QoS 1 solo deja el
+// mensaje en su bandeja (outbox) y la tarea lo escribe sin esperar el PUBACK
+// del anterior. Los PUBACK, la conexión y los mensajes entrantes llegan como
+// eventos en esa tarea; la tarea de red solo mira los contadores. La
+// reconexión automática está apagada para que la maneje esperaMQTT. Lo que no se
+// confirmó se reenvía al reconectar y la bandeja lo descarta si pasa más de
+// CONFIG_OUTBOX_EXPIRED_TIMEOUT_MS (30 s) sin PUBACK.
+enum EstadoMQTT : uint8_t {
+  MQTT_DESCONECTADO,
+  MQTT_CONECTANDO,
+  MQTT_CONECTADO
+};
+const uint8_t VENTANA_QOS1 = 8;  // PUBLISH sin confirmar a la vez
+esp_mqtt_client_handle_t clienteMQTT = nullptr;
+bool clienteMQTTIniciado = false;
+bool intentoMQTTEnCurso = false;
+unsigned long inicioIntentoMQTT = 0;
+char clientIdMQTT[48];
+volatile EstadoMQTT estadoMQTT = MQTT_DESCONECTADO;
+// Los escribe la tarea de esp-mqtt; las demás solo los leen
+volatile uint32_t mqttConfirmados = 0;  // MQTT_EVENT_PUBLISHED
+volatile uint32_t mqttDescartados = 0;  // MQTT_EVENT_DELETED (vencidos en la bandeja)
+// Los escribe la tarea de red
+volatile uint32_t mqttEncolados = 0;
+volatile uint32_t mqttRechazados = 0;   // esp-mqtt no lo aceptó
+
+// ====== Parámetros remotos ======
+// Mismo canal de comandos que el ESP8266 (lib/ParametrosRemotos). El
+// comando se valida en la tarea de esp-mqtt, en una instancia propia fuera
+// del lock, y se aplica al principio de la vuelta siguiente de la tarea de
+// red; todos los accesos a 'parametros' pasan por muxParametros (el muestreo
+// lee con parametro()). Se guardan en NVS con Preferences.
+enum IndiceParametro : uint8_t {
+  PARAM_INTERVALO_UBICACION,
+  PARAM_INTERVALO_DIAGNOSTICO,
+  PARAM_VENTANA_QOS1,
+  CANTIDAD_PARAMETROS
+};
+const DefinicionParametro DEFINICION_PARAMETROS[CANTIDAD_PARAMETROS] = {
+  {"intervalo_ubicacion_ms", 1000, 600000, INTERVALO_ENVIO_UBICACION},
+  {"intervalo_diagnostico_ms", 5000, 3600000, INTERVALO_ENVIO_DIAGNOSTICO},
+  {"ventana_qos1", 1, 32, VENTANA_QOS1},
+};
+ParametrosRemotos parametros(DEFINICION_PARAMETROS, CANTIDAD_PARAMETROS);
+portMUX_TYPE muxParametros = portMUX_INITIALIZER_UNLOCKED;
+Preferences preferencias;
+const char* NVS_ESPACIO = "logiot";
+const char* NVS_PARAMETROS = "parametros";
+// Resultado del último comando; lo responde la tarea de red
+volatile bool respuestaComandoPendiente = false;
+uint32_t idUltimoComando = 0;
+ResultadoComando resultadoUltimoComando = COMANDO_ACEPTADO;
+int8_t parametroRechazado = -1;
+
+// ====== Tareas ======
+// El muestreo (simulación GPS, giros y armado de los mensajes) corre en el
+// núcleo 1 con período fijo; la red (esp-mqtt, reconexión y comandos) en el
+// núcleo 0, junto a la pila WiFi. Los mensajes pasan de una a otra ya
+// serializados por colaSalida (lib/ColaSPSC), sin mutex: un write TLS lento
+// o una reconexión llenan la cola, pero no atrasan una muestra. loop()
+// queda para la consola serie y el estado.
+enum TopicoSalida : uint8_t {
+  SALIDA_PEDIDOS,
+  SALIDA_UBICACION,
+  SALIDA_INFO
+};
+struct MensajeSalida {
+  TopicoSalida topico;
+  uint8_t qos;
+  uint16_t largo;  // para que esp-mqtt no lo vuelva a medir con strlen()
+  uint32_t creadoMs;
+  char datos[TAMANO_MENSAJE_MQTT];
+};
+const uint16_t TAMANO_COLA_SALIDA = 16;  // potencia de 2; ~6 KB
+ColaSPSCFija<MensajeSalida, TAMANO_COLA_SALIDA> colaSalida;
+
+const uint32_t PILA_MUESTREO = 6144;
+const uint32_t PILA_RED = 6144;
+const UBaseType_t PRIORIDAD_MUESTREO = 3;
+const UBaseType_t PRIORIDAD_RED = 2;
+// Sin mensajes nuevos, la red igual revisa la conexión y los comandos
+const uint32_t ESPERA_RED_MS = 50;
+TaskHandle_t manejadorMuestreo = nullptr;
+TaskHandle_t manejadorRed = nullptr;
+
+// La consola pide y el muestreo ejecuta: es el único que escribe en colaSalida
+enum PedidoMapeo : uint8_t {
+  PEDIDO_NINGUNO,
+  PEDIDO_INICIAR,
+  PEDIDO_DETENER,
+  PEDIDO_REPRODUCIR
+};
+volatile PedidoMapeo pedidoMapeo = PEDIDO_NINGUNO;
+
+// Copia para el estado por serie, al final de cada muestra
+struct EstadoMuestreo {
+  PuntoGPS gps;
+  bool mapeando;
+  char calle[16];
+};
+EstadoMuestreo estadoMuestreo = {};
+portMUX_TYPE muxEstado = portMUX_INITIALIZER_UNLOCKED;
+
+// Métricas: las escribe una sola tarea, las lee el estado
+volatile uint32_t muestrasTomadas = 0;
+volatile uint32_t atrasoMuestreoMaxUs = 0;  // muestreo: despertar real - período
+volatile uint32_t esperaColaMaxMs = 0;      // red: encolado -> entregado a esp-mqtt
+
+// ====== Asignador de los JsonDocument ======
+// Sin LOGIOT_SIN_HEAP usa malloc como el asignador por defecto. Con el modo
+// activo reparte un bloque estático: cada bloque lleva su tamaño adelante,
+// el último se puede agrandar en el lugar y cuando no queda ninguno vivo
+// (los documentos se usan de a uno) el bloque vuelve a empezar de cero.
+class AsignadorJson : public ArduinoJson::Allocator {
+ public:
+  void* allocate(size_t tamano) override;
+  void deallocate(void* p) override;
+  void* reallocate(void* p, size_t tamano) override;
+
+  size_t maximoUsado() const { return maximo; }
+  uint32_t rechazos() const { return sinLugar; }
+
+ private:
+  static size_t alinear(size_t n) { return (n + 7) & ~(size_t)7; }
+  static const size_t CABECERA = 8;
+
+  alignas(8) uint8_t memoria[TAMANO_POOL_JSON];
+  size_t usado = 0;
+  size_t ultimo = 0;  // posición de la cabecera del último bloque
+  uint16_t vivos = 0;
+  size_t maximo = 0;
+  uint32_t sinLugar = 0;
+};
+AsignadorJson asignadorJson;  // solo lo usa la tarea de muestreo
+volatile uint32_t asignacionesMuestreo = 0;
 
 // ====== Prototipos ======
 void conectarAWiFi();
 void configurarTiempo();
 void configurarAWS();
-void conectarAWSIoT();
 void reconectarMQTT();
-void callbackMQTT(char* topic, byte* payload, unsigned int length);
+void eventoMQTT(void* arg, esp_event_base_t base, int32_t id, void* datos);
+void callbackMQTT(const char* topico, int largoTopico, const char* datos, int largo);
+bool esTopico(const char* topico, int largoTopico, const char* esperado);
+uint32_t parametro(IndiceParametro indice);
+void cargarParametros();
+void guardarParametros();
+void aplicarParametros();
+void responderComando();
+bool mqttConectado();
+uint32_t mqttEnVuelo();
+bool publicarQoS1(const char* topico, const char* datos, int largo);
+bool publicarQoS0(const char* topico, const char* datos, int largo);
+void tareaMuestreo(void* arg);
+void tareaRed(void* arg);
+void atenderPedidoMapeo();
+void actualizarEstadoMuestreo();
+bool encolarMensaje(JsonDocument& doc, TopicoSalida topico, uint8_t qos);
+const char* topicoSalida(TopicoSalida topico);
+void drenarSalida();
+uint32_t relojMuestreo();
+uint32_t periodoMuestreo();
 void simularDatosGPS();
 void procesarDatosGPS();
-void enviarPuntoAMQTT(PuntoGPS p, const String& topico);
+void enviarPuntoAMQTT(const PuntoGPS& p, TopicoSalida topico);
 void enviarInicioMapeoMQTT();
 void enviarFinMapeoMQTT();
 void publicarGPS();
 void publicarDiagnostico();
 void iniciarMapeo();
 void detenerMapeo();
+void iniciarReproduccion();
+void terminarReproduccion();
 void mostrarEstadoSerial();
 
 // ===================================
@@ -183,8 +409,14 @@ void setup() {
   // Esperar un poco para que todo se estabilice
   delay(2000);
   
+  cargarParametros();
   configurarAWS();
-  conectarAWSIoT();
+#if LOGIOT_REPRODUCCION
+  if (!LittleFS.begin()) {
+    Serial.println("❌ No se pudo montar LittleFS: no hay escenarios");
+  }
+#endif
+  // El primer intento con AWS IoT lo hace la tarea de red
 
   // Inicializar GPS simulado
   gpsSimulado.lat = latBase;
@@ -193,8 +425,14 @@ void setup() {
   gpsSimulado.velocidad = 0.0;
   gpsSimulado.satelites = 8;
   gpsSimulado.tiempo = millis();
-
   estadoActual = ESTADO_PANTALLA_PRINCIPAL;
+  actualizarEstadoMuestreo();
+
+  // La red primero: el muestreo la despierta al encolar
+  xTaskCreatePinnedToCore(tareaRed, "red", PILA_RED, nullptr, PRIORIDAD_RED, &manejadorRed, PRO_CPU_NUM);
+  xTaskCreatePinnedToCore(tareaMuestreo, "muestreo", PILA_MUESTREO, nullptr, PRIORIDAD_MUESTREO, &manejadorMuestreo,
+                          APP_CPU_NUM);
+
   Serial.println("✅ Sistema inicializado correctamente");
   Serial.println("📡 Enviando datos simulados a AWS IoT Core");
   Serial.println("🔄 Presiona 'm' para iniciar mapeo, 's' para detener, 'r' para reiniciar\n");
@@ -203,40 +441,8 @@ void setup() {
 // ===================================
 // === LOOP ===
 // ===================================
+// Solo consola y estado: el GPS y la red corren en sus tareas
 void loop() {
-  awsClient.loop();
-
-  // Simular datos GPS cada segundo
-  static unsigned long ultimaSimulacion = 0;
-  if (millis() - ultimaSimulacion >= INTERVALO_SIMULACION_GPS) {
-    simularDatosGPS();
-    ultimaSimulacion = millis();
-  }
-
-  // Procesar datos GPS si está mapeando
-  if (estadoActual == ESTADO_MAPEO_ACTIVO) {
-    procesarDatosGPS();
-  }
-
-  // Enviar diagnóstico periódicamente
-  if (millis() - ultimoDiagnosticoEnviado >= INTERVALO_ENVIO_DIAGNOSTICO) {
-    publicarDiagnostico();
-    ultimoDiagnosticoEnviado = millis();
-  }
-
-  // Enviar ubicación si está mapeando
-  if (estadoActual == ESTADO_MAPEO_ACTIVO && 
-      (millis() - ultimoPuntoUbicacionEnviado >= INTERVALO_ENVIO_UBICACION)) {
-    publicarGPS();
-    ultimoPuntoUbicacionEnviado = millis();
-  }
-
-  // Reconectar MQTT si es necesario
-  if (millis() - ultimoIntentoMQTT >= INTERVALO_RECONEXION_MQTT) {
-    reconectarMQTT();
-    ultimoIntentoMQTT = millis();
-  }
-
   // Mostrar estado cada 5 segundos
   static unsigned long ultimoEstado = 0;
   if (millis() - ultimoEstado >= 5000) {
@@ -250,12 +456,18 @@ void loop() {
     switch (comando) {
       case 'm':
       case 'M':
-        iniciarMapeo();
+        pedidoMapeo = PEDIDO_INICIAR;
         break;
       case 's':
       case 'S':
-        detenerMapeo();
+        pedidoMapeo = PEDIDO_DETENER;
+        break;
+#if LOGIOT_REPRODUCCION
+      case 'p':
+      case 'P':
+        pedidoMapeo = PEDIDO_REPRODUCIR;
         break;
+#endif
       case 'r':
       case 'R':
         Serial.println("🔄 Reiniciando dispositivo...");
@@ -266,6 +478,9 @@ void loop() {
         Serial.println("\n=== COMANDOS DISPONIBLES ===");
         Serial.println("m/M - Iniciar mapeo");
         Serial.println("s/S - Detener mapeo");
+#if LOGIOT_REPRODUCCION
+        Serial.println("p/P - Reproducir el escenario de LittleFS");
+#endif
         Serial.println("r/R - Reiniciar dispositivo");
         Serial.println("h/H - Mostrar esta ayuda");
         Serial.println("=============================\n");
@@ -273,7 +488,139 @@ void loop() {
     }
   }
 
-  delay(100);
+  delay(20);
+}
+
+// ===================================
+// === TAREAS ===
+// ===================================
+// Núcleo 1: una muestra por período, medida contra el reloj y no contra
+// el final de la anterior
+void tareaMuestreo(void* arg) {
+  TickType_t despertar = xTaskGetTickCount();
+  uint32_t esperadoUs = micros();
+  for (;;) {
+    uint32_t periodo = periodoMuestreo();
+    vTaskDelayUntil(&despertar, pdMS_TO_TICKS(periodo));
+    esperadoUs += periodo * 1000UL;
+    int32_t atraso = (int32_t)(micros() - esperadoUs);
+    if (atraso > (int32_t)atrasoMuestreoMaxUs) atrasoMuestreoMaxUs = (uint32_t)atraso;
+
+    uint32_t asignacionesAntes = contadorAsignaciones();
+    atenderPedidoMapeo();
+    simularDatosGPS();
+    muestrasTomadas = muestrasTomadas + 1;
+
+    // Procesar datos GPS si está mapeando (sin fix no hay puntos)
+    if (estadoActual == ESTADO_MAPEO_ACTIVO && gpsConFix) {
+      procesarDatosGPS();
+    }
+
+    // Enviar diagnóstico periódicamente
+    if (relojMuestreo() - ultimoDiagnosticoEnviado >= parametro(PARAM_INTERVALO_DIAGNOSTICO)) {
+      publicarDiagnostico();
+      ultimoDiagnosticoEnviado = relojMuestreo();
+    }
+
+    // Enviar ubicación si está mapeando
+    if (estadoActual == ESTADO_MAPEO_ACTIVO && gpsConFix &&
+        (relojMuestreo() - ultimoPuntoUbicacionEnviado >= parametro(PARAM_INTERVALO_UBICACION))) {
+      publicarGPS();
+      ultimoPuntoUbicacionEnviado = relojMuestreo();
+    }
+
+    actualizarEstadoMuestreo();
+    asignacionesMuestreo = asignacionesMuestreo + (contadorAsignaciones() - asignacionesAntes);
+  }
+}
+
+// Núcleo 0: dueña del cliente MQTT. Se despierta con cada mensaje encolado
+// o cada ESPERA_RED_MS
+void tareaRed(void* arg) {
+  for (;;) {
+    // Un comando recibido durante la vuelta anterior rige desde acá
+    aplicarParametros();
+    reconectarMQTT();
+    drenarSalida();
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ESPERA_RED_MS));
+  }
+}
+
+void atenderPedidoMapeo() {
+  PedidoMapeo pedido = pedidoMapeo;
+  if (pedido == PEDIDO_NINGUNO) {
+    return;
+  }
+  pedidoMapeo = PEDIDO_NINGUNO;
+  if (pedido == PEDIDO_INICIAR) {
+    iniciarMapeo();
+  } else if (pedido == PEDIDO_DETENER) {
+    detenerMapeo();
+  } else {
+    iniciarReproduccion();
+  }
+}
+
+void actualizarEstadoMuestreo() {
+  portENTER_CRITICAL(&muxEstado);
+  estadoMuestreo.gps = gpsSimulado;
+  estadoMuestreo.mapeando = (estadoActual == ESTADO_MAPEO_ACTIVO);
+  memcpy(estadoMuestreo.calle, idCalleActual, sizeof(estadoMuestreo.calle));
+  portEXIT_CRITICAL(&muxEstado);
+}
+
+// Serializa directo en el registro de la cola, sin buffer intermedio
+bool encolarMensaje(JsonDocument& doc, TopicoSalida topico, uint8_t qos) {
+  MensajeSalida* m = colaSalida.reservar();
+  if (m == nullptr) {
+    return false;
+  }
+  m->topico = topico;
+  m->qos = qos;
+  m->creadoMs = millis();
+  m->largo = serializeJson(doc, m->datos, sizeof(m->datos));
+  colaSalida.publicar();
+  xTaskNotifyGive(manejadorRed);
+  return true;
+}
+
+const char* topicoSalida(TopicoSalida topico) {
+  switch (topico) {
+    case SALIDA_PEDIDOS: return AWS_TOPIC_PEDIDOS;
+    case SALIDA_UBICACION: return AWS_TOPIC_UBICACION;
+    case SALIDA_INFO: return AWS_TOPIC_INFO;
+  }
+  return AWS_TOPIC_INFO;
+}
+
+// Pasa los mensajes de colaSalida a esp-mqtt mientras haya conexión y lugar
+// en la ventana QoS 1. El lugar se libera solo cuando esp-mqtt tomó el
+// mensaje: lo que no sale queda en la cola y, llena, el muestreo descarta
+// lo nuevo
+void drenarSalida() {
+  const MensajeSalida* m;
+  while ((m = colaSalida.frente()) != nullptr) {
+    if (!mqttConectado()) {
+      return;
+    }
+    const char* topico = topicoSalida(m->topico);
+    if (m->qos == 1) {
+      if (mqttEnVuelo() >= parametro(PARAM_VENTANA_QOS1)) {
+        return;
+      }
+      if (!publicarQoS1(topico, m->datos, m->largo)) {
+        Serial.printf("❌ Fallo al publicar en %s (%lu sin PUBACK), se reintenta\n", topico, (unsigned long)mqttEnVuelo());
+        return;
+      }
+      Serial.printf("✅ Publicado en %s -> %s\n", topico, m->datos);
+    } else if (!publicarQoS0(topico, m->datos, m->largo)) {
+      Serial.printf("❌ Fallo al publicar en %s, se reintenta\n", topico);
+      return;
+    }
+    uint32_t espera = millis() - m->creadoMs;
+    if (espera > esperaColaMaxMs) esperaColaMaxMs = espera;
+    colaSalida.liberar();
+  }
 }
 
 // ===================================
@@ -321,103 +668,312 @@ void configurarTiempo() {
 void configurarAWS() {
   Serial.println("🔐 Configurando certificados AWS IoT...");
   
-  // Configurar certificados AWS IoT
-  wifiClientSecure.setCACert(AWS_CERT_CA);
-  wifiClientSecure.setCertificate(AWS_CERT_CRT);
-  wifiClientSecure.setPrivateKey(AWS_CERT_PRIVATE);
-  
-  awsClient.setServer(AWS_IOT_ENDPOINT, AWS_IOT_PORT);
-  awsClient.setCallback(callbackMQTT);
-  awsClient.setKeepAlive(60);
-  awsClient.setSocketTimeout(15);
+  // Generar Client ID único (uno por arranque: la bandeja sobrevive a las reconexiones)
+  snprintf(clientIdMQTT, sizeof(clientIdMQTT), "%s-%lx", THING_NAME, (unsigned long)random(0xffff));
+
+  static char uri[128];
+  snprintf(uri, sizeof(uri), "mqtts://%s:%d", AWS_IOT_ENDPOINT, AWS_IOT_PORT);
+
+  esp_mqtt_client_config_t config = {};
+  config.uri = uri;
+  config.client_id = clientIdMQTT;
+  config.cert_pem = AWS_CERT_CA;
+  config.client_cert_pem = AWS_CERT_CRT;
+  config.client_key_pem = AWS_CERT_PRIVATE;
+  config.keepalive = 60;
+  config.network_timeout_ms = 15000;
+  config.disable_auto_reconnect = true;
+  clienteMQTT = esp_mqtt_client_init(&config);
+  esp_mqtt_client_register_event(clienteMQTT, MQTT_EVENT_ANY, eventoMQTT, nullptr);
   
   Serial.println("✅ AWS IoT configurado con certificados");
 }
 
-void conectarAWSIoT() {
-  Serial.printf("🌐 Conectando a AWS IoT: %s\n", AWS_IOT_ENDPOINT);
-  
-  // Esperar un poco para que la conexión WiFi se estabilice
-  delay(3000);
-  
-  int intentos = 0;
-  while (!awsClient.connected() && intentos < 5) {
-    Serial.printf("🔄 Intento %d de conexión MQTT...\n", intentos + 1);
-    
-    // Generar Client ID único
-    String clientId = String(THING_NAME) + "-" + String(random(0xffff), HEX);
-    
-    if (awsClient.connect(clientId.c_str())) {
-      Serial.println("✅ Conectado a AWS IoT Core");
-      break;
+// El resultado de cada intento llega como evento; si falla, el próximo
+// espera según esperaMQTT
+void reconectarMQTT() {
+  // Corte del broker pedido por el escenario: se cierra la conexión y no se
+  // reintenta hasta que termine
+  if (brokerCaidoEscenario) {
+    if (clienteMQTTIniciado && (estadoMQTT != MQTT_DESCONECTADO || intentoMQTTEnCurso)) {
+      esp_mqtt_client_disconnect(clienteMQTT);
+      estadoMQTT = MQTT_DESCONECTADO;
+      intentoMQTTEnCurso = false;
+      Serial.println("🔌 Escenario: broker caído, conexión cerrada");
+    }
+    return;
+  }
+  EstadoMQTT estado = estadoMQTT;
+  if (intentoMQTTEnCurso) {
+    if (estado == MQTT_CONECTANDO) {
+      return;
+    }
+    intentoMQTTEnCurso = false;
+    if (estado == MQTT_CONECTADO) {
+      Serial.printf("✅ Conectado a AWS IoT Core en %lu ms\n", (unsigned long)(millis() - inicioIntentoMQTT));
+      esperaMQTT.exito();
     } else {
-      Serial.printf("❌ Error conectando: %d\n", awsClient.state());
-      intentos++;
-      delay(5000); // Esperar más tiempo entre intentos
+      uint32_t espera = esperaMQTT.fallo(esp_random());
+      proximoIntentoMQTT = millis() + espera;
+      Serial.printf("❌ AWS IoT FAIL, reintento en %lu ms\n", (unsigned long)espera);
     }
+    return;
   }
-  
-  if (!awsClient.connected()) {
-    Serial.println("❌ No se pudo conectar a AWS IoT");
+  if (estado != MQTT_DESCONECTADO || (long)(millis() - proximoIntentoMQTT) < 0) {
+    return;
+  }
+  Serial.printf("🔄 Conectando a AWS IoT: %s (intento %lu)\n", AWS_IOT_ENDPOINT,
+                (unsigned long)(esperaMQTT.fallosSeguidos() + 1));
+  estadoMQTT = MQTT_CONECTANDO;
+  intentoMQTTEnCurso = true;
+  inicioIntentoMQTT = millis();
+  if (!clienteMQTTIniciado) {
+    clienteMQTTIniciado = esp_mqtt_client_start(clienteMQTT) == ESP_OK;
+    if (!clienteMQTTIniciado) estadoMQTT = MQTT_DESCONECTADO;
+  } else if (esp_mqtt_client_reconnect(clienteMQTT) != ESP_OK) {
+    estadoMQTT = MQTT_DESCONECTADO;
   }
 }
 
-void reconectarMQTT() {
-  if (!awsClient.connected() && intentosFallidosMQTT < MAX_INTENTOS_MQTT) {
-    Serial.println("🔄 Intentando reconectar AWS IoT...");
-    
-    // Generar Client ID único para reconexión
-    String clientId = String(THING_NAME) + "-" + String(random(0xffff), HEX);
-    
-    if (awsClient.connect(clientId.c_str())) {
-      Serial.println("✅ AWS IoT reconectado");
-      intentosFallidosMQTT = 0;
-    } else {
-      intentosFallidosMQTT++;
-      Serial.printf("❌ AWS IoT FAIL (state=%d)\n", awsClient.state());
-      if (intentosFallidosMQTT >= MAX_INTENTOS_MQTT) {
-        Serial.println("⚠️ Máximo de intentos AWS IoT alcanzado. Esperando...");
+// Corre en la tarea de esp-mqtt
+void eventoMQTT(void* arg, esp_event_base_t base, int32_t id, void* datos) {
+  esp_mqtt_event_handle_t evento = (esp_mqtt_event_handle_t)datos;
+  switch ((esp_mqtt_event_id_t)id) {
+    case MQTT_EVENT_CONNECTED:
+      estadoMQTT = MQTT_CONECTADO;
+      // Sesión limpia: las suscripciones se piden en cada conexión
+      esp_mqtt_client_subscribe(evento->client, AWS_TOPIC_CONTROL, 1);
+      esp_mqtt_client_subscribe(evento->client, AWS_TOPIC_CONTROL_FLOTA, 1);
+      break;
+    case MQTT_EVENT_DISCONNECTED:
+      estadoMQTT = MQTT_DESCONECTADO;
+      break;
+    case MQTT_EVENT_PUBLISHED:
+      mqttConfirmados++;
+      break;
+    case MQTT_EVENT_DELETED:
+      mqttDescartados++;
+      break;
+    case MQTT_EVENT_DATA:
+      // Lo que no entra en el buffer de esp-mqtt llega en partes; un comando entra en una
+      if (evento->current_data_offset == 0 && evento->data_len == evento->total_data_len) {
+        callbackMQTT(evento->topic, evento->topic_len, evento->data, evento->data_len);
       }
-    }
+      break;
+    default:
+      break;
   }
 }
 
-void callbackMQTT(char* topic, byte* payload, unsigned int length) {
-  Serial.printf("📨 Mensaje recibido en topic: %s\n", topic);
-  
-  String message = "";
-  for (unsigned int i = 0; i < length; i++) {
-    message += (char)payload[i];
+void callbackMQTT(const char* topico, int largoTopico, const char* datos, int largo) {
+  bool propio = esTopico(topico, largoTopico, AWS_TOPIC_CONTROL);
+  if (propio || esTopico(topico, largoTopico, AWS_TOPIC_CONTROL_FLOTA)) {
+    // Se valida en el buffer del evento, sin copiarlo y sin el spinlock: la
+    // sección crítica solo copia los valores ya leídos
+    ParametrosRemotos comando(DEFINICION_PARAMETROS, CANTIDAD_PARAMETROS);
+    uint32_t id;
+    int8_t rechazado;
+    ResultadoComando resultado = comando.recibir(datos, largo, id, rechazado);
+    portENTER_CRITICAL(&muxParametros);
+    if (resultado == COMANDO_ACEPTADO) {
+      parametros.combinar(comando);
+    }
+    parametroRechazado = rechazado;
+    idUltimoComando = id;
+    resultadoUltimoComando = resultado;
+    respuestaComandoPendiente = true;
+    portEXIT_CRITICAL(&muxParametros);
+    Serial.printf("🎛 Comando %lu (%s): %s\n", (unsigned long)id, propio ? "equipo" : "flota",
+                  ParametrosRemotos::descripcion(resultado));
+    return;
   }
+
+  Serial.printf("📨 Mensaje recibido en topic: %.*s\n", largoTopico, topico);
   
-  Serial.printf("📄 Contenido: %s\n", message.c_str());
+  Serial.printf("📄 Contenido: %.*s\n", largo, datos);
+}
+
+bool mqttConectado() {
+  return estadoMQTT == MQTT_CONECTADO;
+}
+
+uint32_t mqttEnVuelo() {
+  return mqttEncolados - mqttConfirmados - mqttDescartados;
+}
+
+// El tópico del evento no termina en '\0'
+bool esTopico(const char* topico, int largoTopico, const char* esperado) {
+  return (int)strlen(esperado) == largoTopico && memcmp(topico, esperado, largoTopico) == 0;
+}
+
+// Contrapresión: con la ventana llena de mensajes sin PUBACK no se encola otro.
+// esp-mqtt copia el mensaje a su outbox para poder reenviarlo: es la única
+// copia después de serializarlo en colaSalida
+bool publicarQoS1(const char* topico, const char* datos, int largo) {
+  if (!mqttConectado() || mqttEnVuelo() >= parametros.valor(PARAM_VENTANA_QOS1)) {
+    mqttRechazados++;
+    return false;
+  }
+  if (esp_mqtt_client_enqueue(clienteMQTT, topico, datos, largo, 1, 0, true) < 0) {
+    mqttRechazados++;
+    return false;
+  }
+  mqttEncolados++;
+  return true;
+}
+
+// El diagnóstico no necesita confirmación: se escribe directo, como antes
+bool publicarQoS0(const char* topico, const char* datos, int largo) {
+  return mqttConectado() && esp_mqtt_client_publish(clienteMQTT, topico, datos, largo, 0, 0) >= 0;
+}
+
+// ===================================
+// === PARAMETROS REMOTOS ===
+// ===================================
+uint32_t parametro(IndiceParametro indice) {
+  portENTER_CRITICAL(&muxParametros);
+  uint32_t valor = parametros.valor(indice);
+  portEXIT_CRITICAL(&muxParametros);
+  return valor;
+}
+
+void cargarParametros() {
+  uint8_t datos[PARAMETROS_TAMANO_SERIALIZADO];
+  size_t largo = 0;
+  if (preferencias.begin(NVS_ESPACIO, true)) {
+    largo = preferencias.getBytes(NVS_PARAMETROS, datos, sizeof(datos));
+    preferencias.end();
+  }
+  if (largo == 0) {
+    return;
+  }
+  if (!parametros.restaurar(datos, largo)) {
+    Serial.println("⚠️ Parámetros guardados inválidos, se usan los de por defecto");
+    return;
+  }
+  Serial.printf("✅ Parámetros: %u cambiados por comando\n", (unsigned)__builtin_popcount(parametros.modificados()));
+}
+
+void guardarParametros() {
+  uint8_t datos[PARAMETROS_TAMANO_SERIALIZADO];
+  size_t largo = parametros.serializar(datos, sizeof(datos));
+  if (!preferencias.begin(NVS_ESPACIO, false) || preferencias.putBytes(NVS_PARAMETROS, datos, largo) != largo) {
+    Serial.println("⚠️ No se pudieron guardar los parámetros");
+  }
+  preferencias.end();
+}
+
+void aplicarParametros() {
+  uint32_t cambiados = 0;
+  bool responder;
+  portENTER_CRITICAL(&muxParametros);
+  if (parametros.hayPendientes()) {
+    cambiados = parametros.aplicarPendientes();
+  }
+  responder = respuestaComandoPendiente;
+  portEXIT_CRITICAL(&muxParametros);
+  // La escritura en flash queda afuera de la sección crítica
+  if (cambiados != 0) {
+    guardarParametros();
+  }
+  if (responder) {
+    responderComando();
+  }
+}
+
+// Con los valores en uso: también confirma un comando que no cambió nada
+void responderComando() {
+  if (!mqttConectado()) {
+    return;
+  }
+  char buffer[TAMANO_MENSAJE_MQTT];
+  portENTER_CRITICAL(&muxParametros);
+  respuestaComandoPendiente = false;
+  uint32_t id = idUltimoComando;
+  ResultadoComando resultado = resultadoUltimoComando;
+  int8_t rechazado = parametroRechazado;
+  portEXIT_CRITICAL(&muxParametros);
+
+  int largo = snprintf(buffer, sizeof(buffer), "{\"id\":%lu,\"device_id\":\"%s\",\"resultado\":\"%s\"",
+                       (unsigned long)id, DEVICE_ID, ParametrosRemotos::descripcion(resultado));
+  if (rechazado >= 0) {
+    largo += snprintf(buffer + largo, sizeof(buffer) - largo, ",\"parametro\":\"%s\"",
+                      parametros.definicion(rechazado).nombre);
+  }
+  largo += snprintf(buffer + largo, sizeof(buffer) - largo, ",\"valores\":{");
+  for (uint8_t i = 0; i < parametros.cantidad() && largo < (int)sizeof(buffer); i++) {
+    largo += snprintf(buffer + largo, sizeof(buffer) - largo, "%s\"%s\":%lu", i > 0 ? "," : "",
+                      parametros.definicion(i).nombre, (unsigned long)parametros.valor(i));
+  }
+  if (largo + 2 >= (int)sizeof(buffer)) {
+    Serial.println("⚠️ Respuesta de comando demasiado larga");
+    return;
+  }
+  largo += snprintf(buffer + largo, sizeof(buffer) - largo, "}}");
+  publicarQoS0(AWS_TOPIC_CONTROL_RESPUESTA, buffer, largo);
 }
 
 // ===================================
 // === FUNCIONES DE SIMULACION GPS ===
 // ===================================
+// Reloj de la tarea de muestreo: millis() más lo que adelantó el reloj
+// virtual de los escenarios reproducidos
+uint32_t relojMuestreo() {
+#if LOGIOT_REPRODUCCION
+  if (reproduciendo) {
+    return adelantoRelojMs + muestrasEscenario * INTERVALO_SIMULACION_GPS;
+  }
+#endif
+  return millis() + adelantoRelojMs;
+}
+
+uint32_t periodoMuestreo() {
+#if LOGIOT_REPRODUCCION
+  if (reproduciendo) {
+    uint16_t factor = escenario.aceleracion();
+    if (factor > ACELERACION_MAXIMA) factor = ACELERACION_MAXIMA;
+    return INTERVALO_SIMULACION_GPS / factor;
+  }
+#endif
+  return INTERVALO_SIMULACION_GPS;
+}
+
 void simularDatosGPS() {
-  // Simular movimiento en un patrón circular
+#if LOGIOT_REPRODUCCION
+  if (reproduciendo) {
+    MuestraEscenario e;
+    muestrasEscenario++;
+    if (!escenario.muestra(muestrasEscenario * INTERVALO_SIMULACION_GPS, e)) {
+      terminarReproduccion();
+      return;
+    }
+    gpsSimulado.lat = e.lat;
+    gpsSimulado.lon = e.lon;
+    gpsSimulado.rumbo = e.rumbo;
+    gpsSimulado.velocidad = e.velocidad;
+    gpsSimulado.satelites = e.satelites;
+    gpsSimulado.tiempo = relojMuestreo();
+    gpsConFix = e.conFix;
+    brokerCaidoEscenario = e.brokerCaido;
+    // Acelerado, una línea por segundo real alcanza para el monitor serie
+    if (muestrasEscenario % escenario.aceleracion() == 0) {
+      Serial.printf("🎬 Escenario %lus: Lat=%.6f, Lon=%.6f, Rumbo=%.1f°, Vel=%.1f km/h, Sats=%d%s%s\n",
+                    (unsigned long)muestrasEscenario, gpsSimulado.lat, gpsSimulado.lon, gpsSimulado.rumbo,
+                    gpsSimulado.velocidad, gpsSimulado.satelites, gpsConFix ? "" : ", sin fix",
+                    e.brokerCaido ? ", broker caído" : "");
+    }
+    return;
+  }
+#endif
   static unsigned long tiempoInicio = millis();
-  unsigned long tiempoTranscurrido = millis() - tiempoInicio;
-  
-  // Cambiar rumbo gradualmente
-  rumboActual = fmod((tiempoTranscurrido / 1000.0) * 2.0, 360.0);
-  
-  // Simular velocidad variable
-  velocidadSimulada = 15.0 + 10.0 * sin(tiempoTranscurrido / 5000.0);
-  
-  // Calcular nueva posición (movimiento en espiral)
-  double radio = 0.001 + (tiempoTranscurrido / 100000.0);
-  double latOffset = radio * cos(rumboActual * PI / 180.0);
-  double lonOffset = radio * sin(rumboActual * PI / 180.0);
-  
-  gpsSimulado.lat = latBase + latOffset;
-  gpsSimulado.lon = lonBase + lonOffset;
-  gpsSimulado.rumbo = rumboActual;
-  gpsSimulado.velocidad = velocidadSimulada;
-  gpsSimulado.satelites = 8 + (int)(3 * sin(tiempoTranscurrido / 3000.0));
-  gpsSimulado.tiempo = millis();
+  MuestraSimulada m = simulador.muestra(millis() - tiempoInicio);
+
+  gpsSimulado.lat = m.lat;
+  gpsSimulado.lon = m.lon;
+  gpsSimulado.rumbo = m.rumbo;
+  gpsSimulado.velocidad = m.velocidad;
+  gpsSimulado.satelites = m.satelites;
+  gpsSimulado.tiempo = relojMuestreo();
   
   // Log de simulación
   Serial.printf("📍 GPS Simulado: Lat=%.6f, Lon=%.6f, Rumbo=%.1f°, Vel=%.1f km/h, Sats=%d\n",
@@ -427,42 +983,29 @@ void simularDatosGPS() {
 
 void procesarDatosGPS() {
   // Simular detección de giros basada en cambio de rumbo
-  static double rumboAnterior = 0.0;
-  static int contadorGiro = 0;
-  
-  double cambioRumbo = abs(gpsSimulado.rumbo - rumboAnterior);
-  if (cambioRumbo > 180) cambioRumbo = 360 - cambioRumbo;
-  
-  if (cambioRumbo > 30.0 && gpsSimulado.velocidad > 5.0) {
-    contadorGiro++;
-    if (contadorGiro >= 3) {
-      Serial.println("🔄 Giro detectado! Cambiando calle.");
-      enviarFinMapeoMQTT();
-      
-      contadorCalles++;
-      idCalleActual = "CALLE_" + String(contadorCalles);
-      enviarInicioMapeoMQTT();
-      
-      contadorGiro = 0;
-    }
-  } else {
-    contadorGiro = 0;
+  MuestraSimulada m = {gpsSimulado.lat, gpsSimulado.lon, gpsSimulado.rumbo, gpsSimulado.velocidad,
+                       gpsSimulado.satelites};
+  if (simulador.giro(m)) {
+    Serial.println("🔄 Giro detectado! Cambiando calle.");
+    enviarFinMapeoMQTT();
+    
+    contadorCalles++;
+    snprintf(idCalleActual, sizeof(idCalleActual), "CALLE_%d", contadorCalles);
+    enviarInicioMapeoMQTT();
   }
   
-  rumboAnterior = gpsSimulado.rumbo;
-  
   // Enviar punto de mapeo cada 10 segundos
-  if (millis() - ultimoPuntoMapeoEnviado > 10000) {
-    enviarPuntoAMQTT(gpsSimulado, AWS_TOPIC_PEDIDOS);
-    ultimoPuntoMapeoEnviado = millis();
+  if (relojMuestreo() - ultimoPuntoMapeoEnviado > 10000) {
+    enviarPuntoAMQTT(gpsSimulado, SALIDA_PEDIDOS);
+    ultimoPuntoMapeoEnviado = relojMuestreo();
   }
 }
 
 // ===================================
 // === FUNCIONES DE ENVIO MQTT ===
 // ===================================
-void enviarPuntoAMQTT(PuntoGPS p, const String& topico) {
-  JsonDocument doc;
+void enviarPuntoAMQTT(const PuntoGPS& p, TopicoSalida topico) {
+  JsonDocument doc(&asignadorJson);
   doc["id"] = idCalleActual;
   doc["tipo"] = "punto";
   doc["lat"] = p.lat;
@@ -473,24 +1016,15 @@ void enviarPuntoAMQTT(PuntoGPS p, const String& topico) {
   doc["rumbo"] = p.rumbo;
   doc["device_id"] = DEVICE_ID;
   doc["precision_baja"] = (p.satelites < 4);
-  doc["timestamp"] = millis();
-  
-  String buffer;
-  serializeJson(doc, buffer);
-  
-  if (awsClient.connected()) {
-    if (awsClient.publish(topico.c_str(), buffer.c_str())) {
-      Serial.printf("✅ Publicado en %s -> %s\n", topico.c_str(), buffer.c_str());
-    } else {
-      Serial.println("❌ Fallo al publicar punto en AWS IoT");
-    }
-  } else {
-    Serial.println("⚠️ No se publica punto: AWS IoT desconectado");
+  doc["timestamp"] = relojMuestreo();
+
+  if (!encolarMensaje(doc, topico, 1)) {
+    Serial.printf("❌ Punto descartado: cola de salida llena (%u)\n", (unsigned)colaSalida.cantidad());
   }
 }
 
 void enviarInicioMapeoMQTT() {
-  JsonDocument doc;
+  JsonDocument doc(&asignadorJson);
   doc["id"] = idCalleActual;
   doc["tipo"] = "inicio";
   doc["lat"] = gpsSimulado.lat;
@@ -499,87 +1033,66 @@ void enviarInicioMapeoMQTT() {
   doc["tiempo"] = gpsSimulado.tiempo;
   doc["device_id"] = DEVICE_ID;
   doc["precision_baja"] = (gpsSimulado.satelites < 4);
-  doc["timestamp"] = millis();
-  
-  String buffer;
-  serializeJson(doc, buffer);
-  
-  if (awsClient.connected()) {
-    if (awsClient.publish(AWS_TOPIC_PEDIDOS, buffer.c_str())) {
-      Serial.printf("✅ Inicio mapeo publicado en AWS -> %s\n", buffer.c_str());
-    } else {
-      Serial.println("❌ Fallo al publicar inicio mapeo en AWS IoT");
-    }
-  } else {
-    Serial.println("⚠️ No se publica inicio: AWS IoT desconectado");
+  doc["timestamp"] = relojMuestreo();
+
+  if (!encolarMensaje(doc, SALIDA_PEDIDOS, 1)) {
+    Serial.println("❌ Inicio mapeo descartado: cola de salida llena");
   }
 }
 
 void enviarFinMapeoMQTT() {
-  JsonDocument doc;
+  JsonDocument doc(&asignadorJson);
   doc["id"] = idCalleActual;
   doc["tipo"] = "fin";
   doc["device_id"] = DEVICE_ID;
-  doc["timestamp"] = millis();
-  
-  String buffer;
-  serializeJson(doc, buffer);
-  
-  if (awsClient.connected()) {
-    if (awsClient.publish(AWS_TOPIC_PEDIDOS, buffer.c_str())) {
-      Serial.printf("✅ Fin mapeo publicado en AWS -> %s\n", buffer.c_str());
-    } else {
-      Serial.println("❌ Fallo al publicar fin mapeo en AWS IoT");
-    }
-  } else {
-    Serial.println("⚠️ No se publica fin: AWS IoT desconectado");
+  doc["timestamp"] = relojMuestreo();
+
+  if (!encolarMensaje(doc, SALIDA_PEDIDOS, 1)) {
+    Serial.println("❌ Fin mapeo descartado: cola de salida llena");
   }
 }
 
 void publicarGPS() {
-  if (awsClient.connected()) {
-    JsonDocument doc;
-    doc["device_id"] = DEVICE_ID;
-    doc["latitud"] = gpsSimulado.lat;
-    doc["longitud"] = gpsSimulado.lon;
-    doc["satelites"] = gpsSimulado.satelites;
-    doc["velocidad_kmh"] = gpsSimulado.velocidad;
-    doc["precision_baja"] = (gpsSimulado.satelites < 4);
-    doc["timestamp"] = millis();
-
-    String buffer;
-    serializeJson(doc, buffer);
-
-    if (awsClient.publish(AWS_TOPIC_UBICACION, buffer.c_str())) {
-      Serial.printf("✅ Ubicación publicada en AWS -> %s\n", buffer.c_str());
-    } else {
-      Serial.println("❌ Fallo al publicar ubicación en AWS IoT");
-    }
-  } else {
-    Serial.println("⚠️ No se publica GPS: AWS IoT desconectado");
+  // La ubicación se vuelve a mandar en el próximo período: con la cola a
+  // media capacidad se deja el lugar para el mapeo
+  if (colaSalida.cantidad() >= TAMANO_COLA_SALIDA / 2) {
+    Serial.printf("⚠️ No se publica GPS: %u mensajes en la cola de salida\n", (unsigned)colaSalida.cantidad());
+    return;
+  }
+  JsonDocument doc(&asignadorJson);
+  doc["device_id"] = DEVICE_ID;
+  doc["latitud"] = gpsSimulado.lat;
+  doc["longitud"] = gpsSimulado.lon;
+  doc["satelites"] = gpsSimulado.satelites;
+  doc["velocidad_kmh"] = gpsSimulado.velocidad;
+  doc["precision_baja"] = (gpsSimulado.satelites < 4);
+  doc["timestamp"] = relojMuestreo();
+
+  if (!encolarMensaje(doc, SALIDA_UBICACION, 1)) {
+    Serial.println("❌ Ubicación descartada: cola de salida llena");
   }
 }
 
 void publicarDiagnostico() {
-  JsonDocument doc;
+  // Como la ubicación: sin conexión no se llena la cola con diagnósticos
+  if (colaSalida.cantidad() >= TAMANO_COLA_SALIDA / 2) {
+    Serial.printf("⚠️ No se publica diagnóstico: %u mensajes en la cola de salida\n", (unsigned)colaSalida.cantidad());
+    return;
+  }
+  JsonDocument doc(&asignadorJson);
   doc["device_id"] = DEVICE_ID;
   doc["estado_wifi"] = (WiFi.status() == WL_CONNECTED) ? "Conectado" : "Desconectado";
-  doc["estado_mqtt"] = awsClient.connected() ? "Conectado" : "Desconectado";
-  doc["estado_gps"] = "Simulado";
+  doc["estado_mqtt"] = mqttConectado() ? "Conectado" : "Desconectado";
+  doc["estado_gps"] = !gpsConFix ? "Sin fix" : "Simulado";
   doc["satelites_gps"] = gpsSimulado.satelites;
-  doc["timestamp"] = millis();
+  doc["cola_salida"] = colaSalida.cantidad();
+  doc["cola_salida_max"] = colaSalida.maximo();
+  doc["cola_salida_descartados"] = colaSalida.rechazados();
+  doc["atraso_muestreo_max_us"] = (uint32_t)atrasoMuestreoMaxUs;
+  doc["timestamp"] = relojMuestreo();
 
-  String buffer;
-  serializeJson(doc, buffer);
-  
-  if (awsClient.connected()) {
-    if (awsClient.publish(AWS_TOPIC_INFO, buffer.c_str())) {
-      Serial.printf("📊 Diagnóstico publicado en AWS -> %s\n", buffer.c_str());
-    } else {
-      Serial.println("❌ Fallo al publicar diagnóstico en AWS IoT");
-    }
-  } else {
-    Serial.println("⚠️ No se publica diagnóstico: AWS IoT desconectado");
+  if (!encolarMensaje(doc, SALIDA_INFO, 0)) {
+    Serial.println("❌ Diagnóstico descartado: cola de salida llena");
   }
 }
 
@@ -591,9 +1104,9 @@ void iniciarMapeo() {
     mapeando = true;
     estadoActual = ESTADO_MAPEO_ACTIVO;
     contadorCalles++;
-    idCalleActual = "CALLE_" + String(contadorCalles);
+    snprintf(idCalleActual, sizeof(idCalleActual), "CALLE_%d", contadorCalles);
     enviarInicioMapeoMQTT();
-    Serial.printf("🚀 Mapeo ACTIVADO - Calle: %s\n", idCalleActual.c_str());
+    Serial.printf("🚀 Mapeo ACTIVADO - Calle: %s\n", idCalleActual);
   }
 }
 
@@ -606,14 +1119,166 @@ void detenerMapeo() {
   }
 }
 
+// Arranca desde el principio del archivo, con un mapeo nuevo
+void iniciarReproduccion() {
+#if LOGIOT_REPRODUCCION
+  if (reproduciendo) {
+    terminarReproduccion();
+  }
+  if (!fuenteEscenario.abrir(RUTA_ESCENARIO)) {
+    Serial.printf("❌ No se encontró %s en LittleFS\n", RUTA_ESCENARIO);
+    return;
+  }
+  detenerMapeo();
+  escenario.reiniciar();
+  adelantoRelojMs = relojMuestreo();
+  muestrasEscenario = 0;
+  reproduciendo = true;
+  // La posición inicial sale del escenario antes del inicio del mapeo
+  MuestraEscenario e;
+  escenario.muestra(0, e);
+  gpsSimulado.lat = e.lat;
+  gpsSimulado.lon = e.lon;
+  gpsSimulado.rumbo = e.rumbo;
+  gpsSimulado.velocidad = e.velocidad;
+  gpsSimulado.satelites = e.satelites;
+  gpsSimulado.tiempo = relojMuestreo();
+  simulador.reiniciarGiros();
+  iniciarMapeo();
+  Serial.printf("🎬 Reproduciendo %s (x%u)\n", RUTA_ESCENARIO, (unsigned)escenario.aceleracion());
+#endif
+}
+
+void terminarReproduccion() {
+#if LOGIOT_REPRODUCCION
+  const EstadisticasEscenario& est = escenario.estadisticas();
+  Serial.printf("🏁 Escenario terminado: %lu s, %lu líneas, %lu puntos, %lu comandos, %lu errores",
+                (unsigned long)muestrasEscenario, (unsigned long)est.lineas, (unsigned long)est.puntos,
+                (unsigned long)est.comandos, (unsigned long)est.errores);
+  if (est.errores > 0) {
+    Serial.printf(" (la primera en la línea %lu)", (unsigned long)est.primeraConError);
+  }
+  Serial.println();
+  detenerMapeo();
+  fuenteEscenario.cerrar();
+  // El reloj sigue desde donde quedó el virtual
+  adelantoRelojMs = relojMuestreo() - millis();
+  reproduciendo = false;
+  gpsConFix = true;
+  brokerCaidoEscenario = false;
+#endif
+}
+
 void mostrarEstadoSerial() {
   Serial.println("\n=== ESTADO DEL DISPOSITIVO ===");
   Serial.printf("📶 WiFi: %s\n", WiFi.status() == WL_CONNECTED ? "Conectado" : "Desconectado");
-  Serial.printf("🌐 AWS IoT: %s\n", awsClient.connected() ? "Conectado" : "Desconectado");
-  Serial.printf("📍 Estado: %s\n", estadoActual == ESTADO_MAPEO_ACTIVO ? "Mapeando" : "Inactivo");
-  Serial.printf("🛣️ Calle actual: %s\n", idCalleActual.c_str());
-  Serial.printf("📍 GPS: Lat=%.6f, Lon=%.6f\n", gpsSimulado.lat, gpsSimulado.lon);
-  Serial.printf("🧭 Rumbo: %.1f°, Velocidad: %.1f km/h\n", gpsSimulado.rumbo, gpsSimulado.velocidad);
-  Serial.printf("🛰️ Satélites: %d\n", gpsSimulado.satelites);
+  Serial.printf("🌐 AWS IoT: %s\n", mqttConectado() ? "Conectado" : "Desconectado");
+  // Confirmados (PUBACK) por segundo desde el estado anterior
+  static uint32_t confirmadosAntes = 0;
+  static unsigned long instanteAntes = 0;
+  uint32_t confirmados = mqttConfirmados;
+  unsigned long ahora = millis();
+  if (instanteAntes != 0 && ahora > instanteAntes) {
+    uint32_t centesimas = (confirmados - confirmadosAntes) * 100000UL / (ahora - instanteAntes);
+    Serial.printf("📮 QoS1: %lu.%02lu msgs/s confirmados, en vuelo=%lu, encolados=%lu, rechazados=%lu, vencidos=%lu\n",
+                  (unsigned long)(centesimas / 100), (unsigned long)(centesimas % 100), (unsigned long)mqttEnVuelo(),
+                  (unsigned long)mqttEncolados, (unsigned long)mqttRechazados, (unsigned long)mqttDescartados);
+  }
+  confirmadosAntes = confirmados;
+  instanteAntes = ahora;
+  Serial.printf("🧵 Cola salida: %u/%u, máximo=%u, descartados=%lu, espera máx=%lu ms\n",
+                (unsigned)colaSalida.cantidad(), (unsigned)TAMANO_COLA_SALIDA, (unsigned)colaSalida.maximo(),
+                (unsigned long)colaSalida.rechazados(), (unsigned long)esperaColaMaxMs);
+  // Pila libre mínima desde el arranque (bytes en el ESP32)
+  Serial.printf("🧵 Muestreo: %lu muestras, atraso máx=%lu us, pila libre=%u | red: pila libre=%u\n",
+                (unsigned long)muestrasTomadas, (unsigned long)atrasoMuestreoMaxUs,
+                (unsigned)uxTaskGetStackHighWaterMark(manejadorMuestreo),
+                (unsigned)uxTaskGetStackHighWaterMark(manejadorRed));
+  EstadoMuestreo e;
+  portENTER_CRITICAL(&muxEstado);
+  e = estadoMuestreo;
+  portEXIT_CRITICAL(&muxEstado);
+  Serial.printf("📍 Estado: %s\n", e.mapeando ? "Mapeando" : "Inactivo");
+  Serial.printf("🛣️ Calle actual: %s\n", e.calle);
+  Serial.printf("📍 GPS: Lat=%.6f, Lon=%.6f\n", e.gps.lat, e.gps.lon);
+  Serial.printf("🧭 Rumbo: %.1f°, Velocidad: %.1f km/h\n", e.gps.rumbo, e.gps.velocidad);
+  Serial.printf("🛰️ Satélites: %d\n", e.gps.satelites);
+  uint32_t libre = ESP.getFreeHeap();
+  uint32_t bloqueMax = ESP.getMaxAllocHeap();
+  Serial.printf("💾 Heap: libre=%lu bloque_max=%lu frag=%lu%% minimo=%lu\n", (unsigned long)libre,
+                (unsigned long)bloqueMax, libre ? (unsigned long)(100 - bloqueMax * 100 / libre) : 0UL,
+                (unsigned long)ESP.getMinFreeHeap());
+  if (rastreoHeapActivo()) {
+    EstadisticasHeap h = estadisticasHeap();
+    Serial.printf("💾 Asignaciones: %lu (%lu bytes), en el muestreo: %lu, JSON: %u/%u bytes, sin lugar: %lu\n",
+                  (unsigned long)h.asignaciones, (unsigned long)h.bytes, (unsigned long)asignacionesMuestreo,
+                  (unsigned)asignadorJson.maximoUsado(), (unsigned)TAMANO_POOL_JSON,
+                  (unsigned long)asignadorJson.rechazos());
+  }
   Serial.println("===============================\n");
-}
\ No newline at end of file
+}
+
+// ===================================
+// === ASIGNADOR JSON ===
+// ===================================
+void* AsignadorJson::allocate(size_t tamano) {
+#if LOGIOT_SIN_HEAP
+  size_t total = CABECERA + alinear(tamano);
+  if (usado + total > sizeof(memoria)) {
+    sinLugar++;
+    return nullptr;
+  }
+  uint8_t* bloque = memoria + usado;
+  *(size_t*)bloque = tamano;
+  ultimo = usado;
+  usado += total;
+  vivos++;
+  if (usado > maximo) maximo = usado;
+  return bloque + CABECERA;
+#else
+  return malloc(tamano);
+#endif
+}
+
+void AsignadorJson::deallocate(void* p) {
+#if LOGIOT_SIN_HEAP
+  if (p == nullptr) return;
+  uint8_t* bloque = (uint8_t*)p - CABECERA;
+  if (bloque == memoria + ultimo) {
+    usado = ultimo;
+  }
+  if (--vivos == 0) {
+    usado = 0;
+    ultimo = 0;
+  }
+#else
+  free(p);
+#endif
+}
+
+void* AsignadorJson::reallocate(void* p, size_t tamano) {
+#if LOGIOT_SIN_HEAP
+  if (p == nullptr) return allocate(tamano);
+  uint8_t* bloque = (uint8_t*)p - CABECERA;
+  size_t anterior = *(size_t*)bloque;
+  if (bloque == memoria + ultimo) {
+    // El último bloque crece o se achica en el lugar
+    size_t total = CABECERA + alinear(tamano);
+    if (ultimo + total > sizeof(memoria)) {
+      sinLugar++;
+      return nullptr;
+    }
+    *(size_t*)bloque = tamano;
+    usado = ultimo + total;
+    if (usado > maximo) maximo = usado;
+    return p;
+  }
+  void* nuevo = allocate(tamano);
+  if (nuevo == nullptr) return nullptr;
+  memcpy(nuevo, p, anterior < tamano ? anterior : tamano);
+  deallocate(p);
+  return nuevo;
+#else
+  return realloc(p, tamano);
+#endif
+}
@@ -0,0 +1,10 @@
+#!/bin/sh
+# Certificado autofirmado para herramientas/broker_tls (el firmware corre con
+# setInsecure(), no valida la cadena). Uso: ./generar_certificados.sh <ip>
+set -e
+IP="${1:?uso: $0 <ip del broker>}"
+cd "$(dirname "$0")"
+openssl req -x509 -newkey rsa:2048 -nodes -days 365 \
+  -keyout servidor.key -out servidor.crt \
+  -subj "/CN=$IP" -addext "subjectAltName=IP:$IP"
+echo "✔ servidor.crt y servidor.key generados para $IP"
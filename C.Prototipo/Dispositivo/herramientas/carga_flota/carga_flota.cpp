@@ -0,0 +1,1086 @@
+// ====== Generador de carga de la flota ======
+// Miles de equipos virtuales contra un broker MQTT local, para ver cómo se
+// comportan el broker, Telegraf y el tablero con la flota completa antes de
+// comprar hardware. Cada equipo es un Dispositivo de Testeo: su DEVICE_ID
+// (SIM-00000, SIM-00001, ...) y sus tópicos, el mismo recorrido en espiral
+// (lib/SimuladorGPS, desplazado unos km por equipo), los mismos mensajes que
+// enviarPuntoAMQTT, enviarInicioMapeoMQTT, publicarGPS y publicarDiagnostico
+// (mismas claves en el mismo orden, los números como los escribe ArduinoJson)
+// y los mismos períodos: una muestra por segundo, punto de mapeo cada 10 s,
+// ubicación y diagnóstico según las opciones. El mapeo arranca con la
+// primera conexión. Mapeo y ubicación van con QoS 1 por una BandejaMQTT por
+// equipo (la del ESP8266) y el diagnóstico con QoS 0.
+//
+// Los equipos se reparten entre hilos; cada hilo atiende los suyos con un
+// bucle epoll sobre sockets no bloqueantes. Un equipo que pierde la
+// conexión reintenta con EsperaReintentos, como el firmware.
+//
+// Con --escenario todos los equipos reproducen el mismo archivo de
+// lib/EscenarioGPS (guion, NMEA o GPX) en vez de la espiral, con el reloj
+// virtual del firmware con LOGIOT_REPRODUCCION: un segundo por muestra,
+// "acelerar N" acorta el período real y los timestamps siguen al reloj
+// virtual. Sin fix no hay mapeo ni ubicación; "broker caido" cierra la
+// conexión del equipo hasta "broker conectado". Al terminar el escenario el
+// equipo manda el fin del mapeo y queda quieto, con el diagnóstico.
+//
+// Otra conexión se suscribe a los tópicos de la flota y mide cuánto tarda
+// cada mensaje desde que el equipo lo arma hasta que llega. Para eso cada
+// equipo anota por tópico el "timestamp" y el instante de cada mensaje en una
+// ColaSPSC que el hilo del suscriptor consume (mismo orden por tópico que
+// garantiza MQTT); lo que el broker no entregó se cuenta como perdido.
+//
+// Compilar desde esta carpeta (una sola línea):
+//   g++ -O2 -std=c++11 -pthread -I../../lib/SimuladorGPS -I../../lib/EscenarioGPS
+//       -I../../lib/BandejaMQTT -I../../lib/ColaSPSC -I../../lib/HistogramaLatencia
+//       -I../../lib/EsperaReintentos carga_flota.cpp ../../lib/SimuladorGPS/SimuladorGPS.cpp
+//       ../../lib/EscenarioGPS/EscenarioGPS.cpp
+//       ../../lib/BandejaMQTT/BandejaMQTT.cpp ../../lib/ColaSPSC/ColaSPSC.cpp
+//       ../../lib/HistogramaLatencia/HistogramaLatencia.cpp
+//       ../../lib/EsperaReintentos/EsperaReintentos.cpp -o carga_flota
+//
+// Uso:
+//   ./carga_flota [--host 127.0.0.1] [--puerto 1883] [--equipos 5000] [--hilos n]
+//                 [--segundos 60] [--conexiones-seg 500] [--ventana 8]
+//                 [--intervalo-ubicacion 10000] [--intervalo-diagnostico 10000]
+//                 [--prefijo SIM-] [--escenario archivo]
+//
+// Cada equipo es un descriptor en la herramienta y otro en el broker: antes
+// de miles de equipos hay que subir el límite en las dos terminales, por
+// ejemplo
+//   ulimit -n 16384 && mosquitto -p 1883
+//   ulimit -n 16384 && ./carga_flota --equipos 5000
+// Sin TLS, como rendimiento_mqtt. Con Telegraf suscripto al mismo broker los
+// equipos virtuales aparecen en el tablero como equipos reales.
+
+#include <SimuladorGPS.h>
+#include <EscenarioGPS.h>
+#include <BandejaMQTT.h>
+#include <ColaSPSC.h>
+#include <HistogramaLatencia.h>
+#include <EsperaReintentos.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ====== Opciones ======
+struct Opciones {
+  const char* host;
+  int puerto;
+  uint32_t equipos;
+  uint32_t hilos;
+  uint32_t segundos;
+  uint32_t conexionesSeg;  // 0: todas a la vez
+  uint8_t ventana;
+  uint32_t intervaloUbicacionMs;
+  uint32_t intervaloDiagnosticoMs;
+  const char* prefijo;
+  const char* escenario;  // nullptr: la espiral
+};
+static Opciones opciones = {"127.0.0.1", 1883, 5000, 0, 60, 500, 8, 10000, 10000, "SIM-", nullptr};
+// El archivo de --escenario entero; cada equipo lo recorre con su fuente
+static std::string textoEscenario;
+
+// Los del Dispositivo de Testeo
+static const double LAT_BASE = -31.4201;
+static const double LON_BASE = -64.1888;
+static const uint32_t INTERVALO_SIMULACION_MS = 1000;
+static const uint32_t INTERVALO_PUNTO_MAPEO_MS = 10000;
+static const uint16_t ACELERACION_MAXIMA = 100;
+static const uint16_t KEEPALIVE_S = 60;
+
+static const uint16_t TAMANO_BANDEJA = 4096;  // la del ESP8266
+static const size_t TAMANO_SALIDA = 4096;     // bytes armados que el socket todavía no aceptó
+static const size_t TAMANO_MENSAJE = 384;     // TAMANO_MENSAJE_MQTT del ESP32
+static const uint16_t ENVIOS_POR_TOPICO = 32; // anotados sin recibir, por equipo y tópico
+static const uint32_t ESPERA_CONEXION_MS = 10000;
+static const ConfigReintentos CONFIG_REINTENTOS = {1000, 30000};
+
+// ====== Reloj ======
+static const std::chrono::steady_clock::time_point origen = std::chrono::steady_clock::now();
+
+static uint64_t ahoraUs() {
+  using namespace std::chrono;
+  return (uint64_t)duration_cast<microseconds>(steady_clock::now() - origen).count();
+}
+
+static uint32_t ahoraMs() {
+  return (uint32_t)(ahoraUs() / 1000);
+}
+
+// ====== Paquetes MQTT ======
+static size_t escribirLargoRestante(uint8_t* p, uint32_t largo) {
+  size_t n = 0;
+  do {
+    uint8_t b = largo % 128;
+    largo /= 128;
+    p[n++] = largo > 0 ? (b | 0x80) : b;
+  } while (largo > 0);
+  return n;
+}
+
+static size_t escribirTexto(uint8_t* p, const char* texto, size_t largo) {
+  p[0] = (uint8_t)(largo >> 8);
+  p[1] = (uint8_t)largo;
+  memcpy(p + 2, texto, largo);
+  return largo + 2;
+}
+
+// CONNECT de MQTT 3.1.1 con sesión limpia
+static size_t armarConnect(uint8_t* p, const char* clientId) {
+  size_t largoId = strlen(clientId);
+  static const uint8_t VARIABLE[] = {0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, KEEPALIVE_S >> 8, KEEPALIVE_S & 0xFF};
+  p[0] = 0x10;
+  size_t n = 1 + escribirLargoRestante(p + 1, (uint32_t)(sizeof(VARIABLE) + 2 + largoId));
+  memcpy(p + n, VARIABLE, sizeof(VARIABLE));
+  n += sizeof(VARIABLE);
+  return n + escribirTexto(p + n, clientId, largoId);
+}
+
+static size_t armarPublishQoS0(uint8_t* p, const char* topico, const char* datos, size_t largo) {
+  size_t largoTopico = strlen(topico);
+  p[0] = 0x30;
+  size_t n = 1 + escribirLargoRestante(p + 1, (uint32_t)(2 + largoTopico + largo));
+  n += escribirTexto(p + n, topico, largoTopico);
+  memcpy(p + n, datos, largo);
+  return n + largo;
+}
+
+static const uint8_t DISCONNECT[] = {0xE0, 0};
+static const uint8_t PINGREQ[] = {0xC0, 0};
+
+// ====== Mensajes del Dispositivo de Testeo ======
+// Como los escribe ArduinoJson: hasta 9 decimales, sin ceros al final
+static const char* decimal(char* destino, size_t tamano, double valor) {
+  int n = snprintf(destino, tamano, "%.9f", valor);
+  while (n > 1 && destino[n - 1] == '0') destino[--n] = '\0';
+  if (n > 1 && destino[n - 1] == '.') destino[--n] = '\0';
+  return destino;
+}
+
+static const char* booleano(bool valor) {
+  return valor ? "true" : "false";
+}
+
+enum TipoTopico : uint8_t {
+  TOPICO_PEDIDOS,
+  TOPICO_UBICACION,
+  TOPICO_INFO,
+  CANTIDAD_TOPICOS
+};
+
+// Lo que el suscriptor necesita para medir la latencia de un mensaje
+struct Envio {
+  uint32_t timestamp;  // el del JSON (millis() del equipo)
+  uint64_t creadoUs;
+};
+
+// ====== Equipos virtuales ======
+enum EstadoEquipo : uint8_t {
+  EQUIPO_ESPERANDO,       // sin conexión hasta proximoIntentoMs
+  EQUIPO_CONECTANDO,      // TCP en curso
+  EQUIPO_ESPERA_CONNACK,
+  EQUIPO_ACTIVO
+};
+
+// Lo que se armó y el socket todavía no aceptó; la BandejaMQTT escribe acá
+class SalidaEquipo : public SalidaMQTT {
+ public:
+  SalidaEquipo() : inicio(0), fin(0) {}
+
+  bool escribir(const uint8_t* datos, size_t largo) override {
+    if (fin + largo > sizeof(buffer) && inicio > 0) {
+      memmove(buffer, buffer + inicio, fin - inicio);
+      fin -= inicio;
+      inicio = 0;
+    }
+    if (fin + largo > sizeof(buffer)) return false;
+    memcpy(buffer + fin, datos, largo);
+    fin += largo;
+    return true;
+  }
+
+  // Manda lo que acepte el socket; false si el socket falló
+  bool vaciar(int fd) {
+    while (inicio < fin) {
+      ssize_t n = send(fd, buffer + inicio, fin - inicio, MSG_NOSIGNAL);
+      if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+      inicio += (size_t)n;
+    }
+    inicio = 0;
+    fin = 0;
+    return true;
+  }
+
+  void descartar() {
+    inicio = 0;
+    fin = 0;
+  }
+
+ private:
+  uint8_t buffer[TAMANO_SALIDA];
+  size_t inicio;
+  size_t fin;
+};
+
+struct Equipo {
+  Equipo(uint32_t indice, double latBase, double lonBase)
+      : indice(indice), fd(-1), estado(EQUIPO_ESPERANDO), proximoIntentoMs(0), inicioConexionUs(0),
+        espera(CONFIG_REINTENTOS), leidosConnack(0), conectadoAntes(false), simulador(latBase, lonBase),
+        arranqueMs(0), proximaMuestraUs(0), ultimoPuntoMapeo(0), ultimaUbicacion(0), ultimoDiagnostico(0),
+        contadorCalles(0), fuenteEscenario(textoEscenario.data(), textoEscenario.size()), escenario(fuenteEscenario),
+        muestras(0), conFix(true), brokerCaido(false), escenarioTerminado(false), atrasoMaxUs(0), colaMax(0),
+        descartados(0), bandeja(ConfigBandeja{opciones.ventana}) {
+    snprintf(id, sizeof(id), "%s%05u", opciones.prefijo, (unsigned)indice);
+    snprintf(topicoUbicacion, sizeof(topicoUbicacion), "logistica/ubicacion/%s", id);
+    snprintf(topicoInfo, sizeof(topicoInfo), "logistica/info/%s", id);
+    calle[0] = '\0';
+    // Como gpsSimulado en el setup(): hay posición antes de la primera muestra
+    gps = simulador.muestra(0);
+    tiempoGps = 0;
+    if (opciones.escenario != nullptr) {
+      MuestraEscenario m;
+      escenario.muestra(0, m);
+      gps = {m.lat, m.lon, m.rumbo, m.velocidad, m.satelites};
+    }
+  }
+
+  uint32_t indice;
+  char id[24];
+  char topicoUbicacion[64];
+  char topicoInfo[64];
+
+  // Conexión
+  int fd;
+  EstadoEquipo estado;
+  uint32_t proximoIntentoMs;
+  uint64_t inicioConexionUs;
+  EsperaReintentos espera;
+  uint8_t connack[4];
+  uint8_t leidosConnack;
+  bool conectadoAntes;
+
+  // Simulación (los tiempos del equipo son millis() desde arranqueMs)
+  SimuladorGPS simulador;
+  MuestraSimulada gps;
+  uint32_t tiempoGps;
+  uint32_t arranqueMs;
+  uint64_t proximaMuestraUs;
+  uint32_t ultimoPuntoMapeo;
+  uint32_t ultimaUbicacion;
+  uint32_t ultimoDiagnostico;
+  uint16_t contadorCalles;
+  char calle[16];
+
+  // Escenario (con --escenario los tiempos del equipo son el reloj virtual)
+  FuenteEscenarioMemoria fuenteEscenario;
+  EscenarioGPS escenario;
+  uint32_t muestras;
+  bool conFix;
+  bool brokerCaido;
+  bool escenarioTerminado;
+
+  // Para el diagnóstico
+  uint32_t atrasoMaxUs;
+  uint16_t colaMax;
+  uint32_t descartados;
+
+  BandejaMQTTFija<TAMANO_BANDEJA> bandeja;
+  SalidaEquipo salida;
+  // Productor: el hilo del equipo; consumidor: el suscriptor
+  ColaSPSCFija<Envio, ENVIOS_POR_TOPICO> envios[CANTIDAD_TOPICOS];
+};
+
+static std::vector<Equipo*> equipos;
+
+// ====== Hilos de equipos ======
+struct EstadisticasHilo {
+  std::atomic<uint32_t> conectados;
+  std::atomic<uint64_t> armados;
+  std::atomic<uint64_t> descartados;   // no entraban en la bandeja o en la salida
+  std::atomic<uint64_t> omitidos;      // ubicaciones con la bandeja saturada
+  std::atomic<uint64_t> confirmados;   // QoS 1 con PUBACK
+  std::atomic<uint64_t> enviadosQoS0;
+  std::atomic<uint32_t> fallidas;      // conexiones que no llegaron al CONNACK
+  std::atomic<uint32_t> caidas;        // conexiones activas que se cortaron
+  std::atomic<uint32_t> cortes;        // cerradas por "broker caido" del escenario
+  std::atomic<uint32_t> terminados;    // equipos que llegaron al final del escenario
+
+  // Solo los lee el hilo principal después del join
+  HistogramaLatencia conexionUs;       // connect() -> CONNACK
+  uint32_t primerasConexiones;
+  uint64_t primerIntentoUs;
+  uint64_t ultimaPrimeraConexionUs;
+  uint64_t sinRegistro;                // mensajes sin lugar para anotar la latencia
+};
+
+struct Hilo {
+  std::vector<Equipo*> equipos;
+  int epoll;
+  uint32_t azar;
+  EstadisticasHilo est;
+  std::thread hilo;
+};
+
+static sockaddr_storage direccionBroker;
+static socklen_t largoDireccionBroker = 0;
+static std::atomic<bool> terminar(false);
+
+// BandejaMQTT avisa cada PUBACK a una función sin contexto
+static thread_local EstadisticasHilo* estadisticasHilo = nullptr;
+static void contarConfirmacion(uint32_t marca) {
+  estadisticasHilo->confirmados.fetch_add(1, std::memory_order_relaxed);
+}
+
+static uint32_t millisEquipo(const Equipo& e, uint32_t ahora) {
+  if (opciones.escenario != nullptr) {
+    return e.muestras * INTERVALO_SIMULACION_MS;
+  }
+  return ahora - e.arranqueMs;
+}
+
+// El período real de muestreo: más corto con "acelerar" en el escenario
+static uint64_t periodoMuestreoUs(const Equipo& e) {
+  uint32_t factor = 1;
+  if (opciones.escenario != nullptr && !e.escenarioTerminado) {
+    factor = e.escenario.aceleracion() < ACELERACION_MAXIMA ? e.escenario.aceleracion() : ACELERACION_MAXIMA;
+  }
+  return INTERVALO_SIMULACION_MS * 1000ULL / factor;
+}
+
+static void anotarEnvio(Hilo& h, Equipo& e, TipoTopico tipo, uint32_t timestamp) {
+  Envio* r = e.envios[tipo].reservar();
+  if (r == nullptr) {
+    h.est.sinRegistro++;
+    return;
+  }
+  r->timestamp = timestamp;
+  r->creadoUs = ahoraUs();
+  e.envios[tipo].publicar();
+}
+
+// El registro se anota antes de que el mensaje pueda llegar al suscriptor
+static void publicarQoS1(Hilo& h, Equipo& e, TipoTopico tipo, const char* topico, const char* datos, int largo,
+                         uint32_t timestamp) {
+  h.est.armados.fetch_add(1, std::memory_order_relaxed);
+  if (largo <= 0 || (size_t)largo >= TAMANO_MENSAJE ||
+      !e.bandeja.encolar(topico, (const uint8_t*)datos, (size_t)largo, timestamp)) {
+    e.descartados++;
+    h.est.descartados.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  anotarEnvio(h, e, tipo, timestamp);
+  if (e.bandeja.mensajes() > e.colaMax) e.colaMax = e.bandeja.mensajes();
+}
+
+static void publicarQoS0(Hilo& h, Equipo& e, TipoTopico tipo, const char* topico, const char* datos, int largo,
+                         uint32_t timestamp) {
+  h.est.armados.fetch_add(1, std::memory_order_relaxed);
+  uint8_t paquete[TAMANO_MENSAJE + 96];
+  if (largo <= 0 || (size_t)largo >= TAMANO_MENSAJE) {
+    e.descartados++;
+    h.est.descartados.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  anotarEnvio(h, e, tipo, timestamp);
+  if (!e.salida.escribir(paquete, armarPublishQoS0(paquete, topico, datos, (size_t)largo))) {
+    e.descartados++;
+    h.est.descartados.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  h.est.enviadosQoS0.fetch_add(1, std::memory_order_relaxed);
+}
+
+// enviarPuntoAMQTT
+static void enviarPunto(Hilo& h, Equipo& e, uint32_t millis) {
+  char datos[TAMANO_MENSAJE], lat[24], lon[24], velocidad[24], rumbo[24];
+  int n = snprintf(datos, sizeof(datos),
+                   "{\"id\":\"%s\",\"tipo\":\"punto\",\"lat\":%s,\"lon\":%s,\"velocidad\":%s,\"satelites\":%d,"
+                   "\"tiempo\":%u,\"rumbo\":%s,\"device_id\":\"%s\",\"precision_baja\":%s,\"timestamp\":%u}",
+                   e.calle, decimal(lat, sizeof(lat), e.gps.lat), decimal(lon, sizeof(lon), e.gps.lon),
+                   decimal(velocidad, sizeof(velocidad), e.gps.velocidad), e.gps.satelites, (unsigned)e.tiempoGps,
+                   decimal(rumbo, sizeof(rumbo), e.gps.rumbo), e.id, booleano(e.gps.satelites < 4),
+                   (unsigned)millis);
+  publicarQoS1(h, e, TOPICO_PEDIDOS, "logistica/pedidos", datos, n, millis);
+}
+
+// enviarInicioMapeoMQTT
+static void enviarInicio(Hilo& h, Equipo& e, uint32_t millis) {
+  char datos[TAMANO_MENSAJE], lat[24], lon[24];
+  int n = snprintf(datos, sizeof(datos),
+                   "{\"id\":\"%s\",\"tipo\":\"inicio\",\"lat\":%s,\"lon\":%s,\"satelites\":%d,\"tiempo\":%u,"
+                   "\"device_id\":\"%s\",\"precision_baja\":%s,\"timestamp\":%u}",
+                   e.calle, decimal(lat, sizeof(lat), e.gps.lat), decimal(lon, sizeof(lon), e.gps.lon),
+                   e.gps.satelites, (unsigned)e.tiempoGps, e.id, booleano(e.gps.satelites < 4), (unsigned)millis);
+  publicarQoS1(h, e, TOPICO_PEDIDOS, "logistica/pedidos", datos, n, millis);
+}
+
+// enviarFinMapeoMQTT
+static void enviarFin(Hilo& h, Equipo& e, uint32_t millis) {
+  char datos[TAMANO_MENSAJE];
+  int n = snprintf(datos, sizeof(datos), "{\"id\":\"%s\",\"tipo\":\"fin\",\"device_id\":\"%s\",\"timestamp\":%u}",
+                   e.calle, e.id, (unsigned)millis);
+  publicarQoS1(h, e, TOPICO_PEDIDOS, "logistica/pedidos", datos, n, millis);
+}
+
+// publicarGPS
+static void enviarUbicacion(Hilo& h, Equipo& e, uint32_t millis) {
+  char datos[TAMANO_MENSAJE], lat[24], lon[24], velocidad[24];
+  int n = snprintf(datos, sizeof(datos),
+                   "{\"device_id\":\"%s\",\"latitud\":%s,\"longitud\":%s,\"satelites\":%d,\"velocidad_kmh\":%s,"
+                   "\"precision_baja\":%s,\"timestamp\":%u}",
+                   e.id, decimal(lat, sizeof(lat), e.gps.lat), decimal(lon, sizeof(lon), e.gps.lon), e.gps.satelites,
+                   decimal(velocidad, sizeof(velocidad), e.gps.velocidad), booleano(e.gps.satelites < 4),
+                   (unsigned)millis);
+  publicarQoS1(h, e, TOPICO_UBICACION, e.topicoUbicacion, datos, n, millis);
+}
+
+// publicarDiagnostico; la cola de salida del equipo virtual es su bandeja
+static void enviarDiagnostico(Hilo& h, Equipo& e, uint32_t millis) {
+  char datos[TAMANO_MENSAJE];
+  int n = snprintf(datos, sizeof(datos),
+                   "{\"device_id\":\"%s\",\"estado_wifi\":\"Conectado\",\"estado_mqtt\":\"Conectado\","
+                   "\"estado_gps\":\"%s\",\"satelites_gps\":%d,\"cola_salida\":%u,\"cola_salida_max\":%u,"
+                   "\"cola_salida_descartados\":%u,\"atraso_muestreo_max_us\":%u,\"timestamp\":%u}",
+                   e.id, e.conFix ? "Simulado" : "Sin fix", e.gps.satelites, (unsigned)e.bandeja.mensajes(),
+                   (unsigned)e.colaMax,
+                   (unsigned)e.descartados, (unsigned)e.atrasoMaxUs, (unsigned)millis);
+  publicarQoS0(h, e, TOPICO_INFO, e.topicoInfo, datos, n, millis);
+}
+
+// iniciarMapeo
+static void iniciarMapeo(Hilo& h, Equipo& e, uint32_t millis) {
+  e.contadorCalles++;
+  snprintf(e.calle, sizeof(e.calle), "CALLE_%u", (unsigned)e.contadorCalles);
+  enviarInicio(h, e, millis);
+}
+
+static void cerrar(Equipo& e) {
+  if (e.fd >= 0) close(e.fd);  // también lo saca del epoll
+  e.fd = -1;
+  e.salida.descartar();
+  e.leidosConnack = 0;
+}
+
+// Como reconectarMQTT con el broker caído del escenario: DISCONNECT y sin
+// reintentos hasta que vuelva
+static void cortarConexion(Hilo& h, Equipo& e) {
+  if (e.estado == EQUIPO_ACTIVO) {
+    e.salida.escribir(DISCONNECT, sizeof(DISCONNECT));
+    e.salida.vaciar(e.fd);
+    h.est.conectados.fetch_sub(1, std::memory_order_relaxed);
+  }
+  h.est.cortes.fetch_add(1, std::memory_order_relaxed);
+  cerrar(e);
+  e.bandeja.nuevaConexion();
+  e.estado = EQUIPO_ESPERANDO;
+  e.proximoIntentoMs = 0;
+}
+
+// La muestra del escenario en el reloj virtual; al terminar, detenerMapeo
+static void muestrearEscenario(Hilo& h, Equipo& e, uint32_t millis) {
+  MuestraEscenario m;
+  if (!e.escenario.muestra(millis, m)) {
+    e.escenarioTerminado = true;
+    e.conFix = true;
+    e.brokerCaido = false;
+    h.est.terminados.fetch_add(1, std::memory_order_relaxed);
+    if (e.estado == EQUIPO_ACTIVO) enviarFin(h, e, millis);
+    return;
+  }
+  e.gps = {m.lat, m.lon, m.rumbo, m.velocidad, m.satelites};
+  e.conFix = m.conFix;
+  e.brokerCaido = m.brokerCaido;
+  if (e.brokerCaido && e.estado != EQUIPO_ESPERANDO) cortarConexion(h, e);
+}
+
+// Una vuelta de tareaMuestreo: simularDatosGPS, procesarDatosGPS y los
+// envíos periódicos. Sin conexión el firmware tampoco publica
+static void muestrear(Hilo& h, Equipo& e, uint64_t us) {
+  uint32_t atraso = (uint32_t)(us - e.proximaMuestraUs);
+  if (atraso > e.atrasoMaxUs) e.atrasoMaxUs = atraso;
+  e.proximaMuestraUs += periodoMuestreoUs(e);
+
+  e.muestras++;
+  uint32_t millis = millisEquipo(e, (uint32_t)(us / 1000));
+  if (opciones.escenario == nullptr) {
+    e.gps = e.simulador.muestra(millis);
+  } else if (!e.escenarioTerminado) {
+    muestrearEscenario(h, e, millis);
+  }
+  e.tiempoGps = millis;
+  if (e.estado != EQUIPO_ACTIVO) {
+    return;
+  }
+
+  // Sin fix o con el escenario terminado no hay mapeo
+  bool mapeando = e.conFix && !e.escenarioTerminado;
+  if (mapeando && e.simulador.giro(e.gps)) {
+    enviarFin(h, e, millis);
+    iniciarMapeo(h, e, millis);
+  }
+  if (mapeando && millis - e.ultimoPuntoMapeo > INTERVALO_PUNTO_MAPEO_MS) {
+    enviarPunto(h, e, millis);
+    e.ultimoPuntoMapeo = millis;
+  }
+  if (millis - e.ultimoDiagnostico >= opciones.intervaloDiagnosticoMs) {
+    enviarDiagnostico(h, e, millis);
+    e.ultimoDiagnostico = millis;
+  }
+  if (mapeando && millis - e.ultimaUbicacion >= opciones.intervaloUbicacionMs) {
+    // Como el firmware: la ubicación se vuelve a mandar en el próximo período
+    if (e.bandeja.saturada()) {
+      h.est.omitidos.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      enviarUbicacion(h, e, millis);
+    }
+    e.ultimaUbicacion = millis;
+  }
+}
+
+static void fallar(Hilo& h, Equipo& e, uint32_t ahora) {
+  if (e.estado == EQUIPO_ACTIVO) {
+    h.est.caidas.fetch_add(1, std::memory_order_relaxed);
+    h.est.conectados.fetch_sub(1, std::memory_order_relaxed);
+  } else {
+    h.est.fallidas.fetch_add(1, std::memory_order_relaxed);
+  }
+  cerrar(e);
+  // Lo que estaba en vuelo se reenvía con DUP en la conexión siguiente
+  e.bandeja.nuevaConexion();
+  e.estado = EQUIPO_ESPERANDO;
+  e.proximoIntentoMs = ahora + e.espera.fallo(rand_r(&h.azar));
+}
+
+static void iniciarConexion(Hilo& h, Equipo& e, uint32_t ahora) {
+  e.inicioConexionUs = ahoraUs();
+  if (h.est.primerIntentoUs == 0) h.est.primerIntentoUs = e.inicioConexionUs;
+  e.fd = socket(direccionBroker.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (e.fd < 0) {
+    fallar(h, e, ahora);
+    return;
+  }
+  int uno = 1;
+  setsockopt(e.fd, IPPROTO_TCP, TCP_NODELAY, &uno, sizeof(uno));
+  if (connect(e.fd, (const sockaddr*)&direccionBroker, largoDireccionBroker) < 0 && errno != EINPROGRESS) {
+    fallar(h, e, ahora);
+    return;
+  }
+  epoll_event ev = {};
+  ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+  ev.data.ptr = &e;
+  if (epoll_ctl(h.epoll, EPOLL_CTL_ADD, e.fd, &ev) < 0) {
+    fallar(h, e, ahora);
+    return;
+  }
+  e.estado = EQUIPO_CONECTANDO;
+}
+
+static void conectado(Hilo& h, Equipo& e, uint32_t ahora) {
+  uint64_t us = ahoraUs();
+  e.estado = EQUIPO_ACTIVO;
+  e.espera.exito();
+  h.est.conectados.fetch_add(1, std::memory_order_relaxed);
+  h.est.conexionUs.registrar((uint32_t)(us - e.inicioConexionUs));
+  if (!e.conectadoAntes) {
+    e.conectadoAntes = true;
+    h.est.primerasConexiones++;
+    h.est.ultimaPrimeraConexionUs = us;
+    iniciarMapeo(h, e, millisEquipo(e, ahora));
+  }
+}
+
+// false si el equipo perdió la conexión
+static bool leer(Hilo& h, Equipo& e, uint32_t ahora) {
+  uint8_t entrada[2048];
+  for (;;) {
+    ssize_t n = recv(e.fd, entrada, sizeof(entrada), 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      fallar(h, e, ahora);
+      return false;
+    }
+    if (n < 0) return true;
+    ssize_t i = 0;
+    while (e.estado == EQUIPO_ESPERA_CONNACK && i < n) {
+      e.connack[e.leidosConnack++] = entrada[i++];
+      if (e.leidosConnack < sizeof(e.connack)) continue;
+      if (e.connack[0] != 0x20 || e.connack[3] != 0) {
+        fallar(h, e, ahora);
+        return false;
+      }
+      conectado(h, e, ahora);
+    }
+    for (; i < n; i++) e.bandeja.recibir(entrada[i], ahora);
+  }
+}
+
+static void atenderEvento(Hilo& h, Equipo& e, uint32_t eventos, uint32_t ahora) {
+  // Evento de un socket que ya se cerró en esta misma vuelta
+  if (e.estado == EQUIPO_ESPERANDO) {
+    return;
+  }
+  if (e.estado == EQUIPO_CONECTANDO) {
+    int error = 0;
+    socklen_t largo = sizeof(error);
+    if (getsockopt(e.fd, SOL_SOCKET, SO_ERROR, &error, &largo) < 0 || error != 0) {
+      fallar(h, e, ahora);
+      return;
+    }
+    uint8_t paquete[64];
+    e.salida.escribir(paquete, armarConnect(paquete, e.id));
+    e.estado = EQUIPO_ESPERA_CONNACK;
+  }
+  if ((eventos & EPOLLIN) && !leer(h, e, ahora)) {
+    return;
+  }
+  if (eventos & (EPOLLERR | EPOLLHUP)) {
+    fallar(h, e, ahora);
+    return;
+  }
+  // Con PUBACK nuevos hay lugar en la ventana
+  if (e.estado == EQUIPO_ACTIVO) e.bandeja.enviar(e.salida, ahora);
+  if (!e.salida.vaciar(e.fd)) fallar(h, e, ahora);
+}
+
+static void correrHilo(Hilo* h) {
+  estadisticasHilo = &h->est;
+  // Los tiempos de cada equipo se cargaron relativos al arranque del hilo
+  uint64_t inicioUs = ahoraUs();
+  for (Equipo* e : h->equipos) {
+    e->bandeja.alConfirmar(contarConfirmacion);
+    e->proximaMuestraUs += inicioUs;
+    e->proximoIntentoMs += (uint32_t)(inicioUs / 1000);
+  }
+
+  epoll_event eventos[256];
+  while (!terminar.load(std::memory_order_relaxed)) {
+    int n = epoll_wait(h->epoll, eventos, 256, 5);
+    uint32_t ahora = ahoraMs();
+    for (int i = 0; i < n; i++) {
+      atenderEvento(*h, *(Equipo*)eventos[i].data.ptr, eventos[i].events, ahora);
+    }
+
+    uint64_t us = ahoraUs();
+    ahora = (uint32_t)(us / 1000);
+    for (Equipo* e : h->equipos) {
+      if (e->estado == EQUIPO_ESPERANDO && !e->brokerCaido && (int32_t)(ahora - e->proximoIntentoMs) >= 0) {
+        iniciarConexion(*h, *e, ahora);
+      } else if ((e->estado == EQUIPO_CONECTANDO || e->estado == EQUIPO_ESPERA_CONNACK) &&
+                 us - e->inicioConexionUs > ESPERA_CONEXION_MS * 1000ULL) {
+        fallar(*h, *e, ahora);
+      }
+      if (us >= e->proximaMuestraUs) {
+        muestrear(*h, *e, us);
+        if (e->estado == EQUIPO_ACTIVO) {
+          e->bandeja.enviar(e->salida, ahora);
+          if (!e->salida.vaciar(e->fd)) fallar(*h, *e, ahora);
+        }
+      }
+    }
+  }
+
+  for (Equipo* e : h->equipos) {
+    if (e->estado == EQUIPO_ACTIVO) {
+      e->salida.escribir(DISCONNECT, sizeof(DISCONNECT));
+      e->salida.vaciar(e->fd);
+    }
+    cerrar(*e);
+  }
+}
+
+// ====== Suscriptor ======
+struct EstadisticasSuscriptor {
+  std::atomic<uint64_t> recibidos;
+  uint64_t perdidos;      // anotados que el broker no entregó
+  uint64_t sinEnvio;      // del prefijo pero sin registro (repetidos o sin lugar al anotar)
+  uint64_t ajenos;        // de otros equipos
+  HistogramaLatencia latenciaUs;
+};
+static EstadisticasSuscriptor suscriptor;
+static std::atomic<bool> terminarSuscriptor(false);
+
+static const char* buscar(const char* datos, size_t largo, const char* clave) {
+  const char* p = (const char*)memmem(datos, largo, clave, strlen(clave));
+  return p ? p + strlen(clave) : nullptr;
+}
+
+static bool empiezaCon(const char* texto, size_t largo, const char* prefijo) {
+  size_t largoPrefijo = strlen(prefijo);
+  return largo >= largoPrefijo && memcmp(texto, prefijo, largoPrefijo) == 0;
+}
+
+static void recibirPublicacion(const char* topico, size_t largoTopico, const char* datos, size_t largo) {
+  uint64_t us = ahoraUs();
+  TipoTopico tipo;
+  if (empiezaCon(topico, largoTopico, "logistica/pedidos")) tipo = TOPICO_PEDIDOS;
+  else if (empiezaCon(topico, largoTopico, "logistica/ubicacion/")) tipo = TOPICO_UBICACION;
+  else if (empiezaCon(topico, largoTopico, "logistica/info/")) tipo = TOPICO_INFO;
+  else return;
+
+  // Los campos terminan antes del final del payload, así que strtoul no se pasa
+  const char* id = buscar(datos, largo, "\"device_id\":\"");
+  const char* marca = buscar(datos, largo, "\"timestamp\":");
+  size_t largoPrefijo = strlen(opciones.prefijo);
+  if (id == nullptr || marca == nullptr || (size_t)(datos + largo - id) < largoPrefijo ||
+      memcmp(id, opciones.prefijo, largoPrefijo) != 0) {
+    suscriptor.ajenos++;
+    return;
+  }
+  unsigned long indice = strtoul(id + largoPrefijo, nullptr, 10);
+  if (indice >= equipos.size()) {
+    suscriptor.ajenos++;
+    return;
+  }
+  uint32_t timestamp = (uint32_t)strtoul(marca, nullptr, 10);
+  suscriptor.recibidos.fetch_add(1, std::memory_order_relaxed);
+
+  // Los anteriores al recibido no van a llegar
+  ColaSPSCFija<Envio, ENVIOS_POR_TOPICO>& envios = equipos[indice]->envios[tipo];
+  const Envio* r;
+  while ((r = envios.frente()) != nullptr && (int32_t)(r->timestamp - timestamp) < 0) {
+    envios.liberar();
+    suscriptor.perdidos++;
+  }
+  if (r == nullptr || r->timestamp != timestamp) {
+    suscriptor.sinEnvio++;
+    return;
+  }
+  suscriptor.latenciaUs.registrar((uint32_t)(us - r->creadoUs));
+  envios.liberar();
+}
+
+static bool escribirTodo(int fd, const uint8_t* datos, size_t largo) {
+  while (largo > 0) {
+    ssize_t n = send(fd, datos, largo, MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    datos += n;
+    largo -= (size_t)n;
+  }
+  return true;
+}
+
+static int conectarSuscriptor() {
+  int fd = socket(direccionBroker.ss_family, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  if (connect(fd, (const sockaddr*)&direccionBroker, largoDireccionBroker) < 0) {
+    close(fd);
+    return -1;
+  }
+  // Para mirar terminarSuscriptor y mandar PINGREQ aunque no llegue nada
+  timeval espera = {0, 200000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &espera, sizeof(espera));
+
+  uint8_t p[256];
+  size_t n = armarConnect(p, "carga-flota-suscriptor");
+  // SUBSCRIBE id 1 a los tres tópicos con QoS 0
+  static const char* TOPICOS[] = {"logistica/pedidos", "logistica/ubicacion/+", "logistica/info/+"};
+  size_t largo = 2;
+  for (const char* t : TOPICOS) largo += 2 + strlen(t) + 1;
+  p[n++] = 0x82;
+  n += escribirLargoRestante(p + n, (uint32_t)largo);
+  p[n++] = 0;
+  p[n++] = 1;
+  for (const char* t : TOPICOS) {
+    n += escribirTexto(p + n, t, strlen(t));
+    p[n++] = 0;
+  }
+  if (!escribirTodo(fd, p, n)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Arma los paquetes del broker; 'listo' pasa a true con el SUBACK
+static void correrSuscriptor(int fd, std::atomic<bool>* listo) {
+  std::vector<uint8_t> buffer;
+  uint8_t entrada[16384];
+  uint32_t ultimoPing = ahoraMs();
+  while (!terminarSuscriptor.load(std::memory_order_relaxed)) {
+    if (ahoraMs() - ultimoPing > KEEPALIVE_S * 500U) {
+      escribirTodo(fd, PINGREQ, sizeof(PINGREQ));
+      ultimoPing = ahoraMs();
+    }
+    ssize_t n = recv(fd, entrada, sizeof(entrada), 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      fprintf(stderr, "El broker cerró la conexión del suscriptor\n");
+      break;
+    }
+    if (n < 0) continue;
+    buffer.insert(buffer.end(), entrada, entrada + n);
+
+    size_t posicion = 0;
+    for (;;) {
+      // Cabecera fija: tipo y largo restante de 1 a 4 bytes
+      size_t disponible = buffer.size() - posicion;
+      uint32_t restante = 0;
+      size_t cabecera = 1;
+      bool completo = false;
+      for (uint32_t multiplicador = 1; cabecera < disponible && cabecera <= 4; multiplicador *= 128) {
+        uint8_t b = buffer[posicion + cabecera++];
+        restante += (b & 0x7F) * multiplicador;
+        if ((b & 0x80) == 0) {
+          completo = true;
+          break;
+        }
+      }
+      if (!completo || disponible < cabecera + restante) break;
+
+      const uint8_t* paquete = buffer.data() + posicion + cabecera;
+      uint8_t tipo = buffer[posicion] >> 4;
+      if (tipo == 3 && restante >= 2) {
+        size_t largoTopico = ((size_t)paquete[0] << 8) | paquete[1];
+        size_t inicioDatos = 2 + largoTopico + (((buffer[posicion] >> 1) & 3) ? 2 : 0);
+        if (inicioDatos <= restante) {
+          recibirPublicacion((const char*)paquete + 2, largoTopico, (const char*)paquete + inicioDatos,
+                             restante - inicioDatos);
+        }
+      } else if (tipo == 9) {
+        listo->store(true);
+      }
+      posicion += cabecera + restante;
+    }
+    buffer.erase(buffer.begin(), buffer.begin() + posicion);
+  }
+  escribirTodo(fd, DISCONNECT, sizeof(DISCONNECT));
+  close(fd);
+}
+
+// ====== Reporte ======
+static uint64_t sumar(const std::vector<Hilo*>& hilos, std::atomic<uint64_t> EstadisticasHilo::*campo) {
+  uint64_t total = 0;
+  for (Hilo* h : hilos) total += (h->est.*campo).load(std::memory_order_relaxed);
+  return total;
+}
+
+static uint32_t sumar(const std::vector<Hilo*>& hilos, std::atomic<uint32_t> EstadisticasHilo::*campo) {
+  uint32_t total = 0;
+  for (Hilo* h : hilos) total += (h->est.*campo).load(std::memory_order_relaxed);
+  return total;
+}
+
+static uint64_t publicados(const std::vector<Hilo*>& hilos) {
+  return sumar(hilos, &EstadisticasHilo::confirmados) + sumar(hilos, &EstadisticasHilo::enviadosQoS0);
+}
+
+static void imprimirPercentiles(const char* titulo, const HistogramaLatencia& h) {
+  printf("%s: p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, máx %.1f ms (%u muestras)\n", titulo, h.percentil(50) / 1000.0,
+         h.percentil(90) / 1000.0, h.percentil(99) / 1000.0, h.maximo() / 1000.0, (unsigned)h.cantidad());
+}
+
+static bool resolverBroker() {
+  addrinfo pista = {};
+  pista.ai_family = AF_UNSPEC;
+  pista.ai_socktype = SOCK_STREAM;
+  addrinfo* direcciones = nullptr;
+  std::string textoPuerto = std::to_string(opciones.puerto);
+  if (getaddrinfo(opciones.host, textoPuerto.c_str(), &pista, &direcciones) != 0 || direcciones == nullptr) {
+    return false;
+  }
+  memcpy(&direccionBroker, direcciones->ai_addr, direcciones->ai_addrlen);
+  largoDireccionBroker = direcciones->ai_addrlen;
+  freeaddrinfo(direcciones);
+  return true;
+}
+
+// Se lee una vez y se revisa entero antes de arrancar
+static bool cargarEscenario() {
+  FILE* f = fopen(opciones.escenario, "rb");
+  if (f == nullptr) {
+    fprintf(stderr, "No se pudo abrir %s\n", opciones.escenario);
+    return false;
+  }
+  char bloque[4096];
+  size_t n;
+  while ((n = fread(bloque, 1, sizeof(bloque), f)) > 0) textoEscenario.append(bloque, n);
+  fclose(f);
+
+  FuenteEscenarioMemoria fuente(textoEscenario.data(), textoEscenario.size());
+  EscenarioGPS escenario(fuente);
+  MuestraEscenario m;
+  uint32_t ms = 0;
+  while (escenario.muestra(ms, m)) ms += INTERVALO_SIMULACION_MS;
+  const EstadisticasEscenario& est = escenario.estadisticas();
+  printf("Escenario %s: %u s, x%u, %u puntos, %u comandos", opciones.escenario, (unsigned)(ms / 1000),
+         (unsigned)escenario.aceleracion(), (unsigned)est.puntos, (unsigned)est.comandos);
+  if (est.errores > 0) {
+    printf(", %u líneas con error (la primera es la %u)", (unsigned)est.errores, (unsigned)est.primeraConError);
+  }
+  printf("\n");
+  return true;
+}
+
+// Un descriptor por equipo, más el epoll de cada hilo y el suscriptor
+static void subirLimiteDescriptores() {
+  rlimit limite;
+  if (getrlimit(RLIMIT_NOFILE, &limite) != 0) return;
+  limite.rlim_cur = limite.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limite);
+  if (limite.rlim_cur < opciones.equipos + opciones.hilos + 16) {
+    fprintf(stderr, "⚠️ Límite de descriptores %lu para %u equipos: subirlo con ulimit -n\n",
+            (unsigned long)limite.rlim_cur, (unsigned)opciones.equipos);
+  }
+}
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool hayValor = i + 1 < argc;
+    if (a == "--host" && hayValor) opciones.host = argv[++i];
+    else if (a == "--puerto" && hayValor) opciones.puerto = atoi(argv[++i]);
+    else if (a == "--equipos" && hayValor) opciones.equipos = (uint32_t)atoi(argv[++i]);
+    else if (a == "--hilos" && hayValor) opciones.hilos = (uint32_t)atoi(argv[++i]);
+    else if (a == "--segundos" && hayValor) opciones.segundos = (uint32_t)atoi(argv[++i]);
+    else if (a == "--conexiones-seg" && hayValor) opciones.conexionesSeg = (uint32_t)atoi(argv[++i]);
+    else if (a == "--ventana" && hayValor) opciones.ventana = (uint8_t)atoi(argv[++i]);
+    else if (a == "--intervalo-ubicacion" && hayValor) opciones.intervaloUbicacionMs = (uint32_t)atoi(argv[++i]);
+    else if (a == "--intervalo-diagnostico" && hayValor) opciones.intervaloDiagnosticoMs = (uint32_t)atoi(argv[++i]);
+    else if (a == "--prefijo" && hayValor) opciones.prefijo = argv[++i];
+    else if (a == "--escenario" && hayValor) opciones.escenario = argv[++i];
+    else {
+      fprintf(stderr,
+              "Uso: %s [--host h] [--puerto p] [--equipos n] [--hilos n] [--segundos s] [--conexiones-seg n]\n"
+              "          [--ventana 1..%u] [--intervalo-ubicacion ms] [--intervalo-diagnostico ms] [--prefijo p]\n"
+              "          [--escenario archivo]\n",
+              argv[0], BANDEJA_MAX_VENTANA);
+      return 1;
+    }
+  }
+  if (opciones.hilos == 0) opciones.hilos = std::thread::hardware_concurrency();
+  if (opciones.hilos == 0) opciones.hilos = 4;
+  if (opciones.equipos == 0 || opciones.equipos > 99999 || opciones.ventana < 1 ||
+      opciones.ventana > BANDEJA_MAX_VENTANA) {
+    fprintf(stderr, "Equipos entre 1 y 99999, ventana entre 1 y %u\n", BANDEJA_MAX_VENTANA);
+    return 1;
+  }
+  if (opciones.escenario != nullptr && !cargarEscenario()) {
+    return 1;
+  }
+  if (!resolverBroker()) {
+    fprintf(stderr, "No se pudo resolver %s\n", opciones.host);
+    return 1;
+  }
+  subirLimiteDescriptores();
+
+  // Equipos: punto base a hasta ~5 km del original, reloj ya andando, la
+  // muestra en cualquier momento del segundo y la primera conexión según
+  // --conexiones-seg; se reparten en orden entre los hilos
+  std::vector<Hilo*> hilos;
+  for (uint32_t i = 0; i < opciones.hilos; i++) {
+    Hilo* h = new Hilo();
+    h->epoll = epoll_create1(0);
+    h->azar = 0x9E3779B9u * (i + 1);
+    h->est.primerIntentoUs = 0;
+    h->est.ultimaPrimeraConexionUs = 0;
+    h->est.primerasConexiones = 0;
+    h->est.sinRegistro = 0;
+    hilos.push_back(h);
+  }
+  uint32_t ahora = ahoraMs();
+  uint32_t azar = 12345;
+  for (uint32_t i = 0; i < opciones.equipos; i++) {
+    double latBase = LAT_BASE + (rand_r(&azar) % 1001 - 500) * 0.0001;
+    double lonBase = LON_BASE + (rand_r(&azar) % 1001 - 500) * 0.0001;
+    Equipo* e = new Equipo(i, latBase, lonBase);
+    e->arranqueMs = ahora - (uint32_t)(rand_r(&azar) % 3600000);
+    e->proximaMuestraUs = (uint64_t)(rand_r(&azar) % INTERVALO_SIMULACION_MS) * 1000;
+    e->proximoIntentoMs = opciones.conexionesSeg ? (uint32_t)((uint64_t)i * 1000 / opciones.conexionesSeg) : 0;
+    equipos.push_back(e);
+    hilos[i % opciones.hilos]->equipos.push_back(e);
+  }
+
+  int fdSuscriptor = conectarSuscriptor();
+  if (fdSuscriptor < 0) {
+    fprintf(stderr, "No se pudo conectar a %s:%d\n", opciones.host, opciones.puerto);
+    return 1;
+  }
+  std::atomic<bool> suscripto(false);
+  std::thread hiloSuscriptor(correrSuscriptor, fdSuscriptor, &suscripto);
+  for (int i = 0; i < 50 && !suscripto.load(); i++) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  if (!suscripto.load()) {
+    fprintf(stderr, "El broker no confirmó la suscripción\n");
+    terminarSuscriptor = true;
+    hiloSuscriptor.join();
+    return 1;
+  }
+
+  printf("%u equipos en %u hilos contra %s:%d durante %u s\n", (unsigned)opciones.equipos, (unsigned)opciones.hilos,
+         opciones.host, opciones.puerto, (unsigned)opciones.segundos);
+  uint64_t inicioUs = ahoraUs();
+  for (Hilo* h : hilos) h->hilo = std::thread(correrHilo, h);
+
+  printf("   seg  conectados  publicados/s  recibidos/s  caídas\n");
+  uint64_t publicadosAntes = 0;
+  uint64_t recibidosAntes = 0;
+  for (uint32_t s = 5; s <= opciones.segundos; s += 5) {
+    int64_t falta = (int64_t)(inicioUs + s * 1000000ULL) - (int64_t)ahoraUs();
+    if (falta > 0) std::this_thread::sleep_for(std::chrono::microseconds(falta));
+    uint64_t p = publicados(hilos);
+    uint64_t r = suscriptor.recibidos.load(std::memory_order_relaxed);
+    printf("%6u  %10u  %12.0f  %11.0f  %6u\n", (unsigned)s, (unsigned)sumar(hilos, &EstadisticasHilo::conectados),
+           (p - publicadosAntes) / 5.0, (r - recibidosAntes) / 5.0, (unsigned)sumar(hilos, &EstadisticasHilo::caidas));
+    fflush(stdout);
+    publicadosAntes = p;
+    recibidosAntes = r;
+  }
+  double segundos = (ahoraUs() - inicioUs) / 1e6;
+  terminar = true;
+  for (Hilo* h : hilos) h->hilo.join();
+  // Lo que todavía viaja por el broker
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  terminarSuscriptor = true;
+  hiloSuscriptor.join();
+
+  // ====== Resumen ======
+  HistogramaLatencia conexiones;
+  uint32_t primeras = 0;
+  uint64_t primerIntento = UINT64_MAX;
+  uint64_t ultimaPrimera = 0;
+  uint64_t sinRegistro = 0;
+  for (Hilo* h : hilos) {
+    conexiones.sumar(h->est.conexionUs);
+    primeras += h->est.primerasConexiones;
+    if (h->est.primerIntentoUs != 0 && h->est.primerIntentoUs < primerIntento) primerIntento = h->est.primerIntentoUs;
+    if (h->est.ultimaPrimeraConexionUs > ultimaPrimera) ultimaPrimera = h->est.ultimaPrimeraConexionUs;
+    sinRegistro += h->est.sinRegistro;
+  }
+  double segundosConexion = primeras > 0 ? (ultimaPrimera - primerIntento) / 1e6 : 0;
+  printf("\nConexiones: %u de %u equipos en %.2f s (%.0f/s); %u fallidas, %u caídas\n", (unsigned)primeras,
+         (unsigned)opciones.equipos, segundosConexion, segundosConexion > 0 ? primeras / segundosConexion : 0.0,
+         (unsigned)sumar(hilos, &EstadisticasHilo::fallidas), (unsigned)sumar(hilos, &EstadisticasHilo::caidas));
+  imprimirPercentiles("CONNACK", conexiones);
+  uint64_t total = publicados(hilos);
+  printf("Mensajes: %llu armados, %llu descartados, %llu ubicaciones omitidas\n",
+         (unsigned long long)sumar(hilos, &EstadisticasHilo::armados),
+         (unsigned long long)sumar(hilos, &EstadisticasHilo::descartados),
+         (unsigned long long)sumar(hilos, &EstadisticasHilo::omitidos));
+  printf("Publicados: %llu (%.0f msgs/s): %llu QoS 1 confirmados, %llu QoS 0\n", (unsigned long long)total,
+         total / segundos, (unsigned long long)sumar(hilos, &EstadisticasHilo::confirmados),
+         (unsigned long long)sumar(hilos, &EstadisticasHilo::enviadosQoS0));
+  uint64_t recibidos = suscriptor.recibidos.load();
+  printf("Recibidos: %llu (%.0f msgs/s), %llu perdidos, %llu sin registro, %llu de otros equipos\n",
+         (unsigned long long)recibidos, recibidos / segundos, (unsigned long long)suscriptor.perdidos,
+         (unsigned long long)(suscriptor.sinEnvio + sinRegistro), (unsigned long long)suscriptor.ajenos);
+  imprimirPercentiles("Latencia armado -> recepción", suscriptor.latenciaUs);
+  if (opciones.escenario != nullptr) {
+    printf("Escenario: %u de %u equipos lo terminaron, %u conexiones cortadas por el guion\n",
+           (unsigned)sumar(hilos, &EstadisticasHilo::terminados), (unsigned)opciones.equipos,
+           (unsigned)sumar(hilos, &EstadisticasHilo::cortes));
+  }
+  return 0;
+}
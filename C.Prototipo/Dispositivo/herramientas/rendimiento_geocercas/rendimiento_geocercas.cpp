@@ -0,0 +1,265 @@
+// ====== Rendimiento de las geocercas ======
+// Arma conjuntos de zonas al azar (mitad círculos, mitad polígonos) sobre un
+// área del tamaño de una ciudad, los carga con el mismo texto que llega por
+// MQTT y mide cuántos fixes por segundo evalúa lib/Geocercas con su grilla
+// contra probar todas las zonas una por una, para cada cantidad de zonas.
+//
+// Compilar desde esta carpeta (una sola línea):
+//   g++ -O2 -std=c++11 -I../../lib/Geocercas -I../../lib/Geodesia
+//       rendimiento_geocercas.cpp ../../lib/Geocercas/*.cpp
+//       ../../lib/Geodesia/Geodesia.cpp -o rendimiento_geocercas
+//
+// Uso:
+//   ./rendimiento_geocercas [--zonas 10,100,1000,5000] [--fixes n]
+//                           [--area grados] [--semilla s]
+//
+// Dos recorridos por conjunto: un camión a 50 km/h con un fix por segundo
+// (cambia poco de celda, el caso normal) y fixes en lugares al azar (cambia
+// de celda en cada fix, el peor caso). El almacén es la RAM de la PC: en el
+// ESP8266 pesan las lecturas por fix, que salen de LittleFS; la fuerza bruta
+// acá tiene además todos los vértices en memoria, cosa que en el dispositivo
+// no entra.
+
+#include <Geocercas.h>
+#include <Geodesia.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Mismas tablas que src/main.cpp
+typedef GeocercasFija<1024, 512> GeocercasFirmware;
+static const ConfigGeocercas CONFIG_GEOCERCAS = {30, 2, 3, 300000};
+
+static const int32_t LAT_CENTRO_E6 = -31420000;
+static const int32_t LON_CENTRO_E6 = -64190000;
+
+struct Zona {
+  RegistroZona registro;
+  std::vector<int32_t> vertices;
+};
+
+struct Resultado {
+  double fixesPorSegundo;
+  double lecturasPorFix;
+  double dentroPorFix;
+};
+
+static double segundosDesde(std::chrono::steady_clock::time_point inicio) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+}
+
+static void sinAviso(EventoGeocerca, uint32_t, uint32_t) {}
+
+// Zonas al azar y el texto de carga que les corresponde
+static void generar(uint32_t cantidad, int32_t medioAreaE6, std::mt19937& azar, std::vector<Zona>& zonas,
+                    std::string& texto) {
+  std::uniform_int_distribution<int32_t> posicion(-medioAreaE6, medioAreaE6);
+  std::uniform_int_distribution<uint32_t> radio(30, 300);
+  char linea[640];
+  zonas.clear();
+  texto = "inicio 1\n";
+  for (uint32_t i = 0; i < cantidad; i++) {
+    Zona z;
+    memset(&z.registro, 0, sizeof(z.registro));
+    z.registro.id = i + 1;
+    int32_t lat = LAT_CENTRO_E6 + posicion(azar);
+    int32_t lon = LON_CENTRO_E6 + posicion(azar);
+    z.registro.cosLatQ15 = cosenoQ15(lat / 1e6);
+    if (i % 2 == 0) {
+      uint32_t r = radio(azar);
+      z.registro.tipo = ZONA_CIRCULO;
+      z.registro.latE6 = lat;
+      z.registro.lonE6 = lon;
+      z.registro.radioCm = r * 100;
+      snprintf(linea, sizeof(linea), "c %u %.6f %.6f %u\n", z.registro.id, lat / 1e6, lon / 1e6, r);
+    } else {
+      // Manzana irregular de 8 a 16 vértices alrededor de (lat, lon)
+      std::uniform_int_distribution<int> lados(8, 16);
+      std::uniform_int_distribution<int32_t> alcance(800, 2500);
+      int n = lados(azar);
+      int largo = snprintf(linea, sizeof(linea), "p %u", z.registro.id);
+      z.registro.tipo = ZONA_POLIGONO;
+      z.registro.vertices = (uint8_t)n;
+      for (int k = 0; k < n; k++) {
+        double angulo = 2 * M_PI * k / n;
+        int32_t d = alcance(azar);
+        int32_t vLat = lat + (int32_t)(d * sin(angulo));
+        int32_t vLon = lon + (int32_t)(d * cos(angulo));
+        z.vertices.push_back(vLat);
+        z.vertices.push_back(vLon);
+        largo += snprintf(linea + largo, sizeof(linea) - largo, " %.6f %.6f", vLat / 1e6, vLon / 1e6);
+      }
+      snprintf(linea + largo, sizeof(linea) - largo, "\n");
+    }
+    // Caja para el descarte rápido de la fuerza bruta
+    RegistroZona& r = z.registro;
+    if (r.tipo == ZONA_CIRCULO) {
+      int32_t dLat = (int32_t)(r.radioCm / 11.1195) + 1;
+      int32_t dLon = (int32_t)(dLat * 32768.0 / r.cosLatQ15) + 1;
+      r.latMinE6 = lat - dLat;
+      r.latMaxE6 = lat + dLat;
+      r.lonMinE6 = lon - dLon;
+      r.lonMaxE6 = lon + dLon;
+    } else {
+      r.latMinE6 = r.latMaxE6 = z.vertices[0];
+      r.lonMinE6 = r.lonMaxE6 = z.vertices[1];
+      for (size_t k = 2; k < z.vertices.size(); k += 2) {
+        r.latMinE6 = std::min(r.latMinE6, z.vertices[k]);
+        r.latMaxE6 = std::max(r.latMaxE6, z.vertices[k]);
+        r.lonMinE6 = std::min(r.lonMinE6, z.vertices[k + 1]);
+        r.lonMaxE6 = std::max(r.lonMaxE6, z.vertices[k + 1]);
+      }
+    }
+    zonas.push_back(z);
+    texto += linea;
+  }
+  snprintf(linea, sizeof(linea), "fin 1 %u\n", cantidad);
+  texto += linea;
+}
+
+// Fixes de un recorrido: en camión (continuo) o al azar
+static void recorrido(uint32_t fixes, bool continuo, int32_t medioAreaE6, std::mt19937& azar,
+                      std::vector<int32_t>& puntos) {
+  std::uniform_int_distribution<int32_t> posicion(-medioAreaE6, medioAreaE6);
+  std::normal_distribution<double> giro(0.0, 0.15);
+  puntos.clear();
+  double lat = LAT_CENTRO_E6, lon = LON_CENTRO_E6, rumbo = 0;
+  const double pasoE6 = 14.0 * 8.9932;  // 14 m por fix
+  for (uint32_t i = 0; i < fixes; i++) {
+    if (continuo) {
+      rumbo += giro(azar);
+      lat += pasoE6 * cos(rumbo);
+      lon += pasoE6 * sin(rumbo) / 0.853;
+      // Rebota en el borde del área
+      if (fabs(lat - LAT_CENTRO_E6) > medioAreaE6 || fabs(lon - LON_CENTRO_E6) > medioAreaE6) rumbo += M_PI;
+      puntos.push_back((int32_t)lat);
+      puntos.push_back((int32_t)lon);
+    } else {
+      puntos.push_back(LAT_CENTRO_E6 + posicion(azar));
+      puntos.push_back(LON_CENTRO_E6 + posicion(azar));
+    }
+  }
+}
+
+static Resultado medirGrilla(Geocercas& g, const std::vector<int32_t>& puntos) {
+  EstadisticasGeocercas antes = g.estadisticas();
+  size_t n = puntos.size() / 2;
+  auto inicio = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; i++) g.evaluar(puntos[2 * i], puntos[2 * i + 1], (uint32_t)(i * 1000), sinAviso);
+  double s = segundosDesde(inicio);
+  const EstadisticasGeocercas& despues = g.estadisticas();
+  Resultado r;
+  r.fixesPorSegundo = n / s;
+  r.lecturasPorFix = (double)(despues.lecturas - antes.lecturas) / n;
+  r.dentroPorFix = 0;
+  return r;
+}
+
+static Resultado medirFuerzaBruta(const std::vector<Zona>& zonas, const std::vector<int32_t>& puntos) {
+  size_t n = puntos.size() / 2;
+  uint64_t dentro = 0;
+  auto inicio = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; i++) {
+    int32_t lat = puntos[2 * i], lon = puntos[2 * i + 1];
+    for (const Zona& z : zonas) {
+      const RegistroZona& r = z.registro;
+      if (lat < r.latMinE6 || lat > r.latMaxE6 || lon < r.lonMinE6 || lon > r.lonMaxE6) continue;
+      if (Geocercas::contiene(r, z.vertices.data(), lat, lon, 0)) dentro++;
+    }
+  }
+  double s = segundosDesde(inicio);
+  Resultado r;
+  r.fixesPorSegundo = n / s;
+  r.lecturasPorFix = 0;
+  r.dentroPorFix = (double)dentro / n;
+  return r;
+}
+
+static std::vector<uint32_t> leerLista(const char* texto) {
+  std::vector<uint32_t> valores;
+  const char* p = texto;
+  while (*p) {
+    char* fin;
+    unsigned long v = strtoul(p, &fin, 10);
+    if (fin == p) break;
+    valores.push_back((uint32_t)v);
+    p = *fin == ',' ? fin + 1 : fin;
+  }
+  return valores;
+}
+
+int main(int argc, char** argv) {
+  std::vector<uint32_t> cantidades = {10, 100, 1000, 5000};
+  uint32_t fixes = 200000;
+  double areaGrados = 0.4;
+  uint32_t semilla = 1;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--zonas") && i + 1 < argc) {
+      cantidades = leerLista(argv[++i]);
+    } else if (!strcmp(argv[i], "--fixes") && i + 1 < argc) {
+      fixes = (uint32_t)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--area") && i + 1 < argc) {
+      areaGrados = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--semilla") && i + 1 < argc) {
+      semilla = (uint32_t)atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "Uso: %s [--zonas 10,100,1000,5000] [--fixes n] [--area grados] [--semilla s]\n", argv[0]);
+      return 1;
+    }
+  }
+  int32_t medioAreaE6 = (int32_t)(areaGrados * 1e6 / 2);
+
+  // Los tres archivos del almacén en RAM; el más grande es el compilado
+  const size_t capacidad = 4 * 1024 * 1024;
+  std::vector<uint8_t> buffers(GEOCERCAS_ARCHIVOS * capacidad);
+
+  printf("%u fixes por recorrido, área de %.2f grados, tablas de %u celdas y %u refs\n", fixes, areaGrados, 1024,
+         512);
+  printf("  zonas  recorrido   grilla fix/s  lect/fix  cand.max   bruta fix/s  zonas/fix   flash KB  compilar ms\n");
+  for (uint32_t cantidad : cantidades) {
+    std::mt19937 azar(semilla);
+    std::vector<Zona> zonas;
+    std::string texto;
+    generar(cantidad, medioAreaE6, azar, zonas, texto);
+
+    AlmacenGeocercasMemoria almacen(buffers.data(), capacidad);
+    std::unique_ptr<GeocercasFirmware> geocercas(new GeocercasFirmware(almacen, CONFIG_GEOCERCAS));
+    GeocercasFirmware& g = *geocercas;
+    ResultadoCarga r = g.recibir(texto.data(), texto.size());
+    if (r != CARGA_COMPLETA) {
+      fprintf(stderr, "%u zonas: carga %s\n", cantidad, Geocercas::descripcion(r));
+      continue;
+    }
+    auto inicio = std::chrono::steady_clock::now();
+    while ((r = g.avanzarCompilacion(64)) == CARGA_EN_CURSO) {
+    }
+    double compilarMs = segundosDesde(inicio) * 1000;
+    if (r != CARGA_COMPLETA) {
+      fprintf(stderr, "%u zonas: compilación %s\n", cantidad, Geocercas::descripcion(r));
+      continue;
+    }
+
+    for (int continuo = 1; continuo >= 0; continuo--) {
+      std::vector<int32_t> puntos;
+      recorrido(fixes, continuo != 0, medioAreaE6, azar, puntos);
+      Resultado grilla = medirGrilla(g, puntos);
+      Resultado bruta = medirFuerzaBruta(zonas, puntos);
+      printf("%7u  %-9s %14.0f %9.2f %9u %13.0f %10.3f %10.1f %12.1f\n", cantidad, continuo ? "camión" : "al azar",
+             grilla.fixesPorSegundo, grilla.lecturasPorFix, g.estadisticas().candidatosMax, bruta.fixesPorSegundo,
+             bruta.dentroPorFix, almacen.tamano(GEOCERCAS_ACTIVAS) / 1024.0, compilarMs);
+    }
+    if (g.estadisticas().truncados > 0) {
+      printf("         %u celdas con más de %u zonas: se miraron solo las primeras\n", g.estadisticas().truncados,
+             GEOCERCAS_MAX_CANDIDATOS);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,317 @@
+// ====== Rendimiento del grafo de calles ======
+// Arma una cuadrícula de calles con manzanas de ~100 m (nodos corridos al
+// azar unos metros, como en una ciudad real), la carga con el mismo texto
+// que llega por MQTT y mide, para cada cantidad de tramos, cuántos fixes
+// por segundo empareja lib/GrafoCalles contra buscar el tramo más cercano
+// entre todos, cuánta flash ocupa cada 1000 tramos y cuánto tarda en
+// aplicar un 10% de cambios sobre la versión en uso.
+//
+// Compilar desde esta carpeta (una sola línea):
+//   g++ -O2 -std=c++11 -I../../lib/GrafoCalles -I../../lib/Geocercas
+//       -I../../lib/Geodesia rendimiento_grafo_calles.cpp
+//       ../../lib/GrafoCalles/GrafoCalles.cpp ../../lib/Geocercas/*.cpp
+//       ../../lib/Geodesia/Geodesia.cpp -o rendimiento_grafo_calles
+//
+// Uso:
+//   ./rendimiento_grafo_calles [--tramos 1000,5000,20000] [--fixes n]
+//                              [--ruido metros] [--semilla s]
+//
+// El recorrido es un camión a 50 km/h con un fix por segundo que va de
+// esquina en esquina eligiendo al azar por dónde seguir, con ruido gaussiano
+// en la posición y el rumbo. "tramo ok" es la fracción de fixes emparejados
+// con el tramo por el que iba el camión; "conocida" la de fixes en los que el
+// firmware no subiría el punto. El almacén es la RAM de la PC: en el ESP8266
+// pesan las lecturas por fix, que salen de LittleFS.
+//
+// Con 1024 celdas, de ~10000 tramos para arriba las celdas pasan de
+// GRAFO_MAX_CANDIDATOS tramos y el emparejamiento empeora: el backend tiene
+// que mandar el grafo de la zona de operación del camión, no el de la ciudad.
+
+#include <GrafoCalles.h>
+#include <Geodesia.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Mismas tablas y configuración que src/main.cpp
+typedef GrafoCallesFija<1024, 512> GrafoFirmware;
+static const ConfigGrafoCalles CONFIG_GRAFO = {20, 35, 3, 4, 8};
+
+static const int32_t LAT_ORIGEN_E6 = -31440000;
+static const int32_t LON_ORIGEN_E6 = -64220000;
+static const int32_t MANZANA_E6 = 900;  // ~100 m de latitud
+static const double MICROGRADOS_POR_M = 8.9932;
+
+struct Ciudad {
+  uint32_t lado;                    // nodos por lado
+  std::vector<int32_t> nodos;       // lat, lon de cada nodo
+  std::vector<RegistroTramo> tramos;
+  // Tramo entre dos nodos vecinos: horizontales y después verticales
+  uint32_t tramoEste(uint32_t f, uint32_t c) const { return f * (lado - 1) + c; }
+  uint32_t tramoNorte(uint32_t f, uint32_t c) const { return lado * (lado - 1) + c * (lado - 1) + f; }
+};
+
+static double segundosDesde(std::chrono::steady_clock::time_point inicio) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+}
+
+// Cuadrícula con al menos 'cantidad' tramos; los IDs salen en orden
+static void generar(uint32_t cantidad, std::mt19937& azar, Ciudad& ciudad) {
+  uint32_t lado = 2;
+  while (2 * lado * (lado - 1) < cantidad) lado++;
+  ciudad.lado = lado;
+  std::uniform_int_distribution<int32_t> corrimiento(-90, 90);  // ±10 m
+  ciudad.nodos.resize(2 * lado * lado);
+  for (uint32_t f = 0; f < lado; f++) {
+    for (uint32_t c = 0; c < lado; c++) {
+      ciudad.nodos[2 * (f * lado + c)] = LAT_ORIGEN_E6 + (int32_t)f * MANZANA_E6 + corrimiento(azar);
+      ciudad.nodos[2 * (f * lado + c) + 1] = LON_ORIGEN_E6 + (int32_t)c * 1055 + corrimiento(azar);
+    }
+  }
+  ciudad.tramos.clear();
+  auto agregar = [&](uint32_t a, uint32_t b) {
+    RegistroTramo t;
+    t.id = (uint32_t)ciudad.tramos.size() + 1;
+    t.lat0E6 = ciudad.nodos[2 * a];
+    t.lon0E6 = ciudad.nodos[2 * a + 1];
+    t.lat1E6 = ciudad.nodos[2 * b];
+    t.lon1E6 = ciudad.nodos[2 * b + 1];
+    ciudad.tramos.push_back(t);
+  };
+  for (uint32_t f = 0; f < lado; f++) {
+    for (uint32_t c = 0; c + 1 < lado; c++) agregar(f * lado + c, f * lado + c + 1);
+  }
+  for (uint32_t c = 0; c < lado; c++) {
+    for (uint32_t f = 0; f + 1 < lado; f++) agregar(f * lado + c, (f + 1) * lado + c);
+  }
+}
+
+static void lineaTramo(std::string& texto, char marca, const RegistroTramo& t) {
+  char linea[96];
+  snprintf(linea, sizeof(linea), "%c %u %.6f %.6f %.6f %.6f\n", marca, t.id, t.lat0E6 / 1e6, t.lon0E6 / 1e6,
+           t.lat1E6 / 1e6, t.lon1E6 / 1e6);
+  texto += linea;
+}
+
+static void textoCompleto(const Ciudad& ciudad, std::string& texto) {
+  char linea[64];
+  texto = "inicio 1\n";
+  for (const RegistroTramo& t : ciudad.tramos) lineaTramo(texto, 't', t);
+  snprintf(linea, sizeof(linea), "fin 1 %u\n", (unsigned)ciudad.tramos.size());
+  texto += linea;
+}
+
+// Uno de cada diez tramos se corre 1 m al norte; 'ciudad' queda como la
+// versión 2
+static void textoCambios(Ciudad& ciudad, std::string& texto) {
+  char linea[64];
+  texto = "inicio 2 1\n";
+  uint32_t lineas = 0;
+  for (size_t i = 0; i < ciudad.tramos.size(); i += 10) {
+    RegistroTramo& t = ciudad.tramos[i];
+    t.lat0E6 += 9;
+    t.lat1E6 += 9;
+    lineaTramo(texto, 't', t);
+    lineas++;
+  }
+  snprintf(linea, sizeof(linea), "fin 2 %u\n", lineas);
+  texto += linea;
+}
+
+struct Fix {
+  int32_t latE6, lonE6;
+  float rumbo;
+  uint32_t tramo;  // por el que va el camión
+};
+
+// De esquina en esquina a 14 m por fix, con ruido en la posición y el rumbo
+static void recorrido(const Ciudad& ciudad, uint32_t fixes, double ruidoM, std::mt19937& azar,
+                      std::vector<Fix>& puntos) {
+  std::normal_distribution<double> ruido(0.0, ruidoM);
+  std::normal_distribution<double> ruidoRumbo(0.0, 5.0);
+  std::uniform_int_distribution<int> direccion(0, 3);
+  const int DF[4] = {0, 1, 0, -1}, DC[4] = {1, 0, -1, 0};
+  int32_t lado = (int32_t)ciudad.lado;
+  int32_t f = lado / 2, c = lado / 2;
+  puntos.clear();
+  while (puntos.size() < fixes) {
+    int d;
+    int32_t nf, nc;
+    do {
+      d = direccion(azar);
+      nf = f + DF[d];
+      nc = c + DC[d];
+    } while (nf < 0 || nc < 0 || nf >= lado || nc >= lado);
+    uint32_t tramo = d == 0 ? ciudad.tramoEste(f, c) : d == 2 ? ciudad.tramoEste(f, nc)
+                   : d == 1 ? ciudad.tramoNorte(f, c) : ciudad.tramoNorte(nf, c);
+    double lat0 = ciudad.nodos[2 * (f * lado + c)], lon0 = ciudad.nodos[2 * (f * lado + c) + 1];
+    double lat1 = ciudad.nodos[2 * (nf * lado + nc)], lon1 = ciudad.nodos[2 * (nf * lado + nc) + 1];
+    double este = (lon1 - lon0) * 0.853, norte = lat1 - lat0;
+    double largoM = sqrt(este * este + norte * norte) / MICROGRADOS_POR_M;
+    double rumbo = atan2(este, norte) * 180.0 / M_PI;
+    if (rumbo < 0) rumbo += 360;
+    for (double s = 0; s < largoM && puntos.size() < fixes; s += 14.0) {
+      double u = s / largoM;
+      Fix p;
+      p.latE6 = (int32_t)(lat0 + u * (lat1 - lat0) + ruido(azar) * MICROGRADOS_POR_M);
+      p.lonE6 = (int32_t)(lon0 + u * (lon1 - lon0) + ruido(azar) * MICROGRADOS_POR_M / 0.853);
+      p.rumbo = (float)fmod(rumbo + ruidoRumbo(azar) + 360.0, 360.0);
+      p.tramo = tramo + 1;
+      puntos.push_back(p);
+    }
+    f = nf;
+    c = nc;
+  }
+}
+
+struct Resultado {
+  double fixesPorSegundo;
+  double lecturasPorFix;
+  double tramoOk;
+  double conocida;
+};
+
+static Resultado medirGrilla(GrafoCalles& g, const std::vector<Fix>& puntos) {
+  g.reiniciar();
+  EstadisticasGrafo antes = g.estadisticas();
+  size_t n = puntos.size();
+  uint64_t ok = 0, conocida = 0;
+  auto inicio = std::chrono::steady_clock::now();
+  for (const Fix& p : puntos) {
+    g.emparejar(p.latE6, p.lonE6, p.rumbo, 50);
+    if (g.enConocida()) {
+      conocida++;
+      if (g.tramoActual() == p.tramo) ok++;
+    }
+  }
+  double s = segundosDesde(inicio);
+  Resultado r;
+  r.fixesPorSegundo = n / s;
+  r.lecturasPorFix = (double)(g.estadisticas().lecturas - antes.lecturas) / n;
+  r.tramoOk = (double)ok / n;
+  r.conocida = (double)conocida / n;
+  return r;
+}
+
+// El más cercano a menos del radio entre todos los tramos, sin rumbo
+static Resultado medirFuerzaBruta(const Ciudad& ciudad, const std::vector<Fix>& puntos) {
+  size_t n = puntos.size();
+  uint64_t ok = 0;
+  auto inicio = std::chrono::steady_clock::now();
+  for (const Fix& p : puntos) {
+    uint16_t cosLat = cosenoQ15(p.latE6 / 1e6);
+    uint32_t mejor = 0;
+    float mejorD = 0;
+    for (const RegistroTramo& t : ciudad.tramos) {
+      float d = GrafoCalles::distanciaM(t, p.latE6, p.lonE6, cosLat);
+      if (d <= CONFIG_GRAFO.radioM && (mejor == 0 || d < mejorD)) {
+        mejor = t.id;
+        mejorD = d;
+      }
+    }
+    if (mejor == p.tramo) ok++;
+  }
+  double s = segundosDesde(inicio);
+  Resultado r;
+  r.fixesPorSegundo = n / s;
+  r.lecturasPorFix = 0;
+  r.tramoOk = (double)ok / n;
+  r.conocida = 0;
+  return r;
+}
+
+static double compilar(GrafoCalles& g, const std::string& texto, const char* que) {
+  ResultadoCarga r = g.recibir(texto.data(), texto.size());
+  if (r != CARGA_COMPLETA) {
+    fprintf(stderr, "%s: carga %s\n", que, Geocercas::descripcion(r));
+    return -1;
+  }
+  auto inicio = std::chrono::steady_clock::now();
+  while ((r = g.avanzarCompilacion(64)) == CARGA_EN_CURSO) {
+  }
+  if (r != CARGA_COMPLETA) {
+    fprintf(stderr, "%s: compilación %s\n", que, Geocercas::descripcion(r));
+    return -1;
+  }
+  return segundosDesde(inicio) * 1000;
+}
+
+static std::vector<uint32_t> leerLista(const char* texto) {
+  std::vector<uint32_t> valores;
+  const char* p = texto;
+  while (*p) {
+    char* fin;
+    unsigned long v = strtoul(p, &fin, 10);
+    if (fin == p) break;
+    valores.push_back((uint32_t)v);
+    p = *fin == ',' ? fin + 1 : fin;
+  }
+  return valores;
+}
+
+int main(int argc, char** argv) {
+  std::vector<uint32_t> cantidades = {1000, 5000, 20000};
+  uint32_t fixes = 100000;
+  double ruidoM = 4.0;
+  uint32_t semilla = 1;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--tramos") && i + 1 < argc) {
+      cantidades = leerLista(argv[++i]);
+    } else if (!strcmp(argv[i], "--fixes") && i + 1 < argc) {
+      fixes = (uint32_t)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--ruido") && i + 1 < argc) {
+      ruidoM = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--semilla") && i + 1 < argc) {
+      semilla = (uint32_t)atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "Uso: %s [--tramos 1000,5000,20000] [--fixes n] [--ruido metros] [--semilla s]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  const size_t capacidad = 4 * 1024 * 1024;
+  std::vector<uint8_t> buffers(GEOCERCAS_ARCHIVOS * capacidad);
+
+  printf("%u fixes, ruido %.1f m, radio %u m, tablas de %u celdas y %u refs, %u bytes de RAM\n", fixes, ruidoM,
+         CONFIG_GRAFO.radioM, 1024, 512, (unsigned)sizeof(GrafoFirmware));
+  printf(" tramos   grilla fix/s  lect/fix  cand.max  tramo ok  conocida   bruta fix/s  tramo ok"
+         "   bytes/1000   compilar ms  cambios ms\n");
+  for (uint32_t cantidad : cantidades) {
+    std::mt19937 azar(semilla);
+    Ciudad ciudad;
+    generar(cantidad, azar, ciudad);
+    std::string texto;
+    textoCompleto(ciudad, texto);
+
+    AlmacenGeocercasMemoria almacen(buffers.data(), capacidad);
+    std::unique_ptr<GrafoFirmware> grafo(new GrafoFirmware(almacen, CONFIG_GRAFO));
+    GrafoFirmware& g = *grafo;
+    double compilarMs = compilar(g, texto, "completa");
+    if (compilarMs < 0) continue;
+    double bytesPorMil = almacen.tamano(GEOCERCAS_ACTIVAS) * 1000.0 / g.tramos();
+
+    textoCambios(ciudad, texto);
+    double cambiosMs = compilar(g, texto, "cambios");
+    if (cambiosMs < 0) continue;
+
+    std::vector<Fix> puntos;
+    recorrido(ciudad, fixes, ruidoM, azar, puntos);
+    Resultado grilla = medirGrilla(g, puntos);
+    Resultado bruta = medirFuerzaBruta(ciudad, puntos);
+    printf("%7u %14.0f %9.3f %9u %9.3f %9.3f %13.0f %9.3f %12.0f %13.1f %11.1f\n", g.tramos(),
+           grilla.fixesPorSegundo, grilla.lecturasPorFix, g.estadisticas().candidatosMax, grilla.tramoOk,
+           grilla.conocida, bruta.fixesPorSegundo, bruta.tramoOk, bytesPorMil, compilarMs, cambiosMs);
+    if (g.estadisticas().truncados > 0) {
+      printf("        %u celdas con más de %u tramos: se miraron solo los primeros\n", g.estadisticas().truncados,
+             GRAFO_MAX_CANDIDATOS);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,212 @@
+// ====== Rendimiento de la bandeja MQTT QoS 1 ======
+// Publica mensajes del tamaño de los del firmware contra un broker MQTT local
+// con la misma BandejaMQTT que el ESP8266, para cada ventana pedida, y mide
+// cuántos mensajes por segundo quedan confirmados (PUBACK). Ventana 1 es
+// esperar cada PUBACK antes del siguiente PUBLISH.
+//
+// Compilar desde esta carpeta (una sola línea):
+//   g++ -O2 -std=c++11 -I../../lib/BandejaMQTT rendimiento_mqtt.cpp
+//       ../../lib/BandejaMQTT/BandejaMQTT.cpp -o rendimiento_mqtt
+//
+// Uso:
+//   ./rendimiento_mqtt [--host 127.0.0.1] [--puerto 1883] [--mensajes n]
+//                      [--tamano bytes] [--ventanas 1,2,4,8,16]
+//                      [--topico logistica/prueba]
+//
+// Sin TLS: mide el protocolo, no el cifrado. Con un broker en la misma PC el
+// ida y vuelta es de microsegundos y la ventana casi no pesa; para parecerse
+// a la red celular del camión se puede agregar demora a la interfaz local:
+//   sudo tc qdisc add dev lo root netem delay 50ms
+//   sudo tc qdisc del dev lo root
+
+#include <BandejaMQTT.h>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static uint32_t ahoraMs() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+class SalidaSocket : public SalidaMQTT {
+ public:
+  explicit SalidaSocket(int fd) : fd(fd) {}
+  bool escribir(const uint8_t* datos, size_t largo) override {
+    while (largo > 0) {
+      ssize_t n = send(fd, datos, largo, 0);
+      if (n <= 0) return false;
+      datos += n;
+      largo -= (size_t)n;
+    }
+    return true;
+  }
+
+ private:
+  int fd;
+};
+
+static int conectarTCP(const char* host, int puerto) {
+  addrinfo pista = {};
+  pista.ai_family = AF_UNSPEC;
+  pista.ai_socktype = SOCK_STREAM;
+  addrinfo* direcciones = nullptr;
+  std::string textoPuerto = std::to_string(puerto);
+  if (getaddrinfo(host, textoPuerto.c_str(), &pista, &direcciones) != 0) return -1;
+  int fd = -1;
+  for (addrinfo* a = direcciones; a != nullptr; a = a->ai_next) {
+    fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd < 0) continue;
+    if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(direcciones);
+  if (fd >= 0) {
+    // Como lwIP en el ESP8266 con setNoDelay: cada PUBLISH sale en su segmento
+    int uno = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &uno, sizeof(uno));
+  }
+  return fd;
+}
+
+// CONNECT de MQTT 3.1.1 con sesión limpia y espera del CONNACK
+static bool conectarMQTT(int fd, const char* clientId) {
+  size_t largoId = strlen(clientId);
+  std::vector<uint8_t> p = {0x10, 0, 0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, 0, 60,
+                            (uint8_t)(largoId >> 8), (uint8_t)largoId};
+  p.insert(p.end(), clientId, clientId + largoId);
+  p[1] = (uint8_t)(p.size() - 2);
+  SalidaSocket salida(fd);
+  if (!salida.escribir(p.data(), p.size())) return false;
+  uint8_t connack[4];
+  size_t leidos = 0;
+  while (leidos < sizeof(connack)) {
+    ssize_t n = recv(fd, connack + leidos, sizeof(connack) - leidos, 0);
+    if (n <= 0) return false;
+    leidos += (size_t)n;
+  }
+  return connack[0] == 0x20 && connack[3] == 0;
+}
+
+struct Resultado {
+  double segundos;
+  uint32_t confirmados;
+  uint32_t rttMedioMs;
+  uint32_t rttPeorMs;
+};
+
+static uint32_t confirmadosEnCorrida = 0;
+static void contarConfirmacion(uint32_t marca) {
+  confirmadosEnCorrida++;
+}
+
+static bool correr(const char* host, int puerto, const char* topico, uint32_t mensajes, size_t tamano, uint8_t ventana,
+                   Resultado& r) {
+  int fd = conectarTCP(host, puerto);
+  if (fd < 0) {
+    fprintf(stderr, "No se pudo conectar a %s:%d\n", host, puerto);
+    return false;
+  }
+  if (!conectarMQTT(fd, "rendimiento-mqtt")) {
+    fprintf(stderr, "El broker rechazó el CONNECT\n");
+    close(fd);
+    return false;
+  }
+
+  // Mismo tamaño que en el firmware
+  static uint8_t memoria[4096];
+  BandejaMQTT bandeja(memoria, sizeof(memoria), ConfigBandeja{ventana});
+  bandeja.alConfirmar(contarConfirmacion);
+  confirmadosEnCorrida = 0;
+
+  std::vector<uint8_t> carga(tamano, '0');
+  SalidaSocket salida(fd);
+  uint32_t encolados = 0;
+  uint8_t entrada[1024];
+  auto inicio = std::chrono::steady_clock::now();
+  while (confirmadosEnCorrida < mensajes) {
+    while (encolados < mensajes && bandeja.encolar(topico, carga.data(), carga.size(), encolados)) {
+      encolados++;
+    }
+    bandeja.enviar(salida, ahoraMs());
+    pollfd espera = {fd, POLLIN, 0};
+    if (poll(&espera, 1, 5000) <= 0) {
+      fprintf(stderr, "Sin respuesta del broker (%u confirmados)\n", confirmadosEnCorrida);
+      close(fd);
+      return false;
+    }
+    ssize_t n = recv(fd, entrada, sizeof(entrada), 0);
+    if (n <= 0) {
+      fprintf(stderr, "El broker cerró la conexión\n");
+      close(fd);
+      return false;
+    }
+    for (ssize_t i = 0; i < n; i++) bandeja.recibir(entrada[i], ahoraMs());
+  }
+  r.segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+  const EstadisticasBandeja& e = bandeja.estadisticas();
+  r.confirmados = e.confirmados;
+  r.rttMedioMs = e.confirmados ? e.rttTotalMs / e.confirmados : 0;
+  r.rttPeorMs = e.rttPeorMs;
+
+  static const uint8_t DISCONNECT[] = {0xE0, 0};
+  salida.escribir(DISCONNECT, sizeof(DISCONNECT));
+  close(fd);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const char* host = "127.0.0.1";
+  int puerto = 1883;
+  uint32_t mensajes = 2000;
+  size_t tamano = 200;  // una ubicación JSON con seq
+  std::string ventanas = "1,2,4,8,16";
+  const char* topico = "logistica/prueba";
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool hayValor = i + 1 < argc;
+    if (a == "--host" && hayValor) host = argv[++i];
+    else if (a == "--puerto" && hayValor) puerto = atoi(argv[++i]);
+    else if (a == "--mensajes" && hayValor) mensajes = (uint32_t)atoi(argv[++i]);
+    else if (a == "--tamano" && hayValor) tamano = (size_t)atoi(argv[++i]);
+    else if (a == "--ventanas" && hayValor) ventanas = argv[++i];
+    else if (a == "--topico" && hayValor) topico = argv[++i];
+    else {
+      fprintf(stderr, "Uso: %s [--host h] [--puerto p] [--mensajes n] [--tamano bytes] [--ventanas 1,2,4] [--topico t]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  printf("%u mensajes de %zu bytes a %s:%d\n", mensajes, tamano, host, puerto);
+  printf("ventana   msgs/s   rtt medio   rtt peor\n");
+  size_t desde = 0;
+  while (desde < ventanas.size()) {
+    size_t hasta = ventanas.find(',', desde);
+    if (hasta == std::string::npos) hasta = ventanas.size();
+    int ventana = atoi(ventanas.substr(desde, hasta - desde).c_str());
+    desde = hasta + 1;
+    if (ventana < 1 || ventana > BANDEJA_MAX_VENTANA) {
+      fprintf(stderr, "Ventana fuera de rango (1..%u): %d\n", BANDEJA_MAX_VENTANA, ventana);
+      return 1;
+    }
+    Resultado r;
+    if (!correr(host, puerto, topico, mensajes, tamano, (uint8_t)ventana, r)) return 1;
+    printf("%7d %8.0f %8u ms %8u ms\n", ventana, r.confirmados / r.segundos, r.rttMedioMs, r.rttPeorMs);
+  }
+  return 0;
+}
@@ -0,0 +1,268 @@
+// ====== Replay de trazas NMEA para el reporte por banda muerta ======
+// Pasa cada fix de las trazas por lib/BandaMuerta y, para cada umbral de
+// error, cuenta los mensajes de ubicación por hora de camión y el error que
+// vería el tablero en cada fix: la distancia entre el fix y la posición que
+// extrapola desde el último mensaje. Como referencia se mide el envío cada
+// INTERVALO_ENVIO_UBICACION con el tablero mostrando el último punto, que es
+// lo que hace el firmware sin la opción.
+//
+// Compilar desde esta carpeta (una sola línea):
+//   g++ -O2 -std=c++11 -I../../lib/FiltroNMEA -I../../lib/Geodesia
+//       -I../../lib/BandaMuerta replay_banda_muerta.cpp
+//       ../../lib/FiltroNMEA/*.cpp ../../lib/Geodesia/*.cpp
+//       ../../lib/BandaMuerta/*.cpp -o replay_banda_muerta
+//
+// Uso:
+//   ./replay_banda_muerta [--umbrales 10,25,50,100] [--silencio s]
+//                         [--vmin kmh] [--estacionado s] [--semilla n]
+//                         traza1.nmea [traza2.nmea ...]
+//
+// Las trazas son las mismas que lee replay_giros (RMC + GGA); con
+// "replay_giros --generar carpeta cantidad" se arma un corpus sintético de
+// manejo urbano. --estacionado s agrega al final de cada traza s segundos
+// detenido con el ruido de un receptor quieto, para ver cuántos mensajes
+// manda un camión estacionado; esos fixes se cuentan aparte.
+//
+// El error se mide contra los fixes, no contra la posición real: es lo que
+// el equipo conoce. Un salto de multipath cuenta como desvío y se publica.
+
+#include <FiltroNMEA.h>
+#include <Geodesia.h>
+#include <BandaMuerta.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+// Mismos valores que src/main.cpp
+static const uint32_t INTERVALO_ENVIO_UBICACION = 5000;
+static const ConfigBandaMuerta CONFIG_BANDA_MUERTA = {25.0f, 60000, 5.0f};
+
+struct Fix {
+  uint32_t tiempoMs;  // desde las 00:00 UTC
+  double lat;
+  double lon;
+  float velocidadKmh;
+  float rumbo;
+  bool estacionado;   // agregado por --estacionado
+};
+
+struct Traza {
+  std::string nombre;
+  std::vector<Fix> fixes;
+};
+
+// ====== Lectura NMEA ======
+static std::vector<std::string> campos(const std::string& linea) {
+  std::vector<std::string> salida;
+  std::string actual;
+  size_t fin = linea.rfind('*');
+  for (size_t i = 1; i < fin; i++) {
+    if (linea[i] == ',') {
+      salida.push_back(actual);
+      actual.clear();
+    } else {
+      actual += linea[i];
+    }
+  }
+  salida.push_back(actual);
+  return salida;
+}
+
+static double coordenada(const std::string& valor, const std::string& hemisferio) {
+  if (valor.empty()) return NAN;
+  double v = atof(valor.c_str());
+  int grados = (int)(v / 100);
+  double r = grados + (v - grados * 100) / 60.0;
+  return (hemisferio == "S" || hemisferio == "W") ? -r : r;
+}
+
+static uint32_t horaAMs(const std::string& hhmmss) {
+  double v = atof(hhmmss.c_str());
+  int h = (int)(v / 10000);
+  int m = ((int)(v / 100)) % 100;
+  double s = fmod(v, 100.0);
+  return (uint32_t)((h * 3600 + m * 60) * 1000 + s * 1000 + 0.5);
+}
+
+static bool leerTraza(const std::string& ruta, Traza& t) {
+  std::ifstream in(ruta, std::ios::binary);
+  if (!in) return false;
+  t.nombre = ruta;
+  std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  FiltroNMEA filtro;
+  for (char b : bytes) {
+    if (!filtro.procesar((uint8_t)b)) continue;
+    std::string linea(filtro.sentencia(), filtro.largo() - 2);
+    std::vector<std::string> c = campos(linea);
+    if (c[0].substr(2) == "RMC" && c.size() > 8 && c[2] == "A") {
+      Fix f;
+      f.tiempoMs = horaAMs(c[1]);
+      f.lat = coordenada(c[3], c[4]);
+      f.lon = coordenada(c[5], c[6]);
+      f.velocidadKmh = (float)(atof(c[7].c_str()) * 1.852);
+      f.rumbo = (float)atof(c[8].c_str());
+      f.estacionado = false;
+      if (!std::isnan(f.lat) && !std::isnan(f.lon)) t.fixes.push_back(f);
+    }
+  }
+  return true;
+}
+
+// Receptor quieto: error Gauss-Markov (2 m, 30 s) más ruido blanco, como
+// el generador de replay_giros, y velocidad de unas décimas de km/h
+static void agregarEstacionado(Traza& t, uint32_t segundos, std::mt19937& azar) {
+  if (t.fixes.empty()) return;
+  std::normal_distribution<double> normal(0, 1);
+  std::uniform_real_distribution<double> uniforme(0, 360);
+  Fix base = t.fixes.back();
+  double cosLat = cos(base.lat * M_PI / 180);
+  double a = exp(-1.0 / 30.0);
+  double ex = 0, ey = 0;
+  for (uint32_t s = 1; s <= segundos; s++) {
+    ex = a * ex + normal(azar) * 2.0 * sqrt(1 - a * a);
+    ey = a * ey + normal(azar) * 2.0 * sqrt(1 - a * a);
+    Fix f = base;
+    f.tiempoMs = base.tiempoMs + s * 1000;
+    f.lat = base.lat + (ey + normal(azar)) / 111194.93;
+    f.lon = base.lon + (ex + normal(azar)) / (111194.93 * cosLat);
+    f.velocidadKmh = (float)fabs(normal(azar) * 0.4);
+    f.rumbo = (float)uniforme(azar);
+    f.estacionado = true;
+    t.fixes.push_back(f);
+  }
+}
+
+// ====== Medición ======
+struct Medicion {
+  uint32_t mensajes;
+  uint32_t mensajesEstacionado;
+  double horas;
+  double horasEstacionado;
+  std::vector<float> errores;
+};
+
+// Con 'config' nulo: un mensaje cada INTERVALO_ENVIO_UBICACION y el tablero
+// muestra el último punto
+static Medicion medir(const std::vector<Traza>& trazas, const ConfigBandaMuerta* config) {
+  Medicion m = {0, 0, 0, 0, {}};
+  for (const Traza& t : trazas) {
+    if (t.fixes.empty()) continue;
+    BandaMuerta banda(config ? *config : CONFIG_BANDA_MUERTA);
+    MuestraPosicion publicada = {0, 0, 0, 0, 0};
+    bool hayPublicada = false;
+    for (size_t i = 0; i < t.fixes.size(); i++) {
+      const Fix& f = t.fixes[i];
+      MuestraPosicion actual = {f.lat, f.lon, f.velocidadKmh, f.rumbo, f.tiempoMs};
+      bool publica;
+      if (config) {
+        publica = banda.evaluar(actual) != REPORTE_NINGUNO;
+      } else {
+        publica = !hayPublicada || f.tiempoMs - publicada.tiempoMs >= INTERVALO_ENVIO_UBICACION;
+      }
+      if (publica) {
+        publicada = actual;
+        hayPublicada = true;
+        m.mensajes++;
+        if (f.estacionado) m.mensajesEstacionado++;
+      }
+      if (i > 0) {
+        double horas = (f.tiempoMs - t.fixes[i - 1].tiempoMs) / 3600000.0;
+        m.horas += horas;
+        if (f.estacionado) m.horasEstacionado += horas;
+      }
+      double lat = publicada.lat, lon = publicada.lon;
+      if (config) predecirPosicion(publicada, f.tiempoMs, config->velocidadMinimaKmh, lat, lon);
+      m.errores.push_back((float)distanciaHaversine(lat, lon, f.lat, f.lon));
+    }
+  }
+  return m;
+}
+
+static void imprimir(const char* nombre, Medicion& m) {
+  std::sort(m.errores.begin(), m.errores.end());
+  double suma = 0;
+  for (float e : m.errores) suma += e;
+  size_t n = m.errores.size();
+  double horasMovimiento = m.horas - m.horasEstacionado;
+  printf("%-14s %9.0f %12.0f", nombre, horasMovimiento > 0 ? (m.mensajes - m.mensajesEstacionado) / horasMovimiento : 0,
+         m.horasEstacionado > 0 ? m.mensajesEstacionado / m.horasEstacionado : 0);
+  if (n > 0) {
+    printf(" %10.1f %8.1f %8.1f %8.1f", suma / n, m.errores[n / 2], m.errores[(size_t)(n * 0.95)], m.errores[n - 1]);
+  }
+  printf("\n");
+}
+
+int main(int argc, char** argv) {
+  std::string umbrales = "10,25,50,100";
+  ConfigBandaMuerta base = CONFIG_BANDA_MUERTA;
+  uint32_t estacionado = 0;
+  uint32_t semilla = 1;
+  std::vector<std::string> rutas;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool hayValor = i + 1 < argc;
+    if (a == "--umbrales" && hayValor) umbrales = argv[++i];
+    else if (a == "--silencio" && hayValor) base.silencioMaximoMs = (uint32_t)(atof(argv[++i]) * 1000);
+    else if (a == "--vmin" && hayValor) base.velocidadMinimaKmh = (float)atof(argv[++i]);
+    else if (a == "--estacionado" && hayValor) estacionado = (uint32_t)atoi(argv[++i]);
+    else if (a == "--semilla" && hayValor) semilla = (uint32_t)atoi(argv[++i]);
+    else if (a.compare(0, 2, "--") == 0) {
+      fprintf(stderr,
+              "Uso: %s [--umbrales 10,25,50] [--silencio s] [--vmin kmh] [--estacionado s] [--semilla n] "
+              "traza.nmea ...\n",
+              argv[0]);
+      return 1;
+    } else {
+      rutas.push_back(a);
+    }
+  }
+  if (rutas.empty()) {
+    fprintf(stderr, "Faltan las trazas\n");
+    return 1;
+  }
+
+  std::mt19937 azar(semilla);
+  std::vector<Traza> trazas;
+  size_t fixes = 0;
+  for (const std::string& r : rutas) {
+    Traza t;
+    if (!leerTraza(r, t)) {
+      fprintf(stderr, "No se pudo leer %s\n", r.c_str());
+      return 1;
+    }
+    agregarEstacionado(t, estacionado, azar);
+    fixes += t.fixes.size();
+    trazas.push_back(t);
+  }
+
+  printf("%zu trazas, %zu fixes | latido %.0f s, extrapola desde %.1f km/h\n", trazas.size(), fixes,
+         base.silencioMaximoMs / 1000.0, base.velocidadMinimaKmh);
+  printf("%-14s %9s %12s %10s %8s %8s %8s\n", "modo", "msgs/h", "msgs/h quieto", "error med", "p50", "p95", "max");
+  Medicion fijo = medir(trazas, nullptr);
+  char nombre[32];
+  snprintf(nombre, sizeof(nombre), "fijo %u s", INTERVALO_ENVIO_UBICACION / 1000);
+  imprimir(nombre, fijo);
+
+  size_t desde = 0;
+  while (desde < umbrales.size()) {
+    size_t hasta = umbrales.find(',', desde);
+    if (hasta == std::string::npos) hasta = umbrales.size();
+    ConfigBandaMuerta config = base;
+    config.errorMaximoM = (float)atof(umbrales.substr(desde, hasta - desde).c_str());
+    desde = hasta + 1;
+    Medicion m = medir(trazas, &config);
+    snprintf(nombre, sizeof(nombre), "banda %.0f m", config.errorMaximoM);
+    imprimir(nombre, m);
+  }
+  printf("(errores en metros, medidos en cada fix)\n");
+  return 0;
+}
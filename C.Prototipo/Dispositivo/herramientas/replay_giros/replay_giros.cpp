@@ -0,0 +1,477 @@
+// ====== Replay de trazas NMEA para la detección de giros ======
+// Reproduce logs NMEA grabados (RMC + GGA) por la misma cadena que usa el
+// firmware (FiltroNMEA -> VentanaGPS -> FiltroKalman -> DetectorGiros) tan
+// rápido como da la PC, y compara los giros detectados con los anotados.
+//
+// Compilar desde esta carpeta (una sola línea):
+//   g++ -O2 -std=c++11 -I../../lib/FiltroNMEA -I../../lib/VentanaGPS
+//       -I../../lib/Geodesia -I../../lib/FiltroKalman -I../../lib/DetectorGiros
+//       replay_giros.cpp ../../lib/FiltroNMEA/*.cpp ../../lib/VentanaGPS/*.cpp
+//       ../../lib/Geodesia/*.cpp ../../lib/FiltroKalman/*.cpp
+//       ../../lib/DetectorGiros/*.cpp -o replay_giros
+//
+// Uso:
+//   ./replay_giros [--detector rumbo|curvatura|ambos] [--tolerancia s]
+//                  [--repetir n] [--ruido p] traza1.nmea [traza2.nmea ...]
+//   ./replay_giros --generar carpeta cantidad [semilla]
+//
+// Cada traza puede venir con un archivo "<traza>.giros" con la hora UTC
+// (hhmmss) de cada giro real, una por línea; '#' empieza un comentario. Un
+// giro detectado cuenta como acierto si cae a menos de 'tolerancia' segundos
+// de uno anotado que no se haya usado.
+//
+// Los archivos se leen como un flujo de bytes, igual que la UART, y pasan
+// por FiltroNMEA; --ruido p corrompe cada byte con probabilidad p (bit
+// invertido o byte perdido) para ver cómo responden el filtro y la cadena.
+//
+// --generar escribe trazas sintéticas de manejo urbano (esquinas, curvas
+// suaves de avenida, semáforos, ruido y saltos de multipath) con sus
+// anotaciones, para tener un corpus mientras no haya grabaciones reales.
+
+#include <FiltroNMEA.h>
+#include <VentanaGPS.h>
+#include <FiltroKalman.h>
+#include <DetectorGiros.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Mismos valores que src/main.cpp
+static const ConfigVentanaGPS CONFIG_VENTANA_GPS = {150.0f, 25.0f, 5};
+static const ConfigKalman CONFIG_KALMAN = {1.0f, 4.0f, 0.5f, 25.0f, 10000, 2000.0f};
+static const int TAMANO_BUFFER_GPS = 30;
+
+struct Fix {
+  uint32_t tiempoMs;  // desde las 00:00 UTC
+  double lat;
+  double lon;
+  float velocidadKmh;
+  float rumbo;
+  uint8_t satelites;
+  float hdop;
+};
+
+struct Traza {
+  std::string nombre;
+  std::vector<Fix> fixes;
+  std::vector<uint32_t> giros;  // ms desde las 00:00 UTC
+  bool anotada;
+};
+
+// ====== Lectura NMEA ======
+static std::vector<std::string> campos(const std::string& linea) {
+  std::vector<std::string> salida;
+  std::string actual;
+  size_t fin = linea.rfind('*');
+  for (size_t i = 1; i < fin; i++) {
+    if (linea[i] == ',') {
+      salida.push_back(actual);
+      actual.clear();
+    } else {
+      actual += linea[i];
+    }
+  }
+  salida.push_back(actual);
+  return salida;
+}
+
+static double coordenada(const std::string& valor, const std::string& hemisferio) {
+  if (valor.empty()) return NAN;
+  double v = atof(valor.c_str());
+  int grados = (int)(v / 100);
+  double r = grados + (v - grados * 100) / 60.0;
+  return (hemisferio == "S" || hemisferio == "W") ? -r : r;
+}
+
+static uint32_t horaAMs(const std::string& hhmmss) {
+  double v = atof(hhmmss.c_str());
+  int h = (int)(v / 10000);
+  int m = ((int)(v / 100)) % 100;
+  double s = fmod(v, 100.0);
+  return (uint32_t)((h * 3600 + m * 60) * 1000 + s * 1000 + 0.5);
+}
+
+static bool leerTraza(const std::string& ruta, Traza& t, FiltroNMEA& filtro, double ruido, std::mt19937& azar) {
+  std::ifstream in(ruta, std::ios::binary);
+  if (!in) return false;
+  t.nombre = ruta;
+  std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  std::uniform_real_distribution<double> probabilidad(0, 1);
+  uint8_t satelites = 0;
+  float hdop = 1.0f;
+  for (char crudo : bytes) {
+    uint8_t b = (uint8_t)crudo;
+    if (ruido > 0 && probabilidad(azar) < ruido) {
+      if (probabilidad(azar) < 0.5) continue;
+      b ^= (uint8_t)(1 << (azar() % 8));
+    }
+    if (!filtro.procesar(b)) continue;
+    std::string linea(filtro.sentencia(), filtro.largo() - 2);
+    std::vector<std::string> c = campos(linea);
+    std::string tipo = c[0].substr(2);
+    if (tipo == "GGA" && c.size() > 8) {
+      satelites = (uint8_t)atoi(c[7].c_str());
+      hdop = c[8].empty() ? 1.0f : (float)atof(c[8].c_str());
+    } else if (tipo == "RMC" && c.size() > 8 && c[2] == "A") {
+      Fix f;
+      f.tiempoMs = horaAMs(c[1]);
+      f.lat = coordenada(c[3], c[4]);
+      f.lon = coordenada(c[5], c[6]);
+      f.velocidadKmh = (float)(atof(c[7].c_str()) * 1.852);
+      f.rumbo = (float)atof(c[8].c_str());
+      f.satelites = satelites;
+      f.hdop = hdop;
+      if (!std::isnan(f.lat) && !std::isnan(f.lon)) t.fixes.push_back(f);
+    }
+  }
+
+  std::string linea;
+  std::ifstream anotaciones(ruta + ".giros");
+  t.anotada = (bool)anotaciones;
+  while (anotaciones && std::getline(anotaciones, linea)) {
+    size_t comentario = linea.find('#');
+    if (comentario != std::string::npos) linea.erase(comentario);
+    if (linea.find_first_not_of(" \t\r") == std::string::npos) continue;
+    t.giros.push_back(horaAMs(linea));
+  }
+  return true;
+}
+
+// ====== Cadena del firmware ======
+struct Resultado {
+  std::vector<uint32_t> giros;
+  uint32_t posibles;
+  uint32_t fixes;
+};
+
+static Resultado procesar(const Traza& t, const ConfigDetectorGiros& config) {
+  VentanaGPSFija<TAMANO_BUFFER_GPS> ventana(CONFIG_VENTANA_GPS);
+  FiltroKalman filtro(CONFIG_KALMAN);
+  DetectorGiros detector(config);
+  Resultado r = {{}, 0, 0};
+  for (const Fix& f : t.fixes) {
+    if (f.satelites < 3) continue;
+    MuestraGPS m = {f.lat, f.lon, f.rumbo, f.velocidadKmh, f.satelites, 0, f.tiempoMs};
+    if (!ventana.agregar(m)) continue;
+    filtro.actualizar(f.lat, f.lon, f.hdop, f.satelites, f.tiempoMs);
+    filtro.actualizarVelocidad(f.velocidadKmh, f.rumbo);
+    PuntoGiro p = {filtro.latitud(), filtro.longitud(), filtro.rumbo(), filtro.velocidadKmh()};
+    r.fixes++;
+    EventoGiro e = detector.agregar(p);
+    if (e == GIRO_POSIBLE) r.posibles++;
+    if (e == GIRO_CONFIRMADO) r.giros.push_back(f.tiempoMs);
+  }
+  return r;
+}
+
+struct Conteo {
+  uint32_t aciertos;
+  uint32_t falsos;
+  uint32_t perdidos;
+};
+
+static Conteo comparar(const std::vector<uint32_t>& detectados, const std::vector<uint32_t>& reales, uint32_t toleranciaMs) {
+  Conteo c = {0, 0, 0};
+  std::vector<bool> usado(reales.size(), false);
+  for (uint32_t d : detectados) {
+    int mejor = -1;
+    uint32_t mejorDif = toleranciaMs + 1;
+    for (size_t i = 0; i < reales.size(); i++) {
+      uint32_t dif = d > reales[i] ? d - reales[i] : reales[i] - d;
+      if (!usado[i] && dif <= toleranciaMs && dif < mejorDif) {
+        mejor = (int)i;
+        mejorDif = dif;
+      }
+    }
+    if (mejor >= 0) {
+      usado[mejor] = true;
+      c.aciertos++;
+    } else {
+      c.falsos++;
+    }
+  }
+  for (bool u : usado) {
+    if (!u) c.perdidos++;
+  }
+  return c;
+}
+
+static void evaluar(const std::vector<Traza>& trazas, const char* nombre, const ConfigDetectorGiros& config,
+                    uint32_t toleranciaMs, int repeticiones) {
+  Conteo total = {0, 0, 0};
+  uint64_t fixes = 0;
+  uint64_t segmentos = 0;
+  double segundosTraza = 0;
+  bool hayAnotaciones = false;
+
+  auto inicio = std::chrono::steady_clock::now();
+  for (int rep = 0; rep < repeticiones; rep++) {
+    for (const Traza& t : trazas) {
+      Resultado r = procesar(t, config);
+      fixes += r.fixes;
+      segmentos += r.giros.size() + 1;
+      if (rep == 0) {
+        if (!t.fixes.empty()) segundosTraza += (t.fixes.back().tiempoMs - t.fixes.front().tiempoMs) / 1000.0;
+        if (t.anotada) {
+          hayAnotaciones = true;
+          Conteo c = comparar(r.giros, t.giros, toleranciaMs);
+          total.aciertos += c.aciertos;
+          total.falsos += c.falsos;
+          total.perdidos += c.perdidos;
+        }
+      }
+    }
+  }
+  double segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+
+  printf("%-10s %10.0f fixes/s %9.0f segmentos/s %9.0fx tiempo real", nombre, fixes / segundos,
+         segmentos / segundos, segundosTraza * repeticiones / segundos);
+  if (hayAnotaciones) {
+    double precision = total.aciertos + total.falsos ? (double)total.aciertos / (total.aciertos + total.falsos) : 0;
+    double recall = total.aciertos + total.perdidos ? (double)total.aciertos / (total.aciertos + total.perdidos) : 0;
+    double f1 = precision + recall > 0 ? 2 * precision * recall / (precision + recall) : 0;
+    printf("  precision %.3f  recall %.3f  F1 %.3f  (%u/%u/%u)", precision, recall, f1, total.aciertos,
+           total.falsos, total.perdidos);
+  }
+  printf("\n");
+}
+
+// ====== Trazas sintéticas ======
+class Generador {
+ public:
+  Generador(uint32_t semilla) : azar(semilla) {}
+
+  void escribir(const std::string& ruta) {
+    reiniciar();
+    int tramos = 8 + (int)uniforme(0, 8);
+    for (int i = 0; i < tramos; i++) {
+      recta(uniforme(80, 400), uniforme(25, 50));
+      double r = uniforme(0, 1);
+      if (r < 0.25) {
+        // Curva suave de avenida: no es un giro
+        curva(uniforme(10, 35) * signo(), uniforme(150, 400), uniforme(30, 45), false);
+      } else if (r < 0.35) {
+        semaforo(uniforme(10, 40));
+      } else if (r < 0.45) {
+        // Diagonal: giro de 60 a 135 grados
+        curva(uniforme(60, 135) * signo(), uniforme(8, 14), uniforme(12, 20), true);
+      } else {
+        curva(90 * signo() + uniforme(-8, 8), uniforme(6, 14), uniforme(8, 20), true);
+      }
+    }
+    recta(uniforme(80, 200), uniforme(25, 45));
+
+    FILE* nmea = fopen(ruta.c_str(), "w");
+    FILE* giros = fopen((ruta + ".giros").c_str(), "w");
+    if (!nmea || !giros) {
+      fprintf(stderr, "No se pudo escribir %s\n", ruta.c_str());
+      exit(1);
+    }
+    for (const std::string& l : lineas) fprintf(nmea, "%s\n", l.c_str());
+    fprintf(giros, "# giros reales (hhmmss UTC)\n");
+    for (uint32_t g : girosReales) fprintf(giros, "%s\n", hora(g).c_str());
+    fclose(nmea);
+    fclose(giros);
+  }
+
+ private:
+  std::mt19937 azar;
+  std::vector<std::string> lineas;
+  std::vector<uint32_t> girosReales;
+  double x, y, rumbo, velocidad;  // metros, grados, m/s
+  uint32_t tiempoMs;
+  uint32_t proximoFixMs;
+  double errorX, errorY;          // error correlacionado del receptor
+  double lat0, lon0;
+
+  double uniforme(double a, double b) { return std::uniform_real_distribution<double>(a, b)(azar); }
+  double normal(double s) { return std::normal_distribution<double>(0, s)(azar); }
+  double signo() { return uniforme(0, 1) < 0.5 ? -1 : 1; }
+
+  void reiniciar() {
+    lineas.clear();
+    girosReales.clear();
+    x = y = 0;
+    rumbo = uniforme(0, 360);
+    velocidad = 8;
+    tiempoMs = (uint32_t)(uniforme(8, 18) * 3600) * 1000;
+    proximoFixMs = tiempoMs;
+    errorX = errorY = 0;
+    lat0 = -34.6 + uniforme(-0.1, 0.1);
+    lon0 = -58.4 + uniforme(-0.1, 0.1);
+  }
+
+  // Avanza 100 ms acercando la velocidad a 'objetivo' (±2 m/s²) con 'giro' grados/metro
+  void paso(double objetivo, double giro) {
+    double dv = objetivo - velocidad;
+    if (dv > 0.2) dv = 0.2;
+    if (dv < -0.2) dv = -0.2;
+    velocidad += dv;
+    double d = velocidad * 0.1;
+    rumbo = fmod(rumbo + giro * d + 360.0, 360.0);
+    x += d * sin(rumbo * M_PI / 180);
+    y += d * cos(rumbo * M_PI / 180);
+    tiempoMs += 100;
+    if (tiempoMs >= proximoFixMs) {
+      fix();
+      proximoFixMs += 1000;
+    }
+  }
+
+  void recta(double metros, double kmh) {
+    double hecho = 0;
+    while (hecho < metros) {
+      paso(kmh / 3.6, 0);
+      hecho += velocidad * 0.1;
+    }
+  }
+
+  void curva(double grados, double radio, double kmh, bool esGiro) {
+    // Frena antes de la esquina
+    for (int i = 0; i < 40 && velocidad > kmh / 3.6 + 0.3; i++) paso(kmh / 3.6, 0);
+    double giro = (grados > 0 ? 1 : -1) * 180.0 / (M_PI * radio);
+    double girado = 0;
+    uint32_t inicio = tiempoMs;
+    while (girado < fabs(grados)) {
+      paso(kmh / 3.6, giro);
+      girado += fabs(giro) * velocidad * 0.1;
+    }
+    if (esGiro) girosReales.push_back((inicio + tiempoMs) / 2);
+  }
+
+  void semaforo(double segundos) {
+    while (velocidad > 0.05) paso(0, 0);
+    for (int i = 0; i < segundos * 10; i++) paso(0, 0);
+  }
+
+  void fix() {
+    // Error tipo Gauss-Markov (2 m, 30 s) más ruido blanco y algún salto de multipath
+    double a = exp(-1.0 / 30.0);
+    errorX = a * errorX + normal(2.0 * sqrt(1 - a * a));
+    errorY = a * errorY + normal(2.0 * sqrt(1 - a * a));
+    double ex = errorX + normal(1.0);
+    double ey = errorY + normal(1.0);
+    if (uniforme(0, 1) < 0.01) {
+      ex += normal(40);
+      ey += normal(40);
+    }
+    double lat = lat0 + (y + ey) / 111194.93;
+    double lon = lon0 + (x + ex) / (111194.93 * cos(lat0 * M_PI / 180));
+    double v = fmax(0, velocidad + normal(0.15));
+    // El rumbo del GPS empeora a baja velocidad
+    double curso = v < 0.5 ? uniforme(0, 360) : fmod(rumbo + normal(fmin(90, 1.5 + 8 / v)) + 360, 360);
+    int sats = 6 + (int)uniforme(0, 5);
+    double hdop = uniforme(0.8, 1.6);
+
+    char latTxt[32], lonTxt[32], cuerpo[160];
+    formatear(fabs(lat), 2, latTxt);
+    formatear(fabs(lon), 3, lonTxt);
+    std::string h = hora(tiempoMs);
+    snprintf(cuerpo, sizeof(cuerpo), "GPRMC,%s.00,A,%s,%c,%s,%c,%.2f,%.1f,170326,,,A", h.c_str(), latTxt,
+             lat < 0 ? 'S' : 'N', lonTxt, lon < 0 ? 'W' : 'E', v / 0.514444, curso);
+    agregarLinea(cuerpo);
+    snprintf(cuerpo, sizeof(cuerpo), "GPGGA,%s.00,%s,%c,%s,%c,1,%02d,%.1f,25.0,M,0.0,M,,", h.c_str(), latTxt,
+             lat < 0 ? 'S' : 'N', lonTxt, lon < 0 ? 'W' : 'E', sats, hdop);
+    agregarLinea(cuerpo);
+  }
+
+  static void formatear(double grados, int digitos, char* destino) {
+    int g = (int)grados;
+    double minutos = (grados - g) * 60;
+    sprintf(destino, "%0*d%08.5f", digitos, g, minutos);
+  }
+
+  static std::string hora(uint32_t ms) {
+    char t[16];
+    uint32_t s = ms / 1000;
+    sprintf(t, "%02u%02u%02u", (s / 3600) % 24, (s / 60) % 60, s % 60);
+    return t;
+  }
+
+  void agregarLinea(const char* cuerpo) {
+    uint8_t suma = 0;
+    for (const char* c = cuerpo; *c; c++) suma ^= (uint8_t)*c;
+    char linea[200];
+    snprintf(linea, sizeof(linea), "$%s*%02X", cuerpo, suma);
+    lineas.push_back(linea);
+  }
+};
+
+int main(int argc, char** argv) {
+  std::string detector = "ambos";
+  uint32_t toleranciaMs = 20000;
+  int repeticiones = 1;
+  double ruido = 0;
+  std::vector<std::string> rutas;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--generar" && i + 2 < argc) {
+      std::string carpeta = argv[i + 1];
+      int cantidad = atoi(argv[i + 2]);
+      uint32_t semilla = (i + 3 < argc) ? (uint32_t)atoi(argv[i + 3]) : 1;
+      Generador g(semilla);
+      for (int n = 0; n < cantidad; n++) {
+        char nombre[32];
+        snprintf(nombre, sizeof(nombre), "/traza_%03d.nmea", n);
+        g.escribir(carpeta + nombre);
+      }
+      printf("%d trazas escritas en %s\n", cantidad, carpeta.c_str());
+      return 0;
+    } else if (a == "--detector" && i + 1 < argc) {
+      detector = argv[++i];
+    } else if (a == "--tolerancia" && i + 1 < argc) {
+      toleranciaMs = (uint32_t)(atof(argv[++i]) * 1000);
+    } else if (a == "--repetir" && i + 1 < argc) {
+      repeticiones = atoi(argv[++i]);
+    } else if (a == "--ruido" && i + 1 < argc) {
+      ruido = atof(argv[++i]);
+    } else {
+      rutas.push_back(a);
+    }
+  }
+  if (rutas.empty()) {
+    fprintf(stderr, "Uso: %s [--detector rumbo|curvatura|ambos] [--tolerancia s] [--repetir n] [--ruido p] trazas...\n"
+                    "     %s --generar carpeta cantidad [semilla]\n", argv[0], argv[0]);
+    return 1;
+  }
+
+  // Todo en memoria antes de medir: el tiempo es solo el de la cadena
+  std::vector<Traza> trazas;
+  FiltroNMEA filtro;
+  std::mt19937 azar(1);
+  size_t totalFixes = 0;
+  auto inicioLectura = std::chrono::steady_clock::now();
+  for (const std::string& r : rutas) {
+    Traza t;
+    if (!leerTraza(r, t, filtro, ruido, azar)) {
+      fprintf(stderr, "No se pudo leer %s\n", r.c_str());
+      continue;
+    }
+    totalFixes += t.fixes.size();
+    trazas.push_back(t);
+  }
+  double segundosLectura = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicioLectura).count();
+  const EstadisticasNMEA& e = filtro.estadisticas();
+  printf("%zu trazas, %zu fixes\n", trazas.size(), totalFixes);
+  printf("NMEA: %u bytes, %u sentencias, %u aceptadas, %u filtradas, %u checksum inválido, %u truncadas"
+         " (lectura %.1f MB/s)\n", e.bytes, e.sentencias, e.aceptadas, e.filtradas, e.errorChecksum, e.truncadas,
+         e.bytes / segundosLectura / 1e6);
+
+  if (detector == "rumbo" || detector == "ambos") {
+    evaluar(trazas, "rumbo", DETECTOR_GIROS_RUMBO, toleranciaMs, repeticiones);
+  }
+  if (detector == "curvatura" || detector == "ambos") {
+    evaluar(trazas, "curvatura", DETECTOR_GIROS_CURVATURA, toleranciaMs, repeticiones);
+  }
+  return 0;
+}
@@ -0,0 +1,60 @@
+#include "BandaMuerta.h"
+
+#include <math.h>
+#include <string.h>
+
+static const float GRADOS_A_RAD_F = (float)(M_PI / 180.0);
+static const float METROS_POR_GRADO_F = (float)(RADIO_TIERRA_M * M_PI / 180.0);
+
+void predecirPosicion(const MuestraPosicion& referencia, uint32_t tiempoMs, float velocidadMinimaKmh, double& lat,
+                      double& lon) {
+  lat = referencia.lat;
+  lon = referencia.lon;
+  if (referencia.velocidadKmh < velocidadMinimaKmh) return;
+  // El desplazamiento se calcula en float; se suma en double a la referencia
+  float segundos = (float)(tiempoMs - referencia.tiempoMs) / 1000.0f;
+  float metros = referencia.velocidadKmh / 3.6f * segundos;
+  float rumbo = referencia.rumbo * GRADOS_A_RAD_F;
+  float cosLat = cosf((float)referencia.lat * GRADOS_A_RAD_F);
+  lat += metros * cosf(rumbo) / METROS_POR_GRADO_F;
+  lon += metros * sinf(rumbo) / (METROS_POR_GRADO_F * cosLat);
+}
+
+BandaMuerta::BandaMuerta(const ConfigBandaMuerta& config) : config(config), hayReferencia(false) {
+  memset(&ultima, 0, sizeof(ultima));
+  reiniciarEstadisticas();
+}
+
+void BandaMuerta::reiniciarEstadisticas() {
+  memset(&est, 0, sizeof(est));
+}
+
+float BandaMuerta::errorPrediccion(const MuestraPosicion& actual) const {
+  double lat, lon;
+  predecirPosicion(ultima, actual.tiempoMs, config.velocidadMinimaKmh, lat, lon);
+  return distanciaEquirectangular(lat, lon, actual.lat, actual.lon, cosf((float)actual.lat * GRADOS_A_RAD_F));
+}
+
+MotivoReporte BandaMuerta::evaluar(const MuestraPosicion& actual) {
+  est.evaluadas++;
+  MotivoReporte motivo;
+  if (!hayReferencia) {
+    motivo = REPORTE_PRIMERO;
+    est.primeros++;
+  } else {
+    float error = errorPrediccion(actual);
+    if (error > config.errorMaximoM) {
+      motivo = REPORTE_DESVIO;
+      est.desvios++;
+    } else if (actual.tiempoMs - ultima.tiempoMs >= config.silencioMaximoMs) {
+      motivo = REPORTE_SILENCIO;
+      est.silencios++;
+    } else {
+      if (error > est.peorErrorOmitidoM) est.peorErrorOmitidoM = error;
+      return REPORTE_NINGUNO;
+    }
+  }
+  ultima = actual;
+  hayReferencia = true;
+  return motivo;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <Geodesia.h>
+
+// ====== Reporte por banda muerta ======
+// El equipo y el tablero comparten un modelo de extrapolación: desde la
+// última posición publicada el camión sigue en línea recta con la velocidad
+// y el rumbo que informó, o queda quieto si iba a menos de
+// 'velocidadMinimaKmh' (a esa velocidad el rumbo del GPS es ruido). El equipo
+// evalúa cada fix contra esa predicción y publica solo cuando se desvía más
+// de 'errorMaximoM', o cuando pasaron 'silencioMaximoMs' sin publicar
+// (latido). Un camión estacionado manda solo latidos.
+//
+// El error que ve el tablero queda acotado por 'errorMaximoM' en cada fix
+// evaluado; entre dos fixes se suma lo que el camión avanza en ese lapso.
+// El tablero extrapola desde la hora UTC del fix que viaja en el mensaje
+// ("tiempo"), no desde que lo recibió: un mensaje demorado en la cola no se
+// adelanta de más. Pasado 'silencioMaximoMs' desde el fix deja de
+// extrapolar, y un mensaje que llega más viejo que eso (un reenvío) se
+// muestra donde está.
+//
+// predecirPosicion() es el modelo: el tablero
+// (Servicios_AWS/templates/index.html) lo repite en JavaScript y cualquier
+// cambio tiene que hacerse en los dos lados.
+
+struct ConfigBandaMuerta {
+  float errorMaximoM;         // desvío de la predicción que obliga a publicar
+  uint32_t silencioMaximoMs;  // nunca más que esto sin publicar
+  float velocidadMinimaKmh;   // por debajo se predice detenido
+};
+
+struct MuestraPosicion {
+  double lat;
+  double lon;
+  float velocidadKmh;
+  float rumbo;        // grados desde el norte
+  uint32_t tiempoMs;  // millis() del fix
+};
+
+enum MotivoReporte : uint8_t {
+  REPORTE_NINGUNO,
+  REPORTE_PRIMERO,
+  REPORTE_DESVIO,
+  REPORTE_SILENCIO
+};
+
+struct EstadisticasBandaMuerta {
+  uint32_t evaluadas;
+  uint32_t primeros;
+  uint32_t desvios;
+  uint32_t silencios;
+  float peorErrorOmitidoM;  // el mayor desvío que no se publicó
+};
+
+// Posición que el tablero muestra a 'tiempoMs' si la última publicada es 'referencia'
+void predecirPosicion(const MuestraPosicion& referencia, uint32_t tiempoMs, float velocidadMinimaKmh, double& lat,
+                      double& lon);
+
+class BandaMuerta {
+ public:
+  explicit BandaMuerta(const ConfigBandaMuerta& config);
+
+  // Si el fix hay que publicarlo devuelve el motivo y lo toma como la nueva
+  // referencia; si no, REPORTE_NINGUNO
+  MotivoReporte evaluar(const MuestraPosicion& actual);
+  // Metros entre el fix y la predicción desde la referencia
+  float errorPrediccion(const MuestraPosicion& actual) const;
+  // El próximo fix se publica sí o sí (p. ej. al reconectar)
+  void reiniciar() { hayReferencia = false; }
+  // El tablero no usa el umbral: se puede cambiar sin tocarlo
+  void fijarErrorMaximo(float metros) { config.errorMaximoM = metros; }
+
+  bool tieneReferencia() const { return hayReferencia; }
+  const MuestraPosicion& referencia() const { return ultima; }
+  const EstadisticasBandaMuerta& estadisticas() const { return est; }
+  void reiniciarEstadisticas();
+
+ private:
+  ConfigBandaMuerta config;
+  MuestraPosicion ultima;
+  bool hayReferencia;
+  EstadisticasBandaMuerta est;
+};
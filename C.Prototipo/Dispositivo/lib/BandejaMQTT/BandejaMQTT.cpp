@@ -0,0 +1,332 @@
+#include "BandejaMQTT.h"
+
+#include <string.h>
+
+static const uint8_t MQTT_PUBLISH = 0x30;
+static const uint8_t MQTT_PUBLISH_QOS1 = 0x32;
+static const uint8_t MQTT_DUP = 0x08;
+static const uint8_t MQTT_PUBACK = 0x40;
+
+static const uint16_t SIN_RESERVA = 0xFFFF;
+
+enum EstadoLectura : uint8_t {
+  LEYENDO_TIPO,
+  LEYENDO_LARGO,
+  LEYENDO_CUERPO
+};
+
+BandejaMQTT::BandejaMQTT(uint8_t* memoria, uint16_t capacidad, const ConfigBandeja& config)
+    : memoria(memoria),
+      capacidad(capacidad),
+      config(config),
+      confirmacion(nullptr),
+      inicio(0),
+      fin(0),
+      usados(0),
+      entradas(0),
+      cantidad(0),
+      vuelo(0),
+      proximoId(1),
+      topicoReserva(),
+      posicionReserva(SIN_RESERVA),
+      maximoReserva(0),
+      inicioAnterior(0),
+      finAnterior(0),
+      usadosAnterior(0),
+      entradasAnterior(0),
+      tipoEntrante(0),
+      restantes(0),
+      leidos(0),
+      estadoLectura(LEYENDO_TIPO),
+      idEntrante(0) {
+  fijarVentana(config.ventana);
+  reiniciarEstadisticas();
+}
+
+// ====== Cabecera de un PUBLISH ======
+size_t reservaPublish(const TopicoMQTT& topico, uint8_t qos) {
+  return 1 + 3 + 2 + topico.largo + (qos > 0 ? 2 : 0);
+}
+
+uint8_t* armarPublish(uint8_t* datos, size_t largo, const TopicoMQTT& topico, uint8_t qos, size_t& largoPaquete) {
+  uint32_t resto = 2 + topico.largo + (qos > 0 ? 2 : 0) + largo;
+  uint8_t bytesLargo = resto < 128 ? 1 : resto < 16384 ? 2 : 3;
+  size_t cabecera = 1 + bytesLargo + resto - largo;
+  uint8_t* paquete = datos - cabecera;
+  uint8_t* p = paquete;
+  *p++ = qos > 0 ? MQTT_PUBLISH_QOS1 : MQTT_PUBLISH;
+  do {
+    uint8_t b = resto & 0x7F;
+    resto >>= 7;
+    *p++ = resto > 0 ? (b | 0x80) : b;
+  } while (resto > 0);
+  *p++ = (uint8_t)(topico.largo >> 8);
+  *p++ = (uint8_t)topico.largo;
+  memcpy(p, topico.nombre, topico.largo);
+  p += topico.largo;
+  if (qos > 0) {
+    *p++ = 0;
+    *p++ = 0;
+  }
+  largoPaquete = cabecera + largo;
+  return paquete;
+}
+
+void BandejaMQTT::fijarVentana(uint8_t ventana) {
+  if (ventana == 0) ventana = 1;
+  if (ventana > BANDEJA_MAX_VENTANA) ventana = BANDEJA_MAX_VENTANA;
+  config.ventana = ventana;
+}
+
+void BandejaMQTT::reiniciarEstadisticas() {
+  memset(&est, 0, sizeof(est));
+}
+
+// ====== Buffer circular ======
+BandejaMQTT::Entrada BandejaMQTT::leer(uint16_t posicion) const {
+  Entrada e;
+  memcpy(&e, memoria + posicion, CABECERA);
+  return e;
+}
+
+void BandejaMQTT::guardar(uint16_t posicion, const Entrada& e) {
+  memcpy(memoria + posicion, &e, CABECERA);
+}
+
+uint16_t BandejaMQTT::ocupa(const Entrada& e) const {
+  return CABECERA + e.desplazamiento + e.largo;
+}
+
+// Si después de una entrada no entra ni una cabecera, la siguiente está en 0
+uint16_t BandejaMQTT::siguiente(uint16_t posicion, const Entrada& e) const {
+  uint32_t proxima = (uint32_t)posicion + ocupa(e);
+  if (proxima + CABECERA > capacidad) return 0;
+  return (uint16_t)proxima;
+}
+
+// 'fin' nunca alcanza a 'inicio' con entradas adentro: fin == inicio es vacía
+bool BandejaMQTT::reservar(uint16_t tamano, uint16_t& posicion) {
+  if (entradas == 0) {
+    inicio = 0;
+    fin = 0;
+    usados = 0;
+  }
+  if (fin >= inicio) {
+    if ((uint32_t)fin + tamano <= capacidad) {
+      posicion = fin;
+      fin += tamano;
+      usados += tamano;
+      return true;
+    }
+    if (tamano >= inicio) return false;
+    // Lo que queda al final se marca como relleno y se sigue desde 0
+    uint16_t cola = capacidad - fin;
+    if (cola >= CABECERA) {
+      Entrada relleno = {(uint16_t)(cola - CABECERA), 0, 0, ENTRADA_RELLENO, 0, 0, 0};
+      guardar(fin, relleno);
+      entradas++;
+    }
+    usados += cola + tamano;
+    posicion = 0;
+    fin = tamano;
+    return true;
+  }
+  if ((uint32_t)fin + tamano >= inicio) return false;
+  posicion = fin;
+  fin += tamano;
+  usados += tamano;
+  return true;
+}
+
+void BandejaMQTT::liberarConfirmadas() {
+  while (entradas > 0) {
+    Entrada e = leer(inicio);
+    if (e.estado != ENTRADA_CONFIRMADA && e.estado != ENTRADA_RELLENO) break;
+    uint16_t proxima = siguiente(inicio, e);
+    // Con el salto implícito a 0 también se libera la cola sin cabecera
+    usados -= (proxima == 0) ? capacidad - inicio : ocupa(e);
+    if (e.estado == ENTRADA_CONFIRMADA) cantidad--;
+    entradas--;
+    inicio = proxima;
+  }
+  if (entradas == 0) {
+    inicio = 0;
+    fin = 0;
+    usados = 0;
+  }
+}
+
+// ====== Productores ======
+bool BandejaMQTT::encolar(const TopicoMQTT& topico, const uint8_t* datos, size_t largo, uint32_t marca) {
+  uint8_t* destino = reservarMensaje(topico, largo);
+  if (destino == nullptr) {
+    est.rechazados++;
+    return false;
+  }
+  memcpy(destino, datos, largo);
+  est.copiados += largo;
+  cerrarReserva(largo, marca);
+  return true;
+}
+
+// El lugar es para el peor caso de cabecera; lo que no se use queda como
+// 'desplazamiento' delante del paquete
+uint8_t* BandejaMQTT::reservarMensaje(const TopicoMQTT& topico, size_t maximo) {
+  if (posicionReserva != SIN_RESERVA) return nullptr;
+  size_t reserva = reservaPublish(topico, 1);
+  if (CABECERA + reserva + maximo > capacidad) return nullptr;
+  inicioAnterior = inicio;
+  finAnterior = fin;
+  usadosAnterior = usados;
+  entradasAnterior = entradas;
+  uint16_t posicion;
+  if (!reservar((uint16_t)(CABECERA + reserva + maximo), posicion)) return nullptr;
+  topicoReserva = topico;
+  posicionReserva = posicion;
+  maximoReserva = (uint16_t)maximo;
+  return memoria + posicion + CABECERA + reserva;
+}
+
+bool BandejaMQTT::confirmarMensaje(size_t largo, uint32_t marca) {
+  if (posicionReserva == SIN_RESERVA) return false;
+  if (largo == 0 || largo > maximoReserva) {
+    descartarMensaje();
+    return false;
+  }
+  cerrarReserva(largo, marca);
+  est.enSuLugar++;
+  return true;
+}
+
+void BandejaMQTT::descartarMensaje() {
+  if (posicionReserva == SIN_RESERVA) return;
+  // Con el relleno que haya dejado la reserva al dar la vuelta
+  inicio = inicioAnterior;
+  fin = finAnterior;
+  usados = usadosAnterior;
+  entradas = entradasAnterior;
+  posicionReserva = SIN_RESERVA;
+}
+
+void BandejaMQTT::cerrarReserva(size_t largo, uint32_t marca) {
+  uint8_t* comienzo = memoria + posicionReserva + CABECERA;
+  uint8_t* datos = comienzo + reservaPublish(topicoReserva, 1);
+  size_t largoPaquete;
+  uint8_t* paquete = armarPublish(datos, largo, topicoReserva, 1, largoPaquete);
+  // La reserva es la última: lo que sobra del máximo se devuelve desde 'fin'
+  uint16_t sobra = (uint16_t)(maximoReserva - largo);
+  fin -= sobra;
+  usados -= sobra;
+
+  Entrada e = {(uint16_t)largoPaquete, 0, (uint16_t)(datos - 2 - paquete), ENTRADA_PENDIENTE,
+               (uint8_t)(paquete - comienzo), marca, 0};
+  guardar(posicionReserva, e);
+  posicionReserva = SIN_RESERVA;
+  entradas++;
+  cantidad++;
+  est.encolados++;
+}
+
+// ====== Envío ======
+uint8_t BandejaMQTT::enviar(SalidaMQTT& salida, uint32_t ahoraMs) {
+  uint8_t enviados = 0;
+  uint16_t posicion = inicio;
+  for (uint16_t i = 0; i < entradas && vuelo < config.ventana; i++) {
+    Entrada e = leer(posicion);
+    if (e.estado == ENTRADA_PENDIENTE) {
+      // Un reenvío conserva su identificador
+      if (e.idPaquete == 0) {
+        e.idPaquete = proximoId++;
+        if (proximoId == 0) proximoId = 1;
+      }
+      uint8_t* paquete = memoria + posicion + CABECERA + e.desplazamiento;
+      paquete[e.posicionId] = (uint8_t)(e.idPaquete >> 8);
+      paquete[e.posicionId + 1] = (uint8_t)e.idPaquete;
+      if (!salida.escribir(paquete, e.largo)) {
+        guardar(posicion, e);
+        break;
+      }
+      e.estado = ENTRADA_EN_VUELO;
+      e.enviadoMs = ahoraMs;
+      guardar(posicion, e);
+      vuelo++;
+      enviados++;
+      est.enviados++;
+      if (paquete[0] & MQTT_DUP) est.reenviados++;
+    }
+    posicion = siguiente(posicion, e);
+  }
+  return enviados;
+}
+
+void BandejaMQTT::nuevaConexion() {
+  estadoLectura = LEYENDO_TIPO;
+  uint16_t posicion = inicio;
+  for (uint16_t i = 0; i < entradas; i++) {
+    Entrada e = leer(posicion);
+    if (e.estado == ENTRADA_EN_VUELO) {
+      e.estado = ENTRADA_PENDIENTE;
+      guardar(posicion, e);
+      memoria[posicion + CABECERA + e.desplazamiento] |= MQTT_DUP;
+    }
+    posicion = siguiente(posicion, e);
+  }
+  vuelo = 0;
+}
+
+// ====== Confirmaciones ======
+void BandejaMQTT::recibir(uint8_t b, uint32_t ahoraMs) {
+  switch (estadoLectura) {
+    case LEYENDO_TIPO:
+      tipoEntrante = b;
+      restantes = 0;
+      leidos = 0;
+      estadoLectura = LEYENDO_LARGO;
+      return;
+
+    case LEYENDO_LARGO:
+      restantes |= (uint32_t)(b & 0x7F) << (7 * leidos);
+      if (b & 0x80) {
+        // Más de 4 bytes de largo no es MQTT: se vuelve a sincronizar
+        if (++leidos >= 4) estadoLectura = LEYENDO_TIPO;
+        return;
+      }
+      leidos = 0;
+      idEntrante = 0;
+      estadoLectura = restantes > 0 ? LEYENDO_CUERPO : LEYENDO_TIPO;
+      return;
+
+    case LEYENDO_CUERPO:
+      if (leidos < 2) {
+        idEntrante = (uint16_t)((idEntrante << 8) | b);
+        leidos++;
+      }
+      if (--restantes > 0) return;
+      estadoLectura = LEYENDO_TIPO;
+      if ((tipoEntrante & 0xF0) == MQTT_PUBACK && leidos == 2) {
+        confirmar(idEntrante, ahoraMs);
+      }
+      return;
+  }
+}
+
+void BandejaMQTT::confirmar(uint16_t idPaquete, uint32_t ahoraMs) {
+  uint16_t posicion = inicio;
+  for (uint16_t i = 0; i < entradas; i++) {
+    Entrada e = leer(posicion);
+    if (e.estado == ENTRADA_EN_VUELO && e.idPaquete == idPaquete) {
+      e.estado = ENTRADA_CONFIRMADA;
+      guardar(posicion, e);
+      vuelo--;
+      est.confirmados++;
+      uint32_t rtt = ahoraMs - e.enviadoMs;
+      est.rttTotalMs += rtt;
+      if (rtt > est.rttPeorMs) est.rttPeorMs = rtt;
+      if (confirmacion != nullptr) confirmacion(e.marca);
+      liberarConfirmadas();
+      return;
+    }
+    posicion = siguiente(posicion, e);
+  }
+  est.desconocidos++;
+}
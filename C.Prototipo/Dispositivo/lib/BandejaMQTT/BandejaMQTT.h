@@ -0,0 +1,191 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// ====== Bandeja de salida MQTT (QoS 1) ======
+// Los mensajes se guardan ya armados como paquetes PUBLISH QoS 1 en un
+// buffer circular de tamaño fijo; enviar() escribe los pendientes de a un
+// paquete por write() mientras haya lugar en la ventana (PUBLISH sin PUBACK
+// al mismo tiempo), sin esperar la respuesta de cada uno. Un mensaje sale de
+// la bandeja recién cuando llega su PUBACK.
+//
+// El identificador de paquete se asigna al enviar. nuevaConexion() devuelve
+// a pendientes los que estaban en vuelo, con la marca DUP, para reenviarlos
+// en la sesión siguiente (MQTT 3.1.1, 4.4); el backend ya descarta los
+// repetidos por "seq".
+//
+// Los bytes que llegan del broker pasan por recibir(): se arman los paquetes
+// y de los PUBACK se toma el identificador; el resto se ignora (los sigue
+// procesando el cliente MQTT). Cada confirmación llama a la función del
+// productor con la 'marca' que dio al encolar (en el firmware, el seq).
+//
+// Contrapresión: encolar() devuelve false si el mensaje no entra y
+// saturada() avisa cuando queda menos de un cuarto libre, para que los
+// productores dejen de generar lo descartable.
+//
+// Armado en su lugar: reservarMensaje() da el lugar del mensaje dentro de
+// la bandeja, el productor lo codifica ahí y confirmarMensaje() escribe la
+// cabecera del PUBLISH justo delante. El mensaje no se copia: el paquete
+// sale y se reenvía desde donde se codificó. encolar() es lo mismo con una
+// copia, para lo que ya viene armado (la cola en flash).
+//
+// No depende de Arduino: el socket es una interfaz que el firmware
+// implementa sobre WiFiClientSecure y las herramientas sobre un socket TCP.
+
+const uint8_t BANDEJA_MAX_VENTANA = 16;
+
+// Tópico con su largo, calculado una vez y no en cada mensaje
+struct TopicoMQTT {
+  const char* nombre;
+  uint16_t largo;
+};
+
+inline TopicoMQTT topicoMQTT(const char* nombre) {
+  TopicoMQTT t = {nombre, (uint16_t)strlen(nombre)};
+  return t;
+}
+
+// ====== Cabecera de un PUBLISH ======
+// Lo que hay que dejar libre delante del mensaje para la cabecera (tipo,
+// largo restante de hasta 3 bytes, tópico e id con QoS 1)
+size_t reservaPublish(const TopicoMQTT& topico, uint8_t qos);
+// Escribe la cabecera justo antes de 'datos', que tiene delante al menos
+// reservaPublish() bytes libres; devuelve el comienzo del paquete. Con QoS 1
+// el id queda en 0 en los dos bytes anteriores a 'datos'.
+uint8_t* armarPublish(uint8_t* datos, size_t largo, const TopicoMQTT& topico, uint8_t qos, size_t& largoPaquete);
+
+class SalidaMQTT {
+ public:
+  virtual ~SalidaMQTT() {}
+  // Escribe el paquete completo; false si el socket no lo aceptó
+  virtual bool escribir(const uint8_t* datos, size_t largo) = 0;
+};
+
+struct ConfigBandeja {
+  uint8_t ventana;  // 1 equivale a esperar cada PUBACK
+};
+
+struct EstadisticasBandeja {
+  uint32_t encolados;
+  uint32_t enSuLugar;    // de los encolados, armados con reservarMensaje()
+  uint32_t copiados;     // bytes de mensaje copiados por encolar()
+  uint32_t rechazados;   // no entraban
+  uint32_t enviados;     // PUBLISH escritos, con los reenvíos
+  uint32_t reenviados;
+  uint32_t confirmados;
+  uint32_t desconocidos; // PUBACK de un id que no estaba en vuelo
+  uint32_t rttTotalMs;   // PUBLISH -> PUBACK
+  uint32_t rttPeorMs;
+};
+
+typedef void (*FuncionConfirmacion)(uint32_t marca);
+
+class BandejaMQTT {
+ public:
+  BandejaMQTT(uint8_t* memoria, uint16_t capacidad, const ConfigBandeja& config);
+
+  void alConfirmar(FuncionConfirmacion funcion) { confirmacion = funcion; }
+
+  bool encolar(const TopicoMQTT& topico, const uint8_t* datos, size_t largo, uint32_t marca);
+  bool encolar(const char* topico, const uint8_t* datos, size_t largo, uint32_t marca) {
+    return encolar(topicoMQTT(topico), datos, largo, marca);
+  }
+  // Dónde codificar un mensaje de hasta 'maximo' bytes; nullptr si no hay
+  // tanto lugar seguido (no cuenta como rechazo: con el largo real puede
+  // entrar por encolar()). Hasta confirmar o descartar no se puede llamar a
+  // ningún otro método de la bandeja.
+  uint8_t* reservarMensaje(const TopicoMQTT& topico, size_t maximo);
+  // Con el largo real, que no pasa del máximo reservado; el lugar que sobra
+  // vuelve a la bandeja. Un largo de 0 o mayor descarta la reserva.
+  bool confirmarMensaje(size_t largo, uint32_t marca);
+  void descartarMensaje();
+  // Escribe los que permita la ventana; devuelve cuántos PUBLISH salieron
+  uint8_t enviar(SalidaMQTT& salida, uint32_t ahoraMs);
+  void recibir(uint8_t b, uint32_t ahoraMs);
+  // Antes de abrir una conexión nueva
+  void nuevaConexion();
+  // Los que ya están en vuelo siguen; se espera a que bajen de la nueva ventana
+  void fijarVentana(uint8_t ventana);
+  uint8_t ventana() const { return config.ventana; }
+
+  bool vacia() const { return cantidad == 0; }
+  bool saturada() const { return libres() < capacidad / 4; }
+  uint16_t enVuelo() const { return vuelo; }
+  uint16_t mensajes() const { return cantidad; }
+  uint16_t libres() const { return capacidad - usados; }
+  const EstadisticasBandeja& estadisticas() const { return est; }
+  void reiniciarEstadisticas();
+
+ private:
+  enum EstadoEntrada : uint8_t {
+    ENTRADA_PENDIENTE,
+    ENTRADA_EN_VUELO,
+    ENTRADA_CONFIRMADA,
+    ENTRADA_RELLENO  // hueco al final del buffer: la entrada siguiente empieza en 0
+  };
+  // Cabecera propia delante de cada paquete; se copia con memcpy porque el
+  // ESP8266 no tolera lecturas de 16/32 bits desalineadas
+  // Un reenvío se reconoce por la marca DUP del paquete guardado
+  struct Entrada {
+    uint16_t largo;         // del paquete MQTT
+    uint16_t idPaquete;
+    uint16_t posicionId;    // offset del id dentro del paquete
+    uint8_t estado;
+    uint8_t desplazamiento; // del paquete tras la cabecera: lo que sobró de la reserva
+    uint32_t marca;
+    uint32_t enviadoMs;
+  };
+  static const uint16_t CABECERA = sizeof(Entrada);
+
+  Entrada leer(uint16_t posicion) const;
+  void guardar(uint16_t posicion, const Entrada& e);
+  uint16_t ocupa(const Entrada& e) const;
+  uint16_t siguiente(uint16_t posicion, const Entrada& e) const;
+  bool reservar(uint16_t tamano, uint16_t& posicion);
+  void cerrarReserva(size_t largo, uint32_t marca);
+  void confirmar(uint16_t idPaquete, uint32_t ahoraMs);
+  void liberarConfirmadas();
+
+  uint8_t* memoria;
+  uint16_t capacidad;
+  ConfigBandeja config;
+  FuncionConfirmacion confirmacion;
+
+  uint16_t inicio;    // entrada más vieja
+  uint16_t fin;       // donde va la próxima
+  uint16_t usados;    // bytes, con cabeceras y relleno
+  uint16_t entradas;  // con los rellenos
+  uint16_t cantidad;  // mensajes
+  uint16_t vuelo;
+  uint16_t proximoId;
+
+  // Reserva abierta por reservarMensaje(), para confirmarla o deshacerla
+  TopicoMQTT topicoReserva;
+  uint16_t posicionReserva;  // 0xFFFF sin reserva
+  uint16_t maximoReserva;
+  uint16_t inicioAnterior;
+  uint16_t finAnterior;
+  uint16_t usadosAnterior;
+  uint16_t entradasAnterior;
+
+  // Lectura de los paquetes entrantes
+  uint8_t tipoEntrante;
+  uint32_t restantes;
+  uint8_t leidos;     // bytes del largo o del cuerpo
+  uint8_t estadoLectura;
+  uint16_t idEntrante;
+
+  EstadisticasBandeja est;
+};
+
+// Bandeja con su propio almacenamiento
+template <uint16_t BYTES>
+class BandejaMQTTFija : public BandejaMQTT {
+ public:
+  explicit BandejaMQTTFija(const ConfigBandeja& config) : BandejaMQTT(almacen, BYTES, config) {}
+
+ private:
+  uint8_t almacen[BYTES];
+};
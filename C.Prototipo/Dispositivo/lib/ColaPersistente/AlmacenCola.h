@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ====== Almacenamiento de la cola persistente ======
+// La cola se guarda en segmentos numerados de solo-anexar. Esta interfaz
+// separa el formato del log del sistema de archivos concreto (LittleFS en el
+// dispositivo, memoria o disco en el host).
+class AlmacenCola {
+ public:
+  virtual ~AlmacenCola() {}
+
+  virtual bool anexar(uint32_t segmento, const uint8_t* datos, size_t largo) = 0;
+  virtual size_t leer(uint32_t segmento, uint32_t offset, uint8_t* datos, size_t largo) = 0;
+  virtual uint32_t tamano(uint32_t segmento) = 0;  // 0 si no existe
+  virtual void borrar(uint32_t segmento) = 0;
+
+  // Rango de segmentos presentes; false si no hay ninguno
+  virtual bool rango(uint32_t& primero, uint32_t& ultimo) = 0;
+
+  // Bloque chico de estado (cursor de lectura, secuencia reservada)
+  virtual bool guardarEstado(const uint8_t* datos, size_t largo) = 0;
+  virtual bool cargarEstado(uint8_t* datos, size_t largo) = 0;
+};
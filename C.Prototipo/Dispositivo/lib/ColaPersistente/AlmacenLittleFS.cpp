@@ -0,0 +1,112 @@
+#if defined(ARDUINO)
+
+#include "AlmacenLittleFS.h"
+
+#include <stdlib.h>
+
+static const char* DIRECTORIO_COLA = "/cola";
+static const char* ARCHIVO_ESTADO = "/cola/estado";
+
+AlmacenLittleFS::AlmacenLittleFS(fs::FS& sistema)
+    : sistema(sistema), segmentoLectura(0), hayLectura(false) {}
+
+bool AlmacenLittleFS::iniciar() {
+  if (!sistema.exists(DIRECTORIO_COLA)) {
+    return sistema.mkdir(DIRECTORIO_COLA);
+  }
+  return true;
+}
+
+void AlmacenLittleFS::ruta(uint32_t segmento, char* destino) {
+  snprintf(destino, 24, "%s/%08lx", DIRECTORIO_COLA, (unsigned long)segmento);
+}
+
+void AlmacenLittleFS::cerrarLectura() {
+  if (hayLectura) {
+    archivoLectura.close();
+    hayLectura = false;
+  }
+}
+
+bool AlmacenLittleFS::anexar(uint32_t segmento, const uint8_t* datos, size_t largo) {
+  // Un handle de lectura abierto no vería lo anexado
+  if (hayLectura && segmentoLectura == segmento) cerrarLectura();
+
+  char nombre[24];
+  ruta(segmento, nombre);
+  File f = sistema.open(nombre, "a");
+  if (!f) return false;
+  size_t escritos = f.write(datos, largo);
+  f.close();
+  return escritos == largo;
+}
+
+size_t AlmacenLittleFS::leer(uint32_t segmento, uint32_t offset, uint8_t* datos, size_t largo) {
+  if (!hayLectura || segmentoLectura != segmento) {
+    cerrarLectura();
+    char nombre[24];
+    ruta(segmento, nombre);
+    if (!sistema.exists(nombre)) return 0;
+    archivoLectura = sistema.open(nombre, "r");
+    if (!archivoLectura) return 0;
+    segmentoLectura = segmento;
+    hayLectura = true;
+  }
+  if (!archivoLectura.seek(offset, SeekSet)) return 0;
+  return archivoLectura.read(datos, largo);
+}
+
+uint32_t AlmacenLittleFS::tamano(uint32_t segmento) {
+  if (hayLectura && segmentoLectura == segmento) {
+    return archivoLectura.size();
+  }
+  char nombre[24];
+  ruta(segmento, nombre);
+  if (!sistema.exists(nombre)) return 0;
+  File f = sistema.open(nombre, "r");
+  if (!f) return 0;
+  uint32_t t = f.size();
+  f.close();
+  return t;
+}
+
+void AlmacenLittleFS::borrar(uint32_t segmento) {
+  if (hayLectura && segmentoLectura == segmento) cerrarLectura();
+  char nombre[24];
+  ruta(segmento, nombre);
+  sistema.remove(nombre);
+}
+
+bool AlmacenLittleFS::rango(uint32_t& primero, uint32_t& ultimo) {
+  bool hay = false;
+  Dir dir = sistema.openDir(DIRECTORIO_COLA);
+  while (dir.next()) {
+    String nombre = dir.fileName();
+    char* fin = nullptr;
+    uint32_t id = strtoul(nombre.c_str(), &fin, 16);
+    if (fin == nombre.c_str() || *fin != '\0') continue;  // "estado" u otros archivos
+    if (!hay || id < primero) primero = id;
+    if (!hay || id > ultimo) ultimo = id;
+    hay = true;
+  }
+  return hay;
+}
+
+bool AlmacenLittleFS::guardarEstado(const uint8_t* datos, size_t largo) {
+  File f = sistema.open(ARCHIVO_ESTADO, "w");
+  if (!f) return false;
+  size_t escritos = f.write(datos, largo);
+  f.close();
+  return escritos == largo;
+}
+
+bool AlmacenLittleFS::cargarEstado(uint8_t* datos, size_t largo) {
+  if (!sistema.exists(ARCHIVO_ESTADO)) return false;
+  File f = sistema.open(ARCHIVO_ESTADO, "r");
+  if (!f) return false;
+  size_t leidos = f.read(datos, largo);
+  f.close();
+  return leidos == largo;
+}
+
+#endif
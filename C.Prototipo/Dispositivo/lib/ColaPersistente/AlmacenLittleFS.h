@@ -0,0 +1,37 @@
+#pragma once
+
+#if defined(ARDUINO)
+
+#include <LittleFS.h>
+
+#include "AlmacenCola.h"
+
+// ====== Almacén de la cola sobre LittleFS ======
+// Un archivo por segmento en /cola/<id hex> y el estado en /cola/estado.
+// Se mantiene abierto el segmento que se está leyendo para no reabrirlo en
+// cada mensaje durante el drenado.
+class AlmacenLittleFS : public AlmacenCola {
+ public:
+  explicit AlmacenLittleFS(fs::FS& sistema);
+
+  bool iniciar();
+
+  bool anexar(uint32_t segmento, const uint8_t* datos, size_t largo) override;
+  size_t leer(uint32_t segmento, uint32_t offset, uint8_t* datos, size_t largo) override;
+  uint32_t tamano(uint32_t segmento) override;
+  void borrar(uint32_t segmento) override;
+  bool rango(uint32_t& primero, uint32_t& ultimo) override;
+  bool guardarEstado(const uint8_t* datos, size_t largo) override;
+  bool cargarEstado(uint8_t* datos, size_t largo) override;
+
+ private:
+  static void ruta(uint32_t segmento, char* destino);
+  void cerrarLectura();
+
+  fs::FS& sistema;
+  File archivoLectura;
+  uint32_t segmentoLectura;
+  bool hayLectura;
+};
+
+#endif
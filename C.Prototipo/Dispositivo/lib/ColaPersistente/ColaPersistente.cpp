@@ -0,0 +1,324 @@
+#include "ColaPersistente.h"
+
+#include <string.h>
+
+// Formato de registro (little endian):
+// [0xA5][topico | prioritario<<7][largo:2][secuencia:4][crc8 del payload][payload]
+static const uint8_t MAGIA_REGISTRO = 0xA5;
+static const size_t TAMANO_CABECERA = 9;
+static const uint32_t MAGIA_ESTADO = 0x4C4F4731;  // "LOG1"
+static const size_t TAMANO_ESTADO = 16;
+
+static void escribir32(uint8_t* p, uint32_t v) {
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = (v >> 24) & 0xFF;
+}
+
+static uint32_t leer32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+ColaPersistente::ColaPersistente(AlmacenCola& almacen, const ConfigCola& config)
+    : almacen(almacen), config(config), stats{0, 0, 0, 0, 0},
+      segLectura(0), offLectura(0), segEscritura(0), tamanoEscritura(0), pendientes(0),
+      secuencia(0), limiteSecuencia(0), enviadosSinCursor(0),
+      usadoEscritura(0), registrosEnBuffer(0), fichas(0), ultimoRellenoMs(0) {
+  if (this->config.maxSegmentos < 2) this->config.maxSegmentos = 2;
+  if (this->config.mensajesPorCursor == 0) this->config.mensajesPorCursor = 1;
+}
+
+bool ColaPersistente::iniciar(uint32_t semillaSecuencia) {
+  uint8_t estado[TAMANO_ESTADO];
+  bool hayEstado = almacen.cargarEstado(estado, TAMANO_ESTADO) && leer32(estado) == MAGIA_ESTADO;
+
+  uint32_t primero = 0, ultimo = 0;
+  bool haySegmentos = almacen.rango(primero, ultimo);
+
+  if (hayEstado) {
+    segLectura = leer32(estado + 4);
+    offLectura = leer32(estado + 8);
+    limiteSecuencia = leer32(estado + 12);
+  } else {
+    segLectura = haySegmentos ? primero : 0;
+    offLectura = 0;
+    limiteSecuencia = semillaSecuencia;
+  }
+
+  // Sin estado (o con uno viejo) los registros guardados marcan el piso: se
+  // revisan también los ya consumidos antes de borrarlos
+  uint32_t mayor = 0;
+  bool hayRegistros = false;
+  if (haySegmentos) {
+    for (uint32_t s = primero; s <= ultimo; s++) {
+      hayRegistros |= mayorSecuencia(s, mayor);
+    }
+  }
+  if (hayRegistros && mayor >= limiteSecuencia) {
+    limiteSecuencia = mayor + 1;
+  }
+
+  if (!haySegmentos) {
+    segEscritura = segLectura;
+    offLectura = 0;
+    tamanoEscritura = 0;
+  } else {
+    if (segLectura < primero) {
+      segLectura = primero;
+      offLectura = 0;
+    }
+    // Segmentos ya consumidos cuyo borrado no llegó a hacerse antes del corte
+    for (uint32_t s = primero; s < segLectura && s <= ultimo; s++) {
+      almacen.borrar(s);
+    }
+    segEscritura = (ultimo > segLectura) ? ultimo : segLectura;
+    tamanoEscritura = almacen.tamano(segEscritura);
+    if (offLectura > almacen.tamano(segLectura)) {
+      offLectura = almacen.tamano(segLectura);
+    }
+  }
+
+  pendientes = 0;
+  uint32_t fin = 0;
+  for (uint32_t s = segLectura; s <= segEscritura; s++) {
+    pendientes += contarRegistros(s, s == segLectura ? offLectura : 0, fin);
+  }
+
+  // Un registro a medio escribir al final del último segmento dejaría
+  // inalcanzables los siguientes: se continúa en un segmento nuevo
+  if (tamanoEscritura > 0 && fin != tamanoEscritura) {
+    stats.corruptos++;
+    segEscritura++;
+    tamanoEscritura = 0;
+  }
+
+  // Se saltea el resto del bloque reservado antes del reinicio
+  secuencia = limiteSecuencia;
+  limiteSecuencia = secuencia + BLOQUE_SECUENCIA;
+  guardarCursor();
+  return true;
+}
+
+void ColaPersistente::iniciarSinAlmacen(uint32_t semillaSecuencia) {
+  secuencia = semillaSecuencia;
+  limiteSecuencia = secuencia + BLOQUE_SECUENCIA;
+}
+
+uint32_t ColaPersistente::siguienteSecuencia() {
+  if (secuencia >= limiteSecuencia) {
+    limiteSecuencia = secuencia + BLOQUE_SECUENCIA;
+    guardarCursor();
+  }
+  return secuencia++;
+}
+
+bool ColaPersistente::encolar(uint8_t topico, bool prioritario, uint32_t seq, const uint8_t* datos, size_t largo) {
+  if (largo > COLA_MAX_MENSAJE) {
+    stats.descartados++;
+    return false;
+  }
+  size_t tamanoRegistro = TAMANO_CABECERA + largo;
+
+  if (tamanoEscritura > 0 && tamanoEscritura + tamanoRegistro > config.tamanoSegmento) {
+    if (segmentosEnUso() >= config.maxSegmentos) {
+      switch (config.politica) {
+        case DESCARTAR_NUEVOS:
+          stats.descartados++;
+          return false;
+        case DESCARTAR_BAJA_PRIORIDAD:
+          if (!prioritario) {
+            stats.descartados++;
+            return false;
+          }
+          descartarSegmentoMasViejo();
+          break;
+        case DESCARTAR_ANTIGUOS:
+          descartarSegmentoMasViejo();
+          break;
+      }
+    }
+    sincronizar();
+    segEscritura++;
+    tamanoEscritura = 0;
+  }
+
+  if (usadoEscritura + tamanoRegistro > COLA_BUFFER_ESCRITURA) {
+    sincronizar();
+  }
+
+  uint8_t* p = bufferEscritura + usadoEscritura;
+  p[0] = MAGIA_REGISTRO;
+  p[1] = (topico & 0x7F) | (prioritario ? 0x80 : 0x00);
+  p[2] = largo & 0xFF;
+  p[3] = (largo >> 8) & 0xFF;
+  escribir32(p + 4, seq);
+  p[8] = crc8(datos, largo);
+  memcpy(p + TAMANO_CABECERA, datos, largo);
+
+  usadoEscritura += tamanoRegistro;
+  tamanoEscritura += tamanoRegistro;
+  registrosEnBuffer++;
+  pendientes++;
+  stats.encolados++;
+  return true;
+}
+
+void ColaPersistente::sincronizar() {
+  if (usadoEscritura == 0) return;
+  if (almacen.anexar(segEscritura, bufferEscritura, usadoEscritura)) {
+    stats.escrituras++;
+  } else {
+    // Flash llena o error de escritura: esos registros se pierden
+    pendientes -= registrosEnBuffer;
+    stats.descartados += registrosEnBuffer;
+    tamanoEscritura -= usadoEscritura;
+  }
+  usadoEscritura = 0;
+  registrosEnBuffer = 0;
+}
+
+void ColaPersistente::fijarDrenado(uint16_t mensajesPorSegundo, uint16_t rafaga) {
+  config.mensajesPorSegundo = mensajesPorSegundo;
+  config.rafaga = rafaga;
+  uint32_t maxFichas = (uint32_t)rafaga * 1000U;
+  if (fichas > maxFichas) fichas = maxFichas;
+}
+
+uint16_t ColaPersistente::drenar(uint32_t ahoraMs, FuncionEnvioCola enviar) {
+  uint32_t transcurrido = ahoraMs - ultimoRellenoMs;
+  ultimoRellenoMs = ahoraMs;
+  uint32_t maxFichas = (uint32_t)config.rafaga * 1000U;
+  uint32_t nuevas = (transcurrido > maxFichas) ? maxFichas : transcurrido * config.mensajesPorSegundo;
+  fichas = (fichas + nuevas > maxFichas) ? maxFichas : fichas + nuevas;
+
+  uint16_t enviados = 0;
+  while (pendientes > 0 && fichas >= 1000) {
+    if (segLectura == segEscritura && usadoEscritura > 0) {
+      sincronizar();
+    }
+
+    Cabecera c;
+    if (!leerCabecera(segLectura, offLectura, c)) {
+      if (segLectura < segEscritura) {
+        if (offLectura < almacen.tamano(segLectura)) stats.corruptos++;
+        avanzarSegmentoLectura();
+        continue;
+      }
+      // Nada legible en el segmento de escritura: el contador quedó desfasado
+      pendientes = 0;
+      break;
+    }
+
+    size_t leidos = almacen.leer(segLectura, offLectura + TAMANO_CABECERA, bufferLectura, c.largo);
+    if (leidos != c.largo || crc8(bufferLectura, c.largo) != c.crc) {
+      stats.corruptos++;
+      pendientes--;
+      offLectura += TAMANO_CABECERA + c.largo;
+      continue;
+    }
+
+    if (!enviar(c.topico, c.secuencia, bufferLectura, c.largo)) {
+      break;
+    }
+
+    offLectura += TAMANO_CABECERA + c.largo;
+    pendientes--;
+    fichas -= 1000;
+    enviados++;
+    stats.enviados++;
+
+    if (++enviadosSinCursor >= config.mensajesPorCursor) {
+      guardarCursor();
+    }
+    if (segLectura < segEscritura && offLectura >= almacen.tamano(segLectura)) {
+      avanzarSegmentoLectura();
+    }
+  }
+
+  // Cola vacía: se recicla el segmento de escritura para liberar la flash
+  if (pendientes == 0 && segLectura == segEscritura && tamanoEscritura > 0 && usadoEscritura == 0) {
+    almacen.borrar(segEscritura);
+    segEscritura++;
+    segLectura = segEscritura;
+    offLectura = 0;
+    tamanoEscritura = 0;
+    guardarCursor();
+  } else if (enviados > 0 && pendientes == 0) {
+    guardarCursor();
+  }
+  return enviados;
+}
+
+bool ColaPersistente::leerCabecera(uint32_t segmento, uint32_t offset, Cabecera& c) {
+  uint8_t p[TAMANO_CABECERA];
+  if (almacen.leer(segmento, offset, p, TAMANO_CABECERA) != TAMANO_CABECERA) return false;
+  if (p[0] != MAGIA_REGISTRO) return false;
+  c.topico = p[1] & 0x7F;
+  c.prioritario = (p[1] & 0x80) != 0;
+  c.largo = (uint16_t)p[2] | ((uint16_t)p[3] << 8);
+  c.secuencia = leer32(p + 4);
+  c.crc = p[8];
+  if (c.largo > COLA_MAX_MENSAJE) return false;
+  return offset + TAMANO_CABECERA + c.largo <= almacen.tamano(segmento);
+}
+
+uint32_t ColaPersistente::contarRegistros(uint32_t segmento, uint32_t desde, uint32_t& fin) {
+  uint32_t cantidad = 0;
+  Cabecera c;
+  fin = desde;
+  while (leerCabecera(segmento, fin, c)) {
+    fin += TAMANO_CABECERA + c.largo;
+    cantidad++;
+  }
+  return cantidad;
+}
+
+bool ColaPersistente::mayorSecuencia(uint32_t segmento, uint32_t& mayor) {
+  bool hay = false;
+  Cabecera c;
+  uint32_t offset = 0;
+  while (leerCabecera(segmento, offset, c)) {
+    if (c.secuencia > mayor) mayor = c.secuencia;
+    hay = true;
+    offset += TAMANO_CABECERA + c.largo;
+  }
+  return hay;
+}
+
+void ColaPersistente::descartarSegmentoMasViejo() {
+  uint32_t fin = 0;
+  uint32_t perdidos = contarRegistros(segLectura, offLectura, fin);
+  pendientes -= (perdidos > pendientes) ? pendientes : perdidos;
+  stats.descartados += perdidos;
+  avanzarSegmentoLectura();
+}
+
+void ColaPersistente::avanzarSegmentoLectura() {
+  almacen.borrar(segLectura);
+  segLectura++;
+  offLectura = 0;
+  guardarCursor();
+}
+
+void ColaPersistente::guardarCursor() {
+  uint8_t estado[TAMANO_ESTADO];
+  escribir32(estado, MAGIA_ESTADO);
+  escribir32(estado + 4, segLectura);
+  escribir32(estado + 8, offLectura);
+  escribir32(estado + 12, limiteSecuencia);
+  almacen.guardarEstado(estado, TAMANO_ESTADO);
+  enviadosSinCursor = 0;
+}
+
+// CRC-8 (polinomio 0x07)
+uint8_t ColaPersistente::crc8(const uint8_t* datos, size_t largo) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < largo; i++) {
+    crc ^= datos[i];
+    for (uint8_t b = 0; b < 8; b++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "AlmacenCola.h"
+
+// ====== Cola persistente store-and-forward ======
+// Log circular en flash para los mensajes que no pudieron publicarse.
+//
+// - Cada registro lleva la secuencia del mensaje; la secuencia se reserva en
+//   bloques de BLOQUE_SECUENCIA, así sobrevive a reinicios escribiendo el
+//   estado una vez cada mil mensajes y nunca se repite. Si el estado se
+//   perdió, la secuencia sigue después de la mayor que haya en los segmentos
+//   y de la semilla que pase el equipo (aleatoria): volver a 0 haría que el
+//   backend descarte como repetidos mensajes nuevos.
+// - Cuidado del desgaste: los registros se acumulan en RAM y se escriben en
+//   bloques; los segmentos se borran completos y el cursor de lectura se
+//   guarda cada 'mensajesPorCursor' envíos. Tras un corte pueden reenviarse
+//   hasta esa cantidad de mensajes: el backend los descarta por secuencia.
+// - El drenado está limitado por un balde de fichas (mensajes/seg y ráfaga).
+
+enum PoliticaDescarte {
+  DESCARTAR_ANTIGUOS,        // se borra el segmento más viejo
+  DESCARTAR_NUEVOS,          // se rechaza el mensaje entrante
+  DESCARTAR_BAJA_PRIORIDAD   // se rechazan los no prioritarios; los prioritarios desplazan a los más viejos
+};
+
+struct ConfigCola {
+  uint32_t tamanoSegmento;
+  uint16_t maxSegmentos;
+  PoliticaDescarte politica;
+  uint16_t mensajesPorSegundo;
+  uint16_t rafaga;
+  uint16_t mensajesPorCursor;
+};
+
+struct EstadisticasCola {
+  uint32_t encolados;
+  uint32_t enviados;
+  uint32_t descartados;
+  uint32_t corruptos;
+  uint32_t escrituras;
+};
+
+// Devuelve false si el mensaje no pudo enviarse; queda en la cola
+typedef bool (*FuncionEnvioCola)(uint8_t topico, uint32_t secuencia, const uint8_t* datos, size_t largo);
+
+const size_t COLA_MAX_MENSAJE = 768;       // entra un lote de puntos en JSON
+const size_t COLA_BUFFER_ESCRITURA = 1024;  // siempre mayor que un registro completo
+const uint32_t BLOQUE_SECUENCIA = 1024;
+
+class ColaPersistente {
+ public:
+  ColaPersistente(AlmacenCola& almacen, const ConfigCola& config);
+
+  // Recupera cursor, secuencia y cantidad de pendientes desde la flash.
+  // 'semillaSecuencia' es el piso de la secuencia cuando no hay estado
+  bool iniciar(uint32_t semillaSecuencia = 0);
+
+  // Sin sistema de archivos: no hay cola ni estado, solo la secuencia
+  void iniciarSinAlmacen(uint32_t semillaSecuencia);
+
+  uint32_t siguienteSecuencia();
+  bool encolar(uint8_t topico, bool prioritario, uint32_t secuencia, const uint8_t* datos, size_t largo);
+
+  // Envía lo que permita el balde de fichas; devuelve la cantidad enviada
+  uint16_t drenar(uint32_t ahoraMs, FuncionEnvioCola enviar);
+
+  // Baja a flash los registros pendientes en RAM
+  void sincronizar();
+
+  // Cambia el balde de fichas; las fichas acumuladas no superan la ráfaga nueva
+  void fijarDrenado(uint16_t mensajesPorSegundo, uint16_t rafaga);
+
+  bool vacia() const { return pendientes == 0; }
+  uint32_t cantidadPendientes() const { return pendientes; }
+  uint32_t segmentosEnUso() const { return segEscritura - segLectura + 1; }
+  const EstadisticasCola& estadisticas() const { return stats; }
+
+ private:
+  struct Cabecera {
+    uint8_t topico;
+    bool prioritario;
+    uint16_t largo;
+    uint32_t secuencia;
+    uint8_t crc;
+  };
+
+  bool leerCabecera(uint32_t segmento, uint32_t offset, Cabecera& c);
+  uint32_t contarRegistros(uint32_t segmento, uint32_t desde, uint32_t& fin);
+  bool mayorSecuencia(uint32_t segmento, uint32_t& mayor);
+  void descartarSegmentoMasViejo();
+  void avanzarSegmentoLectura();
+  void guardarCursor();
+  static uint8_t crc8(const uint8_t* datos, size_t largo);
+
+  AlmacenCola& almacen;
+  ConfigCola config;
+  EstadisticasCola stats;
+
+  uint32_t segLectura;
+  uint32_t offLectura;
+  uint32_t segEscritura;
+  uint32_t tamanoEscritura;   // bytes del segmento de escritura, incluido el buffer
+  uint32_t pendientes;
+
+  uint32_t secuencia;
+  uint32_t limiteSecuencia;
+  uint16_t enviadosSinCursor;
+
+  uint8_t bufferEscritura[COLA_BUFFER_ESCRITURA];
+  size_t usadoEscritura;
+  uint16_t registrosEnBuffer;
+  uint8_t bufferLectura[COLA_MAX_MENSAJE];
+
+  uint32_t fichas;            // en milésimas de mensaje
+  uint32_t ultimoRellenoMs;
+};
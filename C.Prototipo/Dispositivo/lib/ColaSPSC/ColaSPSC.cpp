@@ -0,0 +1,40 @@
+#include "ColaSPSC.h"
+
+ColaSPSC::ColaSPSC(uint16_t capacidad)
+    : capacidad(capacidad), mascara((uint32_t)capacidad - 1), cabeza(0), cola(0), maximoCantidad(0), rechazadosTotal(0) {}
+
+int32_t ColaSPSC::indiceLibre() {
+  uint32_t c = cabeza.load(std::memory_order_relaxed);
+  // acquire: el consumidor ya terminó de leer el registro que se reutiliza
+  if (c - cola.load(std::memory_order_acquire) >= capacidad) {
+    rechazadosTotal.store(rechazadosTotal.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return -1;
+  }
+  return (int32_t)(c & mascara);
+}
+
+void ColaSPSC::publicar() {
+  uint32_t c = cabeza.load(std::memory_order_relaxed) + 1;
+  // release: el registro queda escrito antes de que el consumidor vea el índice
+  cabeza.store(c, std::memory_order_release);
+  uint16_t n = (uint16_t)(c - cola.load(std::memory_order_relaxed));
+  if (n > maximoCantidad.load(std::memory_order_relaxed)) maximoCantidad.store(n, std::memory_order_relaxed);
+}
+
+int32_t ColaSPSC::indiceFrente() const {
+  uint32_t t = cola.load(std::memory_order_relaxed);
+  if (cabeza.load(std::memory_order_acquire) == t) return -1;
+  return (int32_t)(t & mascara);
+}
+
+void ColaSPSC::liberar() {
+  uint32_t t = cola.load(std::memory_order_relaxed);
+  if (cabeza.load(std::memory_order_relaxed) == t) return;
+  cola.store(t + 1, std::memory_order_release);
+}
+
+uint16_t ColaSPSC::cantidad() const {
+  // La cola primero: leída después, la cabeza nunca queda detrás
+  uint32_t t = cola.load(std::memory_order_acquire);
+  return (uint16_t)(cabeza.load(std::memory_order_acquire) - t);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// ====== Cola sin bloqueo de un productor y un consumidor ======
+// Anillo de registros de tamaño fijo entre dos tareas que corren en núcleos
+// distintos (en el ESP32, el muestreo en uno y la red en el otro). Ninguna
+// toma un mutex ni deshabilita interrupciones: cada índice lo escribe un solo
+// lado y el otro lo lee con orden acquire/release, así un registro se ve
+// completo o no se ve.
+//
+// El productor escribe en el lugar, sin copias:
+//
+//   Mensaje* m = cola.reservar();   // nullptr si está llena
+//   ... completar *m ...
+//   cola.publicar();
+//
+// y el consumidor lee del frente y lo libera cuando terminó:
+//
+//   const Mensaje* m = cola.frente();   // nullptr si está vacía
+//   ... usar *m ...
+//   cola.liberar();
+//
+// Llena, reservar() cuenta un rechazo y el productor decide qué descartar.
+// cantidad(), maximo() y rechazados() se pueden leer desde cualquier tarea.
+//
+// La capacidad tiene que ser potencia de 2 (los índices corren libres y se
+// enmascaran). No depende de Arduino.
+
+class ColaSPSC {
+ public:
+  explicit ColaSPSC(uint16_t capacidad);
+
+  // ====== Productor ======
+  // Índice del registro libre, o -1 si la cola está llena
+  int32_t indiceLibre();
+  void publicar();
+
+  // ====== Consumidor ======
+  // Índice del registro más viejo, o -1 si la cola está vacía
+  int32_t indiceFrente() const;
+  void liberar();
+
+  // ====== Cualquiera ======
+  uint16_t cantidad() const;
+  uint16_t capacidadTotal() const { return capacidad; }
+  uint16_t maximo() const { return maximoCantidad.load(std::memory_order_relaxed); }
+  uint32_t publicados() const { return cabeza.load(std::memory_order_relaxed); }
+  uint32_t rechazados() const { return rechazadosTotal.load(std::memory_order_relaxed); }
+
+ private:
+  const uint16_t capacidad;
+  const uint32_t mascara;
+  std::atomic<uint32_t> cabeza;  // la escribe el productor
+  std::atomic<uint32_t> cola;    // la escribe el consumidor
+  std::atomic<uint16_t> maximoCantidad;
+  std::atomic<uint32_t> rechazadosTotal;
+};
+
+// Con el almacenamiento adentro: ColaSPSCFija<Mensaje, 16> salida;
+template <typename T, uint16_t N>
+class ColaSPSCFija : public ColaSPSC {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "la capacidad tiene que ser potencia de 2");
+
+ public:
+  ColaSPSCFija() : ColaSPSC(N) {}
+
+  T* reservar() {
+    int32_t i = indiceLibre();
+    return i < 0 ? nullptr : &registros[i];
+  }
+  const T* frente() const {
+    int32_t i = indiceFrente();
+    return i < 0 ? nullptr : &registros[i];
+  }
+
+ private:
+  T registros[N];
+};
@@ -0,0 +1,169 @@
+#include "DetectorGiros.h"
+
+#include <math.h>
+
+static const double GRADOS_A_RAD = M_PI / 180.0;
+static const float METROS_POR_GRADO = 111194.93f;
+
+const ConfigDetectorGiros DETECTOR_GIROS_RUMBO = {
+  DETECTOR_RUMBO, 2.5f,
+  15, 20.0f, 3.0f, 8,
+  0.0f, 0.0f, 0.0f, 0.0f, 0.0f
+};
+
+const ConfigDetectorGiros DETECTOR_GIROS_CURVATURA = {
+  DETECTOR_CURVATURA, 2.5f,
+  0, 0.0f, 0.0f, 0,
+  3.0f, 21.0f, 1.5f, 0.6f, 50.0f
+};
+
+float diferenciaAngulo(float a, float b) {
+  float d = fmodf(a - b, 360.0f);
+  if (d > 180.0f) d -= 360.0f;
+  if (d <= -180.0f) d += 360.0f;
+  return d;
+}
+
+DetectorGiros::DetectorGiros(const ConfigDetectorGiros& config) : config(config) {
+  if (this->config.muestrasVentana > DETECTOR_MAX_MUESTRAS) {
+    this->config.muestrasVentana = DETECTOR_MAX_MUESTRAS;
+  }
+  if (this->config.muestrasVentana < 2) this->config.muestrasVentana = 2;
+  reiniciar();
+}
+
+void DetectorGiros::reiniciar() {
+  enCurva = false;
+  cambio = 0.0f;
+  indiceMuestra = 0;
+  cantidadMuestras = 0;
+  contador = 0;
+  indiceNodo = 0;
+  cantidadNodos = 0;
+  hayUltimo = false;
+  recorrido = 0.0f;
+  rumboEntrada = 0.0f;
+  recorridoCalma = 0.0f;
+}
+
+EventoGiro DetectorGiros::agregar(const PuntoGiro& p) {
+  return config.tipo == DETECTOR_CURVATURA ? agregarCurvatura(p) : agregarRumbo(p);
+}
+
+// ====== Rumbo del GPS en ventana de fixes ======
+EventoGiro DetectorGiros::agregarRumbo(const PuntoGiro& p) {
+  muestras[indiceMuestra] = p;
+  indiceMuestra = (indiceMuestra + 1) % config.muestrasVentana;
+  if (cantidadMuestras < config.muestrasVentana) {
+    cantidadMuestras++;
+    return GIRO_NINGUNO;
+  }
+  const PuntoGiro& inicio = muestras[indiceMuestra];
+  float cosLat = (float)cos(p.lat * GRADOS_A_RAD);
+  float dx = (float)(p.lon - inicio.lon) * cosLat * METROS_POR_GRADO;
+  float dy = (float)(p.lat - inicio.lat) * METROS_POR_GRADO;
+  if (sqrtf(dx * dx + dy * dy) < config.distanciaMinimaM || p.velocidad < config.velocidadMinimaKmh) {
+    return GIRO_NINGUNO;
+  }
+
+  cambio = fabsf(diferenciaAngulo(p.rumbo, inicio.rumbo));
+  if (cambio > config.cambioRumbo) {
+    contador++;
+    if (contador >= config.confirmaciones) {
+      enCurva = false;
+      contador = 0;
+      // La ventana vuelve a llenarse con la calle nueva: si no, los rumbos de
+      // antes de la esquina confirmarían el mismo giro otra vez
+      indiceMuestra = 0;
+      cantidadMuestras = 0;
+      return GIRO_CONFIRMADO;
+    }
+    if (!enCurva) {
+      enCurva = true;
+      return GIRO_POSIBLE;
+    }
+    return GIRO_NINGUNO;
+  }
+  contador = 0;
+  if (enCurva) {
+    enCurva = false;
+    return GIRO_DESCARTADO;
+  }
+  return GIRO_NINGUNO;
+}
+
+// ====== Curvatura sobre la distancia recorrida ======
+// Rumbo del nodo que quedó 'metros' atrás del último (o el más viejo que haya)
+float DetectorGiros::rumboAtras(float metros) const {
+  uint8_t ultimo = (indiceNodo + DETECTOR_MAX_NODOS - 1) % DETECTOR_MAX_NODOS;
+  float objetivo = nodos[ultimo].recorrido - metros;
+  uint8_t i = ultimo;
+  for (uint8_t k = 1; k < cantidadNodos; k++) {
+    uint8_t anterior = (i + DETECTOR_MAX_NODOS - 1) % DETECTOR_MAX_NODOS;
+    if (nodos[anterior].recorrido < objetivo) break;
+    i = anterior;
+  }
+  return nodos[i].rumbo;
+}
+
+EventoGiro DetectorGiros::agregarCurvatura(const PuntoGiro& p) {
+  if (p.velocidad < config.velocidadMinimaKmh) {
+    return GIRO_NINGUNO;
+  }
+  if (!hayUltimo) {
+    latUltimo = p.lat;
+    lonUltimo = p.lon;
+    hayUltimo = true;
+    return GIRO_NINGUNO;
+  }
+  float cosLat = (float)cos(p.lat * GRADOS_A_RAD);
+  float dx = (float)(p.lon - lonUltimo) * cosLat * METROS_POR_GRADO;
+  float dy = (float)(p.lat - latUltimo) * METROS_POR_GRADO;
+  float paso = sqrtf(dx * dx + dy * dy);
+  if (paso < config.pasoMetros) {
+    return GIRO_NINGUNO;
+  }
+  latUltimo = p.lat;
+  lonUltimo = p.lon;
+  recorrido += paso;
+
+  float rumbo = atan2f(dx, dy) / (float)GRADOS_A_RAD;
+  if (rumbo < 0.0f) rumbo += 360.0f;
+  nodos[indiceNodo].recorrido = recorrido;
+  nodos[indiceNodo].rumbo = rumbo;
+  indiceNodo = (indiceNodo + 1) % DETECTOR_MAX_NODOS;
+  if (cantidadNodos < DETECTOR_MAX_NODOS) cantidadNodos++;
+
+  // Hace falta una ventana completa de recorrido para medir curvatura
+  float primero = nodos[(indiceNodo + DETECTOR_MAX_NODOS - cantidadNodos) % DETECTOR_MAX_NODOS].recorrido;
+  if (recorrido - primero < config.largoVentanaM) {
+    return GIRO_NINGUNO;
+  }
+
+  float rumboVentana = rumboAtras(config.largoVentanaM);
+  cambio = diferenciaAngulo(rumbo, rumboVentana);
+  float curvatura = fabsf(cambio) / config.largoVentanaM;
+
+  if (!enCurva) {
+    if (curvatura > config.curvaturaEntrada) {
+      enCurva = true;
+      rumboEntrada = rumboVentana;
+      recorridoCalma = 0.0f;
+      return GIRO_POSIBLE;
+    }
+    return GIRO_NINGUNO;
+  }
+
+  if (curvatura < config.curvaturaSalida) {
+    recorridoCalma += paso;
+  } else {
+    recorridoCalma = 0.0f;
+  }
+  if (recorridoCalma < config.largoVentanaM) {
+    return GIRO_NINGUNO;
+  }
+  // Curva terminada: se mide el giro total con el rumbo ya estable
+  enCurva = false;
+  cambio = diferenciaAngulo(rumbo, rumboEntrada);
+  return fabsf(cambio) >= config.giroMinimo ? GIRO_CONFIRMADO : GIRO_DESCARTADO;
+}
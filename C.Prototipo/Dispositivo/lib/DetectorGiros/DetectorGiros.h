@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdint.h>
+
+// ====== Detección de giros ======
+// Decide cuándo el vehículo dobló y hay que cerrar la calle en curso. Se
+// alimenta con los puntos ya filtrados (uno por fix) y no depende de
+// Arduino, así se puede evaluar en la PC con trazas NMEA grabadas
+// (herramientas/replay_giros).
+//
+// Dos algoritmos:
+//
+// - DETECTOR_RUMBO: el original. Compara el rumbo del GPS entre el primer y
+//   el último punto de una ventana de 'muestrasVentana' fixes; si difiere
+//   más de 'cambioRumbo' durante 'confirmaciones' fixes seguidos, hay giro.
+//   Depende del tiempo (a baja velocidad la ventana cubre pocos metros) y
+//   del rumbo del GPS, que es ruidoso cuando el vehículo anda despacio.
+//
+// - DETECTOR_CURVATURA: trabaja sobre la distancia recorrida. Arma nodos
+//   cada 'pasoMetros' con el rumbo del desplazamiento y mide la curvatura
+//   como el cambio de rumbo en los últimos 'largoVentanaM' metros. Entra en
+//   curva con más de 'curvaturaEntrada' grados/metro, sale cuando la
+//   curvatura baja de 'curvaturaSalida' durante una ventana completa, y
+//   confirma el giro si el cambio total de rumbo supera 'giroMinimo'. Las
+//   curvas suaves de una avenida no llegan al umbral y un giro lento en una
+//   esquina no se pierde por la velocidad.
+
+enum TipoDetectorGiro {
+  DETECTOR_RUMBO,
+  DETECTOR_CURVATURA
+};
+
+enum EventoGiro {
+  GIRO_NINGUNO,
+  GIRO_POSIBLE,      // empezó una curva
+  GIRO_DESCARTADO,   // la curva no llegó a giro
+  GIRO_CONFIRMADO    // cambio de calle
+};
+
+struct ConfigDetectorGiros {
+  TipoDetectorGiro tipo;
+  float velocidadMinimaKmh;  // por debajo no se evalúa (rumbo sin sentido)
+
+  // DETECTOR_RUMBO
+  uint8_t muestrasVentana;
+  float cambioRumbo;
+  float distanciaMinimaM;
+  uint8_t confirmaciones;
+
+  // DETECTOR_CURVATURA
+  float pasoMetros;
+  float largoVentanaM;
+  float curvaturaEntrada;  // grados por metro
+  float curvaturaSalida;
+  float giroMinimo;        // grados
+};
+
+struct PuntoGiro {
+  double lat;
+  double lon;
+  float rumbo;      // del GPS o del filtro
+  float velocidad;  // km/h
+};
+
+const uint8_t DETECTOR_MAX_MUESTRAS = 32;
+const uint8_t DETECTOR_MAX_NODOS = 32;
+
+// Configuraciones de referencia
+extern const ConfigDetectorGiros DETECTOR_GIROS_RUMBO;
+extern const ConfigDetectorGiros DETECTOR_GIROS_CURVATURA;
+
+class DetectorGiros {
+ public:
+  explicit DetectorGiros(const ConfigDetectorGiros& config);
+
+  EventoGiro agregar(const PuntoGiro& p);
+  void reiniciar();
+
+  // true entre GIRO_POSIBLE y GIRO_DESCARTADO/GIRO_CONFIRMADO
+  bool enGiro() const { return enCurva; }
+  // Último cambio de rumbo evaluado (grados), para depuración
+  float ultimoCambio() const { return cambio; }
+  const ConfigDetectorGiros& configuracion() const { return config; }
+
+ private:
+  EventoGiro agregarRumbo(const PuntoGiro& p);
+  EventoGiro agregarCurvatura(const PuntoGiro& p);
+  float rumboAtras(float metros) const;
+
+  ConfigDetectorGiros config;
+  bool enCurva;
+  float cambio;
+
+  // DETECTOR_RUMBO
+  PuntoGiro muestras[DETECTOR_MAX_MUESTRAS];
+  uint8_t indiceMuestra;
+  uint8_t cantidadMuestras;
+  uint8_t contador;
+
+  // DETECTOR_CURVATURA
+  struct Nodo {
+    float recorrido;  // metros desde el inicio
+    float rumbo;      // rumbo del paso que termina en este nodo
+  };
+  Nodo nodos[DETECTOR_MAX_NODOS];
+  uint8_t indiceNodo;
+  uint8_t cantidadNodos;
+  bool hayUltimo;
+  double latUltimo;
+  double lonUltimo;
+  float recorrido;
+  float rumboEntrada;
+  float recorridoCalma;  // metros seguidos con curvatura baja dentro de la curva
+};
+
+// Diferencia de ángulos en (-180, 180]
+float diferenciaAngulo(float a, float b);
@@ -0,0 +1,415 @@
+#include "EscenarioGPS.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const double GRADOS_A_RAD = M_PI / 180.0;
+static const double METROS_POR_GRADO = 111194.93;
+static const double NUDOS_A_KMH = 1.852;
+static const uint32_t PASO_INTEGRACION_MS = 1000;
+static const uint32_t MS_POR_DIA = 86400000UL;
+
+// ====== Fuente en memoria ======
+FuenteEscenarioMemoria::FuenteEscenarioMemoria(const char* texto, size_t largo)
+    : texto(texto), largo(largo), posicion(0) {}
+
+bool FuenteEscenarioMemoria::leerLinea(char* destino, size_t tamano) {
+  if (posicion >= largo) return false;
+  size_t n = 0;
+  while (posicion < largo && texto[posicion] != '\n') {
+    char c = texto[posicion++];
+    if (c != '\r' && n + 1 < tamano) destino[n++] = c;
+  }
+  posicion++;  // el '\n'
+  destino[n] = '\0';
+  return true;
+}
+
+// ====== Utilidades ======
+double EscenarioGPS::Rampa::valor(uint32_t t) const {
+  if (duracion == 0 || (int32_t)(t - inicio) >= (int32_t)duracion) return hasta;
+  if ((int32_t)(t - inicio) <= 0) return desde;
+  return desde + (hasta - desde) * (double)(t - inicio) / duracion;
+}
+
+static double normalizarRumbo(double grados) {
+  double r = fmod(grados, 360.0);
+  return r < 0 ? r + 360.0 : r;
+}
+
+// Número completo (sin basura atrás) o false
+static bool leerNumero(const char* texto, double& valor) {
+  if (texto == nullptr || *texto == '\0') return false;
+  char* fin;
+  valor = strtod(texto, &fin);
+  return *fin == '\0';
+}
+
+// "hhmmss.ss" de NMEA
+static bool horaNMEA(const char* texto, uint32_t& ms) {
+  double v;
+  if (!leerNumero(texto, v) || v < 0 || v >= 240000) return false;
+  uint32_t h = (uint32_t)(v / 10000);
+  uint32_t m = ((uint32_t)(v / 100)) % 100;
+  double s = fmod(v, 100.0);
+  ms = (h * 3600 + m * 60) * 1000 + (uint32_t)(s * 1000 + 0.5);
+  return true;
+}
+
+// "ddmm.mmmm" + hemisferio
+static bool coordenadaNMEA(const char* valor, const char* hemisferio, double& grados) {
+  double v;
+  if (!leerNumero(valor, v)) return false;
+  int enteros = (int)(v / 100);
+  grados = enteros + (v - enteros * 100) / 60.0;
+  if (hemisferio[0] == 'S' || hemisferio[0] == 'W') grados = -grados;
+  return true;
+}
+
+// "...Thh:mm:ss[.sss]..." de ISO 8601
+static bool horaISO(const char* texto, uint32_t& ms) {
+  const char* t = strchr(texto, 'T');
+  if (t == nullptr) return false;
+  int h, m;
+  double s;
+  if (sscanf(t + 1, "%d:%d:%lf", &h, &m, &s) != 3) return false;
+  ms = (uint32_t)((h * 3600 + m * 60) * 1000 + (uint32_t)(s * 1000 + 0.5));
+  return true;
+}
+
+// Valor de un atributo XML con comillas simples o dobles
+static bool atributo(const char* etiqueta, const char* nombre, double& valor) {
+  char buscado[16];
+  snprintf(buscado, sizeof(buscado), " %s=", nombre);
+  const char* p = strstr(etiqueta, buscado);
+  if (p == nullptr) return false;
+  p += strlen(buscado);
+  if (*p != '"' && *p != '\'') return false;
+  char* fin;
+  valor = strtod(p + 1, &fin);
+  return fin != p + 1 && *fin == *p;
+}
+
+// ====== Escenario ======
+EscenarioGPS::EscenarioGPS(FuenteEscenario& fuente) : fuente(fuente) {
+  reiniciar();
+}
+
+void EscenarioGPS::reiniciar() {
+  memset(&est, 0, sizeof(est));
+  factor = 1;
+  agotado = false;
+  tiempoGuion = 0;
+  pendiente = PENDIENTE_NADA;
+  lat = 0.0;
+  lon = 0.0;
+  tiempoEstado = 0;
+  rumbo = {0.0, 0.0, 0, 0};
+  velocidad = {0.0, 0.0, 0, 0};
+  satelites = 8;
+  conFix = true;
+  brokerCaido = false;
+  enTraza = false;
+  anclaMs = 0;
+  ultimaHoraMs = 0;
+  diasTraza = 0;
+  hayTramo = false;
+  gpxAbierto = false;
+}
+
+bool EscenarioGPS::muestra(uint32_t tiempoMs, MuestraEscenario& m) {
+  char linea[ESCENARIO_MAX_LINEA];
+  // Todo lo que el guion tiene hasta 'tiempoMs', en orden
+  while (!agotado && (int32_t)(tiempoMs - tiempoGuion) >= 0) {
+    integrar(tiempoGuion);
+    if (pendiente != PENDIENTE_NADA) {
+      conFix = pendiente == PENDIENTE_ENCENDER_GPS;
+      pendiente = PENDIENTE_NADA;
+    }
+    if (!fuente.leerLinea(linea, sizeof(linea))) {
+      agotado = true;
+      break;
+    }
+    est.lineas++;
+    procesarLinea(linea);
+  }
+  integrar(tiempoMs);
+
+  m.lat = lat;
+  m.lon = lon;
+  m.rumbo = hayTramo ? tramo.rumbo : normalizarRumbo(rumbo.valor(tiempoMs));
+  m.velocidad = hayTramo ? tramo.velocidad : velocidad.valor(tiempoMs);
+  m.satelites = satelites;
+  m.conFix = conFix;
+  m.brokerCaido = brokerCaido;
+  return !agotado;
+}
+
+// Lleva la posición hasta 'hasta': sobre el tramo de la traza, o con la
+// velocidad y el rumbo del guion en pasos de hasta un segundo
+void EscenarioGPS::integrar(uint32_t hasta) {
+  if ((int32_t)(hasta - tiempoEstado) <= 0) return;
+  if (hayTramo) {
+    if ((int32_t)(hasta - tramo.tiempoDestino) < 0) {
+      double f = (double)(hasta - tramo.tiempoOrigen) / (tramo.tiempoDestino - tramo.tiempoOrigen);
+      lat = tramo.latOrigen + (tramo.latDestino - tramo.latOrigen) * f;
+      lon = tramo.lonOrigen + (tramo.lonDestino - tramo.lonOrigen) * f;
+      tiempoEstado = hasta;
+      return;
+    }
+    // Después del tramo sigue con su rumbo y su velocidad
+    lat = tramo.latDestino;
+    lon = tramo.lonDestino;
+    tiempoEstado = tramo.tiempoDestino;
+    hayTramo = false;
+    rumbo = {tramo.rumbo, tramo.rumbo, tiempoEstado, 0};
+    velocidad = {tramo.velocidad, tramo.velocidad, tiempoEstado, 0};
+  }
+  while ((int32_t)(hasta - tiempoEstado) > 0) {
+    uint32_t paso = hasta - tiempoEstado;
+    if (paso > PASO_INTEGRACION_MS) paso = PASO_INTEGRACION_MS;
+    uint32_t medio = tiempoEstado + paso / 2;
+    double metros = velocidad.valor(medio) / 3.6 * paso / 1000.0;
+    double r = rumbo.valor(medio) * GRADOS_A_RAD;
+    lat += metros * cos(r) / METROS_POR_GRADO;
+    lon += metros * sin(r) / (METROS_POR_GRADO * cos(lat * GRADOS_A_RAD));
+    tiempoEstado += paso;
+  }
+}
+
+bool EscenarioGPS::procesarLinea(char* linea) {
+  while (*linea == ' ' || *linea == '\t') linea++;
+  if (*linea == '$') return procesarNMEA(linea);
+  if (*linea == '<') return procesarGPX(linea);
+
+  char* comentario = strchr(linea, '#');
+  if (comentario != nullptr) *comentario = '\0';
+  size_t n = strlen(linea);
+  while (n > 0 && (linea[n - 1] == ' ' || linea[n - 1] == '\t')) linea[--n] = '\0';
+  if (n == 0) return true;
+
+  enTraza = false;
+  if (!procesarComando(linea)) {
+    error();
+    return false;
+  }
+  est.comandos++;
+  return true;
+}
+
+bool EscenarioGPS::procesarComando(char* linea) {
+  char* resto;
+  char* comando = strtok_r(linea, " \t", &resto);
+  char* a = strtok_r(nullptr, " \t", &resto);
+  char* b = strtok_r(nullptr, " \t", &resto);
+  if (strtok_r(nullptr, " \t", &resto) != nullptr) return false;
+  double x, y = 0;
+  bool conSegundos = b == nullptr || leerNumero(b, y);
+
+  if (strcmp(comando, "acelerar") == 0) {
+    if (!leerNumero(a, x) || b != nullptr || x < 1 || x > 1000) return false;
+    factor = (uint16_t)x;
+  } else if (strcmp(comando, "inicio") == 0) {
+    if (!leerNumero(a, x) || b == nullptr || !leerNumero(b, y) || fabs(x) > 90 || fabs(y) > 180) return false;
+    lat = x;
+    lon = y;
+  } else if (strcmp(comando, "velocidad") == 0) {
+    if (!leerNumero(a, x) || !conSegundos || x < 0 || y < 0) return false;
+    fijarVelocidad(x, (uint32_t)(y * 1000));
+  } else if (strcmp(comando, "rumbo") == 0) {
+    if (!leerNumero(a, x) || !conSegundos || y < 0) return false;
+    double actual = normalizarRumbo(rumbo.valor(tiempoGuion));
+    double diferencia = normalizarRumbo(x - actual + 180.0) - 180.0;
+    fijarRumbo(rumbo.valor(tiempoGuion) + diferencia, (uint32_t)(y * 1000));
+  } else if (strcmp(comando, "girar") == 0) {
+    if (!leerNumero(a, x) || !conSegundos || y < 0) return false;
+    fijarRumbo(rumbo.valor(tiempoGuion) + x, (uint32_t)(y * 1000));
+  } else if (strcmp(comando, "esperar") == 0) {
+    if (!leerNumero(a, x) || b != nullptr || x < 0) return false;
+    tiempoGuion += (uint32_t)(x * 1000);
+  } else if (strcmp(comando, "satelites") == 0) {
+    if (!leerNumero(a, x) || b != nullptr || x < 0 || x > 99) return false;
+    satelites = (uint8_t)x;
+  } else if (strcmp(comando, "gps") == 0 && a != nullptr && b == nullptr) {
+    if (strcmp(a, "apagado") == 0) conFix = false;
+    else if (strcmp(a, "encendido") == 0) conFix = true;
+    else return false;
+  } else if (strcmp(comando, "broker") == 0 && a != nullptr && b == nullptr) {
+    if (strcmp(a, "caido") == 0) brokerCaido = true;
+    else if (strcmp(a, "conectado") == 0) brokerCaido = false;
+    else return false;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void EscenarioGPS::fijarRumbo(double hasta, uint32_t duracion) {
+  rumbo = {rumbo.valor(tiempoGuion), hasta, tiempoGuion, duracion};
+}
+
+void EscenarioGPS::fijarVelocidad(double hasta, uint32_t duracion) {
+  velocidad = {velocidad.valor(tiempoGuion), hasta, tiempoGuion, duracion};
+}
+
+void EscenarioGPS::error() {
+  est.errores++;
+  if (est.primeraConError == 0) est.primeraConError = est.lineas;
+}
+
+// ====== Trazas ======
+// RMC da posición, velocidad, rumbo y hora; GGA solo los satélites. El resto
+// de las sentencias se ignora sin cortar la traza
+bool EscenarioGPS::procesarNMEA(char* linea) {
+  char* asterisco = strchr(linea, '*');
+  if (asterisco == nullptr) {
+    error();
+    return false;
+  }
+  uint8_t suma = 0;
+  for (const char* p = linea + 1; p < asterisco; p++) suma ^= (uint8_t)*p;
+  if (strtoul(asterisco + 1, nullptr, 16) != suma) {
+    error();
+    return false;
+  }
+  *asterisco = '\0';
+
+  // Campos vacíos incluidos (strtok_r se los saltearía)
+  const uint8_t MAX_CAMPOS = 16;
+  const char* campos[MAX_CAMPOS];
+  uint8_t n = 0;
+  char* p = linea + 1;
+  campos[n++] = p;
+  while ((p = strchr(p, ',')) != nullptr && n < MAX_CAMPOS) {
+    *p++ = '\0';
+    campos[n++] = p;
+  }
+  size_t largoTipo = strlen(campos[0]);
+  const char* tipo = largoTipo >= 3 ? campos[0] + largoTipo - 3 : "";
+
+  if (strcmp(tipo, "GGA") == 0 && n > 7) {
+    double s;
+    if (leerNumero(campos[7], s)) satelites = (uint8_t)s;
+    return true;
+  }
+  if (strcmp(tipo, "RMC") != 0) return true;
+
+  uint32_t hora;
+  if (n < 9 || !horaNMEA(campos[1], hora)) {
+    error();
+    return false;
+  }
+  if (campos[2][0] != 'A') {
+    // Sin fix: desde la hora de la sentencia
+    if (!enTraza) {
+      enTraza = true;
+      diasTraza = 0;
+      anclaMs = tiempoGuion - hora;
+      ultimaHoraMs = hora;
+      conFix = false;
+      return true;
+    }
+    if (hora + MS_POR_DIA / 2 < ultimaHoraMs) diasTraza++;
+    ultimaHoraMs = hora;
+    uint32_t t = anclaMs + hora + diasTraza * MS_POR_DIA;
+    if ((int32_t)(t - tiempoGuion) > 0) {
+      tiempoGuion = t;
+      pendiente = PENDIENTE_APAGAR_GPS;
+    } else {
+      conFix = false;
+    }
+    return true;
+  }
+
+  double latPunto, lonPunto, nudos, curso;
+  if (!coordenadaNMEA(campos[3], campos[4], latPunto) || !coordenadaNMEA(campos[5], campos[6], lonPunto)) {
+    error();
+    return false;
+  }
+  double kmh = leerNumero(campos[7], nudos) ? nudos * NUDOS_A_KMH : NAN;
+  agregarPunto(latPunto, lonPunto, hora, leerNumero(campos[8], curso) ? curso : NAN, kmh);
+  return true;
+}
+
+// Las etiquetas que no son del punto (<gpx>, <trkseg>, <ele>...) se ignoran
+bool EscenarioGPS::procesarGPX(const char* linea) {
+  const char* etiqueta = strstr(linea, "<trkpt");
+  if (etiqueta != nullptr) {
+    if (!atributo(etiqueta, "lat", gpxLat) || !atributo(etiqueta, "lon", gpxLon)) {
+      gpxAbierto = false;
+      error();
+      return false;
+    }
+    gpxAbierto = true;
+    gpxHoraMs = -1;
+  }
+  if (!gpxAbierto) return true;
+
+  const char* hora = strstr(linea, "<time>");
+  uint32_t ms;
+  if (hora != nullptr && horaISO(hora + 6, ms)) gpxHoraMs = (int32_t)ms;
+  const char* sat = strstr(linea, "<sat>");
+  if (sat != nullptr) satelites = (uint8_t)atoi(sat + 5);
+
+  bool cerrado = strstr(linea, "</trkpt>") != nullptr;
+  if (etiqueta != nullptr) {
+    const char* finEtiqueta = strchr(etiqueta, '>');
+    cerrado = cerrado || (finEtiqueta != nullptr && finEtiqueta[-1] == '/');
+  }
+  if (cerrado) {
+    gpxAbierto = false;
+    // Sin <time>, un segundo después del anterior
+    uint32_t horaPunto = gpxHoraMs >= 0 ? (uint32_t)gpxHoraMs : (enTraza ? ultimaHoraMs + 1000 : 0);
+    agregarPunto(gpxLat, gpxLon, horaPunto, NAN, NAN);
+  }
+  return true;
+}
+
+// Rumbo y velocidad en NAN: se toman del tramo
+void EscenarioGPS::agregarPunto(double latPunto, double lonPunto, uint32_t horaMs, double rumboPunto,
+                                double velocidadPunto) {
+  est.puntos++;
+  if (!enTraza) {
+    // El primer punto de la traza queda en el tiempo actual
+    enTraza = true;
+    diasTraza = 0;
+    anclaMs = tiempoGuion - horaMs;
+    ultimaHoraMs = horaMs;
+    lat = latPunto;
+    lon = lonPunto;
+    hayTramo = false;
+    conFix = true;
+    if (!isnan(rumboPunto)) fijarRumbo(rumboPunto, 0);
+    if (!isnan(velocidadPunto)) fijarVelocidad(velocidadPunto, 0);
+    return;
+  }
+  if (horaMs + MS_POR_DIA / 2 < ultimaHoraMs) diasTraza++;
+  ultimaHoraMs = horaMs;
+  uint32_t t = anclaMs + horaMs + diasTraza * MS_POR_DIA;
+  if ((int32_t)(t - tiempoGuion) <= 0) {
+    // Repetido o fuera de orden: salta sin tramo
+    lat = latPunto;
+    lon = lonPunto;
+    return;
+  }
+
+  tramo.latOrigen = lat;
+  tramo.lonOrigen = lon;
+  tramo.latDestino = latPunto;
+  tramo.lonDestino = lonPunto;
+  tramo.tiempoOrigen = tiempoGuion;
+  tramo.tiempoDestino = t;
+  double norte = (latPunto - lat) * METROS_POR_GRADO;
+  double este = (lonPunto - lon) * METROS_POR_GRADO * cos(lat * GRADOS_A_RAD);
+  tramo.rumbo = !isnan(rumboPunto) ? rumboPunto
+                : (norte != 0 || este != 0) ? normalizarRumbo(atan2(este, norte) / GRADOS_A_RAD)
+                                            : normalizarRumbo(rumbo.valor(tiempoGuion));
+  tramo.velocidad = !isnan(velocidadPunto) ? velocidadPunto
+                                           : sqrt(norte * norte + este * este) / ((t - tiempoGuion) / 1000.0) * 3.6;
+  hayTramo = true;
+  tiempoEstado = tiempoGuion;
+  tiempoGuion = t;
+  if (!conFix) pendiente = PENDIENTE_ENCENDER_GPS;
+}
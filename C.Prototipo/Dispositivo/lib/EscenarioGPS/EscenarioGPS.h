@@ -0,0 +1,158 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ====== Escenarios reproducibles ======
+// Reproduce un recorrido escrito de antemano en vez de la espiral de
+// lib/SimuladorGPS: una traza grabada (sentencias NMEA RMC/GGA o puntos
+// <trkpt> de un GPX), un guion de comandos, o las dos cosas mezcladas en el
+// mismo archivo. El tiempo es virtual: muestra() recibe los ms desde el
+// comienzo del escenario, así la misma entrada da siempre las mismas
+// muestras, a cualquier velocidad.
+//
+// Comandos del guion, uno por línea ('#' empieza un comentario):
+//
+//   acelerar N              el reloj virtual corre N veces más rápido que el
+//                           real (lo aplica el llamador; va al principio)
+//   inicio LAT LON          salta a esa posición
+//   velocidad KMH [S]       llega a esa velocidad en S segundos (0: ya)
+//   rumbo GRADOS [S]        gira hasta ese rumbo por el lado más corto
+//   girar GRADOS [S]        gira lo indicado (+ a la derecha)
+//   esperar S               avanza el tiempo con la velocidad y el rumbo
+//   satelites N             a partir de acá (< 4: precisión baja)
+//   gps apagado|encendido   corte del GPS: no hay fix
+//   broker caido|conectado  el llamador corta la conexión MQTT
+//
+// Los puntos de una traza se reproducen a su hora: el primero queda en el
+// tiempo actual del escenario y entre dos puntos la posición se interpola.
+// Una RMC con estado 'V' apaga el GPS hasta la siguiente válida (mientras
+// tanto el recorrido sigue con el último rumbo y velocidad). Cualquier
+// comando corta la traza; la siguiente se vuelve a anclar. "gps apagado"
+// dura hasta "gps encendido" o hasta el próximo punto válido de una traza.
+// Las líneas que no se entienden se cuentan y se saltean.
+//
+// Las líneas se piden de a una a una FuenteEscenario a medida que avanza el
+// tiempo, así una traza de horas no tiene que entrar en RAM (en el ESP32 se
+// lee de LittleFS). No depende de Arduino.
+
+const size_t ESCENARIO_MAX_LINEA = 160;
+
+class FuenteEscenario {
+ public:
+  virtual ~FuenteEscenario() {}
+  // La línea siguiente sin el fin de línea, cortada a 'tamano' - 1; false
+  // cuando no hay más
+  virtual bool leerLinea(char* destino, size_t tamano) = 0;
+};
+
+// Sobre un texto que ya está en memoria (tests, herramientas de la PC)
+class FuenteEscenarioMemoria : public FuenteEscenario {
+ public:
+  FuenteEscenarioMemoria(const char* texto, size_t largo);
+  bool leerLinea(char* destino, size_t tamano) override;
+  void rebobinar() { posicion = 0; }
+
+ private:
+  const char* texto;
+  size_t largo;
+  size_t posicion;
+};
+
+struct MuestraEscenario {
+  double lat;
+  double lon;
+  double rumbo;      // grados
+  double velocidad;  // km/h
+  uint8_t satelites;
+  bool conFix;       // false durante un corte del GPS
+  bool brokerCaido;
+};
+
+struct EstadisticasEscenario {
+  uint32_t lineas;
+  uint32_t comandos;
+  uint32_t puntos;           // de trazas NMEA o GPX
+  uint32_t errores;
+  uint32_t primeraConError;  // número de línea, 0 si no hubo
+};
+
+class EscenarioGPS {
+ public:
+  explicit EscenarioGPS(FuenteEscenario& fuente);
+
+  // Vuelve al comienzo; la fuente la rebobina el llamador
+  void reiniciar();
+
+  // Estado en 'tiempoMs' desde el comienzo. Los tiempos no pueden bajar.
+  // Devuelve false cuando el escenario terminó ('m' queda con el final)
+  bool muestra(uint32_t tiempoMs, MuestraEscenario& m);
+  bool terminado() const { return agotado; }
+  uint16_t aceleracion() const { return factor; }
+  const EstadisticasEscenario& estadisticas() const { return est; }
+
+ private:
+  // Valor que pasa de 'desde' a 'hasta' en línea recta entre dos instantes
+  struct Rampa {
+    double desde;
+    double hasta;
+    uint32_t inicio;
+    uint32_t duracion;
+    double valor(uint32_t t) const;
+  };
+  // Tramo entre dos puntos de una traza
+  struct Tramo {
+    double latOrigen, lonOrigen;
+    double latDestino, lonDestino;
+    uint32_t tiempoOrigen, tiempoDestino;
+    double rumbo;
+    double velocidad;
+  };
+  // Cambio del GPS a la hora de un punto posterior al tiempo del guion
+  enum Pendiente : uint8_t {
+    PENDIENTE_NADA,
+    PENDIENTE_APAGAR_GPS,   // RMC 'V'
+    PENDIENTE_ENCENDER_GPS  // primer punto válido después del corte
+  };
+
+  void integrar(uint32_t hasta);
+  bool procesarLinea(char* linea);
+  bool procesarComando(char* linea);
+  bool procesarNMEA(char* linea);
+  bool procesarGPX(const char* linea);
+  void agregarPunto(double lat, double lon, uint32_t horaMs, double rumbo, double velocidad);
+  void fijarRumbo(double hasta, uint32_t duracion);
+  void fijarVelocidad(double hasta, uint32_t duracion);
+  void error();
+
+  FuenteEscenario& fuente;
+  EstadisticasEscenario est;
+  uint16_t factor;
+  bool agotado;
+
+  // Hasta dónde se leyó el guion
+  uint32_t tiempoGuion;
+  Pendiente pendiente;
+
+  // Estado cinemático, al día hasta 'tiempoEstado'
+  double lat, lon;
+  uint32_t tiempoEstado;
+  Rampa rumbo;
+  Rampa velocidad;
+  uint8_t satelites;
+  bool conFix;
+  bool brokerCaido;
+
+  // Traza: hora del primer punto y tramo en curso
+  bool enTraza;
+  uint32_t anclaMs;     // tiempo del escenario menos la hora del primer punto
+  uint32_t ultimaHoraMs;
+  uint32_t diasTraza;   // la hora UTC vuelve a 0 a la medianoche
+  bool hayTramo;
+  Tramo tramo;
+
+  // GPX: el punto se arma entre <trkpt> y </trkpt>
+  bool gpxAbierto;
+  double gpxLat, gpxLon;
+  int32_t gpxHoraMs;    // -1 sin <time>
+};
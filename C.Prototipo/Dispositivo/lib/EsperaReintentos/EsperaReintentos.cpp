@@ -0,0 +1,27 @@
+#include "EsperaReintentos.h"
+
+EsperaReintentos::EsperaReintentos(const ConfigReintentos& config) : config(config), fallos(0) {
+  if (this->config.esperaInicialMs == 0) this->config.esperaInicialMs = 1;
+  if (this->config.esperaMaximaMs < this->config.esperaInicialMs) this->config.esperaMaximaMs = this->config.esperaInicialMs;
+}
+
+uint32_t EsperaReintentos::techo() const {
+  if (fallos == 0) return config.esperaInicialMs;
+  // Duplicar sin desbordar: se corta apenas pasa el máximo
+  uint32_t t = config.esperaInicialMs;
+  for (uint32_t i = 1; i < fallos && t < config.esperaMaximaMs; i++) {
+    t = (t > config.esperaMaximaMs / 2) ? config.esperaMaximaMs : t * 2;
+  }
+  return t < config.esperaMaximaMs ? t : config.esperaMaximaMs;
+}
+
+uint32_t EsperaReintentos::fallo(uint32_t azar) {
+  if (fallos < 0xFFFFFFFF) fallos++;
+  uint32_t t = techo();
+  uint32_t mitad = t / 2;
+  return (t - mitad) + azar % (mitad + 1);
+}
+
+void EsperaReintentos::exito() {
+  fallos = 0;
+}
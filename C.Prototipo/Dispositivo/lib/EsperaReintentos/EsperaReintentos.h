@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+// ====== Espera entre reintentos ======
+// Backoff exponencial con jitter que no se rinde nunca: después de cada
+// fallo el techo de la espera se duplica, desde 'esperaInicialMs' hasta
+// 'esperaMaximaMs', y la espera real se elige al azar en la mitad superior
+// del techo. Así una flota que perdió el broker al mismo tiempo no vuelve a
+// golpearlo toda junta, y un equipo nunca queda más de 'esperaMaximaMs' sin
+// intentar. Un éxito vuelve a la espera inicial.
+//
+// El azar lo pasa el llamador (en el ESP8266, ESP.random()); no depende de
+// Arduino.
+
+struct ConfigReintentos {
+  uint32_t esperaInicialMs;
+  uint32_t esperaMaximaMs;
+};
+
+class EsperaReintentos {
+ public:
+  explicit EsperaReintentos(const ConfigReintentos& config);
+
+  // Registra un fallo y devuelve cuánto esperar antes del próximo intento
+  uint32_t fallo(uint32_t azar);
+  void exito();
+
+  uint32_t fallosSeguidos() const { return fallos; }
+  uint32_t techo() const;
+
+ private:
+  ConfigReintentos config;
+  uint32_t fallos;
+};
@@ -0,0 +1,184 @@
+#include "FiltroKalman.h"
+
+#include <math.h>
+#include <string.h>
+
+static const double GRADOS_A_RAD = M_PI / 180.0;
+static const float METROS_POR_GRADO = 111194.93f;
+
+FiltroKalman::FiltroKalman(const ConfigKalman& config)
+    : config(config), iniciado(false), latOrigen(0.0), lonOrigen(0.0), cosOrigen(1.0f),
+      tiempoEstadoMs(0), ultimoFixMs(0), totalDescartadas(0),
+      descartesSeguidos(0) {
+  memset(estado, 0, sizeof(estado));
+  memset(P, 0, sizeof(P));
+}
+
+void FiltroKalman::aPlano(double lat, double lon, float& x, float& y) const {
+  x = (float)(lon - lonOrigen) * cosOrigen * METROS_POR_GRADO;
+  y = (float)(lat - latOrigen) * METROS_POR_GRADO;
+}
+
+void FiltroKalman::iniciar(double lat, double lon, float sigma, uint32_t tiempoMs) {
+  latOrigen = lat;
+  lonOrigen = lon;
+  cosOrigen = (float)cos(lat * GRADOS_A_RAD);
+  memset(estado, 0, sizeof(estado));
+  memset(P, 0, sizeof(P));
+  P[0][0] = P[1][1] = sigma * sigma;
+  // Velocidad desconocida: hasta ~30 m/s
+  P[2][2] = P[3][3] = 900.0f;
+  tiempoEstadoMs = tiempoMs;
+  ultimoFixMs = tiempoMs;
+  iniciado = true;
+}
+
+void FiltroKalman::moverOrigen() {
+  double lat = latitud();
+  double lon = longitud();
+  latOrigen = lat;
+  lonOrigen = lon;
+  cosOrigen = (float)cos(lat * GRADOS_A_RAD);
+  estado[0] = 0.0f;
+  estado[1] = 0.0f;
+}
+
+void FiltroKalman::predecir(uint32_t tiempoMs) {
+  if (!iniciado) return;
+  float dt = (int32_t)(tiempoMs - tiempoEstadoMs) / 1000.0f;
+  if (dt <= 0.0f) return;
+  tiempoEstadoMs = tiempoMs;
+
+  estado[0] += estado[2] * dt;
+  estado[1] += estado[3] * dt;
+
+  // P = F P F' con F = [I dt*I; 0 I]
+  for (uint8_t i = 0; i < 4; i++) {
+    P[0][i] += dt * P[2][i];
+    P[1][i] += dt * P[3][i];
+  }
+  for (uint8_t i = 0; i < 4; i++) {
+    P[i][0] += dt * P[i][2];
+    P[i][1] += dt * P[i][3];
+  }
+
+  // Q de aceleración blanca, independiente por eje
+  float q = config.ruidoAceleracion * config.ruidoAceleracion;
+  float dt2 = dt * dt;
+  float qPos = q * dt2 * dt2 / 4.0f;
+  float qCruz = q * dt2 * dt / 2.0f;
+  float qVel = q * dt2;
+  P[0][0] += qPos;
+  P[1][1] += qPos;
+  P[0][2] += qCruz;
+  P[2][0] += qCruz;
+  P[1][3] += qCruz;
+  P[3][1] += qCruz;
+  P[2][2] += qVel;
+  P[3][3] += qVel;
+}
+
+// Medición de dos componentes consecutivas del estado con varianza 'r' en cada una
+bool FiltroKalman::corregir(float zx, float zy, float r, uint8_t primerIndice) {
+  uint8_t a = primerIndice;
+  uint8_t b = primerIndice + 1;
+  float ix = zx - estado[a];
+  float iy = zy - estado[b];
+
+  float s00 = P[a][a] + r;
+  float s01 = P[a][b];
+  float s11 = P[b][b] + r;
+  float det = s00 * s11 - s01 * s01;
+  if (det <= 0.0f) return false;
+  float i00 = s11 / det;
+  float i01 = -s01 / det;
+  float i11 = s00 / det;
+
+  float mahalanobis = ix * (i00 * ix + i01 * iy) + iy * (i01 * ix + i11 * iy);
+  if (mahalanobis > config.umbralInnovacion) return false;
+
+  float K[4][2];
+  for (uint8_t i = 0; i < 4; i++) {
+    K[i][0] = P[i][a] * i00 + P[i][b] * i01;
+    K[i][1] = P[i][a] * i01 + P[i][b] * i11;
+  }
+  for (uint8_t i = 0; i < 4; i++) {
+    estado[i] += K[i][0] * ix + K[i][1] * iy;
+  }
+  // P = (I - K H) P; H toma las filas a y b
+  float filaA[4];
+  float filaB[4];
+  memcpy(filaA, P[a], sizeof(filaA));
+  memcpy(filaB, P[b], sizeof(filaB));
+  for (uint8_t i = 0; i < 4; i++) {
+    for (uint8_t j = 0; j < 4; j++) {
+      P[i][j] -= K[i][0] * filaA[j] + K[i][1] * filaB[j];
+    }
+  }
+  return true;
+}
+
+bool FiltroKalman::actualizar(double lat, double lon, float hdop, uint8_t satelites, uint32_t tiempoMs) {
+  if (hdop <= 0.0f) hdop = 1.0f;
+  float sigma = config.errorBaseMetros * hdop;
+  if (satelites < 4) {
+    sigma *= 2.0f;
+  } else if (satelites < 5) {
+    sigma *= 1.5f;
+  }
+
+  if (!iniciado || !valido(tiempoMs) || descartesSeguidos >= MAX_DESCARTES_SEGUIDOS) {
+    iniciar(lat, lon, sigma, tiempoMs);
+    descartesSeguidos = 0;
+    return true;
+  }
+
+  predecir(tiempoMs);
+  float x, y;
+  aPlano(lat, lon, x, y);
+  if (!corregir(x, y, sigma * sigma, 0)) {
+    totalDescartadas++;
+    descartesSeguidos++;
+    return false;
+  }
+  descartesSeguidos = 0;
+  ultimoFixMs = tiempoMs;
+
+  if (fabsf(estado[0]) > config.radioOrigenMetros || fabsf(estado[1]) > config.radioOrigenMetros) {
+    moverOrigen();
+  }
+  return true;
+}
+
+void FiltroKalman::actualizarVelocidad(float velocidadKmh, float rumboGrados) {
+  if (!iniciado) return;
+  float v = velocidadKmh / 3.6f;
+  float r = rumboGrados * (float)GRADOS_A_RAD;
+  float e = config.errorVelocidad;
+  corregir(v * sinf(r), v * cosf(r), e * e, 2);
+}
+
+bool FiltroKalman::valido(uint32_t ahoraMs) const {
+  return iniciado && (ahoraMs - ultimoFixMs) <= config.maxSinFixMs;
+}
+
+double FiltroKalman::latitud() const {
+  return latOrigen + estado[1] / METROS_POR_GRADO;
+}
+
+double FiltroKalman::longitud() const {
+  return lonOrigen + estado[0] / (METROS_POR_GRADO * cosOrigen);
+}
+
+float FiltroKalman::velocidadKmh() const {
+  return sqrtf(estado[2] * estado[2] + estado[3] * estado[3]) * 3.6f;
+}
+
+float FiltroKalman::rumbo() const {
+  float r = atan2f(estado[2], estado[3]) / (float)GRADOS_A_RAD;
+  return r < 0.0f ? r + 360.0f : r;
+}
+
+float FiltroKalman::errorPosicion() const {
+  return sqrtf(P[0][0] + P[1][1]);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+
+// ====== Filtro de Kalman de velocidad constante ======
+// Estado [x, y, vx, vy] en metros y m/s sobre un plano local este/norte
+// (ENU) con origen en el primer fix. Todo en float y con matrices de tamaño
+// fijo: no usa memoria dinámica y un fix cuesta unas pocas centenas de
+// operaciones, sin recorrer buffers.
+//
+// - El ruido de medición sale del HDOP y de la cantidad de satélites:
+//   sigma = errorBaseMetros * HDOP, inflado con menos de 5 satélites.
+// - Las mediciones con innovación imposible (distancia de Mahalanobis al
+//   cuadrado mayor a 'umbralInnovacion') se ignoran; si se descartan
+//   MAX_DESCARTES_SEGUIDOS seguidas el filtro se reinicia en la medición.
+// - Sin fix el filtro sigue con la predicción ("coast") hasta
+//   'maxSinFixMs'; después se considera perdido y el próximo fix lo reinicia.
+// - Si el vehículo se aleja más de 'radioOrigenMetros' del origen, el origen
+//   se mueve a la posición actual para que la proyección plana siga valiendo.
+
+const uint8_t MAX_DESCARTES_SEGUIDOS = 3;
+
+struct ConfigKalman {
+  float ruidoAceleracion;   // m/s² (desvío de la aceleración no modelada)
+  float errorBaseMetros;    // error de posición con HDOP 1
+  float errorVelocidad;     // m/s, desvío de la velocidad informada por el GPS
+  float umbralInnovacion;   // chi² con 2 grados de libertad
+  uint32_t maxSinFixMs;
+  float radioOrigenMetros;
+};
+
+class FiltroKalman {
+ public:
+  explicit FiltroKalman(const ConfigKalman& config);
+
+  // Predice hasta 'tiempoMs' y corrige con la posición medida. Devuelve
+  // false si la medición se descartó por innovación.
+  bool actualizar(double lat, double lon, float hdop, uint8_t satelites, uint32_t tiempoMs);
+
+  // Corrección con la velocidad del GPS (km/h y rumbo en grados)
+  void actualizarVelocidad(float velocidadKmh, float rumboGrados);
+
+  // Avanza el estado sin medición (para los huecos de GPS)
+  void predecir(uint32_t tiempoMs);
+
+  void reiniciar() { iniciado = false; }
+
+  // true si hay estado y el último fix tiene menos de maxSinFixMs
+  bool valido(uint32_t ahoraMs) const;
+
+  double latitud() const;
+  double longitud() const;
+  float velocidadKmh() const;
+  float rumbo() const;            // [0, 360)
+  float errorPosicion() const;    // metros, raíz de la traza de la covarianza de posición
+  uint32_t descartadas() const { return totalDescartadas; }
+
+ private:
+  void iniciar(double lat, double lon, float sigma, uint32_t tiempoMs);
+  void aPlano(double lat, double lon, float& x, float& y) const;
+  void moverOrigen();
+  bool corregir(float zx, float zy, float r, uint8_t primerIndice);
+
+  ConfigKalman config;
+  bool iniciado;
+  double latOrigen;
+  double lonOrigen;
+  float cosOrigen;
+  float estado[4];
+  float P[4][4];
+  uint32_t tiempoEstadoMs;
+  uint32_t ultimoFixMs;
+  uint32_t totalDescartadas;
+  uint8_t descartesSeguidos;
+};
@@ -0,0 +1,125 @@
+#include "FiltroNMEA.h"
+
+#include <string.h>
+
+// "$GPRMC": el tipo queda en las posiciones 3 a 5
+static const uint8_t LARGO_ENCABEZADO = 6;
+
+static int8_t valorHexa(uint8_t c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+FiltroNMEA::FiltroNMEA(uint8_t tiposAceptados)
+    : tiposAceptados(tiposAceptados),
+      estado(ESPERANDO_INICIO),
+      suma(0),
+      sumaRecibida(0),
+      digitosChecksum(0),
+      largoSentencia(0),
+      tipoActual(NMEA_OTRA) {
+  buffer[0] = '\0';
+  reiniciarEstadisticas();
+}
+
+void FiltroNMEA::reiniciarEstadisticas() {
+  memset(&est, 0, sizeof(est));
+}
+
+TipoSentencia FiltroNMEA::clasificar(const char* tipo) {
+  if (memcmp(tipo, "RMC", 3) == 0) return NMEA_RMC;
+  if (memcmp(tipo, "GGA", 3) == 0) return NMEA_GGA;
+  if (memcmp(tipo, "VTG", 3) == 0) return NMEA_VTG;
+  if (memcmp(tipo, "GSA", 3) == 0) return NMEA_GSA;
+  if (memcmp(tipo, "GSV", 3) == 0) return NMEA_GSV;
+  if (memcmp(tipo, "GLL", 3) == 0) return NMEA_GLL;
+  return NMEA_OTRA;
+}
+
+void FiltroNMEA::empezar() {
+  est.sentencias++;
+  estado = LEYENDO_CUERPO;
+  suma = 0;
+  sumaRecibida = 0;
+  digitosChecksum = 0;
+  tipoActual = NMEA_OTRA;
+  buffer[0] = '$';
+  largoSentencia = 1;
+}
+
+void FiltroNMEA::truncar() {
+  est.truncadas++;
+  estado = ESPERANDO_INICIO;
+}
+
+bool FiltroNMEA::procesar(uint8_t b) {
+  est.bytes++;
+
+  // Un '$' siempre empieza una sentencia nueva, aunque la anterior no haya terminado
+  if (b == '$') {
+    if (estado == LEYENDO_CUERPO || estado == LEYENDO_CHECKSUM) truncar();
+    empezar();
+    return false;
+  }
+
+  switch (estado) {
+    case ESPERANDO_INICIO:
+    case DESCARTANDO:
+      return false;
+
+    case LEYENDO_CUERPO:
+      if (b == '\r' || b == '\n') {
+        truncar();
+        return false;
+      }
+      if (b == '*') {
+        if (largoSentencia < LARGO_ENCABEZADO) {
+          truncar();
+          return false;
+        }
+        buffer[largoSentencia++] = '*';
+        estado = LEYENDO_CHECKSUM;
+        return false;
+      }
+      // Deja lugar para '*', los dos dígitos y "\r\n"
+      if (largoSentencia >= NMEA_MAX_SENTENCIA - 5) {
+        truncar();
+        return false;
+      }
+      suma ^= b;
+      buffer[largoSentencia++] = (char)b;
+      if (largoSentencia == LARGO_ENCABEZADO) {
+        tipoActual = clasificar(buffer + 3);
+        if ((tipoActual & tiposAceptados) == 0) {
+          est.filtradas++;
+          estado = DESCARTANDO;
+        }
+      }
+      return false;
+
+    case LEYENDO_CHECKSUM: {
+      int8_t v = valorHexa(b);
+      if (v < 0) {
+        truncar();
+        return false;
+      }
+      buffer[largoSentencia++] = (char)b;
+      sumaRecibida = (uint8_t)((sumaRecibida << 4) | v);
+      if (++digitosChecksum < 2) return false;
+
+      estado = ESPERANDO_INICIO;
+      if (sumaRecibida != suma) {
+        est.errorChecksum++;
+        return false;
+      }
+      buffer[largoSentencia++] = '\r';
+      buffer[largoSentencia++] = '\n';
+      buffer[largoSentencia] = '\0';
+      est.aceptadas++;
+      return true;
+    }
+  }
+  return false;
+}
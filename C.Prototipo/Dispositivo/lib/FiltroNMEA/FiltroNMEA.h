@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ====== Filtro de sentencias NMEA ======
+// Se para entre la UART del GPS y TinyGPSPlus. Arma las sentencias byte a
+// byte y solo deja pasar las que el firmware usa (por defecto RMC, GGA y
+// VTG): el resto (GSV, GSA, GLL, propietarias...) se descarta apenas se
+// conoce el tipo, sin guardarlo ni calcular el checksum.
+//
+// El checksum se calcula mientras llegan los bytes y se valida con los dos
+// dígitos después de '*', antes de entregar la sentencia; así el parser
+// nunca ve basura. Una sentencia se entrega completa con "\r\n" al final,
+// lista para pasarla a gps.encode() caracter por caracter.
+//
+// Cuenta bytes, sentencias vistas, aceptadas, filtradas por tipo, con
+// checksum inválido y truncadas (muy largas o cortadas por otro '$'). Los
+// desbordes del buffer de la UART los informa el llamador con
+// registrarDesborde().
+//
+// No depende de Arduino: las herramientas de la PC lo usan con un flujo de
+// bytes simulado.
+
+enum TipoSentencia : uint8_t {
+  NMEA_RMC = 0x01,
+  NMEA_GGA = 0x02,
+  NMEA_VTG = 0x04,
+  NMEA_GSA = 0x08,
+  NMEA_GSV = 0x10,
+  NMEA_GLL = 0x20,
+  NMEA_OTRA = 0x80
+};
+
+// El estándar limita la sentencia a 82 caracteres con "\r\n"
+const uint8_t NMEA_MAX_SENTENCIA = 96;
+
+struct EstadisticasNMEA {
+  uint32_t bytes;
+  uint32_t sentencias;     // empezadas con '$'
+  uint32_t aceptadas;
+  uint32_t filtradas;      // tipo no pedido
+  uint32_t errorChecksum;
+  uint32_t truncadas;
+  uint32_t desbordesUart;
+
+  uint32_t descartadas() const { return errorChecksum + truncadas; }
+};
+
+class FiltroNMEA {
+ public:
+  explicit FiltroNMEA(uint8_t tiposAceptados = NMEA_RMC | NMEA_GGA | NMEA_VTG);
+
+  // Devuelve true cuando 'b' completó una sentencia aceptada. sentencia() y
+  // largo() siguen válidos hasta el próximo llamado.
+  bool procesar(uint8_t b);
+
+  const char* sentencia() const { return buffer; }
+  uint8_t largo() const { return largoSentencia; }
+  TipoSentencia tipo() const { return tipoActual; }
+
+  void registrarDesborde() { est.desbordesUart++; }
+  const EstadisticasNMEA& estadisticas() const { return est; }
+  void reiniciarEstadisticas();
+
+ private:
+  enum Estado : uint8_t {
+    ESPERANDO_INICIO,
+    LEYENDO_CUERPO,
+    LEYENDO_CHECKSUM,
+    DESCARTANDO
+  };
+
+  void empezar();
+  void truncar();
+  static TipoSentencia clasificar(const char* tipo);
+
+  uint8_t tiposAceptados;
+  Estado estado;
+  uint8_t suma;
+  uint8_t sumaRecibida;
+  uint8_t digitosChecksum;
+  uint8_t largoSentencia;
+  TipoSentencia tipoActual;
+  char buffer[NMEA_MAX_SENTENCIA + 1];
+  EstadisticasNMEA est;
+};
@@ -0,0 +1,44 @@
+#include "AlmacenGeocercas.h"
+
+#include <string.h>
+
+AlmacenGeocercasMemoria::AlmacenGeocercasMemoria(uint8_t* buffers, size_t capacidad)
+    : buffers(buffers), capacidad(capacidad), cantidadLecturas(0) {
+  for (uint8_t i = 0; i < GEOCERCAS_ARCHIVOS; i++) {
+    bloque[i] = i;
+    largo[i] = 0;
+  }
+}
+
+bool AlmacenGeocercasMemoria::vaciar(ArchivoGeocercas archivo) {
+  largo[archivo] = 0;
+  return true;
+}
+
+bool AlmacenGeocercasMemoria::anexar(ArchivoGeocercas archivo, const uint8_t* datos, size_t n) {
+  if (largo[archivo] + n > capacidad) return false;
+  memcpy(buffers + bloque[archivo] * capacidad + largo[archivo], datos, n);
+  largo[archivo] += n;
+  return true;
+}
+
+size_t AlmacenGeocercasMemoria::leer(ArchivoGeocercas archivo, uint32_t offset, uint8_t* datos, size_t n) {
+  cantidadLecturas++;
+  if (offset >= largo[archivo]) return 0;
+  if (n > largo[archivo] - offset) n = largo[archivo] - offset;
+  memcpy(datos, buffers + bloque[archivo] * capacidad + offset, n);
+  return n;
+}
+
+uint32_t AlmacenGeocercasMemoria::tamano(ArchivoGeocercas archivo) {
+  return largo[archivo];
+}
+
+bool AlmacenGeocercasMemoria::reemplazar(ArchivoGeocercas desde, ArchivoGeocercas hacia) {
+  uint8_t b = bloque[hacia];
+  bloque[hacia] = bloque[desde];
+  largo[hacia] = largo[desde];
+  bloque[desde] = b;
+  largo[desde] = 0;
+  return true;
+}
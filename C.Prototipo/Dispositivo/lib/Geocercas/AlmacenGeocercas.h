@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ====== Almacenamiento de las geocercas ======
+// Tres archivos de solo-anexar: lo que llega por MQTT, el índice que se está
+// armando y el índice en uso. Al terminar de armar uno nuevo reemplaza al
+// activo de una sola vez, así un corte a mitad de una carga deja el conjunto
+// anterior intacto.
+enum ArchivoGeocercas : uint8_t {
+  GEOCERCAS_RECIBIDAS,
+  GEOCERCAS_NUEVAS,
+  GEOCERCAS_ACTIVAS
+};
+
+const uint8_t GEOCERCAS_ARCHIVOS = 3;
+
+class AlmacenGeocercas {
+ public:
+  virtual ~AlmacenGeocercas() {}
+
+  virtual bool vaciar(ArchivoGeocercas archivo) = 0;
+  virtual bool anexar(ArchivoGeocercas archivo, const uint8_t* datos, size_t largo) = 0;
+  virtual size_t leer(ArchivoGeocercas archivo, uint32_t offset, uint8_t* datos, size_t largo) = 0;
+  virtual uint32_t tamano(ArchivoGeocercas archivo) = 0;  // 0 si no existe
+
+  // 'hacia' pasa a tener el contenido de 'desde'; 'desde' queda vacío
+  virtual bool reemplazar(ArchivoGeocercas desde, ArchivoGeocercas hacia) = 0;
+};
+
+// En RAM, para los tests y las herramientas de la PC. 'buffers' tiene lugar
+// para los tres archivos: GEOCERCAS_ARCHIVOS * capacidad bytes.
+class AlmacenGeocercasMemoria : public AlmacenGeocercas {
+ public:
+  AlmacenGeocercasMemoria(uint8_t* buffers, size_t capacidad);
+
+  bool vaciar(ArchivoGeocercas archivo) override;
+  bool anexar(ArchivoGeocercas archivo, const uint8_t* datos, size_t largo) override;
+  size_t leer(ArchivoGeocercas archivo, uint32_t offset, uint8_t* datos, size_t largo) override;
+  uint32_t tamano(ArchivoGeocercas archivo) override;
+  bool reemplazar(ArchivoGeocercas desde, ArchivoGeocercas hacia) override;
+
+  uint32_t lecturas() const { return cantidadLecturas; }
+
+ private:
+  uint8_t* buffers;
+  size_t capacidad;
+  uint8_t bloque[GEOCERCAS_ARCHIVOS];  // qué parte de 'buffers' usa cada archivo
+  uint32_t largo[GEOCERCAS_ARCHIVOS];
+  uint32_t cantidadLecturas;
+};
@@ -0,0 +1,97 @@
+#if defined(ARDUINO)
+
+#include "AlmacenGeocercasLittleFS.h"
+
+#include <stdio.h>
+
+static const char* NOMBRES[GEOCERCAS_ARCHIVOS] = {"recibidas", "nuevas", "activas"};
+
+AlmacenGeocercasLittleFS::AlmacenGeocercasLittleFS(fs::FS& sistema, const char* directorio)
+    : sistema(sistema),
+      directorio(directorio),
+      lectura(GEOCERCAS_ACTIVAS),
+      hayLectura(false),
+      escritura(GEOCERCAS_RECIBIDAS),
+      hayEscritura(false) {
+  for (uint8_t i = 0; i < GEOCERCAS_ARCHIVOS; i++) {
+    snprintf(rutas[i], sizeof(rutas[i]), "%s/%s", directorio, NOMBRES[i]);
+  }
+}
+
+bool AlmacenGeocercasLittleFS::iniciar() {
+  if (!sistema.exists(directorio)) {
+    return sistema.mkdir(directorio);
+  }
+  return true;
+}
+
+void AlmacenGeocercasLittleFS::cerrarLectura() {
+  if (hayLectura) {
+    archivoLectura.close();
+    hayLectura = false;
+  }
+}
+
+void AlmacenGeocercasLittleFS::cerrarEscritura() {
+  if (hayEscritura) {
+    archivoEscritura.close();
+    hayEscritura = false;
+  }
+}
+
+bool AlmacenGeocercasLittleFS::vaciar(ArchivoGeocercas archivo) {
+  if (hayLectura && lectura == archivo) cerrarLectura();
+  if (hayEscritura && escritura == archivo) cerrarEscritura();
+  if (!sistema.exists(ruta(archivo))) return true;
+  return sistema.remove(ruta(archivo));
+}
+
+bool AlmacenGeocercasLittleFS::anexar(ArchivoGeocercas archivo, const uint8_t* datos, size_t largo) {
+  // Un handle de lectura abierto no vería lo anexado
+  if (hayLectura && lectura == archivo) cerrarLectura();
+
+  if (!hayEscritura || escritura != archivo) {
+    cerrarEscritura();
+    archivoEscritura = sistema.open(ruta(archivo), "a");
+    if (!archivoEscritura) return false;
+    escritura = archivo;
+    hayEscritura = true;
+  }
+  return archivoEscritura.write(datos, largo) == largo;
+}
+
+size_t AlmacenGeocercasLittleFS::leer(ArchivoGeocercas archivo, uint32_t offset, uint8_t* datos, size_t largo) {
+  // Lo anexado llega al archivo al cerrarlo
+  if (hayEscritura && escritura == archivo) cerrarEscritura();
+  if (!hayLectura || lectura != archivo) {
+    cerrarLectura();
+    if (!sistema.exists(ruta(archivo))) return 0;
+    archivoLectura = sistema.open(ruta(archivo), "r");
+    if (!archivoLectura) return 0;
+    lectura = archivo;
+    hayLectura = true;
+  }
+  if (!archivoLectura.seek(offset, SeekSet)) return 0;
+  return archivoLectura.read(datos, largo);
+}
+
+uint32_t AlmacenGeocercasLittleFS::tamano(ArchivoGeocercas archivo) {
+  if (hayEscritura && escritura == archivo) cerrarEscritura();
+  if (hayLectura && lectura == archivo) {
+    return archivoLectura.size();
+  }
+  if (!sistema.exists(ruta(archivo))) return 0;
+  File f = sistema.open(ruta(archivo), "r");
+  if (!f) return 0;
+  uint32_t t = f.size();
+  f.close();
+  return t;
+}
+
+bool AlmacenGeocercasLittleFS::reemplazar(ArchivoGeocercas desde, ArchivoGeocercas hacia) {
+  cerrarLectura();
+  cerrarEscritura();
+  return sistema.rename(ruta(desde), ruta(hacia));
+}
+
+#endif
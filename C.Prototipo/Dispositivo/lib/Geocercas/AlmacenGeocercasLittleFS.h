@@ -0,0 +1,44 @@
+#pragma once
+
+#if defined(ARDUINO)
+
+#include <LittleFS.h>
+
+#include "AlmacenGeocercas.h"
+
+// ====== Almacén de las geocercas sobre LittleFS ======
+// Un archivo por cada ArchivoGeocercas en 'directorio' (/geocercas; el grafo
+// de calles usa el mismo almacén en /calles). reemplazar() es un
+// rename, que LittleFS hace atómico. Se mantienen abiertos el archivo que se
+// está leyendo y el que se está escribiendo: la carga y la compilación
+// anexan y leen muchos registros chicos seguidos, y abrir un archivo cuesta
+// más que escribir 40 bytes.
+class AlmacenGeocercasLittleFS : public AlmacenGeocercas {
+ public:
+  AlmacenGeocercasLittleFS(fs::FS& sistema, const char* directorio = "/geocercas");
+
+  bool iniciar();
+
+  bool vaciar(ArchivoGeocercas archivo) override;
+  bool anexar(ArchivoGeocercas archivo, const uint8_t* datos, size_t largo) override;
+  size_t leer(ArchivoGeocercas archivo, uint32_t offset, uint8_t* datos, size_t largo) override;
+  uint32_t tamano(ArchivoGeocercas archivo) override;
+  bool reemplazar(ArchivoGeocercas desde, ArchivoGeocercas hacia) override;
+
+ private:
+  const char* ruta(ArchivoGeocercas archivo) const { return rutas[archivo]; }
+  void cerrarLectura();
+  void cerrarEscritura();
+
+  fs::FS& sistema;
+  const char* directorio;
+  char rutas[GEOCERCAS_ARCHIVOS][24];
+  File archivoLectura;
+  ArchivoGeocercas lectura;
+  bool hayLectura;
+  File archivoEscritura;
+  ArchivoGeocercas escritura;
+  bool hayEscritura;
+};
+
+#endif
@@ -0,0 +1,620 @@
+#include "Geocercas.h"
+
+#include <Geodesia.h>
+
+#include "LineasCarga.h"
+
+#include <math.h>
+#include <string.h>
+
+static const char MAGIA[4] = {'G', 'E', 'O', '1'};
+static const uint32_t SIN_CELDA = 0xFFFFFFFF;
+// Metros por microgrado de latitud sobre la esfera de referencia
+static const float METROS_POR_MICROGRADO_F = (float)(RADIO_TIERRA_M * M_PI / 180.0 / 1e6);
+// Microgrados por km de latitud, redondeado para arriba (8993,2)
+static const uint32_t MICROGRADOS_POR_KM = 8994;
+static const uint16_t RADIO_MAXIMO_M = 50000;
+
+// ====== Geocercas ======
+
+Geocercas::Geocercas(AlmacenGeocercas& almacen, const ConfigGeocercas& config, uint16_t* celdas,
+                     uint16_t maxCeldas, uint16_t* refs, uint16_t capacidadRefs)
+    : almacen(almacen),
+      config(config),
+      stats(),
+      activa(false),
+      cabecera(),
+      celdaActual(SIN_CELDA),
+      cantidadCandidatos(0),
+      cantidadSeguidas(0),
+      hayUltimoFix(false),
+      ultimoFixMs(0),
+      cargando(false),
+      cargaVersion(0),
+      cargaZonas(0),
+      cargaVertices(0),
+      cargaLatMin(0),
+      cargaLonMin(0),
+      cargaLatMax(0),
+      cargaLonMax(0),
+      celdas(celdas),
+      maxCeldas(maxCeldas),
+      refs(refs),
+      capacidadRefs(capacidadRefs),
+      fase(FASE_NADA),
+      nueva(),
+      offsetLectura(0),
+      zonaLeida(0),
+      celdaDesde(0),
+      celdaHasta(0),
+      baseRefs(0),
+      verticesEscritos(0) {}
+
+uint32_t Geocercas::offsetCeldas(const CabeceraGeocercas& c) const {
+  return sizeof(CabeceraGeocercas) + c.refs * sizeof(uint16_t);
+}
+
+uint32_t Geocercas::offsetZonas(const CabeceraGeocercas& c) const {
+  return offsetCeldas(c) + ((uint32_t)c.columnas * c.filas + 1) * sizeof(uint16_t);
+}
+
+uint32_t Geocercas::offsetVertices(const CabeceraGeocercas& c) const {
+  return offsetZonas(c) + c.zonas * sizeof(RegistroZona);
+}
+
+bool Geocercas::iniciar() {
+  activa = false;
+  celdaActual = SIN_CELDA;
+  cantidadCandidatos = 0;
+  CabeceraGeocercas c;
+  if (almacen.leer(GEOCERCAS_ACTIVAS, 0, (uint8_t*)&c, sizeof(c)) != sizeof(c)) return false;
+  if (memcmp(c.magia, MAGIA, sizeof(MAGIA)) != 0 || c.columnas == 0 || c.filas == 0 || c.celdaE6 == 0) {
+    return false;
+  }
+  if (almacen.tamano(GEOCERCAS_ACTIVAS) != offsetVertices(c) + c.vertices * 2 * sizeof(int32_t)) return false;
+  cabecera = c;
+  activa = true;
+  return true;
+}
+
+const char* Geocercas::descripcion(ResultadoCarga r) {
+  switch (r) {
+    case CARGA_EN_CURSO: return "en_curso";
+    case CARGA_COMPLETA: return "completa";
+    case CARGA_MAL_FORMADA: return "mal_formada";
+    case CARGA_SIN_INICIO: return "sin_inicio";
+    case CARGA_INCOMPLETA: return "incompleta";
+    case CARGA_SIN_LUGAR: return "sin_lugar";
+    case CARGA_ERROR_ALMACEN: return "error_almacen";
+    case CARGA_OTRA_BASE: return "otra_base";
+  }
+  return "?";
+}
+
+// ====== Carga ======
+
+ResultadoCarga Geocercas::recibir(const char* datos, size_t largo) {
+  const char* fin = datos + largo;
+  bool completa = false;
+  while (datos < fin) {
+    const char* finLinea = (const char*)memchr(datos, '\n', fin - datos);
+    if (!finLinea) finLinea = fin;
+    ResultadoCarga r = procesarLinea(datos, finLinea);
+    if (r == CARGA_COMPLETA) {
+      completa = true;
+    } else if (r != CARGA_EN_CURSO) {
+      return r;
+    }
+    datos = finLinea + 1;
+  }
+  return completa ? CARGA_COMPLETA : CARGA_EN_CURSO;
+}
+
+ResultadoCarga Geocercas::abortarCarga(ResultadoCarga motivo) {
+  cargando = false;
+  almacen.vaciar(GEOCERCAS_RECIBIDAS);
+  return motivo;
+}
+
+ResultadoCarga Geocercas::procesarLinea(const char* p, const char* fin) {
+  p = saltarEspacios(p, fin);
+  if (p == fin || *p == '#') return CARGA_EN_CURSO;
+
+  if (leerPalabra(p, fin, "inicio")) {
+    uint32_t v;
+    if (!leerNatural(p, fin, v) || p != fin) return cargando ? abortarCarga(CARGA_MAL_FORMADA) : CARGA_MAL_FORMADA;
+    // La compilación en curso lee el archivo que se va a pisar
+    fase = FASE_NADA;
+    if (!almacen.vaciar(GEOCERCAS_RECIBIDAS)) return abortarCarga(CARGA_ERROR_ALMACEN);
+    cargando = true;
+    cargaVersion = v;
+    cargaZonas = 0;
+    cargaVertices = 0;
+    return CARGA_EN_CURSO;
+  }
+
+  if (leerPalabra(p, fin, "fin")) {
+    if (!cargando) return CARGA_SIN_INICIO;
+    uint32_t v, cantidad;
+    if (!leerNatural(p, fin, v) || !leerNatural(p, fin, cantidad) || p != fin) {
+      return abortarCarga(CARGA_MAL_FORMADA);
+    }
+    if (v != cargaVersion || cantidad != cargaZonas) return abortarCarga(CARGA_INCOMPLETA);
+    cargando = false;
+
+    // Grilla sobre la caja de todas las zonas con celdas cuadradas en grados
+    // y no más de maxCeldas
+    CabeceraGeocercas& c = nueva;
+    memset(&c, 0, sizeof(c));
+    memcpy(c.magia, MAGIA, sizeof(MAGIA));
+    c.version = cargaVersion;
+    c.zonas = cargaZonas;
+    c.vertices = cargaVertices;
+    c.celdaE6 = GEOCERCAS_CELDA_MINIMA_E6;
+    c.columnas = 1;
+    c.filas = 1;
+    if (cargaZonas > 0) {
+      uint64_t alto = (uint64_t)((int64_t)cargaLatMax - cargaLatMin) + 1;
+      uint64_t ancho = (uint64_t)((int64_t)cargaLonMax - cargaLonMin) + 1;
+      uint64_t celda = (uint64_t)sqrt((double)alto * (double)ancho / maxCeldas);
+      if (celda < GEOCERCAS_CELDA_MINIMA_E6) celda = GEOCERCAS_CELDA_MINIMA_E6;
+      while (((alto + celda - 1) / celda) * ((ancho + celda - 1) / celda) > maxCeldas) {
+        celda += celda / 16 + 1;
+      }
+      c.latMinE6 = cargaLatMin;
+      c.lonMinE6 = cargaLonMin;
+      c.celdaE6 = (uint32_t)celda;
+      c.filas = (uint16_t)((alto + celda - 1) / celda);
+      c.columnas = (uint16_t)((ancho + celda - 1) / celda);
+    }
+    memset(celdas, 0, ((uint32_t)c.columnas * c.filas + 1) * sizeof(uint16_t));
+    fase = FASE_CONTAR;
+    offsetLectura = 0;
+    zonaLeida = 0;
+    return CARGA_COMPLETA;
+  }
+
+  bool circulo = leerPalabra(p, fin, "c");
+  if (!circulo && !leerPalabra(p, fin, "p")) return cargando ? abortarCarga(CARGA_MAL_FORMADA) : CARGA_MAL_FORMADA;
+  if (!cargando) return CARGA_SIN_INICIO;
+  if (cargaZonas >= GEOCERCAS_MAX_ZONAS) return abortarCarga(CARGA_SIN_LUGAR);
+
+  RegistroZona z;
+  memset(&z, 0, sizeof(z));
+  if (!leerNatural(p, fin, z.id)) return abortarCarga(CARGA_MAL_FORMADA);
+  uint8_t n = 0;
+  if (circulo) {
+    uint32_t radioM;
+    if (!leerMicrogrados(p, fin, 90000000, z.latE6) || !leerMicrogrados(p, fin, 180000000, z.lonE6) ||
+        !leerNatural(p, fin, radioM) || p != fin || radioM == 0 || radioM > RADIO_MAXIMO_M) {
+      return abortarCarga(CARGA_MAL_FORMADA);
+    }
+    z.tipo = ZONA_CIRCULO;
+    z.radioCm = radioM * 100;
+    z.cosLatQ15 = cosenoQ15(z.latE6 / 1e6);
+    int32_t dLat = (int32_t)(radioM * MICROGRADOS_POR_KM / 1000 + 1);
+    int32_t dLon = (int32_t)(((int64_t)dLat << 15) / (z.cosLatQ15 ? z.cosLatQ15 : 1));
+    z.latMinE6 = z.latE6 - dLat;
+    z.latMaxE6 = z.latE6 + dLat;
+    z.lonMinE6 = z.lonE6 - dLon;
+    z.lonMaxE6 = z.lonE6 + dLon;
+  } else {
+    while (p < fin) {
+      if (n == GEOCERCA_MAX_VERTICES) return abortarCarga(CARGA_MAL_FORMADA);
+      if (!leerMicrogrados(p, fin, 90000000, vertices[2 * n]) ||
+          !leerMicrogrados(p, fin, 180000000, vertices[2 * n + 1])) {
+        return abortarCarga(CARGA_MAL_FORMADA);
+      }
+      n++;
+    }
+    if (n < 3) return abortarCarga(CARGA_MAL_FORMADA);
+    z.tipo = ZONA_POLIGONO;
+    z.vertices = n;
+    z.latMinE6 = z.latMaxE6 = vertices[0];
+    z.lonMinE6 = z.lonMaxE6 = vertices[1];
+    for (uint8_t i = 1; i < n; i++) {
+      if (vertices[2 * i] < z.latMinE6) z.latMinE6 = vertices[2 * i];
+      if (vertices[2 * i] > z.latMaxE6) z.latMaxE6 = vertices[2 * i];
+      if (vertices[2 * i + 1] < z.lonMinE6) z.lonMinE6 = vertices[2 * i + 1];
+      if (vertices[2 * i + 1] > z.lonMaxE6) z.lonMaxE6 = vertices[2 * i + 1];
+    }
+    z.latE6 = (int32_t)(((int64_t)z.latMinE6 + z.latMaxE6) / 2);
+    z.lonE6 = (int32_t)(((int64_t)z.lonMinE6 + z.lonMaxE6) / 2);
+    z.cosLatQ15 = cosenoQ15(z.latE6 / 1e6);
+  }
+
+  if (!almacen.anexar(GEOCERCAS_RECIBIDAS, (const uint8_t*)&z, sizeof(z)) ||
+      (n > 0 && !almacen.anexar(GEOCERCAS_RECIBIDAS, (const uint8_t*)vertices, n * 2 * sizeof(int32_t)))) {
+    return abortarCarga(CARGA_ERROR_ALMACEN);
+  }
+  if (cargaZonas == 0 || z.latMinE6 < cargaLatMin) cargaLatMin = z.latMinE6;
+  if (cargaZonas == 0 || z.lonMinE6 < cargaLonMin) cargaLonMin = z.lonMinE6;
+  if (cargaZonas == 0 || z.latMaxE6 > cargaLatMax) cargaLatMax = z.latMaxE6;
+  if (cargaZonas == 0 || z.lonMaxE6 > cargaLonMax) cargaLonMax = z.lonMaxE6;
+  cargaZonas++;
+  cargaVertices += n;
+  return CARGA_EN_CURSO;
+}
+
+// ====== Compilación del índice ======
+
+// La zona siguiente de GEOCERCAS_RECIBIDAS; sus vértices quedan en
+// 'vertices' si 'conVertices'
+bool Geocercas::leerRecibida(RegistroZona& z, bool conVertices) {
+  if (almacen.leer(GEOCERCAS_RECIBIDAS, offsetLectura, (uint8_t*)&z, sizeof(z)) != sizeof(z)) return false;
+  offsetLectura += sizeof(z);
+  size_t bytesVertices = z.vertices * 2 * sizeof(int32_t);
+  if (conVertices && bytesVertices > 0 &&
+      almacen.leer(GEOCERCAS_RECIBIDAS, offsetLectura, (uint8_t*)vertices, bytesVertices) != bytesVertices) {
+    return false;
+  }
+  offsetLectura += bytesVertices;
+  zonaLeida++;
+  return true;
+}
+
+static uint32_t acotar(int64_t valor, uint32_t maximo) {
+  if (valor < 0) return 0;
+  return valor > maximo ? maximo : (uint32_t)valor;
+}
+
+void Geocercas::celdasDeZona(const RegistroZona& z, uint32_t& col0, uint32_t& fil0, uint32_t& col1,
+                             uint32_t& fil1) const {
+  const CabeceraGeocercas& c = nueva;
+  col0 = acotar(((int64_t)z.lonMinE6 - c.lonMinE6) / c.celdaE6, c.columnas - 1);
+  col1 = acotar(((int64_t)z.lonMaxE6 - c.lonMinE6) / c.celdaE6, c.columnas - 1);
+  fil0 = acotar(((int64_t)z.latMinE6 - c.latMinE6) / c.celdaE6, c.filas - 1);
+  fil1 = acotar(((int64_t)z.latMaxE6 - c.latMinE6) / c.celdaE6, c.filas - 1);
+}
+
+ResultadoCarga Geocercas::abortarCompilacion(ResultadoCarga motivo) {
+  fase = FASE_NADA;
+  almacen.vaciar(GEOCERCAS_NUEVAS);
+  almacen.vaciar(GEOCERCAS_RECIBIDAS);
+  return motivo;
+}
+
+// Elige el bloque de celdas cuyos refs entran en 'refs' a partir de celdaDesde
+bool Geocercas::prepararBloqueRefs() {
+  uint32_t total = (uint32_t)nueva.columnas * nueva.filas;
+  baseRefs = celdas[celdaDesde];
+  celdaHasta = celdaDesde;
+  while (celdaHasta < total && (uint32_t)(celdas[celdaHasta + 1] - baseRefs) <= capacidadRefs) celdaHasta++;
+  offsetLectura = 0;
+  zonaLeida = 0;
+  return celdaHasta > celdaDesde;
+}
+
+ResultadoCarga Geocercas::avanzarCompilacion(uint16_t zonasPorPaso) {
+  if (fase == FASE_NADA) return CARGA_COMPLETA;
+  uint32_t total = (uint32_t)nueva.columnas * nueva.filas;
+  RegistroZona z;
+
+  switch (fase) {
+    case FASE_CONTAR: {
+      for (uint16_t k = 0; k < zonasPorPaso && zonaLeida < nueva.zonas; k++) {
+        if (!leerRecibida(z, false)) return abortarCompilacion(CARGA_ERROR_ALMACEN);
+        uint32_t col0, fil0, col1, fil1;
+        celdasDeZona(z, col0, fil0, col1, fil1);
+        nueva.refs += (col1 - col0 + 1) * (fil1 - fil0 + 1);
+        if (nueva.refs > 0xFFFF) return abortarCompilacion(CARGA_SIN_LUGAR);
+        for (uint32_t f = fil0; f <= fil1; f++) {
+          for (uint32_t col = col0; col <= col1; col++) celdas[f * nueva.columnas + col]++;
+        }
+      }
+      if (zonaLeida < nueva.zonas) return CARGA_EN_CURSO;
+
+      // Cuentas -> comienzo de cada celda en refs
+      uint16_t acumulado = 0;
+      for (uint32_t i = 0; i < total; i++) {
+        uint16_t n = celdas[i];
+        celdas[i] = acumulado;
+        acumulado += n;
+      }
+      celdas[total] = acumulado;
+      if (!almacen.vaciar(GEOCERCAS_NUEVAS) ||
+          !almacen.anexar(GEOCERCAS_NUEVAS, (const uint8_t*)&nueva, sizeof(nueva))) {
+        return abortarCompilacion(CARGA_ERROR_ALMACEN);
+      }
+      fase = FASE_REFS;
+      celdaDesde = 0;
+      if (nueva.refs > 0 && !prepararBloqueRefs()) return abortarCompilacion(CARGA_SIN_LUGAR);
+      return CARGA_EN_CURSO;
+    }
+
+    case FASE_REFS: {
+      // celdas[i] hace de cursor de escritura para las celdas del bloque: al
+      // terminar el bloque cada una quedó en el comienzo de la siguiente
+      if (nueva.refs > 0) {
+        for (uint16_t k = 0; k < zonasPorPaso && zonaLeida < nueva.zonas; k++) {
+          uint16_t indice = (uint16_t)zonaLeida;
+          if (!leerRecibida(z, false)) return abortarCompilacion(CARGA_ERROR_ALMACEN);
+          uint32_t col0, fil0, col1, fil1;
+          celdasDeZona(z, col0, fil0, col1, fil1);
+          for (uint32_t f = fil0; f <= fil1; f++) {
+            for (uint32_t col = col0; col <= col1; col++) {
+              uint32_t i = f * nueva.columnas + col;
+              if (i >= celdaDesde && i < celdaHasta) refs[celdas[i]++ - baseRefs] = indice;
+            }
+          }
+        }
+        if (zonaLeida < nueva.zonas) return CARGA_EN_CURSO;
+
+        uint16_t n = celdas[celdaHasta] - baseRefs;
+        if (!almacen.anexar(GEOCERCAS_NUEVAS, (const uint8_t*)refs, n * sizeof(uint16_t))) {
+          return abortarCompilacion(CARGA_ERROR_ALMACEN);
+        }
+        celdaDesde = celdaHasta;
+        if (celdas[celdaDesde] != celdas[total]) {
+          if (!prepararBloqueRefs()) return abortarCompilacion(CARGA_SIN_LUGAR);
+          return CARGA_EN_CURSO;
+        }
+        // No quedan refs: los cursores vuelven a ser comienzos. Las celdas
+        // vacías del final no se tocaron y ya tienen el valor correcto.
+        for (uint32_t i = celdaDesde; i > 0; i--) celdas[i] = celdas[i - 1];
+        celdas[0] = 0;
+      }
+      celdas[total] = (uint16_t)nueva.refs;
+      if (!almacen.anexar(GEOCERCAS_NUEVAS, (const uint8_t*)celdas, (total + 1) * sizeof(uint16_t))) {
+        return abortarCompilacion(CARGA_ERROR_ALMACEN);
+      }
+      fase = FASE_ZONAS;
+      offsetLectura = 0;
+      zonaLeida = 0;
+      verticesEscritos = 0;
+      return CARGA_EN_CURSO;
+    }
+
+    case FASE_ZONAS: {
+      for (uint16_t k = 0; k < zonasPorPaso && zonaLeida < nueva.zonas; k++) {
+        if (!leerRecibida(z, false)) return abortarCompilacion(CARGA_ERROR_ALMACEN);
+        z.primerVertice = verticesEscritos;
+        verticesEscritos += z.vertices;
+        if (!almacen.anexar(GEOCERCAS_NUEVAS, (const uint8_t*)&z, sizeof(z))) {
+          return abortarCompilacion(CARGA_ERROR_ALMACEN);
+        }
+      }
+      if (zonaLeida < nueva.zonas) return CARGA_EN_CURSO;
+      fase = FASE_VERTICES;
+      offsetLectura = 0;
+      zonaLeida = 0;
+      return CARGA_EN_CURSO;
+    }
+
+    case FASE_VERTICES: {
+      for (uint16_t k = 0; k < zonasPorPaso && zonaLeida < nueva.zonas; k++) {
+        if (!leerRecibida(z, true)) return abortarCompilacion(CARGA_ERROR_ALMACEN);
+        if (z.vertices > 0 &&
+            !almacen.anexar(GEOCERCAS_NUEVAS, (const uint8_t*)vertices, z.vertices * 2 * sizeof(int32_t))) {
+          return abortarCompilacion(CARGA_ERROR_ALMACEN);
+        }
+      }
+      if (zonaLeida < nueva.zonas) return CARGA_EN_CURSO;
+      return terminarCompilacion() ? CARGA_COMPLETA : abortarCompilacion(CARGA_ERROR_ALMACEN);
+    }
+
+    default:
+      return CARGA_COMPLETA;
+  }
+}
+
+bool Geocercas::terminarCompilacion() {
+  fase = FASE_NADA;
+  if (!almacen.reemplazar(GEOCERCAS_NUEVAS, GEOCERCAS_ACTIVAS)) return false;
+  almacen.vaciar(GEOCERCAS_RECIBIDAS);
+  if (!iniciar()) return false;
+
+  // Las zonas seguidas pasan a los registros nuevos (primerVertice cambió);
+  // se buscan en la celda de su centro. Las que ya no están dejan de seguirse.
+  uint8_t quedan = 0;
+  for (uint8_t i = 0; i < cantidadSeguidas; i++) {
+    Seguida& s = seguidas[i];
+    if (!cargarCelda(celdaDe(s.zona.latE6, s.zona.lonE6))) continue;
+    for (uint8_t k = 0; k < cantidadCandidatos; k++) {
+      if (candidatos[k].id == s.zona.id) {
+        s.zona = candidatos[k];
+        seguidas[quedan++] = s;
+        break;
+      }
+    }
+  }
+  cantidadSeguidas = quedan;
+  celdaActual = SIN_CELDA;
+  cantidadCandidatos = 0;
+  return true;
+}
+
+// ====== Evaluación ======
+
+uint32_t Geocercas::celdaDe(int32_t latE6, int32_t lonE6) const {
+  if (!activa) return SIN_CELDA;
+  int64_t dLat = (int64_t)latE6 - cabecera.latMinE6;
+  int64_t dLon = (int64_t)lonE6 - cabecera.lonMinE6;
+  if (dLat < 0 || dLon < 0) return SIN_CELDA;
+  uint32_t fil = (uint32_t)(dLat / cabecera.celdaE6);
+  uint32_t col = (uint32_t)(dLon / cabecera.celdaE6);
+  if (fil >= cabecera.filas || col >= cabecera.columnas) return SIN_CELDA;
+  return fil * cabecera.columnas + col;
+}
+
+// Lee a 'candidatos' los registros de las zonas de la celda
+bool Geocercas::cargarCelda(uint32_t celda) {
+  cantidadCandidatos = 0;
+  if (celda == SIN_CELDA) return false;
+  stats.cambiosCelda++;
+  uint16_t rango[2];
+  stats.lecturas++;
+  if (almacen.leer(GEOCERCAS_ACTIVAS, offsetCeldas(cabecera) + celda * sizeof(uint16_t), (uint8_t*)rango,
+                   sizeof(rango)) != sizeof(rango)) {
+    return false;
+  }
+  uint16_t n = rango[1] - rango[0];
+  if (n > stats.candidatosMax) stats.candidatosMax = n;
+  if (n > GEOCERCAS_MAX_CANDIDATOS) {
+    stats.truncados++;
+    n = GEOCERCAS_MAX_CANDIDATOS;
+  }
+  if (n == 0) return true;
+  uint16_t indices[GEOCERCAS_MAX_CANDIDATOS];
+  stats.lecturas++;
+  if (almacen.leer(GEOCERCAS_ACTIVAS, sizeof(CabeceraGeocercas) + rango[0] * sizeof(uint16_t),
+                   (uint8_t*)indices, n * sizeof(uint16_t)) != n * sizeof(uint16_t)) {
+    return false;
+  }
+  uint32_t base = offsetZonas(cabecera);
+  for (uint16_t i = 0; i < n; i++) {
+    stats.lecturas++;
+    if (almacen.leer(GEOCERCAS_ACTIVAS, base + indices[i] * sizeof(RegistroZona), (uint8_t*)&candidatos[i],
+                     sizeof(RegistroZona)) != sizeof(RegistroZona)) {
+      return false;
+    }
+    cantidadCandidatos++;
+  }
+  return true;
+}
+
+bool Geocercas::contiene(const RegistroZona& z, const int32_t* v, int32_t latE6, int32_t lonE6,
+                         uint16_t margenM) {
+  if (z.tipo == ZONA_CIRCULO) {
+    uint32_t d = distanciaMicrogradosCm(latE6, lonE6, z.latE6, z.lonE6, z.cosLatQ15);
+    return d <= z.radioCm + (uint32_t)margenM * 100;
+  }
+
+  // Rayo hacia el este: cuenta cruces de aristas, todo en enteros
+  bool dentro = false;
+  for (uint8_t i = 0, j = z.vertices - 1; i < z.vertices; j = i++) {
+    int64_t yi = v[2 * i], xi = v[2 * i + 1];
+    int64_t yj = v[2 * j], xj = v[2 * j + 1];
+    if ((yi > latE6) != (yj > latE6)) {
+      int64_t dy = yj - yi;
+      int64_t izquierda = (lonE6 - xi) * dy;
+      int64_t derecha = (latE6 - yi) * (xj - xi);
+      if (dy > 0 ? izquierda < derecha : izquierda > derecha) dentro = !dentro;
+    }
+  }
+  if (dentro || margenM == 0) return dentro;
+
+  // Afuera: distancia a cada arista en metros sobre el plano local
+  float ky = METROS_POR_MICROGRADO_F;
+  float kx = METROS_POR_MICROGRADO_F * z.cosLatQ15 / 32768.0f;
+  float margen2 = (float)margenM * margenM;
+  for (uint8_t i = 0, j = z.vertices - 1; i < z.vertices; j = i++) {
+    float ax = (v[2 * j + 1] - lonE6) * kx, ay = (v[2 * j] - latE6) * ky;
+    float bx = (v[2 * i + 1] - lonE6) * kx, by = (v[2 * i] - latE6) * ky;
+    float ex = bx - ax, ey = by - ay;
+    float largo2 = ex * ex + ey * ey;
+    float t = largo2 > 0 ? -(ax * ex + ay * ey) / largo2 : 0;
+    if (t < 0) t = 0;
+    if (t > 1) t = 1;
+    float px = ax + t * ex, py = ay + t * ey;
+    if (px * px + py * py <= margen2) return true;
+  }
+  return false;
+}
+
+bool Geocercas::probar(const RegistroZona& z, int32_t latE6, int32_t lonE6, uint16_t margenM) {
+  int32_t mLat = (int32_t)((uint32_t)margenM * MICROGRADOS_POR_KM / 1000 + 1);
+  int32_t mLon = (int32_t)(((int64_t)mLat << 15) / (z.cosLatQ15 ? z.cosLatQ15 : 1));
+  if (latE6 < z.latMinE6 - mLat || latE6 > z.latMaxE6 + mLat || lonE6 < z.lonMinE6 - mLon ||
+      lonE6 > z.lonMaxE6 + mLon) {
+    return false;
+  }
+  if (z.tipo == ZONA_POLIGONO) {
+    size_t bytes = z.vertices * 2 * sizeof(int32_t);
+    stats.lecturas++;
+    if (almacen.leer(GEOCERCAS_ACTIVAS, offsetVertices(cabecera) + z.primerVertice * 2 * sizeof(int32_t),
+                     (uint8_t*)vertices, bytes) != bytes) {
+      return false;
+    }
+  }
+  return contiene(z, vertices, latE6, lonE6, margenM);
+}
+
+Geocercas::Seguida* Geocercas::buscarSeguida(uint32_t id) {
+  for (uint8_t i = 0; i < cantidadSeguidas; i++) {
+    if (seguidas[i].zona.id == id) return &seguidas[i];
+  }
+  return nullptr;
+}
+
+bool Geocercas::adentro() const {
+  for (uint8_t i = 0; i < cantidadSeguidas; i++) {
+    if (seguidas[i].estado == SEGUIDA_ADENTRO) return true;
+  }
+  return false;
+}
+
+uint8_t Geocercas::evaluar(int32_t latE6, int32_t lonE6, uint32_t fixMs, FuncionEventoGeocerca aviso) {
+  if (hayUltimoFix && fixMs == ultimoFixMs) {
+    stats.repetidos++;
+    return 0;
+  }
+  hayUltimoFix = true;
+  ultimoFixMs = fixMs;
+  stats.evaluaciones++;
+  uint8_t eventos = 0;
+
+  uint32_t celda = celdaDe(latE6, lonE6);
+  if (celda != celdaActual) {
+    cargarCelda(celda);
+    celdaActual = celda;
+  }
+
+  // Zonas seguidas: con su propio registro, estén o no en esta celda
+  uint8_t i = 0;
+  while (i < cantidadSeguidas) {
+    Seguida& s = seguidas[i];
+    bool seguir = true;
+    if (s.estado == SEGUIDA_ENTRANDO) {
+      if (!probar(s.zona, latE6, lonE6, 0)) {
+        seguir = false;
+      } else if (++s.cuenta >= config.fixesEntrada) {
+        s.estado = SEGUIDA_ADENTRO;
+        s.cuenta = 0;
+        s.desdeMs = fixMs;
+        aviso(GEOCERCA_ENTRADA, s.zona.id, 0);
+        eventos++;
+      }
+    } else if (probar(s.zona, latE6, lonE6, config.margenSalidaM)) {
+      s.cuenta = 0;
+      if (config.permanenciaMs > 0 && !s.permanenciaAvisada && fixMs - s.desdeMs >= config.permanenciaMs) {
+        s.permanenciaAvisada = true;
+        aviso(GEOCERCA_PERMANENCIA, s.zona.id, fixMs - s.desdeMs);
+        eventos++;
+      }
+    } else if (++s.cuenta >= config.fixesSalida) {
+      aviso(GEOCERCA_SALIDA, s.zona.id, fixMs - s.desdeMs);
+      eventos++;
+      seguir = false;
+    }
+    if (seguir) {
+      i++;
+    } else {
+      seguidas[i] = seguidas[--cantidadSeguidas];
+    }
+  }
+
+  // Zonas de la celda en las que se acaba de entrar
+  for (uint8_t k = 0; k < cantidadCandidatos; k++) {
+    const RegistroZona& z = candidatos[k];
+    if (buscarSeguida(z.id) || !probar(z, latE6, lonE6, 0)) continue;
+    if (cantidadSeguidas == GEOCERCAS_MAX_SEGUIDAS) {
+      stats.sinLugar++;
+      continue;
+    }
+    Seguida& s = seguidas[cantidadSeguidas++];
+    s.zona = z;
+    s.estado = SEGUIDA_ENTRANDO;
+    s.cuenta = 1;
+    s.desdeMs = fixMs;
+    s.permanenciaAvisada = false;
+    if (s.cuenta >= config.fixesEntrada) {
+      s.estado = SEGUIDA_ADENTRO;
+      s.cuenta = 0;
+      aviso(GEOCERCA_ENTRADA, s.zona.id, 0);
+      eventos++;
+    }
+  }
+  stats.eventos += eventos;
+  return eventos;
+}
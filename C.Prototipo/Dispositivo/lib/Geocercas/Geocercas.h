@@ -0,0 +1,245 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "AlmacenGeocercas.h"
+
+// ====== Geocercas ======
+// Depósitos y puntos de entrega (círculos y polígonos) guardados en flash,
+// con un índice de grilla uniforme para que cada fix mire solo las zonas de
+// su celda. El dispositivo avisa entradas, salidas y permanencias en vez de
+// que la nube compare cada posición con todas las zonas.
+//
+// Carga: líneas de texto por MQTT, varias por mensaje y sin cortar una línea
+// entre dos mensajes. Las coordenadas van en grados con hasta 6 decimales.
+//
+//   inicio VERSION
+//   c ID LAT LON RADIO_M                círculo
+//   p ID LAT LON LAT LON LAT LON ...    polígono de 3 a GEOCERCA_MAX_VERTICES
+//   fin VERSION CANTIDAD
+//
+// Con "fin" se arma el índice de a pasos (avanzarCompilacion) en un archivo
+// nuevo que al terminar reemplaza al activo. Un error en la carga o en la
+// compilación deja el conjunto anterior en uso.
+//
+// Archivo compilado (GEOCERCAS_ACTIVAS):
+//
+//   CabeceraGeocercas
+//   refs[refs]           uint16: índice de zona, agrupadas por celda
+//   celdas[celdas + 1]   uint16: dónde empieza cada celda en refs
+//   zonas[zonas]         RegistroZona
+//   vertices[vertices]   pares lat, lon int32 (1e-6 grados)
+//
+// En RAM quedan solo la cabecera, los registros de la celda actual y las
+// zonas seguidas; las tablas de la compilación (una cuenta por celda y un
+// bloque de refs) viven en GeocercasFija.
+//
+// Histéresis: una zona se da por entrada después de 'fixesEntrada' fixes
+// seguidos adentro y por salida después de 'fixesSalida' fixes seguidos a
+// más de 'margenSalidaM' de su borde. La permanencia se avisa una vez por
+// visita, a los 'permanenciaMs' de la entrada. La geometría es entera en
+// 1e-6 grados salvo el margen de salida, en float. Los fixes se cuentan por
+// su instante: evaluar la misma posición otra vez sin un fix nuevo (el GPS
+// conserva la última cuando pierde la señal) no avanza la histéresis.
+//
+// Limitaciones: las zonas no cruzan el antimeridiano; una celda aporta hasta
+// GEOCERCAS_MAX_CANDIDATOS zonas y se siguen hasta GEOCERCAS_MAX_SEGUIDAS a
+// la vez (el resto se cuenta en las estadísticas). No depende de Arduino.
+
+const uint8_t GEOCERCA_MAX_VERTICES = 32;
+const uint8_t GEOCERCAS_MAX_CANDIDATOS = 24;
+const uint8_t GEOCERCAS_MAX_SEGUIDAS = 8;
+const uint32_t GEOCERCAS_MAX_ZONAS = 0xFFFF;     // índices uint16 en refs
+const uint32_t GEOCERCAS_CELDA_MINIMA_E6 = 1000;  // ~110 m
+
+enum TipoZona : uint8_t {
+  ZONA_CIRCULO,
+  ZONA_POLIGONO
+};
+
+// Se copia tal cual a flash (memcpy); 40 bytes
+struct RegistroZona {
+  uint32_t id;
+  int32_t latMinE6, lonMinE6, latMaxE6, lonMaxE6;  // caja que la contiene
+  int32_t latE6, lonE6;    // centro (círculo) o centro de la caja (polígono)
+  uint32_t radioCm;        // círculo
+  uint32_t primerVertice;  // polígono: índice en la tabla de vértices
+  uint16_t cosLatQ15;
+  uint8_t tipo;
+  uint8_t vertices;
+};
+
+enum ResultadoCarga : uint8_t {
+  CARGA_EN_CURSO,       // faltan líneas o pasos de compilación
+  CARGA_COMPLETA,       // recibir: llegó "fin"; avanzarCompilacion: índice en uso
+  CARGA_MAL_FORMADA,
+  CARGA_SIN_INICIO,     // zonas o "fin" sin "inicio"
+  CARGA_INCOMPLETA,     // "fin" con otra versión o cantidad
+  CARGA_SIN_LUGAR,      // demasiadas zonas o refs, o una celda no entra en el bloque
+  CARGA_ERROR_ALMACEN,
+  CARGA_OTRA_BASE       // cambios sobre una versión que no es la que está en uso (grafo de calles)
+};
+
+enum EventoGeocerca : uint8_t {
+  GEOCERCA_ENTRADA,
+  GEOCERCA_SALIDA,
+  GEOCERCA_PERMANENCIA
+};
+
+// 'duracionMs': tiempo adentro (0 en la entrada)
+typedef void (*FuncionEventoGeocerca)(EventoGeocerca evento, uint32_t idZona, uint32_t duracionMs);
+
+struct ConfigGeocercas {
+  uint16_t margenSalidaM;
+  uint8_t fixesEntrada;
+  uint8_t fixesSalida;
+  uint32_t permanenciaMs;  // 0: sin aviso de permanencia
+};
+
+struct EstadisticasGeocercas {
+  uint32_t evaluaciones;
+  uint32_t cambiosCelda;
+  uint32_t lecturas;       // lecturas del almacén al cambiar de celda o seguir polígonos
+  uint32_t eventos;
+  uint16_t candidatosMax;
+  uint32_t truncados;      // celdas con más de GEOCERCAS_MAX_CANDIDATOS zonas
+  uint32_t sinLugar;       // zonas que no entraron en la tabla de seguidas
+  uint32_t repetidos;      // evaluaciones del mismo fix, ignoradas
+};
+
+class Geocercas {
+ public:
+  // 'celdas' tiene maxCeldas + 1 entradas y 'refs' capacidadRefs
+  Geocercas(AlmacenGeocercas& almacen, const ConfigGeocercas& config, uint16_t* celdas, uint16_t maxCeldas,
+            uint16_t* refs, uint16_t capacidadRefs);
+
+  // Abre el conjunto activo guardado en flash; false si no hay uno válido
+  bool iniciar();
+
+  // Un mensaje de carga; ver el formato arriba
+  ResultadoCarga recibir(const char* datos, size_t largo);
+
+  // Arma el índice de a 'zonasPorPaso' zonas leídas. CARGA_EN_CURSO mientras
+  // falte; CARGA_COMPLETA cuando el conjunto nuevo ya está en uso.
+  ResultadoCarga avanzarCompilacion(uint16_t zonasPorPaso);
+  bool compilando() const { return fase != FASE_NADA; }
+
+  // Un fix tomado en 'fixMs'; avisa los eventos por 'aviso' y devuelve
+  // cuántos hubo. Con el mismo 'fixMs' que la vez anterior no hace nada.
+  uint8_t evaluar(int32_t latE6, int32_t lonE6, uint32_t fixMs, FuncionEventoGeocerca aviso);
+
+  void fijarConfig(const ConfigGeocercas& c) { config = c; }
+
+  // Adentro de al menos una zona (ya confirmada)
+  bool adentro() const;
+  uint32_t version() const { return activa ? cabecera.version : 0; }
+  uint32_t zonas() const { return activa ? cabecera.zonas : 0; }
+  uint32_t versionCargando() const { return cargaVersion; }
+  const EstadisticasGeocercas& estadisticas() const { return stats; }
+  static const char* descripcion(ResultadoCarga r);
+
+  // Adentro de la zona o a menos de 'margenM' de su borde; 'vertices' en
+  // pares lat, lon (se ignora en los círculos)
+  static bool contiene(const RegistroZona& z, const int32_t* vertices, int32_t latE6, int32_t lonE6,
+                       uint16_t margenM);
+
+ private:
+  struct CabeceraGeocercas {
+    char magia[4];
+    uint32_t version;
+    uint32_t zonas;
+    uint32_t refs;
+    uint32_t vertices;
+    int32_t latMinE6;
+    int32_t lonMinE6;
+    uint32_t celdaE6;
+    uint16_t columnas;
+    uint16_t filas;
+  };
+
+  enum Fase : uint8_t {
+    FASE_NADA,
+    FASE_CONTAR,
+    FASE_REFS,
+    FASE_ZONAS,
+    FASE_VERTICES
+  };
+
+  enum EstadoSeguida : uint8_t {
+    SEGUIDA_ENTRANDO,
+    SEGUIDA_ADENTRO
+  };
+
+  struct Seguida {
+    RegistroZona zona;
+    uint32_t desdeMs;
+    uint8_t estado;
+    uint8_t cuenta;  // fixes seguidos adentro (ENTRANDO) o afuera (ADENTRO)
+    bool permanenciaAvisada;
+  };
+
+  ResultadoCarga procesarLinea(const char* p, const char* fin);
+  ResultadoCarga abortarCarga(ResultadoCarga motivo);
+  ResultadoCarga abortarCompilacion(ResultadoCarga motivo);
+  bool leerRecibida(RegistroZona& z, bool conVertices);
+  void celdasDeZona(const RegistroZona& z, uint32_t& col0, uint32_t& fil0, uint32_t& col1, uint32_t& fil1) const;
+  bool prepararBloqueRefs();
+  bool terminarCompilacion();
+  uint32_t offsetCeldas(const CabeceraGeocercas& c) const;
+  uint32_t offsetZonas(const CabeceraGeocercas& c) const;
+  uint32_t offsetVertices(const CabeceraGeocercas& c) const;
+  uint32_t celdaDe(int32_t latE6, int32_t lonE6) const;
+  bool cargarCelda(uint32_t celda);
+  bool probar(const RegistroZona& z, int32_t latE6, int32_t lonE6, uint16_t margenM);
+  Seguida* buscarSeguida(uint32_t id);
+
+  AlmacenGeocercas& almacen;
+  ConfigGeocercas config;
+  EstadisticasGeocercas stats;
+
+  // Conjunto activo
+  bool activa;
+  CabeceraGeocercas cabecera;
+  uint32_t celdaActual;
+  RegistroZona candidatos[GEOCERCAS_MAX_CANDIDATOS];
+  uint8_t cantidadCandidatos;
+  Seguida seguidas[GEOCERCAS_MAX_SEGUIDAS];
+  uint8_t cantidadSeguidas;
+  bool hayUltimoFix;
+  uint32_t ultimoFixMs;
+  int32_t vertices[2 * GEOCERCA_MAX_VERTICES];
+
+  // Carga en curso
+  bool cargando;
+  uint32_t cargaVersion;
+  uint32_t cargaZonas;
+  uint32_t cargaVertices;
+  int32_t cargaLatMin, cargaLonMin, cargaLatMax, cargaLonMax;
+
+  // Compilación
+  uint16_t* celdas;
+  uint16_t maxCeldas;
+  uint16_t* refs;
+  uint16_t capacidadRefs;
+  Fase fase;
+  CabeceraGeocercas nueva;
+  uint32_t offsetLectura;  // en GEOCERCAS_RECIBIDAS
+  uint32_t zonaLeida;      // índice de la próxima zona a leer
+  uint32_t celdaDesde;     // bloque de refs en armado: celdas [celdaDesde, celdaHasta)
+  uint32_t celdaHasta;
+  uint16_t baseRefs;
+  uint32_t verticesEscritos;
+};
+
+// Con las tablas de compilación incluidas
+template <uint16_t MAX_CELDAS, uint16_t CAPACIDAD_REFS>
+class GeocercasFija : public Geocercas {
+ public:
+  GeocercasFija(AlmacenGeocercas& almacen, const ConfigGeocercas& config)
+      : Geocercas(almacen, config, tablaCeldas, MAX_CELDAS, tablaRefs, CAPACIDAD_REFS) {}
+
+ private:
+  uint16_t tablaCeldas[MAX_CELDAS + 1];
+  uint16_t tablaRefs[CAPACIDAD_REFS];
+};
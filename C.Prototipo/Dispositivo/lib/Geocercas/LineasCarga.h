@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// ====== Lectura de las líneas de carga ======
+// Campos de las líneas de texto que llegan por MQTT (geocercas y grafo de
+// calles): palabras, naturales de 32 bits y grados con hasta 6 decimales.
+// Cada función avanza 'p' hasta el campo siguiente solo si leyó uno válido.
+
+inline const char* saltarEspacios(const char* p, const char* fin) {
+  while (p < fin && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+  return p;
+}
+
+inline bool finDeCampo(const char* p, const char* fin) {
+  return p == fin || *p == ' ' || *p == '\t' || *p == '\r';
+}
+
+inline bool leerPalabra(const char*& p, const char* fin, const char* palabra) {
+  size_t n = strlen(palabra);
+  if ((size_t)(fin - p) < n || strncmp(p, palabra, n) != 0 || !finDeCampo(p + n, fin)) return false;
+  p = saltarEspacios(p + n, fin);
+  return true;
+}
+
+inline bool leerNatural(const char*& p, const char* fin, uint32_t& valor) {
+  const char* q = p;
+  uint64_t v = 0;
+  while (q < fin && *q >= '0' && *q <= '9') {
+    v = v * 10 + (uint32_t)(*q - '0');
+    if (v > 0xFFFFFFFFull) return false;
+    q++;
+  }
+  if (q == p || !finDeCampo(q, fin)) return false;
+  valor = (uint32_t)v;
+  p = saltarEspacios(q, fin);
+  return true;
+}
+
+// Grados con hasta 6 decimales a 1e-6 grados, sin pasar por double (los
+// decimales que sobran se descartan)
+inline bool leerMicrogrados(const char*& p, const char* fin, int32_t limite, int32_t& valorE6) {
+  const char* q = p;
+  bool negativo = false;
+  if (q < fin && (*q == '-' || *q == '+')) negativo = (*q++ == '-');
+  int32_t enteros = 0;
+  uint8_t digitos = 0;
+  while (q < fin && *q >= '0' && *q <= '9') {
+    if (++digitos > 3) return false;
+    enteros = enteros * 10 + (*q++ - '0');
+  }
+  int32_t fraccion = 0;
+  uint8_t decimales = 0;
+  if (q < fin && *q == '.') {
+    q++;
+    while (q < fin && *q >= '0' && *q <= '9') {
+      if (decimales < 6) {
+        fraccion = fraccion * 10 + (*q - '0');
+        decimales++;
+      }
+      q++;
+    }
+  }
+  if (digitos == 0 || !finDeCampo(q, fin)) return false;
+  while (decimales++ < 6) fraccion *= 10;
+  int32_t v = enteros * 1000000 + fraccion;
+  if (v > limite) return false;
+  valorE6 = negativo ? -v : v;
+  p = saltarEspacios(q, fin);
+  return true;
+}
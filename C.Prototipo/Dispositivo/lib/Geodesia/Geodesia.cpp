@@ -0,0 +1,99 @@
+#include "Geodesia.h"
+
+#include <math.h>
+
+static const double GRADOS_A_RAD = M_PI / 180.0;
+static const float GRADOS_A_RAD_F = (float)(M_PI / 180.0);
+// Metros por grado de latitud sobre la esfera de referencia
+static const float METROS_POR_GRADO_F = (float)(RADIO_TIERRA_M * M_PI / 180.0);
+// Centímetros por microgrado en Q16 (11,1195 cm -> 728728)
+static const uint32_t CM_POR_MICROGRADO_Q16 = 728728;
+
+double distanciaHaversine(double lat1, double lon1, double lat2, double lon2) {
+  lat1 *= GRADOS_A_RAD;
+  lon1 *= GRADOS_A_RAD;
+  lat2 *= GRADOS_A_RAD;
+  lon2 *= GRADOS_A_RAD;
+  double dLat = lat2 - lat1;
+  double dLon = lon2 - lon1;
+  double a = sin(dLat / 2) * sin(dLat / 2) +
+             cos(lat1) * cos(lat2) * sin(dLon / 2) * sin(dLon / 2);
+  double c = 2 * atan2(sqrt(a), sqrt(1 - a));
+  return RADIO_TIERRA_M * c;
+}
+
+float distanciaHaversineF(float lat1, float lon1, float lat2, float lon2) {
+  float dLat = (lat2 - lat1) * GRADOS_A_RAD_F;
+  float dLon = (lon2 - lon1) * GRADOS_A_RAD_F;
+  float sLat = sinf(dLat * 0.5f);
+  float sLon = sinf(dLon * 0.5f);
+  float a = sLat * sLat + cosf(lat1 * GRADOS_A_RAD_F) * cosf(lat2 * GRADOS_A_RAD_F) * sLon * sLon;
+  // Para distancias cortas asin(sqrt(a)) es más preciso que atan2 en float
+  return 2.0f * (float)RADIO_TIERRA_M * asinf(sqrtf(a));
+}
+
+float distanciaEquirectangular(double lat1, double lon1, double lat2, double lon2, float cosLat) {
+  // Las restas van en double para no perder los decimales de las coordenadas
+  float dy = (float)(lat2 - lat1);
+  float dx = (float)(lon2 - lon1) * cosLat;
+  return sqrtf(dx * dx + dy * dy) * METROS_POR_GRADO_F;
+}
+
+// ====== Proyección local ======
+ProyeccionLocal::ProyeccionLocal(float margenGrados)
+    : margenGrados(margenGrados), latOrigen(0.0), coseno(1.0f), iniciada(false) {}
+
+void ProyeccionLocal::fijarOrigen(double lat) {
+  latOrigen = lat;
+  coseno = cosf((float)lat * GRADOS_A_RAD_F);
+  iniciada = true;
+}
+
+float ProyeccionLocal::distancia(double lat1, double lon1, double lat2, double lon2) {
+  if (!iniciada || fabs(lat1 - latOrigen) > margenGrados) {
+    fijarOrigen(lat1);
+  }
+  return distanciaEquirectangular(lat1, lon1, lat2, lon2, coseno);
+}
+
+// ====== Variante entera ======
+static uint64_t raizEntera(uint64_t v) {
+  uint64_t r = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+  while (bit > v) bit >>= 2;
+  while (bit) {
+    if (v >= r + bit) {
+      v -= r + bit;
+      r = (r >> 1) + bit;
+    } else {
+      r >>= 1;
+    }
+    bit >>= 2;
+  }
+  return r;
+}
+
+uint32_t distanciaMicrogradosCm(int32_t lat1E6, int32_t lon1E6, int32_t lat2E6, int32_t lon2E6,
+                                uint16_t cosLatQ15) {
+  int64_t dLat = (int64_t)lat2E6 - lat1E6;
+  int64_t dLon = (((int64_t)lon2E6 - lon1E6) * cosLatQ15) >> 15;
+  // Centímetros en Q16 para no perder resolución antes de la raíz
+  int64_t y = dLat * CM_POR_MICROGRADO_Q16;
+  int64_t x = dLon * CM_POR_MICROGRADO_Q16;
+  // Hasta ~100 km x, y son menores que 2^40: con x/1024 la suma de cuadrados entra en 63 bits
+  x >>= 10;
+  y >>= 10;
+  uint64_t r = raizEntera((uint64_t)(x * x + y * y));
+  return (uint32_t)((r + 32) >> 6);
+}
+
+uint16_t cosenoQ15(double lat) {
+  double c = cos(lat * GRADOS_A_RAD);
+  if (c < 0) c = 0;
+  uint32_t q = (uint32_t)(c * 32768.0 + 0.5);
+  return q > 32767 ? 32767 : (uint16_t)q;
+}
+
+int32_t gradosAE6(double grados) {
+  return (int32_t)(grados * 1e6 + (grados < 0 ? -0.5 : 0.5));
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+// ====== Geodesia ======
+// Distancias entre fixes GPS en varias precisiones. El ESP8266 no tiene FPU:
+// cada operación en double se emula y un haversine en double cuesta decenas
+// de microsegundos. Cada uso elige la variante más barata que le alcanza.
+//
+// Errores máximos medidos contra distanciaHaversine (double) para distancias
+// de hasta 5 km y latitudes de hasta ±60°:
+//
+//   distanciaHaversine            referencia (esfera de radio 6371 km)
+//   distanciaHaversineF           float32: < 1,7 m (resolución de una longitud
+//                                 cercana a ±180° guardada en float)
+//   ProyeccionLocal::distancia    float32 con cos(lat) cacheado: < 0,03 %
+//                                 (1,5 m a 5 km)
+//   distanciaMicrogradosCm        entera en 1e-6 grados: < 0,2 m + 0,1 %
+//
+// Las aproximaciones planas son peores cuanto más larga la distancia y más
+// lejos está el punto del origen de la proyección; no sirven para tramos de
+// decenas de km.
+
+const double RADIO_TIERRA_M = 6371000.0;
+
+// Referencia en double
+double distanciaHaversine(double lat1, double lon1, double lat2, double lon2);
+
+// Haversine en float32
+float distanciaHaversineF(float lat1, float lon1, float lat2, float lon2);
+
+// Equirectangular: el llamador pasa cos(lat) ya calculado
+float distanciaEquirectangular(double lat1, double lon1, double lat2, double lon2, float cosLat);
+
+// Equirectangular con cos(lat) cacheado. El coseno se recalcula solo si la
+// latitud se alejó más de 'margenGrados' del origen.
+class ProyeccionLocal {
+ public:
+  explicit ProyeccionLocal(float margenGrados = 0.1f);
+
+  float distancia(double lat1, double lon1, double lat2, double lon2);
+  float cosenoLatitud() const { return coseno; }
+
+ private:
+  void fijarOrigen(double lat);
+
+  float margenGrados;
+  double latOrigen;
+  float coseno;
+  bool iniciada;
+};
+
+// Entera: coordenadas en 1e-6 grados y coseno en Q15 (ver cosenoQ15).
+// Devuelve centímetros; sin operaciones de punto flotante.
+uint32_t distanciaMicrogradosCm(int32_t lat1E6, int32_t lon1E6, int32_t lat2E6, int32_t lon2E6,
+                                uint16_t cosLatQ15);
+uint16_t cosenoQ15(double lat);
+int32_t gradosAE6(double grados);
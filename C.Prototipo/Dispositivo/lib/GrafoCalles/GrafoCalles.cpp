@@ -0,0 +1,641 @@
+#include "GrafoCalles.h"
+
+#include <Geodesia.h>
+#include <LineasCarga.h>
+
+#include <math.h>
+#include <string.h>
+
+static const char MAGIA[4] = {'C', 'A', 'L', '1'};
+static const uint32_t SIN_CELDA = 0xFFFFFFFF;
+// Metros por microgrado de latitud sobre la esfera de referencia
+static const float METROS_POR_MICROGRADO_F = (float)(RADIO_TIERRA_M * M_PI / 180.0 / 1e6);
+// Microgrados por km de latitud, redondeado para arriba (8993,2)
+static const uint32_t MICROGRADOS_POR_KM = 8994;
+// En GEOCERCAS_RECIBIDAS un "b" es un registro con esta latitud
+static const int32_t TRAMO_BORRADO = INT32_MIN;
+// Costo de pasar al tramo del fix desde el anterior
+static const float COSTO_TRAMO_CONECTADO = 0.5f;
+static const float COSTO_TRAMO_SUELTO = 1.5f;
+
+// Caja del tramo agrandada en GRAFO_MARGEN_INDICE_M
+static void cajaTramo(const RegistroTramo& t, int32_t& latMin, int32_t& lonMin, int32_t& latMax, int32_t& lonMax) {
+  latMin = t.lat0E6 < t.lat1E6 ? t.lat0E6 : t.lat1E6;
+  latMax = t.lat0E6 < t.lat1E6 ? t.lat1E6 : t.lat0E6;
+  lonMin = t.lon0E6 < t.lon1E6 ? t.lon0E6 : t.lon1E6;
+  lonMax = t.lon0E6 < t.lon1E6 ? t.lon1E6 : t.lon0E6;
+  uint16_t cosLat = cosenoQ15((((int64_t)latMin + latMax) / 2) / 1e6);
+  int32_t mLat = (int32_t)((uint32_t)GRAFO_MARGEN_INDICE_M * MICROGRADOS_POR_KM / 1000 + 1);
+  int32_t mLon = (int32_t)(((int64_t)mLat << 15) / (cosLat ? cosLat : 1));
+  latMin -= mLat;
+  latMax += mLat;
+  lonMin -= mLon;
+  lonMax += mLon;
+}
+
+// Diferencia entre dos rumbos sin importar el sentido: 0 a 90 grados
+static float diferenciaRumbo(float a, float b) {
+  float d = fmodf(fabsf(a - b), 180.0f);
+  return d > 90.0f ? 180.0f - d : d;
+}
+
+// ====== GrafoCalles ======
+
+GrafoCalles::GrafoCalles(AlmacenGeocercas& almacen, const ConfigGrafoCalles& config, uint16_t* celdas,
+                         uint16_t maxCeldas, uint16_t* refs, uint16_t capacidadRefs)
+    : almacen(almacen),
+      config(),
+      stats(),
+      activo(false),
+      cabecera(),
+      celdaActual(SIN_CELDA),
+      cantidadCandidatos(0),
+      conocida(false),
+      hayAnterior(false),
+      anterior(),
+      cuenta(0),
+      cantidadRecorridos(0),
+      recorridoLleno(false),
+      cargando(false),
+      cargaParcial(false),
+      cargaVersion(0),
+      cargaLineas(0),
+      ultimoIdCargado(0),
+      cargaLatMin(0),
+      cargaLonMin(0),
+      cargaLatMax(0),
+      cargaLonMax(0),
+      celdas(celdas),
+      maxCeldas(maxCeldas),
+      refs(refs),
+      capacidadRefs(capacidadRefs),
+      fase(FASE_NADA),
+      nueva(),
+      offsetLectura(0),
+      tramoLeido(0),
+      celdaDesde(0),
+      celdaHasta(0),
+      baseRefs(0),
+      activos(),
+      cambios() {
+  fijarConfig(config);
+}
+
+void GrafoCalles::fijarConfig(const ConfigGrafoCalles& c) {
+  config = c;
+  if (config.radioM == 0) config.radioM = 1;
+  if (config.radioM > GRAFO_MARGEN_INDICE_M) config.radioM = GRAFO_MARGEN_INDICE_M;
+  if (config.difRumboMaxGrados == 0) config.difRumboMaxGrados = 1;
+  if (config.fixesConfirmar == 0) config.fixesConfirmar = 1;
+  if (config.fixesSoltar == 0) config.fixesSoltar = 1;
+}
+
+uint32_t GrafoCalles::offsetCeldas(const CabeceraGrafo& c) const {
+  return sizeof(CabeceraGrafo) + c.refs * sizeof(uint16_t);
+}
+
+uint32_t GrafoCalles::offsetTramos(const CabeceraGrafo& c) const {
+  return offsetCeldas(c) + ((uint32_t)c.columnas * c.filas + 1) * sizeof(uint16_t);
+}
+
+bool GrafoCalles::iniciar() {
+  activo = false;
+  celdaActual = SIN_CELDA;
+  cantidadCandidatos = 0;
+  CabeceraGrafo c;
+  if (almacen.leer(GEOCERCAS_ACTIVAS, 0, (uint8_t*)&c, sizeof(c)) != sizeof(c)) return false;
+  if (memcmp(c.magia, MAGIA, sizeof(MAGIA)) != 0 || c.columnas == 0 || c.filas == 0 || c.celdaE6 == 0) {
+    return false;
+  }
+  if (almacen.tamano(GEOCERCAS_ACTIVAS) != offsetTramos(c) + c.tramos * sizeof(RegistroTramo)) return false;
+  cabecera = c;
+  activo = true;
+  return true;
+}
+
+// ====== Carga ======
+
+ResultadoCarga GrafoCalles::recibir(const char* datos, size_t largo) {
+  const char* fin = datos + largo;
+  bool completa = false;
+  while (datos < fin) {
+    const char* finLinea = (const char*)memchr(datos, '\n', fin - datos);
+    if (!finLinea) finLinea = fin;
+    ResultadoCarga r = procesarLinea(datos, finLinea);
+    if (r == CARGA_COMPLETA) {
+      completa = true;
+    } else if (r != CARGA_EN_CURSO) {
+      return r;
+    }
+    datos = finLinea + 1;
+  }
+  return completa ? CARGA_COMPLETA : CARGA_EN_CURSO;
+}
+
+ResultadoCarga GrafoCalles::abortarCarga(ResultadoCarga motivo) {
+  cargando = false;
+  almacen.vaciar(GEOCERCAS_RECIBIDAS);
+  return motivo;
+}
+
+void GrafoCalles::incluirEnCaja(const RegistroTramo& t, bool primero) {
+  int32_t latMin, lonMin, latMax, lonMax;
+  cajaTramo(t, latMin, lonMin, latMax, lonMax);
+  if (primero || latMin < cargaLatMin) cargaLatMin = latMin;
+  if (primero || lonMin < cargaLonMin) cargaLonMin = lonMin;
+  if (primero || latMax > cargaLatMax) cargaLatMax = latMax;
+  if (primero || lonMax > cargaLonMax) cargaLonMax = lonMax;
+}
+
+ResultadoCarga GrafoCalles::procesarLinea(const char* p, const char* fin) {
+  p = saltarEspacios(p, fin);
+  if (p == fin || *p == '#') return CARGA_EN_CURSO;
+
+  if (leerPalabra(p, fin, "inicio")) {
+    uint32_t v, base = 0;
+    bool parcial = false;
+    if (!leerNatural(p, fin, v)) return cargando ? abortarCarga(CARGA_MAL_FORMADA) : CARGA_MAL_FORMADA;
+    if (p != fin) {
+      if (!leerNatural(p, fin, base) || p != fin) {
+        return cargando ? abortarCarga(CARGA_MAL_FORMADA) : CARGA_MAL_FORMADA;
+      }
+      parcial = true;
+    }
+    if (parcial && base != version()) return cargando ? abortarCarga(CARGA_OTRA_BASE) : CARGA_OTRA_BASE;
+    // La compilación en curso lee el archivo que se va a pisar
+    fase = FASE_NADA;
+    if (!almacen.vaciar(GEOCERCAS_RECIBIDAS)) return abortarCarga(CARGA_ERROR_ALMACEN);
+    cargando = true;
+    cargaParcial = parcial;
+    cargaVersion = v;
+    cargaLineas = 0;
+    ultimoIdCargado = 0;
+    return CARGA_EN_CURSO;
+  }
+
+  if (leerPalabra(p, fin, "fin")) {
+    if (!cargando) return CARGA_SIN_INICIO;
+    uint32_t v, cantidad;
+    if (!leerNatural(p, fin, v) || !leerNatural(p, fin, cantidad) || p != fin) {
+      return abortarCarga(CARGA_MAL_FORMADA);
+    }
+    if (v != cargaVersion || cantidad != cargaLineas) return abortarCarga(CARGA_INCOMPLETA);
+    cargando = false;
+
+    memset(&nueva, 0, sizeof(nueva));
+    memcpy(nueva.magia, MAGIA, sizeof(MAGIA));
+    nueva.version = cargaVersion;
+    if (cargaParcial) {
+      // La caja y la cantidad salen de la unión
+      if (!almacen.vaciar(GEOCERCAS_NUEVAS)) return abortarCompilacion(CARGA_ERROR_ALMACEN);
+      if (!iniciarLector(activos, GEOCERCAS_ACTIVAS, offsetTramos(cabecera), tramos()) ||
+          !iniciarLector(cambios, GEOCERCAS_RECIBIDAS, 0, cargaLineas)) {
+        return abortarCompilacion(CARGA_ERROR_ALMACEN);
+      }
+      fase = FASE_UNIR;
+    } else {
+      nueva.tramos = cargaLineas;
+      prepararGrilla();
+    }
+    return CARGA_COMPLETA;
+  }
+
+  bool borrado = leerPalabra(p, fin, "b");
+  if (!borrado && !leerPalabra(p, fin, "t")) return cargando ? abortarCarga(CARGA_MAL_FORMADA) : CARGA_MAL_FORMADA;
+  if (!cargando) return CARGA_SIN_INICIO;
+  if (borrado && !cargaParcial) return abortarCarga(CARGA_MAL_FORMADA);
+  if (cargaLineas >= GRAFO_MAX_TRAMOS) return abortarCarga(CARGA_SIN_LUGAR);
+
+  RegistroTramo t;
+  memset(&t, 0, sizeof(t));
+  // IDs crecientes: la unión con el grafo activo es una sola pasada
+  if (!leerNatural(p, fin, t.id) || t.id == 0 || t.id <= ultimoIdCargado) return abortarCarga(CARGA_MAL_FORMADA);
+  if (borrado) {
+    if (p != fin) return abortarCarga(CARGA_MAL_FORMADA);
+    t.lat0E6 = TRAMO_BORRADO;
+  } else if (!leerMicrogrados(p, fin, 90000000, t.lat0E6) || !leerMicrogrados(p, fin, 180000000, t.lon0E6) ||
+             !leerMicrogrados(p, fin, 90000000, t.lat1E6) || !leerMicrogrados(p, fin, 180000000, t.lon1E6) ||
+             p != fin) {
+    return abortarCarga(CARGA_MAL_FORMADA);
+  }
+  if (!almacen.anexar(GEOCERCAS_RECIBIDAS, (const uint8_t*)&t, sizeof(t))) {
+    return abortarCarga(CARGA_ERROR_ALMACEN);
+  }
+  // Con cambios la caja se arma en la unión, con los tramos que quedan
+  if (!cargaParcial) incluirEnCaja(t, cargaLineas == 0);
+  ultimoIdCargado = t.id;
+  cargaLineas++;
+  return CARGA_EN_CURSO;
+}
+
+// ====== Compilación del índice ======
+
+// Grilla sobre la caja de todos los tramos con celdas cuadradas en grados y
+// no más de maxCeldas, como la de las geocercas
+void GrafoCalles::prepararGrilla() {
+  CabeceraGrafo& c = nueva;
+  c.celdaE6 = GRAFO_CELDA_MINIMA_E6;
+  c.columnas = 1;
+  c.filas = 1;
+  c.refs = 0;
+  if (c.tramos > 0) {
+    uint64_t alto = (uint64_t)((int64_t)cargaLatMax - cargaLatMin) + 1;
+    uint64_t ancho = (uint64_t)((int64_t)cargaLonMax - cargaLonMin) + 1;
+    uint64_t celda = (uint64_t)sqrt((double)alto * (double)ancho / maxCeldas);
+    if (celda < GRAFO_CELDA_MINIMA_E6) celda = GRAFO_CELDA_MINIMA_E6;
+    while (((alto + celda - 1) / celda) * ((ancho + celda - 1) / celda) > maxCeldas) {
+      celda += celda / 16 + 1;
+    }
+    c.latMinE6 = cargaLatMin;
+    c.lonMinE6 = cargaLonMin;
+    c.celdaE6 = (uint32_t)celda;
+    c.filas = (uint16_t)((alto + celda - 1) / celda);
+    c.columnas = (uint16_t)((ancho + celda - 1) / celda);
+  }
+  memset(celdas, 0, ((uint32_t)c.columnas * c.filas + 1) * sizeof(uint16_t));
+  fase = FASE_CONTAR;
+  offsetLectura = 0;
+  tramoLeido = 0;
+}
+
+bool GrafoCalles::leerTramo(ArchivoGeocercas archivo, uint32_t& offset, RegistroTramo& t) {
+  if (almacen.leer(archivo, offset, (uint8_t*)&t, sizeof(t)) != sizeof(t)) return false;
+  offset += sizeof(t);
+  return true;
+}
+
+// El tramo siguiente de GEOCERCAS_RECIBIDAS
+bool GrafoCalles::leerRecibido(RegistroTramo& t) {
+  if (!leerTramo(GEOCERCAS_RECIBIDAS, offsetLectura, t)) return false;
+  tramoLeido++;
+  return true;
+}
+
+static uint32_t acotar(int64_t valor, uint32_t maximo) {
+  if (valor < 0) return 0;
+  return valor > maximo ? maximo : (uint32_t)valor;
+}
+
+void GrafoCalles::celdasDeTramo(const RegistroTramo& t, uint32_t& col0, uint32_t& fil0, uint32_t& col1,
+                                uint32_t& fil1) const {
+  const CabeceraGrafo& c = nueva;
+  int32_t latMin, lonMin, latMax, lonMax;
+  cajaTramo(t, latMin, lonMin, latMax, lonMax);
+  col0 = acotar(((int64_t)lonMin - c.lonMinE6) / c.celdaE6, c.columnas - 1);
+  col1 = acotar(((int64_t)lonMax - c.lonMinE6) / c.celdaE6, c.columnas - 1);
+  fil0 = acotar(((int64_t)latMin - c.latMinE6) / c.celdaE6, c.filas - 1);
+  fil1 = acotar(((int64_t)latMax - c.latMinE6) / c.celdaE6, c.filas - 1);
+}
+
+ResultadoCarga GrafoCalles::abortarCompilacion(ResultadoCarga motivo) {
+  fase = FASE_NADA;
+  almacen.vaciar(GEOCERCAS_NUEVAS);
+  almacen.vaciar(GEOCERCAS_RECIBIDAS);
+  return motivo;
+}
+
+// Elige el bloque de celdas cuyos refs entran en 'refs' a partir de celdaDesde
+bool GrafoCalles::prepararBloqueRefs() {
+  uint32_t total = (uint32_t)nueva.columnas * nueva.filas;
+  baseRefs = celdas[celdaDesde];
+  celdaHasta = celdaDesde;
+  while (celdaHasta < total && (uint32_t)(celdas[celdaHasta + 1] - baseRefs) <= capacidadRefs) celdaHasta++;
+  offsetLectura = 0;
+  tramoLeido = 0;
+  return celdaHasta > celdaDesde;
+}
+
+bool GrafoCalles::iniciarLector(LectorTramos& l, ArchivoGeocercas archivo, uint32_t offset, uint32_t cantidad) {
+  l.archivo = archivo;
+  l.offset = offset;
+  l.quedan = cantidad;
+  l.posicion = 0;
+  l.cantidad = 0;
+  return avanzarLector(l);
+}
+
+// Pasa al tramo siguiente; con el lote agotado lee el próximo
+bool GrafoCalles::avanzarLector(LectorTramos& l) {
+  if (l.posicion < l.cantidad) l.posicion++;
+  if (l.posicion < l.cantidad || l.quedan == 0) return true;
+  uint8_t n = l.quedan < GRAFO_LOTE_UNION ? (uint8_t)l.quedan : GRAFO_LOTE_UNION;
+  size_t bytes = n * sizeof(RegistroTramo);
+  if (almacen.leer(l.archivo, l.offset, (uint8_t*)l.lote, bytes) != bytes) return false;
+  l.offset += bytes;
+  l.quedan -= n;
+  l.posicion = 0;
+  l.cantidad = n;
+  return true;
+}
+
+// Mezcla del grafo activo y los cambios, los dos ordenados por ID, en una
+// lista de tramos en GEOCERCAS_NUEVAS que después pasa a ser la recibida
+ResultadoCarga GrafoCalles::avanzarUnion(uint16_t tramosPorPaso) {
+  for (uint16_t k = 0; k < tramosPorPaso && (quedaEnLector(activos) || quedaEnLector(cambios)); k++) {
+    bool hayActivo = quedaEnLector(activos), hayCambio = quedaEnLector(cambios);
+    const RegistroTramo* a = hayActivo ? &activos.lote[activos.posicion] : nullptr;
+    const RegistroTramo* c = hayCambio ? &cambios.lote[cambios.posicion] : nullptr;
+    const RegistroTramo* sale = nullptr;
+    bool avanzarActivo = false, avanzarCambio = false;
+    if (a && (!c || a->id < c->id)) {
+      sale = a;
+      avanzarActivo = true;
+    } else {
+      // Un cambio reemplaza o borra al tramo activo con el mismo ID
+      if (c->lat0E6 != TRAMO_BORRADO) sale = c;
+      avanzarActivo = a && a->id == c->id;
+      avanzarCambio = true;
+    }
+    if (sale) {
+      if (nueva.tramos >= GRAFO_MAX_TRAMOS) return abortarCompilacion(CARGA_SIN_LUGAR);
+      if (!almacen.anexar(GEOCERCAS_NUEVAS, (const uint8_t*)sale, sizeof(RegistroTramo))) {
+        return abortarCompilacion(CARGA_ERROR_ALMACEN);
+      }
+      incluirEnCaja(*sale, nueva.tramos == 0);
+      nueva.tramos++;
+    }
+    if ((avanzarActivo && !avanzarLector(activos)) || (avanzarCambio && !avanzarLector(cambios))) {
+      return abortarCompilacion(CARGA_ERROR_ALMACEN);
+    }
+  }
+  if (quedaEnLector(activos) || quedaEnLector(cambios)) return CARGA_EN_CURSO;
+
+  // Sin tramos no llegó a crearse el archivo
+  bool listo = nueva.tramos > 0 ? almacen.reemplazar(GEOCERCAS_NUEVAS, GEOCERCAS_RECIBIDAS)
+                                : almacen.vaciar(GEOCERCAS_RECIBIDAS);
+  if (!listo) return abortarCompilacion(CARGA_ERROR_ALMACEN);
+  prepararGrilla();
+  return CARGA_EN_CURSO;
+}
+
+ResultadoCarga GrafoCalles::avanzarCompilacion(uint16_t tramosPorPaso) {
+  if (fase == FASE_NADA) return CARGA_COMPLETA;
+  uint32_t total = (uint32_t)nueva.columnas * nueva.filas;
+  RegistroTramo t;
+
+  switch (fase) {
+    case FASE_UNIR:
+      return avanzarUnion(tramosPorPaso);
+
+    case FASE_CONTAR: {
+      for (uint16_t k = 0; k < tramosPorPaso && tramoLeido < nueva.tramos; k++) {
+        if (!leerRecibido(t)) return abortarCompilacion(CARGA_ERROR_ALMACEN);
+        uint32_t col0, fil0, col1, fil1;
+        celdasDeTramo(t, col0, fil0, col1, fil1);
+        nueva.refs += (col1 - col0 + 1) * (fil1 - fil0 + 1);
+        if (nueva.refs > 0xFFFF) return abortarCompilacion(CARGA_SIN_LUGAR);
+        for (uint32_t f = fil0; f <= fil1; f++) {
+          for (uint32_t col = col0; col <= col1; col++) celdas[f * nueva.columnas + col]++;
+        }
+      }
+      if (tramoLeido < nueva.tramos) return CARGA_EN_CURSO;
+
+      // Cuentas -> comienzo de cada celda en refs
+      uint16_t acumulado = 0;
+      for (uint32_t i = 0; i < total; i++) {
+        uint16_t n = celdas[i];
+        celdas[i] = acumulado;
+        acumulado += n;
+      }
+      celdas[total] = acumulado;
+      if (!almacen.vaciar(GEOCERCAS_NUEVAS) ||
+          !almacen.anexar(GEOCERCAS_NUEVAS, (const uint8_t*)&nueva, sizeof(nueva))) {
+        return abortarCompilacion(CARGA_ERROR_ALMACEN);
+      }
+      fase = FASE_REFS;
+      celdaDesde = 0;
+      if (nueva.refs > 0 && !prepararBloqueRefs()) return abortarCompilacion(CARGA_SIN_LUGAR);
+      return CARGA_EN_CURSO;
+    }
+
+    case FASE_REFS: {
+      // celdas[i] hace de cursor de escritura, como en las geocercas
+      if (nueva.refs > 0) {
+        for (uint16_t k = 0; k < tramosPorPaso && tramoLeido < nueva.tramos; k++) {
+          uint16_t indice = (uint16_t)tramoLeido;
+          if (!leerRecibido(t)) return abortarCompilacion(CARGA_ERROR_ALMACEN);
+          uint32_t col0, fil0, col1, fil1;
+          celdasDeTramo(t, col0, fil0, col1, fil1);
+          for (uint32_t f = fil0; f <= fil1; f++) {
+            for (uint32_t col = col0; col <= col1; col++) {
+              uint32_t i = f * nueva.columnas + col;
+              if (i >= celdaDesde && i < celdaHasta) refs[celdas[i]++ - baseRefs] = indice;
+            }
+          }
+        }
+        if (tramoLeido < nueva.tramos) return CARGA_EN_CURSO;
+
+        uint16_t n = celdas[celdaHasta] - baseRefs;
+        if (!almacen.anexar(GEOCERCAS_NUEVAS, (const uint8_t*)refs, n * sizeof(uint16_t))) {
+          return abortarCompilacion(CARGA_ERROR_ALMACEN);
+        }
+        celdaDesde = celdaHasta;
+        if (celdas[celdaDesde] != celdas[total]) {
+          if (!prepararBloqueRefs()) return abortarCompilacion(CARGA_SIN_LUGAR);
+          return CARGA_EN_CURSO;
+        }
+        for (uint32_t i = celdaDesde; i > 0; i--) celdas[i] = celdas[i - 1];
+        celdas[0] = 0;
+      }
+      celdas[total] = (uint16_t)nueva.refs;
+      if (!almacen.anexar(GEOCERCAS_NUEVAS, (const uint8_t*)celdas, (total + 1) * sizeof(uint16_t))) {
+        return abortarCompilacion(CARGA_ERROR_ALMACEN);
+      }
+      fase = FASE_TRAMOS;
+      offsetLectura = 0;
+      tramoLeido = 0;
+      return CARGA_EN_CURSO;
+    }
+
+    case FASE_TRAMOS: {
+      for (uint16_t k = 0; k < tramosPorPaso && tramoLeido < nueva.tramos; k++) {
+        if (!leerRecibido(t)) return abortarCompilacion(CARGA_ERROR_ALMACEN);
+        if (!almacen.anexar(GEOCERCAS_NUEVAS, (const uint8_t*)&t, sizeof(t))) {
+          return abortarCompilacion(CARGA_ERROR_ALMACEN);
+        }
+      }
+      if (tramoLeido < nueva.tramos) return CARGA_EN_CURSO;
+      return terminarCompilacion() ? CARGA_COMPLETA : abortarCompilacion(CARGA_ERROR_ALMACEN);
+    }
+
+    default:
+      return CARGA_COMPLETA;
+  }
+}
+
+bool GrafoCalles::terminarCompilacion() {
+  fase = FASE_NADA;
+  if (!almacen.reemplazar(GEOCERCAS_NUEVAS, GEOCERCAS_ACTIVAS)) return false;
+  almacen.vaciar(GEOCERCAS_RECIBIDAS);
+  // El tramo anterior sigue valiendo para la transición: los IDs se mantienen
+  // entre versiones
+  return iniciar();
+}
+
+// ====== Emparejamiento ======
+
+uint32_t GrafoCalles::celdaDe(int32_t latE6, int32_t lonE6) const {
+  if (!activo) return SIN_CELDA;
+  int64_t dLat = (int64_t)latE6 - cabecera.latMinE6;
+  int64_t dLon = (int64_t)lonE6 - cabecera.lonMinE6;
+  if (dLat < 0 || dLon < 0) return SIN_CELDA;
+  uint32_t fil = (uint32_t)(dLat / cabecera.celdaE6);
+  uint32_t col = (uint32_t)(dLon / cabecera.celdaE6);
+  if (fil >= cabecera.filas || col >= cabecera.columnas) return SIN_CELDA;
+  return fil * cabecera.columnas + col;
+}
+
+// Lee a 'candidatos' los tramos de la celda y calcula su rumbo una sola vez
+bool GrafoCalles::cargarCelda(uint32_t celda) {
+  cantidadCandidatos = 0;
+  if (celda == SIN_CELDA) return false;
+  stats.cambiosCelda++;
+  uint16_t rango[2];
+  stats.lecturas++;
+  if (almacen.leer(GEOCERCAS_ACTIVAS, offsetCeldas(cabecera) + celda * sizeof(uint16_t), (uint8_t*)rango,
+                   sizeof(rango)) != sizeof(rango)) {
+    return false;
+  }
+  uint16_t n = rango[1] - rango[0];
+  if (n > stats.candidatosMax) stats.candidatosMax = n;
+  if (n > GRAFO_MAX_CANDIDATOS) {
+    stats.truncados++;
+    n = GRAFO_MAX_CANDIDATOS;
+  }
+  if (n == 0) return true;
+  uint16_t indices[GRAFO_MAX_CANDIDATOS];
+  stats.lecturas++;
+  if (almacen.leer(GEOCERCAS_ACTIVAS, sizeof(CabeceraGrafo) + rango[0] * sizeof(uint16_t), (uint8_t*)indices,
+                   n * sizeof(uint16_t)) != n * sizeof(uint16_t)) {
+    return false;
+  }
+  uint32_t base = offsetTramos(cabecera);
+  for (uint16_t i = 0; i < n; i++) {
+    RegistroTramo& t = candidatos[cantidadCandidatos];
+    stats.lecturas++;
+    if (almacen.leer(GEOCERCAS_ACTIVAS, base + indices[i] * sizeof(RegistroTramo), (uint8_t*)&t,
+                     sizeof(RegistroTramo)) != sizeof(RegistroTramo)) {
+      return false;
+    }
+    uint16_t cosLat = cosenoQ15((((int64_t)t.lat0E6 + t.lat1E6) / 2) / 1e6);
+    float este = (float)(t.lon1E6 - t.lon0E6) * cosLat / 32768.0f;
+    float norte = (float)(t.lat1E6 - t.lat0E6);
+    float rumbo = atan2f(este, norte) * (float)(180.0 / M_PI);
+    rumbos[cantidadCandidatos] = rumbo < 0 ? rumbo + 180.0f : rumbo;
+    cantidadCandidatos++;
+  }
+  return true;
+}
+
+float GrafoCalles::distanciaM(const RegistroTramo& t, int32_t latE6, int32_t lonE6, uint16_t cosLatQ15) {
+  float ky = METROS_POR_MICROGRADO_F;
+  float kx = METROS_POR_MICROGRADO_F * cosLatQ15 / 32768.0f;
+  float ax = (t.lon0E6 - lonE6) * kx, ay = (t.lat0E6 - latE6) * ky;
+  float bx = (t.lon1E6 - lonE6) * kx, by = (t.lat1E6 - latE6) * ky;
+  float ex = bx - ax, ey = by - ay;
+  float largo2 = ex * ex + ey * ey;
+  float u = largo2 > 0 ? -(ax * ex + ay * ey) / largo2 : 0;
+  if (u < 0) u = 0;
+  if (u > 1) u = 1;
+  float px = ax + u * ex, py = ay + u * ey;
+  return sqrtf(px * px + py * py);
+}
+
+static bool mismoNodo(int32_t latA, int32_t lonA, int32_t latB, int32_t lonB) {
+  return latA - latB <= GRAFO_TOLERANCIA_NODO_E6 && latB - latA <= GRAFO_TOLERANCIA_NODO_E6 &&
+         lonA - lonB <= GRAFO_TOLERANCIA_NODO_E6 && lonB - lonA <= GRAFO_TOLERANCIA_NODO_E6;
+}
+
+bool GrafoCalles::conectados(const RegistroTramo& a, const RegistroTramo& b) {
+  return mismoNodo(a.lat0E6, a.lon0E6, b.lat0E6, b.lon0E6) || mismoNodo(a.lat0E6, a.lon0E6, b.lat1E6, b.lon1E6) ||
+         mismoNodo(a.lat1E6, a.lon1E6, b.lat0E6, b.lon0E6) || mismoNodo(a.lat1E6, a.lon1E6, b.lat1E6, b.lon1E6);
+}
+
+void GrafoCalles::reiniciar() {
+  conocida = false;
+  hayAnterior = false;
+  cuenta = 0;
+  reiniciarRecorrido();
+}
+
+void GrafoCalles::reiniciarRecorrido() {
+  cantidadRecorridos = 0;
+  recorridoLleno = false;
+  // El tramo en curso encabeza el recorrido nuevo
+  if (conocida) anotarRecorrido(anterior.id);
+}
+
+void GrafoCalles::anotarRecorrido(uint32_t id) {
+  if (cantidadRecorridos > 0 && tramosRecorridos[cantidadRecorridos - 1] == id) return;
+  if (cantidadRecorridos == GRAFO_MAX_RECORRIDO) {
+    recorridoLleno = true;
+    return;
+  }
+  tramosRecorridos[cantidadRecorridos++] = id;
+}
+
+CambioEmparejamiento GrafoCalles::emparejar(int32_t latE6, int32_t lonE6, float rumbo, float velocidadKmh) {
+  stats.fixes++;
+  uint32_t celda = celdaDe(latE6, lonE6);
+  if (celda != celdaActual) {
+    cargarCelda(celda);
+    celdaActual = celda;
+  }
+
+  int8_t mejor = -1;
+  float mejorCosto = 0;
+  if (cantidadCandidatos > 0) {
+    uint16_t cosLat = cosenoQ15(latE6 / 1e6);
+    bool conRumbo = velocidadKmh >= config.velocidadRumboKmh;
+    float radio = config.radioM;
+    float difMax = config.difRumboMaxGrados;
+    for (uint8_t k = 0; k < cantidadCandidatos; k++) {
+      const RegistroTramo& t = candidatos[k];
+      float d = distanciaM(t, latE6, lonE6, cosLat);
+      if (d > radio) continue;
+      float costo = (d / radio) * (d / radio);
+      if (conRumbo) {
+        float dif = diferenciaRumbo(rumbo, rumbos[k]);
+        if (dif > difMax) continue;
+        costo += (dif / difMax) * (dif / difMax);
+      }
+      if (hayAnterior && t.id != anterior.id) {
+        costo += conectados(anterior, t) ? COSTO_TRAMO_CONECTADO : COSTO_TRAMO_SUELTO;
+      }
+      if (mejor < 0 || costo < mejorCosto) {
+        mejor = (int8_t)k;
+        mejorCosto = costo;
+      }
+    }
+  }
+
+  if (mejor >= 0) {
+    stats.emparejados++;
+    const RegistroTramo& t = candidatos[mejor];
+    bool otro = !hayAnterior || t.id != anterior.id;
+    anterior = t;
+    hayAnterior = true;
+    if (!conocida) {
+      if (++cuenta < config.fixesConfirmar) return EMPAREJAMIENTO_SIGUE;
+      conocida = true;
+      cuenta = 0;
+      anotarRecorrido(t.id);
+      return EMPAREJAMIENTO_CONOCIDA;
+    }
+    cuenta = 0;
+    if (!otro) return EMPAREJAMIENTO_SIGUE;
+    anotarRecorrido(t.id);
+    return EMPAREJAMIENTO_OTRO_TRAMO;
+  }
+
+  if (!conocida) {
+    cuenta = 0;
+    hayAnterior = false;
+    return EMPAREJAMIENTO_SIGUE;
+  }
+  if (++cuenta < config.fixesSoltar) return EMPAREJAMIENTO_SIGUE;
+  conocida = false;
+  cuenta = 0;
+  hayAnterior = false;
+  return EMPAREJAMIENTO_NUEVA;
+}
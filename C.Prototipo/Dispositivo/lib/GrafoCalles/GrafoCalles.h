@@ -0,0 +1,247 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <AlmacenGeocercas.h>
+#include <Geocercas.h>
+
+// ====== Grafo de calles conocidas ======
+// Los tramos de calle que el backend ya tiene para la zona de operación,
+// guardados en flash con un índice de grilla como el de las geocercas. Cada
+// fix del mapeo se empareja contra los tramos de su celda; mientras el
+// camión va por calles conocidas el firmware no sube sus puntos, solo los
+// identificadores de los tramos recorridos.
+//
+// Carga: líneas de texto por MQTT, varias por mensaje y sin cortar una línea
+// entre dos mensajes. Los tramos van ordenados por ID, de menor a mayor.
+//
+//   inicio VERSION [BASE]              con BASE: cambios sobre la versión BASE
+//   t ID LAT LON LAT LON               tramo nuevo o cambiado (extremos)
+//   b ID                               tramo borrado (solo con BASE)
+//   fin VERSION CANTIDAD               CANTIDAD: líneas t y b
+//
+// Una carga con BASE distinta de la versión en uso se rechaza con
+// CARGA_OTRA_BASE y el backend tiene que mandar el conjunto completo. Con
+// BASE, la compilación empieza uniendo el conjunto activo con los cambios
+// (los dos ordenados por ID, en una sola pasada) y sigue igual que una
+// carga completa.
+//
+// Archivo compilado (GEOCERCAS_ACTIVAS del almacén del grafo):
+//
+//   CabeceraGrafo
+//   refs[refs]           uint16: índice de tramo, agrupados por celda
+//   celdas[celdas + 1]   uint16: dónde empieza cada celda en refs
+//   tramos[tramos]       RegistroTramo, ordenados por ID
+//
+// Cada tramo figura en las celdas que toca su caja agrandada en
+// GRAFO_MARGEN_INDICE_M, así un fix encuentra en su celda todos los tramos
+// que tiene a menos de ese radio.
+//
+// Emparejamiento en línea: cada candidato a menos de 'radioM' y con el
+// rumbo parecido (en cualquier sentido de circulación) suma un costo por
+// distancia, por rumbo y por la transición desde el tramo anterior (mismo
+// tramo, tramo conectado u otro); gana el más barato, como un Viterbi que
+// conserva un solo estado. El camión pasa a calle conocida después de
+// 'fixesConfirmar' fixes emparejados seguidos y vuelve a calle nueva después
+// de 'fixesSoltar' fixes sin tramo. Debajo de 'velocidadRumboKmh' el rumbo
+// del GPS no se usa.
+//
+// Limitaciones: el grafo no cruza el antimeridiano; una celda aporta hasta
+// GRAFO_MAX_CANDIDATOS tramos (el resto se cuenta en las estadísticas). No
+// depende de Arduino.
+
+const uint8_t GRAFO_MAX_CANDIDATOS = 32;
+const uint8_t GRAFO_MAX_RECORRIDO = 24;
+const uint32_t GRAFO_MAX_TRAMOS = 0xFFFF;     // índices uint16 en refs
+const uint32_t GRAFO_CELDA_MINIMA_E6 = 500;   // ~55 m
+const uint8_t GRAFO_MARGEN_INDICE_M = 40;     // tope de radioM
+const int32_t GRAFO_TOLERANCIA_NODO_E6 = 20;  // extremos a ~2 m se toman como el mismo nodo
+const uint8_t GRAFO_LOTE_UNION = 8;           // tramos por lectura de cada lado en la unión
+
+// Se copia tal cual a flash (memcpy); 20 bytes
+struct RegistroTramo {
+  uint32_t id;
+  int32_t lat0E6, lon0E6;
+  int32_t lat1E6, lon1E6;
+};
+
+enum CambioEmparejamiento : uint8_t {
+  EMPAREJAMIENTO_SIGUE,      // mismo estado y mismo tramo
+  EMPAREJAMIENTO_CONOCIDA,   // confirmó una calle conocida
+  EMPAREJAMIENTO_OTRO_TRAMO, // sigue en calles conocidas, en otro tramo
+  EMPAREJAMIENTO_NUEVA       // dejó las calles conocidas
+};
+
+struct ConfigGrafoCalles {
+  uint8_t radioM;
+  uint8_t difRumboMaxGrados;
+  uint8_t fixesConfirmar;
+  uint8_t fixesSoltar;
+  uint8_t velocidadRumboKmh;
+};
+
+struct EstadisticasGrafo {
+  uint32_t fixes;
+  uint32_t emparejados;    // fixes con un tramo a menos de radioM
+  uint32_t cambiosCelda;
+  uint32_t lecturas;       // lecturas del almacén al cambiar de celda
+  uint16_t candidatosMax;
+  uint32_t truncados;      // celdas con más de GRAFO_MAX_CANDIDATOS tramos
+};
+
+class GrafoCalles {
+ public:
+  // 'almacen' es propio del grafo (otro directorio que las geocercas);
+  // 'celdas' tiene maxCeldas + 1 entradas y 'refs' capacidadRefs
+  GrafoCalles(AlmacenGeocercas& almacen, const ConfigGrafoCalles& config, uint16_t* celdas, uint16_t maxCeldas,
+              uint16_t* refs, uint16_t capacidadRefs);
+
+  // Abre el grafo activo guardado en flash; false si no hay uno válido
+  bool iniciar();
+
+  // Un mensaje de carga; ver el formato arriba
+  ResultadoCarga recibir(const char* datos, size_t largo);
+
+  // Arma el índice de a 'tramosPorPaso' tramos leídos. CARGA_EN_CURSO
+  // mientras falte; CARGA_COMPLETA cuando el grafo nuevo ya está en uso.
+  ResultadoCarga avanzarCompilacion(uint16_t tramosPorPaso);
+  bool compilando() const { return fase != FASE_NADA; }
+
+  // Un fix del mapeo; rumbo en grados y velocidad en km/h como los da el GPS
+  CambioEmparejamiento emparejar(int32_t latE6, int32_t lonE6, float rumbo, float velocidadKmh);
+
+  // Al empezar o terminar un mapeo: sin tramo anterior ni recorrido
+  void reiniciar();
+
+  bool enConocida() const { return conocida; }
+  // Tramo del último fix emparejado; 0 sin tramo
+  uint32_t tramoActual() const { return conocida ? anterior.id : 0; }
+
+  // IDs de los tramos recorridos en calles conocidas desde reiniciarRecorrido(),
+  // sin repetir consecutivos
+  const uint32_t* recorrido() const { return tramosRecorridos; }
+  uint8_t largoRecorrido() const { return cantidadRecorridos; }
+  bool recorridoDesbordado() const { return recorridoLleno; }
+  void reiniciarRecorrido();
+
+  void fijarConfig(const ConfigGrafoCalles& c);
+
+  uint32_t version() const { return activo ? cabecera.version : 0; }
+  uint32_t tramos() const { return activo ? cabecera.tramos : 0; }
+  uint32_t versionCargando() const { return cargaVersion; }
+  const EstadisticasGrafo& estadisticas() const { return stats; }
+
+  // Distancia en metros del punto al tramo, sobre el plano local
+  static float distanciaM(const RegistroTramo& t, int32_t latE6, int32_t lonE6, uint16_t cosLatQ15);
+  static bool conectados(const RegistroTramo& a, const RegistroTramo& b);
+
+ private:
+  struct CabeceraGrafo {
+    char magia[4];
+    uint32_t version;
+    uint32_t tramos;
+    uint32_t refs;
+    int32_t latMinE6;
+    int32_t lonMinE6;
+    uint32_t celdaE6;
+    uint16_t columnas;
+    uint16_t filas;
+  };
+
+  // Lectura de a GRAFO_LOTE_UNION tramos: la unión alterna dos archivos y
+  // cada cambio de archivo puede costar abrirlo
+  struct LectorTramos {
+    ArchivoGeocercas archivo;
+    uint32_t offset;  // del próximo lote
+    uint32_t quedan;  // tramos sin leer después del lote
+    uint8_t posicion;
+    uint8_t cantidad;
+    RegistroTramo lote[GRAFO_LOTE_UNION];
+  };
+
+  enum Fase : uint8_t {
+    FASE_NADA,
+    FASE_UNIR,
+    FASE_CONTAR,
+    FASE_REFS,
+    FASE_TRAMOS
+  };
+
+  ResultadoCarga procesarLinea(const char* p, const char* fin);
+  ResultadoCarga abortarCarga(ResultadoCarga motivo);
+  ResultadoCarga abortarCompilacion(ResultadoCarga motivo);
+  void incluirEnCaja(const RegistroTramo& t, bool primero);
+  void prepararGrilla();
+  ResultadoCarga avanzarUnion(uint16_t tramosPorPaso);
+  bool iniciarLector(LectorTramos& l, ArchivoGeocercas archivo, uint32_t offset, uint32_t cantidad);
+  bool avanzarLector(LectorTramos& l);
+  static bool quedaEnLector(const LectorTramos& l) { return l.posicion < l.cantidad; }
+  bool leerTramo(ArchivoGeocercas archivo, uint32_t& offset, RegistroTramo& t);
+  bool leerRecibido(RegistroTramo& t);
+  void celdasDeTramo(const RegistroTramo& t, uint32_t& col0, uint32_t& fil0, uint32_t& col1, uint32_t& fil1) const;
+  bool prepararBloqueRefs();
+  bool terminarCompilacion();
+  uint32_t offsetCeldas(const CabeceraGrafo& c) const;
+  uint32_t offsetTramos(const CabeceraGrafo& c) const;
+  uint32_t celdaDe(int32_t latE6, int32_t lonE6) const;
+  bool cargarCelda(uint32_t celda);
+  void anotarRecorrido(uint32_t id);
+
+  AlmacenGeocercas& almacen;
+  ConfigGrafoCalles config;
+  EstadisticasGrafo stats;
+
+  // Grafo activo
+  bool activo;
+  CabeceraGrafo cabecera;
+  uint32_t celdaActual;
+  RegistroTramo candidatos[GRAFO_MAX_CANDIDATOS];
+  float rumbos[GRAFO_MAX_CANDIDATOS];  // de cada candidato, 0 a 180 grados
+  uint8_t cantidadCandidatos;
+
+  // Emparejamiento
+  bool conocida;
+  bool hayAnterior;
+  RegistroTramo anterior;
+  uint8_t cuenta;  // fixes seguidos emparejados (calle nueva) o sin tramo (conocida)
+  uint32_t tramosRecorridos[GRAFO_MAX_RECORRIDO];
+  uint8_t cantidadRecorridos;
+  bool recorridoLleno;
+
+  // Carga en curso
+  bool cargando;
+  bool cargaParcial;
+  uint32_t cargaVersion;
+  uint32_t cargaLineas;
+  uint32_t ultimoIdCargado;
+  int32_t cargaLatMin, cargaLonMin, cargaLatMax, cargaLonMax;
+
+  // Compilación
+  uint16_t* celdas;
+  uint16_t maxCeldas;
+  uint16_t* refs;
+  uint16_t capacidadRefs;
+  Fase fase;
+  CabeceraGrafo nueva;
+  uint32_t offsetLectura;  // en GEOCERCAS_RECIBIDAS
+  uint32_t tramoLeido;     // índice del próximo tramo a leer
+  uint32_t celdaDesde;     // bloque de refs en armado: celdas [celdaDesde, celdaHasta)
+  uint32_t celdaHasta;
+  uint16_t baseRefs;
+  // Unión: el grafo activo y los cambios recibidos
+  LectorTramos activos;
+  LectorTramos cambios;
+};
+
+// Con las tablas de compilación incluidas
+template <uint16_t MAX_CELDAS, uint16_t CAPACIDAD_REFS>
+class GrafoCallesFija : public GrafoCalles {
+ public:
+  GrafoCallesFija(AlmacenGeocercas& almacen, const ConfigGrafoCalles& config)
+      : GrafoCalles(almacen, config, tablaCeldas, MAX_CELDAS, tablaRefs, CAPACIDAD_REFS) {}
+
+ private:
+  uint16_t tablaCeldas[MAX_CELDAS + 1];
+  uint16_t tablaRefs[CAPACIDAD_REFS];
+};
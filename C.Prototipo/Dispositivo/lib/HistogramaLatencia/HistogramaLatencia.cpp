@@ -0,0 +1,89 @@
+#include "HistogramaLatencia.h"
+
+#include <stdio.h>
+#include <string.h>
+
+HistogramaLatencia::HistogramaLatencia() {
+  reiniciar();
+}
+
+void HistogramaLatencia::reiniciar() {
+  memset(cuentas, 0, sizeof(cuentas));
+  total = 0;
+  mayor = 0;
+  suma = 0;
+}
+
+// ====== Cubetas ======
+// 0 y 1 tienen cubeta propia; desde 2, la potencia de 2 y el bit siguiente
+uint8_t HistogramaLatencia::cubetaDe(uint32_t valor) {
+  if (valor < 2) return (uint8_t)valor;
+  uint8_t potencia = (uint8_t)(31 - __builtin_clz(valor));
+  return (uint8_t)(2 * potencia + ((valor >> (potencia - 1)) & 1));
+}
+
+uint32_t HistogramaLatencia::limiteInferior(uint8_t cubeta) {
+  if (cubeta < 2) return cubeta;
+  uint8_t potencia = cubeta / 2;
+  return (1UL << potencia) | ((uint32_t)(cubeta & 1) << (potencia - 1));
+}
+
+uint32_t HistogramaLatencia::limiteSuperior(uint8_t cubeta) {
+  if (cubeta >= HISTOGRAMA_CUBETAS - 1) return 0xFFFFFFFF;
+  return limiteInferior(cubeta + 1) - 1;
+}
+
+void HistogramaLatencia::registrar(uint32_t valor) {
+  uint8_t c = cubetaDe(valor);
+  if (cuentas[c] < 0xFFFFFFFF) cuentas[c]++;
+  total++;
+  suma += valor;
+  if (valor > mayor) mayor = valor;
+}
+
+void HistogramaLatencia::sumar(const HistogramaLatencia& otro) {
+  for (uint8_t c = 0; c < HISTOGRAMA_CUBETAS; c++) {
+    uint32_t espacio = 0xFFFFFFFF - cuentas[c];
+    cuentas[c] += otro.cuentas[c] < espacio ? otro.cuentas[c] : espacio;
+  }
+  total += otro.total;
+  suma += otro.suma;
+  if (otro.mayor > mayor) mayor = otro.mayor;
+}
+
+// ====== Resumen ======
+uint32_t HistogramaLatencia::percentil(uint8_t porcentaje) const {
+  if (total == 0) return 0;
+  if (porcentaje > 100) porcentaje = 100;
+  // Posición redondeada hacia arriba: el p99 de 10 muestras es la décima
+  uint64_t objetivo = ((uint64_t)total * porcentaje + 99) / 100;
+  if (objetivo == 0) objetivo = 1;
+  uint64_t acumulado = 0;
+  for (uint8_t c = 0; c < HISTOGRAMA_CUBETAS; c++) {
+    acumulado += cuentas[c];
+    if (acumulado >= objetivo) {
+      uint32_t limite = limiteSuperior(c);
+      return limite < mayor ? limite : mayor;
+    }
+  }
+  return mayor;
+}
+
+size_t HistogramaLatencia::describir(char* destino, size_t tamano, uint32_t divisor) const {
+  if (tamano == 0) return 0;
+  if (divisor == 0) divisor = 1;
+  size_t largo = 0;
+  destino[0] = '\0';
+  for (uint8_t c = 0; c < HISTOGRAMA_CUBETAS; c++) {
+    if (cuentas[c] == 0) continue;
+    int n = snprintf(destino + largo, tamano - largo, "%s%lu:%lu", largo > 0 ? "," : "",
+                     (unsigned long)(limiteInferior(c) / divisor), (unsigned long)cuentas[c]);
+    if (n < 0 || (size_t)n >= tamano - largo) {
+      // No entra la cubeta entera: se corta en la anterior
+      destino[largo] = '\0';
+      return largo;
+    }
+    largo += n;
+  }
+  return largo;
+}
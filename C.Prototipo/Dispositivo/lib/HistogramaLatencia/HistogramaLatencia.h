@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ====== Histograma de latencias ======
+// Cubetas fijas en escala logarítmica: dos por cada potencia de 2, así que
+// la cubeta de un valor v cubre como mucho v/2 de ancho (el error de un
+// percentil es menor al 50 %, normalmente bastante menos). 64 cubetas de
+// 32 bits cubren todo el rango de uint32_t sin configurar nada: 256 bytes
+// por histograma.
+//
+// registrar() es un conteo de ceros a la izquierda y un incremento; se puede
+// llamar en cada pasada del loop. La unidad es la del llamador (ciclos de
+// CPU para las fases del loop, milisegundos para la latencia de un fix):
+// 'divisor' en describir() la pasa a la unidad del reporte.
+//
+// percentil() devuelve el límite superior de la cubeta donde cae, acotado por
+// el máximo, que sí es exacto.
+//
+// No depende de Arduino.
+
+const uint8_t HISTOGRAMA_CUBETAS = 64;
+
+class HistogramaLatencia {
+ public:
+  HistogramaLatencia();
+
+  void registrar(uint32_t valor);
+  void reiniciar();
+  // Agrega las cuentas de otro (por ejemplo, uno por hilo al final)
+  void sumar(const HistogramaLatencia& otro);
+
+  uint32_t cantidad() const { return total; }
+  uint32_t maximo() const { return mayor; }
+  uint32_t media() const { return total > 0 ? (uint32_t)(suma / total) : 0; }
+  // porcentaje entre 1 y 100
+  uint32_t percentil(uint8_t porcentaje) const;
+
+  uint32_t cuenta(uint8_t cubeta) const { return cuentas[cubeta]; }
+  static uint8_t cubetaDe(uint32_t valor);
+  static uint32_t limiteInferior(uint8_t cubeta);
+  static uint32_t limiteSuperior(uint8_t cubeta);
+
+  // Cubetas no vacías como "inferior:cuenta,..." con los límites divididos
+  // por 'divisor'; devuelve el largo escrito (sin contar el '\0')
+  size_t describir(char* destino, size_t tamano, uint32_t divisor) const;
+
+ private:
+  uint32_t cuentas[HISTOGRAMA_CUBETAS];
+  uint32_t total;
+  uint32_t mayor;
+  uint64_t suma;
+};
@@ -0,0 +1,84 @@
+#include "LoteTrayecto.h"
+
+LoteTrayecto::LoteTrayecto(const ConfigLote& config) : config(config), cantidadPuntos(0) {
+  if (this->config.maxPuntos == 0 || this->config.maxPuntos > TRAMA_LOTE_MAX_PUNTOS) {
+    this->config.maxPuntos = TRAMA_LOTE_MAX_PUNTOS;
+  }
+}
+
+bool LoteTrayecto::agregar(double lat, double lon, uint32_t tiempoMs) {
+  if (cantidadPuntos < config.maxPuntos) {
+    PuntoLote& p = puntos[cantidadPuntos++];
+    p.latE6 = (int32_t)(lat * 1e6 + (lat < 0 ? -0.5 : 0.5));
+    p.lonE6 = (int32_t)(lon * 1e6 + (lon < 0 ? -0.5 : 0.5));
+    p.tiempoMs = tiempoMs;
+  }
+  return cantidadPuntos >= config.maxPuntos;
+}
+
+bool LoteTrayecto::vencido(uint32_t ahoraMs) const {
+  return cantidadPuntos > 0 && (ahoraMs - puntos[0].tiempoMs) >= config.maxLatenciaMs;
+}
+
+size_t LoteTrayecto::codificarBinario(uint32_t seq, uint16_t calle, uint8_t* destino, size_t capacidad,
+                                      TipoTrama tipo) const {
+  return codificarLote(seq, calle, puntos, cantidadPuntos, destino, capacidad, tipo);
+}
+
+// Redondeo de 1e-6 a 1e-5 grados
+static int32_t aE5(int32_t e6) {
+  return (e6 >= 0) ? (e6 + 5) / 10 : (e6 - 5) / 10;
+}
+
+size_t escribirValorPolyline(int32_t valor, char* destino, size_t capacidad) {
+  uint32_t v = (uint32_t)valor << 1;
+  if (valor < 0) v = ~v;
+  size_t n = 0;
+  while (v >= 0x20) {
+    if (n >= capacidad) return 0;
+    destino[n++] = (char)((0x20 | (v & 0x1F)) + 63);
+    v >>= 5;
+  }
+  if (n >= capacidad) return 0;
+  destino[n++] = (char)(v + 63);
+  return n;
+}
+
+size_t LoteTrayecto::codificarPolyline(char* destino, size_t capacidad) const {
+  size_t usado = 0;
+  int32_t latPrevia = 0;
+  int32_t lonPrevia = 0;
+  for (uint8_t i = 0; i < cantidadPuntos; i++) {
+    int32_t lat = aE5(puntos[i].latE6);
+    int32_t lon = aE5(puntos[i].lonE6);
+    size_t n = escribirValorPolyline(lat - latPrevia, destino + usado, capacidad - usado);
+    if (n == 0) return 0;
+    usado += n;
+    n = escribirValorPolyline(lon - lonPrevia, destino + usado, capacidad - usado);
+    if (n == 0) return 0;
+    usado += n;
+    latPrevia = lat;
+    lonPrevia = lon;
+  }
+  if (usado >= capacidad) return 0;
+  destino[usado] = '\0';
+  return usado;
+}
+
+size_t LoteTrayecto::codificarTiempos(char* destino, size_t capacidad) const {
+  size_t usado = 0;
+  // Diferencias entre tiempos ya redondeados desde el primero, como las
+  // coordenadas: el error no se acumula punto a punto
+  int32_t previoCs = 0;
+  for (uint8_t i = 0; i < cantidadPuntos; i++) {
+    int32_t desdeInicioCs = (int32_t)((puntos[i].tiempoMs - puntos[0].tiempoMs + 5) / 10);
+    int32_t dt = desdeInicioCs - previoCs;
+    previoCs = desdeInicioCs;
+    size_t n = escribirValorPolyline(dt, destino + usado, capacidad - usado);
+    if (n == 0) return 0;
+    usado += n;
+  }
+  if (usado >= capacidad) return 0;
+  destino[usado] = '\0';
+  return usado;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <TramaBinaria.h>
+
+// ====== Lotes de trayecto ======
+// Junta varios fixes en un solo mensaje para no pagar el encabezado TLS/MQTT
+// por cada punto. El lote se cierra al llegar a 'maxPuntos', cuando el primer
+// punto tiene más de 'maxLatenciaMs' de antigüedad, o cuando el llamador lo
+// fuerza (fin de calle, giro detectado).
+//
+// Se puede codificar como trama binaria (TRAMA_LOTE, varint zigzag) o como
+// texto en el formato "encoded polyline" de Google, que el backend puede
+// decodificar con cualquier librería de polylines.
+
+struct ConfigLote {
+  uint8_t maxPuntos;
+  uint32_t maxLatenciaMs;
+};
+
+class LoteTrayecto {
+ public:
+  explicit LoteTrayecto(const ConfigLote& config);
+
+  // Devuelve true si con este punto el lote quedó lleno
+  bool agregar(double lat, double lon, uint32_t tiempoMs);
+
+  // true si hay puntos y el más viejo superó la latencia máxima
+  bool vencido(uint32_t ahoraMs) const;
+
+  uint8_t cantidad() const { return cantidadPuntos; }
+  bool vacio() const { return cantidadPuntos == 0; }
+  bool lleno() const { return cantidadPuntos >= config.maxPuntos; }
+  const PuntoLote& punto(uint8_t i) const { return puntos[i]; }
+  void vaciar() { cantidadPuntos = 0; }
+
+  size_t codificarBinario(uint32_t seq, uint16_t calle, uint8_t* destino, size_t capacidad,
+                          TipoTrama tipo = TRAMA_LOTE) const;
+
+  // Polyline de Google (precisión 1e-5) terminada en '\0'; 0 si no entra
+  size_t codificarPolyline(char* destino, size_t capacidad) const;
+
+  // Diferencias de tiempo en centésimas de segundo con el mismo alfabeto de
+  // la polyline (el primer valor es 0)
+  size_t codificarTiempos(char* destino, size_t capacidad) const;
+
+ private:
+  ConfigLote config;
+  PuntoLote puntos[TRAMA_LOTE_MAX_PUNTOS];
+  uint8_t cantidadPuntos;
+};
+
+// Un valor con signo en el alfabeto de las polylines; devuelve los caracteres escritos
+size_t escribirValorPolyline(int32_t valor, char* destino, size_t capacidad);
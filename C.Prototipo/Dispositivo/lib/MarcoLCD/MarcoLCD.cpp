@@ -0,0 +1,134 @@
+#include "MarcoLCD.h"
+
+#include <stdio.h>
+#include <string.h>
+
+MarcoLCD::MarcoLCD(const ConfigMarcoLCD& config)
+    : config(config), columnaDibujo(0), filaDibujo(0), columnaDisplay(0), filaDisplay(0), cursorConocido(false), difieren(0) {
+  if (this->config.columnas > MARCO_MAX_COLUMNAS) this->config.columnas = MARCO_MAX_COLUMNAS;
+  if (this->config.filas > MARCO_MAX_FILAS) this->config.filas = MARCO_MAX_FILAS;
+  // lcd.init() deja el display en blanco
+  memset(deseado, ' ', sizeof(deseado));
+  memset(mostrado, ' ', sizeof(mostrado));
+  reiniciarEstadisticas();
+}
+
+void MarcoLCD::reiniciarEstadisticas() {
+  memset(&est, 0, sizeof(est));
+}
+
+void MarcoLCD::invalidar() {
+  memset(mostrado, 0, sizeof(mostrado));
+  cursorConocido = false;
+  // En 'deseado' no hay ceros: todas las celdas difieren
+  difieren = config.filas * config.columnas;
+}
+
+void MarcoLCD::cambiarCelda(uint8_t columna, uint8_t fila, char c) {
+  char& celda = deseado[fila][columna];
+  if (celda == c) return;
+  char visible = mostrado[fila][columna];
+  if (celda == visible) {
+    difieren++;
+  } else if (c == visible) {
+    difieren--;
+  }
+  celda = c;
+}
+
+// ====== Dibujo ======
+void MarcoLCD::limpiar() {
+  for (uint8_t f = 0; f < config.filas; f++) {
+    for (uint8_t c = 0; c < config.columnas; c++) {
+      cambiarCelda(c, f, ' ');
+    }
+  }
+  columnaDibujo = 0;
+  filaDibujo = 0;
+  est.cuadros++;
+  est.bytesSinMarco += config.bytesPorCursor;
+}
+
+void MarcoLCD::cursor(uint8_t columna, uint8_t fila) {
+  columnaDibujo = columna;
+  filaDibujo = fila;
+  est.bytesSinMarco += config.bytesPorCursor;
+}
+
+void MarcoLCD::escribir(char c) {
+  // Lo que no entra en la fila se recorta
+  if (filaDibujo >= config.filas || columnaDibujo >= config.columnas) return;
+  est.bytesSinMarco += config.bytesPorCaracter;
+  cambiarCelda(columnaDibujo, filaDibujo, c);
+  columnaDibujo++;
+}
+
+void MarcoLCD::escribir(const char* texto) {
+  while (*texto) escribir(*texto++);
+}
+
+void MarcoLCD::escribirEntero(long valor) {
+  char texto[12];
+  snprintf(texto, sizeof(texto), "%ld", valor);
+  escribir(texto);
+}
+
+void MarcoLCD::escribirDecimal(double valor, uint8_t decimales) {
+  char texto[24];
+  snprintf(texto, sizeof(texto), "%.*f", (int)decimales, valor);
+  escribir(texto);
+}
+
+// ====== Volcado ======
+uint16_t MarcoLCD::volcar(SalidaLCD& salida, uint16_t presupuestoBytes) {
+  if (difieren == 0) {
+    est.volcadosVacios++;
+    return 0;
+  }
+
+  uint16_t gastado = 0;
+  for (uint8_t f = 0; f < config.filas; f++) {
+    uint8_t c = 0;
+    while (c < config.columnas) {
+      if (!difiere(c, f)) {
+        c++;
+        continue;
+      }
+
+      // Empieza un tramo: mover el cursor solo si no quedó ahí
+      bool mover = !(cursorConocido && columnaDisplay == c && filaDisplay == f);
+      uint16_t costo = (mover ? config.bytesPorCursor : 0) + config.bytesPorCaracter;
+      if (presupuestoBytes > 0 && gastado + costo > presupuestoBytes) return gastado;
+      if (mover) {
+        salida.posicionar(c, f);
+        gastado += config.bytesPorCursor;
+        est.bytes += config.bytesPorCursor;
+        est.cursores++;
+        columnaDisplay = c;
+        filaDisplay = f;
+        cursorConocido = true;
+      }
+
+      while (c < config.columnas) {
+        if (!difiere(c, f)) {
+          // Un hueco corto sale más barato reescribirlo que volver a posicionar
+          uint8_t fin = c;
+          while (fin < config.columnas && !difiere(fin, f)) fin++;
+          if (fin == config.columnas || (uint16_t)(fin - c) * config.bytesPorCaracter > config.bytesPorCursor) break;
+        }
+        if (presupuestoBytes > 0 && gastado + config.bytesPorCaracter > presupuestoBytes) return gastado;
+        salida.escribir((uint8_t)deseado[f][c]);
+        if (difiere(c, f)) difieren--;
+        mostrado[f][c] = deseado[f][c];
+        gastado += config.bytesPorCaracter;
+        est.bytes += config.bytesPorCaracter;
+        est.caracteres++;
+        c++;
+        columnaDisplay++;
+      }
+      // Al pasar el final de la fila el HD44780 sigue en otra fila no contigua
+      if (columnaDisplay >= config.columnas) cursorConocido = false;
+    }
+  }
+  return gastado;
+}
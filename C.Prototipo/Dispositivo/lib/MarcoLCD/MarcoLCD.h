@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ====== Framebuffer del LCD de caracteres ======
+// Las pantallas escriben en una copia en RAM ('deseado') y volcar() manda
+// al display solo las celdas que difieren de lo que ya muestra ('mostrado'),
+// agrupadas en tramos para no repetir el posicionamiento del cursor. Cada
+// volcado gasta como mucho 'presupuestoBytes' de I2C; lo que no entra queda
+// para el paso siguiente. Se lleva la cuenta de las celdas que difieren,
+// así redibujar el mismo cuadro no deja nada pendiente y, si nada cambió,
+// volcar() vuelve sin recorrer nada.
+//
+// limpiar() no manda el comando "clear" del display (que además bloquea
+// ~2 ms): solo llena la copia con espacios y el diff decide qué borrar.
+//
+// El costo en bytes de un caracter y de mover el cursor depende del
+// adaptador (con un PCF8574 en modo 4 bits son 6 escrituras por comando),
+// así que se pasa en la configuración. 'bytesSinMarco' suma lo que costaría
+// mandar cada clear, cursor y caracter dibujado directo al display, para
+// comparar con lo que de verdad se envió.
+//
+// No depende de Arduino: la salida es una interfaz que el firmware implementa
+// sobre LiquidCrystal_I2C.
+
+const uint8_t MARCO_MAX_COLUMNAS = 20;
+const uint8_t MARCO_MAX_FILAS = 4;
+
+class SalidaLCD {
+ public:
+  virtual ~SalidaLCD() {}
+  virtual void posicionar(uint8_t columna, uint8_t fila) = 0;
+  virtual void escribir(uint8_t c) = 0;
+};
+
+struct ConfigMarcoLCD {
+  uint8_t columnas;
+  uint8_t filas;
+  uint8_t bytesPorCaracter;
+  uint8_t bytesPorCursor;
+};
+
+struct EstadisticasMarcoLCD {
+  uint32_t bytes;        // enviados al display
+  uint32_t caracteres;
+  uint32_t cursores;
+  uint32_t cuadros;      // veces que se llamó a limpiar()
+  uint32_t volcadosVacios;
+  uint32_t bytesSinMarco; // lo que habría costado dibujar directo en el display
+};
+
+class MarcoLCD {
+ public:
+  explicit MarcoLCD(const ConfigMarcoLCD& config);
+
+  // ====== Dibujo (solo en RAM) ======
+  void limpiar();
+  void cursor(uint8_t columna, uint8_t fila);
+  void escribir(char c);
+  void escribir(const char* texto);
+  void escribirEntero(long valor);
+  void escribirDecimal(double valor, uint8_t decimales);
+
+  // ====== Volcado ======
+  // Devuelve los bytes enviados; 0 como presupuesto no pone límite
+  uint16_t volcar(SalidaLCD& salida, uint16_t presupuestoBytes);
+  bool pendiente() const { return difieren > 0; }
+
+  // Olvida lo que muestra el display (p. ej. después de reiniciarlo)
+  void invalidar();
+
+  const EstadisticasMarcoLCD& estadisticas() const { return est; }
+  void reiniciarEstadisticas();
+
+ private:
+  bool difiere(uint8_t columna, uint8_t fila) const {
+    return deseado[fila][columna] != mostrado[fila][columna];
+  }
+  void cambiarCelda(uint8_t columna, uint8_t fila, char c);
+
+  ConfigMarcoLCD config;
+  char deseado[MARCO_MAX_FILAS][MARCO_MAX_COLUMNAS];
+  char mostrado[MARCO_MAX_FILAS][MARCO_MAX_COLUMNAS];
+  uint8_t columnaDibujo;
+  uint8_t filaDibujo;
+  uint8_t columnaDisplay;  // posición real del cursor del display
+  uint8_t filaDisplay;
+  bool cursorConocido;
+  uint8_t difieren;  // celdas con deseado != mostrado
+  EstadisticasMarcoLCD est;
+};
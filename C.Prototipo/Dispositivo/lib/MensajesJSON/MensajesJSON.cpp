@@ -0,0 +1,38 @@
+#include "MensajesJSON.h"
+
+#include <ArduinoJson.h>
+
+size_t codificarPuntoJSON(const PuntoGPS& p, const char* idCalle, const ContextoMensaje& c, char* destino,
+                          size_t capacidad) {
+  StaticJsonDocument<256> doc;
+  doc["id"] = idCalle;
+  doc["tipo"] = "punto";
+  doc["lat"] = p.lat;
+  doc["lon"] = p.lon;
+  doc["velocidad"] = p.velocidad;
+  doc["satelites"] = p.satelites;
+  doc["tiempo"] = p.tiempo;
+  doc["rumbo"] = p.rumbo;
+  doc["device_id"] = c.deviceId;
+  doc["precision_baja"] = (p.satelites < 4);
+  doc["timestamp"] = c.timestampMs;
+  doc["seq"] = c.seq;
+  if (c.latenciaMs >= 0) doc["latencia_ms"] = c.latenciaMs;
+  return serializeJson(doc, destino, capacidad);
+}
+
+size_t codificarUbicacionJSON(const PuntoGPS& p, const ContextoMensaje& c, char* destino, size_t capacidad) {
+  StaticJsonDocument<256> doc;
+  doc["device_id"] = c.deviceId;
+  doc["latitud"] = p.lat;
+  doc["longitud"] = p.lon;
+  doc["satelites"] = p.satelites;
+  doc["velocidad_kmh"] = p.velocidad;
+  doc["rumbo"] = p.rumbo;
+  doc["tiempo"] = p.tiempo;
+  doc["precision_baja"] = (p.satelites < 4);
+  doc["timestamp"] = c.timestampMs;
+  doc["seq"] = c.seq;
+  if (c.latenciaMs >= 0) doc["latencia_ms"] = c.latenciaMs;
+  return serializeJson(doc, destino, capacidad);
+}
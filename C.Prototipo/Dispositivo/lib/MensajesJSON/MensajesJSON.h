@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <ProcesadorGPS.h>
+
+// ====== Mensajes JSON de mapeo y ubicación ======
+// Los dos mensajes que salen en cada período; los campos y su orden son los
+// que espera el backend (Servicios_AWS). El documento es un
+// StaticJsonDocument en la pila: no se usa el heap.
+//
+// Devuelven los bytes escritos, como serializeJson(); 'capacidad' tiene que
+// alcanzar para el mensaje completo (TAMANO_MENSAJE_MQTT en el firmware).
+
+struct ContextoMensaje {
+  const char* deviceId;
+  uint32_t timestampMs;  // millis() del equipo
+  uint32_t seq;
+  int32_t latenciaMs;    // fix -> mensaje (LOGIOT_PERFIL); negativo no se incluye
+};
+
+// Vértice de la calle 'idCalle' ("tipo": "punto")
+size_t codificarPuntoJSON(const PuntoGPS& p, const char* idCalle, const ContextoMensaje& c, char* destino,
+                          size_t capacidad);
+// Tracking en tiempo real; el rumbo y la hora UTC del fix ("tiempo") van
+// para que el tablero extrapole desde el fix y no desde que lo recibió
+size_t codificarUbicacionJSON(const PuntoGPS& p, const ContextoMensaje& c, char* destino, size_t capacidad);
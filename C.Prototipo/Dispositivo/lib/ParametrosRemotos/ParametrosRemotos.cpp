@@ -0,0 +1,215 @@
+#include "ParametrosRemotos.h"
+
+#include <string.h>
+
+static const uint8_t MAGIA_0 = 'P';
+static const uint8_t MAGIA_1 = 'R';
+static const uint8_t VERSION_FORMATO = 1;
+
+ParametrosRemotos::ParametrosRemotos(const DefinicionParametro* definiciones, uint8_t cantidad)
+    : definiciones(definiciones), cantidadParametros(cantidad > PARAMETROS_MAX ? PARAMETROS_MAX : cantidad) {
+  restablecer();
+}
+
+void ParametrosRemotos::restablecer() {
+  for (uint8_t i = 0; i < cantidadParametros; i++) {
+    valores[i] = definiciones[i].porDefecto;
+    pendientes[i] = valores[i];
+  }
+  mascaraPendientes = 0;
+}
+
+uint32_t ParametrosRemotos::modificados() const {
+  uint32_t mascara = 0;
+  for (uint8_t i = 0; i < cantidadParametros; i++) {
+    if (valores[i] != definiciones[i].porDefecto) mascara |= 1UL << i;
+  }
+  return mascara;
+}
+
+int8_t ParametrosRemotos::buscar(const char* clave, size_t largo) const {
+  for (uint8_t i = 0; i < cantidadParametros; i++) {
+    const char* nombre = definiciones[i].nombre;
+    if (strncmp(nombre, clave, largo) == 0 && nombre[largo] == '\0') return (int8_t)i;
+  }
+  return -1;
+}
+
+// ====== Lectura del comando ======
+static const char* saltarEspacios(const char* p, const char* fin) {
+  while (p < fin && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+  return p;
+}
+
+ResultadoComando ParametrosRemotos::recibir(const char* datos, size_t largo, uint32_t& id, int8_t& parametroError) {
+  id = 0;
+  parametroError = -1;
+  const char* p = datos;
+  const char* fin = datos + largo;
+  // Algunos clientes mandan el '\0' final
+  while (fin > p && fin[-1] == '\0') fin--;
+
+  // Se junta todo aparte y se pasa a pendientes solo si el comando es válido
+  uint32_t nuevos[PARAMETROS_MAX];
+  uint32_t mascara = 0;
+
+  p = saltarEspacios(p, fin);
+  if (p == fin || *p++ != '{') return COMANDO_MAL_FORMADO;
+  p = saltarEspacios(p, fin);
+  if (p < fin && *p == '}') {
+    p++;
+  } else {
+    while (true) {
+      if (p == fin || *p++ != '"') return COMANDO_MAL_FORMADO;
+      const char* clave = p;
+      while (p < fin && *p != '"') {
+        if (*p == '\\' || (uint8_t)*p < 0x20) return COMANDO_MAL_FORMADO;
+        p++;
+      }
+      if (p == fin) return COMANDO_MAL_FORMADO;
+      size_t largoClave = (size_t)(p - clave);
+      p = saltarEspacios(p + 1, fin);
+      if (p == fin || *p++ != ':') return COMANDO_MAL_FORMADO;
+      p = saltarEspacios(p, fin);
+
+      if (p == fin || *p < '0' || *p > '9') return COMANDO_MAL_FORMADO;
+      uint32_t v = 0;
+      while (p < fin && *p >= '0' && *p <= '9') {
+        uint32_t digito = (uint32_t)(*p++ - '0');
+        if (v > (0xFFFFFFFFUL - digito) / 10) return COMANDO_FUERA_DE_RANGO;
+        v = v * 10 + digito;
+      }
+      // Decimales y exponentes no son parámetros válidos
+      if (p < fin && (*p == '.' || *p == 'e' || *p == 'E')) return COMANDO_MAL_FORMADO;
+
+      if (largoClave == 2 && clave[0] == 'i' && clave[1] == 'd') {
+        id = v;
+      } else {
+        int8_t i = buscar(clave, largoClave);
+        if (i < 0) return COMANDO_DESCONOCIDO;
+        if (v < definiciones[i].minimo || v > definiciones[i].maximo) {
+          parametroError = i;
+          return COMANDO_FUERA_DE_RANGO;
+        }
+        nuevos[i] = v;
+        mascara |= 1UL << i;
+      }
+
+      p = saltarEspacios(p, fin);
+      if (p == fin) return COMANDO_MAL_FORMADO;
+      if (*p == '}') {
+        p++;
+        break;
+      }
+      if (*p++ != ',') return COMANDO_MAL_FORMADO;
+      p = saltarEspacios(p, fin);
+    }
+  }
+  if (saltarEspacios(p, fin) != fin) return COMANDO_MAL_FORMADO;
+  if (mascara == 0) return COMANDO_VACIO;
+
+  for (uint8_t i = 0; i < cantidadParametros; i++) {
+    if (mascara & (1UL << i)) pendientes[i] = nuevos[i];
+  }
+  mascaraPendientes |= mascara;
+  return COMANDO_ACEPTADO;
+}
+
+void ParametrosRemotos::combinar(const ParametrosRemotos& comando) {
+  for (uint8_t i = 0; i < cantidadParametros && i < comando.cantidadParametros; i++) {
+    if (comando.mascaraPendientes & (1UL << i)) pendientes[i] = comando.pendientes[i];
+  }
+  mascaraPendientes |= comando.mascaraPendientes;
+}
+
+uint32_t ParametrosRemotos::aplicarPendientes() {
+  uint32_t cambiados = 0;
+  for (uint8_t i = 0; i < cantidadParametros; i++) {
+    if ((mascaraPendientes & (1UL << i)) && valores[i] != pendientes[i]) {
+      valores[i] = pendientes[i];
+      cambiados |= 1UL << i;
+    }
+  }
+  mascaraPendientes = 0;
+  return cambiados;
+}
+
+const char* ParametrosRemotos::descripcion(ResultadoComando r) {
+  switch (r) {
+    case COMANDO_ACEPTADO: return "aceptado";
+    case COMANDO_MAL_FORMADO: return "mal_formado";
+    case COMANDO_DESCONOCIDO: return "desconocido";
+    case COMANDO_FUERA_DE_RANGO: return "fuera_de_rango";
+    case COMANDO_VACIO: return "vacio";
+  }
+  return "?";
+}
+
+// ====== Persistencia ======
+// 'P' 'R' versión cantidad | (hash del nombre, valor) x cantidad | crc8
+uint32_t ParametrosRemotos::hashNombre(const char* nombre) {
+  uint32_t h = 2166136261UL;  // FNV-1a
+  while (*nombre) {
+    h ^= (uint8_t)*nombre++;
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+uint8_t ParametrosRemotos::crc8(const uint8_t* datos, size_t largo) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < largo; i++) {
+    crc ^= datos[i];
+    for (uint8_t b = 0; b < 8; b++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+static void escribirU32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t leerU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+size_t ParametrosRemotos::serializar(uint8_t* destino, size_t capacidad) const {
+  size_t largo = 4 + (size_t)cantidadParametros * 8 + 1;
+  if (capacidad < largo) return 0;
+  destino[0] = MAGIA_0;
+  destino[1] = MAGIA_1;
+  destino[2] = VERSION_FORMATO;
+  destino[3] = cantidadParametros;
+  uint8_t* p = destino + 4;
+  for (uint8_t i = 0; i < cantidadParametros; i++) {
+    escribirU32(p, hashNombre(definiciones[i].nombre));
+    escribirU32(p + 4, valores[i]);
+    p += 8;
+  }
+  *p = crc8(destino, largo - 1);
+  return largo;
+}
+
+bool ParametrosRemotos::restaurar(const uint8_t* datos, size_t largo) {
+  if (largo < 5 || datos[0] != MAGIA_0 || datos[1] != MAGIA_1 || datos[2] != VERSION_FORMATO) return false;
+  size_t esperado = 4 + (size_t)datos[3] * 8 + 1;
+  if (largo != esperado || crc8(datos, largo - 1) != datos[largo - 1]) return false;
+  const uint8_t* p = datos + 4;
+  for (uint8_t j = 0; j < datos[3]; j++, p += 8) {
+    uint32_t hash = leerU32(p);
+    uint32_t v = leerU32(p + 4);
+    for (uint8_t i = 0; i < cantidadParametros; i++) {
+      if (hashNombre(definiciones[i].nombre) != hash) continue;
+      const DefinicionParametro& d = definiciones[i];
+      valores[i] = (v < d.minimo || v > d.maximo) ? d.porDefecto : v;
+      break;
+    }
+  }
+  mascaraPendientes = 0;
+  return true;
+}
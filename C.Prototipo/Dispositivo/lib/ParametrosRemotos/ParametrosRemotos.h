@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ====== Parámetros ajustables por MQTT ======
+// Tabla de parámetros enteros (nombre, rango y valor por defecto) que el
+// firmware lee en cada paso en lugar de constantes. Un comando es un objeto
+// JSON plano que llega por el tópico de control:
+//
+//   {"id": 17, "intervalo_ubicacion_ms": 1000, "intervalo_diagnostico_ms": 60000}
+//
+// - recibir() recorre el payload en el mismo buffer del cliente MQTT, sin
+//   copiarlo ni reservar memoria: solo acepta enteros sin signo y claves
+//   sin escapes. "id" es opcional y se devuelve en la respuesta.
+// - Todo o nada: con una clave desconocida o un valor fuera de rango no se
+//   cambia ninguno. Lo válido queda pendiente hasta aplicarPendientes(), que
+//   el firmware llama entre dos pasadas del loop; ninguna tarea ve la mitad
+//   de un comando. Dos comandos antes de aplicar se combinan, gana el último.
+// - serializar()/restaurar() guardan los valores con el hash de cada nombre:
+//   agregar o quitar parámetros entre versiones no corre los demás, y un
+//   valor que quedó fuera del rango nuevo vuelve al de por defecto.
+
+struct DefinicionParametro {
+  const char* nombre;
+  uint32_t minimo;
+  uint32_t maximo;
+  uint32_t porDefecto;
+};
+
+enum ResultadoComando : uint8_t {
+  COMANDO_ACEPTADO,
+  COMANDO_MAL_FORMADO,
+  COMANDO_DESCONOCIDO,      // clave que no está en la tabla
+  COMANDO_FUERA_DE_RANGO,
+  COMANDO_VACIO             // ningún parámetro además de "id"
+};
+
+const uint8_t PARAMETROS_MAX = 16;
+const size_t PARAMETROS_TAMANO_SERIALIZADO = 4 + PARAMETROS_MAX * 8 + 1;
+
+class ParametrosRemotos {
+ public:
+  // 'definiciones' tiene que vivir tanto como el objeto (una tabla const global)
+  ParametrosRemotos(const DefinicionParametro* definiciones, uint8_t cantidad);
+
+  // Valida el comando y deja sus valores pendientes. 'id' queda en 0 si el
+  // comando no trae uno; 'parametroError' es el índice de la clave rechazada
+  // en la tabla, o -1 si no corresponde
+  ResultadoComando recibir(const char* datos, size_t largo, uint32_t& id, int8_t& parametroError);
+
+  // Suma a los pendientes los de 'comando', leído con la misma tabla en otra
+  // instancia: el JSON se recorre fuera de la sección crítica y acá solo se
+  // copian los valores
+  void combinar(const ParametrosRemotos& comando);
+
+  // Pasa los pendientes a los valores en uso; devuelve la máscara de los
+  // que cambiaron (bit i = parámetro i)
+  uint32_t aplicarPendientes();
+  bool hayPendientes() const { return mascaraPendientes != 0; }
+
+  uint32_t valor(uint8_t indice) const { return valores[indice]; }
+  uint8_t cantidad() const { return cantidadParametros; }
+  const DefinicionParametro& definicion(uint8_t indice) const { return definiciones[indice]; }
+  // Máscara de los que difieren del valor por defecto
+  uint32_t modificados() const;
+  // Vuelve todo al valor por defecto, también lo pendiente
+  void restablecer();
+
+  // Devuelve los bytes escritos, o 0 si 'capacidad' no alcanza
+  size_t serializar(uint8_t* destino, size_t capacidad) const;
+  // Devuelve false si los datos no son válidos; los valores no cambian
+  bool restaurar(const uint8_t* datos, size_t largo);
+
+  static const char* descripcion(ResultadoComando r);
+
+ private:
+  int8_t buscar(const char* clave, size_t largo) const;
+  static uint32_t hashNombre(const char* nombre);
+  static uint8_t crc8(const uint8_t* datos, size_t largo);
+
+  const DefinicionParametro* definiciones;
+  uint8_t cantidadParametros;
+  uint32_t valores[PARAMETROS_MAX];
+  uint32_t pendientes[PARAMETROS_MAX];
+  uint32_t mascaraPendientes;
+};
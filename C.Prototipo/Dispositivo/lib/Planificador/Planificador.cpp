@@ -0,0 +1,148 @@
+#include "Planificador.h"
+
+// Una tarea dormida se revisa cada tanto sin ejecutarla, para no romper la
+// comparación con desborde del reloj de 32 bits
+static const uint32_t ESPERA_DORMIDA_US = 60000000UL;
+
+Planificador::Planificador(Reloj relojMs, Reloj relojUs, Reloj contadorAsignaciones)
+    : relojMs(relojMs),
+      reloj(relojUs),
+      contadorAsignaciones(contadorAsignaciones),
+      hayPrioritaria(false),
+      cantidadTareas(0),
+      inicioPasoUs(0),
+      presupuestoPasoUs(0) {
+  tareaPrioritaria = Tarea{"prioritaria", nullptr, 0, 0, 0, 0, 0, 0, 0, false};
+}
+
+int Planificador::agregar(const char* nombre, FuncionTarea funcion, uint32_t retardoInicialMs, uint32_t presupuestoUs) {
+  if (cantidadTareas >= PLANIFICADOR_MAX_TAREAS || funcion == nullptr) {
+    return -1;
+  }
+  uint8_t id = cantidadTareas++;
+  tareas[id] = Tarea{nombre, funcion, presupuestoUs, plazoEn(reloj(), retardoInicialMs), 0, 0, 0, 0, 0, false};
+  heap[id] = id;
+  posicionEnHeap[id] = id;
+  subir(id);
+  return id;
+}
+
+void Planificador::fijarPrioritaria(FuncionTarea funcion, uint32_t presupuestoUs) {
+  tareaPrioritaria.funcion = funcion;
+  tareaPrioritaria.presupuestoUs = presupuestoUs;
+  hayPrioritaria = (funcion != nullptr);
+}
+
+void Planificador::despertar(int id) {
+  if (id < 0 || id >= cantidadTareas) return;
+  Tarea& t = tareas[id];
+  t.dormida = false;
+  t.proximaUs = reloj();
+  subir(posicionEnHeap[id]);
+}
+
+void Planificador::ejecutar() {
+  if (cantidadTareas == 0) {
+    if (hayPrioritaria) correr(tareaPrioritaria, reloj());
+    return;
+  }
+
+  // Como máximo una vuelta por tarea en cada pasada: una tarea que devuelve 0
+  // no puede acaparar el loop
+  for (uint8_t n = 0; n < cantidadTareas; n++) {
+    if (hayPrioritaria) correr(tareaPrioritaria, reloj());
+
+    uint32_t ahora = reloj();
+    Tarea& t = tareas[heap[0]];
+    if (antes(ahora, t.proximaUs)) {
+      break;
+    }
+
+    if (t.dormida) {
+      t.proximaUs = ahora + ESPERA_DORMIDA_US;
+    } else {
+      uint32_t retardoMs = correr(t, ahora);
+      if (retardoMs == TAREA_DETENIDA) {
+        t.dormida = true;
+        t.proximaUs = reloj() + ESPERA_DORMIDA_US;
+      } else {
+        t.proximaUs = plazoEn(reloj(), retardoMs);
+      }
+    }
+    bajar(0);
+  }
+}
+
+// Un retardo mayor al horizonte daría la vuelta en la comparación y la tarea
+// quedaría vencida en cada pasada
+uint32_t Planificador::plazoEn(uint32_t ahoraUs, uint32_t retardoMs) {
+  if (retardoMs > PLANIFICADOR_RETARDO_MAXIMO_MS) retardoMs = PLANIFICADOR_RETARDO_MAXIMO_MS;
+  return ahoraUs + retardoMs * 1000U;
+}
+
+bool Planificador::presupuestoAgotado() const {
+  return presupuestoPasoUs > 0 && (reloj() - inicioPasoUs) >= presupuestoPasoUs;
+}
+
+void Planificador::reiniciarEstadisticas() {
+  for (uint8_t i = 0; i < cantidadTareas; i++) {
+    tareas[i].peorUs = 0;
+    tareas[i].excesos = 0;
+    tareas[i].ejecuciones = 0;
+    tareas[i].asignaciones = 0;
+  }
+  tareaPrioritaria.peorUs = 0;
+  tareaPrioritaria.excesos = 0;
+  tareaPrioritaria.ejecuciones = 0;
+  tareaPrioritaria.asignaciones = 0;
+}
+
+uint32_t Planificador::correr(Tarea& t, uint32_t ahoraUs) {
+  inicioPasoUs = ahoraUs;
+  presupuestoPasoUs = t.presupuestoUs;
+  uint32_t asignacionesAntes = contadorAsignaciones ? contadorAsignaciones() : 0;
+
+  uint32_t retardoMs = t.funcion(relojMs());
+
+  uint32_t duracion = reloj() - ahoraUs;
+  if (contadorAsignaciones) t.asignaciones += contadorAsignaciones() - asignacionesAntes;
+  t.ultimoUs = duracion;
+  t.ejecuciones++;
+  if (duracion > t.peorUs) t.peorUs = duracion;
+  if (t.presupuestoUs > 0 && duracion > t.presupuestoUs) t.excesos++;
+
+  presupuestoPasoUs = 0;
+  return retardoMs;
+}
+
+// ====== Operaciones del heap ======
+void Planificador::intercambiar(uint8_t a, uint8_t b) {
+  uint8_t ia = heap[a];
+  uint8_t ib = heap[b];
+  heap[a] = ib;
+  heap[b] = ia;
+  posicionEnHeap[ib] = a;
+  posicionEnHeap[ia] = b;
+}
+
+void Planificador::subir(uint8_t pos) {
+  while (pos > 0) {
+    uint8_t padre = (pos - 1) / 2;
+    if (!antes(tareas[heap[pos]].proximaUs, tareas[heap[padre]].proximaUs)) break;
+    intercambiar(pos, padre);
+    pos = padre;
+  }
+}
+
+void Planificador::bajar(uint8_t pos) {
+  while (true) {
+    uint8_t izq = 2 * pos + 1;
+    uint8_t der = izq + 1;
+    uint8_t menor = pos;
+    if (izq < cantidadTareas && antes(tareas[heap[izq]].proximaUs, tareas[heap[menor]].proximaUs)) menor = izq;
+    if (der < cantidadTareas && antes(tareas[heap[der]].proximaUs, tareas[heap[menor]].proximaUs)) menor = der;
+    if (menor == pos) break;
+    intercambiar(pos, menor);
+    pos = menor;
+  }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ====== Planificador cooperativo por plazos ======
+// Cola de tareas ordenada por su próximo plazo (min-heap de tamaño fijo).
+// Cada tarea es una máquina de estados reanudable: ejecuta un paso corto y
+// devuelve en cuántos ms quiere volver a correr. Si el paso se queda sin
+// presupuesto puede devolver 0 y continúa en la siguiente pasada.
+//
+// Entre cada tarea se ejecuta la tarea prioritaria (ingesta GPS), así ninguna
+// tarea puede dejar sin atender al UART más de lo que dura un solo paso.
+//
+// Los plazos se llevan en microsegundos con comparación tolerante al desborde,
+// por lo que un retardo no puede superar los ~35 minutos: los retardos más
+// largos se recortan a PLANIFICADOR_RETARDO_MAXIMO_MS.
+//
+// Con un contador de asignaciones del heap (opcional) cada tarea acumula
+// cuántas hizo durante sus pasos, para encontrar la que fragmenta el heap.
+
+typedef uint32_t (*FuncionTarea)(uint32_t ahoraMs);
+typedef uint32_t (*Reloj)();
+
+const uint8_t PLANIFICADOR_MAX_TAREAS = 12;
+const uint32_t TAREA_DETENIDA = 0xFFFFFFFF;  // valor de retorno para dormir hasta despertar()
+const uint32_t PLANIFICADOR_RETARDO_MAXIMO_MS = 1800000;  // 30 min, por debajo del horizonte de 2^31 us
+
+struct Tarea {
+  const char* nombre;
+  FuncionTarea funcion;
+  uint32_t presupuestoUs;
+  uint32_t proximaUs;
+  uint32_t peorUs;       // peor tiempo de ejecución observado
+  uint32_t ultimoUs;
+  uint32_t ejecuciones;
+  uint32_t excesos;      // pasos que superaron el presupuesto
+  uint32_t asignaciones; // asignaciones del heap durante sus pasos
+  bool dormida;
+};
+
+class Planificador {
+ public:
+  Planificador(Reloj relojMs, Reloj relojUs, Reloj contadorAsignaciones = nullptr);
+
+  // Devuelve el id de la tarea o -1 si no hay lugar
+  int agregar(const char* nombre, FuncionTarea funcion, uint32_t retardoInicialMs, uint32_t presupuestoUs);
+  void fijarPrioritaria(FuncionTarea funcion, uint32_t presupuestoUs);
+
+  // Adelanta una tarea para que corra en la próxima pasada
+  void despertar(int id);
+
+  // Una pasada: corre todas las tareas vencidas en orden de plazo
+  void ejecutar();
+
+  // Consultado por las tareas durante su paso
+  bool presupuestoAgotado() const;
+
+  uint8_t cantidad() const { return cantidadTareas; }
+  const Tarea& tarea(uint8_t i) const { return tareas[i]; }
+  const Tarea& prioritaria() const { return tareaPrioritaria; }
+  void reiniciarEstadisticas();
+
+ private:
+  uint32_t correr(Tarea& t, uint32_t ahoraUs);
+  static uint32_t plazoEn(uint32_t ahoraUs, uint32_t retardoMs);
+  static bool antes(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; }
+  void subir(uint8_t pos);
+  void bajar(uint8_t pos);
+  void intercambiar(uint8_t a, uint8_t b);
+
+  Reloj relojMs;
+  Reloj reloj;
+  Reloj contadorAsignaciones;
+  Tarea tareas[PLANIFICADOR_MAX_TAREAS];
+  Tarea tareaPrioritaria;
+  bool hayPrioritaria;
+  uint8_t cantidadTareas;
+
+  // Heap de índices a tareas, ordenado por proximaUs
+  uint8_t heap[PLANIFICADOR_MAX_TAREAS];
+  uint8_t posicionEnHeap[PLANIFICADOR_MAX_TAREAS];
+
+  uint32_t inicioPasoUs;
+  uint32_t presupuestoPasoUs;
+};
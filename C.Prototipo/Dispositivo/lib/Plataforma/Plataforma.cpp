@@ -0,0 +1,49 @@
+#include "Plataforma.h"
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+
+uint32_t relojMs() {
+  return millis();
+}
+
+uint32_t relojUs() {
+  return micros();
+}
+
+#else
+
+#include <time.h>
+
+static bool manual = false;
+static uint32_t manualMs = 0;
+
+static uint64_t monotonoUs() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000ULL + (uint64_t)t.tv_nsec / 1000ULL;
+}
+
+uint32_t relojMs() {
+  return manual ? manualMs : (uint32_t)(monotonoUs() / 1000ULL);
+}
+
+uint32_t relojUs() {
+  return manual ? manualMs * 1000U : (uint32_t)monotonoUs();
+}
+
+void fijarRelojManual(uint32_t ms) {
+  manual = true;
+  manualMs = ms;
+}
+
+void avanzarReloj(uint32_t ms) {
+  manualMs += ms;
+}
+
+void usarRelojReal() {
+  manual = false;
+}
+
+#endif
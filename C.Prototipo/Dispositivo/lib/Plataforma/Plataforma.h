@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// ====== Plataforma ======
+// Lo poco del hardware que necesita la lógica portable: el reloj. En el
+// equipo es millis()/micros(); en el build nativo (env:native de
+// platformio.ini) es el reloj monótono del sistema, o un reloj manual que
+// los tests avanzan a mano para que los plazos no dependan de la máquina.
+//
+// relojMs() y relojUs() tienen la firma de Reloj del Planificador.
+
+uint32_t relojMs();
+uint32_t relojUs();
+
+#ifndef ARDUINO
+// Desde acá el reloj solo cambia con avanzarReloj(); relojUs() = ms * 1000
+void fijarRelojManual(uint32_t ms);
+void avanzarReloj(uint32_t ms);
+// Vuelve al reloj del sistema
+void usarRelojReal();
+#endif
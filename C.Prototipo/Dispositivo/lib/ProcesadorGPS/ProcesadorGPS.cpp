@@ -0,0 +1,103 @@
+#include "ProcesadorGPS.h"
+
+#include <Geodesia.h>
+
+ProcesadorGPS::ProcesadorGPS(VentanaGPS& ventana, FiltroKalman& filtro, DetectorGiros& detector,
+                             SimplificadorTrayecto& simplificador, EventosProcesadorGPS& eventos)
+    : ventana(ventana), filtro(filtro), detector(detector), simplificador(simplificador), eventos(eventos) {
+  reiniciar();
+}
+
+void ProcesadorGPS::reiniciar() {
+  distanciaRecorridaCm = 0;
+  ultimoLatE6 = 0;
+  ultimoLonE6 = 0;
+  cosenoRecorridoQ15 = 0;
+  detector.reiniciar();
+  filtro.reiniciar();
+}
+
+ResultadoFix ProcesadorGPS::agregarFix(const MuestraGPS& m, float hdop) {
+  if (!ventana.agregar(m)) {
+    return FIX_SALTO;
+  }
+  acumularDistancia(m.lat, m.lon, m.velocidad);
+  bool usado = filtro.actualizar(m.lat, m.lon, hdop, m.satelites, m.tiempoMs);
+  filtro.actualizarVelocidad(m.velocidad, m.rumbo);
+  return usado ? FIX_ACEPTADO : FIX_FILTRO_FUERA;
+}
+
+void ProcesadorGPS::procesar(uint32_t ahoraMs) {
+  PuntoGPS punto = puntoFiltrado(ahoraMs);
+  PuntoGiro p = {punto.lat, punto.lon, (float)punto.rumbo, (float)punto.velocidad};
+
+  EventoGiro evento = detector.agregar(p);
+  if (evento != GIRO_NINGUNO) {
+    eventos.giro(evento, detector.ultimoCambio());
+    if (evento == GIRO_CONFIRMADO) {
+      return;
+    }
+  }
+
+  if (!detector.enGiro() && punto.velocidad >= detector.configuracion().velocidadMinimaKmh) {
+    agregarAlSimplificador(punto, ahoraMs);
+  }
+}
+
+void ProcesadorGPS::agregarAlSimplificador(const PuntoGPS& p, uint32_t ahoraMs) {
+  VerticeTrayecto punto = {p.lat, p.lon, (float)p.rumbo, (float)p.velocidad,
+                           (uint8_t)p.satelites, (uint32_t)p.tiempo, ahoraMs};
+  if (!simplificador.activo()) {
+    simplificador.iniciar(punto);
+    eventos.inicioCalle(punto);
+    return;
+  }
+  VerticeTrayecto vertice;
+  if (simplificador.agregar(punto, vertice)) {
+    eventos.vertice(vertice);
+  }
+}
+
+PuntoGPS ProcesadorGPS::puntoPromedio() const {
+  PuntoGPS promedio = {0.0, 0.0, 0.0, 0.0, 0, 0};
+  if (ventana.vacia()) {
+    return promedio;
+  }
+  promedio.lat = ventana.latitudMedia();
+  promedio.lon = ventana.longitudMedia();
+  promedio.rumbo = ventana.rumboMedio();
+  promedio.velocidad = ventana.velocidadMedia();
+  promedio.satelites = (int)ventana.satelitesMedia();
+  promedio.tiempo = ventana.muestra(0).tiempoGps;
+  return promedio;
+}
+
+PuntoGPS ProcesadorGPS::puntoFiltrado(uint32_t ahoraMs) {
+  if (!filtro.valido(ahoraMs) || ventana.vacia()) {
+    return puntoPromedio();
+  }
+  filtro.predecir(ahoraMs);
+  const MuestraGPS& ultima = ventana.muestra(0);
+  PuntoGPS p = {filtro.latitud(), filtro.longitud(), filtro.rumbo(), filtro.velocidadKmh(),
+                ultima.satelites, ultima.tiempoGps};
+  return p;
+}
+
+// Suma sin punto flotante; el coseno se toma una vez por mapeo (a 5 km el
+// error de usar siempre el mismo es menor a 1 m). Detenido o con un paso más
+// corto que el mínimo no se mueve el punto de referencia: al arrancar, el
+// primer paso cuenta desde donde quedó el camión
+void ProcesadorGPS::acumularDistancia(double lat, double lon, float velocidadKmh) {
+  int32_t latE6 = gradosAE6(lat);
+  int32_t lonE6 = gradosAE6(lon);
+  if (cosenoRecorridoQ15 == 0) {
+    cosenoRecorridoQ15 = cosenoQ15(lat);
+  } else {
+    if (velocidadKmh < VELOCIDAD_MINIMA_DISTANCIA_KMH) return;
+    uint32_t paso = distanciaMicrogradosCm(ultimoLatE6, ultimoLonE6, latE6, lonE6, cosenoRecorridoQ15);
+    if (paso < DESPLAZAMIENTO_MINIMO_CM) return;
+    distanciaRecorridaCm += paso;
+  }
+  ultimoLatE6 = latE6;
+  ultimoLonE6 = lonE6;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <VentanaGPS.h>
+#include <FiltroKalman.h>
+#include <DetectorGiros.h>
+#include <SimplificadorTrayecto.h>
+
+// ====== Procesamiento de fixes durante el mapeo ======
+// La cadena que recorre cada fix aceptado: ventana deslizante (descarte de
+// saltos), distancia recorrida, filtro de Kalman, detector de giros y
+// simplificador de la calle. Las piezas las pone el llamador (el firmware
+// las tiene como globales) y lo que tiene que salir por MQTT, por pantalla o
+// por el puerto serie lo avisa por EventosProcesadorGPS, así la cadena corre
+// igual en el equipo, en los tests y en los benchmarks del build nativo.
+//
+// El tiempo lo pasa el llamador (millis() en el equipo).
+
+struct PuntoGPS {
+  double lat;
+  double lon;
+  double rumbo;
+  double velocidad;
+  int satelites;
+  unsigned long tiempo;
+};
+
+// Con el camión detenido el fix baila unos metros: sumar ese ruido inflaba
+// la distancia. Un fix suma solo si el GPS informa movimiento y se alejó lo
+// suficiente del último punto sumado
+const float VELOCIDAD_MINIMA_DISTANCIA_KMH = 3.0f;
+const uint32_t DESPLAZAMIENTO_MINIMO_CM = 300;
+
+enum ResultadoFix : uint8_t {
+  FIX_ACEPTADO,
+  FIX_SALTO,         // la ventana lo descartó: no sigue
+  FIX_FILTRO_FUERA   // el filtro no lo usó (innovación alta); la cadena sigue con la predicción
+};
+
+class EventosProcesadorGPS {
+ public:
+  virtual ~EventosProcesadorGPS() {}
+  // GIRO_POSIBLE, GIRO_DESCARTADO o GIRO_CONFIRMADO. Con un giro confirmado
+  // el punto no entra en la calle: el llamador cierra la calle y abre otra
+  virtual void giro(EventoGiro evento, float cambioGrados) = 0;
+  // Primer punto de la calle: ya viajó con el "inicio", solo va a la geometría
+  virtual void inicioCalle(const VerticeTrayecto& v) = 0;
+  // Vértice que el simplificador no pudo omitir
+  virtual void vertice(const VerticeTrayecto& v) = 0;
+};
+
+class ProcesadorGPS {
+ public:
+  ProcesadorGPS(VentanaGPS& ventana, FiltroKalman& filtro, DetectorGiros& detector,
+                SimplificadorTrayecto& simplificador, EventosProcesadorGPS& eventos);
+
+  // Ventana, distancia y filtro; con FIX_SALTO no hay que llamar a procesar()
+  ResultadoFix agregarFix(const MuestraGPS& m, float hdop);
+  // Giros y simplificación sobre el punto filtrado
+  void procesar(uint32_t ahoraMs);
+
+  // Promedio de la ventana; las sumas ya están al día, no se recorre el buffer
+  PuntoGPS puntoPromedio() const;
+  // Estado del filtro predicho hasta 'ahoraMs'; sin filtro válido, el promedio
+  PuntoGPS puntoFiltrado(uint32_t ahoraMs);
+
+  // Al empezar un mapeo: distancia en cero, detector y filtro sin historia
+  void reiniciar();
+  uint32_t distanciaCm() const { return distanciaRecorridaCm; }
+
+ private:
+  void acumularDistancia(double lat, double lon, float velocidadKmh);
+  void agregarAlSimplificador(const PuntoGPS& p, uint32_t ahoraMs);
+
+  VentanaGPS& ventana;
+  FiltroKalman& filtro;
+  DetectorGiros& detector;
+  SimplificadorTrayecto& simplificador;
+  EventosProcesadorGPS& eventos;
+
+  // Distancia acumulada en enteros (1e-6 grados); 'ultimo' es el último punto sumado
+  uint32_t distanciaRecorridaCm;
+  int32_t ultimoLatE6;
+  int32_t ultimoLonE6;
+  uint16_t cosenoRecorridoQ15;
+};
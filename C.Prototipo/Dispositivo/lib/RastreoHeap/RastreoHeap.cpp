@@ -0,0 +1,67 @@
+#include "RastreoHeap.h"
+
+static volatile uint32_t asignaciones = 0;
+static volatile uint32_t liberaciones = 0;
+static volatile uint32_t bytes = 0;
+static volatile uint32_t fallidas = 0;
+
+bool rastreoHeapActivo() {
+  return LOGIOT_SIN_HEAP != 0;
+}
+
+EstadisticasHeap estadisticasHeap() {
+  EstadisticasHeap e = {asignaciones, liberaciones, bytes, fallidas};
+  return e;
+}
+
+uint32_t contadorAsignaciones() {
+  return asignaciones;
+}
+
+#if LOGIOT_SIN_HEAP
+
+// ====== Envoltorios del enlazador (-Wl,--wrap=...) ======
+static void contar(void* p, size_t tamano) {
+  asignaciones = asignaciones + 1;
+  bytes = bytes + tamano;
+  if (p == nullptr && tamano > 0) fallidas = fallidas + 1;
+}
+
+extern "C" {
+
+void* __real_malloc(size_t tamano);
+void* __real_calloc(size_t cantidad, size_t tamano);
+void* __real_realloc(void* p, size_t tamano);
+void __real_free(void* p);
+
+void* __wrap_malloc(size_t tamano) {
+  void* p = __real_malloc(tamano);
+  contar(p, tamano);
+  return p;
+}
+
+void* __wrap_calloc(size_t cantidad, size_t tamano) {
+  void* p = __real_calloc(cantidad, tamano);
+  contar(p, cantidad * tamano);
+  return p;
+}
+
+void* __wrap_realloc(void* p, size_t tamano) {
+  // realloc(p, 0) libera; realloc(NULL, n) es un malloc
+  if (tamano == 0) {
+    if (p != nullptr) liberaciones = liberaciones + 1;
+    return __real_realloc(p, tamano);
+  }
+  void* nuevo = __real_realloc(p, tamano);
+  contar(nuevo, tamano);
+  return nuevo;
+}
+
+void __wrap_free(void* p) {
+  if (p != nullptr) liberaciones = liberaciones + 1;
+  __real_free(p);
+}
+
+}  // extern "C"
+
+#endif
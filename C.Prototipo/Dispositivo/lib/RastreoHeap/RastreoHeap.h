@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ====== Rastreo de asignaciones del heap ======
+// Con -DLOGIOT_SIN_HEAP=1 y el enlazador envolviendo malloc, calloc,
+// realloc y free:
+//
+//   build_flags = -DLOGIOT_SIN_HEAP=1 -Wl,--wrap=malloc -Wl,--wrap=calloc
+//                 -Wl,--wrap=realloc -Wl,--wrap=free
+//
+// cada asignación del programa (incluidas las de String, new y las
+// librerías del SDK) pasa por los contadores de este módulo antes de llegar
+// al asignador real. Sin esas opciones las funciones existen pero devuelven
+// ceros, así el resto del firmware no necesita #if.
+//
+// contadorAsignaciones() tiene la firma de un Reloj del Planificador: se le
+// pasa como contador y cada tarea acumula cuántas asignaciones hizo.
+//
+// Los contadores no son atómicos; en el ESP32 las asignaciones de otros
+// núcleos pueden perder alguna cuenta, lo que no cambia el diagnóstico.
+
+#ifndef LOGIOT_SIN_HEAP
+#define LOGIOT_SIN_HEAP 0
+#endif
+
+struct EstadisticasHeap {
+  uint32_t asignaciones;  // malloc, calloc y realloc que pidieron memoria
+  uint32_t liberaciones;
+  uint32_t bytes;         // total pedido desde el arranque
+  uint32_t fallidas;      // devolvieron NULL
+};
+
+bool rastreoHeapActivo();
+EstadisticasHeap estadisticasHeap();
+uint32_t contadorAsignaciones();
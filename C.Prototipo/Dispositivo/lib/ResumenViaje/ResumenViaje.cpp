@@ -0,0 +1,114 @@
+#include "ResumenViaje.h"
+
+#include <string.h>
+
+float Resumen::velocidadMediaKmh() const {
+  if (duracionMs == 0) return 0.0f;
+  // cm/ms son 10 m/s, 36 km/h
+  return (float)distanciaCm * 36.0f / (float)duracionMs;
+}
+
+ResumenViaje::ResumenViaje(const ConfigResumenViaje& config) : config(config) {
+  iniciarViaje();
+}
+
+void ResumenViaje::iniciarViaje() {
+  memset(&resumenViaje, 0, sizeof(resumenViaje));
+  memset(&resumenCalle, 0, sizeof(resumenCalle));
+  hayAnterior = false;
+  latAnterior = 0.0;
+  lonAnterior = 0.0;
+  velocidadAnterior = 0.0f;
+  tiempoAnteriorMs = 0;
+  estaDetenido = false;
+  paradaContada = false;
+  detenidoDesdeMs = 0;
+  enAceleracion = false;
+  enFrenada = false;
+}
+
+void ResumenViaje::iniciarCalle() {
+  memset(&resumenCalle, 0, sizeof(resumenCalle));
+}
+
+uint8_t ResumenViaje::rango(float velocidadKmh) {
+  if (velocidadKmh <= 0.0f) return 0;
+  uint32_t r = (uint32_t)(velocidadKmh / RESUMEN_ANCHO_RANGO_KMH);
+  return r >= RESUMEN_RANGOS ? RESUMEN_RANGOS - 1 : (uint8_t)r;
+}
+
+void ResumenViaje::sumarLapso(Resumen& r, uint32_t lapsoMs, uint32_t distanciaCm, bool hueco) {
+  r.duracionMs += lapsoMs;
+  r.distanciaCm += distanciaCm;
+  if (hueco) return;
+  r.rangoMs[rango(velocidadAnterior)] += lapsoMs;
+  if (estaDetenido) r.detenidoMs += lapsoMs;
+}
+
+void ResumenViaje::contarFix(Resumen& r, float velocidadKmh) {
+  r.fixes++;
+  if (velocidadKmh > r.velocidadMaxKmh) r.velocidadMaxKmh = velocidadKmh;
+}
+
+void ResumenViaje::agregar(const MuestraGPS& m) {
+  float velocidad = m.velocidad > 0.0f ? m.velocidad : 0.0f;
+
+  if (!hayAnterior) {
+    hayAnterior = true;
+    estaDetenido = velocidad < config.velocidadDetenidoKmh;
+    paradaContada = false;
+    detenidoDesdeMs = m.tiempoMs;
+  } else {
+    // El lapso desde el fix anterior se cuenta con el estado de ese fix
+    uint32_t lapsoMs = m.tiempoMs - tiempoAnteriorMs;
+    bool hueco = lapsoMs > config.huecoMaximoMs;
+    uint32_t distanciaCm =
+        estaDetenido ? 0 : (uint32_t)(proyeccion.distancia(latAnterior, lonAnterior, m.lat, m.lon) * 100.0f + 0.5f);
+    sumarLapso(resumenCalle, lapsoMs, distanciaCm, hueco);
+    sumarLapso(resumenViaje, lapsoMs, distanciaCm, hueco);
+
+    if (!hueco && lapsoMs > 0) {
+      float aceleracion = (velocidad - velocidadAnterior) / 3.6f * 1000.0f / (float)lapsoMs;
+      if (aceleracion >= config.aceleracionBruscaMs2) {
+        if (!enAceleracion) {
+          resumenCalle.aceleraciones++;
+          resumenViaje.aceleraciones++;
+        }
+        enAceleracion = true;
+      } else {
+        enAceleracion = false;
+      }
+      if (aceleracion <= -config.aceleracionBruscaMs2) {
+        if (!enFrenada) {
+          resumenCalle.frenadas++;
+          resumenViaje.frenadas++;
+        }
+        enFrenada = true;
+      } else {
+        enFrenada = false;
+      }
+    }
+
+    if (estaDetenido) {
+      if (velocidad > config.velocidadArranqueKmh) {
+        estaDetenido = false;
+      } else if (!paradaContada && m.tiempoMs - detenidoDesdeMs >= config.paradaMinimaMs) {
+        // La parada le toca a la calle en la que llega al mínimo
+        resumenCalle.paradas++;
+        resumenViaje.paradas++;
+        paradaContada = true;
+      }
+    } else if (velocidad < config.velocidadDetenidoKmh) {
+      estaDetenido = true;
+      paradaContada = false;
+      detenidoDesdeMs = m.tiempoMs;
+    }
+  }
+
+  contarFix(resumenCalle, velocidad);
+  contarFix(resumenViaje, velocidad);
+  latAnterior = m.lat;
+  lonAnterior = m.lon;
+  velocidadAnterior = velocidad;
+  tiempoAnteriorMs = m.tiempoMs;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <VentanaGPS.h>
+#include <Geodesia.h>
+
+// ====== Resumen del viaje ======
+// Lo que el tablero calculaba recorriendo todos los puntos, acumulado fix
+// por fix en el equipo: distancia, duración, velocidad máxima y media,
+// tiempo por rango de velocidad, paradas y tiempo detenido, aceleraciones y
+// frenadas bruscas. Hay un resumen de la calle en curso (CALLE_n) y otro del
+// viaje completo; la memoria es fija, no se guarda ningún punto.
+//
+// Detenciones con histéresis: el camión queda detenido al bajar de
+// 'velocidadDetenidoKmh' y vuelve a moverse al pasar 'velocidadArranqueKmh'.
+// Una detención cuenta como parada cuando dura 'paradaMinimaMs' (un semáforo
+// no es una parada). Detenido no suma distancia: el ruido de la posición en
+// el lugar no es recorrido.
+//
+// La aceleración sale de la velocidad del GPS entre dos fixes seguidos, que
+// es mucho menos ruidosa que derivar la posición. Un episodio brusco cuenta
+// una sola vez: tiene que bajar del umbral para contar otro.
+//
+// Dos fixes separados por más de 'huecoMaximoMs' son un corte del GPS: el
+// lapso suma a la duración (y la recta, a la distancia), pero no a los
+// rangos de velocidad ni al tiempo detenido, y no da aceleración.
+//
+// La distancia entre fixes va con ProyeccionLocal: con un fix por segundo
+// los pasos son de pocos metros y el redondeo de distanciaMicrogradosCm
+// (hasta 0,2 m por paso) se acumularía. El tiempo es el millis() de cada
+// fix. No depende de Arduino.
+
+const uint8_t RESUMEN_RANGOS = 8;
+const uint8_t RESUMEN_ANCHO_RANGO_KMH = 15;  // el último rango es de 105 km/h para arriba
+
+struct ConfigResumenViaje {
+  float velocidadDetenidoKmh;
+  float velocidadArranqueKmh;
+  uint32_t paradaMinimaMs;
+  float aceleracionBruscaMs2;  // en valor absoluto, también para frenar
+  uint32_t huecoMaximoMs;
+};
+
+// Acumulado de una calle o del viaje
+struct Resumen {
+  uint32_t fixes;
+  uint32_t distanciaCm;
+  uint32_t duracionMs;
+  uint32_t detenidoMs;
+  float velocidadMaxKmh;
+  uint16_t paradas;
+  uint16_t aceleraciones;
+  uint16_t frenadas;
+  uint32_t rangoMs[RESUMEN_RANGOS];  // tiempo en cada rango de velocidad
+
+  uint32_t distanciaM() const { return distanciaCm / 100; }
+  // Distancia sobre duración, con las detenciones incluidas
+  float velocidadMediaKmh() const;
+};
+
+class ResumenViaje {
+ public:
+  explicit ResumenViaje(const ConfigResumenViaje& config);
+
+  // Al empezar el mapeo: los dos resúmenes en cero y sin fix anterior
+  void iniciarViaje();
+  // Al abrir una calle: solo el resumen de la calle; el lapso desde el
+  // último fix ya le toca a la calle nueva
+  void iniciarCalle();
+  // Cada fix que aceptó la ventana
+  void agregar(const MuestraGPS& m);
+
+  const Resumen& calle() const { return resumenCalle; }
+  const Resumen& viaje() const { return resumenViaje; }
+  bool detenido() const { return estaDetenido; }
+
+  static uint8_t rango(float velocidadKmh);
+
+ private:
+  void sumarLapso(Resumen& r, uint32_t lapsoMs, uint32_t distanciaCm, bool hueco);
+  void contarFix(Resumen& r, float velocidadKmh);
+
+  ConfigResumenViaje config;
+  Resumen resumenCalle;
+  Resumen resumenViaje;
+
+  // Fix anterior
+  bool hayAnterior;
+  double latAnterior;
+  double lonAnterior;
+  float velocidadAnterior;
+  uint32_t tiempoAnteriorMs;
+  ProyeccionLocal proyeccion;
+
+  bool estaDetenido;
+  bool paradaContada;
+  uint32_t detenidoDesdeMs;
+  bool enAceleracion;
+  bool enFrenada;
+};
@@ -0,0 +1,103 @@
+#include "SimplificadorTrayecto.h"
+
+#include <math.h>
+
+static const double GRADOS_A_RAD = M_PI / 180.0;
+static const float METROS_POR_GRADO = 111194.93f;
+
+SimplificadorTrayecto::SimplificadorTrayecto(const ConfigSimplificador& config)
+    : config(config), iniciado(false), ancla(), cosAncla(1.0f), largo(0) {
+  if (this->config.maxVentana < 4 || this->config.maxVentana > SIMPLIFICADOR_MAX_VENTANA) {
+    this->config.maxVentana = SIMPLIFICADOR_MAX_VENTANA;
+  }
+}
+
+void SimplificadorTrayecto::iniciar(const VerticeTrayecto& nuevaAncla) {
+  ancla = nuevaAncla;
+  cosAncla = (float)cos(nuevaAncla.lat * GRADOS_A_RAD);
+  largo = 0;
+  iniciado = true;
+}
+
+void SimplificadorTrayecto::aPlano(const VerticeTrayecto& p, float& x, float& y) const {
+  x = (float)(p.lon - ancla.lon) * cosAncla * METROS_POR_GRADO;
+  y = (float)(p.lat - ancla.lat) * METROS_POR_GRADO;
+}
+
+VerticeTrayecto SimplificadorTrayecto::desdeVentana(const PuntoVentana& p) const {
+  VerticeTrayecto v;
+  v.lat = ancla.lat + p.y / METROS_POR_GRADO;
+  v.lon = ancla.lon + p.x / (METROS_POR_GRADO * cosAncla);
+  v.rumbo = p.rumbo;
+  v.velocidad = p.velocidad;
+  v.satelites = p.satelites;
+  v.tiempoGps = p.tiempoGps;
+  v.tiempoMs = p.tiempoMs;
+  return v;
+}
+
+// ¿Algún punto de la ventana se aleja más de la tolerancia del segmento ancla -> (px, py)?
+bool SimplificadorTrayecto::excedeTolerancia(float px, float py) const {
+  float largo2 = px * px + py * py;
+  float tol2 = config.toleranciaMetros * config.toleranciaMetros;
+  for (uint8_t i = 0; i < largo; i++) {
+    float qx = ventana[i].x;
+    float qy = ventana[i].y;
+    float t = largo2 > 0.0f ? (qx * px + qy * py) / largo2 : 0.0f;
+    if (t < 0.0f) t = 0.0f;
+    if (t > 1.0f) t = 1.0f;
+    float dx = qx - t * px;
+    float dy = qy - t * py;
+    if (dx * dx + dy * dy > tol2) return true;
+  }
+  return false;
+}
+
+bool SimplificadorTrayecto::agregar(const VerticeTrayecto& punto, VerticeTrayecto& vertice) {
+  if (!iniciado) {
+    iniciar(punto);
+    return false;
+  }
+
+  float x, y;
+  aPlano(punto, x, y);
+  bool emitir = largo > 0 && (excedeTolerancia(x, y) ||
+                              punto.tiempoMs - ancla.tiempoMs >= config.maxIntervaloMs);
+  if (emitir) {
+    vertice = desdeVentana(ventana[largo - 1]);
+    iniciar(vertice);
+    aPlano(punto, x, y);
+  }
+  if (largo >= config.maxVentana) {
+    compactar();
+  }
+  PuntoVentana& p = ventana[largo++];
+  p.x = x;
+  p.y = y;
+  p.rumbo = punto.rumbo;
+  p.velocidad = punto.velocidad;
+  p.satelites = punto.satelites;
+  p.tiempoGps = punto.tiempoGps;
+  p.tiempoMs = punto.tiempoMs;
+  return emitir;
+}
+
+// Se queda con los puntos de índice impar; el último siempre sobrevive
+// porque es el candidato a vértice
+void SimplificadorTrayecto::compactar() {
+  uint8_t destino = 0;
+  for (uint8_t i = (largo % 2 == 0) ? 1 : 0; i < largo; i += 2) {
+    ventana[destino++] = ventana[i];
+  }
+  largo = destino;
+}
+
+bool SimplificadorTrayecto::cerrar(VerticeTrayecto& vertice) {
+  bool hay = iniciado && largo > 0;
+  if (hay) {
+    vertice = desdeVentana(ventana[largo - 1]);
+  }
+  iniciado = false;
+  largo = 0;
+  return hay;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+
+// ====== Simplificación de trayecto en línea ======
+// Ventana que se abre desde el último vértice emitido ("ancla"): cada punto
+// nuevo extiende el segmento ancla -> punto y, si algún punto intermedio de
+// la ventana queda a más de 'toleranciaMetros' de ese segmento, el punto
+// anterior al nuevo se emite como vértice y pasa a ser el ancla.
+//
+// En una avenida recta no se emite nada hasta que el camino se desvía, así
+// se publican solo los vértices que cambian la geometría. La ventana es
+// acotada: al llenarse se descarta uno de cada dos puntos intermedios (todos
+// están dentro de la tolerancia del segmento actual, así que el control
+// sigue valiendo con menos muestras). Si pasan 'maxIntervaloMs' desde el
+// ancla se emite igual, para que el backend no se quede sin noticias en una
+// recta larga.
+//
+// Las distancias se miden en un plano local (equirectangular) centrado en
+// el ancla; el costo por punto es O(largo de la ventana). La ventana guarda
+// solo las coordenadas planas en float (~28 bytes por punto).
+
+const uint8_t SIMPLIFICADOR_MAX_VENTANA = 64;
+
+struct ConfigSimplificador {
+  float toleranciaMetros;
+  uint8_t maxVentana;        // de 4 a SIMPLIFICADOR_MAX_VENTANA
+  uint32_t maxIntervaloMs;
+};
+
+struct VerticeTrayecto {
+  double lat;
+  double lon;
+  float rumbo;
+  float velocidad;
+  uint8_t satelites;
+  uint32_t tiempoGps;
+  uint32_t tiempoMs;
+};
+
+class SimplificadorTrayecto {
+ public:
+  explicit SimplificadorTrayecto(const ConfigSimplificador& config);
+
+  // Empieza un tramo nuevo con 'ancla' como primer vértice
+  void iniciar(const VerticeTrayecto& ancla);
+  void reiniciar() { iniciado = false; }
+  bool activo() const { return iniciado; }
+
+  // Devuelve true y completa 'vertice' si el punto obligó a emitir uno
+  bool agregar(const VerticeTrayecto& punto, VerticeTrayecto& vertice);
+
+  // Cierra el tramo: devuelve el último punto pendiente como vértice final
+  bool cerrar(VerticeTrayecto& vertice);
+
+  uint8_t pendientes() const { return largo; }
+
+ private:
+  struct PuntoVentana {
+    float x;
+    float y;
+    float rumbo;
+    float velocidad;
+    uint8_t satelites;
+    uint32_t tiempoGps;
+    uint32_t tiempoMs;
+  };
+
+  void aPlano(const VerticeTrayecto& p, float& x, float& y) const;
+  VerticeTrayecto desdeVentana(const PuntoVentana& p) const;
+  bool excedeTolerancia(float px, float py) const;
+  void compactar();
+
+  ConfigSimplificador config;
+  bool iniciado;
+  VerticeTrayecto ancla;
+  float cosAncla;
+  PuntoVentana ventana[SIMPLIFICADOR_MAX_VENTANA];
+  uint8_t largo;
+};
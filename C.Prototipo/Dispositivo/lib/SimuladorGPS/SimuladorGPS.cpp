@@ -0,0 +1,48 @@
+#include "SimuladorGPS.h"
+
+#include <math.h>
+
+static const double GRADOS_A_RAD = M_PI / 180.0;
+static const double CAMBIO_GIRO_GRADOS = 30.0;
+static const double VELOCIDAD_GIRO_KMH = 5.0;
+static const uint8_t MUESTRAS_GIRO = 3;
+
+SimuladorGPS::SimuladorGPS(double latBase, double lonBase) : latBase(latBase), lonBase(lonBase) {
+  reiniciarGiros();
+}
+
+void SimuladorGPS::reiniciarGiros() {
+  rumboAnterior = 0.0;
+  muestrasEnGiro = 0;
+}
+
+MuestraSimulada SimuladorGPS::muestra(uint32_t transcurridoMs) const {
+  MuestraSimulada m;
+  // Rumbo que cambia gradualmente y velocidad variable
+  m.rumbo = fmod((transcurridoMs / 1000.0) * 2.0, 360.0);
+  m.velocidad = 15.0 + 10.0 * sin(transcurridoMs / 5000.0);
+
+  // Movimiento en espiral
+  double radio = 0.001 + (transcurridoMs / 100000.0);
+  m.lat = latBase + radio * cos(m.rumbo * GRADOS_A_RAD);
+  m.lon = lonBase + radio * sin(m.rumbo * GRADOS_A_RAD);
+  m.satelites = 8 + (int)(3 * sin(transcurridoMs / 3000.0));
+  return m;
+}
+
+bool SimuladorGPS::giro(const MuestraSimulada& m) {
+  double cambio = fabs(m.rumbo - rumboAnterior);
+  if (cambio > 180) cambio = 360 - cambio;
+  rumboAnterior = m.rumbo;
+
+  if (cambio > CAMBIO_GIRO_GRADOS && m.velocidad > VELOCIDAD_GIRO_KMH) {
+    muestrasEnGiro++;
+    if (muestrasEnGiro >= MUESTRAS_GIRO) {
+      muestrasEnGiro = 0;
+      return true;
+    }
+  } else {
+    muestrasEnGiro = 0;
+  }
+  return false;
+}
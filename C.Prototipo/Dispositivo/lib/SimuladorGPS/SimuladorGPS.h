@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+// ====== Recorrido simulado ======
+// El modelo del Dispositivo de Testeo: una espiral alrededor de un punto base
+// que gira 2° por segundo y se abre 0,01° por segundo, con la velocidad
+// oscilando entre 5 y 25 km/h y entre 5 y 11 satélites. La muestra depende
+// solo del tiempo transcurrido, así el ESP32 y el generador de carga de la
+// flota (herramientas/carga_flota) recorren exactamente lo mismo.
+//
+// giro() es la detección de giros de prueba del firmware: tres muestras
+// seguidas con más de 30° de cambio de rumbo y más de 5 km/h. Sobre la
+// espiral no salta nunca (cambia 2° por muestra); queda para recorridos con
+// giros reales.
+//
+// No depende de Arduino.
+
+struct MuestraSimulada {
+  double lat;
+  double lon;
+  double rumbo;
+  double velocidad;  // km/h
+  int satelites;
+};
+
+class SimuladorGPS {
+ public:
+  SimuladorGPS(double latBase, double lonBase);
+
+  // 'transcurridoMs' desde el comienzo de la simulación
+  MuestraSimulada muestra(uint32_t transcurridoMs) const;
+
+  // true en la muestra que confirma el giro; el contador vuelve a cero
+  bool giro(const MuestraSimulada& m);
+  void reiniciarGiros();
+
+ private:
+  double latBase;
+  double lonBase;
+  double rumboAnterior;
+  uint8_t muestrasEnGiro;
+};
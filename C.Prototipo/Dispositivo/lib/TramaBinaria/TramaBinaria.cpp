@@ -0,0 +1,404 @@
+#include "TramaBinaria.h"
+
+#include <string.h>
+
+static const size_t LARGO_PUNTO = 28;
+static const size_t LARGO_INICIO = 24;
+static const size_t LARGO_FIN = 11;
+static const size_t LARGO_UBICACION = 20;
+static const size_t LARGO_DIAGNOSTICO_V1 = 10;
+static const size_t LARGO_DIAGNOSTICO = 22;
+static const size_t LARGO_CABECERA_LOTE = 20;
+static const size_t LARGO_RESUMEN = 32;
+
+// ====== Escritura / lectura little endian ======
+namespace {
+
+struct Escritor {
+  uint8_t* p;
+  void u8(uint8_t v) { *p++ = v; }
+  void u16(uint16_t v) {
+    *p++ = v & 0xFF;
+    *p++ = v >> 8;
+  }
+  void u32(uint32_t v) {
+    for (uint8_t i = 0; i < 4; i++) *p++ = (v >> (8 * i)) & 0xFF;
+  }
+  void i32(int32_t v) { u32((uint32_t)v); }
+};
+
+struct Lector {
+  const uint8_t* p;
+  uint8_t u8() { return *p++; }
+  uint16_t u16() {
+    uint16_t v = (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+    p += 2;
+    return v;
+  }
+  uint32_t u32() {
+    uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    p += 4;
+    return v;
+  }
+  int32_t i32() { return (int32_t)u32(); }
+};
+
+uint8_t cabecera(TipoTrama tipo) {
+  return (uint8_t)((TRAMA_VERSION << 4) | (tipo & 0x0F));
+}
+
+uint8_t flagsMapeo(const TramaMapeo& m) {
+  uint8_t sats = m.satelites > 31 ? 31 : m.satelites;
+  return sats | (m.precisionBaja ? 0x20 : 0x00);
+}
+
+void leerFlagsMapeo(uint8_t f, TramaMapeo& m) {
+  m.satelites = f & 0x1F;
+  m.precisionBaja = (f & 0x20) != 0;
+}
+
+}  // namespace
+
+// ====== Codificación ======
+size_t codificarPunto(const TramaMapeo& m, uint8_t* destino, size_t capacidad) {
+  if (capacidad < LARGO_PUNTO) return 0;
+  Escritor e{destino};
+  e.u8(cabecera(TRAMA_PUNTO));
+  e.u32(m.seq);
+  e.u16(m.calle);
+  e.i32(m.latE7);
+  e.i32(m.lonE7);
+  e.u16(m.velocidadCentiKmh);
+  e.u16(m.rumboCentiGrados);
+  e.u32(m.tiempoGps);
+  e.u32(m.timestamp);
+  e.u8(flagsMapeo(m));
+  return LARGO_PUNTO;
+}
+
+size_t codificarInicio(const TramaMapeo& m, uint8_t* destino, size_t capacidad) {
+  if (capacidad < LARGO_INICIO) return 0;
+  Escritor e{destino};
+  e.u8(cabecera(TRAMA_INICIO));
+  e.u32(m.seq);
+  e.u16(m.calle);
+  e.i32(m.latE7);
+  e.i32(m.lonE7);
+  e.u32(m.tiempoGps);
+  e.u32(m.timestamp);
+  e.u8(flagsMapeo(m));
+  return LARGO_INICIO;
+}
+
+size_t codificarFin(const TramaMapeo& m, uint8_t* destino, size_t capacidad, const uint32_t* tramos,
+                    uint8_t cantidadTramos) {
+  if (capacidad < LARGO_FIN) return 0;
+  Escritor e{destino};
+  e.u8(cabecera(TRAMA_FIN));
+  e.u32(m.seq);
+  e.u16(m.calle);
+  e.u32(m.timestamp);
+  if (cantidadTramos == 0) return LARGO_FIN;
+  if (capacidad == LARGO_FIN) return 0;
+  size_t pos = LARGO_FIN;
+  destino[pos++] = cantidadTramos;
+  for (uint8_t i = 0; i < cantidadTramos; i++) {
+    size_t n = escribirVarint(tramos[i], destino + pos, capacidad - pos);
+    if (n == 0) return 0;
+    pos += n;
+  }
+  return pos;
+}
+
+size_t codificarUbicacion(const TramaMapeo& m, uint8_t* destino, size_t capacidad) {
+  if (capacidad < LARGO_UBICACION) return 0;
+  Escritor e{destino};
+  e.u8(cabecera(TRAMA_UBICACION));
+  e.u32(m.seq);
+  e.i32(m.latE7);
+  e.i32(m.lonE7);
+  e.u16(m.velocidadCentiKmh);
+  e.u32(m.timestamp);
+  e.u8(flagsMapeo(m));
+  return LARGO_UBICACION;
+}
+
+size_t codificarDiagnostico(const TramaDiagnostico& d, uint8_t* destino, size_t capacidad) {
+  if (capacidad < LARGO_DIAGNOSTICO) return 0;
+  Escritor e{destino};
+  e.u8(cabecera(TRAMA_DIAGNOSTICO));
+  e.u32(d.timestamp);
+  uint8_t sats = d.satelites > 31 ? 31 : d.satelites;
+  e.u8(sats | (d.wifi ? 0x20 : 0) | (d.mqtt ? 0x40 : 0) | (d.gps ? 0x80 : 0));
+  e.u32(d.colaPendientes);
+  e.u32(d.sentenciasGps);
+  e.u32(d.descartadasGps);
+  e.u32(d.desbordesGps);
+  return LARGO_DIAGNOSTICO;
+}
+
+size_t codificarResumen(const TramaResumen& r, uint8_t* destino, size_t capacidad) {
+  if (capacidad < LARGO_RESUMEN || r.rangos > TRAMA_RESUMEN_MAX_RANGOS) return 0;
+  Escritor e{destino};
+  e.u8(cabecera(TRAMA_RESUMEN));
+  e.u32(r.seq);
+  e.u16(r.calle);
+  e.u32(r.timestamp);
+  e.u8((r.viaje ? 0x01 : 0) | (r.final ? 0x02 : 0));
+  e.u32(r.distanciaM);
+  e.u32(r.duracionS);
+  e.u32(r.detenidoS);
+  e.u16(r.velocidadMaxCentiKmh);
+  e.u16(r.paradas);
+  e.u16(r.aceleraciones);
+  e.u16(r.frenadas);
+  if (r.rangos == 0) return LARGO_RESUMEN;
+  if (capacidad == LARGO_RESUMEN) return 0;
+  size_t pos = LARGO_RESUMEN;
+  destino[pos++] = r.rangos;
+  for (uint8_t i = 0; i < r.rangos; i++) {
+    size_t n = escribirVarint(r.rangoS[i], destino + pos, capacidad - pos);
+    if (n == 0) return 0;
+    pos += n;
+  }
+  return pos;
+}
+
+size_t codificarLote(uint32_t seq, uint16_t calle, const PuntoLote* puntos, uint8_t cantidad,
+                     uint8_t* destino, size_t capacidad, TipoTrama tipo) {
+  if (cantidad == 0 || capacidad < LARGO_CABECERA_LOTE) return 0;
+  Escritor e{destino};
+  e.u8(cabecera(tipo));
+  e.u32(seq);
+  e.u16(calle);
+  e.u8(cantidad);
+  e.u32(puntos[0].tiempoMs);
+  e.i32(puntos[0].latE6);
+  e.i32(puntos[0].lonE6);
+
+  size_t usado = LARGO_CABECERA_LOTE;
+  // Se redondea el tiempo desde el primer punto y se manda la diferencia:
+  // redondear cada intervalo por separado acumularía el error en la decodificación
+  uint32_t previoCs = 0;
+  for (uint8_t i = 1; i < cantidad; i++) {
+    uint32_t desdeInicioCs = (puntos[i].tiempoMs - puntos[0].tiempoMs + 5) / 10;
+    uint32_t campos[3] = {
+      zigzag(puntos[i].latE6 - puntos[i - 1].latE6),
+      zigzag(puntos[i].lonE6 - puntos[i - 1].lonE6),
+      desdeInicioCs - previoCs
+    };
+    previoCs = desdeInicioCs;
+    for (uint8_t c = 0; c < 3; c++) {
+      size_t n = escribirVarint(campos[c], destino + usado, capacidad - usado);
+      if (n == 0) return 0;
+      usado += n;
+    }
+  }
+  return usado;
+}
+
+// ====== Decodificación ======
+ResultadoTrama decodificarTrama(const uint8_t* datos, size_t largo, Trama& trama) {
+  memset(&trama, 0, sizeof(trama));
+  if (largo < 1) return TRAMA_CORTA;
+
+  Lector l{datos};
+  uint8_t cab = l.u8();
+  trama.version = cab >> 4;
+  trama.tipo = (TipoTrama)(cab & 0x0F);
+  if (trama.version != TRAMA_VERSION) return TRAMA_VERSION_DESCONOCIDA;
+
+  TramaMapeo& m = trama.mapeo;
+  switch (trama.tipo) {
+    case TRAMA_PUNTO:
+      if (largo < LARGO_PUNTO) return TRAMA_CORTA;
+      m.seq = l.u32();
+      m.calle = l.u16();
+      m.latE7 = l.i32();
+      m.lonE7 = l.i32();
+      m.velocidadCentiKmh = l.u16();
+      m.rumboCentiGrados = l.u16();
+      m.tiempoGps = l.u32();
+      m.timestamp = l.u32();
+      leerFlagsMapeo(l.u8(), m);
+      return TRAMA_OK;
+
+    case TRAMA_INICIO:
+      if (largo < LARGO_INICIO) return TRAMA_CORTA;
+      m.seq = l.u32();
+      m.calle = l.u16();
+      m.latE7 = l.i32();
+      m.lonE7 = l.i32();
+      m.tiempoGps = l.u32();
+      m.timestamp = l.u32();
+      leerFlagsMapeo(l.u8(), m);
+      return TRAMA_OK;
+
+    case TRAMA_FIN:
+      if (largo < LARGO_FIN) return TRAMA_CORTA;
+      m.seq = l.u32();
+      m.calle = l.u16();
+      m.timestamp = l.u32();
+      return TRAMA_OK;
+
+    case TRAMA_UBICACION:
+      if (largo < LARGO_UBICACION) return TRAMA_CORTA;
+      m.seq = l.u32();
+      m.latE7 = l.i32();
+      m.lonE7 = l.i32();
+      m.velocidadCentiKmh = l.u16();
+      m.timestamp = l.u32();
+      leerFlagsMapeo(l.u8(), m);
+      return TRAMA_OK;
+
+    case TRAMA_DIAGNOSTICO: {
+      if (largo < LARGO_DIAGNOSTICO_V1) return TRAMA_CORTA;
+      TramaDiagnostico& d = trama.diagnostico;
+      d.timestamp = l.u32();
+      uint8_t f = l.u8();
+      d.satelites = f & 0x1F;
+      d.wifi = (f & 0x20) != 0;
+      d.mqtt = (f & 0x40) != 0;
+      d.gps = (f & 0x80) != 0;
+      d.colaPendientes = l.u32();
+      if (largo >= LARGO_DIAGNOSTICO) {
+        d.sentenciasGps = l.u32();
+        d.descartadasGps = l.u32();
+        d.desbordesGps = l.u32();
+      }
+      return TRAMA_OK;
+    }
+
+    case TRAMA_LOTE:
+    case TRAMA_GEOMETRIA:
+      if (largo < LARGO_CABECERA_LOTE) return TRAMA_CORTA;
+      m.seq = l.u32();
+      m.calle = l.u16();
+      trama.puntosLote = l.u8();
+      m.timestamp = l.u32();
+      return TRAMA_OK;
+
+    case TRAMA_RESUMEN: {
+      if (largo < LARGO_RESUMEN) return TRAMA_CORTA;
+      TramaResumen& r = trama.resumen;
+      r.seq = l.u32();
+      r.calle = l.u16();
+      r.timestamp = l.u32();
+      uint8_t f = l.u8();
+      r.viaje = (f & 0x01) != 0;
+      r.final = (f & 0x02) != 0;
+      r.distanciaM = l.u32();
+      r.duracionS = l.u32();
+      r.detenidoS = l.u32();
+      r.velocidadMaxCentiKmh = l.u16();
+      r.paradas = l.u16();
+      r.aceleraciones = l.u16();
+      r.frenadas = l.u16();
+      if (largo > LARGO_RESUMEN) {
+        uint8_t cantidad = datos[LARGO_RESUMEN];
+        size_t pos = LARGO_RESUMEN + 1;
+        for (uint8_t i = 0; i < cantidad && i < TRAMA_RESUMEN_MAX_RANGOS; i++) {
+          size_t n = leerVarint(datos + pos, largo - pos, r.rangoS[i]);
+          if (n == 0) return TRAMA_CORTA;
+          pos += n;
+          r.rangos = i + 1;
+        }
+      }
+      return TRAMA_OK;
+    }
+  }
+  return TRAMA_TIPO_DESCONOCIDO;
+}
+
+const char* nombreTipoTrama(TipoTrama tipo) {
+  switch (tipo) {
+    case TRAMA_PUNTO: return "punto";
+    case TRAMA_INICIO: return "inicio";
+    case TRAMA_FIN: return "fin";
+    case TRAMA_UBICACION: return "ubicacion";
+    case TRAMA_DIAGNOSTICO: return "diagnostico";
+    case TRAMA_LOTE: return "lote";
+    case TRAMA_GEOMETRIA: return "geometria";
+    case TRAMA_RESUMEN: return "resumen";
+  }
+  return "desconocido";
+}
+
+uint8_t decodificarPuntosLote(const uint8_t* datos, size_t largo, PuntoLote* puntos, uint8_t maxPuntos) {
+  if (largo < LARGO_CABECERA_LOTE || maxPuntos == 0) return 0;
+  if (datos[0] != cabecera(TRAMA_LOTE) && datos[0] != cabecera(TRAMA_GEOMETRIA)) return 0;
+  Lector l{datos + 7};
+  uint8_t cantidad = l.u8();
+  if (cantidad == 0) return 0;
+  puntos[0].tiempoMs = l.u32();
+  puntos[0].latE6 = l.i32();
+  puntos[0].lonE6 = l.i32();
+
+  size_t pos = LARGO_CABECERA_LOTE;
+  uint8_t i = 1;
+  for (; i < cantidad && i < maxPuntos; i++) {
+    uint32_t campos[3];
+    for (uint8_t c = 0; c < 3; c++) {
+      size_t n = leerVarint(datos + pos, largo - pos, campos[c]);
+      if (n == 0) return 0;
+      pos += n;
+    }
+    puntos[i].latE6 = puntos[i - 1].latE6 + deszigzag(campos[0]);
+    puntos[i].lonE6 = puntos[i - 1].lonE6 + deszigzag(campos[1]);
+    puntos[i].tiempoMs = puntos[i - 1].tiempoMs + campos[2] * 10;
+  }
+  return i;
+}
+
+uint8_t decodificarTramosFin(const uint8_t* datos, size_t largo, uint32_t* tramos, uint8_t maxTramos) {
+  if (largo <= LARGO_FIN || datos[0] != cabecera(TRAMA_FIN)) return 0;
+  uint8_t cantidad = datos[LARGO_FIN];
+  size_t pos = LARGO_FIN + 1;
+  uint8_t i = 0;
+  for (; i < cantidad && i < maxTramos; i++) {
+    size_t n = leerVarint(datos + pos, largo - pos, tramos[i]);
+    if (n == 0) return 0;
+    pos += n;
+  }
+  return i;
+}
+
+// ====== Varint ======
+size_t escribirVarint(uint32_t valor, uint8_t* destino, size_t capacidad) {
+  size_t n = 0;
+  do {
+    if (n >= capacidad) return 0;
+    uint8_t b = valor & 0x7F;
+    valor >>= 7;
+    destino[n++] = b | (valor ? 0x80 : 0x00);
+  } while (valor);
+  return n;
+}
+
+size_t leerVarint(const uint8_t* datos, size_t largo, uint32_t& valor) {
+  valor = 0;
+  for (size_t n = 0; n < largo && n < 5; n++) {
+    valor |= (uint32_t)(datos[n] & 0x7F) << (7 * n);
+    if ((datos[n] & 0x80) == 0) return n + 1;
+  }
+  return 0;
+}
+
+// ====== Punto fijo ======
+int32_t gradosAE7(double grados) {
+  double v = grados * 1e7;
+  if (v > 2147483647.0) return 2147483647;
+  if (v < -2147483648.0) return (int32_t)-2147483647 - 1;
+  return (int32_t)(v < 0 ? v - 0.5 : v + 0.5);
+}
+
+double e7AGrados(int32_t e7) {
+  return e7 / 1e7;
+}
+
+uint16_t aCentesimas(double valor) {
+  double v = valor * 100.0 + 0.5;
+  if (v <= 0) return 0;
+  if (v >= 65535.0) return 65535;
+  return (uint16_t)v;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ====== Formato binario de telemetría (opcional) ======
+// Alternativa compacta al JSON para los mensajes de mapeo, ubicación y
+// diagnóstico. El device_id no viaja en el payload: va en el tópico.
+//
+// Todas las tramas empiezan con un byte [versión:4 | tipo:4] y los campos
+// van en little endian con ancho fijo:
+//
+//   PUNTO       cab seq:4 calle:2 lat:4 lon:4 vel:2 rumbo:2 tiempo:4 ts:4 flags:1  = 28 bytes
+//   INICIO      cab seq:4 calle:2 lat:4 lon:4 tiempo:4 ts:4 flags:1                = 24 bytes
+//   FIN         cab seq:4 calle:2 ts:4 [n:1 {tramo}*n]                             = 11 bytes + tramos
+//   UBICACION   cab seq:4 lat:4 lon:4 vel:2 ts:4 flags:1                           = 20 bytes
+//   DIAGNOSTICO cab ts:4 flags:1 cola:4 sent:4 desc:4 desb:4                       = 22 bytes
+//   LOTE        cab seq:4 calle:2 n:1 t0:4 lat0:4 lon0:4 {dlat dlon dt}*(n-1)      = 20 + ~5/punto
+//   GEOMETRIA   igual que LOTE: vértices simplificados de la calle completa
+//   RESUMEN     cab seq:4 calle:2 ts:4 flags:1 dist:4 dur:4 det:4 vmax:2
+//               paradas:2 acel:2 fren:2 [n:1 {rango}*n]                        = 32 bytes + rangos
+//
+// lat/lon en 1e-7 grados, vel en centésimas de km/h, rumbo en centésimas de
+// grado, tiempo es el hhmmsscc del GPS y ts el millis() del equipo.
+// flags de mapeo/ubicación: satélites en bits 0-4, precisión baja en bit 5.
+// flags de diagnóstico: satélites en bits 0-4, WiFi bit 5, MQTT bit 6, GPS bit 7.
+// sent/desc/desb son las sentencias NMEA vistas, descartadas (checksum o
+// truncadas) y los desbordes de la UART; las tramas de 10 bytes de firmwares
+// anteriores se siguen aceptando con esos campos en 0.
+//
+// En el LOTE las coordenadas van en 1e-6 grados (0,11 m) y cada punto después
+// del primero se codifica como diferencia con el anterior en varint zigzag;
+// dt en centésimas de segundo. t0 es el millis() del primer punto.
+//
+// RESUMEN (lib/ResumenViaje): dist en metros, dur y det (detenido) en
+// segundos, vmax en centésimas de km/h; flags bit 0 = del viaje (si no, de
+// la calle 'calle'), bit 1 = último del viaje. Los rangos van solo en el del
+// viaje: segundos en cada rango de velocidad, en varint.
+//
+// El FIN de una calle que iba por tramos que el backend ya tiene
+// (lib/GrafoCalles) lleva sus IDs en varint; sin tramos la trama termina en
+// ts, como en las versiones anteriores.
+//
+// El decodificador ignora bytes sobrantes al final, así una versión futura
+// puede agregar campos sin romper a los lectores existentes.
+//
+// Este módulo no depende de Arduino: el backend y las herramientas de prueba
+// pueden compilarlo tal cual.
+
+const uint8_t TRAMA_VERSION = 1;
+const size_t TRAMA_MAX_BYTES = 32;
+const uint8_t TRAMA_LOTE_MAX_PUNTOS = 64;
+const size_t TRAMA_LOTE_MAX_BYTES = 20 + (TRAMA_LOTE_MAX_PUNTOS - 1) * 15;
+const uint8_t TRAMA_RESUMEN_MAX_RANGOS = 16;
+
+enum TipoTrama {
+  TRAMA_PUNTO = 1,
+  TRAMA_INICIO = 2,
+  TRAMA_FIN = 3,
+  TRAMA_UBICACION = 4,
+  TRAMA_DIAGNOSTICO = 5,
+  TRAMA_LOTE = 6,
+  TRAMA_GEOMETRIA = 7,
+  TRAMA_RESUMEN = 8
+};
+
+enum ResultadoTrama {
+  TRAMA_OK = 0,
+  TRAMA_CORTA,
+  TRAMA_VERSION_DESCONOCIDA,
+  TRAMA_TIPO_DESCONOCIDO
+};
+
+struct TramaMapeo {
+  uint32_t seq;
+  uint16_t calle;
+  int32_t latE7;
+  int32_t lonE7;
+  uint16_t velocidadCentiKmh;
+  uint16_t rumboCentiGrados;
+  uint32_t tiempoGps;
+  uint32_t timestamp;
+  uint8_t satelites;
+  bool precisionBaja;
+};
+
+struct TramaDiagnostico {
+  uint32_t timestamp;
+  uint8_t satelites;
+  bool wifi;
+  bool mqtt;
+  bool gps;
+  uint32_t colaPendientes;
+  uint32_t sentenciasGps;
+  uint32_t descartadasGps;
+  uint32_t desbordesGps;
+};
+
+struct TramaResumen {
+  uint32_t seq;
+  uint16_t calle;
+  uint32_t timestamp;
+  bool viaje;
+  bool final;
+  uint32_t distanciaM;
+  uint32_t duracionS;
+  uint32_t detenidoS;
+  uint16_t velocidadMaxCentiKmh;
+  uint16_t paradas;
+  uint16_t aceleraciones;
+  uint16_t frenadas;
+  uint8_t rangos;
+  uint32_t rangoS[TRAMA_RESUMEN_MAX_RANGOS];
+};
+
+struct PuntoLote {
+  int32_t latE6;
+  int32_t lonE6;
+  uint32_t tiempoMs;
+};
+
+struct Trama {
+  uint8_t version;
+  TipoTrama tipo;
+  TramaMapeo mapeo;              // PUNTO, INICIO, FIN, UBICACION; en LOTE/GEOMETRIA seq, calle y t0 en timestamp
+  TramaDiagnostico diagnostico;  // DIAGNOSTICO
+  TramaResumen resumen;          // RESUMEN
+  uint8_t puntosLote;            // LOTE/GEOMETRIA: usar decodificarPuntosLote para expandirlo
+};
+
+// Devuelven los bytes escritos o 0 si no entra en 'capacidad'
+size_t codificarPunto(const TramaMapeo& m, uint8_t* destino, size_t capacidad);
+size_t codificarInicio(const TramaMapeo& m, uint8_t* destino, size_t capacidad);
+size_t codificarFin(const TramaMapeo& m, uint8_t* destino, size_t capacidad, const uint32_t* tramos = nullptr,
+                    uint8_t cantidadTramos = 0);
+size_t codificarUbicacion(const TramaMapeo& m, uint8_t* destino, size_t capacidad);
+size_t codificarDiagnostico(const TramaDiagnostico& d, uint8_t* destino, size_t capacidad);
+size_t codificarResumen(const TramaResumen& r, uint8_t* destino, size_t capacidad);
+size_t codificarLote(uint32_t seq, uint16_t calle, const PuntoLote* puntos, uint8_t cantidad,
+                     uint8_t* destino, size_t capacidad, TipoTrama tipo = TRAMA_LOTE);
+
+ResultadoTrama decodificarTrama(const uint8_t* datos, size_t largo, Trama& trama);
+const char* nombreTipoTrama(TipoTrama tipo);
+
+// Devuelve la cantidad de puntos escritos en 'puntos' (0 si la trama es inválida)
+uint8_t decodificarPuntosLote(const uint8_t* datos, size_t largo, PuntoLote* puntos, uint8_t maxPuntos);
+
+// IDs de los tramos conocidos de un FIN; 0 si no trae o la trama es inválida
+uint8_t decodificarTramosFin(const uint8_t* datos, size_t largo, uint32_t* tramos, uint8_t maxTramos);
+
+// Varint sin signo (7 bits por byte) y zigzag para enteros con signo
+size_t escribirVarint(uint32_t valor, uint8_t* destino, size_t capacidad);
+size_t leerVarint(const uint8_t* datos, size_t largo, uint32_t& valor);
+inline uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+inline int32_t deszigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+// Conversión a punto fijo con redondeo y saturación
+int32_t gradosAE7(double grados);
+double e7AGrados(int32_t e7);
+uint16_t aCentesimas(double valor);
@@ -0,0 +1,186 @@
+#include "VentanaGPS.h"
+
+#include <math.h>
+
+static const double GRADOS_A_RAD = M_PI / 180.0;
+static const double METROS_POR_GRADO = RADIO_TIERRA_M * GRADOS_A_RAD;
+
+// ====== Welford con retiro ======
+void VentanaGPS::Welford::sumar(double x, uint16_t nuevoN) {
+  double d = x - media;
+  media += d / nuevoN;
+  m2 += d * (x - media);
+}
+
+void VentanaGPS::Welford::restar(double x, uint16_t nuevoN) {
+  if (nuevoN == 0) {
+    media = 0.0;
+    m2 = 0.0;
+    return;
+  }
+  double d = x - media;
+  media -= d / nuevoN;
+  m2 -= d * (x - media);
+  if (m2 < 0.0) m2 = 0.0;
+}
+
+// ====== Ventana ======
+VentanaGPS::VentanaGPS(MuestraGPS* muestras, uint16_t* colaMin, uint16_t* colaMax, uint16_t capacidad,
+                       const ConfigVentanaGPS& config)
+    : muestras(muestras), colaMin(colaMin), colaMax(colaMax), capacidad(capacidad), config(config),
+      totalRechazadas(0) {
+  vaciar();
+}
+
+void VentanaGPS::vaciar() {
+  inicio = 0;
+  n = 0;
+  minInicio = minLargo = 0;
+  maxInicio = maxLargo = 0;
+  origenLat = origenLon = 0.0;
+  cosOrigen = 1.0f;
+  lat = {0.0, 0.0};
+  lon = {0.0, 0.0};
+  vel = {0.0, 0.0};
+  sumaSen = sumaCos = 0.0;
+  sumaSatelites = 0;
+  retirosDesdeRecalculo = 0;
+  rechazosSeguidos = 0;
+}
+
+uint16_t VentanaGPS::indiceFisico(uint16_t edad) const {
+  return (uint16_t)((inicio + n - 1 - edad) % capacidad);
+}
+
+const MuestraGPS& VentanaGPS::muestra(uint16_t edad) const {
+  return muestras[indiceFisico(edad)];
+}
+
+bool VentanaGPS::esSalto(const MuestraGPS& m) const {
+  if (n == 0 || config.maxRechazosSeguidos == 0) return false;
+  const MuestraGPS& previa = muestra(0);
+  float velocidad = m.velocidad > previa.velocidad ? m.velocidad : previa.velocidad;
+  // 50% de holgura sobre la velocidad informada, con tope
+  velocidad *= 1.5f;
+  if (velocidad > config.velocidadMaximaKmh) velocidad = config.velocidadMaximaKmh;
+  float segundos = (m.tiempoMs - previa.tiempoMs) / 1000.0f;
+  float permitida = velocidad / 3.6f * segundos + config.margenSaltoMetros;
+  // Chequeo por fix: equirectangular con el coseno del origen de la ventana
+  return distanciaEquirectangular(previa.lat, previa.lon, m.lat, m.lon, cosOrigen) > permitida;
+}
+
+bool VentanaGPS::agregar(const MuestraGPS& m) {
+  if (esSalto(m)) {
+    totalRechazadas++;
+    if (++rechazosSeguidos < config.maxRechazosSeguidos) {
+      return false;
+    }
+    // Demasiados rechazos seguidos: la ventana quedó vieja, se empieza de nuevo
+    vaciar();
+  }
+  rechazosSeguidos = 0;
+
+  if (n == capacidad) {
+    sacarMasVieja();
+  }
+  if (n == 0) {
+    origenLat = m.lat;
+    origenLon = m.lon;
+    cosOrigen = (float)cos(m.lat * GRADOS_A_RAD);
+  }
+
+  uint16_t pos = (uint16_t)((inicio + n) % capacidad);
+  muestras[pos] = m;
+  n++;
+
+  lat.sumar(m.lat - origenLat, n);
+  lon.sumar(m.lon - origenLon, n);
+  vel.sumar(m.velocidad, n);
+  sumaSen += sin(m.rumbo * GRADOS_A_RAD);
+  sumaCos += cos(m.rumbo * GRADOS_A_RAD);
+  sumaSatelites += m.satelites;
+
+  // Colas monótonas: se descartan por detrás las que ya no pueden ser extremo
+  while (minLargo > 0 && muestras[colaMin[(minInicio + minLargo - 1) % capacidad]].velocidad >= m.velocidad) {
+    minLargo--;
+  }
+  colaMin[(minInicio + minLargo++) % capacidad] = pos;
+  while (maxLargo > 0 && muestras[colaMax[(maxInicio + maxLargo - 1) % capacidad]].velocidad <= m.velocidad) {
+    maxLargo--;
+  }
+  colaMax[(maxInicio + maxLargo++) % capacidad] = pos;
+  return true;
+}
+
+void VentanaGPS::sacarMasVieja() {
+  const MuestraGPS& m = muestras[inicio];
+  n--;
+  lat.restar(m.lat - origenLat, n);
+  lon.restar(m.lon - origenLon, n);
+  vel.restar(m.velocidad, n);
+  sumaSen -= sin(m.rumbo * GRADOS_A_RAD);
+  sumaCos -= cos(m.rumbo * GRADOS_A_RAD);
+  sumaSatelites -= m.satelites;
+
+  if (minLargo > 0 && colaMin[minInicio] == inicio) {
+    minInicio = (minInicio + 1) % capacidad;
+    minLargo--;
+  }
+  if (maxLargo > 0 && colaMax[maxInicio] == inicio) {
+    maxInicio = (maxInicio + 1) % capacidad;
+    maxLargo--;
+  }
+  inicio = (inicio + 1) % capacidad;
+
+  if (++retirosDesdeRecalculo >= RECALCULO_VENTANA) {
+    recalcular();
+  }
+}
+
+void VentanaGPS::recalcular() {
+  retirosDesdeRecalculo = 0;
+  lat = {0.0, 0.0};
+  lon = {0.0, 0.0};
+  vel = {0.0, 0.0};
+  sumaSen = sumaCos = 0.0;
+  for (uint16_t i = 0; i < n; i++) {
+    const MuestraGPS& m = muestras[(inicio + i) % capacidad];
+    lat.sumar(m.lat - origenLat, i + 1);
+    lon.sumar(m.lon - origenLon, i + 1);
+    vel.sumar(m.velocidad, i + 1);
+    sumaSen += sin(m.rumbo * GRADOS_A_RAD);
+    sumaCos += cos(m.rumbo * GRADOS_A_RAD);
+  }
+}
+
+double VentanaGPS::desvioLatitudMetros() const {
+  return sqrt(lat.varianza(n)) * METROS_POR_GRADO;
+}
+
+double VentanaGPS::desvioLongitudMetros() const {
+  return sqrt(lon.varianza(n)) * METROS_POR_GRADO * cosOrigen;
+}
+
+double VentanaGPS::desvioVelocidad() const {
+  return sqrt(vel.varianza(n));
+}
+
+double VentanaGPS::rumboMedio() const {
+  if (n == 0) return 0.0;
+  double r = atan2(sumaSen, sumaCos) / GRADOS_A_RAD;
+  return r < 0.0 ? r + 360.0 : r;
+}
+
+double VentanaGPS::longitudResultante() const {
+  if (n == 0) return 0.0;
+  double r = sqrt(sumaSen * sumaSen + sumaCos * sumaCos) / n;
+  return r > 1.0 ? 1.0 : r;
+}
+
+float VentanaGPS::velocidadMinima() const {
+  return minLargo ? muestras[colaMin[minInicio]].velocidad : 0.0f;
+}
+
+float VentanaGPS::velocidadMaxima() const {
+  return maxLargo ? muestras[colaMax[maxInicio]].velocidad : 0.0f;
+}
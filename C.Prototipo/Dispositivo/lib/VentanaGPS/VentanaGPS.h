@@ -0,0 +1,134 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <Geodesia.h>
+
+// ====== Ventana deslizante de muestras GPS ======
+// Buffer circular que mantiene las estadísticas al día en cada muestra que
+// entra y sale, así todas las consultas son O(1) sin importar el tamaño de
+// la ventana:
+//
+// - media y varianza (Welford, con retiro) de latitud, longitud y velocidad;
+// - media circular del rumbo y longitud resultante (0 = rumbos dispersos,
+//   1 = todos iguales), así 359° y 1° promedian 0° y no 180°;
+// - mínimo y máximo de velocidad con colas monótonas (O(1) amortizado);
+// - descarte de saltos imposibles: una muestra cuya distancia a la anterior
+//   no se explica por la velocidad informada se rechaza. Tras
+//   'maxRechazosSeguidos' rechazos se acepta igual (el equipo realmente se
+//   movió, p. ej. después de estar sin fix).
+//
+// Latitud y longitud se acumulan como diferencia con un origen fijo para no
+// perder precisión al restar números grandes. Cada 'RECALCULO_VENTANA'
+// retiros las sumas se recalculan desde cero para cortar la deriva del
+// punto flotante (costo amortizado O(1)).
+//
+// El almacenamiento lo pone el llamador; VentanaGPSFija<N> lo trae incluido.
+
+struct MuestraGPS {
+  double lat;
+  double lon;
+  float rumbo;
+  float velocidad;     // km/h
+  uint8_t satelites;
+  uint32_t tiempoGps;  // hhmmsscc del GPS
+  uint32_t tiempoMs;   // millis() al recibirla
+};
+
+struct ConfigVentanaGPS {
+  float velocidadMaximaKmh;     // tope para la velocidad usada en el chequeo de saltos
+  float margenSaltoMetros;      // ruido tolerado entre dos fixes
+  uint8_t maxRechazosSeguidos;  // 0 desactiva el descarte
+};
+
+const uint16_t RECALCULO_VENTANA = 4096;
+
+class VentanaGPS {
+ public:
+  VentanaGPS(MuestraGPS* muestras, uint16_t* colaMin, uint16_t* colaMax, uint16_t capacidad,
+             const ConfigVentanaGPS& config);
+
+  // Devuelve false si la muestra se descartó por salto imposible
+  bool agregar(const MuestraGPS& m);
+  void vaciar();
+
+  uint16_t cantidad() const { return n; }
+  uint16_t capacidadTotal() const { return capacidad; }
+  bool llena() const { return n == capacidad; }
+  bool vacia() const { return n == 0; }
+
+  // edad 0 es la más reciente; edad debe ser menor que cantidad()
+  const MuestraGPS& muestra(uint16_t edad) const;
+
+  double latitudMedia() const { return origenLat + lat.media; }
+  double longitudMedia() const { return origenLon + lon.media; }
+  double velocidadMedia() const { return vel.media; }
+  double satelitesMedia() const { return n ? (double)sumaSatelites / n : 0.0; }
+
+  // Desvío estándar en metros (estimación de la dispersión de los fixes)
+  double desvioLatitudMetros() const;
+  double desvioLongitudMetros() const;
+  double desvioVelocidad() const;
+
+  // Rumbo medio en [0, 360) y longitud resultante en [0, 1]
+  double rumboMedio() const;
+  double longitudResultante() const;
+
+  float velocidadMinima() const;
+  float velocidadMaxima() const;
+
+  uint32_t rechazadas() const { return totalRechazadas; }
+
+ private:
+  struct Welford {
+    double media;
+    double m2;
+    void sumar(double x, uint16_t nuevoN);
+    void restar(double x, uint16_t nuevoN);
+    double varianza(uint16_t n) const { return n > 1 ? m2 / (n - 1) : 0.0; }
+  };
+
+  uint16_t indiceFisico(uint16_t edad) const;
+  bool esSalto(const MuestraGPS& m) const;
+  void sacarMasVieja();
+  void recalcular();
+
+  MuestraGPS* muestras;
+  uint16_t* colaMin;  // posiciones en 'muestras' con velocidad creciente
+  uint16_t* colaMax;  // posiciones en 'muestras' con velocidad decreciente
+  uint16_t capacidad;
+  ConfigVentanaGPS config;
+
+  uint16_t inicio;
+  uint16_t n;
+  uint16_t minInicio, minLargo;
+  uint16_t maxInicio, maxLargo;
+
+  double origenLat;
+  double origenLon;
+  float cosOrigen;
+  Welford lat;
+  Welford lon;
+  Welford vel;
+  double sumaSen;
+  double sumaCos;
+  uint32_t sumaSatelites;
+
+  uint16_t retirosDesdeRecalculo;
+  uint8_t rechazosSeguidos;
+  uint32_t totalRechazadas;
+};
+
+// Ventana con su propio almacenamiento
+template <uint16_t N>
+class VentanaGPSFija : public VentanaGPS {
+ public:
+  explicit VentanaGPSFija(const ConfigVentanaGPS& config)
+      : VentanaGPS(almacenMuestras, almacenMin, almacenMax, N, config) {}
+
+ private:
+  MuestraGPS almacenMuestras[N];
+  uint16_t almacenMin[N];
+  uint16_t almacenMax[N];
+};
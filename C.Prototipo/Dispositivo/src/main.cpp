@@ -15,6 +15,36 @@
 #include <TinyGPSPlus.h>
 #include <SoftwareSerial.h>
 
+#include <LittleFS.h>
+
+#include <Planificador.h>
+#include <ColaPersistente.h>
+#include <AlmacenLittleFS.h>
+#include <TramaBinaria.h>
+#include <LoteTrayecto.h>
+#include <VentanaGPS.h>
+#include <Geodesia.h>
+#include <FiltroKalman.h>
+#include <SimplificadorTrayecto.h>
+#include <DetectorGiros.h>
+#include <FiltroNMEA.h>
+#include <RastreoHeap.h>
+#include <MarcoLCD.h>
+#include <HistogramaLatencia.h>
+#include <EsperaReintentos.h>
+#include <BandejaMQTT.h>
+#include <BandaMuerta.h>
+#include <Geocercas.h>
+#include <AlmacenGeocercasLittleFS.h>
+#include <GrafoCalles.h>
+#include <ResumenViaje.h>
+#include <ParametrosRemotos.h>
+#include <Plataforma.h>
+#include <ProcesadorGPS.h>
+#include <MensajesJSON.h>
+
+#include <lwip/dns.h>
+
 // ====== CONFIG WIFI ======
 const char* WIFI_SSID = "DZS_5380";
 const char* WIFI_PASS = "dzsi123456789";
@@ -36,6 +66,14 @@ const char* MQTT_TOPICO_UBICACION = "vehiculos/ubicacion";  // tracking
 // ====== CONFIG AWS IoT CORE ======
 const char* AWS_IOT_ENDPOINT = "a152xtye3fq6bt-ats.iot.us-east-2.amazonaws.com";  // Reemplazar con tu endpoint
 const int AWS_IOT_PORT = 8883;
+// Con -DLOGIOT_BROKER='"192.168.0.10"' el equipo se conecta a otro broker
+// MQTT/TLS en el mismo puerto (herramientas/broker_tls) para medir las
+// reconexiones sin tocar AWS IoT
+#ifdef LOGIOT_BROKER
+const char* HOST_BROKER = LOGIOT_BROKER;
+#else
+const char* HOST_BROKER = AWS_IOT_ENDPOINT;
+#endif
 const char* THING_NAME = "Grupo1_logiot";  // Tu Thing Name en AWS IoT
 
 // ID único del dispositivo
@@ -45,9 +83,74 @@ const char* DEVICE_ID = "ESP-32-CAMION_01";
 const char* AWS_TOPIC_UBICACION = "logistica/ubicacion/ESP-32-CAMION_01";  // Tracking en tiempo real
 const char* AWS_TOPIC_PEDIDOS = "logistica/pedidos";                       // Mapeo (inicio, punto, fin)
 const char* AWS_TOPIC_INFO = "logistica/info/ESP-32-CAMION_01";            // Diagnóstico
+const char* AWS_TOPIC_CONTROL = "logistica/control/ESP-32-CAMION_01";      // Comandos a este equipo
+const char* AWS_TOPIC_CONTROL_FLOTA = "logistica/control/flota";           // Comandos a todos los camiones
+const char* AWS_TOPIC_CONTROL_RESPUESTA = "logistica/control/ESP-32-CAMION_01/respuesta";
+
+// ====== Formato de los mensajes ======
+// Con -DLOGIOT_FORMATO_BINARIO=1 se publica el formato compacto de
+// lib/TramaBinaria en tópicos propios (el device_id va en el tópico)
+#ifndef LOGIOT_FORMATO_BINARIO
+#define LOGIOT_FORMATO_BINARIO 0
+#endif
+#if LOGIOT_FORMATO_BINARIO
+const char* TOPICO_UBICACION = "logistica/bin/ubicacion/ESP-32-CAMION_01";
+const char* TOPICO_PEDIDOS = "logistica/bin/pedidos/ESP-32-CAMION_01";
+const char* TOPICO_INFO = "logistica/bin/info/ESP-32-CAMION_01";
+#else
+const char* TOPICO_UBICACION = AWS_TOPIC_UBICACION;
+const char* TOPICO_PEDIDOS = AWS_TOPIC_PEDIDOS;
+const char* TOPICO_INFO = AWS_TOPIC_INFO;
+#endif
+
+// Con -DLOGIOT_LOTES=1 los puntos de mapeo y de ubicación viajan agrupados
+// (lib/LoteTrayecto) en vez de un mensaje por punto
+#ifndef LOGIOT_LOTES
+#define LOGIOT_LOTES 0
+#endif
+
+// Con -DLOGIOT_SIN_HEAP=1 y los --wrap del enlazador (lib/RastreoHeap) se
+// cuentan las asignaciones del heap por tarea; el loop en régimen no debería
+// pedir memoria fuera de la pila de red
+
+// Con -DLOGIOT_PERFIL=1 se mide en ciclos de CPU cada fase del loop
+// (lib/HistogramaLatencia) y la demora entre el fix y su publicación; sin la
+// opción las mediciones no generan código
+#ifndef LOGIOT_PERFIL
+#define LOGIOT_PERFIL 0
+#endif
+
+// Con -DLOGIOT_BANDA_MUERTA=1 la ubicación se evalúa en cada fix y se
+// publica solo cuando se aparta de lo que extrapola el tablero
+// (lib/BandaMuerta) o como latido, en vez de cada INTERVALO_ENVIO_UBICACION
+#ifndef LOGIOT_BANDA_MUERTA
+#define LOGIOT_BANDA_MUERTA 0
+#endif
+
+// Con -DLOGIOT_GEOCERCAS=1 los depósitos y puntos de entrega llegan por MQTT
+// y quedan en flash (lib/Geocercas); el equipo publica entradas, salidas y
+// permanencias, y adentro de una zona la ubicación pasa a ser un latido
+#ifndef LOGIOT_GEOCERCAS
+#define LOGIOT_GEOCERCAS 0
+#endif
+
+// Con -DLOGIOT_CALLES_CONOCIDAS=1 los tramos de calle que el backend ya
+// tiene llegan por MQTT y quedan en flash (lib/GrafoCalles); en una calle
+// conocida el mapeo no sube vértices, solo los IDs de los tramos recorridos
+#ifndef LOGIOT_CALLES_CONOCIDAS
+#define LOGIOT_CALLES_CONOCIDAS 0
+#endif
+
+// Con -DLOGIOT_RESUMEN_VIAJE=1 el "fin" de cada calle lleva su resumen
+// (distancia, duración, velocidades, paradas, frenadas y aceleraciones
+// bruscas, lib/ResumenViaje) y durante el mapeo sale un resumen del viaje
+// cada INTERVALO_RESUMEN_VIAJE, así el tablero no recorre los puntos
+#ifndef LOGIOT_RESUMEN_VIAJE
+#define LOGIOT_RESUMEN_VIAJE 0
+#endif
 
 // ====== CERTIFICADOS AWS IoT (cargar aquí temporalmente) ======
-/ ====== CERTIFICADOS AWS IoT ======
+// ====== CERTIFICADOS AWS IoT ======
 const char AWS_CERT_CA[] PROGMEM = R"EOF(
 -----BEGIN CERTIFICATE-----
 MIIDQTCCAimgAwIBAgITBmyfz5m/jAo54vB4ikPmljZbyjANBgkqhkiG9w0BAQsF
@@ -132,12 +235,36 @@ L6kbnO1Yejisrb3gs0cBZOA+Ukps7XafcDb6Oppy3mT1jUg9XFcS
 #define PIN_BOTON_DESPLAZAR D6
 LiquidCrystal_I2C lcd(LCD_ADDR, LCD_COLS, LCD_ROWS);
 
+// Las pantallas dibujan en un framebuffer en RAM y tareaPantalla manda al
+// display solo las celdas que cambiaron. Con el PCF8574 en modo 4 bits cada
+// caracter o comando son dos nibbles de tres escrituras I2C.
+const uint8_t BYTES_I2C_POR_COMANDO_LCD = 6;
+const uint16_t PRESUPUESTO_I2C_LCD_POR_PASO = 24;  // ~4 comandos, ~5 ms a 100 kHz
+const unsigned long PERIODO_VOLCADO_LCD = 10;
+
+class SalidaLCDI2C : public SalidaLCD {
+ public:
+  explicit SalidaLCDI2C(LiquidCrystal_I2C& lcd) : lcd(lcd) {}
+  void posicionar(uint8_t columna, uint8_t fila) override { lcd.setCursor(columna, fila); }
+  void escribir(uint8_t c) override { lcd.write(c); }
+
+ private:
+  LiquidCrystal_I2C& lcd;
+};
+SalidaLCDI2C salidaLCD(lcd);
+MarcoLCD pantalla({LCD_COLS, LCD_ROWS, BYTES_I2C_POR_COMANDO_LCD, BYTES_I2C_POR_COMANDO_LCD});
+
 // ====== GPS ======
 #define GPS_RX D7
 #define GPS_TX D8
 #define GPS_BAUD 9600
+// SoftwareSerial recibe por interrupción en su propia cola sin locks; con
+// 1 KB entra ~1 s de NMEA a 9600 baudios aunque el loop se demore (WiFi, TLS)
+#define GPS_BUFFER_UART 1024
 SoftwareSerial gpsSerial(GPS_RX, GPS_TX);
 TinyGPSPlus gps;
+// Solo RMC, GGA y VTG llegan a TinyGPSPlus, y ya con el checksum verificado
+FiltroNMEA filtroNMEA(NMEA_RMC | NMEA_GGA | NMEA_VTG);
 
 // ====== Estados del Dispositivo ======
 enum Estado {
@@ -150,7 +277,7 @@ enum Estado {
 Estado estadoActual = ESTADO_PANTALLA_PRINCIPAL;
 int opcionActual = 0;
 const int NUM_OPCIONES = 3;
-const String opcionesMenu[3] = {"Iniciar Mapeo", "Detener Mapeo", "Reiniciar"};
+const char* const opcionesMenu[3] = {"Iniciar Mapeo", "Detener Mapeo", "Reiniciar"};
 bool mapeando = false;
 unsigned long ultimoDebounceSeleccion = 0;
 unsigned long ultimoDebounceDesplazar = 0;
@@ -162,40 +289,173 @@ bool ultimoEstadoDesplazar = HIGH;
 unsigned long tiempoPulsacionSeleccion = 0;
 const unsigned long TIEMPO_PULSACION_LARGA = 500;
 
-// ====== Estructura PuntoGPS ======
-struct PuntoGPS {
-  double lat;
-  double lon;
-  double rumbo;
-  double velocidad;
-  int satelites;
-  unsigned long tiempo;
-};
-
 // ====== Variables de Mapeo y Tiempos ======
 const int TAMANO_BUFFER_GPS = 30;
-PuntoGPS bufferGPS[TAMANO_BUFFER_GPS];
-int indiceBuffer = 0;
-bool bufferLleno = false;
-bool posibleGiroDetectado = false;
-int contadorLecturasGiro = 0;
-const int UMBRAL_CONFIRMACION_GIRO = 8;
-const double UMBRAL_VELOCIDAD_GIRO = 2.5;
-const double UMBRAL_DISTANCIA_GIRO = 3.0;
+// Saltos de más de (1,5 x velocidad) + 25 m entre fixes se descartan
+const ConfigVentanaGPS CONFIG_VENTANA_GPS = {150.0f, 25.0f, 5};
+VentanaGPSFija<TAMANO_BUFFER_GPS> ventanaGPS(CONFIG_VENTANA_GPS);
+
+// Posición suavizada: Kalman de velocidad constante (aceleración 1 m/s²,
+// 4 m con HDOP 1, velocidad ±0,5 m/s, gate chi² 25, 10 s sin fix, origen cada 2 km)
+const ConfigKalman CONFIG_KALMAN = {1.0f, 4.0f, 0.5f, 25.0f, 10000, 2000.0f};
+FiltroKalman filtroGPS(CONFIG_KALMAN);
+// Giros por curvatura sobre la distancia recorrida; evaluado con
+// herramientas/replay_giros contra el detector por rumbo original
+DetectorGiros detectorGiros(DETECTOR_GIROS_CURVATURA);
+
+// Solo se publican los vértices que se apartan más de 3 m de la recta; en
+// una recta larga, uno cada 2 minutos
+const ConfigSimplificador CONFIG_SIMPLIFICADOR = {3.0f, SIMPLIFICADOR_MAX_VENTANA, 120000};
+SimplificadorTrayecto simplificador(CONFIG_SIMPLIFICADOR);
+// Vértices de la calle en curso, para mandar la geometría completa con el "fin"
+const ConfigLote CONFIG_VERTICES_CALLE = {TRAMA_LOTE_MAX_PUNTOS, 0xFFFFFFFF};
+LoteTrayecto verticesCalle(CONFIG_VERTICES_CALLE);
+bool verticesDesbordados = false;
+
+// Cadena de cada fix aceptado (lib/ProcesadorGPS); los giros y vértices
+// vuelven por EventosMapeo para publicarlos
+class EventosMapeo : public EventosProcesadorGPS {
+ public:
+  void giro(EventoGiro evento, float cambioGrados) override;
+  void inicioCalle(const VerticeTrayecto& v) override;
+  void vertice(const VerticeTrayecto& v) override;
+};
+EventosMapeo eventosMapeo;
+ProcesadorGPS procesadorGPS(ventanaGPS, filtroGPS, detectorGiros, simplificador, eventosMapeo);
 int contadorCalles = 0;
-String idCalleActual = "";
+char idCalleActual[16] = "";
 unsigned long ultimoPuntoMapeoEnviado = 0;
 unsigned long ultimoPuntoUbicacionEnviado = 0;
 unsigned long ultimoDiagnosticoEnviado = 0;
 const unsigned long INTERVALO_ENVIO_UBICACION = 5000;
+#if LOGIOT_BANDA_MUERTA
+// Error máximo en el tablero, latido y velocidad desde la que se extrapola;
+// el tablero usa los mismos valores
+const ConfigBandaMuerta CONFIG_BANDA_MUERTA = {25.0f, 60000, 5.0f};
+const unsigned long INTERVALO_EVALUACION_UBICACION = 1000;  // un fix por segundo
+BandaMuerta bandaMuerta(CONFIG_BANDA_MUERTA);
+#endif
+#if LOGIOT_GEOCERCAS
+const char* AWS_TOPIC_GEOCERCAS = "logistica/geocercas/ESP-32-CAMION_01";  // Zonas de este equipo
+const char* AWS_TOPIC_GEOCERCAS_FLOTA = "logistica/geocercas/flota";       // Zonas de todos los camiones
+const char* AWS_TOPIC_GEOCERCAS_RESPUESTA = "logistica/geocercas/ESP-32-CAMION_01/respuesta";
+const char* AWS_TOPIC_EVENTOS = "logistica/eventos/ESP-32-CAMION_01";      // Entradas, salidas y permanencias
+// Margen de salida, fixes para entrar y para salir, permanencia
+const ConfigGeocercas CONFIG_GEOCERCAS = {30, 2, 3, 300000};
+const unsigned long PERIODO_TAREA_GEOCERCAS = 1000;  // sin carga en curso solo queda responder
+const unsigned long PERIODO_COMPILACION_GEOCERCAS = 20;
+const uint16_t ZONAS_POR_PASO_GEOCERCAS = 16;        // lecturas de flash por paso de compilación
+const unsigned long INTERVALO_UBICACION_EN_ZONA = 120000;
+AlmacenGeocercasLittleFS almacenGeocercas(LittleFS);
+// 1024 celdas y bloques de 512 refs: ~3 KB de RAM para compilar, ~1,6 KB
+// para la celda actual y las zonas seguidas
+GeocercasFija<1024, 512> geocercas(almacenGeocercas, CONFIG_GEOCERCAS);
+bool geocercasDisponibles = false;
+unsigned long ultimaUbicacionEnZona = 0;
+// Resultado de la última carga; se responde desde el loop, no desde el callback
+bool respuestaGeocercasPendiente = false;
+ResultadoCarga resultadoGeocercas = CARGA_COMPLETA;
+#endif
+#if LOGIOT_CALLES_CONOCIDAS
+const char* AWS_TOPIC_CALLES = "logistica/calles/ESP-32-CAMION_01";  // Tramos para este equipo
+const char* AWS_TOPIC_CALLES_FLOTA = "logistica/calles/flota";       // Tramos para todos los camiones
+const char* AWS_TOPIC_CALLES_RESPUESTA = "logistica/calles/ESP-32-CAMION_01/respuesta";
+// Radio, diferencia de rumbo, fixes para confirmar y para soltar, velocidad
+// desde la que cuenta el rumbo; medido con herramientas/rendimiento_grafo_calles
+const ConfigGrafoCalles CONFIG_GRAFO_CALLES = {20, 35, 3, 4, 8};
+const unsigned long PERIODO_TAREA_CALLES = 1000;
+const unsigned long PERIODO_COMPILACION_CALLES = 20;
+const uint16_t TRAMOS_POR_PASO_CALLES = 16;  // lecturas de flash por paso de compilación
+AlmacenGeocercasLittleFS almacenCalles(LittleFS, "/calles");
+// 1024 celdas y bloques de 512 refs: ~3 KB de RAM para compilar, ~1,4 KB
+// para la celda actual y el recorrido
+GrafoCallesFija<1024, 512> grafoCalles(almacenCalles, CONFIG_GRAFO_CALLES);
+bool grafoCallesDisponible = false;
+// La calle en curso va por tramos conocidos: sin vértices, con el recorrido en el "fin"
+bool calleConocida = false;
+uint32_t verticesOmitidos = 0;
+// Al conectar también se responde, así el backend sabe sobre qué versión mandar cambios
+bool respuestaCallesPendiente = false;
+ResultadoCarga resultadoCalles = CARGA_COMPLETA;
+#endif
+#if LOGIOT_RESUMEN_VIAJE
+// Detenido por debajo de 3 km/h y en movimiento desde 6, parada desde 1 min,
+// 2,5 m/s² para aceleraciones y frenadas bruscas, corte del GPS desde 5 s
+const ConfigResumenViaje CONFIG_RESUMEN_VIAJE = {3.0f, 6.0f, 60000, 2.5f, 5000};
+const unsigned long INTERVALO_RESUMEN_VIAJE = 300000;
+ResumenViaje resumenViaje(CONFIG_RESUMEN_VIAJE);
+unsigned long ultimoResumenViaje = 0;
+#endif
 const unsigned long INTERVALO_ENVIO_DIAGNOSTICO = 15000;
 bool tieneFixGPS = false;
-unsigned long ultimoIntentoMQTT = 0;
-const unsigned long INTERVALO_RECONEXION_MQTT = 5000;
-int intentosFallidosMQTT = 0;
-const int MAX_INTENTOS_MQTT = 5;
+// Reconexión a AWS IoT: de 1 s a 5 min entre intentos, sin tope de intentos
+const ConfigReintentos CONFIG_REINTENTOS_MQTT = {1000, 300000};
+EsperaReintentos esperaMQTT(CONFIG_REINTENTOS_MQTT);
+unsigned long proximoIntentoMQTT = 0;
+const uint32_t AVISO_INTENTOS_MQTT = 5;       // desde acá el LCD muestra el error
+const unsigned long TIMEOUT_DNS_MS = 5000;
+const unsigned long TIMEOUT_TLS_MS = 10000;
+const uint16_t TIMEOUT_CONNACK_S = 5;
 bool mqttErrorMostrado = false;
 
+// ====== Planificador de tareas ======
+// Períodos y presupuestos de cada tarea (ms / us)
+const unsigned long PERIODO_TAREA_FIX_GPS = 50;
+const unsigned long PERIODO_TAREA_MQTT_LOOP = 10;
+const unsigned long PERIODO_TAREA_BOTONES = 10;
+const unsigned long PERIODO_TAREA_CONEXION = 250;
+const unsigned long PERIODO_TAREA_DNS = 20;
+const unsigned long INTERVALO_REPORTE_TAREAS = 60000;
+const uint32_t PRESUPUESTO_INGESTA_GPS_US = 2000;
+const uint32_t PRESUPUESTO_TAREA_US = 5000;
+const int MAX_BYTES_GPS_POR_PASO = 128;
+
+Planificador planificador(relojMs, relojUs, contadorAsignaciones);
+
+// Estados de la conexión WiFi y AWS IoT (no bloqueante)
+enum EstadoConexion {
+  CONEXION_INICIAL,
+  CONEXION_ESPERANDO_WIFI,
+  CONEXION_WIFI_OK,   // espera el próximo intento con AWS IoT
+  CONEXION_DNS,       // resolución asíncrona del endpoint
+  CONEXION_TLS,       // TCP + handshake
+  CONEXION_MQTT,      // CONNECT / CONNACK
+  CONEXION_AWS_OK
+};
+EstadoConexion estadoConexion = CONEXION_INICIAL;
+unsigned long inicioEsperaWiFi = 0;
+unsigned long inicioIntentoMQTT = 0;
+unsigned long inicioPasoConexion = 0;
+
+// El callback de lwIP solo marca el resultado; la consulta sirve para
+// ignorar respuestas que llegan después del timeout
+enum ResultadoDNS : uint8_t {
+  DNS_ESPERANDO,
+  DNS_RESUELTO,
+  DNS_FALLIDO
+};
+volatile ResultadoDNS resultadoDNS = DNS_ESPERANDO;
+volatile uint8_t consultaDNS = 0;
+
+// Sesión TLS de la última conexión: al reconectar se ofrece al servidor y,
+// si la acepta, el handshake evita el intercambio RSA (segundos en el ESP8266)
+BearSSL::Session sesionTLS;
+bool sesionTLSValida = false;
+
+// Duración del TCP + TLS, completo o reanudado (se reporta con las tareas)
+struct MedicionHandshake {
+  uint32_t cantidad;
+  uint32_t totalMs;
+  uint32_t peorMs;
+};
+MedicionHandshake handshakeCompleto = {0, 0, 0};
+MedicionHandshake handshakeReanudado = {0, 0, 0};
+uint32_t intentosMQTT = 0;
+uint32_t fallosMQTT = 0;
+
+// Mensajes temporales en el LCD (reemplazan los delay() después de cada aviso)
+unsigned long pantallaOcupadaHasta = 0;
+
 // Variables para diagnóstico
 bool estadoUltimoGPS = false;
 bool estadoUltimoMQTT = false;
@@ -203,7 +463,217 @@ bool estadoUltimoWiFi = false;
 
 // ====== AWS IoT MQTT Client ======
 WiFiClientSecure wifiClientSecure;
-PubSubClient awsClient(wifiClientSecure);
+
+// ====== Bandeja de salida QoS 1 (lib/BandejaMQTT) ======
+// PubSubClient solo publica con QoS 0: los mensajes de datos se escriben
+// armados desde la bandeja directo sobre el socket TLS, y los PUBACK se
+// toman de los bytes que PubSubClient lee en loop() (los ignora) a través de
+// ClienteObservado. El diagnóstico sigue saliendo con QoS 0, también
+// armado a mano (publicarQoS0).
+const uint16_t TAMANO_BANDEJA_MQTT = 4096;
+const ConfigBandeja CONFIG_BANDEJA = {4};  // PUBLISH sin confirmar a la vez
+BandejaMQTTFija<TAMANO_BANDEJA_MQTT> bandejaMQTT(CONFIG_BANDEJA);
+uint32_t ultimoSeqConfirmado = 0;
+
+class ClienteObservado : public Client {
+ public:
+  explicit ClienteObservado(Client& cliente) : cliente(cliente) {}
+  int connect(IPAddress ip, uint16_t puerto) override { return cliente.connect(ip, puerto); }
+  int connect(const char* host, uint16_t puerto) override { return cliente.connect(host, puerto); }
+  size_t write(uint8_t b) override { return cliente.write(b); }
+  size_t write(const uint8_t* datos, size_t largo) override { return cliente.write(datos, largo); }
+  int available() override { return cliente.available(); }
+  int read() override {
+    int b = cliente.read();
+    if (b >= 0) bandejaMQTT.recibir((uint8_t)b, millis());
+    return b;
+  }
+  int read(uint8_t* datos, size_t largo) override {
+    int leidos = cliente.read(datos, largo);
+    for (int i = 0; i < leidos; i++) bandejaMQTT.recibir(datos[i], millis());
+    return leidos;
+  }
+  int peek() override { return cliente.peek(); }
+  void flush() override { cliente.flush(); }
+  void stop() override { cliente.stop(); }
+  uint8_t connected() override { return cliente.connected(); }
+  operator bool() override { return (bool)cliente; }
+
+ private:
+  Client& cliente;
+};
+
+// Un PUBLISH a medias desincroniza el flujo: se corta y en la conexión
+// siguiente la bandeja lo reenvía entero
+class SalidaTLS : public SalidaMQTT {
+ public:
+  bool escribir(const uint8_t* datos, size_t largo) override {
+    size_t escritos = wifiClientSecure.write(datos, largo);
+    if (escritos == largo) return true;
+    if (escritos > 0) wifiClientSecure.stop();
+    return false;
+  }
+};
+
+ClienteObservado clienteObservado(wifiClientSecure);
+SalidaTLS salidaBandeja;
+PubSubClient awsClient(clienteObservado);
+const uint16_t TAMANO_MENSAJE_MQTT = 320;       // JSON + "seq" ya no entra en los 256 por defecto
+const uint16_t TAMANO_MENSAJE_LOTE = 768;
+const uint16_t TAMANO_MENSAJE_DIAGNOSTICO = 512;  // contadores de GPS, heap y versiones en flash
+const uint16_t TAMANO_BUFFER_PUBSUBCLIENT = 1024;
+
+// ====== Cola persistente (store-and-forward) ======
+enum TopicoCola {
+  COLA_TOPICO_PEDIDOS = 0,
+  COLA_TOPICO_UBICACION = 1,
+  COLA_TOPICO_EVENTOS = 2
+};
+const ConfigCola CONFIG_COLA = {
+  8192,                       // bytes por segmento
+  32,                         // segmentos (256 KB de flash como máximo)
+  DESCARTAR_BAJA_PRIORIDAD,   // al llenarse se pierde primero la ubicación, no el mapeo
+  5,                          // mensajes/seg al drenar
+  10,                         // ráfaga máxima
+  32                          // envíos entre escrituras del cursor
+};
+const unsigned long PERIODO_TAREA_COLA = 200;
+const unsigned long INTERVALO_SINCRONIZAR_COLA = 30000;
+AlmacenLittleFS almacenCola(LittleFS);
+ColaPersistente colaEnvio(almacenCola, CONFIG_COLA);
+bool colaDisponible = false;
+unsigned long ultimaSincronizacionCola = 0;
+
+// ====== Mensajes armados en su lugar ======
+// Los QoS 1 se codifican directo en el lugar que ocupan en la bandeja
+// (armarMensaje): de ahí se envían y se reenvían sin copiarlos. Solo los
+// que van a la cola (sin conexión, con pendientes en flash o sin lugar
+// seguido en la bandeja) se codifican en bufferSalida. Los QoS 0 se
+// codifican en bufferQoS0 detrás del lugar de la cabecera y salen con un
+// solo write() por salidaBandeja: publish() de PubSubClient los copiaba a
+// su buffer, y beginPublish() + write() serían dos registros TLS por
+// mensaje (BearSSL cierra uno en cada write()).
+const TopicoMQTT TOPICO_MQTT_PEDIDOS = topicoMQTT(TOPICO_PEDIDOS);
+const TopicoMQTT TOPICO_MQTT_UBICACION = topicoMQTT(TOPICO_UBICACION);
+const TopicoMQTT TOPICO_MQTT_INFO = topicoMQTT(TOPICO_INFO);
+const TopicoMQTT TOPICO_MQTT_PERFIL = topicoMQTT(AWS_TOPIC_INFO);  // el perfil va siempre en JSON
+const TopicoMQTT TOPICO_MQTT_CONTROL_RESPUESTA = topicoMQTT(AWS_TOPIC_CONTROL_RESPUESTA);
+#if LOGIOT_GEOCERCAS
+const TopicoMQTT TOPICO_MQTT_EVENTOS = topicoMQTT(AWS_TOPIC_EVENTOS);
+const TopicoMQTT TOPICO_MQTT_GEOCERCAS_RESPUESTA = topicoMQTT(AWS_TOPIC_GEOCERCAS_RESPUESTA);
+#endif
+#if LOGIOT_CALLES_CONOCIDAS
+const TopicoMQTT TOPICO_MQTT_CALLES_RESPUESTA = topicoMQTT(AWS_TOPIC_CALLES_RESPUESTA);
+#endif
+const uint16_t RESERVA_CABECERA_QOS0 = 64;  // el tópico QoS 0 más largo tiene 46 bytes
+uint8_t bufferSalida[TAMANO_MENSAJE_LOTE];
+uint8_t bufferQoS0[RESERVA_CABECERA_QOS0 + TAMANO_MENSAJE_DIAGNOSTICO];
+
+struct MensajeEnArmado {
+  uint8_t idTopico;
+  uint8_t* datos;
+  size_t capacidad;
+  bool enBandeja;  // si no, está en bufferSalida
+  uint32_t inicioCiclos;
+};
+
+// ====== Lotes de puntos ======
+const ConfigLote CONFIG_LOTE_MAPEO = {30, 60000};      // 30 fixes o 60 s
+const ConfigLote CONFIG_LOTE_UBICACION = {12, 60000};  // 12 muestras (una por INTERVALO_ENVIO_UBICACION) o 60 s
+LoteTrayecto loteMapeo(CONFIG_LOTE_MAPEO);
+LoteTrayecto loteUbicacion(CONFIG_LOTE_UBICACION);
+
+// ====== Parámetros remotos ======
+// Se cambian con un comando en AWS_TOPIC_CONTROL o AWS_TOPIC_CONTROL_FLOTA,
+// se aplican entre dos pasadas del planificador y quedan en flash. Los
+// valores por defecto son las constantes de arriba.
+enum IndiceParametro : uint8_t {
+  PARAM_INTERVALO_UBICACION,
+  PARAM_INTERVALO_DIAGNOSTICO,
+  PARAM_COLA_MENSAJES_SEG,
+  PARAM_COLA_RAFAGA,
+  PARAM_VENTANA_MQTT,
+#if LOGIOT_BANDA_MUERTA
+  PARAM_BANDA_ERROR_M,
+#endif
+#if LOGIOT_GEOCERCAS
+  PARAM_INTERVALO_UBICACION_ZONA,
+#endif
+  CANTIDAD_PARAMETROS
+};
+const DefinicionParametro DEFINICION_PARAMETROS[CANTIDAD_PARAMETROS] = {
+  {"intervalo_ubicacion_ms", 1000, 600000, INTERVALO_ENVIO_UBICACION},
+  {"intervalo_diagnostico_ms", 5000, PLANIFICADOR_RETARDO_MAXIMO_MS, INTERVALO_ENVIO_DIAGNOSTICO},
+  {"cola_mensajes_seg", 1, 50, CONFIG_COLA.mensajesPorSegundo},
+  {"cola_rafaga", 1, 100, CONFIG_COLA.rafaga},
+  {"ventana_mqtt", 1, BANDEJA_MAX_VENTANA, CONFIG_BANDEJA.ventana},
+#if LOGIOT_BANDA_MUERTA
+  {"banda_error_m", 5, 500, (uint32_t)CONFIG_BANDA_MUERTA.errorMaximoM},
+#endif
+#if LOGIOT_GEOCERCAS
+  {"intervalo_ubicacion_zona_ms", 5000, 3600000, INTERVALO_UBICACION_EN_ZONA},
+#endif
+};
+ParametrosRemotos parametros(DEFINICION_PARAMETROS, CANTIDAD_PARAMETROS);
+const char* ARCHIVO_PARAMETROS = "/parametros.bin";
+// Resultado del último comando; se responde desde el loop, no desde el callback
+bool respuestaComandoPendiente = false;
+uint32_t idUltimoComando = 0;
+ResultadoComando resultadoUltimoComando = COMANDO_ACEPTADO;
+int8_t parametroRechazado = -1;
+int idTareaPublicarGPS = -1;
+int idTareaDiagnostico = -1;
+
+// Costo de codificar los mensajes (se reporta junto con los tiempos de tareas)
+struct MedicionCodificacion {
+  uint32_t mensajes;
+  uint32_t bytes;
+  uint32_t totalUs;
+  uint32_t peorUs;
+};
+MedicionCodificacion medicionCodificacion = {0, 0, 0, 0};
+
+// De armarMensaje() al mensaje en la bandeja o en la cola, con la
+// codificación: ciclos de CPU y bytes del mensaje copiados después de
+// codificarlo (0 si se armó en su lugar)
+struct MedicionEntrega {
+  uint32_t mensajes;
+  uint32_t copiados;
+  uint32_t totalCiclos;
+  uint32_t peorCiclos;
+};
+MedicionEntrega medicionEntrega = {0, 0, 0, 0};
+
+// ====== Perfil de fases del loop ======
+#if LOGIOT_PERFIL
+enum FasePerfil {
+  FASE_MQTT_LOOP,     // awsClient.loop()
+  FASE_NMEA,          // gps.encode() de una sentencia aceptada
+  FASE_PROCESAR_GPS,  // procesadorGPS.procesar()
+  FASE_CODIFICAR,     // JSON o trama binaria (medido con micros())
+  FASE_PUBLICAR,      // bandejaMQTT.enviar()
+  FASE_BOTONES,       // manejarBotones()
+  FASE_PANTALLA,      // actualizarPantalla() en RAM
+  FASE_VOLCADO_LCD,   // I2C del framebuffer
+  CANTIDAD_FASES
+};
+const char* const NOMBRES_FASES[CANTIDAD_FASES] = {"mqtt_loop", "nmea", "procesar_gps", "codificar",
+                                                   "publicar", "botones", "pantalla", "volcado_lcd"};
+HistogramaLatencia histogramasFases[CANTIDAD_FASES];   // ciclos de CPU
+HistogramaLatencia histogramaLatenciaFix;              // ms desde el fix hasta el publish
+// Llegada de la última RMC/GGA: el instante en que TinyGPSPlus tiene el fix
+uint32_t instanteSentenciaGps = 0;
+// Fix que describe el mensaje en armado; 0 si no lleva posición
+uint32_t instanteFixMensaje = 0;
+
+#define PERFIL_INICIO(fase) uint32_t inicioPerfil_##fase = ESP.getCycleCount()
+#define PERFIL_FIN(fase) histogramasFases[fase].registrar(ESP.getCycleCount() - inicioPerfil_##fase)
+#define PERFIL_FIX_MENSAJE(instante) (instanteFixMensaje = (instante))
+#else
+#define PERFIL_INICIO(fase)
+#define PERFIL_FIN(fase)
+#define PERFIL_FIX_MENSAJE(instante)
+#endif
 
 // Comentado - Clientes del broker anterior
 // WebSocketsClient clienteWs;
@@ -213,52 +683,118 @@ PubSubClient awsClient(wifiClientSecure);
 void conectarAWiFi();
 void configurarTiempo();
 void configurarAWS();
-void conectarAWSIoT();
-void reconectarMQTT();
+void iniciarConexionMQTT(uint32_t ahora);
+void conectarTLS();
+void conectarMQTT();
+void fallarConexionMQTT(const char* paso);
+void registrarHandshake(MedicionHandshake& m, uint32_t duracionMs);
+void reportarConexion();
+void reportarBandeja();
+void confirmacionMQTT(uint32_t seq);
 void callbackMQTT(char* topic, byte* payload, unsigned int length);
+void cargarParametros();
+void guardarParametros();
+void aplicarParametros();
+void usarParametros(uint32_t cambiados);
+void responderComando();
 void manejarBotones();
-void procesarDatosGPS();
-void enviarPuntoAMQTT(PuntoGPS p, const String& topico);
+void enviarPuntoAMQTT(const PuntoGPS& p, uint8_t idTopico);
 void enviarInicioMapeoMQTT();
 void enviarFinMapeoMQTT();
-PuntoGPS obtenerPuntoPromedio();
-double calcularDistanciaHaversine(PuntoGPS p1, PuntoGPS p2);
-double normalizarAngulo(double angulo);
+void publicarVertice(const VerticeTrayecto& v);
+void enviarGeometriaCalle();
 void mostrarMenu();
 void actualizarPantalla();
 void mostrarDashboard();
 void mostrarPantallaMapeo();
 void publicarGPS();
+#if LOGIOT_BANDA_MUERTA
+bool ubicacionParaReportar();
+void reportarBandaMuerta();
+#endif
+#if LOGIOT_GEOCERCAS
+void iniciarGeocercas();
+void avisoGeocerca(EventoGeocerca evento, uint32_t idZona, uint32_t duracionMs);
+void responderGeocercas();
+void reportarGeocercas();
+uint32_t tareaGeocercas(uint32_t ahora);
+#endif
+#if LOGIOT_CALLES_CONOCIDAS
+void iniciarCalles();
+void emparejarFix();
+void responderCalles();
+void reportarCalles();
+uint32_t tareaCalles(uint32_t ahora);
+#endif
+#if LOGIOT_RESUMEN_VIAJE
+void enviarResumenMQTT(bool viaje, bool final);
+void agregarResumenJSON(JsonObject destino, const Resumen& r);
+#endif
 void publicarDiagnostico();
 void mostrarConfirmarReinicio();
 void iniciarMapeo();
 void detenerMapeo();
+void iniciarCola();
+MensajeEnArmado armarMensaje(uint8_t idTopico, size_t capacidad);
+void publicarMensaje(const MensajeEnArmado& mensaje, bool prioritario, uint32_t seq, size_t largo, const char* descripcion);
+char* mensajeQoS0();
+bool publicarQoS0(const TopicoMQTT& topico, size_t largo);
+void registrarCodificacion(uint32_t duracionUs, size_t largo);
+void registrarEntrega(const MensajeEnArmado& mensaje, uint32_t copiados);
+void enviarLoteMQTT(LoteTrayecto& lote, uint8_t idTopico, bool prioritario, const char* descripcion);
+TramaMapeo tramaDesdePunto(const PuntoGPS& p, uint32_t seq);
+const TopicoMQTT& topicoDeCola(uint8_t idTopico);
+bool enviarDesdeCola(uint8_t idTopico, uint32_t seq, const uint8_t* datos, size_t largo);
+void mostrarMensajeTemporal(unsigned long duracion);
+void registrarTareas();
+void reportarTiemposTareas();
+void reportarTarea(const char* nombre, const Tarea& t);
+void reportarHeap();
+void reportarPantalla();
+#if LOGIOT_PERFIL
+void reportarPerfil();
+void publicarPerfil();
+#endif
+uint32_t tareaIngestaGPS(uint32_t ahora);
+uint32_t tareaFixGPS(uint32_t ahora);
+uint32_t tareaPublicarGPS(uint32_t ahora);
+uint32_t tareaDiagnostico(uint32_t ahora);
+uint32_t tareaConexion(uint32_t ahora);
+uint32_t tareaMQTTLoop(uint32_t ahora);
+uint32_t tareaBotones(uint32_t ahora);
+uint32_t tareaPantalla(uint32_t ahora);
+uint32_t tareaReporteTiempos(uint32_t ahora);
+uint32_t tareaCola(uint32_t ahora);
 
 // ===================================
 // === SETUP ===
 // ===================================
 void setup() {
   Serial.begin(115200);
-  gpsSerial.begin(GPS_BAUD);
+  gpsSerial.begin(GPS_BAUD, SWSERIAL_8N1, GPS_RX, GPS_TX, false, GPS_BUFFER_UART);
 
   Wire.begin();
   lcd.init();
   lcd.backlight();
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Iniciando...");
+  pantalla.limpiar();
+  pantalla.cursor(0, 0);
+  pantalla.escribir("Iniciando...");
+  pantalla.volcar(salidaLCD, 0);
 
   pinMode(PIN_BOTON_SELECCION, INPUT_PULLUP);
   pinMode(PIN_BOTON_DESPLAZAR, INPUT_PULLUP);
 
-  for (int i = 0; i < TAMANO_BUFFER_GPS; i++) {
-    bufferGPS[i] = {0.0, 0.0, 0.0, 0.0, 0, 0};
-  }
-
-  conectarAWiFi();
-  configurarTiempo();
+  // WiFi, NTP y AWS IoT se conectan desde tareaConexion sin bloquear el loop
+  iniciarCola();
+#if LOGIOT_GEOCERCAS
+  iniciarGeocercas();
+#endif
+#if LOGIOT_CALLES_CONOCIDAS
+  iniciarCalles();
+#endif
+  cargarParametros();
   configurarAWS();
-  conectarAWSIoT();
+  registrarTareas();
 
   // Comentado - Configuración del broker anterior
   /*
@@ -279,228 +815,835 @@ void setup() {
 // === LOOP ===
 // ===================================
 void loop() {
-  // Cambio: usar awsClient en lugar de clienteMQTT
-  awsClient.loop();
+  planificador.ejecutar();
+  // Entre dos pasadas ninguna tarea quedó a mitad de un paso
+  aplicarParametros();
+  yield();
+}
 
-  while (gpsSerial.available() > 0) {
-    gps.encode(gpsSerial.read());
+// ===================================
+// === TAREAS DEL PLANIFICADOR ===
+// ===================================
+void registrarTareas() {
+  planificador.fijarPrioritaria(tareaIngestaGPS, PRESUPUESTO_INGESTA_GPS_US);
+  planificador.agregar("conexion", tareaConexion, 0, PRESUPUESTO_TAREA_US);
+  planificador.agregar("mqtt_loop", tareaMQTTLoop, PERIODO_TAREA_MQTT_LOOP, PRESUPUESTO_TAREA_US);
+  planificador.agregar("fix_gps", tareaFixGPS, PERIODO_TAREA_FIX_GPS, PRESUPUESTO_TAREA_US);
+#if LOGIOT_BANDA_MUERTA
+  idTareaPublicarGPS = planificador.agregar("publicar_gps", tareaPublicarGPS, INTERVALO_EVALUACION_UBICACION, PRESUPUESTO_TAREA_US);
+#else
+  idTareaPublicarGPS = planificador.agregar("publicar_gps", tareaPublicarGPS, parametros.valor(PARAM_INTERVALO_UBICACION), PRESUPUESTO_TAREA_US);
+#endif
+  planificador.agregar("cola", tareaCola, PERIODO_TAREA_COLA, PRESUPUESTO_TAREA_US);
+#if LOGIOT_GEOCERCAS
+  planificador.agregar("geocercas", tareaGeocercas, PERIODO_TAREA_GEOCERCAS, PRESUPUESTO_TAREA_US);
+#endif
+#if LOGIOT_CALLES_CONOCIDAS
+  planificador.agregar("calles", tareaCalles, PERIODO_TAREA_CALLES, PRESUPUESTO_TAREA_US);
+#endif
+  idTareaDiagnostico = planificador.agregar("diagnostico", tareaDiagnostico, parametros.valor(PARAM_INTERVALO_DIAGNOSTICO), PRESUPUESTO_TAREA_US);
+  planificador.agregar("botones", tareaBotones, PERIODO_TAREA_BOTONES, PRESUPUESTO_TAREA_US);
+  planificador.agregar("pantalla", tareaPantalla, INTERVALO_ACTUALIZACION_PANTALLA, PRESUPUESTO_TAREA_US);
+  planificador.agregar("reporte", tareaReporteTiempos, INTERVALO_REPORTE_TAREAS, 0);
+}
+
+// Drena el UART del GPS hasta agotar el presupuesto. Corre entre cada tarea.
+uint32_t tareaIngestaGPS(uint32_t ahora) {
+  if (gpsSerial.overflow()) {
+    filtroNMEA.registrarDesborde();
   }
-  
-  if (estadoActual == ESTADO_MAPEO_ACTIVO) {
-    if (gps.location.isValid() && gps.location.isUpdated() && gps.satellites.value() >= 3) {
-      tieneFixGPS = true;
-      PuntoGPS nuevoPunto;
-      nuevoPunto.lat = gps.location.lat();
-      nuevoPunto.lon = gps.location.lng();
-      nuevoPunto.rumbo = gps.course.deg();
-      nuevoPunto.velocidad = gps.speed.kmph();
-      nuevoPunto.satelites = gps.satellites.value();
-      nuevoPunto.tiempo = gps.time.value();
-      bufferGPS[indiceBuffer] = nuevoPunto;
-      indiceBuffer = (indiceBuffer + 1) % TAMANO_BUFFER_GPS;
-      if (indiceBuffer == 0) {
-        bufferLleno = true;
+  int leidos = 0;
+  while (gpsSerial.available() > 0 && leidos < MAX_BYTES_GPS_POR_PASO) {
+    if (filtroNMEA.procesar(gpsSerial.read())) {
+      const char* sentencia = filtroNMEA.sentencia();
+      PERFIL_INICIO(FASE_NMEA);
+      for (uint8_t i = 0; i < filtroNMEA.largo(); i++) {
+        gps.encode(sentencia[i]);
       }
-      if (bufferLleno) {
-        procesarDatosGPS();
+      PERFIL_FIN(FASE_NMEA);
+#if LOGIOT_PERFIL
+      if (filtroNMEA.tipo() == NMEA_RMC || filtroNMEA.tipo() == NMEA_GGA) {
+        instanteSentenciaGps = millis();
       }
-    } else {
-      tieneFixGPS = false;
-      Serial.printf("⚠ GPS sin fix (satélites=%d)\n", gps.satellites.value());
+#endif
+    }
+    leidos++;
+    if ((leidos & 0x0F) == 0 && planificador.presupuestoAgotado()) {
+      break;
     }
   }
+  return 0;
+}
 
-  if (millis() - ultimoDiagnosticoEnviado >= INTERVALO_ENVIO_DIAGNOSTICO) {
-    publicarDiagnostico();
-    ultimoDiagnosticoEnviado = millis();
+uint32_t tareaFixGPS(uint32_t ahora) {
+  // Leer la posición borra isUpdated(): se mira una sola vez por pasada
+  bool fixNuevo = gps.location.isValid() && gps.location.isUpdated() && gps.satellites.value() >= 3;
+#if LOGIOT_GEOCERCAS
+  // Esté o no mapeando, una vez por fix nuevo
+  if (fixNuevo && !geocercas.compilando()) {
+    uint32_t instanteFix = millis() - gps.location.age();
+    geocercas.evaluar(gradosAE6(gps.location.lat()), gradosAE6(gps.location.lng()), instanteFix, avisoGeocerca);
+  }
+#endif
+  if (estadoActual != ESTADO_MAPEO_ACTIVO) {
+    return PERIODO_TAREA_FIX_GPS;
+  }
+#if LOGIOT_RESUMEN_VIAJE
+  if (ahora - ultimoResumenViaje >= INTERVALO_RESUMEN_VIAJE) {
+    enviarResumenMQTT(true, false);
   }
+#endif
+  if (fixNuevo) {
+    tieneFixGPS = true;
+    MuestraGPS nuevaMuestra;
+    nuevaMuestra.lat = gps.location.lat();
+    nuevaMuestra.lon = gps.location.lng();
+    nuevaMuestra.rumbo = gps.course.deg();
+    nuevaMuestra.velocidad = gps.speed.kmph();
+    nuevaMuestra.satelites = gps.satellites.value();
+    nuevaMuestra.tiempoGps = gps.time.value();
+    nuevaMuestra.tiempoMs = millis();
+    ResultadoFix resultado = procesadorGPS.agregarFix(nuevaMuestra, gps.hdop.hdop());
+    if (resultado == FIX_SALTO) {
+      Serial.printf("⚠ Fix descartado por salto (total=%lu)\n", (unsigned long)ventanaGPS.rechazadas());
+    } else {
+      if (resultado == FIX_FILTRO_FUERA) {
+        Serial.printf("⚠ Fix descartado por el filtro (total=%lu)\n", (unsigned long)filtroGPS.descartadas());
+      }
+#if LOGIOT_RESUMEN_VIAJE
+      resumenViaje.agregar(nuevaMuestra);
+#endif
+      PERFIL_INICIO(FASE_PROCESAR_GPS);
+      procesadorGPS.procesar(millis());
+      PERFIL_FIN(FASE_PROCESAR_GPS);
+#if LOGIOT_CALLES_CONOCIDAS
+      emparejarFix();
+#endif
+    }
+  } else if (!gps.location.isValid() || gps.satellites.value() < 3) {
+    if (tieneFixGPS) {
+      Serial.printf("⚠ GPS sin fix (satélites=%d)\n", gps.satellites.value());
+    }
+    tieneFixGPS = false;
+  }
+  return PERIODO_TAREA_FIX_GPS;
+}
 
-  if (estadoActual == ESTADO_MAPEO_ACTIVO && (millis() - ultimoPuntoUbicacionEnviado >= INTERVALO_ENVIO_UBICACION)) {
+uint32_t tareaPublicarGPS(uint32_t ahora) {
+  if (estadoActual == ESTADO_MAPEO_ACTIVO) {
     publicarGPS();
     ultimoPuntoUbicacionEnviado = millis();
   }
+#if LOGIOT_LOTES
+  // Cota de latencia: ningún punto espera más que la configurada
+  if (loteMapeo.vencido(ahora)) {
+    enviarLoteMQTT(loteMapeo, COLA_TOPICO_PEDIDOS, true, "lote mapeo");
+  }
+  if (loteUbicacion.vencido(ahora)) {
+    enviarLoteMQTT(loteUbicacion, COLA_TOPICO_UBICACION, false, "lote ubicación");
+  }
+#endif
+#if LOGIOT_BANDA_MUERTA
+  return INTERVALO_EVALUACION_UBICACION;
+#else
+  return parametros.valor(PARAM_INTERVALO_UBICACION);
+#endif
+}
+
+uint32_t tareaDiagnostico(uint32_t ahora) {
+  publicarDiagnostico();
+  ultimoDiagnosticoEnviado = millis();
+  return parametros.valor(PARAM_INTERVALO_DIAGNOSTICO);
+}
+
+// Máquina de estados de la conexión: WiFi -> NTP -> AWS IoT
+uint32_t tareaConexion(uint32_t ahora) {
+  if (estadoConexion > CONEXION_ESPERANDO_WIFI && WiFi.status() != WL_CONNECTED) {
+    Serial.println("⚠ WiFi perdido, esperando reconexión");
+    wifiClientSecure.stop();
+    inicioEsperaWiFi = ahora;
+    estadoConexion = CONEXION_ESPERANDO_WIFI;
+    return 500;
+  }
+
+  switch (estadoConexion) {
+    case CONEXION_INICIAL:
+      conectarAWiFi();
+      inicioEsperaWiFi = ahora;
+      estadoConexion = CONEXION_ESPERANDO_WIFI;
+      return 500;
+
+    case CONEXION_ESPERANDO_WIFI:
+      if (WiFi.status() != WL_CONNECTED) {
+        Serial.print(".");
+        return 500;
+      }
+      Serial.printf("\n✔ WiFi conectado en %lu ms, IP: %s\n", ahora - inicioEsperaWiFi, WiFi.localIP().toString().c_str());
+      pantalla.limpiar();
+      pantalla.cursor(0, 0);
+      pantalla.escribir("WiFi: OK");
+      pantalla.cursor(0, 1);
+      {
+        IPAddress ip = WiFi.localIP();
+        char textoIp[16];
+        snprintf(textoIp, sizeof(textoIp), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+        pantalla.escribir(textoIp);
+      }
+      mostrarMensajeTemporal(2000);
+      configurarTiempo();
+      estadoConexion = CONEXION_WIFI_OK;
+      proximoIntentoMQTT = ahora;
+      return 0;
+
+    case CONEXION_WIFI_OK:
+      if ((long)(ahora - proximoIntentoMQTT) < 0) {
+        return PERIODO_TAREA_CONEXION;
+      }
+      iniciarConexionMQTT(ahora);
+      return 0;
 
-  if (millis() - ultimoIntentoMQTT >= INTERVALO_RECONEXION_MQTT) {
-    reconectarMQTT();
-    ultimoIntentoMQTT = millis();
+    case CONEXION_DNS:
+      if (resultadoDNS == DNS_RESUELTO) {
+        estadoConexion = CONEXION_TLS;
+        return 0;
+      }
+      if (resultadoDNS == DNS_FALLIDO || ahora - inicioPasoConexion >= TIMEOUT_DNS_MS) {
+        fallarConexionMQTT("DNS");
+        return PERIODO_TAREA_CONEXION;
+      }
+      return PERIODO_TAREA_DNS;
+
+    // Cada paso bloquea solo lo suyo; entre uno y otro corren las demás tareas
+    case CONEXION_TLS:
+      conectarTLS();
+      return 0;
+
+    case CONEXION_MQTT:
+      conectarMQTT();
+      return PERIODO_TAREA_CONEXION;
+
+    case CONEXION_AWS_OK:
+      if (!awsClient.connected()) {
+        // El primer reintento sale enseguida: con la sesión TLS es barato
+        Serial.printf("⚠ AWS IoT desconectado (state=%d)\n", awsClient.state());
+        proximoIntentoMQTT = ahora;
+        estadoConexion = CONEXION_WIFI_OK;
+      }
+      return PERIODO_TAREA_CONEXION;
   }
+  return PERIODO_TAREA_CONEXION;
+}
 
+// Drena la cola a ritmo controlado y baja a flash lo acumulado en RAM
+uint32_t tareaCola(uint32_t ahora) {
+  if (!colaDisponible) {
+    return PERIODO_TAREA_COLA;
+  }
+  // Lo que ya está en flash espera mientras la bandeja esté cargada
+  if (awsClient.connected() && !colaEnvio.vacia() && !bandejaMQTT.saturada()) {
+    uint16_t enviados = colaEnvio.drenar(ahora, enviarDesdeCola);
+    if (enviados > 0) {
+      Serial.printf("📤 Cola: %u pasados a la bandeja, %lu pendientes\n", enviados, (unsigned long)colaEnvio.cantidadPendientes());
+    }
+  }
+  if (ahora - ultimaSincronizacionCola >= INTERVALO_SINCRONIZAR_COLA) {
+    colaEnvio.sincronizar();
+    ultimaSincronizacionCola = ahora;
+  }
+  return PERIODO_TAREA_COLA;
+}
+
+#if LOGIOT_GEOCERCAS
+// Arma de a pasos el índice de una carga recién llegada y responde; los
+// fixes se evalúan desde tareaFixGPS, uno por fix nuevo
+uint32_t tareaGeocercas(uint32_t ahora) {
+  if (geocercas.compilando()) {
+    ResultadoCarga r = geocercas.avanzarCompilacion(ZONAS_POR_PASO_GEOCERCAS);
+    if (r == CARGA_EN_CURSO) {
+      return PERIODO_COMPILACION_GEOCERCAS;
+    }
+    resultadoGeocercas = r;
+    respuestaGeocercasPendiente = true;
+    if (r == CARGA_COMPLETA) {
+      Serial.printf("✔ Geocercas v%lu en uso: %lu zonas\n", (unsigned long)geocercas.version(),
+                    (unsigned long)geocercas.zonas());
+    } else {
+      Serial.printf("⚠ Geocercas v%lu: no se pudo armar el índice (%s)\n",
+                    (unsigned long)geocercas.versionCargando(), Geocercas::descripcion(r));
+    }
+  }
+  if (respuestaGeocercasPendiente) {
+    responderGeocercas();
+  }
+  return PERIODO_TAREA_GEOCERCAS;
+}
+#endif
+
+#if LOGIOT_CALLES_CONOCIDAS
+// Solo arma el índice de una carga recién llegada y responde; los fixes se
+// emparejan desde tareaFixGPS, mientras se mapea
+uint32_t tareaCalles(uint32_t ahora) {
+  if (grafoCalles.compilando()) {
+    ResultadoCarga r = grafoCalles.avanzarCompilacion(TRAMOS_POR_PASO_CALLES);
+    if (r == CARGA_EN_CURSO) {
+      return PERIODO_COMPILACION_CALLES;
+    }
+    resultadoCalles = r;
+    respuestaCallesPendiente = true;
+    if (r == CARGA_COMPLETA) {
+      Serial.printf("✔ Calles v%lu en uso: %lu tramos\n", (unsigned long)grafoCalles.version(),
+                    (unsigned long)grafoCalles.tramos());
+    } else {
+      Serial.printf("⚠ Calles v%lu: no se pudo armar el índice (%s)\n",
+                    (unsigned long)grafoCalles.versionCargando(), Geocercas::descripcion(r));
+    }
+  }
+  if (respuestaCallesPendiente) {
+    responderCalles();
+  }
+  return PERIODO_TAREA_CALLES;
+}
+#endif
+
+uint32_t tareaMQTTLoop(uint32_t ahora) {
+  PERFIL_INICIO(FASE_MQTT_LOOP);
+  awsClient.loop();
+  PERFIL_FIN(FASE_MQTT_LOOP);
+  // Después de loop(): los PUBACK recién leídos ya liberaron la ventana
+  if (awsClient.connected() && !bandejaMQTT.vacia()) {
+    PERFIL_INICIO(FASE_PUBLICAR);
+    bandejaMQTT.enviar(salidaBandeja, ahora);
+    PERFIL_FIN(FASE_PUBLICAR);
+  }
+  return PERIODO_TAREA_MQTT_LOOP;
+}
+
+uint32_t tareaBotones(uint32_t ahora) {
+  PERFIL_INICIO(FASE_BOTONES);
   manejarBotones();
+  PERFIL_FIN(FASE_BOTONES);
+  return PERIODO_TAREA_BOTONES;
+}
 
-  if (millis() - tiempoUltimaActualizacionPantalla >= INTERVALO_ACTUALIZACION_PANTALLA) {
+uint32_t tareaPantalla(uint32_t ahora) {
+  // Redibuja en RAM cada INTERVALO_ACTUALIZACION_PANTALLA, salvo mientras
+  // dure un mensaje temporal, y vuelca al LCD de a poco lo que cambió
+  if ((long)(pantallaOcupadaHasta - ahora) <= 0 &&
+      ahora - tiempoUltimaActualizacionPantalla >= INTERVALO_ACTUALIZACION_PANTALLA) {
+    PERFIL_INICIO(FASE_PANTALLA);
     actualizarPantalla();
-    tiempoUltimaActualizacionPantalla = millis();
+    PERFIL_FIN(FASE_PANTALLA);
+    tiempoUltimaActualizacionPantalla = ahora;
   }
+  PERFIL_INICIO(FASE_VOLCADO_LCD);
+  pantalla.volcar(salidaLCD, PRESUPUESTO_I2C_LCD_POR_PASO);
+  PERFIL_FIN(FASE_VOLCADO_LCD);
+  return PERIODO_VOLCADO_LCD;
+}
 
-  yield();
-  delay(10);
+uint32_t tareaReporteTiempos(uint32_t ahora) {
+  reportarTiemposTareas();
+  return INTERVALO_REPORTE_TAREAS;
+}
+
+// Peor tiempo de ejecución de cada tarea desde el último reporte
+void reportarTarea(const char* nombre, const Tarea& t) {
+  Serial.printf("%-14s peor=%6lu ultimo=%6lu ejec=%lu excesos=%lu", nombre,
+                (unsigned long)t.peorUs, (unsigned long)t.ultimoUs, (unsigned long)t.ejecuciones, (unsigned long)t.excesos);
+  if (rastreoHeapActivo()) {
+    Serial.printf(" asig=%lu", (unsigned long)t.asignaciones);
+  }
+  Serial.println();
+}
+
+void reportarTiemposTareas() {
+  Serial.println("=== Tiempos de tareas (us) ===");
+  reportarTarea("ingesta_gps", planificador.prioritaria());
+  for (uint8_t i = 0; i < planificador.cantidad(); i++) {
+    reportarTarea(planificador.tarea(i).nombre, planificador.tarea(i));
+  }
+  planificador.reiniciarEstadisticas();
+  reportarHeap();
+  reportarPantalla();
+  reportarConexion();
+  reportarBandeja();
+#if LOGIOT_BANDA_MUERTA
+  reportarBandaMuerta();
+#endif
+#if LOGIOT_GEOCERCAS
+  reportarGeocercas();
+#endif
+#if LOGIOT_CALLES_CONOCIDAS
+  reportarCalles();
+#endif
+#if LOGIOT_PERFIL
+  reportarPerfil();
+#endif
+
+  if (medicionCodificacion.mensajes > 0) {
+    Serial.printf("Codificación %s: %lu msgs, %lu bytes/msg, %lu us/msg, peor=%lu us\n",
+                  LOGIOT_FORMATO_BINARIO ? "binaria" : "JSON",
+                  (unsigned long)medicionCodificacion.mensajes,
+                  (unsigned long)(medicionCodificacion.bytes / medicionCodificacion.mensajes),
+                  (unsigned long)(medicionCodificacion.totalUs / medicionCodificacion.mensajes),
+                  (unsigned long)medicionCodificacion.peorUs);
+    medicionCodificacion = {0, 0, 0, 0};
+  }
+  if (medicionEntrega.mensajes > 0) {
+    uint32_t ciclosPorUs = ESP.getCpuFreqMHz();
+    Serial.printf("Entrega a bandeja/cola: %lu msgs, %lu bytes copiados/msg, %lu us/msg (%lu ciclos), peor=%lu us\n",
+                  (unsigned long)medicionEntrega.mensajes,
+                  (unsigned long)(medicionEntrega.copiados / medicionEntrega.mensajes),
+                  (unsigned long)(medicionEntrega.totalCiclos / medicionEntrega.mensajes / ciclosPorUs),
+                  (unsigned long)(medicionEntrega.totalCiclos / medicionEntrega.mensajes),
+                  (unsigned long)(medicionEntrega.peorCiclos / ciclosPorUs));
+    medicionEntrega = {0, 0, 0, 0};
+  }
+}
+
+// Libre, bloque más grande y fragmentación; con LOGIOT_SIN_HEAP además las
+// asignaciones desde el reporte anterior
+void reportarHeap() {
+  static EstadisticasHeap anterior = {0, 0, 0, 0};
+  Serial.printf("💾 Heap: libre=%lu bloque_max=%lu frag=%u%%\n", (unsigned long)ESP.getFreeHeap(),
+                (unsigned long)ESP.getMaxFreeBlockSize(), (unsigned)ESP.getHeapFragmentation());
+  if (!rastreoHeapActivo()) return;
+  EstadisticasHeap e = estadisticasHeap();
+  Serial.printf("💾 Asignaciones: %lu (%lu bytes), liberaciones: %lu, fallidas: %lu\n",
+                (unsigned long)(e.asignaciones - anterior.asignaciones), (unsigned long)(e.bytes - anterior.bytes),
+                (unsigned long)(e.liberaciones - anterior.liberaciones), (unsigned long)(e.fallidas - anterior.fallidas));
+  anterior = e;
+}
+
+// Bytes I2C por segundo que mandó el framebuffer y los que habría mandado
+// dibujando directo en el display
+void reportarPantalla() {
+  static unsigned long ultimoReporte = 0;
+  unsigned long ahora = millis();
+  unsigned long segundos = (ahora - ultimoReporte) / 1000;
+  ultimoReporte = ahora;
+  if (segundos == 0) return;
+  const EstadisticasMarcoLCD& e = pantalla.estadisticas();
+  Serial.printf("🖥 LCD: %lu bytes I2C/s (sin framebuffer: %lu bytes/s), %lu cuadros, %lu caracteres, %lu cursores\n",
+                (unsigned long)(e.bytes / segundos), (unsigned long)(e.bytesSinMarco / segundos),
+                (unsigned long)e.cuadros, (unsigned long)e.caracteres, (unsigned long)e.cursores);
+  pantalla.reiniciarEstadisticas();
+}
+
+// Handshakes completos contra reanudados desde el arranque
+void reportarConexion() {
+  if (intentosMQTT == 0) return;
+  Serial.printf("🔐 AWS IoT: %lu intentos, %lu fallidos | TLS completo: %lu, media=%lu peor=%lu ms | reanudado: %lu, media=%lu peor=%lu ms\n",
+                (unsigned long)intentosMQTT, (unsigned long)fallosMQTT, (unsigned long)handshakeCompleto.cantidad,
+                (unsigned long)(handshakeCompleto.cantidad ? handshakeCompleto.totalMs / handshakeCompleto.cantidad : 0),
+                (unsigned long)handshakeCompleto.peorMs, (unsigned long)handshakeReanudado.cantidad,
+                (unsigned long)(handshakeReanudado.cantidad ? handshakeReanudado.totalMs / handshakeReanudado.cantidad : 0),
+                (unsigned long)handshakeReanudado.peorMs);
+}
+
+// Mensajes confirmados por segundo (PUBACK) desde el reporte anterior, lo
+// que queda en la bandeja y el tiempo de ida y vuelta de cada PUBLISH
+void reportarBandeja() {
+  static unsigned long ultimoReporte = 0;
+  unsigned long ahora = millis();
+  unsigned long segundos = (ahora - ultimoReporte) / 1000;
+  ultimoReporte = ahora;
+  if (segundos == 0) return;
+  const EstadisticasBandeja& e = bandejaMQTT.estadisticas();
+  Serial.printf("📮 Bandeja QoS1: %lu.%02lu msgs/s confirmados, %lu encolados (%lu en su lugar, %lu bytes copiados), "
+                "%lu rechazados, %lu reenviados | "
+                "en vuelo=%u mensajes=%u libres=%u | rtt media=%lu peor=%lu ms | último seq=%lu\n",
+                (unsigned long)(e.confirmados / segundos), (unsigned long)(e.confirmados * 100 / segundos % 100),
+                (unsigned long)e.encolados, (unsigned long)e.enSuLugar, (unsigned long)e.copiados,
+                (unsigned long)e.rechazados, (unsigned long)e.reenviados,
+                (unsigned)bandejaMQTT.enVuelo(), (unsigned)bandejaMQTT.mensajes(), (unsigned)bandejaMQTT.libres(),
+                (unsigned long)(e.confirmados ? e.rttTotalMs / e.confirmados : 0), (unsigned long)e.rttPeorMs,
+                (unsigned long)ultimoSeqConfirmado);
+  bandejaMQTT.reiniciarEstadisticas();
+}
+
+#if LOGIOT_PERFIL
+// p50/p99/máximo de cada fase (us) y de la latencia fix -> publish (ms), con
+// las cubetas no vacías como "límite:cuenta"; después se publican y se reinician
+void reportarPerfil() {
+  static char cubetas[256];
+  uint32_t ciclosPorUs = ESP.getCpuFreqMHz();
+  Serial.println("=== Perfil de fases (us) ===");
+  for (uint8_t f = 0; f < CANTIDAD_FASES; f++) {
+    const HistogramaLatencia& h = histogramasFases[f];
+    if (h.cantidad() == 0) continue;
+    h.describir(cubetas, sizeof(cubetas), ciclosPorUs);
+    Serial.printf("⏱ %-12s n=%lu p50=%lu p99=%lu max=%lu [%s]\n", NOMBRES_FASES[f], (unsigned long)h.cantidad(),
+                  (unsigned long)(h.percentil(50) / ciclosPorUs), (unsigned long)(h.percentil(99) / ciclosPorUs),
+                  (unsigned long)(h.maximo() / ciclosPorUs), cubetas);
+  }
+  if (histogramaLatenciaFix.cantidad() > 0) {
+    histogramaLatenciaFix.describir(cubetas, sizeof(cubetas), 1);
+    Serial.printf("⏱ fix->publish n=%lu p50=%lu p99=%lu max=%lu ms [%s]\n", (unsigned long)histogramaLatenciaFix.cantidad(),
+                  (unsigned long)histogramaLatenciaFix.percentil(50), (unsigned long)histogramaLatenciaFix.percentil(99),
+                  (unsigned long)histogramaLatenciaFix.maximo(), cubetas);
+  }
+
+  publicarPerfil();
+  for (uint8_t f = 0; f < CANTIDAD_FASES; f++) {
+    histogramasFases[f].reiniciar();
+  }
+  histogramaLatenciaFix.reiniciar();
 }
 
+// Un mensaje por histograma en el tópico de diagnóstico; si no hay conexión
+// se pierde el período (no pasa por la cola)
+void publicarPerfil() {
+  if (!awsClient.connected()) {
+    return;
+  }
+  // Con el resto de los campos tiene que entrar en TAMANO_MENSAJE_DIAGNOSTICO
+  static char cubetas[224];
+  char* buffer = mensajeQoS0();
+  uint32_t ciclosPorUs = ESP.getCpuFreqMHz();
+  for (uint8_t f = 0; f <= CANTIDAD_FASES; f++) {
+    bool latencia = (f == CANTIDAD_FASES);
+    const HistogramaLatencia& h = latencia ? histogramaLatenciaFix : histogramasFases[f];
+    uint32_t divisor = latencia ? 1 : ciclosPorUs;
+    if (h.cantidad() == 0) continue;
+    h.describir(cubetas, sizeof(cubetas), divisor);
+
+    StaticJsonDocument<384> doc;
+    doc["device_id"] = DEVICE_ID;
+    doc["tipo"] = "perfil";
+    doc["fase"] = latencia ? "fix_publicacion" : NOMBRES_FASES[f];
+    doc["unidad"] = latencia ? "ms" : "us";
+    doc["n"] = h.cantidad();
+    doc["p50"] = h.percentil(50) / divisor;
+    doc["p99"] = h.percentil(99) / divisor;
+    doc["max"] = h.maximo() / divisor;
+    doc["media"] = h.media() / divisor;
+    doc["cubetas"] = (const char*)cubetas;
+    doc["timestamp"] = millis();
+    size_t largo = serializeJson(doc, buffer, TAMANO_MENSAJE_DIAGNOSTICO);
+    if (!publicarQoS0(TOPICO_MQTT_PERFIL, largo)) {
+      Serial.println("⚠ Fallo al publicar el perfil en AWS IoT");
+      return;
+    }
+  }
+  Serial.println("📤 Perfil publicado");
+}
+#endif
+
 // ===================================
 // === FUNCIONES DE CONEXION AWS ===
 // ===================================
+// Solo inicia la asociación; tareaConexion espera el resultado sin bloquear
 void conectarAWiFi() {
   Serial.printf("Conectando a WiFi: %s\n", WIFI_SSID);
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Conectando WiFi...");
+  pantalla.limpiar();
+  pantalla.cursor(0, 0);
+  pantalla.escribir("Conectando WiFi...");
   WiFi.mode(WIFI_STA);
   WiFi.begin(WIFI_SSID, WIFI_PASS);
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    Serial.print(".");
-    lcd.print(".");
-  }
-  Serial.printf("\n✔ WiFi conectado, IP: %s\n", WiFi.localIP().toString().c_str());
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("WiFi: OK");
-  lcd.setCursor(0, 1);
-  lcd.print(WiFi.localIP().toString());
-  delay(2000);
 }
 
 void configurarTiempo() {
   Serial.println("Configurando tiempo NTP...");
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Configurando NTP...");
   
-  // Configurar NTP (necesario para validar certificados SSL)
+  // El SNTP sincroniza en segundo plano; no hace falta esperar porque el
+  // cliente TLS corre en modo inseguro y no valida fechas de certificados
   configTime(-3 * 3600, 0, "pool.ntp.org", "time.nist.gov");
-  
-  time_t now = time(nullptr);
-  int timeout = 0;
-  while (now < 8 * 3600 * 2 && timeout < 20) {
-    delay(500);
-    Serial.print(".");
-    now = time(nullptr);
-    timeout++;
-  }
-  
-  if (timeout >= 20) {
-    Serial.println("\n⚠ Error configurando NTP");
-    lcd.clear();
-    lcd.setCursor(0, 0);
-    lcd.print("Error NTP");
-    delay(2000);
-  } else {
-    Serial.println("\n✔ Tiempo configurado");
-    lcd.clear();
-    lcd.setCursor(0, 0);
-    lcd.print("NTP: OK");
-    delay(1000);
-  }
 }
 
 void configurarAWS() {
   Serial.println("Configurando certificados AWS IoT...");
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Config AWS IoT...");
+  pantalla.limpiar();
+  pantalla.cursor(0, 0);
+  pantalla.escribir("Config AWS IoT...");
   
   // Configurar SSL en modo inseguro (sin validación de certificados)
   wifiClientSecure.setInsecure();
+  wifiClientSecure.setSession(&sesionTLS);
+  wifiClientSecure.setTimeout(TIMEOUT_TLS_MS);
   
   // Configurar cliente MQTT
-  awsClient.setServer(AWS_IOT_ENDPOINT, AWS_IOT_PORT);
+  awsClient.setServer(HOST_BROKER, AWS_IOT_PORT);
   awsClient.setCallback(callbackMQTT);
+  awsClient.setBufferSize(TAMANO_BUFFER_PUBSUBCLIENT);
+  awsClient.setSocketTimeout(TIMEOUT_CONNACK_S);
+  bandejaMQTT.alConfirmar(confirmacionMQTT);
   
   Serial.println("✔ AWS IoT configurado (modo inseguro)");
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("AWS: Configurado");
-  delay(1000);
+  pantalla.limpiar();
+  pantalla.cursor(0, 0);
+  pantalla.escribir("AWS: Configurado");
+  mostrarMensajeTemporal(1000);
 }
 
-void conectarAWSIoT() {
-  Serial.printf("Conectando a AWS IoT: %s\n", AWS_IOT_ENDPOINT);
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Conectando AWS...");
-  
-  int intentos = 0;
-  while (!awsClient.connected() && intentos < 5) {
-    Serial.printf("Intento %d de conexión MQTT...\n", intentos + 1);
-    
-    if (awsClient.connect(THING_NAME)) {
-      Serial.println("✔ Conectado a AWS IoT Core");
-      lcd.clear();
-      lcd.setCursor(0, 0);
-      lcd.print("AWS IoT: Conectado");
-      
-      // Suscribirse a topics de control si es necesario
-      // awsClient.subscribe("logistica/control/mapeo-01");
-      
-      delay(1000);
-      break;
-    } else {
-      Serial.printf("Error conectando: %d\n", awsClient.state());
-      lcd.print(".");
-      intentos++;
-      delay(2000);
-    }
+// ====== Conexión con AWS IoT ======
+// DNS, TCP + TLS y CONNECT son pasos separados de tareaConexion. La consulta
+// DNS es asíncrona; el handshake de BearSSL no se puede partir, pero con la
+// sesión reanudada pasa de segundos a unas decenas de ms. PubSubClient no
+// vuelve a abrir el socket si ya está conectado: solo manda el CONNECT.
+static void dnsResuelto(const char* nombre, const ip_addr_t* ip, void* arg) {
+  if ((uint8_t)(uintptr_t)arg != consultaDNS) return;
+  resultadoDNS = (ip != nullptr) ? DNS_RESUELTO : DNS_FALLIDO;
+}
+
+void iniciarConexionMQTT(uint32_t ahora) {
+  intentosMQTT++;
+  Serial.printf("Conectando AWS IoT (intento %lu)...\n", (unsigned long)(esperaMQTT.fallosSeguidos() + 1));
+  if (!mqttErrorMostrado) {
+    pantalla.limpiar();
+    pantalla.cursor(0, 0);
+    pantalla.escribir("Conectando AWS...");
+    mqttErrorMostrado = true;
   }
-  
-  if (!awsClient.connected()) {
-    Serial.println("⚠ No se pudo conectar a AWS IoT");
-    lcd.clear();
-    lcd.setCursor(0, 0);
-    lcd.print("AWS: Error conexion");
-    delay(2000);
-  }
-}
-
-void reconectarMQTT() {
-  if (!awsClient.connected() && intentosFallidosMQTT < MAX_INTENTOS_MQTT) {
-    Serial.println("Intentando reconectar AWS IoT...");
-    if (!mqttErrorMostrado) {
-      lcd.clear();
-      lcd.setCursor(0, 0);
-      lcd.print("Reconectando AWS...");
-      mqttErrorMostrado = true;
-    }
-    
-    if (awsClient.connect(THING_NAME)) {
-      lcd.clear();
-      lcd.setCursor(0, 0);
-      lcd.print("AWS Reconectado!");
-      delay(500);
-      Serial.println("AWS IoT reconectado");
-      intentosFallidosMQTT = 0;
-      mqttErrorMostrado = false;
-    } else {
-      intentosFallidosMQTT++;
-      Serial.printf("AWS IoT FAIL (state=%d)\n", awsClient.state());
-      if (intentosFallidosMQTT >= MAX_INTENTOS_MQTT) {
-        Serial.println("⚠ Máximo de intentos AWS IoT alcanzado. Esperando...");
-        lcd.clear();
-        lcd.setCursor(0, 0);
-        lcd.print("AWS: Error Persist");
-        lcd.setCursor(0, 1);
-        lcd.print("Verificar config");
-        delay(2000);
-      }
-    }
+  inicioIntentoMQTT = ahora;
+  inicioPasoConexion = ahora;
+  estadoConexion = CONEXION_DNS;
+
+  // La respuesta queda en la caché de lwIP: el connect() del paso TLS la
+  // encuentra ahí y no vuelve a esperar al servidor DNS
+  ip_addr_t direccion;
+  consultaDNS++;
+  resultadoDNS = DNS_ESPERANDO;
+  err_t r = dns_gethostbyname(HOST_BROKER, &direccion, dnsResuelto, (void*)(uintptr_t)consultaDNS);
+  if (r == ERR_OK) {
+    resultadoDNS = DNS_RESUELTO;
+  } else if (r != ERR_INPROGRESS) {
+    resultadoDNS = DNS_FALLIDO;
+  }
+}
+
+void conectarTLS() {
+  // Si el servidor acepta la sesión ofrecida no cambian ni su id ni el secreto
+  uint8_t sesionOfrecida[sizeof(BearSSL::Session)];
+  memcpy(sesionOfrecida, &sesionTLS, sizeof(sesionTLS));
+  // Lo que quedó sin PUBACK se reenvía con DUP en esta conexión
+  bandejaMQTT.nuevaConexion();
+  uint32_t inicio = millis();
+  bool conectado = wifiClientSecure.connect(HOST_BROKER, AWS_IOT_PORT);
+  uint32_t duracion = millis() - inicio;
+  if (!conectado) {
+    sesionTLS = BearSSL::Session();
+    sesionTLSValida = false;
+    fallarConexionMQTT("TLS");
+    return;
+  }
+  bool reanudada = sesionTLSValida && memcmp(sesionOfrecida, &sesionTLS, sizeof(sesionTLS)) == 0;
+  sesionTLSValida = true;
+  registrarHandshake(reanudada ? handshakeReanudado : handshakeCompleto, duracion);
+  Serial.printf("🔐 TLS %s en %lu ms\n", reanudada ? "reanudado" : "completo", (unsigned long)duracion);
+  estadoConexion = CONEXION_MQTT;
+}
+
+void conectarMQTT() {
+  if (!awsClient.connect(THING_NAME)) {
+    fallarConexionMQTT("MQTT");
+    return;
+  }
+  esperaMQTT.exito();
+  mqttErrorMostrado = false;
+  estadoConexion = CONEXION_AWS_OK;
+  Serial.printf("✔ AWS IoT conectado en %lu ms\n", (unsigned long)(millis() - inicioIntentoMQTT));
+  pantalla.limpiar();
+  pantalla.cursor(0, 0);
+  pantalla.escribir("AWS Conectado!");
+  mostrarMensajeTemporal(500);
+
+  // Comandos de ajuste; con QoS 1 el broker reintenta hasta el PUBACK
+  awsClient.subscribe(AWS_TOPIC_CONTROL, 1);
+  awsClient.subscribe(AWS_TOPIC_CONTROL_FLOTA, 1);
+#if LOGIOT_GEOCERCAS
+  awsClient.subscribe(AWS_TOPIC_GEOCERCAS, 1);
+  awsClient.subscribe(AWS_TOPIC_GEOCERCAS_FLOTA, 1);
+#endif
+#if LOGIOT_CALLES_CONOCIDAS
+  awsClient.subscribe(AWS_TOPIC_CALLES, 1);
+  awsClient.subscribe(AWS_TOPIC_CALLES_FLOTA, 1);
+  respuestaCallesPendiente = true;
+#endif
+}
+
+// Nunca se deja de intentar: la espera crece hasta CONFIG_REINTENTOS_MQTT.esperaMaximaMs
+void fallarConexionMQTT(const char* paso) {
+  wifiClientSecure.stop();
+  fallosMQTT++;
+  uint32_t espera = esperaMQTT.fallo(ESP.random());
+  proximoIntentoMQTT = millis() + espera;
+  estadoConexion = CONEXION_WIFI_OK;
+  Serial.printf("⚠ AWS IoT: falló %s (state=%d), %lu fallos seguidos, reintento en %lu ms\n", paso, awsClient.state(),
+                (unsigned long)esperaMQTT.fallosSeguidos(), (unsigned long)espera);
+  if (esperaMQTT.fallosSeguidos() == AVISO_INTENTOS_MQTT) {
+    pantalla.limpiar();
+    pantalla.cursor(0, 0);
+    pantalla.escribir("AWS: Error Persist");
+    pantalla.cursor(0, 1);
+    pantalla.escribir("Verificar config");
+    mostrarMensajeTemporal(2000);
+  }
+}
+
+void registrarHandshake(MedicionHandshake& m, uint32_t duracionMs) {
+  m.cantidad++;
+  m.totalMs += duracionMs;
+  if (duracionMs > m.peorMs) m.peorMs = duracionMs;
+}
+
+void iniciarCola() {
+  // Sin estado guardado la secuencia arranca en un punto al azar: el backend
+  // descarta por (equipo, seq) y pudo haber visto las secuencias bajas
+  uint32_t semillaSecuencia = ESP.random();
+  if (!LittleFS.begin()) {
+    Serial.println("⚠ No se pudo montar LittleFS, la cola persistente queda deshabilitada");
+    colaEnvio.iniciarSinAlmacen(semillaSecuencia);
+    return;
   }
+  almacenCola.iniciar();
+  colaDisponible = colaEnvio.iniciar(semillaSecuencia);
+  Serial.printf("✔ Cola persistente: %lu mensajes pendientes en %lu segmentos\n",
+                (unsigned long)colaEnvio.cantidadPendientes(), (unsigned long)colaEnvio.segmentosEnUso());
 }
 
 // Callback para mensajes MQTT recibidos
 void callbackMQTT(char* topic, byte* payload, unsigned int length) {
-  Serial.printf("Mensaje recibido en topic: %s\n", topic);
-  
-  // Convertir payload a string
-  String message = "";
-  for (unsigned int i = 0; i < length; i++) {
-    message += (char)payload[i];
+  if (strcmp(topic, AWS_TOPIC_CONTROL) == 0 || strcmp(topic, AWS_TOPIC_CONTROL_FLOTA) == 0) {
+    // Se lee directo del buffer de PubSubClient; lo aceptado queda pendiente
+    // hasta aplicarParametros()
+    resultadoUltimoComando = parametros.recibir((const char*)payload, length, idUltimoComando, parametroRechazado);
+    respuestaComandoPendiente = true;
+    Serial.printf("🎛 Comando %lu (%s): %s\n", (unsigned long)idUltimoComando,
+                  strcmp(topic, AWS_TOPIC_CONTROL) == 0 ? "equipo" : "flota",
+                  ParametrosRemotos::descripcion(resultadoUltimoComando));
+    return;
+  }
+#if LOGIOT_GEOCERCAS
+  if (strcmp(topic, AWS_TOPIC_GEOCERCAS) == 0 || strcmp(topic, AWS_TOPIC_GEOCERCAS_FLOTA) == 0) {
+    // Las líneas van del buffer de PubSubClient a flash sin copiarse; se
+    // responde al terminar la carga o ante el primer error
+    ResultadoCarga r = geocercasDisponibles ? geocercas.recibir((const char*)payload, length) : CARGA_ERROR_ALMACEN;
+    if (r != CARGA_EN_CURSO && r != CARGA_COMPLETA) {
+      resultadoGeocercas = r;
+      respuestaGeocercasPendiente = true;
+      Serial.printf("⚠ Geocercas: carga rechazada (%s)\n", Geocercas::descripcion(r));
+    } else if (r == CARGA_COMPLETA) {
+      Serial.printf("📌 Geocercas v%lu recibidas, armando el índice\n", (unsigned long)geocercas.versionCargando());
+    }
+    return;
+  }
+#endif
+#if LOGIOT_CALLES_CONOCIDAS
+  if (strcmp(topic, AWS_TOPIC_CALLES) == 0 || strcmp(topic, AWS_TOPIC_CALLES_FLOTA) == 0) {
+    // Como las geocercas: de a varias líneas, directo a flash
+    ResultadoCarga r = grafoCallesDisponible ? grafoCalles.recibir((const char*)payload, length) : CARGA_ERROR_ALMACEN;
+    if (r != CARGA_EN_CURSO && r != CARGA_COMPLETA) {
+      resultadoCalles = r;
+      respuestaCallesPendiente = true;
+      Serial.printf("⚠ Calles: carga rechazada (%s)\n", Geocercas::descripcion(r));
+    } else if (r == CARGA_COMPLETA) {
+      Serial.printf("🗺 Calles v%lu recibidas, armando el índice\n", (unsigned long)grafoCalles.versionCargando());
+    }
+    return;
   }
+#endif
+
+  Serial.printf("Mensaje recibido en topic: %s\n", topic);
   
-  Serial.printf("Contenido: %s\n", message.c_str());
+  // El payload no termina en '\0': se imprime con su largo, sin copiarlo
+  Serial.printf("Contenido: %.*s\n", (int)length, (const char*)payload);
   
   // Aquí puedes agregar lógica para manejar comandos remotos
   // Por ejemplo, comandos para iniciar/detener mapeo desde AWS
 }
 
+// ====== Parámetros remotos ======
+// LittleFS escribe el archivo completo al cerrarlo: un corte a mitad de la
+// escritura deja el anterior
+void cargarParametros() {
+  File archivo = LittleFS.open(ARCHIVO_PARAMETROS, "r");
+  if (!archivo) {
+    return;
+  }
+  uint8_t datos[PARAMETROS_TAMANO_SERIALIZADO];
+  size_t largo = archivo.read(datos, sizeof(datos));
+  archivo.close();
+  if (!parametros.restaurar(datos, largo)) {
+    Serial.println("⚠ Parámetros guardados inválidos, se usan los de por defecto");
+    return;
+  }
+  usarParametros(parametros.modificados());
+  Serial.printf("✔ Parámetros: %u cambiados por comando\n", (unsigned)__builtin_popcount(parametros.modificados()));
+}
+
+void guardarParametros() {
+  uint8_t datos[PARAMETROS_TAMANO_SERIALIZADO];
+  size_t largo = parametros.serializar(datos, sizeof(datos));
+  File archivo = LittleFS.open(ARCHIVO_PARAMETROS, "w");
+  if (!archivo || archivo.write(datos, largo) != largo) {
+    Serial.println("⚠ No se pudieron guardar los parámetros");
+  }
+  archivo.close();
+}
+
+void aplicarParametros() {
+  if (parametros.hayPendientes()) {
+    uint32_t cambiados = parametros.aplicarPendientes();
+    if (cambiados != 0) {
+      usarParametros(cambiados);
+      guardarParametros();
+    }
+  }
+  if (respuestaComandoPendiente) {
+    responderComando();
+  }
+}
+
+void usarParametros(uint32_t cambiados) {
+  if (cambiados & ((1UL << PARAM_COLA_MENSAJES_SEG) | (1UL << PARAM_COLA_RAFAGA))) {
+    colaEnvio.fijarDrenado(parametros.valor(PARAM_COLA_MENSAJES_SEG), parametros.valor(PARAM_COLA_RAFAGA));
+  }
+  if (cambiados & (1UL << PARAM_VENTANA_MQTT)) {
+    bandejaMQTT.fijarVentana(parametros.valor(PARAM_VENTANA_MQTT));
+  }
+#if LOGIOT_BANDA_MUERTA
+  if (cambiados & (1UL << PARAM_BANDA_ERROR_M)) {
+    bandaMuerta.fijarErrorMaximo(parametros.valor(PARAM_BANDA_ERROR_M));
+  }
+#endif
+  // El período nuevo corre desde ahora y no desde el plazo ya agendado
+  if ((cambiados & (1UL << PARAM_INTERVALO_UBICACION)) && idTareaPublicarGPS >= 0) {
+    planificador.despertar(idTareaPublicarGPS);
+  }
+  if ((cambiados & (1UL << PARAM_INTERVALO_DIAGNOSTICO)) && idTareaDiagnostico >= 0) {
+    planificador.despertar(idTareaDiagnostico);
+  }
+}
+
+// QoS 0 con los valores en uso: la respuesta también confirma un comando que
+// no cambió nada
+void responderComando() {
+  if (!awsClient.connected()) {
+    return;
+  }
+  respuestaComandoPendiente = false;
+  char* buffer = mensajeQoS0();
+  const int capacidad = TAMANO_MENSAJE_DIAGNOSTICO;
+  int largo = snprintf(buffer, capacidad, "{\"id\":%lu,\"device_id\":\"%s\",\"resultado\":\"%s\"",
+                       (unsigned long)idUltimoComando, DEVICE_ID, ParametrosRemotos::descripcion(resultadoUltimoComando));
+  if (parametroRechazado >= 0) {
+    largo += snprintf(buffer + largo, capacidad - largo, ",\"parametro\":\"%s\"",
+                      parametros.definicion(parametroRechazado).nombre);
+  }
+  largo += snprintf(buffer + largo, capacidad - largo, ",\"valores\":{");
+  for (uint8_t i = 0; i < parametros.cantidad() && largo < capacidad; i++) {
+    largo += snprintf(buffer + largo, capacidad - largo, "%s\"%s\":%lu", i > 0 ? "," : "",
+                      parametros.definicion(i).nombre, (unsigned long)parametros.valor(i));
+  }
+  if (largo + 2 >= capacidad) {
+    Serial.println("⚠ Respuesta de comando demasiado larga");
+    return;
+  }
+  largo += snprintf(buffer + largo, capacidad - largo, "}}");
+  publicarQoS0(TOPICO_MQTT_CONTROL_RESPUESTA, largo);
+}
+
 // Comentado - Funciones del broker anterior
 /*
 void conectarAWebSocket() {
@@ -514,135 +1657,110 @@ void conectarAWebSocket() {
 // ===================================
 // === FUNCIONES DE PROCESAMIENTO GPS ===
 // ===================================
-void procesarDatosGPS() {
-  int ventanaInicio = (indiceBuffer + TAMANO_BUFFER_GPS - 15) % TAMANO_BUFFER_GPS;
-  int ventanaFin = (indiceBuffer + TAMANO_BUFFER_GPS - 1) % TAMANO_BUFFER_GPS;
-  PuntoGPS puntoInicioVentana = bufferGPS[ventanaInicio];
-  PuntoGPS puntoFinVentana = bufferGPS[ventanaFin];
-
-  double distanciaVentana = calcularDistanciaHaversine(puntoInicioVentana, puntoFinVentana);
-  if (distanciaVentana < UMBRAL_DISTANCIA_GIRO || puntoFinVentana.velocidad < UMBRAL_VELOCIDAD_GIRO) {
-    Serial.printf("Debug: Ignorando (Dist=%.1fm, Vel=%.2fkm/h, Sats=%d)\n", distanciaVentana, puntoFinVentana.velocidad, puntoFinVentana.satelites);
-    return;
-  }
-
-  double cambioRumbo = abs(normalizarAngulo(puntoFinVentana.rumbo - puntoInicioVentana.rumbo));
-
-  Serial.printf("Debug Giro: Rumbo cambio=%.1f°, Vel=%.2f km/h, Dist=%.1fm, Sats=%d\n", cambioRumbo, puntoFinVentana.velocidad, distanciaVentana, puntoFinVentana.satelites);
-
-  if (cambioRumbo > 20.0 && puntoFinVentana.velocidad > UMBRAL_VELOCIDAD_GIRO) {
-    if (!posibleGiroDetectado) {
-      posibleGiroDetectado = true;
-      contadorLecturasGiro = 1;
-      Serial.println("Posible giro detectado (conteo=1)");
-    } else {
-      contadorLecturasGiro++;
-      Serial.printf("Giro en progreso (conteo=%d/%d)\n", contadorLecturasGiro, UMBRAL_CONFIRMACION_GIRO);
-    }
-  } else {
-    if (posibleGiroDetectado) {
-      Serial.println("Giro descartado (estabilizado)");
-    }
-    posibleGiroDetectado = false;
-    contadorLecturasGiro = 0;
-  }
-
-  if (posibleGiroDetectado && contadorLecturasGiro >= UMBRAL_CONFIRMACION_GIRO) {
-    Serial.println("Giro confirmado! Cambiando calle.");
-    enviarFinMapeoMQTT(); 
-    
-    contadorCalles++;
-    idCalleActual = "CALLE_" + String(contadorCalles);
-    enviarInicioMapeoMQTT(); 
+void EventosMapeo::giro(EventoGiro evento, float cambioGrados) {
+  switch (evento) {
+    case GIRO_POSIBLE:
+      Serial.printf("Posible giro detectado (%.1f°)\n", cambioGrados);
+#if LOGIOT_LOTES
+      // El tramo recto sale antes de que empiece la curva
+      enviarLoteMQTT(loteMapeo, COLA_TOPICO_PEDIDOS, true, "lote mapeo");
+#endif
+      break;
+    case GIRO_DESCARTADO:
+      Serial.printf("Giro descartado (%.1f°)\n", cambioGrados);
+      break;
+    case GIRO_CONFIRMADO:
+      Serial.printf("Giro confirmado (%.1f°)! Cambiando calle.\n", cambioGrados);
+      enviarFinMapeoMQTT();
 
-    posibleGiroDetectado = false;
-    contadorLecturasGiro = 0;
-    actualizarPantalla();
-  } else if (!posibleGiroDetectado && (millis() - ultimoPuntoMapeoEnviado > 10000) && gps.speed.kmph() >= 2.5) {
-    PuntoGPS puntoFiltrado = obtenerPuntoPromedio();
-    enviarPuntoAMQTT(puntoFiltrado, AWS_TOPIC_PEDIDOS);
-    ultimoPuntoMapeoEnviado = millis();
-  }
-}
-
-PuntoGPS obtenerPuntoPromedio() {
-  PuntoGPS puntoPromedio = {0.0, 0.0, 0.0, 0.0, 0, 0};
-  int contadorValidos = 0;
-  for (int i = 0; i < TAMANO_BUFFER_GPS; i++) {
-    if (bufferGPS[i].satelites >= 3) {
-      puntoPromedio.lat += bufferGPS[i].lat;
-      puntoPromedio.lon += bufferGPS[i].lon;
-      puntoPromedio.rumbo += bufferGPS[i].rumbo;
-      puntoPromedio.velocidad += bufferGPS[i].velocidad;
-      puntoPromedio.satelites += bufferGPS[i].satelites;
-      contadorValidos++;
-    }
-  }
-  if (contadorValidos > 0) {
-    puntoPromedio.lat /= contadorValidos;
-    puntoPromedio.lon /= contadorValidos;
-    puntoPromedio.rumbo /= contadorValidos;
-    puntoPromedio.velocidad /= contadorValidos;
-    puntoPromedio.satelites /= contadorValidos;
+      contadorCalles++;
+      snprintf(idCalleActual, sizeof(idCalleActual), "CALLE_%d", contadorCalles);
+      enviarInicioMapeoMQTT();
+      actualizarPantalla();
+      break;
+    case GIRO_NINGUNO:
+      break;
   }
-  puntoPromedio.tiempo = bufferGPS[(indiceBuffer - 1 + TAMANO_BUFFER_GPS) % TAMANO_BUFFER_GPS].tiempo;
-  return puntoPromedio;
 }
 
-double calcularDistanciaHaversine(PuntoGPS p1, PuntoGPS p2) {
-  const double R = 6371000.0;
-  double lat1 = p1.lat * PI / 180.0;
-  double lon1 = p1.lon * PI / 180.0;
-  double lat2 = p2.lat * PI / 180.0;
-  double lon2 = p2.lon * PI / 180.0;
-
-  double dLat = lat2 - lat1;
-  double dLon = lon2 - lon1;
+// ====== Simplificación de la calle ======
+void EventosMapeo::inicioCalle(const VerticeTrayecto& v) {
+  verticesCalle.agregar(v.lat, v.lon, v.tiempoMs);
+}
 
-  double a = sin(dLat / 2) * sin(dLat / 2) +
-             cos(lat1) * cos(lat2) * sin(dLon / 2) * sin(dLon / 2);
-  double c = 2 * atan2(sqrt(a), sqrt(1 - a));
-  return R * c;
+void EventosMapeo::vertice(const VerticeTrayecto& v) {
+  publicarVertice(v);
 }
 
-double normalizarAngulo(double angulo) {
-  if (angulo > 180) angulo -= 360;
-  if (angulo < -180) angulo += 360;
-  return angulo;
+void publicarVertice(const VerticeTrayecto& v) {
+#if LOGIOT_CALLES_CONOCIDAS
+  // El backend ya tiene la geometría: el "fin" lleva los tramos recorridos
+  if (calleConocida) {
+    verticesOmitidos++;
+    return;
+  }
+#endif
+  if (verticesCalle.lleno()) {
+    verticesDesbordados = true;
+  } else {
+    verticesCalle.agregar(v.lat, v.lon, v.tiempoMs);
+  }
+#if LOGIOT_LOTES
+  if (loteMapeo.agregar(v.lat, v.lon, v.tiempoMs)) {
+    enviarLoteMQTT(loteMapeo, COLA_TOPICO_PEDIDOS, true, "lote mapeo");
+  }
+#else
+  PuntoGPS p = {v.lat, v.lon, v.rumbo, v.velocidad, v.satelites, v.tiempoGps};
+  // El vértice sale con demora (el simplificador espera a ver la recta); la
+  // latencia se cuenta desde que tareaFixGPS lo tomó
+  PERFIL_FIX_MENSAJE(v.tiempoMs);
+  enviarPuntoAMQTT(p, COLA_TOPICO_PEDIDOS);
+#endif
+  ultimoPuntoMapeoEnviado = millis();
 }
 
 // ===================================
 // === FUNCIONES DE ENVIO MQTT (ACTUALIZADAS PARA AWS) ===
 // ===================================
-void enviarPuntoAMQTT(PuntoGPS p, const String& topico) {
-  StaticJsonDocument<256> doc;
-  doc["id"] = idCalleActual;
-  doc["tipo"] = "punto";
-  doc["lat"] = p.lat;
-  doc["lon"] = p.lon;
-  doc["velocidad"] = p.velocidad;
-  doc["satelites"] = p.satelites;
-  doc["tiempo"] = p.tiempo;
-  doc["rumbo"] = p.rumbo;
-  doc["device_id"] = DEVICE_ID;  // Cambio: usar device_id en lugar de vehiculo_id
-  doc["precision_baja"] = (p.satelites < 4);
-  doc["timestamp"] = millis();   // Agregar timestamp local
+void enviarPuntoAMQTT(const PuntoGPS& p, uint8_t idTopico) {
+  uint32_t seq = colaEnvio.siguienteSecuencia();
+  MensajeEnArmado mensaje = armarMensaje(idTopico, TAMANO_MENSAJE_MQTT);
+  uint32_t inicioCodificacion = micros();
+#if LOGIOT_FORMATO_BINARIO
+  TramaMapeo m = tramaDesdePunto(p, seq);
+  size_t largo = codificarPunto(m, mensaje.datos, mensaje.capacidad);
+#else
+  ContextoMensaje c = {DEVICE_ID, (uint32_t)millis(), seq, -1};
+#if LOGIOT_PERFIL
+  if (instanteFixMensaje != 0) c.latenciaMs = (int32_t)(millis() - instanteFixMensaje);
+#endif
+  size_t largo = codificarPuntoJSON(p, idCalleActual, c, (char*)mensaje.datos, mensaje.capacidad);
+#endif
+  registrarCodificacion(micros() - inicioCodificacion, largo);
   
-  char buffer[256];
-  serializeJson(doc, buffer);
-  
-  if (awsClient.connected()) {
-    if (awsClient.publish(topico.c_str(), buffer)) {
-      Serial.printf("✔ Publicado en %s -> %s\n", topico.c_str(), buffer);
-    } else {
-      Serial.println("⚠ Fallo al publicar punto en AWS IoT");
-    }
-  } else {
-    Serial.println("⚠ No se publica punto: AWS IoT desconectado");
-  }
+  publicarMensaje(mensaje, true, seq, largo, "punto");
 }
 
 void enviarInicioMapeoMQTT() {
+  simplificador.reiniciar();
+  verticesCalle.vaciar();
+  verticesDesbordados = false;
+#if LOGIOT_CALLES_CONOCIDAS
+  grafoCalles.reiniciarRecorrido();
+#endif
+#if LOGIOT_RESUMEN_VIAJE
+  resumenViaje.iniciarCalle();
+#endif
+  uint32_t seq = colaEnvio.siguienteSecuencia();
+  MensajeEnArmado mensaje = armarMensaje(COLA_TOPICO_PEDIDOS, TAMANO_MENSAJE_MQTT);
+  uint32_t inicioCodificacion = micros();
+#if LOGIOT_FORMATO_BINARIO
+  PuntoGPS actual = {gps.location.isValid() ? gps.location.lat() : 0.0,
+                     gps.location.isValid() ? gps.location.lng() : 0.0,
+                     0.0, 0.0, (int)gps.satellites.value(), gps.time.value()};
+  TramaMapeo m = tramaDesdePunto(actual, seq);
+  size_t largo = codificarInicio(m, mensaje.datos, mensaje.capacidad);
+#else
   StaticJsonDocument<256> doc;
   doc["id"] = idCalleActual;
   doc["tipo"] = "inicio";
@@ -652,62 +1770,223 @@ void enviarInicioMapeoMQTT() {
   doc["tiempo"] = gps.time.value();
   doc["device_id"] = DEVICE_ID;
   doc["precision_baja"] = (gps.satellites.value() < 4);
+#if LOGIOT_CALLES_CONOCIDAS
+  if (calleConocida) {
+    doc["conocida"] = true;
+  }
+#endif
   doc["timestamp"] = millis();
+  doc["seq"] = seq;
+  size_t largo = serializeJson(doc, (char*)mensaje.datos, mensaje.capacidad);
+#endif
+  registrarCodificacion(micros() - inicioCodificacion, largo);
   
-  char buffer[256];
-  serializeJson(doc, buffer);
-  
-  if (awsClient.connected()) {
-    if (awsClient.publish(AWS_TOPIC_PEDIDOS, buffer)) {
-      Serial.printf("✔ Inicio mapeo publicado en AWS -> %s\n", buffer);
-    } else {
-      Serial.println("⚠ Fallo al publicar inicio mapeo en AWS IoT");
-    }
-  } else {
-    Serial.println("⚠ No se publica inicio: AWS IoT desconectado");
-  }
+  publicarMensaje(mensaje, true, seq, largo, "inicio mapeo");
 }
 
 void enviarFinMapeoMQTT() {
-  StaticJsonDocument<256> doc;
+  VerticeTrayecto ultimo;
+  if (simplificador.cerrar(ultimo)) {
+    publicarVertice(ultimo);
+  }
+#if LOGIOT_LOTES
+  // Los puntos pendientes de la calle tienen que llegar antes que su "fin"
+  enviarLoteMQTT(loteMapeo, COLA_TOPICO_PEDIDOS, true, "lote mapeo");
+#endif
+#if LOGIOT_FORMATO_BINARIO
+  // En binario la geometría viaja en su propia trama, antes del "fin"
+  enviarGeometriaCalle();
+#if LOGIOT_RESUMEN_VIAJE
+  enviarResumenMQTT(false, false);
+#endif
+#endif
+  uint32_t seq = colaEnvio.siguienteSecuencia();
+  MensajeEnArmado mensaje = armarMensaje(COLA_TOPICO_PEDIDOS, TAMANO_MENSAJE_LOTE);
+  uint32_t inicioCodificacion = micros();
+#if LOGIOT_FORMATO_BINARIO
+  TramaMapeo m = {};
+  m.seq = seq;
+  m.calle = contadorCalles;
+  m.timestamp = millis();
+#if LOGIOT_CALLES_CONOCIDAS
+  size_t largo = calleConocida ? codificarFin(m, mensaje.datos, mensaje.capacidad, grafoCalles.recorrido(),
+                                              grafoCalles.largoRecorrido())
+                               : codificarFin(m, mensaje.datos, mensaje.capacidad);
+#else
+  size_t largo = codificarFin(m, mensaje.datos, mensaje.capacidad);
+#endif
+#else
+  // Estática: con la polyline no entra en la pila del loop
+  static char polyline[TAMANO_MENSAJE_LOTE / 2];
+  // Más los tramos de una calle conocida y el resumen de la calle
+  const size_t TAMANO_DOC_FIN = 384
+#if LOGIOT_CALLES_CONOCIDAS
+                                + JSON_ARRAY_SIZE(GRAFO_MAX_RECORRIDO)
+#endif
+#if LOGIOT_RESUMEN_VIAJE
+                                + JSON_OBJECT_SIZE(8)
+#endif
+      ;
+  StaticJsonDocument<TAMANO_DOC_FIN> doc;
   doc["id"] = idCalleActual;
   doc["tipo"] = "fin";
   doc["device_id"] = DEVICE_ID;
   doc["timestamp"] = millis();
-  
-  char buffer[256];
-  serializeJson(doc, buffer);
-  
-  if (awsClient.connected()) {
-    if (awsClient.publish(AWS_TOPIC_PEDIDOS, buffer)) {
-      Serial.printf("✔ Fin mapeo publicado en AWS -> %s\n", buffer);
-    } else {
-      Serial.println("⚠ Fallo al publicar fin mapeo en AWS IoT");
+  doc["seq"] = seq;
+#if LOGIOT_CALLES_CONOCIDAS
+  // En una calle conocida no hay vértices: la geometría son los tramos
+  if (calleConocida) {
+    JsonArray tramos = doc.createNestedArray("tramos");
+    for (uint8_t i = 0; i < grafoCalles.largoRecorrido(); i++) {
+      tramos.add(grafoCalles.recorrido()[i]);
     }
-  } else {
-    Serial.println("⚠ No se publica fin: AWS IoT desconectado");
   }
+#endif
+#if LOGIOT_RESUMEN_VIAJE
+  agregarResumenJSON(doc.createNestedObject("resumen"), resumenViaje.calle());
+#endif
+  // Geometría simplificada de toda la calle; si se llenó, el backend se queda con los puntos
+  if (verticesCalle.cantidad() >= 2 && !verticesDesbordados &&
+      verticesCalle.codificarPolyline(polyline, sizeof(polyline)) > 0) {
+    doc["polyline"] = (const char*)polyline;
+    doc["vertices"] = verticesCalle.cantidad();
+  }
+  size_t largo = serializeJson(doc, (char*)mensaje.datos, mensaje.capacidad);
+#endif
+  registrarCodificacion(micros() - inicioCodificacion, largo);
+  
+  publicarMensaje(mensaje, true, seq, largo, "fin mapeo");
 }
 
-void publicarGPS() {
-  if (awsClient.connected() && gps.location.isValid() && gps.satellites.value() >= 3) {
-    StaticJsonDocument<256> doc;
-    doc["device_id"] = DEVICE_ID;
-    doc["latitud"] = gps.location.lat();
-    doc["longitud"] = gps.location.lng();
-    doc["satelites"] = gps.satellites.value();
-    doc["velocidad_kmh"] = gps.speed.kmph();
-    doc["precision_baja"] = (gps.satellites.value() < 4);
-    doc["timestamp"] = millis();
+#if LOGIOT_RESUMEN_VIAJE
+// El de la calle se manda así solo en binario (en JSON va adentro del
+// "fin"); el del viaje lleva además el tiempo por rango de velocidad
+void enviarResumenMQTT(bool viaje, bool final) {
+  const Resumen& r = viaje ? resumenViaje.viaje() : resumenViaje.calle();
+  if (viaje) {
+    ultimoResumenViaje = millis();
+    Serial.printf("🧾 Viaje: %lu m en %lu s, %u paradas (%lu s detenido), máx %.0f km/h, %u aceleraciones y %u frenadas bruscas\n",
+                  (unsigned long)r.distanciaM(), (unsigned long)(r.duracionMs / 1000), (unsigned)r.paradas,
+                  (unsigned long)(r.detenidoMs / 1000), r.velocidadMaxKmh, (unsigned)r.aceleraciones,
+                  (unsigned)r.frenadas);
+  }
+  uint32_t seq = colaEnvio.siguienteSecuencia();
+  MensajeEnArmado mensaje = armarMensaje(COLA_TOPICO_PEDIDOS, TAMANO_MENSAJE_LOTE);
+  uint32_t inicioCodificacion = micros();
+#if LOGIOT_FORMATO_BINARIO
+  TramaResumen t = {};
+  t.seq = seq;
+  t.calle = contadorCalles;
+  t.timestamp = millis();
+  t.viaje = viaje;
+  t.final = final;
+  t.distanciaM = r.distanciaM();
+  t.duracionS = r.duracionMs / 1000;
+  t.detenidoS = r.detenidoMs / 1000;
+  t.velocidadMaxCentiKmh = aCentesimas(r.velocidadMaxKmh);
+  t.paradas = r.paradas;
+  t.aceleraciones = r.aceleraciones;
+  t.frenadas = r.frenadas;
+  if (viaje) {
+    t.rangos = RESUMEN_RANGOS;
+    for (uint8_t i = 0; i < RESUMEN_RANGOS; i++) t.rangoS[i] = r.rangoMs[i] / 1000;
+  }
+  size_t largo = codificarResumen(t, mensaje.datos, mensaje.capacidad);
+#else
+  StaticJsonDocument<JSON_OBJECT_SIZE(9) + JSON_OBJECT_SIZE(8) + JSON_ARRAY_SIZE(RESUMEN_RANGOS)> doc;
+  doc["id"] = idCalleActual;
+  doc["tipo"] = "viaje";
+  doc["device_id"] = DEVICE_ID;
+  doc["final"] = final;
+  agregarResumenJSON(doc.createNestedObject("resumen"), r);
+  doc["rangos_kmh"] = RESUMEN_ANCHO_RANGO_KMH;
+  JsonArray rangos = doc.createNestedArray("rangos_s");
+  for (uint8_t i = 0; i < RESUMEN_RANGOS; i++) {
+    rangos.add(r.rangoMs[i] / 1000);
+  }
+  doc["timestamp"] = millis();
+  doc["seq"] = seq;
+  size_t largo = serializeJson(doc, (char*)mensaje.datos, mensaje.capacidad);
+#endif
+  registrarCodificacion(micros() - inicioCodificacion, largo);
+  publicarMensaje(mensaje, true, seq, largo, viaje ? "resumen viaje" : "resumen calle");
+}
 
-    char buffer[256];
-    serializeJson(doc, buffer);
+void agregarResumenJSON(JsonObject destino, const Resumen& r) {
+  destino["distancia_m"] = r.distanciaM();
+  destino["duracion_s"] = r.duracionMs / 1000;
+  destino["detenido_s"] = r.detenidoMs / 1000;
+  destino["paradas"] = r.paradas;
+  destino["vel_max"] = (int)(r.velocidadMaxKmh + 0.5f);
+  destino["vel_media"] = (int)(r.velocidadMediaKmh() + 0.5f);
+  destino["aceleraciones"] = r.aceleraciones;
+  destino["frenadas"] = r.frenadas;
+}
+#endif
 
-    if (awsClient.publish(AWS_TOPIC_UBICACION, buffer)) {
-      Serial.printf("✔ Ubicación publicada en AWS -> %s\n", buffer);
-    } else {
-      Serial.println("⚠ Fallo al publicar ubicación en AWS IoT");
+void enviarGeometriaCalle() {
+  if (verticesCalle.cantidad() < 2 || verticesDesbordados) {
+    return;
+  }
+  uint32_t seq = colaEnvio.siguienteSecuencia();
+  MensajeEnArmado mensaje = armarMensaje(COLA_TOPICO_PEDIDOS, TAMANO_MENSAJE_LOTE);
+  uint32_t inicioCodificacion = micros();
+  size_t largo =
+      verticesCalle.codificarBinario(seq, contadorCalles, mensaje.datos, mensaje.capacidad, TRAMA_GEOMETRIA);
+  registrarCodificacion(micros() - inicioCodificacion, largo);
+  publicarMensaje(mensaje, true, seq, largo, "geometría calle");
+}
+
+void publicarGPS() {
+  // Contrapresión: la ubicación se vuelve a mandar en el próximo período,
+  // no vale la pena que le quite lugar al mapeo
+  if (bandejaMQTT.saturada()) {
+    Serial.printf("⚠ Bandeja MQTT saturada (%u libres): se omite la ubicación\n", (unsigned)bandejaMQTT.libres());
+    return;
+  }
+#if LOGIOT_GEOCERCAS
+  // Adentro de un depósito o punto de entrega el tablero ya sabe dónde está
+  // el camión por el evento de entrada: alcanza con un latido
+  if (geocercas.adentro()) {
+    if (millis() - ultimaUbicacionEnZona < parametros.valor(PARAM_INTERVALO_UBICACION_ZONA)) {
+      return;
     }
+    ultimaUbicacionEnZona = millis();
+  }
+#endif
+#if LOGIOT_BANDA_MUERTA
+  if (gps.location.isValid() && gps.satellites.value() >= 3 && !ubicacionParaReportar()) {
+    return;
+  }
+#endif
+#if LOGIOT_LOTES
+  if (gps.location.isValid() && gps.satellites.value() >= 3) {
+    if (loteUbicacion.agregar(gps.location.lat(), gps.location.lng(), millis())) {
+      enviarLoteMQTT(loteUbicacion, COLA_TOPICO_UBICACION, false, "lote ubicación");
+    }
+    return;
+  }
+#endif
+  if (gps.location.isValid() && gps.satellites.value() >= 3) {
+    uint32_t seq = colaEnvio.siguienteSecuencia();
+    MensajeEnArmado mensaje = armarMensaje(COLA_TOPICO_UBICACION, TAMANO_MENSAJE_MQTT);
+    uint32_t inicioCodificacion = micros();
+    PuntoGPS actual = {gps.location.lat(), gps.location.lng(), gps.course.deg(), gps.speed.kmph(),
+                       (int)gps.satellites.value(), gps.time.value()};
+#if LOGIOT_FORMATO_BINARIO
+    TramaMapeo m = tramaDesdePunto(actual, seq);
+    size_t largo = codificarUbicacion(m, mensaje.datos, mensaje.capacidad);
+#else
+    ContextoMensaje c = {DEVICE_ID, (uint32_t)millis(), seq, -1};
+#if LOGIOT_PERFIL
+    c.latenciaMs = (int32_t)(millis() - instanteSentenciaGps);
+#endif
+    size_t largo = codificarUbicacionJSON(actual, c, (char*)mensaje.datos, mensaje.capacidad);
+#endif
+    registrarCodificacion(micros() - inicioCodificacion, largo);
+
+    PERFIL_FIX_MENSAJE(instanteSentenciaGps);
+    publicarMensaje(mensaje, false, seq, largo, "ubicación");
   } else {
     Serial.printf("No se publica GPS: AWS=%s, Sats=%d\n", 
                   awsClient.connected() ? "Conectado" : "Desconectado", 
@@ -715,22 +1994,408 @@ void publicarGPS() {
   }
 }
 
-void publicarDiagnostico() {
-  
+#if LOGIOT_BANDA_MUERTA
+// El fix actual contra la extrapolación desde la última ubicación publicada
+bool ubicacionParaReportar() {
+  MuestraPosicion m = {gps.location.lat(), gps.location.lng(), (float)gps.speed.kmph(), (float)gps.course.deg(),
+                       (uint32_t)millis()};
+  MotivoReporte motivo = bandaMuerta.evaluar(m);
+  if (motivo == REPORTE_DESVIO) {
+    Serial.println("📍 Ubicación: se apartó de la predicción");
+  } else if (motivo == REPORTE_SILENCIO) {
+    Serial.println("📍 Ubicación: latido");
+  }
+  return motivo != REPORTE_NINGUNO;
+}
+
+// Fixes evaluados contra publicados desde el reporte anterior
+void reportarBandaMuerta() {
+  const EstadisticasBandaMuerta& e = bandaMuerta.estadisticas();
+  if (e.evaluadas == 0) return;
+  uint32_t publicadas = e.primeros + e.desvios + e.silencios;
+  // Los que habría mandado el intervalo fijo en el mismo lapso
+  uint32_t fijos = e.evaluadas * INTERVALO_EVALUACION_UBICACION / INTERVALO_ENVIO_UBICACION;
+  Serial.printf("📍 Banda muerta: %lu fixes, %lu publicados (%lu desvío, %lu latido), con intervalo fijo %lu, "
+                "peor error omitido=%.1f m\n",
+                (unsigned long)e.evaluadas, (unsigned long)publicadas, (unsigned long)e.desvios, (unsigned long)e.silencios,
+                (unsigned long)fijos, e.peorErrorOmitidoM);
+  bandaMuerta.reiniciarEstadisticas();
+}
+#endif
+
+#if LOGIOT_GEOCERCAS
+// LittleFS ya está montado por iniciarCola()
+void iniciarGeocercas() {
+  geocercasDisponibles = almacenGeocercas.iniciar();
+  if (!geocercasDisponibles) {
+    Serial.println("⚠ Geocercas: sin almacén en flash, no se aceptan cargas");
+  } else if (geocercas.iniciar()) {
+    Serial.printf("✔ Geocercas v%lu: %lu zonas\n", (unsigned long)geocercas.version(), (unsigned long)geocercas.zonas());
+  } else {
+    Serial.println("Geocercas: ninguna cargada todavía");
+  }
+}
+
+// Los eventos son pocos y van siempre en JSON, también con el formato binario
+void avisoGeocerca(EventoGeocerca evento, uint32_t idZona, uint32_t duracionMs) {
+  static const char* NOMBRES_EVENTO[] = {"entrada", "salida", "permanencia"};
+  uint32_t seq = colaEnvio.siguienteSecuencia();
+  MensajeEnArmado mensaje = armarMensaje(COLA_TOPICO_EVENTOS, TAMANO_MENSAJE_MQTT);
+  uint32_t inicioCodificacion = micros();
   StaticJsonDocument<256> doc;
   doc["device_id"] = DEVICE_ID;
+  doc["evento"] = NOMBRES_EVENTO[evento];
+  doc["zona"] = idZona;
+  doc["version_zonas"] = geocercas.version();
+  doc["latitud"] = gps.location.lat();
+  doc["longitud"] = gps.location.lng();
+  if (evento != GEOCERCA_ENTRADA) {
+    doc["duracion_ms"] = duracionMs;
+  }
+  doc["timestamp"] = millis();
+  doc["seq"] = seq;
+  size_t largo = serializeJson(doc, (char*)mensaje.datos, mensaje.capacidad);
+  registrarCodificacion(micros() - inicioCodificacion, largo);
+  Serial.printf("📌 Zona %lu: %s\n", (unsigned long)idZona, NOMBRES_EVENTO[evento]);
+  publicarMensaje(mensaje, true, seq, largo, "evento de zona");
+}
+
+// QoS 0, como la respuesta a los comandos
+void responderGeocercas() {
+  if (!awsClient.connected()) {
+    return;
+  }
+  respuestaGeocercasPendiente = false;
+  char* buffer = mensajeQoS0();
+  int largo = snprintf(buffer, TAMANO_MENSAJE_DIAGNOSTICO,
+                       "{\"device_id\":\"%s\",\"resultado\":\"%s\",\"version\":%lu,\"zonas\":%lu}", DEVICE_ID,
+                       resultadoGeocercas == CARGA_COMPLETA ? "en_uso" : Geocercas::descripcion(resultadoGeocercas),
+                       (unsigned long)geocercas.version(), (unsigned long)geocercas.zonas());
+  publicarQoS0(TOPICO_MQTT_GEOCERCAS_RESPUESTA, largo);
+}
+
+// Acumulado desde el arranque
+void reportarGeocercas() {
+  const EstadisticasGeocercas& e = geocercas.estadisticas();
+  Serial.printf("📌 Geocercas v%lu: %lu zonas, %lu fixes, %lu cambios de celda, %lu lecturas de flash, %lu eventos, "
+                "candidatos max=%u, celdas truncadas=%lu, sin lugar=%lu, adentro=%s\n",
+                (unsigned long)geocercas.version(), (unsigned long)geocercas.zonas(), (unsigned long)e.evaluaciones,
+                (unsigned long)e.cambiosCelda, (unsigned long)e.lecturas, (unsigned long)e.eventos,
+                (unsigned)e.candidatosMax, (unsigned long)e.truncados, (unsigned long)e.sinLugar,
+                geocercas.adentro() ? "si" : "no");
+}
+#endif
+
+#if LOGIOT_CALLES_CONOCIDAS
+// LittleFS ya está montado por iniciarCola()
+void iniciarCalles() {
+  grafoCallesDisponible = almacenCalles.iniciar();
+  if (!grafoCallesDisponible) {
+    Serial.println("⚠ Calles: sin almacén en flash, no se aceptan cargas");
+  } else if (grafoCalles.iniciar()) {
+    Serial.printf("✔ Calles v%lu: %lu tramos\n", (unsigned long)grafoCalles.version(),
+                  (unsigned long)grafoCalles.tramos());
+  } else {
+    Serial.println("Calles: ninguna cargada todavía");
+  }
+}
+
+// Después de cada fix aceptado del mapeo. Al entrar o salir de las calles
+// conocidas se corta la calle, como en un giro; también cuando el recorrido
+// ya no tiene lugar para otro tramo
+void emparejarFix() {
+  PuntoGPS p = procesadorGPS.puntoFiltrado(millis());
+  CambioEmparejamiento cambio = grafoCalles.emparejar(gradosAE6(p.lat), gradosAE6(p.lon), p.rumbo, p.velocidad);
+  bool cortar = (cambio == EMPAREJAMIENTO_CONOCIDA || cambio == EMPAREJAMIENTO_NUEVA);
+  if (cambio == EMPAREJAMIENTO_OTRO_TRAMO && grafoCalles.largoRecorrido() == GRAFO_MAX_RECORRIDO) {
+    cortar = true;
+  }
+  if (!cortar) {
+    return;
+  }
+  if (cambio == EMPAREJAMIENTO_CONOCIDA) {
+    Serial.printf("🗺 Calle conocida: tramo %lu\n", (unsigned long)grafoCalles.tramoActual());
+  } else if (cambio == EMPAREJAMIENTO_NUEVA) {
+    Serial.println("🗺 Fuera de las calles conocidas, se vuelve a mapear");
+  }
+  enviarFinMapeoMQTT();
+  calleConocida = grafoCalles.enConocida();
+  contadorCalles++;
+  snprintf(idCalleActual, sizeof(idCalleActual), "CALLE_%d", contadorCalles);
+  enviarInicioMapeoMQTT();
+  actualizarPantalla();
+}
+
+// QoS 0, como la respuesta de las geocercas
+void responderCalles() {
+  if (!awsClient.connected()) {
+    return;
+  }
+  respuestaCallesPendiente = false;
+  char* buffer = mensajeQoS0();
+  int largo = snprintf(buffer, TAMANO_MENSAJE_DIAGNOSTICO,
+                       "{\"device_id\":\"%s\",\"resultado\":\"%s\",\"version\":%lu,\"tramos\":%lu}", DEVICE_ID,
+                       resultadoCalles == CARGA_COMPLETA ? "en_uso" : Geocercas::descripcion(resultadoCalles),
+                       (unsigned long)grafoCalles.version(), (unsigned long)grafoCalles.tramos());
+  publicarQoS0(TOPICO_MQTT_CALLES_RESPUESTA, largo);
+}
+
+// Acumulado desde el arranque
+void reportarCalles() {
+  const EstadisticasGrafo& e = grafoCalles.estadisticas();
+  Serial.printf("🗺 Calles v%lu: %lu tramos, %lu fixes, %lu emparejados, %lu cambios de celda, %lu lecturas de flash, "
+                "candidatos max=%u, celdas truncadas=%lu, vértices omitidos=%lu, conocida=%s\n",
+                (unsigned long)grafoCalles.version(), (unsigned long)grafoCalles.tramos(), (unsigned long)e.fixes,
+                (unsigned long)e.emparejados, (unsigned long)e.cambiosCelda, (unsigned long)e.lecturas,
+                (unsigned)e.candidatosMax, (unsigned long)e.truncados, (unsigned long)verticesOmitidos,
+                calleConocida ? "si" : "no");
+}
+#endif
+
+// Publica el lote completo en un solo mensaje y lo vacía
+void enviarLoteMQTT(LoteTrayecto& lote, uint8_t idTopico, bool prioritario, const char* descripcion) {
+  if (lote.vacio()) {
+    return;
+  }
+  uint32_t seq = colaEnvio.siguienteSecuencia();
+  MensajeEnArmado mensaje = armarMensaje(idTopico, TAMANO_MENSAJE_LOTE);
+  uint32_t inicioCodificacion = micros();
+#if LOGIOT_FORMATO_BINARIO
+  size_t largo = lote.codificarBinario(seq, contadorCalles, mensaje.datos, mensaje.capacidad);
+#else
+  // Estáticos: en el ESP8266 la pila del loop es de 4 KB
+  static char polyline[TAMANO_MENSAJE_LOTE / 2];
+  static char tiempos[TRAMA_LOTE_MAX_PUNTOS * 2 + 1];
+  lote.codificarPolyline(polyline, sizeof(polyline));
+  lote.codificarTiempos(tiempos, sizeof(tiempos));
+  const PuntoLote& ultimo = lote.punto(lote.cantidad() - 1);
+
+  StaticJsonDocument<384> doc;
+  if (idTopico == COLA_TOPICO_PEDIDOS) {
+    doc["id"] = idCalleActual;
+  } else {
+    // Compatibilidad con los consumidores de ubicación: última posición del lote
+    doc["latitud"] = ultimo.latE6 / 1e6;
+    doc["longitud"] = ultimo.lonE6 / 1e6;
+  }
+  doc["tipo"] = "lote";
+  doc["device_id"] = DEVICE_ID;
+  doc["n"] = lote.cantidad();
+  doc["t0"] = lote.punto(0).tiempoMs;
+  doc["polyline"] = (const char*)polyline;
+  doc["dt"] = (const char*)tiempos;
+  doc["timestamp"] = millis();
+  doc["seq"] = seq;
+#if LOGIOT_PERFIL
+  // La latencia de un lote es la de su punto más viejo
+  doc["latencia_ms"] = millis() - lote.punto(0).tiempoMs;
+#endif
+  size_t largo = serializeJson(doc, (char*)mensaje.datos, mensaje.capacidad);
+#endif
+  registrarCodificacion(micros() - inicioCodificacion, largo);
+
+  Serial.printf("📦 %s: %u puntos en %u bytes\n", descripcion, lote.cantidad(), (unsigned)largo);
+  PERFIL_FIX_MENSAJE(lote.punto(0).tiempoMs);
+  lote.vaciar();
+  publicarMensaje(mensaje, prioritario, seq, largo, descripcion);
+}
+
+// Va directo a la bandeja QoS 1 solo si hay conexión y la cola está vacía;
+// si no, el mensaje va a la cola para no desordenarse respecto de los que
+// esperan en flash
+MensajeEnArmado armarMensaje(uint8_t idTopico, size_t capacidad) {
+  MensajeEnArmado mensaje = {idTopico, nullptr, capacidad, false, ESP.getCycleCount()};
+  if (awsClient.connected() && (colaEnvio.vacia() || !colaDisponible)) {
+    mensaje.datos = bandejaMQTT.reservarMensaje(topicoDeCola(idTopico), capacidad);
+    mensaje.enBandeja = (mensaje.datos != nullptr);
+  }
+  if (!mensaje.enBandeja) {
+    mensaje.datos = bufferSalida;
+  }
+  return mensaje;
+}
+
+// El mensaje armado en bufferSalida todavía puede entrar en la bandeja con
+// su largo real, copiándolo; si no, o si la bandeja está llena, va a la cola
+void publicarMensaje(const MensajeEnArmado& mensaje, bool prioritario, uint32_t seq, size_t largo, const char* descripcion) {
+#if LOGIOT_PERFIL
+  // Se consume acá para que no quede pegado al próximo mensaje sin posición
+  uint32_t instanteFix = instanteFixMensaje;
+  instanteFixMensaje = 0;
+#endif
+  if (largo == 0) {
+    // El codificador no pudo armarlo: no hay nada que publicar
+    if (mensaje.enBandeja) bandejaMQTT.descartarMensaje();
+    return;
+  }
+  bool enBandeja = false;
+  if (mensaje.enBandeja) {
+    enBandeja = bandejaMQTT.confirmarMensaje(largo, seq);
+    registrarEntrega(mensaje, 0);
+  } else if (awsClient.connected() && (colaEnvio.vacia() || !colaDisponible)) {
+    enBandeja = bandejaMQTT.encolar(topicoDeCola(mensaje.idTopico), mensaje.datos, largo, seq);
+    if (enBandeja) {
+      registrarEntrega(mensaje, largo);
+    } else {
+      Serial.printf("⚠ Bandeja MQTT llena (%u en vuelo, %u mensajes): %s a la cola\n", (unsigned)bandejaMQTT.enVuelo(),
+                    (unsigned)bandejaMQTT.mensajes(), descripcion);
+    }
+  }
+  if (enBandeja) {
+#if LOGIOT_PERFIL
+    // Los que pasan por la cola no cuentan: su demora es la del corte
+    if (instanteFix != 0) histogramaLatenciaFix.registrar(millis() - instanteFix);
+#endif
+#if LOGIOT_FORMATO_BINARIO
+    Serial.printf("📮 %s a la bandeja para %s (%u bytes)\n", descripcion, topicoDeCola(mensaje.idTopico).nombre,
+                  (unsigned)largo);
+#else
+    Serial.printf("📮 %s a la bandeja para %s -> %.*s\n", descripcion, topicoDeCola(mensaje.idTopico).nombre,
+                  (int)largo, (const char*)mensaje.datos);
+#endif
+    return;
+  }
+  if (!colaDisponible) {
+    Serial.printf("⚠ No se publica %s: AWS IoT desconectado y sin cola\n", descripcion);
+    return;
+  }
+  if (colaEnvio.encolar(mensaje.idTopico, prioritario, seq, mensaje.datos, largo)) {
+    registrarEntrega(mensaje, largo);
+    Serial.printf("💾 %s encolado (seq=%lu, pendientes=%lu)\n", descripcion,
+                  (unsigned long)seq, (unsigned long)colaEnvio.cantidadPendientes());
+  } else {
+    Serial.printf("⚠ Cola llena: se descarta %s (seq=%lu)\n", descripcion, (unsigned long)seq);
+  }
+}
+
+const TopicoMQTT& topicoDeCola(uint8_t idTopico) {
+#if LOGIOT_GEOCERCAS
+  if (idTopico == COLA_TOPICO_EVENTOS) {
+    return TOPICO_MQTT_EVENTOS;
+  }
+#endif
+  return idTopico == COLA_TOPICO_UBICACION ? TOPICO_MQTT_UBICACION : TOPICO_MQTT_PEDIDOS;
+}
+
+// La cola da el mensaje por enviado cuando entra en la bandeja; si no entra,
+// el drenaje se corta y se reintenta en la próxima pasada
+bool enviarDesdeCola(uint8_t idTopico, uint32_t seq, const uint8_t* datos, size_t largo) {
+  if (!awsClient.connected()) {
+    return false;
+  }
+  return bandejaMQTT.encolar(topicoDeCola(idTopico), datos, largo, seq);
+}
+
+// Dónde codificar un mensaje QoS 0 de hasta TAMANO_MENSAJE_DIAGNOSTICO bytes
+char* mensajeQoS0() {
+  return (char*)bufferQoS0 + RESERVA_CABECERA_QOS0;
+}
+
+// Cabecera delante del mensaje y un solo write(); como publish(), sin
+// reintento si el socket no lo acepta
+bool publicarQoS0(const TopicoMQTT& topico, size_t largo) {
+  if (!awsClient.connected() || largo > TAMANO_MENSAJE_DIAGNOSTICO ||
+      reservaPublish(topico, 0) > RESERVA_CABECERA_QOS0) {
+    return false;
+  }
+  size_t largoPaquete;
+  uint8_t* paquete = armarPublish(bufferQoS0 + RESERVA_CABECERA_QOS0, largo, topico, 0, largoPaquete);
+  return salidaBandeja.escribir(paquete, largoPaquete);
+}
+
+void confirmacionMQTT(uint32_t seq) {
+  ultimoSeqConfirmado = seq;
+}
+
+TramaMapeo tramaDesdePunto(const PuntoGPS& p, uint32_t seq) {
+  TramaMapeo m = {};
+  m.seq = seq;
+  m.calle = contadorCalles;
+  m.latE7 = gradosAE7(p.lat);
+  m.lonE7 = gradosAE7(p.lon);
+  m.velocidadCentiKmh = aCentesimas(p.velocidad);
+  m.rumboCentiGrados = aCentesimas(p.rumbo);
+  m.tiempoGps = p.tiempo;
+  m.timestamp = millis();
+  m.satelites = p.satelites;
+  m.precisionBaja = (p.satelites < 4);
+  return m;
+}
+
+// Tiempo de codificación y bytes en el cable del formato activo
+void registrarCodificacion(uint32_t duracionUs, size_t largo) {
+  medicionCodificacion.mensajes++;
+  medicionCodificacion.bytes += largo;
+  medicionCodificacion.totalUs += duracionUs;
+  if (duracionUs > medicionCodificacion.peorUs) medicionCodificacion.peorUs = duracionUs;
+#if LOGIOT_PERFIL
+  histogramasFases[FASE_CODIFICAR].registrar(duracionUs * ESP.getCpuFreqMHz());
+#endif
+}
+
+void registrarEntrega(const MensajeEnArmado& mensaje, uint32_t copiados) {
+  uint32_t ciclos = ESP.getCycleCount() - mensaje.inicioCiclos;
+  medicionEntrega.mensajes++;
+  medicionEntrega.copiados += copiados;
+  medicionEntrega.totalCiclos += ciclos;
+  if (ciclos > medicionEntrega.peorCiclos) medicionEntrega.peorCiclos = ciclos;
+}
+
+void publicarDiagnostico() {
+  char* buffer = mensajeQoS0();
+  uint32_t inicioCodificacion = micros();
+#if LOGIOT_FORMATO_BINARIO
+  TramaDiagnostico d = {};
+  d.timestamp = millis();
+  d.satelites = gps.satellites.value();
+  d.wifi = (WiFi.status() == WL_CONNECTED);
+  d.mqtt = awsClient.connected();
+  d.gps = gps.satellites.isValid() && gps.satellites.value() >= 3;
+  d.colaPendientes = colaEnvio.cantidadPendientes();
+  const EstadisticasNMEA& nmea = filtroNMEA.estadisticas();
+  d.sentenciasGps = nmea.sentencias;
+  d.descartadasGps = nmea.descartadas();
+  d.desbordesGps = nmea.desbordesUart;
+  size_t largo = codificarDiagnostico(d, (uint8_t*)buffer, TAMANO_MENSAJE_DIAGNOSTICO);
+#else
+  StaticJsonDocument<384> doc;
+  doc["device_id"] = DEVICE_ID;
   doc["estado_wifi"] = (WiFi.status() == WL_CONNECTED) ? "Conectado" : "Desconectado";
   doc["estado_mqtt"] = awsClient.connected() ? "Conectado" : "Desconectado";
   doc["estado_gps"] = (gps.satellites.isValid() && gps.satellites.value() >= 3) ? "Señal OK" : "Sin señal";
   doc["satelites_gps"] = gps.satellites.value();
   doc["timestamp"] = millis();
-
-  char buffer[256];
-  serializeJson(doc, buffer);
+  doc["cola_pendientes"] = colaEnvio.cantidadPendientes();
+  doc["distancia_m"] = procesadorGPS.distanciaCm() / 100;
+  const EstadisticasNMEA& nmea = filtroNMEA.estadisticas();
+  doc["gps_bytes"] = nmea.bytes;
+  doc["gps_sentencias"] = nmea.sentencias;
+  doc["gps_descartadas"] = nmea.descartadas();
+  doc["gps_desbordes"] = nmea.desbordesUart;
+  doc["heap_libre"] = ESP.getFreeHeap();
+  doc["heap_bloque_max"] = ESP.getMaxFreeBlockSize();
+  doc["heap_frag"] = ESP.getHeapFragmentation();
+  if (rastreoHeapActivo()) {
+    doc["heap_asignaciones"] = estadisticasHeap().asignaciones;
+  }
+#if LOGIOT_GEOCERCAS
+  doc["geocercas_version"] = geocercas.version();
+  doc["geocercas_zonas"] = geocercas.zonas();
+#endif
+#if LOGIOT_CALLES_CONOCIDAS
+  doc["calles_version"] = grafoCalles.version();
+  doc["calles_tramos"] = grafoCalles.tramos();
+#endif
+  size_t largo = serializeJson(doc, buffer, TAMANO_MENSAJE_DIAGNOSTICO);
+#endif
+  registrarCodificacion(micros() - inicioCodificacion, largo);
   
   if (awsClient.connected()) {
-    if (awsClient.publish(AWS_TOPIC_INFO, buffer)) {
-      Serial.printf("Diagnóstico publicado en AWS -> %s\n", buffer);
+    PERFIL_INICIO(FASE_PUBLICAR);
+    bool publicado = publicarQoS0(TOPICO_MQTT_INFO, largo);
+    PERFIL_FIN(FASE_PUBLICAR);
+    if (publicado) {
+      Serial.printf("Diagnóstico publicado en AWS (%u bytes)\n", (unsigned)largo);
     } else {
       Serial.println("Fallo al publicar diagnóstico en AWS IoT");
     }
@@ -746,31 +2411,39 @@ void iniciarMapeo() {
   if (estadoActual != ESTADO_MAPEO_ACTIVO) {
     if (gps.satellites.value() < 3) {
       Serial.println("No se puede iniciar mapeo: GPS sin fix");
-      lcd.clear();
-      lcd.setCursor(0, 0);
-      lcd.print("Error: GPS sin fix");
-      delay(2000);
+      pantalla.limpiar();
+      pantalla.cursor(0, 0);
+      pantalla.escribir("Error: GPS sin fix");
+      mostrarMensajeTemporal(2000);
       estadoActual = ESTADO_PANTALLA_PRINCIPAL;
-      actualizarPantalla();
       return;
     }
     mapeando = true;
     estadoActual = ESTADO_MAPEO_ACTIVO;
+    procesadorGPS.reiniciar();
+#if LOGIOT_CALLES_CONOCIDAS
+    grafoCalles.reiniciar();
+    calleConocida = false;
+#endif
+#if LOGIOT_RESUMEN_VIAJE
+    resumenViaje.iniciarViaje();
+    ultimoResumenViaje = millis();
+#endif
     contadorCalles++;
-    idCalleActual = "CALLE_" + String(contadorCalles);
+    snprintf(idCalleActual, sizeof(idCalleActual), "CALLE_%d", contadorCalles);
     enviarInicioMapeoMQTT();
-    Serial.println("Mapeo ACTIVADO - Calle: " + idCalleActual);
-    lcd.clear();
-    lcd.setCursor(0, 0);
-    lcd.print("Mapeo Iniciado!");
-    lcd.setCursor(0, 1);
-    lcd.print("Calle: " + idCalleActual);
+    Serial.printf("Mapeo ACTIVADO - Calle: %s\n", idCalleActual);
+    pantalla.limpiar();
+    pantalla.cursor(0, 0);
+    pantalla.escribir("Mapeo Iniciado!");
+    pantalla.cursor(0, 1);
+    pantalla.escribir("Calle: ");
+    pantalla.escribir(idCalleActual);
     if (gps.satellites.value() < 4) {
-      lcd.setCursor(0, 2);
-      lcd.print("Advert: Baja prec.");
+      pantalla.cursor(0, 2);
+      pantalla.escribir("Advert: Baja prec.");
     }
-    delay(1000);
-    actualizarPantalla();
+    mostrarMensajeTemporal(1000);
   }
 }
 
@@ -778,13 +2451,19 @@ void detenerMapeo() {
   if (estadoActual == ESTADO_MAPEO_ACTIVO) {
     mapeando = false;
     enviarFinMapeoMQTT();
+#if LOGIOT_RESUMEN_VIAJE
+    enviarResumenMQTT(true, true);
+#endif
+#if LOGIOT_CALLES_CONOCIDAS
+    grafoCalles.reiniciar();
+    calleConocida = false;
+#endif
     estadoActual = ESTADO_PANTALLA_PRINCIPAL;
     Serial.println("Mapeo DESACTIVADO");
-    lcd.clear();
-    lcd.setCursor(0, 0);
-    lcd.print("Mapeo Detenido");
-    delay(1000);
-    actualizarPantalla();
+    pantalla.limpiar();
+    pantalla.cursor(0, 0);
+    pantalla.escribir("Mapeo Detenido");
+    mostrarMensajeTemporal(1000);
   }
 }
 
@@ -792,28 +2471,28 @@ void detenerMapeo() {
 // === FUNCIONES DEL MENÚ y LCD ===
 // ===================================
 void mostrarMenu() {
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("<< Menu >>");
-  lcd.setCursor(0, 1);
-  lcd.print(opcionActual == 0 ? ">> " : "   ");
-  lcd.print(opcionesMenu[0]);
-  lcd.setCursor(0, 2);
-  lcd.print(opcionActual == 1 ? ">> " : "   ");
-  lcd.print(opcionesMenu[1]);
-  lcd.setCursor(0, 3);
-  lcd.print(opcionActual == 2 ? ">> " : "   ");
-  lcd.print(opcionesMenu[2]);
+  pantalla.limpiar();
+  pantalla.cursor(0, 0);
+  pantalla.escribir("<< Menu >>");
+  pantalla.cursor(0, 1);
+  pantalla.escribir(opcionActual == 0 ? ">> " : "   ");
+  pantalla.escribir(opcionesMenu[0]);
+  pantalla.cursor(0, 2);
+  pantalla.escribir(opcionActual == 1 ? ">> " : "   ");
+  pantalla.escribir(opcionesMenu[1]);
+  pantalla.cursor(0, 3);
+  pantalla.escribir(opcionActual == 2 ? ">> " : "   ");
+  pantalla.escribir(opcionesMenu[2]);
 }
 
 void mostrarConfirmarReinicio() {
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Confirmar Reinicio");
-  lcd.setCursor(0, 1);
-  lcd.print("Seleccionar: SI");
-  lcd.setCursor(0, 2);
-  lcd.print("Desplazar: NO");
+  pantalla.limpiar();
+  pantalla.cursor(0, 0);
+  pantalla.escribir("Confirmar Reinicio");
+  pantalla.cursor(0, 1);
+  pantalla.escribir("Seleccionar: SI");
+  pantalla.cursor(0, 2);
+  pantalla.escribir("Desplazar: NO");
 }
 
 void manejarBotones() {
@@ -871,7 +2550,15 @@ void manejarBotones() {
   ultimoEstadoDesplazar = estadoActualDesplazar;
 }
 
+// Mantiene en el LCD el mensaje actual durante 'duracion' ms sin bloquear
+void mostrarMensajeTemporal(unsigned long duracion) {
+  pantallaOcupadaHasta = millis() + duracion;
+}
+
 void actualizarPantalla() {
+  if ((long)(pantallaOcupadaHasta - millis()) > 0) {
+    return;
+  }
   switch (estadoActual) {
     case ESTADO_PANTALLA_PRINCIPAL: mostrarDashboard(); break;
     case ESTADO_MAPEO_ACTIVO:       mostrarPantallaMapeo(); break;
@@ -883,43 +2570,47 @@ void actualizarPantalla() {
 }
 
 void mostrarDashboard() {
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Status: Wi-Fi ");
-  lcd.print(WiFi.status() == WL_CONNECTED ? "OK" : "NO");
+  pantalla.limpiar();
+  pantalla.cursor(0, 0);
+  pantalla.escribir("Status: Wi-Fi ");
+  pantalla.escribir(WiFi.status() == WL_CONNECTED ? "OK" : "NO");
   
-  lcd.setCursor(0, 1);
-  lcd.print("MQTT: ");
-  lcd.print(awsClient.connected() ? "OK" : "NO");
+  pantalla.cursor(0, 1);
+  pantalla.escribir("MQTT: ");
+  pantalla.escribir(awsClient.connected() ? "OK" : "NO");
 
-  lcd.setCursor(0, 2);
-  lcd.print("Lat:");
-  lcd.print(gps.location.isValid() ? gps.location.lat() : 0.0, 6);
+  pantalla.cursor(0, 2);
+  pantalla.escribir("Lat:");
+  pantalla.escribirDecimal(gps.location.isValid() ? gps.location.lat() : 0.0, 6);
   
-  lcd.setCursor(0, 3);
-  lcd.print("Lon:");
-  lcd.print(gps.location.isValid() ? gps.location.lng() : 0.0, 6);
+  pantalla.cursor(0, 3);
+  pantalla.escribir("Lon:");
+  pantalla.escribirDecimal(gps.location.isValid() ? gps.location.lng() : 0.0, 6);
   
-  lcd.setCursor(18, 0);
-  lcd.print("GPS");
-  lcd.setCursor(18, 1);
-  lcd.print(gps.satellites.isValid() ? String(gps.satellites.value()) : "NO");
+  pantalla.cursor(18, 0);
+  pantalla.escribir("GPS");
+  pantalla.cursor(18, 1);
+  if (gps.satellites.isValid()) {
+    pantalla.escribirEntero(gps.satellites.value());
+  } else {
+    pantalla.escribir("NO");
+  }
 }
 
 void mostrarPantallaMapeo() {
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("MAPEO: ACTIVO >>");
+  pantalla.limpiar();
+  pantalla.cursor(0, 0);
+  pantalla.escribir("MAPEO: ACTIVO >>");
   
-  lcd.setCursor(0, 1);
-  lcd.print("Calle:");
-  lcd.print(idCalleActual);
+  pantalla.cursor(0, 1);
+  pantalla.escribir("Calle:");
+  pantalla.escribir(idCalleActual);
   
-  lcd.setCursor(0, 2);
-  lcd.print("Lat:");
-  lcd.print(gps.location.isValid() ? gps.location.lat() : 0.0, 6);
+  pantalla.cursor(0, 2);
+  pantalla.escribir("Lat:");
+  pantalla.escribirDecimal(gps.location.isValid() ? gps.location.lat() : 0.0, 6);
   
-  lcd.setCursor(0, 3);
-  lcd.print("Lon:");
-  lcd.print(gps.location.isValid() ? gps.location.lng() : 0.0, 6);
+  pantalla.cursor(0, 3);
+  pantalla.escribir("Lon:");
+  pantalla.escribirDecimal(gps.location.isValid() ? gps.location.lng() : 0.0, 6);
 }
\ No newline at end of file
@@ -0,0 +1,91 @@
+// ====== Tests de lib/BandaMuerta ======
+// predecirPosicion() es el contrato con el tablero: los valores esperados
+// salen de la misma cuenta en JavaScript (Servicios_AWS/templates/index.html),
+// así un cambio de un solo lado rompe el test. Además, cuándo el equipo
+// publica: primer fix, desvío, latido y después de reiniciar.
+
+#include <unity.h>
+
+#include <math.h>
+
+#include <BandaMuerta.h>
+#include <Geodesia.h>
+
+static const ConfigBandaMuerta CONFIG = {20.0f, 60000, 5.0f};
+
+// 36 km/h = 10 m/s con rumbo 45°, desde Buenos Aires
+static const MuestraPosicion REFERENCIA = {-34.6, -58.4, 36.0f, 45.0f, 1000};
+
+void setUp() {}
+void tearDown() {}
+
+void test_modelo_igual_al_tablero() {
+  double lat, lon;
+  predecirPosicion(REFERENCIA, REFERENCIA.tiempoMs + 10000, CONFIG.velocidadMinimaKmh, lat, lon);
+  // predecirPosicion(device, fixMs + 10000) en el tablero
+  TEST_ASSERT_DOUBLE_WITHIN(1e-6, -34.5993641, lat);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-6, -58.3992274, lon);
+  TEST_ASSERT_DOUBLE_WITHIN(0.5, 100.0, distanciaHaversine(REFERENCIA.lat, REFERENCIA.lon, lat, lon));
+}
+
+void test_lento_se_predice_detenido() {
+  MuestraPosicion lenta = REFERENCIA;
+  lenta.velocidadKmh = 4.0f;
+  double lat, lon;
+  predecirPosicion(lenta, lenta.tiempoMs + 30000, CONFIG.velocidadMinimaKmh, lat, lon);
+  TEST_ASSERT_TRUE(lat == lenta.lat);
+  TEST_ASSERT_TRUE(lon == lenta.lon);
+}
+
+void test_sobre_la_prediccion_no_publica() {
+  BandaMuerta banda(CONFIG);
+  TEST_ASSERT_EQUAL_UINT8(REPORTE_PRIMERO, banda.evaluar(REFERENCIA));
+  for (uint32_t s = 1; s <= 10; s++) {
+    MuestraPosicion m = REFERENCIA;
+    m.tiempoMs = REFERENCIA.tiempoMs + s * 1000;
+    predecirPosicion(REFERENCIA, m.tiempoMs, CONFIG.velocidadMinimaKmh, m.lat, m.lon);
+    TEST_ASSERT_EQUAL_UINT8(REPORTE_NINGUNO, banda.evaluar(m));
+  }
+  TEST_ASSERT_EQUAL_UINT32(11, banda.estadisticas().evaluadas);
+  TEST_ASSERT_TRUE(banda.estadisticas().peorErrorOmitidoM < 0.5f);
+}
+
+void test_desvio_publica_y_cambia_la_referencia() {
+  BandaMuerta banda(CONFIG);
+  banda.evaluar(REFERENCIA);
+  // Dobla: 10 s después está 100 m al este de la referencia y no al noreste
+  MuestraPosicion dobla = REFERENCIA;
+  dobla.tiempoMs += 10000;
+  dobla.lon += 100.0 / (RADIO_TIERRA_M * M_PI / 180.0 * cos(REFERENCIA.lat * M_PI / 180.0));
+  dobla.rumbo = 90.0f;
+  TEST_ASSERT_TRUE(banda.errorPrediccion(dobla) > CONFIG.errorMaximoM);
+  TEST_ASSERT_EQUAL_UINT8(REPORTE_DESVIO, banda.evaluar(dobla));
+  TEST_ASSERT_EQUAL_UINT32(dobla.tiempoMs, banda.referencia().tiempoMs);
+}
+
+void test_latido_y_reinicio() {
+  BandaMuerta banda(CONFIG);
+  MuestraPosicion quieto = REFERENCIA;
+  quieto.velocidadKmh = 0.0f;
+  banda.evaluar(quieto);
+  quieto.tiempoMs += CONFIG.silencioMaximoMs - 1;
+  TEST_ASSERT_EQUAL_UINT8(REPORTE_NINGUNO, banda.evaluar(quieto));
+  quieto.tiempoMs += 1;
+  TEST_ASSERT_EQUAL_UINT8(REPORTE_SILENCIO, banda.evaluar(quieto));
+
+  banda.reiniciar();
+  quieto.tiempoMs += 1000;
+  TEST_ASSERT_EQUAL_UINT8(REPORTE_PRIMERO, banda.evaluar(quieto));
+  TEST_ASSERT_EQUAL_UINT32(2, banda.estadisticas().primeros);
+  TEST_ASSERT_EQUAL_UINT32(1, banda.estadisticas().silencios);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_modelo_igual_al_tablero);
+  RUN_TEST(test_lento_se_predice_detenido);
+  RUN_TEST(test_sobre_la_prediccion_no_publica);
+  RUN_TEST(test_desvio_publica_y_cambia_la_referencia);
+  RUN_TEST(test_latido_y_reinicio);
+  return UNITY_END();
+}
@@ -0,0 +1,257 @@
+// ====== Tests de lib/BandejaMQTT ======
+// El PUBLISH armado byte a byte, el mismo paquete por encolar() y armado en
+// su lugar, reservas descartadas (también al dar la vuelta al buffer),
+// reenvíos con DUP y muchas vueltas del buffer con largos distintos.
+
+#include <unity.h>
+
+#include <BandejaMQTT.h>
+
+#include <string.h>
+
+static const char* TOPICO = "logistica/pedidos";
+
+// Guarda lo que escribe enviar(), paquete por paquete
+class SalidaMemoria : public SalidaMQTT {
+ public:
+  bool escribir(const uint8_t* datos, size_t largo) override {
+    if (usado + largo > sizeof(bytes)) return false;
+    memcpy(bytes + usado, datos, largo);
+    ultimo = bytes + usado;
+    ultimoLargo = largo;
+    usado += largo;
+    return true;
+  }
+  void vaciar() { usado = 0; }
+
+  uint8_t bytes[4096];
+  size_t usado = 0;
+  const uint8_t* ultimo = nullptr;
+  size_t ultimoLargo = 0;
+};
+
+static uint32_t ultimaMarca = 0;
+static void anotarMarca(uint32_t marca) {
+  ultimaMarca = marca;
+}
+
+static void puback(BandejaMQTT& bandeja, uint16_t id) {
+  bandeja.recibir(0x40, 0);
+  bandeja.recibir(0x02, 0);
+  bandeja.recibir((uint8_t)(id >> 8), 0);
+  bandeja.recibir((uint8_t)id, 0);
+}
+
+static uint16_t idDe(const uint8_t* paquete, size_t posicion) {
+  return (uint16_t)((paquete[posicion] << 8) | paquete[posicion + 1]);
+}
+
+void setUp() {
+  ultimaMarca = 0;
+}
+void tearDown() {}
+
+void test_publish_qos1_armado() {
+  BandejaMQTTFija<256> bandeja(ConfigBandeja{4});
+  SalidaMemoria salida;
+  const uint8_t datos[] = {'h', 'o', 'l', 'a'};
+  TEST_ASSERT_TRUE(bandeja.encolar(TOPICO, datos, sizeof(datos), 7));
+  TEST_ASSERT_EQUAL_UINT8(1, bandeja.enviar(salida, 0));
+
+  const uint8_t esperado[] = {0x32, 2 + 17 + 2 + 4, 0, 17, 'l', 'o', 'g', 'i', 's', 't', 'i', 'c', 'a',
+                              '/',  'p',            'e', 'd', 'i', 'd', 'o', 's', 0,   1,   'h', 'o', 'l', 'a'};
+  TEST_ASSERT_EQUAL_UINT32(sizeof(esperado), salida.usado);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(esperado, salida.bytes, sizeof(esperado));
+}
+
+void test_en_su_lugar_igual_que_copiando() {
+  BandejaMQTTFija<512> copiando(ConfigBandeja{4});
+  BandejaMQTTFija<512> enSuLugar(ConfigBandeja{4});
+  SalidaMemoria salidaCopia;
+  SalidaMemoria salidaLugar;
+  TopicoMQTT topico = topicoMQTT(TOPICO);
+
+  // 200 bytes: el largo restante ya ocupa dos bytes
+  uint8_t datos[200];
+  for (size_t i = 0; i < sizeof(datos); i++) datos[i] = (uint8_t)(i * 7);
+  TEST_ASSERT_TRUE(copiando.encolar(topico, datos, sizeof(datos), 1));
+
+  uint8_t* destino = enSuLugar.reservarMensaje(topico, 300);
+  TEST_ASSERT_NOT_NULL(destino);
+  memcpy(destino, datos, sizeof(datos));
+  TEST_ASSERT_TRUE(enSuLugar.confirmarMensaje(sizeof(datos), 1));
+
+  // Lo que sobró de la reserva volvió a la bandeja
+  TEST_ASSERT_EQUAL_UINT16(copiando.libres(), enSuLugar.libres());
+  TEST_ASSERT_EQUAL_UINT32(sizeof(datos), copiando.estadisticas().copiados);
+  TEST_ASSERT_EQUAL_UINT32(0, enSuLugar.estadisticas().copiados);
+  TEST_ASSERT_EQUAL_UINT32(1, enSuLugar.estadisticas().enSuLugar);
+
+  copiando.enviar(salidaCopia, 0);
+  enSuLugar.enviar(salidaLugar, 0);
+  TEST_ASSERT_EQUAL_UINT32(salidaCopia.usado, salidaLugar.usado);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(salidaCopia.bytes, salidaLugar.bytes, salidaCopia.usado);
+  TEST_ASSERT_EQUAL_UINT8(0x32, salidaLugar.bytes[0]);
+  TEST_ASSERT_EQUAL_UINT8(0x80 | ((2 + 17 + 2 + 200) & 0x7F), salidaLugar.bytes[1]);
+}
+
+void test_reserva_descartada_no_ocupa() {
+  BandejaMQTTFija<256> bandeja(ConfigBandeja{4});
+  TopicoMQTT topico = topicoMQTT(TOPICO);
+  const uint8_t datos[40] = {};
+  TEST_ASSERT_TRUE(bandeja.encolar(topico, datos, sizeof(datos), 1));
+  uint16_t libres = bandeja.libres();
+
+  TEST_ASSERT_NOT_NULL(bandeja.reservarMensaje(topico, 100));
+  // Con una reserva abierta no se abre otra
+  TEST_ASSERT_NULL(bandeja.reservarMensaje(topico, 10));
+  bandeja.descartarMensaje();
+  TEST_ASSERT_EQUAL_UINT16(libres, bandeja.libres());
+  TEST_ASSERT_EQUAL_UINT16(1, bandeja.mensajes());
+
+  // Un largo de 0 también descarta
+  TEST_ASSERT_NOT_NULL(bandeja.reservarMensaje(topico, 100));
+  TEST_ASSERT_FALSE(bandeja.confirmarMensaje(0, 2));
+  TEST_ASSERT_EQUAL_UINT16(libres, bandeja.libres());
+  // Más de lo que entra no se reserva
+  TEST_ASSERT_NULL(bandeja.reservarMensaje(topico, 256));
+}
+
+void test_reserva_descartada_al_dar_la_vuelta() {
+  BandejaMQTTFija<256> bandeja(ConfigBandeja{4});
+  bandeja.alConfirmar(anotarMarca);
+  SalidaMemoria salida;
+  TopicoMQTT topico = topicoMQTT(TOPICO);
+  const uint8_t datos[60] = {};
+  // Tres de 60 (16 + 25 + 60 = 101 bytes cada uno): se confirma el primero
+  // y la reserva siguiente no entra al final, va al comienzo con relleno
+  TEST_ASSERT_TRUE(bandeja.encolar(topico, datos, sizeof(datos), 1));
+  TEST_ASSERT_TRUE(bandeja.encolar(topico, datos, sizeof(datos), 2));
+  bandeja.enviar(salida, 0);
+  puback(bandeja, 1);
+  TEST_ASSERT_EQUAL_UINT32(1, ultimaMarca);
+  uint16_t libres = bandeja.libres();
+
+  TEST_ASSERT_NOT_NULL(bandeja.reservarMensaje(topico, 50));
+  TEST_ASSERT_TRUE(bandeja.libres() < libres - 50);
+  bandeja.descartarMensaje();
+  TEST_ASSERT_EQUAL_UINT16(libres, bandeja.libres());
+
+  // El siguiente armado en su lugar sale detrás del que quedó en vuelo
+  uint8_t* destino = bandeja.reservarMensaje(topico, 50);
+  TEST_ASSERT_NOT_NULL(destino);
+  memset(destino, 0xAB, 30);
+  TEST_ASSERT_TRUE(bandeja.confirmarMensaje(30, 3));
+  salida.vaciar();
+  TEST_ASSERT_EQUAL_UINT8(1, bandeja.enviar(salida, 0));
+  TEST_ASSERT_EQUAL_UINT32(1 + 1 + 2 + 17 + 2 + 30, salida.ultimoLargo);
+  TEST_ASSERT_EQUAL_UINT8(0xAB, salida.ultimo[salida.ultimoLargo - 1]);
+  puback(bandeja, 2);
+  puback(bandeja, 3);
+  TEST_ASSERT_EQUAL_UINT32(3, ultimaMarca);
+  TEST_ASSERT_TRUE(bandeja.vacia());
+  TEST_ASSERT_EQUAL_UINT16(256, bandeja.libres());
+}
+
+void test_reenvio_con_dup_y_mismo_id() {
+  BandejaMQTTFija<256> bandeja(ConfigBandeja{4});
+  SalidaMemoria salida;
+  TopicoMQTT topico = topicoMQTT(TOPICO);
+  uint8_t* destino = bandeja.reservarMensaje(topico, 64);
+  memcpy(destino, "abc", 3);
+  TEST_ASSERT_TRUE(bandeja.confirmarMensaje(3, 9));
+  bandeja.enviar(salida, 0);
+  TEST_ASSERT_EQUAL_UINT8(0x32, salida.ultimo[0]);
+  uint16_t id = idDe(salida.ultimo, 4 + 17);
+
+  bandeja.nuevaConexion();
+  TEST_ASSERT_EQUAL_UINT8(1, bandeja.enviar(salida, 0));
+  TEST_ASSERT_EQUAL_UINT8(0x3A, salida.ultimo[0]);
+  TEST_ASSERT_EQUAL_UINT16(id, idDe(salida.ultimo, 4 + 17));
+  TEST_ASSERT_EQUAL_UINT32(1, bandeja.estadisticas().reenviados);
+  puback(bandeja, id);
+  TEST_ASSERT_TRUE(bandeja.vacia());
+}
+
+void test_muchas_vueltas_con_largos_distintos() {
+  BandejaMQTTFija<1024> bandeja(ConfigBandeja{4});
+  bandeja.alConfirmar(anotarMarca);
+  SalidaMemoria salida;
+  TopicoMQTT topico = topicoMQTT(TOPICO);
+  uint32_t marca = 0;
+  uint32_t enviados = 0;
+  uint32_t confirmados = 0;
+  uint16_t ids[BANDEJA_MAX_VENTANA];
+  for (uint32_t vuelta = 0; vuelta < 2000; vuelta++) {
+    size_t largo = 1 + (vuelta * 37) % 300;
+    uint8_t datos[300];
+    for (size_t i = 0; i < largo; i++) datos[i] = (uint8_t)(marca + i);
+    bool entro;
+    if (vuelta % 3 != 0) {
+      uint8_t* destino = bandeja.reservarMensaje(topico, 300);
+      if (destino != nullptr) memcpy(destino, datos, largo);
+      entro = destino != nullptr && bandeja.confirmarMensaje(largo, marca);
+    } else {
+      entro = bandeja.encolar(topico, datos, largo, marca);
+    }
+    if (entro) marca++;
+
+    // Cada paquete que sale tiene el mensaje entero
+    salida.vaciar();
+    bandeja.enviar(salida, vuelta);
+    for (size_t leido = 0; leido < salida.usado;) {
+      const uint8_t* p = salida.bytes + leido;
+      size_t cabecera = (p[1] & 0x80) ? 3 : 2;
+      size_t resto = (p[1] & 0x7F) | ((p[1] & 0x80) ? p[2] << 7 : 0);
+      size_t largoDatos = resto - (2 + 17 + 2);
+      const uint8_t* contenido = p + cabecera + 2 + 17 + 2;
+      TEST_ASSERT_EQUAL_UINT8((uint8_t)enviados, contenido[0]);
+      TEST_ASSERT_EQUAL_UINT8((uint8_t)(enviados + largoDatos - 1), contenido[largoDatos - 1]);
+      ids[enviados % BANDEJA_MAX_VENTANA] = idDe(p, cabecera + 2 + 17);
+      enviados++;
+      leido += cabecera + resto;
+    }
+    // Los PUBACK se demoran 8 de cada 20 vueltas y la bandeja se llena
+    if (vuelta % 20 < 8) continue;
+    while (confirmados < enviados) {
+      puback(bandeja, ids[confirmados % BANDEJA_MAX_VENTANA]);
+      TEST_ASSERT_EQUAL_UINT32(confirmados, ultimaMarca);
+      confirmados++;
+    }
+  }
+  while (confirmados < enviados) {
+    puback(bandeja, ids[confirmados % BANDEJA_MAX_VENTANA]);
+    confirmados++;
+  }
+  TEST_ASSERT_TRUE(marca < 2000);
+  TEST_ASSERT_EQUAL_UINT32(marca, confirmados);
+  TEST_ASSERT_TRUE(bandeja.vacia());
+  TEST_ASSERT_EQUAL_UINT16(1024, bandeja.libres());
+}
+
+// Diagnóstico y respuestas: el mensaje se codifica detrás de la reserva
+void test_publish_qos0_delante_del_mensaje() {
+  uint8_t buffer[64];
+  TopicoMQTT topico = topicoMQTT("a/b");
+  size_t reserva = reservaPublish(topico, 0);
+  TEST_ASSERT_EQUAL_UINT32(1 + 3 + 2 + 3, reserva);
+  memcpy(buffer + reserva, "{}", 2);
+  size_t largoPaquete;
+  uint8_t* paquete = armarPublish(buffer + reserva, 2, topico, 0, largoPaquete);
+  const uint8_t esperado[] = {0x30, 2 + 3 + 2, 0, 3, 'a', '/', 'b', '{', '}'};
+  TEST_ASSERT_EQUAL_UINT32(sizeof(esperado), largoPaquete);
+  TEST_ASSERT_TRUE(paquete == buffer + 2);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(esperado, paquete, sizeof(esperado));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_publish_qos1_armado);
+  RUN_TEST(test_en_su_lugar_igual_que_copiando);
+  RUN_TEST(test_reserva_descartada_no_ocupa);
+  RUN_TEST(test_reserva_descartada_al_dar_la_vuelta);
+  RUN_TEST(test_reenvio_con_dup_y_mismo_id);
+  RUN_TEST(test_muchas_vueltas_con_largos_distintos);
+  RUN_TEST(test_publish_qos0_delante_del_mensaje);
+  return UNITY_END();
+}
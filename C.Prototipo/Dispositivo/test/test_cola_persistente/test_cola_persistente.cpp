@@ -0,0 +1,234 @@
+// ====== Tests de lib/ColaPersistente ======
+// Con un almacén en memoria que sobrevive al objeto cola, como la flash a un
+// reinicio: se recuperan pendientes y secuencia, la secuencia no vuelve atrás
+// aunque se pierda el estado, con la cola llena se descartan los más viejos y
+// un registro truncado o corrupto no bloquea a los siguientes.
+
+#include <unity.h>
+
+#include <string.h>
+
+#include <ColaPersistente.h>
+
+const uint8_t ALMACEN_MAX_SEGMENTOS = 16;
+const uint32_t ALMACEN_TAMANO_SEGMENTO = 2048;
+
+class AlmacenMemoria : public AlmacenCola {
+ public:
+  AlmacenMemoria() { memset(tamanos, 0, sizeof(tamanos)); }
+
+  bool anexar(uint32_t segmento, const uint8_t* datos, size_t largo) override {
+    if (segmento >= ALMACEN_MAX_SEGMENTOS || tamanos[segmento] + largo > ALMACEN_TAMANO_SEGMENTO) return false;
+    memcpy(datosSegmentos[segmento] + tamanos[segmento], datos, largo);
+    tamanos[segmento] += largo;
+    return true;
+  }
+  size_t leer(uint32_t segmento, uint32_t offset, uint8_t* datos, size_t largo) override {
+    if (segmento >= ALMACEN_MAX_SEGMENTOS || offset >= tamanos[segmento]) return 0;
+    if (offset + largo > tamanos[segmento]) largo = tamanos[segmento] - offset;
+    memcpy(datos, datosSegmentos[segmento] + offset, largo);
+    return largo;
+  }
+  uint32_t tamano(uint32_t segmento) override {
+    return segmento < ALMACEN_MAX_SEGMENTOS ? tamanos[segmento] : 0;
+  }
+  void borrar(uint32_t segmento) override {
+    if (segmento < ALMACEN_MAX_SEGMENTOS) tamanos[segmento] = 0;
+  }
+  bool rango(uint32_t& primero, uint32_t& ultimo) override {
+    bool hay = false;
+    for (uint32_t s = 0; s < ALMACEN_MAX_SEGMENTOS; s++) {
+      if (tamanos[s] == 0) continue;
+      if (!hay) primero = s;
+      ultimo = s;
+      hay = true;
+    }
+    return hay;
+  }
+  bool guardarEstado(const uint8_t* datos, size_t largo) override {
+    memcpy(estado, datos, largo);
+    hayEstado = true;
+    return true;
+  }
+  bool cargarEstado(uint8_t* datos, size_t largo) override {
+    if (!hayEstado) return false;
+    memcpy(datos, estado, largo);
+    return true;
+  }
+
+  uint8_t datosSegmentos[ALMACEN_MAX_SEGMENTOS][ALMACEN_TAMANO_SEGMENTO];
+  uint32_t tamanos[ALMACEN_MAX_SEGMENTOS];
+  uint8_t estado[64];
+  bool hayEstado = false;
+};
+
+static const ConfigCola CONFIG = {256, 8, DESCARTAR_ANTIGUOS, 1000, 1000, 4};
+
+static uint32_t secuenciasEnviadas[128];
+static uint8_t cantidadEnviadas = 0;
+
+static bool enviarTodo(uint8_t, uint32_t secuencia, const uint8_t*, size_t) {
+  if (cantidadEnviadas < 128) secuenciasEnviadas[cantidadEnviadas++] = secuencia;
+  return true;
+}
+
+static void encolarVarios(ColaPersistente& cola, uint8_t cantidad, uint32_t* secuencias = nullptr) {
+  uint8_t datos[40];
+  for (uint8_t i = 0; i < cantidad; i++) {
+    uint32_t seq = cola.siguienteSecuencia();
+    memset(datos, 'a' + i % 26, sizeof(datos));
+    TEST_ASSERT_TRUE(cola.encolar(1, false, seq, datos, sizeof(datos)));
+    if (secuencias) secuencias[i] = seq;
+  }
+  cola.sincronizar();
+}
+
+// Reloj muy adelantado: el balde de fichas se llena hasta la ráfaga
+static uint16_t drenarTodo(ColaPersistente& cola) {
+  static uint32_t ahora = 0;
+  ahora += 1000000;
+  return cola.drenar(ahora, enviarTodo);
+}
+
+void setUp() {
+  cantidadEnviadas = 0;
+}
+void tearDown() {}
+
+void test_recupera_pendientes_tras_reinicio() {
+  static AlmacenMemoria almacen;
+  almacen = AlmacenMemoria();
+  uint32_t secuencias[10];
+  uint32_t ultima;
+  {
+    ColaPersistente cola(almacen, CONFIG);
+    cola.iniciar();
+    encolarVarios(cola, 10, secuencias);
+    ultima = secuencias[9];
+  }
+  ColaPersistente cola(almacen, CONFIG);
+  cola.iniciar();
+  TEST_ASSERT_EQUAL_UINT32(10, cola.cantidadPendientes());
+  TEST_ASSERT_TRUE(cola.siguienteSecuencia() > ultima);
+
+  TEST_ASSERT_EQUAL_UINT16(10, drenarTodo(cola));
+  TEST_ASSERT_TRUE(cola.vacia());
+  for (uint8_t i = 0; i < 10; i++) {
+    TEST_ASSERT_EQUAL_UINT32(secuencias[i], secuenciasEnviadas[i]);
+  }
+}
+
+void test_sin_estado_la_secuencia_sigue_a_los_segmentos() {
+  static AlmacenMemoria almacen;
+  almacen = AlmacenMemoria();
+  uint32_t secuencias[6];
+  {
+    ColaPersistente cola(almacen, CONFIG);
+    cola.iniciar();
+    // Varios bloques de secuencia ya usados antes del corte
+    for (uint32_t i = 0; i < 3 * BLOQUE_SECUENCIA; i++) cola.siguienteSecuencia();
+    encolarVarios(cola, 6, secuencias);
+  }
+  almacen.hayEstado = false;
+
+  ColaPersistente cola(almacen, CONFIG);
+  cola.iniciar();
+  TEST_ASSERT_EQUAL_UINT32(6, cola.cantidadPendientes());
+  TEST_ASSERT_TRUE(cola.siguienteSecuencia() > secuencias[5]);
+}
+
+void test_sin_estado_ni_registros_arranca_en_la_semilla() {
+  static AlmacenMemoria almacen;
+  almacen = AlmacenMemoria();
+  ColaPersistente cola(almacen, CONFIG);
+  cola.iniciar(700000);
+  TEST_ASSERT_EQUAL_UINT32(700000, cola.siguienteSecuencia());
+
+  ColaPersistente sinFlash(almacen, CONFIG);
+  sinFlash.iniciarSinAlmacen(123456);
+  TEST_ASSERT_EQUAL_UINT32(123456, sinFlash.siguienteSecuencia());
+  TEST_ASSERT_EQUAL_UINT32(123457, sinFlash.siguienteSecuencia());
+}
+
+void test_llena_descarta_los_mas_viejos() {
+  static AlmacenMemoria almacen;
+  almacen = AlmacenMemoria();
+  ConfigCola config = CONFIG;
+  config.maxSegmentos = 3;
+  ColaPersistente cola(almacen, config);
+  cola.iniciar();
+
+  // 49 bytes por registro: 5 por segmento de 256, caben 15 en 3 segmentos
+  uint32_t secuencias[40];
+  encolarVarios(cola, 40, secuencias);
+  TEST_ASSERT_EQUAL_UINT32(3, cola.segmentosEnUso());
+  TEST_ASSERT_TRUE(cola.estadisticas().descartados > 0);
+  TEST_ASSERT_EQUAL_UINT32(40 - cola.estadisticas().descartados, cola.cantidadPendientes());
+
+  uint16_t enviados = drenarTodo(cola);
+  TEST_ASSERT_TRUE(enviados > 0);
+  // Llegan los más nuevos, en orden y terminando en el último
+  TEST_ASSERT_EQUAL_UINT32(secuencias[39], secuenciasEnviadas[enviados - 1]);
+  for (uint16_t i = 1; i < enviados; i++) {
+    TEST_ASSERT_EQUAL_UINT32(secuenciasEnviadas[i - 1] + 1, secuenciasEnviadas[i]);
+  }
+}
+
+void test_cola_truncada_sigue_en_segmento_nuevo() {
+  static AlmacenMemoria almacen;
+  almacen = AlmacenMemoria();
+  uint32_t secuencias[3];
+  uint32_t ultimoSegmento = 0;
+  {
+    ColaPersistente cola(almacen, CONFIG);
+    cola.iniciar();
+    encolarVarios(cola, 3, secuencias);
+    uint32_t primero = 0;
+    TEST_ASSERT_TRUE(almacen.rango(primero, ultimoSegmento));
+  }
+  // Corte a mitad de la escritura de un registro
+  const uint8_t mitad[] = {0xA5, 0x01, 40, 0, 0x10, 0x00};
+  almacen.anexar(ultimoSegmento, mitad, sizeof(mitad));
+
+  ColaPersistente cola(almacen, CONFIG);
+  cola.iniciar();
+  TEST_ASSERT_EQUAL_UINT32(3, cola.cantidadPendientes());
+  TEST_ASSERT_EQUAL_UINT32(1, cola.estadisticas().corruptos);
+
+  uint32_t nuevas[2];
+  encolarVarios(cola, 2, nuevas);
+  TEST_ASSERT_EQUAL_UINT16(5, drenarTodo(cola));
+  TEST_ASSERT_EQUAL_UINT32(secuencias[0], secuenciasEnviadas[0]);
+  TEST_ASSERT_EQUAL_UINT32(nuevas[1], secuenciasEnviadas[4]);
+}
+
+void test_registro_corrupto_se_saltea() {
+  static AlmacenMemoria almacen;
+  almacen = AlmacenMemoria();
+  ColaPersistente cola(almacen, CONFIG);
+  cola.iniciar();
+  uint32_t secuencias[3];
+  encolarVarios(cola, 3, secuencias);
+
+  // Un bit cambiado en el payload del segundo registro: falla el CRC
+  uint32_t primero = 0, ultimo = 0;
+  TEST_ASSERT_TRUE(almacen.rango(primero, ultimo));
+  almacen.datosSegmentos[primero][49 + 9 + 3] ^= 0x04;
+
+  TEST_ASSERT_EQUAL_UINT16(2, drenarTodo(cola));
+  TEST_ASSERT_EQUAL_UINT32(1, cola.estadisticas().corruptos);
+  TEST_ASSERT_EQUAL_UINT32(secuencias[0], secuenciasEnviadas[0]);
+  TEST_ASSERT_EQUAL_UINT32(secuencias[2], secuenciasEnviadas[1]);
+  TEST_ASSERT_TRUE(cola.vacia());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_recupera_pendientes_tras_reinicio);
+  RUN_TEST(test_sin_estado_la_secuencia_sigue_a_los_segmentos);
+  RUN_TEST(test_sin_estado_ni_registros_arranca_en_la_semilla);
+  RUN_TEST(test_llena_descarta_los_mas_viejos);
+  RUN_TEST(test_cola_truncada_sigue_en_segmento_nuevo);
+  RUN_TEST(test_registro_corrupto_se_saltea);
+  return UNITY_END();
+}
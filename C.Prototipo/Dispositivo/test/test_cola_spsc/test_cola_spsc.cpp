@@ -0,0 +1,111 @@
+// ====== Tests de lib/ColaSPSC ======
+// Orden, cola llena, máximo de ocupación y un productor y un consumidor en
+// hilos distintos: ningún registro se pierde, se repite ni se lee a medias.
+
+#include <unity.h>
+
+#include <ColaSPSC.h>
+
+#include <thread>
+
+struct Registro {
+  uint32_t numero;
+  uint32_t copia[15];  // el consumidor verifica que todo el registro sea del mismo número
+};
+
+void setUp() {}
+void tearDown() {}
+
+static bool poner(ColaSPSCFija<Registro, 4>& cola, uint32_t n) {
+  Registro* r = cola.reservar();
+  if (r == nullptr) return false;
+  r->numero = n;
+  cola.publicar();
+  return true;
+}
+
+void test_orden_fifo() {
+  ColaSPSCFija<Registro, 4> cola;
+  TEST_ASSERT_NULL(cola.frente());
+  TEST_ASSERT_TRUE(poner(cola, 1));
+  TEST_ASSERT_TRUE(poner(cola, 2));
+  TEST_ASSERT_EQUAL_UINT16(2, cola.cantidad());
+  TEST_ASSERT_EQUAL_UINT32(1, cola.frente()->numero);
+  cola.liberar();
+  TEST_ASSERT_EQUAL_UINT32(2, cola.frente()->numero);
+  cola.liberar();
+  TEST_ASSERT_NULL(cola.frente());
+  cola.liberar();  // vacía: no hace nada
+  TEST_ASSERT_EQUAL_UINT16(0, cola.cantidad());
+}
+
+void test_llena_rechaza_y_cuenta() {
+  ColaSPSCFija<Registro, 4> cola;
+  for (uint32_t i = 0; i < 4; i++) TEST_ASSERT_TRUE(poner(cola, i));
+  TEST_ASSERT_FALSE(poner(cola, 99));
+  TEST_ASSERT_EQUAL_UINT32(1, cola.rechazados());
+  TEST_ASSERT_EQUAL_UINT16(4, cola.maximo());
+  cola.liberar();
+  TEST_ASSERT_TRUE(poner(cola, 4));
+  TEST_ASSERT_EQUAL_UINT32(1, cola.frente()->numero);
+}
+
+void test_maximo_queda_registrado() {
+  ColaSPSCFija<Registro, 4> cola;
+  for (uint32_t vuelta = 0; vuelta < 100; vuelta++) {
+    poner(cola, vuelta);
+    if (vuelta % 10 == 0) poner(cola, vuelta);
+    cola.liberar();
+    if (vuelta % 10 == 5) cola.liberar();
+  }
+  TEST_ASSERT_EQUAL_UINT16(2, cola.maximo());
+  TEST_ASSERT_EQUAL_UINT32(110, cola.publicados());
+}
+
+void test_dos_hilos() {
+  static ColaSPSCFija<Registro, 16> cola;
+  const uint32_t TOTAL = 200000;
+
+  std::thread productor([]() {
+    for (uint32_t n = 0; n < TOTAL;) {
+      Registro* r = cola.reservar();
+      if (r == nullptr) {
+        std::this_thread::yield();
+        continue;
+      }
+      r->numero = n;
+      for (uint32_t& c : r->copia) c = n;
+      cola.publicar();
+      n++;
+    }
+  });
+
+  uint32_t esperado = 0;
+  bool completos = true;
+  while (esperado < TOTAL) {
+    const Registro* r = cola.frente();
+    if (r == nullptr) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (r->numero != esperado) break;
+    for (uint32_t c : r->copia) completos = completos && c == esperado;
+    cola.liberar();
+    esperado++;
+  }
+  productor.join();
+
+  TEST_ASSERT_EQUAL_UINT32(TOTAL, esperado);
+  TEST_ASSERT_TRUE(completos);
+  TEST_ASSERT_TRUE(cola.maximo() <= 16);
+  TEST_ASSERT_EQUAL_UINT16(0, cola.cantidad());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_orden_fifo);
+  RUN_TEST(test_llena_rechaza_y_cuenta);
+  RUN_TEST(test_maximo_queda_registrado);
+  RUN_TEST(test_dos_hilos);
+  return UNITY_END();
+}
@@ -0,0 +1,183 @@
+// ====== Tests de lib/DetectorGiros ======
+// Trayectos sintéticos de un fix por segundo a 14,4 km/h (4 m por fix): una
+// esquina de 90°, una vuelta en U, una recta con ruido en el rumbo y en la
+// posición, y el rumbo cruzando el norte (359° → 1°). Los dos algoritmos
+// tienen que confirmar un solo giro en la esquina y ninguno en la recta.
+
+#include <unity.h>
+
+#include <math.h>
+
+#include <DetectorGiros.h>
+#include <Geodesia.h>
+
+static const double LAT0 = -31.42;
+static const double LON0 = -64.18;
+static const double METROS_POR_GRADO = RADIO_TIERRA_M * M_PI / 180.0;
+static const float PASO_M = 4.0f;
+static const float VELOCIDAD_KMH = PASO_M * 3.6f;
+
+// Gaussiano determinista (LCG + Box-Muller): el test no depende de rand()
+static uint32_t semilla = 12345;
+static double uniforme() {
+  semilla = semilla * 1664525u + 1013904223u;
+  return ((semilla >> 8) + 0.5) / 16777216.0;
+}
+static double gaussiano() {
+  return sqrt(-2.0 * log(uniforme())) * cos(2.0 * M_PI * uniforme());
+}
+
+struct Recorrido {
+  double norte;
+  double este;
+  float rumbo;
+  float ruidoRumboGrados;
+  float ruidoPosicionM;
+  uint8_t confirmados;
+  uint8_t posibles;
+  float cambioConfirmado;
+};
+
+static void empezar(Recorrido& r, float rumbo, float ruidoRumbo = 0.0f, float ruidoPosicion = 0.0f) {
+  r = Recorrido{0.0, 0.0, rumbo, ruidoRumbo, ruidoPosicion, 0, 0, 0.0f};
+}
+
+// Avanza 'metros' girando 'giro' grados repartidos a lo largo del tramo
+static void avanzar(DetectorGiros& d, Recorrido& r, float metros, float giro = 0.0f) {
+  uint32_t pasos = (uint32_t)(metros / PASO_M + 0.5f);
+  for (uint32_t i = 0; i < pasos; i++) {
+    // Arco: medio giro antes del paso y medio después
+    r.rumbo += giro / pasos / 2.0f;
+    double rad = r.rumbo * M_PI / 180.0;
+    r.norte += PASO_M * cos(rad);
+    r.este += PASO_M * sin(rad);
+    r.rumbo += giro / pasos / 2.0f;
+
+    PuntoGiro p;
+    double norte = r.norte + r.ruidoPosicionM * gaussiano();
+    double este = r.este + r.ruidoPosicionM * gaussiano();
+    p.lat = LAT0 + norte / METROS_POR_GRADO;
+    p.lon = LON0 + este / (METROS_POR_GRADO * cos(LAT0 * M_PI / 180.0));
+    p.rumbo = fmodf(r.rumbo + r.ruidoRumboGrados * (float)gaussiano() + 720.0f, 360.0f);
+    p.velocidad = VELOCIDAD_KMH;
+
+    EventoGiro e = d.agregar(p);
+    if (e == GIRO_POSIBLE) r.posibles++;
+    if (e == GIRO_CONFIRMADO) {
+      r.confirmados++;
+      r.cambioConfirmado = d.ultimoCambio();
+    }
+  }
+}
+
+void setUp() {
+  semilla = 12345;
+}
+void tearDown() {}
+
+void test_diferencia_angulo_cruza_el_norte() {
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 2.0f, diferenciaAngulo(1.0f, 359.0f));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, -2.0f, diferenciaAngulo(359.0f, 1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 180.0f, diferenciaAngulo(0.0f, 180.0f));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 180.0f, diferenciaAngulo(180.0f, 0.0f));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, -90.0f, diferenciaAngulo(-45.0f, 45.0f));
+}
+
+void test_esquina_de_90_grados() {
+  const ConfigDetectorGiros* configs[] = {&DETECTOR_GIROS_CURVATURA, &DETECTOR_GIROS_RUMBO};
+  for (const ConfigDetectorGiros* config : configs) {
+    DetectorGiros d(*config);
+    Recorrido r;
+    empezar(r, 0.0f);
+    avanzar(d, r, 100.0f);
+    TEST_ASSERT_EQUAL_UINT8(0, r.posibles);
+    avanzar(d, r, 16.0f, 90.0f);
+    avanzar(d, r, 100.0f);
+    TEST_ASSERT_EQUAL_UINT8(1, r.confirmados);
+    TEST_ASSERT_FALSE(d.enGiro());
+  }
+
+  // La curvatura mide el giro total, con signo
+  DetectorGiros d(DETECTOR_GIROS_CURVATURA);
+  Recorrido r;
+  empezar(r, 0.0f);
+  avanzar(d, r, 100.0f);
+  avanzar(d, r, 16.0f, -90.0f);
+  avanzar(d, r, 100.0f);
+  TEST_ASSERT_EQUAL_UINT8(1, r.confirmados);
+  TEST_ASSERT_FLOAT_WITHIN(5.0f, -90.0f, r.cambioConfirmado);
+}
+
+void test_vuelta_en_u() {
+  DetectorGiros d(DETECTOR_GIROS_CURVATURA);
+  Recorrido r;
+  empezar(r, 90.0f);
+  avanzar(d, r, 100.0f);
+  avanzar(d, r, 24.0f, 180.0f);
+  avanzar(d, r, 100.0f);
+  TEST_ASSERT_EQUAL_UINT8(1, r.confirmados);
+  TEST_ASSERT_FLOAT_WITHIN(5.0f, 180.0f, fabsf(r.cambioConfirmado));
+}
+
+void test_recta_con_ruido_no_gira() {
+  // El rumbo del GPS con 5° de ruido para el algoritmo original
+  DetectorGiros rumbo(DETECTOR_GIROS_RUMBO);
+  Recorrido r;
+  empezar(r, 60.0f, 5.0f, 0.0f);
+  avanzar(rumbo, r, 1000.0f);
+  TEST_ASSERT_EQUAL_UINT8(0, r.confirmados);
+
+  // Medio metro de ruido en la posición para la curvatura
+  DetectorGiros curvatura(DETECTOR_GIROS_CURVATURA);
+  empezar(r, 60.0f, 0.0f, 0.5f);
+  avanzar(curvatura, r, 1000.0f);
+  TEST_ASSERT_EQUAL_UINT8(0, r.confirmados);
+
+  // Una avenida con una curva suave de 20° en 200 m tampoco es un giro
+  empezar(r, 60.0f);
+  curvatura.reiniciar();
+  avanzar(curvatura, r, 100.0f);
+  avanzar(curvatura, r, 200.0f, 20.0f);
+  avanzar(curvatura, r, 100.0f);
+  TEST_ASSERT_EQUAL_UINT8(0, r.posibles);
+  TEST_ASSERT_EQUAL_UINT8(0, r.confirmados);
+}
+
+void test_rumbo_cruza_el_norte() {
+  const ConfigDetectorGiros* configs[] = {&DETECTOR_GIROS_CURVATURA, &DETECTOR_GIROS_RUMBO};
+  for (const ConfigDetectorGiros* config : configs) {
+    // Hacia el norte con el rumbo saltando entre 359° y 1°
+    DetectorGiros d(*config);
+    Recorrido r;
+    empezar(r, 0.0f, 1.0f, 0.0f);
+    avanzar(d, r, 300.0f);
+    TEST_ASSERT_EQUAL_UINT8(0, r.posibles);
+    TEST_ASSERT_EQUAL_UINT8(0, r.confirmados);
+
+    // Esquina de 315° a 45°: 90° pasando por el norte
+    d.reiniciar();
+    empezar(r, 315.0f);
+    avanzar(d, r, 100.0f);
+    avanzar(d, r, 16.0f, 90.0f);
+    avanzar(d, r, 100.0f);
+    TEST_ASSERT_EQUAL_UINT8(1, r.confirmados);
+  }
+
+  DetectorGiros d(DETECTOR_GIROS_CURVATURA);
+  Recorrido r;
+  empezar(r, 315.0f);
+  avanzar(d, r, 100.0f);
+  avanzar(d, r, 16.0f, 90.0f);
+  avanzar(d, r, 100.0f);
+  TEST_ASSERT_FLOAT_WITHIN(5.0f, 90.0f, r.cambioConfirmado);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_diferencia_angulo_cruza_el_norte);
+  RUN_TEST(test_esquina_de_90_grados);
+  RUN_TEST(test_vuelta_en_u);
+  RUN_TEST(test_recta_con_ruido_no_gira);
+  RUN_TEST(test_rumbo_cruza_el_norte);
+  return UNITY_END();
+}
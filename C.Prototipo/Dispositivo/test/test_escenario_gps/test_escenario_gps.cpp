@@ -0,0 +1,189 @@
+// ====== Tests de lib/EscenarioGPS ======
+// Guiones con rampas de velocidad y giros, trazas NMEA y GPX con su hora,
+// cortes de GPS y del broker, errores y reproducibilidad con reloj virtual.
+
+#include <unity.h>
+
+#include <EscenarioGPS.h>
+
+#include <math.h>
+#include <string.h>
+
+static const double METROS_POR_GRADO = 111194.93;
+
+void setUp() {}
+void tearDown() {}
+
+struct Reproduccion {
+  explicit Reproduccion(const char* texto) : fuente(texto, strlen(texto)), escenario(fuente) {}
+  MuestraEscenario en(uint32_t ms) {
+    MuestraEscenario m;
+    escenario.muestra(ms, m);
+    return m;
+  }
+  FuenteEscenarioMemoria fuente;
+  EscenarioGPS escenario;
+};
+
+static double norteMetros(const MuestraEscenario& m, double lat0) {
+  return (m.lat - lat0) * METROS_POR_GRADO;
+}
+
+void test_guion_avanza_con_velocidad_y_rumbo() {
+  Reproduccion r("inicio -31.42 -64.18\nvelocidad 36\nrumbo 0\nesperar 10\n");
+  MuestraEscenario m = r.en(10000);
+  TEST_ASSERT_DOUBLE_WITHIN(0.01, 100.0, norteMetros(m, -31.42));
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, -64.18, m.lon);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 36.0, m.velocidad);
+}
+
+void test_rampa_de_velocidad() {
+  Reproduccion r("inicio -31.42 -64.18\nvelocidad 36 10\nesperar 20\n");
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 18.0, r.en(5000).velocidad);
+  // Acelerando de 0 a 10 m/s en 10 s: 50 m
+  TEST_ASSERT_DOUBLE_WITHIN(0.01, 50.0, norteMetros(r.en(10000), -31.42));
+  TEST_ASSERT_DOUBLE_WITHIN(0.01, 150.0, norteMetros(r.en(20000), -31.42));
+}
+
+void test_rumbo_gira_por_el_lado_corto() {
+  Reproduccion r("rumbo 350\nrumbo 10 4\nesperar 10\ngirar -90 2\nesperar 5\n");
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 350.0, r.en(0).rumbo);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, r.en(2000).rumbo);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 10.0, r.en(4000).rumbo);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 325.0, r.en(11000).rumbo);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 280.0, r.en(12000).rumbo);
+}
+
+void test_traza_nmea_a_su_hora() {
+  Reproduccion r(
+      "esperar 5\n"
+      "$GPGGA,120000.00,3125.2000,S,06410.8000,W,1,07,1.0,400.0,M,0.0,M,,*5E\n"
+      "$GPRMC,120000.00,A,3125.2000,S,06410.8000,W,10.0,90.0,010524,,,A*54\n"
+      "$GPRMC,120002.00,A,3125.2000,S,06410.7800,W,10.0,90.0,010524,,,A*51\n");
+  MuestraEscenario m = r.en(5000);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, -31.42, m.lat);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, -64.18, m.lon);
+  TEST_ASSERT_EQUAL_UINT8(7, m.satelites);
+  // A mitad de camino entre las dos sentencias
+  m = r.en(6000);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, -64.18 + 0.01 / 60.0, m.lon);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-6, 18.52, m.velocidad);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 90.0, m.rumbo);
+  TEST_ASSERT_EQUAL_UINT32(2, r.escenario.estadisticas().puntos);
+  TEST_ASSERT_EQUAL_UINT32(0, r.escenario.estadisticas().errores);
+}
+
+void test_rmc_sin_fix_corta_el_gps_hasta_la_siguiente_valida() {
+  Reproduccion r(
+      "$GPRMC,120000.00,A,3125.2000,S,06410.8000,W,10.0,90.0,010524,,,A*54\n"
+      "$GPRMC,120003.00,V,,,,,,,010524,,,N*7F\n"
+      "$GPRMC,120008.00,A,3125.2000,S,06410.7000,W,10.0,90.0,010524,,,A*53\n");
+  TEST_ASSERT_TRUE(r.en(0).conFix);
+  TEST_ASSERT_TRUE(r.en(2000).conFix);
+  TEST_ASSERT_FALSE(r.en(3000).conFix);
+  TEST_ASSERT_FALSE(r.en(7000).conFix);
+  MuestraEscenario m = r.en(8000);
+  TEST_ASSERT_TRUE(m.conFix);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, -64.18 + 0.1 / 60.0, m.lon);
+}
+
+void test_checksum_invalido_es_un_error() {
+  Reproduccion r("velocidad 10\n$GPRMC,120000.00,A,3125.2000,S,06410.8000,W,10.0,90.0,010524,,,A*00\n");
+  r.en(0);
+  TEST_ASSERT_EQUAL_UINT32(1, r.escenario.estadisticas().errores);
+  TEST_ASSERT_EQUAL_UINT32(2, r.escenario.estadisticas().primeraConError);
+}
+
+void test_traza_gpx_calcula_velocidad_y_rumbo() {
+  Reproduccion r(
+      "<?xml version=\"1.0\"?>\n"
+      "<gpx><trk><trkseg>\n"
+      "<trkpt lat=\"-31.42\" lon=\"-64.18\"><time>2024-05-01T23:59:58Z</time></trkpt>\n"
+      "<trkpt lat=\"-31.4191\" lon=\"-64.18\">\n"
+      "  <ele>400</ele>\n"
+      "  <time>2024-05-02T00:00:08Z</time>\n"
+      "  <sat>5</sat>\n"
+      "</trkpt>\n"
+      "</trkseg></trk></gpx>\n");
+  r.en(0);
+  // 0.0009° al norte (unos 100 m) en 10 s, pasando la medianoche
+  double metros = 0.0009 * METROS_POR_GRADO;
+  MuestraEscenario m = r.en(5000);
+  TEST_ASSERT_DOUBLE_WITHIN(0.01, metros / 2, norteMetros(m, -31.42));
+  TEST_ASSERT_DOUBLE_WITHIN(0.01, metros / 10 * 3.6, m.velocidad);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-6, 0.0, m.rumbo);
+  TEST_ASSERT_EQUAL_UINT8(5, m.satelites);
+  TEST_ASSERT_EQUAL_UINT32(2, r.escenario.estadisticas().puntos);
+}
+
+void test_cortes_de_gps_y_broker() {
+  Reproduccion r(
+      "acelerar 20\n"
+      "esperar 10\n"
+      "gps apagado\nsatelites 3\n"
+      "esperar 5\n"
+      "broker caido\ngps encendido\n"
+      "esperar 30\n"
+      "broker conectado\n"
+      "esperar 1\n");
+  MuestraEscenario m = r.en(0);
+  TEST_ASSERT_EQUAL_UINT16(20, r.escenario.aceleracion());
+  TEST_ASSERT_TRUE(m.conFix);
+  m = r.en(10000);
+  TEST_ASSERT_FALSE(m.conFix);
+  TEST_ASSERT_EQUAL_UINT8(3, m.satelites);
+  TEST_ASSERT_FALSE(m.brokerCaido);
+  m = r.en(15000);
+  TEST_ASSERT_TRUE(m.conFix);
+  TEST_ASSERT_TRUE(m.brokerCaido);
+  TEST_ASSERT_TRUE(r.escenario.muestra(45000, m));
+  TEST_ASSERT_FALSE(m.brokerCaido);
+  TEST_ASSERT_FALSE(r.escenario.muestra(46000, m));
+  TEST_ASSERT_TRUE(r.escenario.terminado());
+}
+
+void test_comandos_invalidos_se_saltean() {
+  Reproduccion r("velocidad\nfrenar 3\nvelocidad 36 x\n# comentario\nvelocidad 36 # a fondo\nesperar 1\n");
+  MuestraEscenario m = r.en(1000);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 36.0, m.velocidad);
+  TEST_ASSERT_EQUAL_UINT32(3, r.escenario.estadisticas().errores);
+  TEST_ASSERT_EQUAL_UINT32(1, r.escenario.estadisticas().primeraConError);
+  TEST_ASSERT_EQUAL_UINT32(2, r.escenario.estadisticas().comandos);
+}
+
+void test_misma_entrada_mismas_muestras() {
+  const char* guion = "inicio -31.42 -64.18\nvelocidad 40 5\ngirar 90 20\nesperar 60\nvelocidad 0 10\nesperar 20\n";
+  Reproduccion a(guion);
+  Reproduccion b(guion);
+  MuestraEscenario finalA = {};
+  for (uint32_t t = 0; t <= 90000; t += 1000) {
+    MuestraEscenario ma = a.en(t);
+    MuestraEscenario mb = b.en(t);
+    TEST_ASSERT_EQUAL_MEMORY(&ma.lat, &mb.lat, sizeof(double));
+    TEST_ASSERT_EQUAL_MEMORY(&ma.lon, &mb.lon, sizeof(double));
+    finalA = ma;
+  }
+  // Otra vez desde el principio, con el mismo objeto
+  a.fuente.rebobinar();
+  a.escenario.reiniciar();
+  for (uint32_t t = 0; t < 90000; t += 1000) a.en(t);
+  MuestraEscenario otra = a.en(90000);
+  TEST_ASSERT_EQUAL_MEMORY(&finalA.lat, &otra.lat, sizeof(double));
+  TEST_ASSERT_EQUAL_MEMORY(&finalA.lon, &otra.lon, sizeof(double));
+  TEST_ASSERT_EQUAL_UINT32(0, a.escenario.estadisticas().errores);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_guion_avanza_con_velocidad_y_rumbo);
+  RUN_TEST(test_rampa_de_velocidad);
+  RUN_TEST(test_rumbo_gira_por_el_lado_corto);
+  RUN_TEST(test_traza_nmea_a_su_hora);
+  RUN_TEST(test_rmc_sin_fix_corta_el_gps_hasta_la_siguiente_valida);
+  RUN_TEST(test_checksum_invalido_es_un_error);
+  RUN_TEST(test_traza_gpx_calcula_velocidad_y_rumbo);
+  RUN_TEST(test_cortes_de_gps_y_broker);
+  RUN_TEST(test_comandos_invalidos_se_saltean);
+  RUN_TEST(test_misma_entrada_mismas_muestras);
+  return UNITY_END();
+}
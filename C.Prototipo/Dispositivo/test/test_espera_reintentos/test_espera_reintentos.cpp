@@ -0,0 +1,111 @@
+// ====== Tests de lib/EsperaReintentos ======
+// El techo se duplica con cada fallo hasta el máximo (sin desbordar aunque
+// el máximo sea 2^32 - 1), un éxito vuelve a la espera inicial y la espera
+// con jitter queda siempre en la mitad superior del techo y la recorre toda.
+
+#include <unity.h>
+
+#include <EsperaReintentos.h>
+
+// Arranca en 1 s como la reconexión MQTT, con un tope más corto
+static const ConfigReintentos CONFIG = {1000, 60000};
+
+// Azar determinista (LCG): el test no depende de rand()
+static uint32_t semilla = 12345;
+static uint32_t azar() {
+  semilla = semilla * 1664525u + 1013904223u;
+  return semilla;
+}
+
+void setUp() {
+  semilla = 12345;
+}
+void tearDown() {}
+
+void test_techo_se_duplica_hasta_el_maximo() {
+  EsperaReintentos e(CONFIG);
+  TEST_ASSERT_EQUAL_UINT32(1000, e.techo());
+  const uint32_t techos[] = {1000, 2000, 4000, 8000, 16000, 32000, 60000, 60000, 60000};
+  for (uint8_t i = 0; i < sizeof(techos) / sizeof(techos[0]); i++) {
+    e.fallo(0);
+    TEST_ASSERT_EQUAL_UINT32(i + 1, e.fallosSeguidos());
+    TEST_ASSERT_EQUAL_UINT32(techos[i], e.techo());
+  }
+  // Con el azar en los extremos: la mitad del techo y el techo
+  TEST_ASSERT_EQUAL_UINT32(30000, e.fallo(0));
+  TEST_ASSERT_EQUAL_UINT32(60000, e.fallo(30000));
+}
+
+void test_sin_desborde_con_muchos_fallos() {
+  ConfigReintentos sinTope = {1, 0xFFFFFFFF};
+  EsperaReintentos e(sinTope);
+  for (uint32_t i = 0; i < 31; i++) e.fallo(0);
+  TEST_ASSERT_EQUAL_UINT32(0x40000000, e.techo());
+  e.fallo(0);
+  TEST_ASSERT_EQUAL_UINT32(0x80000000, e.techo());
+  // El siguiente doble no entra en 32 bits: queda en el máximo
+  e.fallo(0);
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, e.techo());
+  for (uint32_t i = 0; i < 100000; i++) e.fallo(azar());
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, e.techo());
+  TEST_ASSERT_TRUE(e.fallo(0xFFFFFFFF) >= 0x80000000);
+}
+
+void test_exito_vuelve_a_la_espera_inicial() {
+  EsperaReintentos e(CONFIG);
+  for (uint8_t i = 0; i < 10; i++) e.fallo(azar());
+  TEST_ASSERT_EQUAL_UINT32(60000, e.techo());
+  e.exito();
+  TEST_ASSERT_EQUAL_UINT32(0, e.fallosSeguidos());
+  TEST_ASSERT_EQUAL_UINT32(1000, e.techo());
+  uint32_t espera = e.fallo(azar());
+  TEST_ASSERT_TRUE(espera >= 500 && espera <= 1000);
+}
+
+void test_jitter_en_la_mitad_superior() {
+  EsperaReintentos e(CONFIG);
+  for (uint8_t fallos = 1; fallos <= 8; fallos++) {
+    e.exito();
+    for (uint8_t i = 1; i < fallos; i++) e.fallo(0);
+
+    // Mil equipos que cayeron juntos: cada uno con su azar
+    uint32_t menor = 0xFFFFFFFF, mayor = 0, techo = 0;
+    for (uint16_t equipo = 0; equipo < 1000; equipo++) {
+      EsperaReintentos copia = e;
+      uint32_t espera = copia.fallo(azar());
+      techo = copia.techo();
+      TEST_ASSERT_TRUE(espera >= techo - techo / 2);
+      TEST_ASSERT_TRUE(espera <= techo);
+      if (espera < menor) menor = espera;
+      if (espera > mayor) mayor = espera;
+    }
+    // Se reparten por toda la mitad superior, no se amontonan
+    TEST_ASSERT_TRUE(menor < techo / 2 + techo / 20);
+    TEST_ASSERT_TRUE(mayor > techo - techo / 20);
+  }
+}
+
+void test_configuracion_corregida() {
+  ConfigReintentos rara = {0, 0};
+  EsperaReintentos e(rara);
+  TEST_ASSERT_EQUAL_UINT32(1, e.techo());
+  TEST_ASSERT_EQUAL_UINT32(1, e.fallo(azar()));
+  TEST_ASSERT_EQUAL_UINT32(1, e.fallo(azar()));
+
+  // Máximo menor que la espera inicial: se usa la inicial
+  ConfigReintentos invertida = {5000, 1000};
+  EsperaReintentos f(invertida);
+  f.fallo(0);
+  f.fallo(0);
+  TEST_ASSERT_EQUAL_UINT32(5000, f.techo());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_techo_se_duplica_hasta_el_maximo);
+  RUN_TEST(test_sin_desborde_con_muchos_fallos);
+  RUN_TEST(test_exito_vuelve_a_la_espera_inicial);
+  RUN_TEST(test_jitter_en_la_mitad_superior);
+  RUN_TEST(test_configuracion_corregida);
+  return UNITY_END();
+}
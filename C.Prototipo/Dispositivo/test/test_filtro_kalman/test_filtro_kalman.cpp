@@ -0,0 +1,148 @@
+// ====== Tests de lib/FiltroKalman ======
+// Sobre una recta sintética a 10 m/s y un fix por segundo: converge a la
+// velocidad y el rumbo, descarta un salto imposible (y se reinicia si los
+// saltos siguen), arranca de cero después de reiniciar() o de un hueco, y
+// con ruido gaussiano deja menos error cuadrático medio que los fixes crudos.
+
+#include <unity.h>
+
+#include <math.h>
+
+#include <FiltroKalman.h>
+#include <Geodesia.h>
+
+static const ConfigKalman CONFIG = {1.0f, 4.0f, 0.5f, 25.0f, 10000, 2000.0f};
+
+static const double LAT0 = -31.42;
+static const double LON0 = -64.18;
+static const double METROS_POR_GRADO = RADIO_TIERRA_M * M_PI / 180.0;
+
+// Posición a 'norte' y 'este' metros del origen
+static void desplazar(double norte, double este, double& lat, double& lon) {
+  lat = LAT0 + norte / METROS_POR_GRADO;
+  lon = LON0 + este / (METROS_POR_GRADO * cos(LAT0 * M_PI / 180.0));
+}
+
+// Recta hacia el noreste a 10 m/s; fix n en t = n segundos
+static void enRecta(uint32_t n, double& lat, double& lon) {
+  double metros = 10.0 * n;
+  desplazar(metros * M_SQRT1_2, metros * M_SQRT1_2, lat, lon);
+}
+
+static uint32_t tiempoMs(uint32_t n) {
+  return 1000 + n * 1000;
+}
+
+static void recorrer(FiltroKalman& f, uint32_t desde, uint32_t hasta) {
+  for (uint32_t n = desde; n < hasta; n++) {
+    double lat, lon;
+    enRecta(n, lat, lon);
+    f.actualizar(lat, lon, 1.0f, 9, tiempoMs(n));
+  }
+}
+
+// Gaussiano determinista (LCG + Box-Muller): el test no depende de rand()
+static uint32_t semilla = 12345;
+static double uniforme() {
+  semilla = semilla * 1664525u + 1013904223u;
+  return ((semilla >> 8) + 0.5) / 16777216.0;
+}
+static double gaussiano() {
+  return sqrt(-2.0 * log(uniforme())) * cos(2.0 * M_PI * uniforme());
+}
+
+void setUp() {
+  semilla = 12345;
+}
+void tearDown() {}
+
+void test_converge_en_recta() {
+  FiltroKalman f(CONFIG);
+  recorrer(f, 0, 1);
+  float errorInicial = f.errorPosicion();
+  recorrer(f, 1, 30);
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 36.0f, f.velocidadKmh());
+  TEST_ASSERT_FLOAT_WITHIN(2.0f, 45.0f, f.rumbo());
+  TEST_ASSERT_TRUE(f.errorPosicion() < errorInicial);
+
+  double lat, lon;
+  enRecta(29, lat, lon);
+  TEST_ASSERT_TRUE(distanciaHaversine(lat, lon, f.latitud(), f.longitud()) < 1.0);
+  TEST_ASSERT_EQUAL_UINT32(0, f.descartadas());
+}
+
+void test_descarta_salto_y_se_reinicia_si_sigue() {
+  FiltroKalman f(CONFIG);
+  recorrer(f, 0, 20);
+
+  // 300 m al costado de la recta: imposible a 10 m/s
+  double lat, lon, latRecta, lonRecta;
+  enRecta(20, latRecta, lonRecta);
+  desplazar(10.0 * 20 * M_SQRT1_2 + 300.0, 10.0 * 20 * M_SQRT1_2, lat, lon);
+  TEST_ASSERT_FALSE(f.actualizar(lat, lon, 1.0f, 9, tiempoMs(20)));
+  TEST_ASSERT_EQUAL_UINT32(1, f.descartadas());
+  TEST_ASSERT_TRUE(distanciaHaversine(latRecta, lonRecta, f.latitud(), f.longitud()) < 2.0);
+
+  // El salto se repite: después de MAX_DESCARTES_SEGUIDOS se cree en la medición
+  for (uint32_t n = 21; n < 21 + MAX_DESCARTES_SEGUIDOS - 1; n++) {
+    TEST_ASSERT_FALSE(f.actualizar(lat, lon, 1.0f, 9, tiempoMs(n)));
+  }
+  TEST_ASSERT_TRUE(f.actualizar(lat, lon, 1.0f, 9, tiempoMs(21 + MAX_DESCARTES_SEGUIDOS)));
+  TEST_ASSERT_TRUE(distanciaHaversine(lat, lon, f.latitud(), f.longitud()) < 0.01);
+  TEST_ASSERT_EQUAL_UINT32(MAX_DESCARTES_SEGUIDOS, f.descartadas());
+}
+
+void test_despues_de_reiniciar() {
+  FiltroKalman f(CONFIG);
+  recorrer(f, 0, 20);
+  f.reiniciar();
+  TEST_ASSERT_FALSE(f.valido(tiempoMs(20)));
+
+  // Lejos de la recta: se toma tal cual, sin velocidad heredada
+  double lat, lon;
+  desplazar(-5000.0, 2000.0, lat, lon);
+  TEST_ASSERT_TRUE(f.actualizar(lat, lon, 1.0f, 9, tiempoMs(20)));
+  TEST_ASSERT_TRUE(f.valido(tiempoMs(20)));
+  TEST_ASSERT_TRUE(distanciaHaversine(lat, lon, f.latitud(), f.longitud()) < 0.01);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, f.velocidadKmh());
+
+  // Un hueco más largo que maxSinFixMs también reinicia
+  TEST_ASSERT_FALSE(f.valido(tiempoMs(20) + CONFIG.maxSinFixMs + 1));
+  desplazar(0.0, 0.0, lat, lon);
+  TEST_ASSERT_TRUE(f.actualizar(lat, lon, 1.0f, 9, tiempoMs(20) + CONFIG.maxSinFixMs + 1));
+  TEST_ASSERT_TRUE(distanciaHaversine(lat, lon, f.latitud(), f.longitud()) < 0.01);
+}
+
+void test_menos_error_que_los_fixes_crudos() {
+  FiltroKalman f(CONFIG);
+  const uint32_t FIXES = 150;
+  const uint32_t DESCARTE_INICIAL = 20;  // mientras converge
+  double sumaCrudo = 0, sumaFiltrado = 0;
+  for (uint32_t n = 0; n < FIXES; n++) {
+    double latReal, lonReal, lat, lon;
+    enRecta(n, latReal, lonReal);
+    double metros = 10.0 * n;
+    desplazar(metros * M_SQRT1_2 + CONFIG.errorBaseMetros * gaussiano(),
+              metros * M_SQRT1_2 + CONFIG.errorBaseMetros * gaussiano(), lat, lon);
+    f.actualizar(lat, lon, 1.0f, 9, tiempoMs(n));
+    if (n < DESCARTE_INICIAL) continue;
+    double crudo = distanciaHaversine(latReal, lonReal, lat, lon);
+    double filtrado = distanciaHaversine(latReal, lonReal, f.latitud(), f.longitud());
+    sumaCrudo += crudo * crudo;
+    sumaFiltrado += filtrado * filtrado;
+  }
+  double rmsCrudo = sqrt(sumaCrudo / (FIXES - DESCARTE_INICIAL));
+  double rmsFiltrado = sqrt(sumaFiltrado / (FIXES - DESCARTE_INICIAL));
+  TEST_ASSERT_TRUE(rmsCrudo > 4.0);
+  TEST_ASSERT_TRUE(rmsFiltrado < 0.7 * rmsCrudo);
+  TEST_ASSERT_EQUAL_UINT32(0, f.descartadas());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_converge_en_recta);
+  RUN_TEST(test_descarta_salto_y_se_reinicia_si_sigue);
+  RUN_TEST(test_despues_de_reiniciar);
+  RUN_TEST(test_menos_error_que_los_fixes_crudos);
+  return UNITY_END();
+}
@@ -0,0 +1,207 @@
+// ====== Tests de lib/FiltroNMEA ======
+// Con un flujo de bytes simulado como el de la UART del GPS: entrega las
+// sentencias pedidas con "\r\n", filtra los otros tipos, descarta checksums
+// inválidos, sentencias cortadas por otro '$' o por fin de línea y las muy
+// largas, y rearma una sentencia partida entre varias lecturas. Los
+// contadores son los que salen en el diagnóstico (sent/desc/desb).
+
+#include <unity.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <FiltroNMEA.h>
+
+// Sentencias de ejemplo del estándar, con su checksum
+static const char* RMC = "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n";
+static const char* GGA = "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+
+// "$<cuerpo>*HH\r\n" con el checksum correcto
+static void armar(const char* cuerpo, char* salida, size_t tamano) {
+  uint8_t suma = 0;
+  for (const char* c = cuerpo; *c; c++) suma ^= (uint8_t)*c;
+  snprintf(salida, tamano, "$%s*%02X\r\n", cuerpo, suma);
+}
+
+// Pasa 'texto' por el filtro; devuelve cuántas sentencias entregó y guarda la última
+static uint8_t alimentar(FiltroNMEA& filtro, const char* texto, size_t largo, char* ultima = nullptr) {
+  uint8_t entregadas = 0;
+  for (size_t i = 0; i < largo; i++) {
+    if (filtro.procesar((uint8_t)texto[i])) {
+      entregadas++;
+      if (ultima) memcpy(ultima, filtro.sentencia(), filtro.largo() + 1);
+    }
+  }
+  return entregadas;
+}
+
+static uint8_t alimentar(FiltroNMEA& filtro, const char* texto, char* ultima = nullptr) {
+  return alimentar(filtro, texto, strlen(texto), ultima);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_entrega_las_sentencias_pedidas() {
+  FiltroNMEA filtro;
+  char ultima[NMEA_MAX_SENTENCIA + 1];
+
+  TEST_ASSERT_EQUAL_UINT8(1, alimentar(filtro, RMC, ultima));
+  TEST_ASSERT_EQUAL_STRING(RMC, ultima);
+  TEST_ASSERT_EQUAL_UINT8(NMEA_RMC, filtro.tipo());
+
+  TEST_ASSERT_EQUAL_UINT8(1, alimentar(filtro, GGA, ultima));
+  TEST_ASSERT_EQUAL_STRING(GGA, ultima);
+  TEST_ASSERT_EQUAL_UINT8(NMEA_GGA, filtro.tipo());
+
+  // Dígitos del checksum en minúscula: se acepta y se entrega tal cual
+  TEST_ASSERT_EQUAL_UINT8(1, alimentar(filtro, "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6a\r\n"));
+
+  const EstadisticasNMEA& est = filtro.estadisticas();
+  TEST_ASSERT_EQUAL_UINT32(3, est.sentencias);
+  TEST_ASSERT_EQUAL_UINT32(3, est.aceptadas);
+  TEST_ASSERT_EQUAL_UINT32(0, est.descartadas());
+  TEST_ASSERT_EQUAL_UINT32(strlen(RMC) * 2 + strlen(GGA), est.bytes);
+}
+
+void test_filtra_los_tipos_no_pedidos() {
+  FiltroNMEA filtro(NMEA_RMC);
+  char gsv[NMEA_MAX_SENTENCIA + 1], pubx[NMEA_MAX_SENTENCIA + 1];
+  armar("GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00", gsv, sizeof(gsv));
+  armar("PUBX,00,081350.00,4717.113210,N", pubx, sizeof(pubx));
+
+  TEST_ASSERT_EQUAL_UINT8(0, alimentar(filtro, gsv));
+  TEST_ASSERT_EQUAL_UINT8(0, alimentar(filtro, GGA));
+  TEST_ASSERT_EQUAL_UINT8(0, alimentar(filtro, pubx));
+  TEST_ASSERT_EQUAL_UINT8(1, alimentar(filtro, RMC));
+
+  const EstadisticasNMEA& est = filtro.estadisticas();
+  TEST_ASSERT_EQUAL_UINT32(4, est.sentencias);
+  TEST_ASSERT_EQUAL_UINT32(3, est.filtradas);
+  TEST_ASSERT_EQUAL_UINT32(1, est.aceptadas);
+  // Filtrar no es un error
+  TEST_ASSERT_EQUAL_UINT32(0, est.descartadas());
+}
+
+void test_descarta_checksum_invalido() {
+  FiltroNMEA filtro;
+  // Un dígito de la hora cambiado en el camino
+  TEST_ASSERT_EQUAL_UINT8(0, alimentar(filtro, "$GPRMC,123619,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n"));
+  // Checksum que no es hexadecimal
+  TEST_ASSERT_EQUAL_UINT8(0, alimentar(filtro, "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*4G\r\n"));
+  // La siguiente sana pasa
+  TEST_ASSERT_EQUAL_UINT8(1, alimentar(filtro, RMC));
+
+  const EstadisticasNMEA& est = filtro.estadisticas();
+  TEST_ASSERT_EQUAL_UINT32(1, est.errorChecksum);
+  TEST_ASSERT_EQUAL_UINT32(1, est.truncadas);
+  TEST_ASSERT_EQUAL_UINT32(2, est.descartadas());
+  TEST_ASSERT_EQUAL_UINT32(1, est.aceptadas);
+}
+
+void test_descarta_sentencias_truncadas() {
+  FiltroNMEA filtro;
+  char ultima[NMEA_MAX_SENTENCIA + 1];
+
+  // Cortada por el '$' de la siguiente: se pierde la primera, no la segunda
+  TEST_ASSERT_EQUAL_UINT8(1, alimentar(filtro, "$GPGGA,123519,4807.0$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n", ultima));
+  TEST_ASSERT_EQUAL_STRING(RMC, ultima);
+  // Fin de línea antes del '*'
+  TEST_ASSERT_EQUAL_UINT8(0, alimentar(filtro, "$GPRMC,123519,A,4807.038\r\n"));
+  // '*' antes de conocer el tipo
+  TEST_ASSERT_EQUAL_UINT8(0, alimentar(filtro, "$GP*00\r\n"));
+  // Basura sin '$': ni siquiera cuenta como sentencia
+  TEST_ASSERT_EQUAL_UINT8(0, alimentar(filtro, "123519,A,4807.038*6A\r\n"));
+
+  const EstadisticasNMEA& est = filtro.estadisticas();
+  TEST_ASSERT_EQUAL_UINT32(4, est.sentencias);
+  TEST_ASSERT_EQUAL_UINT32(3, est.truncadas);
+  TEST_ASSERT_EQUAL_UINT32(1, est.aceptadas);
+}
+
+void test_descarta_sentencia_demasiado_larga() {
+  FiltroNMEA filtro;
+  char cuerpo[128];
+  char larga[160];
+  memcpy(cuerpo, "GPGGA,", 6);
+  memset(cuerpo + 6, '9', 100);
+  cuerpo[106] = '\0';
+  armar(cuerpo, larga, sizeof(larga));
+
+  TEST_ASSERT_EQUAL_UINT8(0, alimentar(filtro, larga));
+  TEST_ASSERT_EQUAL_UINT32(1, filtro.estadisticas().truncadas);
+  // El resto de la larga se ignora hasta el próximo '$'
+  TEST_ASSERT_EQUAL_UINT8(1, alimentar(filtro, GGA));
+  TEST_ASSERT_EQUAL_UINT32(1, filtro.estadisticas().aceptadas);
+
+  // Justo en el límite entra
+  char cuerpoMaximo[NMEA_MAX_SENTENCIA];
+  char maxima[NMEA_MAX_SENTENCIA + 8];
+  size_t largoCuerpo = NMEA_MAX_SENTENCIA - 6;
+  memcpy(cuerpoMaximo, "GPGGA,", 6);
+  memset(cuerpoMaximo + 6, '1', largoCuerpo - 6);
+  cuerpoMaximo[largoCuerpo] = '\0';
+  armar(cuerpoMaximo, maxima, sizeof(maxima));
+  char ultima[NMEA_MAX_SENTENCIA + 1];
+  TEST_ASSERT_EQUAL_UINT8(1, alimentar(filtro, maxima, ultima));
+  TEST_ASSERT_EQUAL_STRING(maxima, ultima);
+  TEST_ASSERT_EQUAL_UINT8(NMEA_MAX_SENTENCIA, filtro.largo());
+}
+
+void test_flujo_partido_entre_lecturas() {
+  FiltroNMEA filtro;
+  char vtg[NMEA_MAX_SENTENCIA + 1], gsa[NMEA_MAX_SENTENCIA + 1];
+  armar("GPVTG,054.7,T,034.4,M,005.5,N,010.2,K", vtg, sizeof(vtg));
+  armar("GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1", gsa, sizeof(gsa));
+
+  // Un segundo del GPS: RMC, GGA, VTG y GSA, diez veces
+  char flujo[4096];
+  size_t largo = 0;
+  for (uint8_t i = 0; i < 10; i++) {
+    largo += snprintf(flujo + largo, sizeof(flujo) - largo, "%s%s%s%s", RMC, GGA, vtg, gsa);
+  }
+
+  // Lecturas de la UART de tamaño variable que parten las sentencias en cualquier byte
+  uint8_t entregadas = 0;
+  size_t desde = 0;
+  for (uint32_t lectura = 0; desde < largo; lectura++) {
+    size_t cuantos = 1 + (lectura * 7) % 23;
+    if (desde + cuantos > largo) cuantos = largo - desde;
+    entregadas += alimentar(filtro, flujo + desde, cuantos);
+    desde += cuantos;
+  }
+  TEST_ASSERT_EQUAL_UINT8(30, entregadas);
+
+  // La UART desborda a mitad de una RMC: se pierden 12 bytes y falla el checksum
+  size_t corte = 20;
+  alimentar(filtro, RMC, corte);
+  filtro.registrarDesborde();
+  alimentar(filtro, RMC + corte + 12, strlen(RMC) - corte - 12);
+  // Y a mitad de una GGA se pierde el final con el '*': la corta la RMC siguiente
+  alimentar(filtro, GGA, 30);
+  filtro.registrarDesborde();
+  TEST_ASSERT_EQUAL_UINT8(1, alimentar(filtro, RMC));
+
+  const EstadisticasNMEA& est = filtro.estadisticas();
+  TEST_ASSERT_EQUAL_UINT32(43, est.sentencias);
+  TEST_ASSERT_EQUAL_UINT32(31, est.aceptadas);
+  TEST_ASSERT_EQUAL_UINT32(10, est.filtradas);
+  TEST_ASSERT_EQUAL_UINT32(1, est.errorChecksum);
+  TEST_ASSERT_EQUAL_UINT32(1, est.truncadas);
+  TEST_ASSERT_EQUAL_UINT32(2, est.desbordesUart);
+
+  filtro.reiniciarEstadisticas();
+  TEST_ASSERT_EQUAL_UINT32(0, filtro.estadisticas().sentencias);
+  TEST_ASSERT_EQUAL_UINT32(0, filtro.estadisticas().desbordesUart);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_entrega_las_sentencias_pedidas);
+  RUN_TEST(test_filtra_los_tipos_no_pedidos);
+  RUN_TEST(test_descarta_checksum_invalido);
+  RUN_TEST(test_descarta_sentencias_truncadas);
+  RUN_TEST(test_descarta_sentencia_demasiado_larga);
+  RUN_TEST(test_flujo_partido_entre_lecturas);
+  return UNITY_END();
+}
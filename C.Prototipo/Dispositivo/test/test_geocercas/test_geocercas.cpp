@@ -0,0 +1,372 @@
+// ====== Tests de lib/Geocercas ======
+// Carga por líneas, índice de grilla contra fuerza bruta, histéresis de
+// entrada y salida (que no avanza con un fix repetido), permanencia y
+// persistencia del conjunto activo.
+
+#include <unity.h>
+
+#include <Geocercas.h>
+#include <Geodesia.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp() {}
+void tearDown() {}
+
+static const size_t CAPACIDAD_ALMACEN = 256 * 1024;
+static uint8_t buffers[GEOCERCAS_ARCHIVOS * CAPACIDAD_ALMACEN];
+static const ConfigGeocercas CONFIG = {30, 2, 3, 60000};
+
+// Eventos avisados
+struct Aviso {
+  EventoGeocerca evento;
+  uint32_t id;
+  uint32_t duracionMs;
+};
+static Aviso avisos[16];
+static uint8_t cantidadAvisos;
+
+static void registrarAviso(EventoGeocerca evento, uint32_t id, uint32_t duracionMs) {
+  if (cantidadAvisos < 16) avisos[cantidadAvisos++] = {evento, id, duracionMs};
+}
+
+static ResultadoCarga cargar(Geocercas& g, const char* texto) {
+  return g.recibir(texto, strlen(texto));
+}
+
+static void compilar(Geocercas& g) {
+  ResultadoCarga r;
+  int pasos = 0;
+  while ((r = g.avanzarCompilacion(7)) == CARGA_EN_CURSO) pasos++;
+  TEST_ASSERT_EQUAL(CARGA_COMPLETA, r);
+  TEST_ASSERT_TRUE(pasos > 0);
+}
+
+// Depósito circular de 100 m y un polígono cóncavo en forma de U:
+//
+//   (-31.400,-64.200) ........ (-31.400,-64.190)
+//        |  ....  |      |  (hueco entre -64.197 y -64.193, hasta -31.405)
+//   (-31.410,-64.200) ........ (-31.410,-64.190)
+static const char* CONJUNTO =
+    "inicio 7\n"
+    "c 100 -31.420000 -64.180000 100\n"
+    "p 200 -31.400 -64.200 -31.410 -64.200 -31.410 -64.190 -31.400 -64.190 -31.400 -64.193"
+    " -31.405 -64.193 -31.405 -64.197 -31.400 -64.197\n"
+    "fin 7 2\n";
+
+// Metros al norte del centro del depósito, en 1e-6 grados
+static int32_t alNorte(double metros) {
+  return -31420000 + (int32_t)(metros * 8.9932);
+}
+
+void test_carga_y_compilacion() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  GeocercasFija<64, 16> g(almacen, CONFIG);
+  TEST_ASSERT_FALSE(g.iniciar());
+  TEST_ASSERT_EQUAL(CARGA_COMPLETA, cargar(g, CONJUNTO));
+  TEST_ASSERT_TRUE(g.compilando());
+  TEST_ASSERT_EQUAL_UINT32(0, g.version());
+  compilar(g);
+  TEST_ASSERT_FALSE(g.compilando());
+  TEST_ASSERT_EQUAL_UINT32(7, g.version());
+  TEST_ASSERT_EQUAL_UINT32(2, g.zonas());
+  TEST_ASSERT_EQUAL_UINT32(0, almacen.tamano(GEOCERCAS_RECIBIDAS));
+}
+
+void test_la_carga_puede_venir_en_varios_mensajes() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  GeocercasFija<64, 16> g(almacen, CONFIG);
+  TEST_ASSERT_EQUAL(CARGA_EN_CURSO, cargar(g, "inicio 3\r\nc 1 -31.42 -64.18 50\r\n"));
+  TEST_ASSERT_EQUAL(CARGA_EN_CURSO, cargar(g, "# depósito norte\nc 2 -31.40 -64.18 50\n"));
+  TEST_ASSERT_EQUAL(CARGA_COMPLETA, cargar(g, "fin 3 2"));
+  compilar(g);
+  TEST_ASSERT_EQUAL_UINT32(2, g.zonas());
+}
+
+void test_una_carga_con_errores_deja_el_conjunto_anterior() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  GeocercasFija<64, 16> g(almacen, CONFIG);
+  cargar(g, CONJUNTO);
+  compilar(g);
+
+  TEST_ASSERT_EQUAL(CARGA_SIN_INICIO, cargar(g, "c 1 -31.42 -64.18 50\n"));
+  TEST_ASSERT_EQUAL(CARGA_MAL_FORMADA, cargar(g, "inicio 8\nc 1 -31.42 -64.18\n"));
+  TEST_ASSERT_EQUAL(CARGA_MAL_FORMADA, cargar(g, "inicio 8\nc 1 -95.0 -64.18 50\n"));
+  TEST_ASSERT_EQUAL(CARGA_MAL_FORMADA, cargar(g, "inicio 8\np 1 -31.4 -64.2 -31.5 -64.2\n"));
+  TEST_ASSERT_EQUAL(CARGA_MAL_FORMADA, cargar(g, "inicio 8\nx 1\n"));
+  TEST_ASSERT_EQUAL(CARGA_INCOMPLETA, cargar(g, "inicio 8\nc 1 -31.42 -64.18 50\nfin 8 2\n"));
+  TEST_ASSERT_EQUAL(CARGA_INCOMPLETA, cargar(g, "inicio 8\nc 1 -31.42 -64.18 50\nfin 9 1\n"));
+  TEST_ASSERT_EQUAL(CARGA_SIN_INICIO, cargar(g, "fin 8 1\n"));
+
+  TEST_ASSERT_FALSE(g.compilando());
+  TEST_ASSERT_EQUAL_UINT32(7, g.version());
+  TEST_ASSERT_EQUAL_UINT32(2, g.zonas());
+}
+
+void test_sin_lugar_en_el_almacen() {
+  AlmacenGeocercasMemoria almacen(buffers, 100);
+  GeocercasFija<64, 16> g(almacen, CONFIG);
+  TEST_ASSERT_EQUAL(CARGA_ERROR_ALMACEN, cargar(g, CONJUNTO));
+  TEST_ASSERT_FALSE(g.compilando());
+}
+
+void test_circulo_con_histeresis_de_entrada_y_salida() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  GeocercasFija<64, 16> g(almacen, CONFIG);
+  cargar(g, CONJUNTO);
+  compilar(g);
+  cantidadAvisos = 0;
+  uint32_t t = 0;
+
+  // Afuera, un fix adentro suelto (no alcanza) y después dos seguidos
+  TEST_ASSERT_EQUAL_UINT8(0, g.evaluar(alNorte(150), -64180000, t += 1000, registrarAviso));
+  TEST_ASSERT_EQUAL_UINT8(0, g.evaluar(alNorte(90), -64180000, t += 1000, registrarAviso));
+  TEST_ASSERT_EQUAL_UINT8(0, g.evaluar(alNorte(150), -64180000, t += 1000, registrarAviso));
+  TEST_ASSERT_EQUAL_UINT8(0, g.evaluar(alNorte(90), -64180000, t += 1000, registrarAviso));
+  TEST_ASSERT_FALSE(g.adentro());
+  TEST_ASSERT_EQUAL_UINT8(1, g.evaluar(alNorte(50), -64180000, t += 1000, registrarAviso));
+  TEST_ASSERT_TRUE(g.adentro());
+  TEST_ASSERT_EQUAL(GEOCERCA_ENTRADA, avisos[0].evento);
+  TEST_ASSERT_EQUAL_UINT32(100, avisos[0].id);
+  uint32_t entrada = t;
+
+  // Ruido en el borde: dentro del margen de salida no cuenta como afuera
+  for (int i = 0; i < 5; i++) {
+    TEST_ASSERT_EQUAL_UINT8(0, g.evaluar(alNorte(120), -64180000, t += 1000, registrarAviso));
+  }
+  // Dos fixes lejos y uno adentro: la cuenta de salida vuelve a cero
+  g.evaluar(alNorte(200), -64180000, t += 1000, registrarAviso);
+  g.evaluar(alNorte(200), -64180000, t += 1000, registrarAviso);
+  g.evaluar(alNorte(0), -64180000, t += 1000, registrarAviso);
+  g.evaluar(alNorte(200), -64180000, t += 1000, registrarAviso);
+  g.evaluar(alNorte(200), -64180000, t += 1000, registrarAviso);
+  TEST_ASSERT_EQUAL_UINT8(1, cantidadAvisos);
+  TEST_ASSERT_EQUAL_UINT8(1, g.evaluar(alNorte(200), -64180000, t += 1000, registrarAviso));
+  TEST_ASSERT_EQUAL(GEOCERCA_SALIDA, avisos[1].evento);
+  TEST_ASSERT_EQUAL_UINT32(t - entrada, avisos[1].duracionMs);
+  TEST_ASSERT_FALSE(g.adentro());
+}
+
+void test_poligono_concavo() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  ConfigGeocercas config = CONFIG;
+  config.fixesEntrada = 1;
+  GeocercasFija<64, 16> g(almacen, config);
+  cargar(g, CONJUNTO);
+  compilar(g);
+  cantidadAvisos = 0;
+
+  // En el hueco de la U: dentro de la caja pero afuera del polígono
+  TEST_ASSERT_EQUAL_UINT8(0, g.evaluar(-31402000, -64195000, 1000, registrarAviso));
+  // En una de las patas
+  TEST_ASSERT_EQUAL_UINT8(1, g.evaluar(-31402000, -64199000, 2000, registrarAviso));
+  TEST_ASSERT_EQUAL_UINT32(200, avisos[0].id);
+  // En la base, por debajo del hueco
+  TEST_ASSERT_EQUAL_UINT8(0, g.evaluar(-31408000, -64195000, 3000, registrarAviso));
+  TEST_ASSERT_TRUE(g.adentro());
+}
+
+void test_contiene_con_margen() {
+  int32_t cuadrado[] = {0, 0, 0, 1000, 1000, 1000, 1000, 0};  // ~111 m de lado en el ecuador
+  RegistroZona z = {};
+  z.tipo = ZONA_POLIGONO;
+  z.vertices = 4;
+  z.cosLatQ15 = 32767;
+  TEST_ASSERT_TRUE(Geocercas::contiene(z, cuadrado, 500, 500, 0));
+  TEST_ASSERT_FALSE(Geocercas::contiene(z, cuadrado, 500, 1200, 0));
+  // 200 microgrados al este del borde son ~22 m
+  TEST_ASSERT_TRUE(Geocercas::contiene(z, cuadrado, 500, 1200, 25));
+  TEST_ASSERT_FALSE(Geocercas::contiene(z, cuadrado, 500, 1200, 20));
+  // Frente a una esquina cuenta la distancia al vértice (~31 m)
+  TEST_ASSERT_FALSE(Geocercas::contiene(z, cuadrado, 1200, 1200, 30));
+  TEST_ASSERT_TRUE(Geocercas::contiene(z, cuadrado, 1200, 1200, 32));
+}
+
+// Sin señal el GPS repite el último fix: evaluarlo otra vez no confirma
+// entradas, salidas ni permanencias
+void test_el_mismo_fix_no_avanza_la_histeresis() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  GeocercasFija<64, 16> g(almacen, CONFIG);
+  cargar(g, CONJUNTO);
+  compilar(g);
+  cantidadAvisos = 0;
+
+  // Un solo fix adentro, repetido por el temporizador
+  for (int i = 0; i < 10; i++) {
+    TEST_ASSERT_EQUAL_UINT8(0, g.evaluar(alNorte(0), -64180000, 1000, registrarAviso));
+  }
+  TEST_ASSERT_FALSE(g.adentro());
+  TEST_ASSERT_EQUAL_UINT32(1, g.estadisticas().evaluaciones);
+  TEST_ASSERT_EQUAL_UINT32(9, g.estadisticas().repetidos);
+
+  // Un fix nuevo sí cuenta
+  TEST_ASSERT_EQUAL_UINT8(1, g.evaluar(alNorte(0), -64180000, 2000, registrarAviso));
+  TEST_ASSERT_TRUE(g.adentro());
+
+  // En un túnel después de salir: el último fix afuera se repite y no alcanza
+  g.evaluar(alNorte(200), -64180000, 3000, registrarAviso);
+  for (int i = 0; i < 10; i++) g.evaluar(alNorte(200), -64180000, 3000, registrarAviso);
+  TEST_ASSERT_TRUE(g.adentro());
+  TEST_ASSERT_EQUAL_UINT8(1, cantidadAvisos);
+  // Los fixes nuevos completan la salida
+  g.evaluar(alNorte(200), -64180000, 4000, registrarAviso);
+  TEST_ASSERT_EQUAL_UINT8(1, g.evaluar(alNorte(200), -64180000, 5000, registrarAviso));
+  TEST_ASSERT_EQUAL(GEOCERCA_SALIDA, avisos[1].evento);
+  TEST_ASSERT_FALSE(g.adentro());
+}
+
+void test_permanencia_una_vez_por_visita() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  GeocercasFija<64, 16> g(almacen, CONFIG);
+  cargar(g, CONJUNTO);
+  compilar(g);
+  cantidadAvisos = 0;
+
+  uint32_t t = 0;
+  g.evaluar(alNorte(0), -64180000, t += 1000, registrarAviso);
+  g.evaluar(alNorte(0), -64180000, t += 1000, registrarAviso);
+  uint32_t entrada = t;
+  TEST_ASSERT_EQUAL_UINT8(1, cantidadAvisos);
+  while (t - entrada < 120000) g.evaluar(alNorte(0), -64180000, t += 5000, registrarAviso);
+  TEST_ASSERT_EQUAL_UINT8(2, cantidadAvisos);
+  TEST_ASSERT_EQUAL(GEOCERCA_PERMANENCIA, avisos[1].evento);
+  TEST_ASSERT_EQUAL_UINT32(60000, avisos[1].duracionMs);
+}
+
+void test_el_conjunto_activo_sobrevive_a_un_reinicio() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  {
+    GeocercasFija<64, 16> g(almacen, CONFIG);
+    cargar(g, CONJUNTO);
+    compilar(g);
+  }
+  GeocercasFija<64, 16> g(almacen, CONFIG);
+  TEST_ASSERT_TRUE(g.iniciar());
+  TEST_ASSERT_EQUAL_UINT32(7, g.version());
+  cantidadAvisos = 0;
+  g.evaluar(alNorte(0), -64180000, 1000, registrarAviso);
+  g.evaluar(alNorte(0), -64180000, 2000, registrarAviso);
+  TEST_ASSERT_EQUAL_UINT8(1, cantidadAvisos);
+}
+
+void test_una_recarga_conserva_las_zonas_seguidas() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  ConfigGeocercas config = CONFIG;
+  config.fixesEntrada = 1;
+  config.fixesSalida = 1;
+  GeocercasFija<64, 16> g(almacen, config);
+  cargar(g, CONJUNTO);
+  compilar(g);
+  cantidadAvisos = 0;
+  g.evaluar(-31402000, -64199000, 1000, registrarAviso);
+  TEST_ASSERT_TRUE(g.adentro());
+
+  // Versión nueva con otra zona antes: el polígono cambia de lugar en el archivo
+  TEST_ASSERT_EQUAL(CARGA_COMPLETA,
+                    cargar(g, "inicio 8\nc 300 -31.000 -64.000 80\n"
+                              "p 200 -31.400 -64.200 -31.410 -64.200 -31.410 -64.190 -31.400 -64.190 -31.400 -64.193"
+                              " -31.405 -64.193 -31.405 -64.197 -31.400 -64.197\n"
+                              "fin 8 2\n"));
+  compilar(g);
+  TEST_ASSERT_EQUAL_UINT32(8, g.version());
+  TEST_ASSERT_EQUAL_UINT8(0, g.evaluar(-31402000, -64199000, 2000, registrarAviso));
+  TEST_ASSERT_TRUE(g.adentro());
+  TEST_ASSERT_EQUAL_UINT8(1, g.evaluar(-31402000, -64195000, 3000, registrarAviso));
+  TEST_ASSERT_EQUAL(GEOCERCA_SALIDA, avisos[1].evento);
+}
+
+// Muchas zonas al azar, con bloques de refs chicos para forzar varias
+// pasadas: el índice tiene que ver lo mismo que probar todas las zonas
+void test_la_grilla_coincide_con_la_fuerza_bruta() {
+  static const int ZONAS = 400;
+  static RegistroZona zonas[ZONAS];
+  static int32_t vertices[ZONAS][2 * 6];
+  static char linea[256];
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  ConfigGeocercas config = CONFIG;
+  config.fixesEntrada = 1;
+  config.fixesSalida = 1;
+  config.margenSalidaM = 0;
+  GeocercasFija<256, 64> g(almacen, config);
+
+  srand(12345);
+  TEST_ASSERT_EQUAL(CARGA_EN_CURSO, cargar(g, "inicio 1\n"));
+  for (int i = 0; i < ZONAS; i++) {
+    RegistroZona& z = zonas[i];
+    memset(&z, 0, sizeof(z));
+    z.id = 1000 + i;
+    int32_t lat = -31500000 + rand() % 200000;
+    int32_t lon = -64300000 + rand() % 200000;
+    z.cosLatQ15 = cosenoQ15(lat / 1e6);
+    if (i % 2 == 0) {
+      uint32_t radio = 30 + rand() % 300;
+      z.tipo = ZONA_CIRCULO;
+      z.latE6 = lat;
+      z.lonE6 = lon;
+      z.radioCm = radio * 100;
+      snprintf(linea, sizeof(linea), "c %lu %.6f %.6f %lu\n", (unsigned long)z.id, lat / 1e6, lon / 1e6,
+               (unsigned long)radio);
+    } else {
+      // Hexágono irregular alrededor de (lat, lon)
+      z.tipo = ZONA_POLIGONO;
+      z.vertices = 6;
+      int n = snprintf(linea, sizeof(linea), "p %lu", (unsigned long)z.id);
+      static const int DIRECCIONES[6][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 0}, {-1, -1}, {0, -1}};
+      for (int k = 0; k < 6; k++) {
+        int32_t d = 500 + rand() % 3000;
+        vertices[i][2 * k] = lat + DIRECCIONES[k][0] * d;
+        vertices[i][2 * k + 1] = lon + DIRECCIONES[k][1] * d;
+        n += snprintf(linea + n, sizeof(linea) - n, " %.6f %.6f", vertices[i][2 * k] / 1e6,
+                      vertices[i][2 * k + 1] / 1e6);
+      }
+      snprintf(linea + n, sizeof(linea) - n, "\n");
+    }
+    TEST_ASSERT_EQUAL(CARGA_EN_CURSO, cargar(g, linea));
+  }
+  snprintf(linea, sizeof(linea), "fin 1 %d\n", ZONAS);
+  TEST_ASSERT_EQUAL(CARGA_COMPLETA, cargar(g, linea));
+  compilar(g);
+
+  // Cada fix en un lugar nuevo: con fixesEntrada = fixesSalida = 1 las zonas
+  // adentro son las que entraron menos las que salieron
+  bool dentro[ZONAS] = {};
+  int coincidencias = 0;
+  for (int f = 0; f < 3000; f++) {
+    int32_t lat = -31510000 + rand() % 220000;
+    int32_t lon = -64310000 + rand() % 220000;
+    cantidadAvisos = 0;
+    g.evaluar(lat, lon, f * 1000, registrarAviso);
+    for (uint8_t a = 0; a < cantidadAvisos; a++) {
+      int i = avisos[a].id - 1000;
+      if (avisos[a].evento == GEOCERCA_ENTRADA) dentro[i] = true;
+      if (avisos[a].evento == GEOCERCA_SALIDA) dentro[i] = false;
+    }
+    for (int i = 0; i < ZONAS; i++) {
+      bool esperado = Geocercas::contiene(zonas[i], vertices[i], lat, lon, 0);
+      TEST_ASSERT_EQUAL_MESSAGE(esperado, dentro[i], "zona distinta de la fuerza bruta");
+      if (esperado) coincidencias++;
+    }
+  }
+  TEST_ASSERT_TRUE(coincidencias > 100);
+  TEST_ASSERT_EQUAL_UINT32(0, g.estadisticas().truncados);
+  TEST_ASSERT_EQUAL_UINT32(0, g.estadisticas().sinLugar);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_carga_y_compilacion);
+  RUN_TEST(test_la_carga_puede_venir_en_varios_mensajes);
+  RUN_TEST(test_una_carga_con_errores_deja_el_conjunto_anterior);
+  RUN_TEST(test_sin_lugar_en_el_almacen);
+  RUN_TEST(test_circulo_con_histeresis_de_entrada_y_salida);
+  RUN_TEST(test_poligono_concavo);
+  RUN_TEST(test_contiene_con_margen);
+  RUN_TEST(test_el_mismo_fix_no_avanza_la_histeresis);
+  RUN_TEST(test_permanencia_una_vez_por_visita);
+  RUN_TEST(test_el_conjunto_activo_sobrevive_a_un_reinicio);
+  RUN_TEST(test_una_recarga_conserva_las_zonas_seguidas);
+  RUN_TEST(test_la_grilla_coincide_con_la_fuerza_bruta);
+  return UNITY_END();
+}
@@ -0,0 +1,76 @@
+// ====== Tests de lib/Geodesia ======
+// Las variantes baratas contra el haversine en double, con las cotas de
+// error que promete Geodesia.h.
+
+#include <unity.h>
+
+#include <Geodesia.h>
+
+#include <math.h>
+
+void setUp() {}
+void tearDown() {}
+
+// Un grado de meridiano en la esfera de 6371 km
+static const double METROS_POR_GRADO = RADIO_TIERRA_M * M_PI / 180.0;
+
+void test_haversine_un_grado_de_latitud() {
+  TEST_ASSERT_DOUBLE_WITHIN(0.01, METROS_POR_GRADO, distanciaHaversine(-31.0, -64.0, -32.0, -64.0));
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, distanciaHaversine(-31.42, -64.18, -31.42, -64.18));
+}
+
+void test_haversine_es_simetrico() {
+  double ida = distanciaHaversine(-31.4201, -64.1888, -31.4012, -64.1623);
+  double vuelta = distanciaHaversine(-31.4012, -64.1623, -31.4201, -64.1888);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-6, ida, vuelta);
+}
+
+// Recorre distancias de hasta 5 km en varias latitudes y rumbos
+void test_variantes_dentro_de_la_cota() {
+  ProyeccionLocal proyeccion;
+  for (int lat = -60; lat <= 60; lat += 15) {
+    for (int rumbo = 0; rumbo < 360; rumbo += 30) {
+      for (double metros = 10; metros <= 5000; metros *= 3) {
+        double lat1 = lat + 0.123;
+        double lon1 = -64.1888;
+        double r = rumbo * M_PI / 180.0;
+        double lat2 = lat1 + metros * cos(r) / METROS_POR_GRADO;
+        double lon2 = lon1 + metros * sin(r) / (METROS_POR_GRADO * cos(lat1 * M_PI / 180.0));
+        double referencia = distanciaHaversine(lat1, lon1, lat2, lon2);
+
+        TEST_ASSERT_FLOAT_WITHIN(1.7f, (float)referencia,
+                                 distanciaHaversineF((float)lat1, (float)lon1, (float)lat2, (float)lon2));
+        TEST_ASSERT_FLOAT_WITHIN((float)(referencia * 0.0003 + 0.01), (float)referencia,
+                                 proyeccion.distancia(lat1, lon1, lat2, lon2));
+        uint32_t cm = distanciaMicrogradosCm(gradosAE6(lat1), gradosAE6(lon1), gradosAE6(lat2), gradosAE6(lon2),
+                                             cosenoQ15(lat1));
+        TEST_ASSERT_FLOAT_WITHIN((float)(0.2 + referencia * 0.001), (float)referencia, cm / 100.0f);
+      }
+    }
+  }
+}
+
+void test_proyeccion_recalcula_el_coseno_lejos_del_origen() {
+  ProyeccionLocal proyeccion(0.1f);
+  proyeccion.distancia(-31.0, -64.0, -31.001, -64.0);
+  float cosenoCordoba = proyeccion.cosenoLatitud();
+  proyeccion.distancia(-45.0, -64.0, -45.001, -64.0);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, (float)cos(45.0 * M_PI / 180.0), proyeccion.cosenoLatitud());
+  TEST_ASSERT_TRUE(cosenoCordoba > proyeccion.cosenoLatitud());
+}
+
+void test_conversion_a_microgrados_redondea() {
+  TEST_ASSERT_EQUAL_INT32(-31420100, gradosAE6(-31.4201));
+  TEST_ASSERT_EQUAL_INT32(1, gradosAE6(0.0000006));
+  TEST_ASSERT_EQUAL_INT32(-1, gradosAE6(-0.0000006));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_haversine_un_grado_de_latitud);
+  RUN_TEST(test_haversine_es_simetrico);
+  RUN_TEST(test_variantes_dentro_de_la_cota);
+  RUN_TEST(test_proyeccion_recalcula_el_coseno_lejos_del_origen);
+  RUN_TEST(test_conversion_a_microgrados_redondea);
+  return UNITY_END();
+}
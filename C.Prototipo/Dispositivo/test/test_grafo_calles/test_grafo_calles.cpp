@@ -0,0 +1,345 @@
+// ====== Tests de lib/GrafoCalles ======
+// Carga completa y por cambios, emparejamiento con rumbo, transición entre
+// tramos conectados, histéresis y el índice de grilla contra fuerza bruta.
+
+#include <unity.h>
+
+#include <GrafoCalles.h>
+#include <Geodesia.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp() {}
+void tearDown() {}
+
+static const size_t CAPACIDAD_ALMACEN = 256 * 1024;
+static uint8_t buffers[GEOCERCAS_ARCHIVOS * CAPACIDAD_ALMACEN];
+// Radio, diferencia de rumbo, fixes para confirmar y para soltar, velocidad
+static const ConfigGrafoCalles CONFIG = {15, 35, 2, 3, 8};
+
+static ResultadoCarga cargar(GrafoCalles& g, const char* texto) {
+  return g.recibir(texto, strlen(texto));
+}
+
+static void compilar(GrafoCalles& g) {
+  ResultadoCarga r;
+  int pasos = 0;
+  while ((r = g.avanzarCompilacion(5)) == CARGA_EN_CURSO) pasos++;
+  TEST_ASSERT_EQUAL(CARGA_COMPLETA, r);
+  TEST_ASSERT_TRUE(pasos > 0);
+}
+
+// Una avenida este-oeste sobre la latitud -31.42 en dos tramos que comparten
+// el nodo de -64.19, una calle hacia el norte desde ese nodo y un tramo
+// paralelo a 8 m al norte del tramo 2 que no toca a ninguno:
+//
+//              3
+//              |
+//   1 ---------+--------- 2
+//                ......... 9
+static const char* GRAFO =
+    "inicio 7\n"
+    "t 1 -31.420000 -64.200000 -31.420000 -64.190000\n"
+    "t 2 -31.420000 -64.190000 -31.420000 -64.180000\n"
+    "t 3 -31.420000 -64.190000 -31.410000 -64.190000\n"
+    "t 9 -31.419928 -64.188000 -31.419928 -64.180000\n"
+    "fin 7 4\n";
+
+// Metros al norte de la avenida, en 1e-6 grados
+static int32_t alNorte(double metros) {
+  return -31420000 + (int32_t)(metros * 8.9932);
+}
+
+static void cargarGrafo(GrafoCalles& g) {
+  TEST_ASSERT_EQUAL(CARGA_COMPLETA, cargar(g, GRAFO));
+  compilar(g);
+}
+
+void test_carga_y_compilacion() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  GrafoCallesFija<64, 16> g(almacen, CONFIG);
+  TEST_ASSERT_FALSE(g.iniciar());
+  TEST_ASSERT_EQUAL(CARGA_COMPLETA, cargar(g, GRAFO));
+  TEST_ASSERT_TRUE(g.compilando());
+  TEST_ASSERT_EQUAL_UINT32(0, g.version());
+  compilar(g);
+  TEST_ASSERT_EQUAL_UINT32(7, g.version());
+  TEST_ASSERT_EQUAL_UINT32(4, g.tramos());
+  TEST_ASSERT_EQUAL_UINT32(0, almacen.tamano(GEOCERCAS_RECIBIDAS));
+
+  // Sobrevive a un reinicio
+  GrafoCallesFija<64, 16> otro(almacen, CONFIG);
+  TEST_ASSERT_TRUE(otro.iniciar());
+  TEST_ASSERT_EQUAL_UINT32(7, otro.version());
+}
+
+void test_cargas_mal_formadas_dejan_el_grafo_anterior() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  GrafoCallesFija<64, 16> g(almacen, CONFIG);
+  cargarGrafo(g);
+
+  // IDs desordenados, borrado en una carga completa, ID 0
+  TEST_ASSERT_EQUAL(CARGA_MAL_FORMADA, cargar(g, "inicio 8\nt 5 -31.4 -64.2 -31.4 -64.1\nt 4 -31.4 -64.2 -31.4 -64.1\n"));
+  TEST_ASSERT_EQUAL(CARGA_MAL_FORMADA, cargar(g, "inicio 8\nb 5\n"));
+  TEST_ASSERT_EQUAL(CARGA_MAL_FORMADA, cargar(g, "inicio 8\nt 0 -31.4 -64.2 -31.4 -64.1\n"));
+  TEST_ASSERT_EQUAL(CARGA_INCOMPLETA, cargar(g, "inicio 8\nt 5 -31.4 -64.2 -31.4 -64.1\nfin 8 2\n"));
+  TEST_ASSERT_EQUAL(CARGA_SIN_INICIO, cargar(g, "t 5 -31.4 -64.2 -31.4 -64.1\n"));
+  // Cambios sobre una versión que el equipo no tiene
+  TEST_ASSERT_EQUAL(CARGA_OTRA_BASE, cargar(g, "inicio 9 6\nb 1\nfin 9 1\n"));
+
+  TEST_ASSERT_FALSE(g.compilando());
+  TEST_ASSERT_EQUAL_UINT32(7, g.version());
+  TEST_ASSERT_EQUAL_UINT32(4, g.tramos());
+}
+
+void test_recorrido_por_la_avenida() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  GrafoCallesFija<64, 16> g(almacen, CONFIG);
+  cargarGrafo(g);
+
+  // Hacia el este a 3 m de la avenida: el segundo fix confirma el tramo 1
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_SIGUE, g.emparejar(alNorte(3), -64196000, 90, 40));
+  TEST_ASSERT_FALSE(g.enConocida());
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_CONOCIDA, g.emparejar(alNorte(3), -64195000, 90, 40));
+  TEST_ASSERT_EQUAL_UINT32(1, g.tramoActual());
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_SIGUE, g.emparejar(alNorte(-2), -64192000, 92, 40));
+  // Pasa el nodo: tramo 2, conectado al 1
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_OTRO_TRAMO, g.emparejar(alNorte(1), -64189000, 90, 40));
+  TEST_ASSERT_EQUAL_UINT32(2, g.tramoActual());
+
+  // Se aleja 60 m: suelta la avenida al tercer fix sin tramo
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_SIGUE, g.emparejar(alNorte(-60), -64187000, 90, 40));
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_SIGUE, g.emparejar(alNorte(-60), -64186000, 90, 40));
+  TEST_ASSERT_TRUE(g.enConocida());
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_NUEVA, g.emparejar(alNorte(-60), -64185000, 90, 40));
+  TEST_ASSERT_FALSE(g.enConocida());
+  TEST_ASSERT_EQUAL_UINT32(0, g.tramoActual());
+
+  TEST_ASSERT_EQUAL_UINT8(2, g.largoRecorrido());
+  TEST_ASSERT_EQUAL_UINT32(1, g.recorrido()[0]);
+  TEST_ASSERT_EQUAL_UINT32(2, g.recorrido()[1]);
+  TEST_ASSERT_FALSE(g.recorridoDesbordado());
+
+  const EstadisticasGrafo& e = g.estadisticas();
+  TEST_ASSERT_EQUAL_UINT32(7, e.fixes);
+  TEST_ASSERT_EQUAL_UINT32(4, e.emparejados);
+}
+
+void test_el_rumbo_descarta_calles_cruzadas() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  ConfigGrafoCalles c = CONFIG;
+  c.fixesConfirmar = 1;
+  GrafoCallesFija<64, 16> g(almacen, c);
+  cargarGrafo(g);
+
+  // Sobre la avenida yendo al norte: no es la avenida
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_SIGUE, g.emparejar(alNorte(2), -64195000, 0, 40));
+  TEST_ASSERT_FALSE(g.enConocida());
+  // Al oeste también es la avenida, en el otro sentido
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_CONOCIDA, g.emparejar(alNorte(2), -64195000, 268, 40));
+  TEST_ASSERT_EQUAL_UINT32(1, g.tramoActual());
+
+  // Parado el rumbo del GPS no vale y alcanza con la distancia
+  g.reiniciar();
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_CONOCIDA, g.emparejar(alNorte(2), -64195000, 0, 3));
+  TEST_ASSERT_EQUAL_UINT32(1, g.tramoActual());
+
+  // Al norte por la calle 3
+  g.reiniciar();
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_CONOCIDA, g.emparejar(alNorte(200), -64190010, 1, 40));
+  TEST_ASSERT_EQUAL_UINT32(3, g.tramoActual());
+}
+
+void test_prefiere_el_tramo_conectado() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  ConfigGrafoCalles c = CONFIG;
+  c.fixesConfirmar = 1;
+  GrafoCallesFija<64, 16> g(almacen, c);
+  cargarGrafo(g);
+
+  // A 5 m del tramo 2 y a 3 m del 9: viniendo por el 1 sigue por el 2
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_CONOCIDA, g.emparejar(alNorte(0), -64193000, 90, 40));
+  TEST_ASSERT_EQUAL_UINT32(1, g.tramoActual());
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_OTRO_TRAMO, g.emparejar(alNorte(5), -64186000, 90, 40));
+  TEST_ASSERT_EQUAL_UINT32(2, g.tramoActual());
+
+  // Sin historia gana el más cercano
+  g.reiniciar();
+  g.emparejar(alNorte(5), -64186000, 90, 40);
+  TEST_ASSERT_EQUAL_UINT32(9, g.tramoActual());
+}
+
+void test_cambios_sobre_la_version_en_uso() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  ConfigGrafoCalles c = CONFIG;
+  c.fixesConfirmar = 1;
+  GrafoCallesFija<64, 16> g(almacen, c);
+  cargarGrafo(g);
+
+  // El 2 se corre 100 m al sur, el 3 se borra, aparece el 5 y el 9 queda
+  TEST_ASSERT_EQUAL(CARGA_COMPLETA, cargar(g,
+                                           "inicio 8 7\n"
+                                           "t 2 -31.420900 -64.190000 -31.420900 -64.180000\n"
+                                           "b 3\n"
+                                           "t 5 -31.430000 -64.200000 -31.430000 -64.190000\n"
+                                           "fin 8 3\n"));
+  compilar(g);
+  TEST_ASSERT_EQUAL_UINT32(8, g.version());
+  TEST_ASSERT_EQUAL_UINT32(4, g.tramos());
+
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_SIGUE, g.emparejar(alNorte(200), -64190000, 0, 40));
+  g.reiniciar();
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_CONOCIDA, g.emparejar(alNorte(-100), -64185000, 90, 40));
+  TEST_ASSERT_EQUAL_UINT32(2, g.tramoActual());
+  g.reiniciar();
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_CONOCIDA, g.emparejar(-31430000, -64195000, 90, 40));
+  TEST_ASSERT_EQUAL_UINT32(5, g.tramoActual());
+  g.reiniciar();
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_CONOCIDA, g.emparejar(alNorte(1), -64196000, 90, 40));
+  TEST_ASSERT_EQUAL_UINT32(1, g.tramoActual());
+
+  // Borrar todo deja un grafo vacío pero válido
+  TEST_ASSERT_EQUAL(CARGA_COMPLETA, cargar(g, "inicio 9 8\nb 1\nb 2\nb 5\nb 9\nfin 9 4\n"));
+  compilar(g);
+  TEST_ASSERT_EQUAL_UINT32(9, g.version());
+  TEST_ASSERT_EQUAL_UINT32(0, g.tramos());
+  g.reiniciar();
+  TEST_ASSERT_EQUAL(EMPAREJAMIENTO_SIGUE, g.emparejar(alNorte(1), -64196000, 90, 40));
+}
+
+void test_recorrido_desbordado() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  ConfigGrafoCalles c = CONFIG;
+  c.fixesConfirmar = 1;
+  GrafoCallesFija<64, 16> g(almacen, c);
+
+  // Una avenida de 40 tramos de ~95 m
+  static char texto[4096];
+  int largo = snprintf(texto, sizeof(texto), "inicio 1\n");
+  for (int i = 0; i < 40; i++) {
+    largo += snprintf(texto + largo, sizeof(texto) - largo, "t %d -31.420000 %.6f -31.420000 %.6f\n", i + 1,
+                      -64.2 + i * 0.001, -64.2 + (i + 1) * 0.001);
+  }
+  snprintf(texto + largo, sizeof(texto) - largo, "fin 1 40\n");
+  TEST_ASSERT_EQUAL(CARGA_COMPLETA, cargar(g, texto));
+  compilar(g);
+
+  for (int i = 0; i < 40; i++) g.emparejar(alNorte(1), -64199500 + i * 1000, 90, 40);
+  TEST_ASSERT_EQUAL_UINT8(GRAFO_MAX_RECORRIDO, g.largoRecorrido());
+  TEST_ASSERT_TRUE(g.recorridoDesbordado());
+
+  // Un recorrido nuevo empieza por el tramo en curso
+  g.reiniciarRecorrido();
+  TEST_ASSERT_EQUAL_UINT8(1, g.largoRecorrido());
+  TEST_ASSERT_EQUAL_UINT32(40, g.recorrido()[0]);
+  TEST_ASSERT_FALSE(g.recorridoDesbordado());
+}
+
+// ====== Grilla contra fuerza bruta ======
+
+static uint32_t semilla = 12345;
+static uint32_t aleatorio(uint32_t n) {
+  semilla = semilla * 1103515245u + 12345u;
+  return (semilla >> 8) % n;
+}
+
+struct TramoPrueba {
+  RegistroTramo t;
+  bool vivo;
+};
+
+void test_la_grilla_coincide_con_la_fuerza_bruta() {
+  AlmacenGeocercasMemoria almacen(buffers, CAPACIDAD_ALMACEN);
+  ConfigGrafoCalles c = CONFIG;
+  c.radioM = 25;
+  c.fixesConfirmar = 1;
+  GrafoCallesFija<256, 64> g(almacen, c);
+
+  // 300 tramos de hasta ~150 m en un área de ~3 km; la mitad llega en la
+  // carga completa y el resto como cambios, con algunos borrados
+  const int N = 300;
+  static TramoPrueba tramos[N];
+  static char texto[32 * 1024];
+  for (int i = 0; i < N; i++) {
+    RegistroTramo& t = tramos[i].t;
+    t.id = (uint32_t)(i + 1) * 3;
+    t.lat0E6 = -31420000 + (int32_t)aleatorio(27000);
+    t.lon0E6 = -64200000 + (int32_t)aleatorio(32000);
+    t.lat1E6 = t.lat0E6 + (int32_t)aleatorio(2700) - 1350;
+    t.lon1E6 = t.lon0E6 + (int32_t)aleatorio(3200) - 1600;
+    tramos[i].vivo = false;
+  }
+
+  int largo = snprintf(texto, sizeof(texto), "inicio 1\n");
+  int lineas = 0;
+  for (int i = 0; i < N; i += 2) {
+    const RegistroTramo& t = tramos[i].t;
+    largo += snprintf(texto + largo, sizeof(texto) - largo, "t %lu %.6f %.6f %.6f %.6f\n", (unsigned long)t.id,
+                      t.lat0E6 / 1e6, t.lon0E6 / 1e6, t.lat1E6 / 1e6, t.lon1E6 / 1e6);
+    tramos[i].vivo = true;
+    lineas++;
+  }
+  snprintf(texto + largo, sizeof(texto) - largo, "fin 1 %d\n", lineas);
+  TEST_ASSERT_EQUAL(CARGA_COMPLETA, cargar(g, texto));
+  compilar(g);
+
+  largo = snprintf(texto, sizeof(texto), "inicio 2 1\n");
+  lineas = 0;
+  for (int i = 0; i < N; i++) {
+    const RegistroTramo& t = tramos[i].t;
+    if (i % 2 == 1) {
+      largo += snprintf(texto + largo, sizeof(texto) - largo, "t %lu %.6f %.6f %.6f %.6f\n", (unsigned long)t.id,
+                        t.lat0E6 / 1e6, t.lon0E6 / 1e6, t.lat1E6 / 1e6, t.lon1E6 / 1e6);
+      tramos[i].vivo = true;
+      lineas++;
+    } else if (i % 10 == 0) {
+      largo += snprintf(texto + largo, sizeof(texto) - largo, "b %lu\n", (unsigned long)t.id);
+      tramos[i].vivo = false;
+      lineas++;
+    }
+  }
+  snprintf(texto + largo, sizeof(texto) - largo, "fin 2 %d\n", lineas);
+  TEST_ASSERT_EQUAL(CARGA_COMPLETA, cargar(g, texto));
+  compilar(g);
+  TEST_ASSERT_EQUAL_UINT32(2, g.version());
+  TEST_ASSERT_EQUAL_UINT32(N - N / 10, g.tramos());
+
+  // Sin rumbo ni historia gana el tramo más cercano a menos de radioM
+  int conTramo = 0;
+  for (int k = 0; k < 3000; k++) {
+    int32_t lat = -31421000 + (int32_t)aleatorio(30000);
+    int32_t lon = -64201000 + (int32_t)aleatorio(35000);
+    uint16_t cosLat = cosenoQ15(lat / 1e6);
+    uint32_t esperado = 0;
+    float mejor = 0;
+    for (int i = 0; i < N; i++) {
+      if (!tramos[i].vivo) continue;
+      float d = GrafoCalles::distanciaM(tramos[i].t, lat, lon, cosLat);
+      if (d <= c.radioM && (esperado == 0 || d < mejor)) {
+        esperado = tramos[i].t.id;
+        mejor = d;
+      }
+    }
+    g.reiniciar();
+    g.emparejar(lat, lon, 0, 0);
+    if (esperado != 0) conTramo++;
+    TEST_ASSERT_EQUAL_UINT32(esperado, g.tramoActual());
+  }
+  TEST_ASSERT_TRUE(conTramo > 100);
+  TEST_ASSERT_EQUAL_UINT32(0, g.estadisticas().truncados);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_carga_y_compilacion);
+  RUN_TEST(test_cargas_mal_formadas_dejan_el_grafo_anterior);
+  RUN_TEST(test_recorrido_por_la_avenida);
+  RUN_TEST(test_el_rumbo_descarta_calles_cruzadas);
+  RUN_TEST(test_prefiere_el_tramo_conectado);
+  RUN_TEST(test_cambios_sobre_la_version_en_uso);
+  RUN_TEST(test_recorrido_desbordado);
+  RUN_TEST(test_la_grilla_coincide_con_la_fuerza_bruta);
+  return UNITY_END();
+}
@@ -0,0 +1,119 @@
+// ====== Tests de lib/HistogramaLatencia ======
+// Los bordes de las cubetas log2 (contiguas, sin huecos y de ancho menor a
+// la mitad del valor), la cuenta del percentil contra el valor exacto de
+// una muestra conocida, media, máximo, sumar() y el texto de describir().
+
+#include <unity.h>
+
+#include <string.h>
+
+#include <HistogramaLatencia.h>
+
+void setUp() {}
+void tearDown() {}
+
+void test_bordes_de_las_cubetas() {
+  const uint32_t valores[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 1000, 0x80000000, 0xFFFFFFFF};
+  const uint8_t cubetas[] = {0, 1, 2, 3, 4, 4, 5, 5, 6, 7, 19, 62, 63};
+  for (uint8_t i = 0; i < sizeof(valores) / sizeof(valores[0]); i++) {
+    TEST_ASSERT_EQUAL_UINT8(cubetas[i], HistogramaLatencia::cubetaDe(valores[i]));
+  }
+  TEST_ASSERT_EQUAL_UINT32(768, HistogramaLatencia::limiteInferior(19));
+  TEST_ASSERT_EQUAL_UINT32(1023, HistogramaLatencia::limiteSuperior(19));
+
+  // Contiguas desde 0 hasta 2^32 - 1, cada límite en su propia cubeta
+  TEST_ASSERT_EQUAL_UINT32(0, HistogramaLatencia::limiteInferior(0));
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, HistogramaLatencia::limiteSuperior(HISTOGRAMA_CUBETAS - 1));
+  for (uint8_t c = 0; c < HISTOGRAMA_CUBETAS; c++) {
+    uint32_t inferior = HistogramaLatencia::limiteInferior(c);
+    uint32_t superior = HistogramaLatencia::limiteSuperior(c);
+    TEST_ASSERT_EQUAL_UINT8(c, HistogramaLatencia::cubetaDe(inferior));
+    TEST_ASSERT_EQUAL_UINT8(c, HistogramaLatencia::cubetaDe(superior));
+    if (c + 1 < HISTOGRAMA_CUBETAS) {
+      TEST_ASSERT_EQUAL_UINT32(superior + 1, HistogramaLatencia::limiteInferior(c + 1));
+    }
+    // Ancho de la cubeta: como mucho la mitad de su límite inferior
+    if (c >= 2) TEST_ASSERT_TRUE(superior - inferior < inferior / 2);
+  }
+}
+
+void test_percentiles() {
+  HistogramaLatencia h;
+  TEST_ASSERT_EQUAL_UINT32(0, h.percentil(50));
+
+  for (uint32_t v = 1; v <= 100; v++) h.registrar(v);
+  // El 50 cae en la cubeta 48-63
+  TEST_ASSERT_EQUAL_UINT32(63, h.percentil(50));
+  TEST_ASSERT_EQUAL_UINT32(1, h.percentil(1));
+  // El 100 cae en 96-127, acotado por el máximo exacto
+  TEST_ASSERT_EQUAL_UINT32(100, h.percentil(100));
+  TEST_ASSERT_EQUAL_UINT32(100, h.percentil(200));
+
+  // Nunca por debajo del valor exacto y a menos del 50 % por encima
+  for (uint8_t p = 1; p <= 100; p++) {
+    uint32_t exacto = p;  // con 1..100 el percentil p es p
+    uint32_t estimado = h.percentil(p);
+    TEST_ASSERT_TRUE(estimado >= exacto);
+    TEST_ASSERT_TRUE(estimado < exacto + exacto / 2 + 1);
+  }
+
+  // Posición redondeada hacia arriba: el p90 de 10 muestras es la novena
+  HistogramaLatencia diez;
+  for (uint32_t i = 0; i < 9; i++) diez.registrar(10);
+  diez.registrar(5000);
+  TEST_ASSERT_EQUAL_UINT32(11, diez.percentil(90));
+  TEST_ASSERT_EQUAL_UINT32(5000, diez.percentil(91));
+  TEST_ASSERT_EQUAL_UINT32(5000, diez.percentil(99));
+}
+
+void test_media_maximo_y_sumar() {
+  HistogramaLatencia a, b;
+  a.registrar(10);
+  a.registrar(30);
+  b.registrar(4000000000u);
+  b.registrar(4000000000u);
+  TEST_ASSERT_EQUAL_UINT32(20, a.media());
+  // La suma de 64 bits no desborda
+  TEST_ASSERT_EQUAL_UINT32(4000000000u, b.media());
+
+  a.sumar(b);
+  TEST_ASSERT_EQUAL_UINT32(4, a.cantidad());
+  TEST_ASSERT_EQUAL_UINT32(4000000000u, a.maximo());
+  TEST_ASSERT_EQUAL_UINT32(2000000010u, a.media());
+  TEST_ASSERT_EQUAL_UINT32(2, a.cuenta(HistogramaLatencia::cubetaDe(4000000000u)));
+  TEST_ASSERT_EQUAL_UINT32(31, a.percentil(50));  // cubeta 24-31
+
+  a.reiniciar();
+  TEST_ASSERT_EQUAL_UINT32(0, a.cantidad());
+  TEST_ASSERT_EQUAL_UINT32(0, a.maximo());
+  TEST_ASSERT_EQUAL_UINT32(0, a.media());
+}
+
+void test_describir() {
+  HistogramaLatencia h;
+  h.registrar(0);
+  h.registrar(1500);
+  h.registrar(1500);
+  h.registrar(40000);
+  char texto[64];
+  TEST_ASSERT_EQUAL_UINT32(strlen("0:1,1024:2,32768:1"), h.describir(texto, sizeof(texto), 1));
+  TEST_ASSERT_EQUAL_STRING("0:1,1024:2,32768:1", texto);
+
+  // En miles (p. ej. ciclos a kciclos)
+  h.describir(texto, sizeof(texto), 1000);
+  TEST_ASSERT_EQUAL_STRING("0:1,1:2,32:1", texto);
+
+  // Si no entra, se corta en la última cubeta entera
+  char corto[12];
+  TEST_ASSERT_EQUAL_UINT32(strlen("0:1,1024:2"), h.describir(corto, sizeof(corto), 1));
+  TEST_ASSERT_EQUAL_STRING("0:1,1024:2", corto);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_bordes_de_las_cubetas);
+  RUN_TEST(test_percentiles);
+  RUN_TEST(test_media_maximo_y_sumar);
+  RUN_TEST(test_describir);
+  return UNITY_END();
+}
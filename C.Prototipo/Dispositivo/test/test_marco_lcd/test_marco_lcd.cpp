@@ -0,0 +1,189 @@
+// ====== Tests de lib/MarcoLCD ======
+// Contra un display de 20x4 simulado que guarda lo que muestra: el primer
+// volcado dibuja la pantalla, redibujar lo mismo no manda nada, un cambio
+// manda solo las celdas que difieren, invalidar() fuerza a redibujar todo,
+// el texto que no entra en la fila se recorta y el presupuesto de bytes
+// deja el resto para el volcado siguiente.
+
+#include <unity.h>
+
+#include <string.h>
+
+#include <MarcoLCD.h>
+
+// Como en el firmware: 6 escrituras I2C por comando con el PCF8574
+static const ConfigMarcoLCD CONFIG = {20, 4, 6, 6};
+
+class DisplaySimulado : public SalidaLCD {
+ public:
+  DisplaySimulado() { memset(celdas, ' ', sizeof(celdas)); }
+
+  void posicionar(uint8_t c, uint8_t f) override {
+    columna = c;
+    fila = f;
+    cursores++;
+  }
+  void escribir(uint8_t c) override {
+    if (columna < MARCO_MAX_COLUMNAS && fila < MARCO_MAX_FILAS) {
+      celdas[fila][columna] = (char)c;
+    } else {
+      fueraDePantalla++;
+    }
+    columna++;
+    caracteres++;
+  }
+
+  // La fila 'f' como texto
+  const char* fila_(uint8_t f) {
+    memcpy(texto, celdas[f], MARCO_MAX_COLUMNAS);
+    texto[MARCO_MAX_COLUMNAS] = '\0';
+    return texto;
+  }
+  void contarDesdeCero() { cursores = caracteres = 0; }
+
+  char celdas[MARCO_MAX_FILAS][MARCO_MAX_COLUMNAS];
+  uint8_t columna = 0;
+  uint8_t fila = 0;
+  uint32_t cursores = 0;
+  uint32_t caracteres = 0;
+  uint32_t fueraDePantalla = 0;
+
+ private:
+  char texto[MARCO_MAX_COLUMNAS + 1];
+};
+
+// Una pantalla de mapeo como la del firmware
+static void dibujar(MarcoLCD& m, long puntos, double velocidad) {
+  m.limpiar();
+  m.cursor(0, 0);
+  m.escribir("MAPEANDO CALLE_3");
+  m.cursor(0, 1);
+  m.escribir("Puntos: ");
+  m.escribirEntero(puntos);
+  m.cursor(0, 2);
+  m.escribir("Vel: ");
+  m.escribirDecimal(velocidad, 1);
+  m.escribir(" km/h");
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_sin_cambios_no_manda_nada() {
+  MarcoLCD m(CONFIG);
+  DisplaySimulado d;
+  dibujar(m, 12, 35.5);
+  TEST_ASSERT_TRUE(m.volcar(d, 0) > 0);
+  TEST_ASSERT_EQUAL_STRING("MAPEANDO CALLE_3    ", d.fila_(0));
+  TEST_ASSERT_EQUAL_STRING("Puntos: 12          ", d.fila_(1));
+  TEST_ASSERT_EQUAL_STRING("Vel: 35.5 km/h      ", d.fila_(2));
+  TEST_ASSERT_FALSE(m.pendiente());
+
+  // El mismo cuadro otra vez: limpiar() + dibujo no ensucian nada
+  d.contarDesdeCero();
+  dibujar(m, 12, 35.5);
+  TEST_ASSERT_FALSE(m.pendiente());
+  TEST_ASSERT_EQUAL_UINT16(0, m.volcar(d, 0));
+  TEST_ASSERT_EQUAL_UINT32(0, d.caracteres + d.cursores);
+  TEST_ASSERT_EQUAL_UINT32(1, m.estadisticas().volcadosVacios);
+}
+
+void test_solo_las_celdas_cambiadas() {
+  MarcoLCD m(CONFIG);
+  DisplaySimulado d;
+  dibujar(m, 12, 35.5);
+  m.volcar(d, 0);
+  m.reiniciarEstadisticas();
+
+  // 12 -> 13: un cursor y un caracter
+  d.contarDesdeCero();
+  dibujar(m, 13, 35.5);
+  TEST_ASSERT_EQUAL_UINT16(CONFIG.bytesPorCursor + CONFIG.bytesPorCaracter, m.volcar(d, 0));
+  TEST_ASSERT_EQUAL_UINT32(1, d.cursores);
+  TEST_ASSERT_EQUAL_UINT32(1, d.caracteres);
+  TEST_ASSERT_EQUAL_STRING("Puntos: 13          ", d.fila_(1));
+
+  // 35.5 -> 38.9: el '.' igual del medio se reescribe antes que volver a posicionar
+  d.contarDesdeCero();
+  dibujar(m, 13, 38.9);
+  m.volcar(d, 0);
+  TEST_ASSERT_EQUAL_UINT32(1, d.cursores);
+  TEST_ASSERT_EQUAL_UINT32(3, d.caracteres);
+  TEST_ASSERT_EQUAL_STRING("Vel: 38.9 km/h      ", d.fila_(2));
+
+  // 13 -> 9: el número se acorta y el diff borra lo que sobra
+  d.contarDesdeCero();
+  dibujar(m, 9, 38.9);
+  m.volcar(d, 0);
+  TEST_ASSERT_EQUAL_UINT32(2, d.caracteres);
+  TEST_ASSERT_EQUAL_STRING("Puntos: 9           ", d.fila_(1));
+
+  // Dibujar directo habría costado mucho más que lo enviado
+  const EstadisticasMarcoLCD& est = m.estadisticas();
+  TEST_ASSERT_TRUE(est.bytesSinMarco > 10 * est.bytes);
+  TEST_ASSERT_EQUAL_UINT32(0, d.fueraDePantalla);
+}
+
+void test_invalidar_redibuja_todo() {
+  MarcoLCD m(CONFIG);
+  DisplaySimulado d;
+  dibujar(m, 12, 35.5);
+  m.volcar(d, 0);
+
+  // El display se reinició y quedó con basura
+  memset(d.celdas, '#', sizeof(d.celdas));
+  d.contarDesdeCero();
+  m.invalidar();
+  TEST_ASSERT_TRUE(m.pendiente());
+  m.volcar(d, 0);
+  TEST_ASSERT_EQUAL_UINT32(CONFIG.columnas * CONFIG.filas, d.caracteres);
+  // Una posición por fila: al final de cada una el cursor del HD44780 no sigue en la próxima
+  TEST_ASSERT_EQUAL_UINT32(CONFIG.filas, d.cursores);
+  TEST_ASSERT_FALSE(m.pendiente());
+  TEST_ASSERT_EQUAL_STRING("MAPEANDO CALLE_3    ", d.fila_(0));
+  TEST_ASSERT_EQUAL_STRING("                    ", d.fila_(3));
+}
+
+void test_recorta_el_texto_que_no_entra() {
+  MarcoLCD m(CONFIG);
+  DisplaySimulado d;
+  m.cursor(15, 0);
+  m.escribir("Texto demasiado largo");
+  m.cursor(0, 4);
+  m.escribir("Fila que no existe");
+  m.cursor(25, 1);
+  m.escribir('x');
+  m.volcar(d, 0);
+  TEST_ASSERT_EQUAL_STRING("               Texto", d.fila_(0));
+  // No sigue en la fila de abajo
+  TEST_ASSERT_EQUAL_STRING("                    ", d.fila_(1));
+  TEST_ASSERT_EQUAL_UINT32(5, d.caracteres);
+  TEST_ASSERT_EQUAL_UINT32(0, d.fueraDePantalla);
+}
+
+void test_presupuesto_deja_el_resto_para_despues() {
+  MarcoLCD m(CONFIG);
+  DisplaySimulado d;
+  dibujar(m, 12, 35.5);
+  // 24 bytes por paso como en el firmware: un cursor y tres caracteres
+  uint8_t pasos = 0;
+  while (m.pendiente()) {
+    TEST_ASSERT_TRUE(m.volcar(d, 24) <= 24);
+    pasos++;
+    TEST_ASSERT_TRUE(pasos < 100);
+  }
+  TEST_ASSERT_TRUE(pasos > 5);
+  TEST_ASSERT_EQUAL_STRING("MAPEANDO CALLE_3    ", d.fila_(0));
+  TEST_ASSERT_EQUAL_STRING("Puntos: 12          ", d.fila_(1));
+  TEST_ASSERT_EQUAL_STRING("Vel: 35.5 km/h      ", d.fila_(2));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sin_cambios_no_manda_nada);
+  RUN_TEST(test_solo_las_celdas_cambiadas);
+  RUN_TEST(test_invalidar_redibuja_todo);
+  RUN_TEST(test_recorta_el_texto_que_no_entra);
+  RUN_TEST(test_presupuesto_deja_el_resto_para_despues);
+  return UNITY_END();
+}
@@ -0,0 +1,58 @@
+// ====== Tests de lib/MensajesJSON ======
+// Los campos y su orden son el contrato con el backend: se compara el
+// mensaje completo. Las coordenadas son exactas en binario para que el
+// texto no dependa del redondeo de ArduinoJson.
+
+#include <unity.h>
+
+#include <MensajesJSON.h>
+
+#include <string.h>
+
+static const PuntoGPS PUNTO = {-31.5, -64.25, 90.0, 42.5, 9, 13452199};
+
+void setUp() {}
+void tearDown() {}
+
+void test_punto() {
+  ContextoMensaje c = {"camion-01", 123456, 7, -1};
+  char buffer[256];
+  size_t largo = codificarPuntoJSON(PUNTO, "calle_3", c, buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"id\":\"calle_3\",\"tipo\":\"punto\",\"lat\":-31.5,\"lon\":-64.25,\"velocidad\":42.5,"
+      "\"satelites\":9,\"tiempo\":13452199,\"rumbo\":90,\"device_id\":\"camion-01\","
+      "\"precision_baja\":false,\"timestamp\":123456,\"seq\":7}",
+      buffer);
+  TEST_ASSERT_EQUAL_size_t(strlen(buffer), largo);
+}
+
+void test_ubicacion() {
+  ContextoMensaje c = {"camion-01", 123456, 8, -1};
+  char buffer[256];
+  codificarUbicacionJSON(PUNTO, c, buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"device_id\":\"camion-01\",\"latitud\":-31.5,\"longitud\":-64.25,\"satelites\":9,"
+      "\"velocidad_kmh\":42.5,\"rumbo\":90,\"tiempo\":13452199,\"precision_baja\":false,\"timestamp\":123456,\"seq\":8}",
+      buffer);
+}
+
+void test_latencia_y_precision_baja() {
+  PuntoGPS p = PUNTO;
+  p.satelites = 3;
+  ContextoMensaje c = {"camion-01", 123456, 9, 35};
+  char buffer[256];
+  codificarUbicacionJSON(p, c, buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"device_id\":\"camion-01\",\"latitud\":-31.5,\"longitud\":-64.25,\"satelites\":3,"
+      "\"velocidad_kmh\":42.5,\"rumbo\":90,\"tiempo\":13452199,\"precision_baja\":true,\"timestamp\":123456,\"seq\":9,"
+      "\"latencia_ms\":35}",
+      buffer);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_punto);
+  RUN_TEST(test_ubicacion);
+  RUN_TEST(test_latencia_y_precision_baja);
+  return UNITY_END();
+}
@@ -0,0 +1,100 @@
+// ====== Tests de lib/ParametrosRemotos ======
+// El lector del comando (todo o nada, rangos, "id"), la combinación de un
+// comando leído aparte y la persistencia con el hash del nombre.
+
+#include <unity.h>
+
+#include <ParametrosRemotos.h>
+
+#include <string.h>
+
+static const DefinicionParametro TABLA[] = {
+  {"intervalo_ubicacion_ms", 500, 60000, 5000},
+  {"ventana_mqtt", 1, 8, 4},
+};
+
+static ParametrosRemotos parametros(TABLA, 2);
+static uint32_t id;
+static int8_t parametroError;
+
+static ResultadoComando recibir(const char* comando) {
+  return parametros.recibir(comando, strlen(comando), id, parametroError);
+}
+
+void setUp() {
+  parametros.restablecer();
+}
+void tearDown() {}
+
+void test_aplica_entre_pasadas() {
+  TEST_ASSERT_EQUAL_UINT8(COMANDO_ACEPTADO, recibir("{\"id\": 17, \"ventana_mqtt\": 2}"));
+  TEST_ASSERT_EQUAL_UINT32(17, id);
+  TEST_ASSERT_EQUAL_UINT32(4, parametros.valor(1));
+  TEST_ASSERT_TRUE(parametros.hayPendientes());
+  TEST_ASSERT_EQUAL_UINT32(1UL << 1, parametros.aplicarPendientes());
+  TEST_ASSERT_EQUAL_UINT32(2, parametros.valor(1));
+  TEST_ASSERT_EQUAL_UINT32(0, parametros.aplicarPendientes());
+}
+
+void test_todo_o_nada() {
+  TEST_ASSERT_EQUAL_UINT8(COMANDO_FUERA_DE_RANGO, recibir("{\"ventana_mqtt\": 2, \"intervalo_ubicacion_ms\": 100}"));
+  TEST_ASSERT_EQUAL_INT(0, parametroError);
+  TEST_ASSERT_EQUAL_UINT8(COMANDO_DESCONOCIDO, recibir("{\"ventana_mqtt\": 2, \"otro\": 1}"));
+  TEST_ASSERT_FALSE(parametros.hayPendientes());
+  TEST_ASSERT_EQUAL_UINT32(4, parametros.valor(1));
+}
+
+void test_rechaza_lo_que_no_es_entero() {
+  TEST_ASSERT_EQUAL_UINT8(COMANDO_MAL_FORMADO, recibir("{\"ventana_mqtt\": 2.5}"));
+  TEST_ASSERT_EQUAL_UINT8(COMANDO_MAL_FORMADO, recibir("{\"ventana_mqtt\": 1e3}"));
+  TEST_ASSERT_EQUAL_UINT8(COMANDO_MAL_FORMADO, recibir("{\"ventana_mqtt\": -1}"));
+  TEST_ASSERT_EQUAL_UINT8(COMANDO_MAL_FORMADO, recibir("{\"ventana_mqtt\": 2"));
+  TEST_ASSERT_EQUAL_UINT8(COMANDO_FUERA_DE_RANGO, recibir("{\"ventana_mqtt\": 99999999999}"));
+  TEST_ASSERT_EQUAL_UINT8(COMANDO_VACIO, recibir("{\"id\": 3}"));
+}
+
+void test_combina_comando_leido_aparte() {
+  TEST_ASSERT_EQUAL_UINT8(COMANDO_ACEPTADO, recibir("{\"ventana_mqtt\": 2}"));
+  ParametrosRemotos comando(TABLA, 2);
+  const char* texto = "{\"id\": 9, \"intervalo_ubicacion_ms\": 1000}";
+  TEST_ASSERT_EQUAL_UINT8(COMANDO_ACEPTADO, comando.recibir(texto, strlen(texto), id, parametroError));
+  TEST_ASSERT_EQUAL_UINT32(5000, parametros.valor(0));
+
+  parametros.combinar(comando);
+  TEST_ASSERT_EQUAL_UINT32((1UL << 0) | (1UL << 1), parametros.aplicarPendientes());
+  TEST_ASSERT_EQUAL_UINT32(1000, parametros.valor(0));
+  TEST_ASSERT_EQUAL_UINT32(2, parametros.valor(1));
+}
+
+void test_persistencia_ida_y_vuelta() {
+  recibir("{\"intervalo_ubicacion_ms\": 1000}");
+  parametros.aplicarPendientes();
+  uint8_t datos[PARAMETROS_TAMANO_SERIALIZADO];
+  size_t largo = parametros.serializar(datos, sizeof(datos));
+  TEST_ASSERT_TRUE(largo > 0);
+
+  // Una versión con un parámetro más antes del guardado no corre los valores
+  static const DefinicionParametro TABLA_NUEVA[] = {
+    {"banda_error_m", 5, 500, 25},
+    {"intervalo_ubicacion_ms", 500, 60000, 5000},
+    {"ventana_mqtt", 1, 8, 4},
+  };
+  ParametrosRemotos nuevos(TABLA_NUEVA, 3);
+  TEST_ASSERT_TRUE(nuevos.restaurar(datos, largo));
+  TEST_ASSERT_EQUAL_UINT32(25, nuevos.valor(0));
+  TEST_ASSERT_EQUAL_UINT32(1000, nuevos.valor(1));
+  TEST_ASSERT_EQUAL_UINT32(1UL << 1, nuevos.modificados());
+
+  datos[5] ^= 0x01;
+  TEST_ASSERT_FALSE(parametros.restaurar(datos, largo));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_aplica_entre_pasadas);
+  RUN_TEST(test_todo_o_nada);
+  RUN_TEST(test_rechaza_lo_que_no_es_entero);
+  RUN_TEST(test_combina_comando_leido_aparte);
+  RUN_TEST(test_persistencia_ida_y_vuelta);
+  return UNITY_END();
+}
@@ -0,0 +1,150 @@
+// ====== Tests de lib/Planificador ======
+// Con el reloj manual de lib/Plataforma: los plazos se cumplen en orden, una
+// tarea dormida solo vuelve con despertar(), el exceso de presupuesto se
+// cuenta aunque el paso no pueda interrumpirse y un retardo más allá del
+// horizonte del reloj se recorta en lugar de dar la vuelta.
+
+#include <unity.h>
+
+#include <Planificador.h>
+#include <Plataforma.h>
+
+static char orden[32];
+static uint8_t largoOrden = 0;
+
+static void anotar(char c) {
+  if (largoOrden < sizeof(orden) - 1) orden[largoOrden++] = c;
+  orden[largoOrden] = '\0';
+}
+
+static uint32_t tareaA(uint32_t) {
+  anotar('a');
+  return 100;
+}
+
+static uint32_t tareaB(uint32_t) {
+  anotar('b');
+  return 250;
+}
+
+static uint32_t tareaDormilona(uint32_t) {
+  anotar('d');
+  return TAREA_DETENIDA;
+}
+
+static uint32_t tareaLenta(uint32_t) {
+  avanzarReloj(5);
+  return 1000;
+}
+
+static uint32_t tareaHoraria(uint32_t) {
+  anotar('h');
+  return 3600000;
+}
+
+static uint32_t prioritarias = 0;
+static uint32_t tareaPrioritaria(uint32_t) {
+  prioritarias++;
+  return 0;
+}
+
+void setUp() {
+  fijarRelojManual(1000);
+  largoOrden = 0;
+  orden[0] = '\0';
+  prioritarias = 0;
+}
+void tearDown() {
+  usarRelojReal();
+}
+
+// Avanza de a 50 ms ejecutando una pasada en cada paso
+static void correrDurante(Planificador& p, uint32_t ms) {
+  for (uint32_t t = 0; t < ms; t += 50) {
+    p.ejecutar();
+    avanzarReloj(50);
+  }
+}
+
+void test_respeta_los_periodos() {
+  Planificador p(relojMs, relojUs);
+  p.agregar("a", tareaA, 0, 0);
+  p.agregar("b", tareaB, 0, 0);
+  correrDurante(p, 500);
+  TEST_ASSERT_EQUAL_UINT32(5, p.tarea(0).ejecuciones);
+  TEST_ASSERT_EQUAL_UINT32(2, p.tarea(1).ejecuciones);
+  TEST_ASSERT_EQUAL_STRING("abaabaa", orden);
+}
+
+void test_retardo_inicial() {
+  Planificador p(relojMs, relojUs);
+  p.agregar("a", tareaA, 300, 0);
+  correrDurante(p, 250);
+  TEST_ASSERT_EQUAL_UINT32(0, p.tarea(0).ejecuciones);
+  correrDurante(p, 100);
+  TEST_ASSERT_EQUAL_UINT32(1, p.tarea(0).ejecuciones);
+}
+
+void test_dormida_hasta_despertar() {
+  Planificador p(relojMs, relojUs);
+  int id = p.agregar("d", tareaDormilona, 0, 0);
+  correrDurante(p, 1000);
+  TEST_ASSERT_EQUAL_UINT32(1, p.tarea(id).ejecuciones);
+  p.despertar(id);
+  p.ejecutar();
+  TEST_ASSERT_EQUAL_UINT32(2, p.tarea(id).ejecuciones);
+  TEST_ASSERT_EQUAL_STRING("dd", orden);
+}
+
+void test_cuenta_excesos_de_presupuesto() {
+  Planificador p(relojMs, relojUs);
+  p.agregar("lenta", tareaLenta, 0, 2000);
+  p.ejecutar();
+  TEST_ASSERT_EQUAL_UINT32(1, p.tarea(0).excesos);
+  TEST_ASSERT_EQUAL_UINT32(5000, p.tarea(0).peorUs);
+}
+
+void test_prioritaria_entre_tareas() {
+  Planificador p(relojMs, relojUs);
+  p.fijarPrioritaria(tareaPrioritaria, 0);
+  p.agregar("a", tareaA, 0, 0);
+  p.agregar("b", tareaB, 0, 0);
+  p.ejecutar();
+  TEST_ASSERT_EQUAL_UINT32(2, prioritarias);
+  TEST_ASSERT_EQUAL_UINT32(2, p.prioritaria().ejecuciones);
+}
+
+void test_retardo_mas_alla_del_horizonte() {
+  Planificador p(relojMs, relojUs);
+  p.agregar("h", tareaHoraria, 0, 0);
+  p.ejecutar();
+  // 1 h en us no entra en la comparación con signo: sin recorte la tarea
+  // quedaría vencida y correría en cada pasada
+  correrDurante(p, 1000);
+  TEST_ASSERT_EQUAL_UINT32(1, p.tarea(0).ejecuciones);
+  avanzarReloj(PLANIFICADOR_RETARDO_MAXIMO_MS - 2000);
+  p.ejecutar();
+  TEST_ASSERT_EQUAL_UINT32(1, p.tarea(0).ejecuciones);
+  avanzarReloj(2000);
+  p.ejecutar();
+  TEST_ASSERT_EQUAL_UINT32(2, p.tarea(0).ejecuciones);
+}
+
+void test_retardo_inicial_mas_alla_del_horizonte() {
+  Planificador p(relojMs, relojUs);
+  p.agregar("h", tareaHoraria, 3600000, 0);
+  correrDurante(p, 1000);
+  TEST_ASSERT_EQUAL_UINT32(0, p.tarea(0).ejecuciones);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_respeta_los_periodos);
+  RUN_TEST(test_retardo_inicial);
+  RUN_TEST(test_dormida_hasta_despertar);
+  RUN_TEST(test_cuenta_excesos_de_presupuesto);
+  RUN_TEST(test_prioritaria_entre_tareas);
+  RUN_TEST(test_retardo_mas_alla_del_horizonte);
+  RUN_TEST(test_retardo_inicial_mas_alla_del_horizonte);
+  return UNITY_END();
+}
@@ -0,0 +1,145 @@
+// ====== Tests de lib/ProcesadorGPS ======
+// La cadena completa del mapeo con la configuración del firmware: un
+// recorrido en L sintético tiene que dar una calle, un giro confirmado y la
+// distancia recorrida; un salto no tiene que llegar a la distancia, y el
+// ruido del fix con el camión detenido tampoco.
+
+#include <unity.h>
+
+#include <ProcesadorGPS.h>
+
+#include <math.h>
+
+static const ConfigVentanaGPS CONFIG_VENTANA = {150.0f, 25.0f, 5};
+static const ConfigKalman CONFIG_KALMAN = {1.0f, 4.0f, 0.5f, 25.0f, 10000, 2000.0f};
+static const ConfigSimplificador CONFIG_SIMPLIFICADOR = {3.0f, SIMPLIFICADOR_MAX_VENTANA, 120000};
+
+static const double METROS_POR_GRADO = 111194.93;
+static const double LAT0 = -31.42;
+static const double LON0 = -64.18;
+
+class Registro : public EventosProcesadorGPS {
+ public:
+  Registro() : confirmados(0), posibles(0), inicios(0), vertices(0) {}
+  void giro(EventoGiro evento, float) override {
+    if (evento == GIRO_CONFIRMADO) confirmados++;
+    if (evento == GIRO_POSIBLE) posibles++;
+  }
+  void inicioCalle(const VerticeTrayecto&) override { inicios++; }
+  void vertice(const VerticeTrayecto&) override { vertices++; }
+
+  int confirmados;
+  int posibles;
+  int inicios;
+  int vertices;
+};
+
+// Las piezas como globales, igual que en el firmware
+static VentanaGPSFija<30> ventana(CONFIG_VENTANA);
+static FiltroKalman filtro(CONFIG_KALMAN);
+static DetectorGiros detector(DETECTOR_GIROS_CURVATURA);
+static SimplificadorTrayecto simplificador(CONFIG_SIMPLIFICADOR);
+static Registro registro;
+static ProcesadorGPS procesador(ventana, filtro, detector, simplificador, registro);
+
+void setUp() {
+  ventana.vaciar();
+  simplificador.reiniciar();
+  procesador.reiniciar();
+  registro = Registro();
+}
+void tearDown() {}
+
+// 'norte' y 'este' en metros desde el origen
+static MuestraGPS muestra(double norte, double este, float rumbo, float velocidad, uint32_t tiempoMs) {
+  double lat = LAT0 + norte / METROS_POR_GRADO;
+  double lon = LON0 + este / (METROS_POR_GRADO * cos(LAT0 * M_PI / 180.0));
+  MuestraGPS m = {lat, lon, rumbo, velocidad, 9, tiempoMs / 10, tiempoMs};
+  return m;
+}
+
+// Un fix por segundo a 5 m/s: 300 m al norte, esquina de 20 m de radio y
+// 200 m al este
+static const double TRAMO_NORTE = 300.0;
+static const double RADIO_ESQUINA = 20.0;
+static const double LARGO_ESQUINA = RADIO_ESQUINA * M_PI / 2;
+static const double LARGO_TOTAL = TRAMO_NORTE + LARGO_ESQUINA + 200.0;
+
+static MuestraGPS muestraEnL(double s, uint32_t tiempoMs) {
+  if (s <= TRAMO_NORTE) return muestra(s, 0, 0, 18, tiempoMs);
+  if (s <= TRAMO_NORTE + LARGO_ESQUINA) {
+    double a = (s - TRAMO_NORTE) / RADIO_ESQUINA;
+    return muestra(TRAMO_NORTE + RADIO_ESQUINA * sin(a), RADIO_ESQUINA * (1 - cos(a)), (float)(a * 180 / M_PI), 18,
+                   tiempoMs);
+  }
+  return muestra(TRAMO_NORTE + RADIO_ESQUINA, RADIO_ESQUINA + s - TRAMO_NORTE - LARGO_ESQUINA, 90, 18, tiempoMs);
+}
+
+static void recorrerEnL() {
+  uint32_t t = 1000;
+  for (double s = 0; s <= LARGO_TOTAL; s += 5.0, t += 1000) {
+    if (procesador.agregarFix(muestraEnL(s, t), 1.0f) != FIX_SALTO) procesador.procesar(t);
+  }
+}
+
+void test_recorrido_en_l_confirma_un_giro() {
+  recorrerEnL();
+  TEST_ASSERT_EQUAL_INT(1, registro.confirmados);
+  TEST_ASSERT_TRUE(registro.posibles >= 1);
+  TEST_ASSERT_EQUAL_INT(1, registro.inicios);
+}
+
+void test_distancia_recorrida() {
+  recorrerEnL();
+  // 1 %: las cuerdas de la esquina y la distancia en microgrados
+  TEST_ASSERT_UINT32_WITHIN((uint32_t)LARGO_TOTAL, (uint32_t)(LARGO_TOTAL * 100), procesador.distanciaCm());
+}
+
+void test_salto_no_suma_distancia() {
+  procesador.agregarFix(muestra(0, 0, 0, 36, 1000), 1.0f);
+  procesador.agregarFix(muestra(10, 0, 0, 36, 2000), 1.0f);
+  uint32_t antes = procesador.distanciaCm();
+  TEST_ASSERT_EQUAL_UINT8(FIX_SALTO, procesador.agregarFix(muestra(5000, 0, 0, 36, 3000), 1.0f));
+  TEST_ASSERT_EQUAL_UINT32(antes, procesador.distanciaCm());
+}
+
+void test_detenido_no_suma_distancia() {
+  procesador.agregarFix(muestra(0, 0, 0, 18, 1000), 1.0f);
+  // Dos minutos parado con el fix bailando hasta 4 m alrededor del punto
+  for (uint32_t i = 0; i < 120; i++) {
+    double norte = 4.0 * sin(i * 1.7);
+    double este = 4.0 * cos(i * 2.3);
+    procesador.agregarFix(muestra(norte, este, (float)(i * 37 % 360), 0.8f, 2000 + i * 1000), 1.0f);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, procesador.distanciaCm());
+
+  // Al arrancar cuenta desde donde quedó
+  procesador.agregarFix(muestra(20, 0, 0, 18, 123000), 1.0f);
+  TEST_ASSERT_UINT32_WITHIN(20, 2000, procesador.distanciaCm());
+}
+
+void test_punto_promedio_de_la_ventana() {
+  procesador.agregarFix(muestra(0, 0, 0, 30, 1000), 1.0f);
+  procesador.agregarFix(muestra(10, 0, 0, 40, 2000), 1.0f);
+  PuntoGPS p = procesador.puntoPromedio();
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, LAT0 + 5 / METROS_POR_GRADO, p.lat);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 35.0, p.velocidad);
+  TEST_ASSERT_EQUAL_INT(9, p.satelites);
+}
+
+void test_reiniciar_pone_la_distancia_en_cero() {
+  recorrerEnL();
+  procesador.reiniciar();
+  TEST_ASSERT_EQUAL_UINT32(0, procesador.distanciaCm());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_recorrido_en_l_confirma_un_giro);
+  RUN_TEST(test_distancia_recorrida);
+  RUN_TEST(test_salto_no_suma_distancia);
+  RUN_TEST(test_detenido_no_suma_distancia);
+  RUN_TEST(test_punto_promedio_de_la_ventana);
+  RUN_TEST(test_reiniciar_pone_la_distancia_en_cero);
+  return UNITY_END();
+}
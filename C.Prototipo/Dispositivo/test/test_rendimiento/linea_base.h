@@ -0,0 +1,33 @@
+#pragma once
+
+// ====== Línea base de test_rendimiento ======
+// Medida con "pio test -e native -f test_rendimiento -v" en la PC de
+// desarrollo (x86-64, gcc, -Og del build de tests). Los tiempos solo sirven
+// comparados en la misma máquina; las asignaciones valen en cualquiera.
+//
+// Los mensajes JSON tienen el tiempo en 0 (solo se controla que no usen el
+// heap) hasta medirlos con la ArduinoJson del env native, y lo mismo el
+// punto a la bandeja; para actualizar la tabla se copia la que imprime el
+// test al final.
+
+struct LineaBase {
+  const char* nombre;
+  float nsPorOp;
+  float asignacionesPorOp;
+};
+
+static const LineaBase LINEA_BASE[] = {
+  {"procesarDatosGPS", 730.5f, 0.00f},
+  {"obtenerPuntoPromedio", 38.7f, 0.00f},
+  {"puntoFiltrado", 53.0f, 0.00f},
+  {"distanciaHaversine", 73.6f, 0.00f},
+  {"distanciaHaversineF", 40.0f, 0.00f},
+  {"distanciaEquirectangular", 8.6f, 0.00f},
+  {"distanciaMicrogradosCm", 54.8f, 0.00f},
+  {"codificarPuntoJSON", 0.0f, 0.00f},
+  {"codificarUbicacionJSON", 0.0f, 0.00f},
+  {"codificarPunto", 55.1f, 0.00f},
+  {"codificarLote30", 456.5f, 0.00f},
+  {"puntoABandejaCopiando", 0.0f, 0.00f},
+  {"puntoABandejaEnSuLugar", 0.0f, 0.00f},
+};
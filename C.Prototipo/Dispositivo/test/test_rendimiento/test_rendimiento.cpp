@@ -0,0 +1,450 @@
+// ====== Benchmarks de la cadena del firmware ======
+// ns por operación y asignaciones del heap por operación de lo que corre en
+// cada fix o en cada período de publicación, contra linea_base.h:
+//
+//   pio test -e native -f test_rendimiento -v
+//
+// - Las asignaciones se cuentan con lib/RastreoHeap (el env native envuelve
+//   malloc con -Wl,--wrap; new se redirige a malloc acá abajo). Son
+//   deterministas: pasar de la línea base hace fallar el test.
+// - Los tiempos dependen de la máquina: más de TOLERANCIA_TIEMPO veces la
+//   línea base se marca con ⚠ y solo falla con -DRENDIMIENTO_ESTRICTO=1
+//   (para una máquina de CI fija). Cada medición es la mejor de RONDAS.
+// - Al final se imprime la tabla con los valores medidos, lista para
+//   reemplazar linea_base.h cuando un cambio de rendimiento es intencional.
+// - test_error_distancias imprime el error máximo de cada variante de
+//   lib/Geodesia contra el haversine en double, junto a sus ns/op.
+// - test_bytes_por_punto compara el tamaño de un punto en cada formato
+//   (JSON, trama binaria, lote binario y lote en polyline); no depende de la
+//   máquina.
+//
+// Los nombres entre paréntesis son las funciones del main.cpp original.
+
+#include <unity.h>
+
+#include <BandejaMQTT.h>
+#include <Geodesia.h>
+#include <LoteTrayecto.h>
+#include <MensajesJSON.h>
+#include <ProcesadorGPS.h>
+#include <RastreoHeap.h>
+#include <TramaBinaria.h>
+
+#include <math.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "linea_base.h"
+
+#ifndef RENDIMIENTO_ESTRICTO
+#define RENDIMIENTO_ESTRICTO 0
+#endif
+
+static const float TOLERANCIA_TIEMPO = 1.5f;
+static const int RONDAS = 5;
+
+// ====== new -> malloc, para que RastreoHeap también lo vea ======
+void* operator new(size_t tamano) {
+  void* p = malloc(tamano ? tamano : 1);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t tamano) {
+  return operator new(tamano);
+}
+void operator delete(void* p) noexcept {
+  free(p);
+}
+void operator delete[](void* p) noexcept {
+  free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+void operator delete[](void* p, size_t) noexcept {
+  free(p);
+}
+
+// ====== Recorrido sintético ======
+// Una manzana de 360 m de lado con esquinas de 20 m de radio, un fix por
+// segundo a 5 m/s; se repite sin saltos porque el tiempo sigue avanzando
+static const int PASOS_RECTA = 72;
+static const int PASOS_ESQUINA = 6;
+static const int FIXES_VUELTA = 4 * (PASOS_RECTA + PASOS_ESQUINA);
+static const double METROS_POR_GRADO = 111194.93;
+static MuestraGPS vuelta[FIXES_VUELTA];
+
+static void armarVuelta() {
+  double norte = 0, este = 0, rumbo = 0;
+  double cosLat = cos(-31.42 * M_PI / 180.0);
+  int i = 0;
+  for (int lado = 0; lado < 4; lado++) {
+    for (int paso = 0; paso < PASOS_RECTA + PASOS_ESQUINA; paso++, i++) {
+      if (paso >= PASOS_RECTA) rumbo += 90.0 / PASOS_ESQUINA;
+      norte += 5.0 * cos(rumbo * M_PI / 180.0);
+      este += 5.0 * sin(rumbo * M_PI / 180.0);
+      MuestraGPS m = {-31.42 + norte / METROS_POR_GRADO, -64.18 + este / (METROS_POR_GRADO * cosLat),
+                      (float)fmod(rumbo, 360.0), 18.0f, 9, 0, 0};
+      vuelta[i] = m;
+    }
+  }
+}
+
+static MuestraGPS fix(uint32_t n) {
+  MuestraGPS m = vuelta[n % FIXES_VUELTA];
+  m.tiempoMs = 1000 + n * 1000;
+  m.tiempoGps = m.tiempoMs / 10;
+  return m;
+}
+
+// ====== Cadena del mapeo, como en el firmware ======
+class SinEventos : public EventosProcesadorGPS {
+ public:
+  void giro(EventoGiro, float) override {}
+  void inicioCalle(const VerticeTrayecto&) override {}
+  void vertice(const VerticeTrayecto&) override {}
+};
+
+static const ConfigVentanaGPS CONFIG_VENTANA = {150.0f, 25.0f, 5};
+static const ConfigKalman CONFIG_KALMAN = {1.0f, 4.0f, 0.5f, 25.0f, 10000, 2000.0f};
+static const ConfigSimplificador CONFIG_SIMPLIFICADOR = {3.0f, SIMPLIFICADOR_MAX_VENTANA, 120000};
+static VentanaGPSFija<30> ventana(CONFIG_VENTANA);
+static FiltroKalman filtro(CONFIG_KALMAN);
+static DetectorGiros detector(DETECTOR_GIROS_CURVATURA);
+static SimplificadorTrayecto simplificador(CONFIG_SIMPLIFICADOR);
+static SinEventos sinEventos;
+static ProcesadorGPS procesador(ventana, filtro, detector, simplificador, sinEventos);
+static uint32_t fixesProcesados = 0;
+
+// Evita que el compilador descarte lo medido
+static volatile double sumidero = 0;
+
+// ====== Medición ======
+static uint64_t ahoraNs() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+struct Medicion {
+  const char* nombre;
+  double nsPorOp;
+  double asignacionesPorOp;
+};
+
+static Medicion medidas[24];
+static int cantidadMedidas = 0;
+
+template <typename F>
+static void medir(const char* nombre, uint32_t iteraciones, F operacion) {
+  for (uint32_t i = 0; i < iteraciones / 10; i++) operacion(i);
+
+  double mejorNs = 1e30;
+  double asignaciones = 0;
+  for (int r = 0; r < RONDAS; r++) {
+    uint32_t antes = contadorAsignaciones();
+    uint64_t inicio = ahoraNs();
+    for (uint32_t i = 0; i < iteraciones; i++) operacion(i);
+    double ns = (double)(ahoraNs() - inicio) / iteraciones;
+    double a = (double)(contadorAsignaciones() - antes) / iteraciones;
+    if (ns < mejorNs) mejorNs = ns;
+    if (a > asignaciones) asignaciones = a;
+  }
+
+  Medicion m = {nombre, mejorNs, asignaciones};
+  if (cantidadMedidas < (int)(sizeof(medidas) / sizeof(medidas[0]))) medidas[cantidadMedidas++] = m;
+
+  const LineaBase* base = nullptr;
+  for (size_t i = 0; i < sizeof(LINEA_BASE) / sizeof(LINEA_BASE[0]); i++) {
+    if (strcmp(LINEA_BASE[i].nombre, nombre) == 0) base = &LINEA_BASE[i];
+  }
+  if (base == nullptr) {
+    printf("%-24s %10.1f ns/op %6.2f asig/op  (sin línea base)\n", nombre, mejorNs, asignaciones);
+    return;
+  }
+  // Un tiempo en 0 en la línea base solo controla las asignaciones
+  double relacion = base->nsPorOp > 0 ? mejorNs / base->nsPorOp : 0;
+  bool lento = relacion > TOLERANCIA_TIEMPO;
+  printf("%-24s %10.1f ns/op %6.2f asig/op  (base %.1f ns/op %.2f asig/op, x%.2f)%s\n", nombre, mejorNs,
+         asignaciones, base->nsPorOp, base->asignacionesPorOp, relacion, lento ? " ⚠ más lento" : "");
+
+  if (rastreoHeapActivo()) {
+    TEST_ASSERT_TRUE_MESSAGE(asignaciones <= base->asignacionesPorOp, "más asignaciones que la línea base");
+  }
+  if (RENDIMIENTO_ESTRICTO) {
+    TEST_ASSERT_TRUE_MESSAGE(!lento, "más lento que la línea base");
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ====== Casos ======
+// agregarFix() + procesar(): lo que hace tareaFixGPS con cada fix (procesarDatosGPS)
+void test_procesar_fix() {
+  medir("procesarDatosGPS", 20000, [](uint32_t) {
+    MuestraGPS m = fix(fixesProcesados++);
+    if (procesador.agregarFix(m, 1.0f) != FIX_SALTO) procesador.procesar(m.tiempoMs);
+  });
+}
+
+// Con la ventana llena (obtenerPuntoPromedio)
+void test_punto_promedio() {
+  medir("obtenerPuntoPromedio", 200000, [](uint32_t) { sumidero = sumidero + procesador.puntoPromedio().lat; });
+}
+
+void test_punto_filtrado() {
+  uint32_t ahora = fix(fixesProcesados).tiempoMs;
+  medir("puntoFiltrado", 200000, [ahora](uint32_t) { sumidero = sumidero + procesador.puntoFiltrado(ahora).lat; });
+}
+
+// Entre fixes consecutivos (calcularDistanciaHaversine)
+void test_distancia_haversine() {
+  medir("distanciaHaversine", 500000, [](uint32_t i) {
+    const MuestraGPS& a = vuelta[i % FIXES_VUELTA];
+    const MuestraGPS& b = vuelta[(i + 1) % FIXES_VUELTA];
+    sumidero = sumidero + distanciaHaversine(a.lat, a.lon, b.lat, b.lon);
+  });
+}
+
+void test_distancia_haversine_f() {
+  medir("distanciaHaversineF", 500000, [](uint32_t i) {
+    const MuestraGPS& a = vuelta[i % FIXES_VUELTA];
+    const MuestraGPS& b = vuelta[(i + 1) % FIXES_VUELTA];
+    sumidero = sumidero + distanciaHaversineF((float)a.lat, (float)a.lon, (float)b.lat, (float)b.lon);
+  });
+}
+
+void test_distancia_equirectangular() {
+  float coseno = cosf(-31.42f * (float)M_PI / 180.0f);
+  medir("distanciaEquirectangular", 500000, [coseno](uint32_t i) {
+    const MuestraGPS& a = vuelta[i % FIXES_VUELTA];
+    const MuestraGPS& b = vuelta[(i + 1) % FIXES_VUELTA];
+    sumidero = sumidero + distanciaEquirectangular(a.lat, a.lon, b.lat, b.lon, coseno);
+  });
+}
+
+void test_distancia_microgrados() {
+  uint16_t coseno = cosenoQ15(-31.42);
+  medir("distanciaMicrogradosCm", 500000, [coseno](uint32_t i) {
+    const MuestraGPS& a = vuelta[i % FIXES_VUELTA];
+    const MuestraGPS& b = vuelta[(i + 1) % FIXES_VUELTA];
+    sumidero = sumidero + distanciaMicrogradosCm(gradosAE6(a.lat), gradosAE6(a.lon), gradosAE6(b.lat),
+                                                 gradosAE6(b.lon), coseno);
+  });
+}
+
+// Error máximo contra distanciaHaversine en el rango que documenta
+// Geodesia.h: hasta 5 km, latitudes de hasta ±60° y todos los rumbos
+void test_error_distancias() {
+  double peorF = 0, peorEquirectangular = 0, peorMicrogrados = 0;
+  double peorRelativoEquirectangular = 0;
+  for (int lat = -60; lat <= 60; lat += 5) {
+    for (int rumbo = 0; rumbo < 360; rumbo += 15) {
+      for (double metros = 5; metros <= 5000; metros *= 1.5) {
+        double lat1 = lat + 0.123;
+        double lon1 = -64.1888;
+        double r = rumbo * M_PI / 180.0;
+        double lat2 = lat1 + metros * cos(r) / METROS_POR_GRADO;
+        double lon2 = lon1 + metros * sin(r) / (METROS_POR_GRADO * cos(lat1 * M_PI / 180.0));
+        double referencia = distanciaHaversine(lat1, lon1, lat2, lon2);
+
+        double f = fabs(distanciaHaversineF((float)lat1, (float)lon1, (float)lat2, (float)lon2) - referencia);
+        float coseno = cosf((float)lat1 * (float)M_PI / 180.0f);
+        double e = fabs(distanciaEquirectangular(lat1, lon1, lat2, lon2, coseno) - referencia);
+        uint32_t cm = distanciaMicrogradosCm(gradosAE6(lat1), gradosAE6(lon1), gradosAE6(lat2), gradosAE6(lon2),
+                                             cosenoQ15(lat1));
+        double m = fabs(cm / 100.0 - referencia);
+        if (f > peorF) peorF = f;
+        if (e > peorEquirectangular) peorEquirectangular = e;
+        if (e / referencia > peorRelativoEquirectangular) peorRelativoEquirectangular = e / referencia;
+        if (m > peorMicrogrados) peorMicrogrados = m;
+      }
+    }
+  }
+  printf("%-24s %10.3f m de error máximo\n", "distanciaHaversineF", peorF);
+  printf("%-24s %10.3f m de error máximo (%.4f %%)\n", "distanciaEquirectangular", peorEquirectangular,
+         peorRelativoEquirectangular * 100);
+  printf("%-24s %10.3f m de error máximo\n", "distanciaMicrogradosCm", peorMicrogrados);
+  // Las cotas de Geodesia.h
+  TEST_ASSERT_TRUE(peorF < 1.7);
+  TEST_ASSERT_TRUE(peorRelativoEquirectangular < 0.0003);
+  TEST_ASSERT_TRUE(peorMicrogrados < 0.2 + 5000 * 0.001);
+}
+
+static PuntoGPS puntoDeVuelta(uint32_t i) {
+  const MuestraGPS& m = vuelta[i % FIXES_VUELTA];
+  PuntoGPS p = {m.lat, m.lon, m.rumbo, m.velocidad, m.satelites, 13452199};
+  return p;
+}
+
+static TramaMapeo tramaDeVuelta(uint32_t i) {
+  PuntoGPS p = puntoDeVuelta(i);
+  TramaMapeo m = {i, 12, gradosAE7(p.lat), gradosAE7(p.lon), aCentesimas(p.velocidad), aCentesimas(p.rumbo),
+                  (uint32_t)p.tiempo, i, (uint8_t)p.satelites, false};
+  return m;
+}
+
+void test_json_punto() {
+  medir("codificarPuntoJSON", 100000, [](uint32_t i) {
+    char buffer[256];
+    ContextoMensaje c = {"camion-01", i, i, -1};
+    sumidero = sumidero + codificarPuntoJSON(puntoDeVuelta(i), "calle_12", c, buffer, sizeof(buffer));
+  });
+}
+
+void test_json_ubicacion() {
+  medir("codificarUbicacionJSON", 100000, [](uint32_t i) {
+    char buffer[256];
+    ContextoMensaje c = {"camion-01", i, i, 35};
+    sumidero = sumidero + codificarUbicacionJSON(puntoDeVuelta(i), c, buffer, sizeof(buffer));
+  });
+}
+
+// El mismo punto en el formato binario (LOGIOT_FORMATO_BINARIO)
+void test_trama_punto() {
+  medir("codificarPunto", 500000, [](uint32_t i) {
+    uint8_t buffer[TRAMA_MAX_BYTES];
+    sumidero = sumidero + codificarPunto(tramaDeVuelta(i), buffer, sizeof(buffer));
+  });
+}
+
+// Un lote de 30 fixes (LOGIOT_LOTES)
+void test_trama_lote() {
+  static PuntoLote puntos[30];
+  for (int i = 0; i < 30; i++) {
+    puntos[i].latE6 = gradosAE6(vuelta[i].lat);
+    puntos[i].lonE6 = gradosAE6(vuelta[i].lon);
+    puntos[i].tiempoMs = 1000 + i * 1000;
+  }
+  medir("codificarLote30", 50000, [](uint32_t i) {
+    uint8_t buffer[TRAMA_LOTE_MAX_BYTES];
+    sumidero = sumidero + codificarLote(i, 12, puntos, 30, buffer, sizeof(buffer));
+  });
+}
+
+// Bytes por punto de cada formato sobre 30 fixes de la vuelta, con el tiempo
+// a 1 Hz más unos ms de atraso como en el UART. El lote en polyline cuenta
+// solo la polyline y los "dt", sin el resto del documento JSON
+void test_bytes_por_punto() {
+  const uint8_t CANTIDAD = 30;
+  size_t json = 0, trama = 0;
+  PuntoLote puntos[CANTIDAD];
+  LoteTrayecto lote(ConfigLote{CANTIDAD, 60000});
+  for (uint8_t i = 0; i < CANTIDAD; i++) {
+    char buffer[256];
+    ContextoMensaje c = {"camion-01", 1000 + i * 1000U, i, -1};
+    json += codificarPuntoJSON(puntoDeVuelta(i), "calle_12", c, buffer, sizeof(buffer));
+    uint8_t binario[TRAMA_MAX_BYTES];
+    trama += codificarPunto(tramaDeVuelta(i), binario, sizeof(binario));
+    puntos[i].latE6 = gradosAE6(vuelta[i].lat);
+    puntos[i].lonE6 = gradosAE6(vuelta[i].lon);
+    puntos[i].tiempoMs = 1000 + i * 1000U + (i * 7) % 40;
+    lote.agregar(vuelta[i].lat, vuelta[i].lon, puntos[i].tiempoMs);
+  }
+  uint8_t binario[TRAMA_LOTE_MAX_BYTES];
+  size_t loteBinario = codificarLote(1, 12, puntos, CANTIDAD, binario, sizeof(binario));
+  char polyline[512];
+  char tiempos[TRAMA_LOTE_MAX_PUNTOS * 2 + 1];
+  size_t lotePolyline = lote.codificarPolyline(polyline, sizeof(polyline)) +
+                        lote.codificarTiempos(tiempos, sizeof(tiempos));
+
+  double porPunto[4] = {(double)json / CANTIDAD, (double)trama / CANTIDAD, (double)loteBinario / CANTIDAD,
+                        (double)lotePolyline / CANTIDAD};
+  const char* nombres[4] = {"punto JSON", "punto binario", "lote binario", "lote polyline"};
+  for (int i = 0; i < 4; i++) {
+    printf("%-24s %10.1f bytes/punto  (x%.1f contra JSON)\n", nombres[i], porPunto[i], porPunto[0] / porPunto[i]);
+  }
+  TEST_ASSERT_TRUE(loteBinario > 0 && lotePolyline > 0);
+  TEST_ASSERT_TRUE(porPunto[1] < porPunto[0]);
+  TEST_ASSERT_TRUE(porPunto[2] < porPunto[1]);
+  TEST_ASSERT_TRUE(porPunto[3] < porPunto[1]);
+}
+
+// ====== Punto a la bandeja QoS 1 (enviarPuntoAMQTT + publicarMensaje) ======
+// Antes la trama se codificaba en la pila y encolar() la copiaba a la
+// bandeja; ahora se codifica en el lugar que ocupa en la bandeja. Cada
+// operación además escribe el PUBLISH y lo confirma, para que no se llene.
+class SalidaDescartada : public SalidaMQTT {
+ public:
+  bool escribir(const uint8_t*, size_t) override { return true; }
+};
+
+static BandejaMQTTFija<4096> bandejaPuntos(ConfigBandeja{4});
+static SalidaDescartada salidaDescartada;
+static uint16_t idEsperado = 1;
+static const TopicoMQTT TOPICO_PUNTOS = topicoMQTT("logistica/bin/pedidos/ESP-32-CAMION_01");
+
+static void enviarYConfirmar() {
+  bandejaPuntos.enviar(salidaDescartada, 0);
+  bandejaPuntos.recibir(0x40, 0);
+  bandejaPuntos.recibir(0x02, 0);
+  bandejaPuntos.recibir((uint8_t)(idEsperado >> 8), 0);
+  bandejaPuntos.recibir((uint8_t)idEsperado, 0);
+  if (++idEsperado == 0) idEsperado = 1;
+}
+
+static void imprimirCopiados() {
+  const EstadisticasBandeja& e = bandejaPuntos.estadisticas();
+  printf("%-24s %10.1f bytes copiados/msg\n", "", e.encolados ? (double)e.copiados / e.encolados : 0.0);
+  TEST_ASSERT_EQUAL_UINT32(0, e.rechazados);
+  bandejaPuntos.reiniciarEstadisticas();
+}
+
+void test_punto_a_bandeja_copiando() {
+  medir("puntoABandejaCopiando", 200000, [](uint32_t i) {
+    uint8_t buffer[TRAMA_MAX_BYTES];
+    size_t largo = codificarPunto(tramaDeVuelta(i), buffer, sizeof(buffer));
+    bandejaPuntos.encolar(TOPICO_PUNTOS, buffer, largo, i);
+    enviarYConfirmar();
+  });
+  imprimirCopiados();
+}
+
+void test_punto_a_bandeja_en_su_lugar() {
+  medir("puntoABandejaEnSuLugar", 200000, [](uint32_t i) {
+    uint8_t* destino = bandejaPuntos.reservarMensaje(TOPICO_PUNTOS, TRAMA_MAX_BYTES);
+    size_t largo = codificarPunto(tramaDeVuelta(i), destino, TRAMA_MAX_BYTES);
+    bandejaPuntos.confirmarMensaje(largo, i);
+    enviarYConfirmar();
+  });
+  TEST_ASSERT_EQUAL_UINT32(0, bandejaPuntos.estadisticas().copiados);
+  imprimirCopiados();
+}
+
+// Tabla para linea_base.h con lo medido en esta corrida
+static void imprimirLineaBase() {
+  printf("\nstatic const LineaBase LINEA_BASE[] = {\n");
+  for (int i = 0; i < cantidadMedidas; i++) {
+    printf("  {\"%s\", %.1ff, %.2ff},\n", medidas[i].nombre, medidas[i].nsPorOp, medidas[i].asignacionesPorOp);
+  }
+  printf("};\n");
+}
+
+int main() {
+  armarVuelta();
+  if (!rastreoHeapActivo()) {
+    printf("⚠ Sin -DLOGIOT_SIN_HEAP=1 y -Wl,--wrap=malloc no se cuentan asignaciones\n");
+  }
+  UNITY_BEGIN();
+  RUN_TEST(test_procesar_fix);
+  RUN_TEST(test_punto_promedio);
+  RUN_TEST(test_punto_filtrado);
+  RUN_TEST(test_distancia_haversine);
+  RUN_TEST(test_distancia_haversine_f);
+  RUN_TEST(test_distancia_equirectangular);
+  RUN_TEST(test_distancia_microgrados);
+  RUN_TEST(test_error_distancias);
+  RUN_TEST(test_json_punto);
+  RUN_TEST(test_json_ubicacion);
+  RUN_TEST(test_trama_punto);
+  RUN_TEST(test_trama_lote);
+  RUN_TEST(test_bytes_por_punto);
+  RUN_TEST(test_punto_a_bandeja_copiando);
+  RUN_TEST(test_punto_a_bandeja_en_su_lugar);
+  imprimirLineaBase();
+  return UNITY_END();
+}
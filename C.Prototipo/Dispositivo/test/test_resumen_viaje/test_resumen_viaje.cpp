@@ -0,0 +1,165 @@
+// ====== Tests de lib/ResumenViaje ======
+// Recorridos reproducidos con lib/EscenarioGPS a un fix por segundo:
+// distancia y rangos de velocidad, paradas con histéresis, aceleraciones y
+// frenadas bruscas, cortes del GPS y calles que suman el viaje.
+
+#include <unity.h>
+
+#include <EscenarioGPS.h>
+#include <ResumenViaje.h>
+
+#include <string.h>
+
+// Mismos valores que src/main.cpp
+static const ConfigResumenViaje CONFIG = {3.0f, 6.0f, 60000, 2.5f, 5000};
+
+void setUp() {}
+void tearDown() {}
+
+// Reproduce el guion hasta que termina, salteando los cortes del GPS; el
+// último fix es el del segundo anterior al final del guion
+static void reproducir(const char* guion, ResumenViaje& resumen) {
+  FuenteEscenarioMemoria fuente(guion, strlen(guion));
+  EscenarioGPS escenario(fuente);
+  resumen.iniciarViaje();
+  resumen.iniciarCalle();
+  MuestraEscenario e;
+  for (uint32_t t = 0; escenario.muestra(t, e); t += 1000) {
+    if (!e.conFix) continue;
+    MuestraGPS m = {e.lat, e.lon, (float)e.rumbo, (float)e.velocidad, e.satelites, 0, t};
+    resumen.agregar(m);
+  }
+}
+
+void test_recta_a_velocidad_constante() {
+  ResumenViaje resumen(CONFIG);
+  reproducir("inicio -31.42 -64.18\nrumbo 90\nvelocidad 36\nesperar 100\n", resumen);
+  const Resumen& v = resumen.viaje();
+  TEST_ASSERT_UINT32_WITHIN(1, 990, v.distanciaM());
+  TEST_ASSERT_EQUAL_UINT32(99000, v.duracionMs);
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 36.0f, v.velocidadMediaKmh());
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 36.0f, v.velocidadMaxKmh);
+  // 36 km/h cae en el rango de 30 a 45
+  TEST_ASSERT_EQUAL_UINT32(99000, v.rangoMs[2]);
+  TEST_ASSERT_EQUAL_UINT16(0, v.paradas);
+  TEST_ASSERT_EQUAL_UINT32(0, v.detenidoMs);
+  TEST_ASSERT_EQUAL_UINT16(0, v.aceleraciones + v.frenadas);
+}
+
+void test_parada_larga_cuenta_y_semaforo_no() {
+  ResumenViaje resumen(CONFIG);
+  reproducir(
+      "inicio -31.42 -64.18\nvelocidad 36\nesperar 30\n"
+      // Semáforo: 30 s detenido
+      "velocidad 0 10\nesperar 40\nvelocidad 36 10\nesperar 30\n"
+      // Entrega: 2 min detenido, con un arrastre a 5 km/h que no alcanza
+      // para salir de la detención
+      "velocidad 0 10\nesperar 70\nvelocidad 5 2\nesperar 5\nvelocidad 0 2\nesperar 60\n"
+      "velocidad 36 10\nesperar 30\n",
+      resumen);
+  const Resumen& v = resumen.viaje();
+  TEST_ASSERT_EQUAL_UINT16(1, v.paradas);
+  TEST_ASSERT_FALSE(resumen.detenido());
+  // ~31 s del semáforo y ~128 s de la entrega, con el arrastre adentro
+  TEST_ASSERT_UINT32_WITHIN(4000, 159000, v.detenidoMs);
+  // Frenando y arrancando también se pasa por debajo de 15 km/h
+  TEST_ASSERT_TRUE(v.rangoMs[0] > v.detenidoMs);
+  // Frenar o arrancar de 0 a 36 en 10 s (1 m/s²) no es brusco
+  TEST_ASSERT_EQUAL_UINT16(0, v.aceleraciones + v.frenadas);
+}
+
+void test_detenido_no_suma_distancia() {
+  ResumenViaje resumen(CONFIG);
+  // A 2 km/h el escenario se sigue moviendo: 100 s son ~55 m que no cuentan
+  reproducir("inicio -31.42 -64.18\nvelocidad 2\nesperar 100\n", resumen);
+  TEST_ASSERT_TRUE(resumen.detenido());
+  TEST_ASSERT_EQUAL_UINT32(0, resumen.viaje().distanciaM());
+  TEST_ASSERT_EQUAL_UINT32(99000, resumen.viaje().detenidoMs);
+  TEST_ASSERT_EQUAL_UINT16(1, resumen.viaje().paradas);
+}
+
+void test_frenada_y_aceleracion_bruscas_cuentan_una_vez() {
+  ResumenViaje resumen(CONFIG);
+  reproducir(
+      "inicio -31.42 -64.18\nvelocidad 60\nesperar 10\n"
+      // 60 a 0 en 5 s: 3,3 m/s² durante 5 fixes
+      "velocidad 0 5\nesperar 20\n"
+      // 0 a 50 en 4 s: 3,5 m/s²
+      "velocidad 50 4\nesperar 20\n"
+      // 50 a 30 en 10 s: 0,6 m/s²
+      "velocidad 30 10\nesperar 20\n",
+      resumen);
+  const Resumen& v = resumen.viaje();
+  TEST_ASSERT_EQUAL_UINT16(1, v.frenadas);
+  TEST_ASSERT_EQUAL_UINT16(1, v.aceleraciones);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 60.0f, v.velocidadMaxKmh);
+}
+
+void test_corte_del_gps() {
+  ResumenViaje resumen(CONFIG);
+  reproducir(
+      "inicio -31.42 -64.18\nvelocidad 36\nesperar 20\n"
+      "gps apagado\nvelocidad 72\nesperar 30\ngps encendido\nesperar 20\n",
+      resumen);
+  const Resumen& v = resumen.viaje();
+  // El salto de 36 a 72 km/h pasa en el corte: no es una aceleración
+  TEST_ASSERT_EQUAL_UINT16(0, v.aceleraciones);
+  TEST_ASSERT_EQUAL_UINT32(69000, v.duracionMs);
+  // El hueco va a la duración y a la distancia, no a los rangos
+  uint32_t enRangos = 0;
+  for (uint8_t i = 0; i < RESUMEN_RANGOS; i++) enRangos += v.rangoMs[i];
+  TEST_ASSERT_UINT32_WITHIN(1000, 38000, enRangos);
+  TEST_ASSERT_UINT32_WITHIN(5, 200 + 600 + 380, v.distanciaM());
+}
+
+void test_calles_suman_el_viaje() {
+  ResumenViaje completo(CONFIG);
+  ResumenViaje porCalles(CONFIG);
+  const char* guion =
+      "inicio -31.42 -64.18\nvelocidad 40 10\nesperar 60\nvelocidad 0 5\nesperar 90\n"
+      "velocidad 80 6\nrumbo 90 5\nesperar 120\n";
+  reproducir(guion, completo);
+
+  // Mismo recorrido cortado en calles de 25 fixes, sumando cada una al cerrarla
+  FuenteEscenarioMemoria fuente(guion, strlen(guion));
+  EscenarioGPS escenario(fuente);
+  porCalles.iniciarViaje();
+  porCalles.iniciarCalle();
+  Resumen suma;
+  memset(&suma, 0, sizeof(suma));
+  MuestraEscenario e;
+  uint32_t fixes = 0;
+  for (uint32_t t = 0; escenario.muestra(t, e); t += 1000) {
+    MuestraGPS m = {e.lat, e.lon, (float)e.rumbo, (float)e.velocidad, e.satelites, 0, t};
+    porCalles.agregar(m);
+    if (++fixes % 25 == 0) {
+      suma.distanciaCm += porCalles.calle().distanciaCm;
+      suma.duracionMs += porCalles.calle().duracionMs;
+      suma.paradas += porCalles.calle().paradas;
+      suma.aceleraciones += porCalles.calle().aceleraciones;
+      porCalles.iniciarCalle();
+    }
+  }
+  suma.distanciaCm += porCalles.calle().distanciaCm;
+  suma.duracionMs += porCalles.calle().duracionMs;
+  suma.paradas += porCalles.calle().paradas;
+  suma.aceleraciones += porCalles.calle().aceleraciones;
+
+  const Resumen& v = completo.viaje();
+  TEST_ASSERT_EQUAL_UINT32(v.distanciaCm, porCalles.viaje().distanciaCm);
+  TEST_ASSERT_EQUAL_UINT32(v.distanciaCm, suma.distanciaCm);
+  TEST_ASSERT_EQUAL_UINT32(v.duracionMs, suma.duracionMs);
+  TEST_ASSERT_EQUAL_UINT16(1, suma.paradas);
+  TEST_ASSERT_EQUAL_UINT16(v.aceleraciones, suma.aceleraciones);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_recta_a_velocidad_constante);
+  RUN_TEST(test_parada_larga_cuenta_y_semaforo_no);
+  RUN_TEST(test_detenido_no_suma_distancia);
+  RUN_TEST(test_frenada_y_aceleracion_bruscas_cuentan_una_vez);
+  RUN_TEST(test_corte_del_gps);
+  RUN_TEST(test_calles_suman_el_viaje);
+  return UNITY_END();
+}
@@ -0,0 +1,181 @@
+// ====== Tests de lib/SimplificadorTrayecto ======
+// Una recta de puntos colineales se reduce a sus dos extremos (aunque la
+// ventana se compacte), en un trayecto con curvas todo punto descartado
+// queda a menos de la tolerancia de la polilínea simplificada, el primer y
+// el último punto se conservan siempre y una recta larga emite igual cada
+// maxIntervaloMs.
+
+#include <unity.h>
+
+#include <math.h>
+
+#include <SimplificadorTrayecto.h>
+#include <Geodesia.h>
+
+static const ConfigSimplificador CONFIG = {5.0f, SIMPLIFICADOR_MAX_VENTANA, 600000};
+
+static const double LAT0 = -31.42;
+static const double LON0 = -64.18;
+static const double METROS_POR_GRADO = RADIO_TIERRA_M * M_PI / 180.0;
+static const double COS_LAT0 = cos(LAT0 * M_PI / 180.0);
+
+static const uint16_t MAX_PUNTOS = 400;
+
+// Un fix por segundo a 'norte' y 'este' metros del origen
+static VerticeTrayecto punto(double norte, double este, uint32_t n) {
+  VerticeTrayecto v = {};
+  v.lat = LAT0 + norte / METROS_POR_GRADO;
+  v.lon = LON0 + este / (METROS_POR_GRADO * COS_LAT0);
+  v.velocidad = 36.0f;
+  v.satelites = 9;
+  v.tiempoGps = n;
+  v.tiempoMs = 1000 + n * 1000;
+  return v;
+}
+
+static void aMetros(const VerticeTrayecto& v, double& norte, double& este) {
+  norte = (v.lat - LAT0) * METROS_POR_GRADO;
+  este = (v.lon - LON0) * METROS_POR_GRADO * COS_LAT0;
+}
+
+// Pasa los puntos por el simplificador como el procesador: el primero es
+// el ancla, después agregar() y al final cerrar(). Devuelve los vértices.
+static uint16_t simplificar(SimplificadorTrayecto& s, const VerticeTrayecto* puntos, uint16_t cantidad,
+                            VerticeTrayecto* vertices) {
+  uint16_t n = 0;
+  s.iniciar(puntos[0]);
+  vertices[n++] = puntos[0];
+  for (uint16_t i = 1; i < cantidad; i++) {
+    if (s.agregar(puntos[i], vertices[n])) n++;
+  }
+  if (s.cerrar(vertices[n])) n++;
+  return n;
+}
+
+// Distancia en metros de p al segmento a-b
+static double distanciaASegmento(const VerticeTrayecto& p, const VerticeTrayecto& a, const VerticeTrayecto& b) {
+  double pn, pe, an, ae, bn, be;
+  aMetros(p, pn, pe);
+  aMetros(a, an, ae);
+  aMetros(b, bn, be);
+  double dn = bn - an, de = be - ae;
+  double largo2 = dn * dn + de * de;
+  double t = largo2 > 0 ? ((pn - an) * dn + (pe - ae) * de) / largo2 : 0;
+  if (t < 0) t = 0;
+  if (t > 1) t = 1;
+  return hypot(pn - an - t * dn, pe - ae - t * de);
+}
+
+static void mismoPunto(const VerticeTrayecto& esperado, const VerticeTrayecto& v) {
+  TEST_ASSERT_TRUE(distanciaHaversine(esperado.lat, esperado.lon, v.lat, v.lon) < 0.01);
+  TEST_ASSERT_EQUAL_UINT32(esperado.tiempoMs, v.tiempoMs);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_colineales_quedan_en_los_extremos() {
+  // 300 puntos cada 8 m hacia el noreste: la ventana se compacta varias veces
+  static VerticeTrayecto puntos[MAX_PUNTOS], vertices[MAX_PUNTOS];
+  const uint16_t CANTIDAD = 300;
+  for (uint16_t i = 0; i < CANTIDAD; i++) {
+    puntos[i] = punto(8.0 * i * M_SQRT1_2, 8.0 * i * M_SQRT1_2, i);
+  }
+  SimplificadorTrayecto s(CONFIG);
+  TEST_ASSERT_EQUAL_UINT16(2, simplificar(s, puntos, CANTIDAD, vertices));
+  mismoPunto(puntos[0], vertices[0]);
+  mismoPunto(puntos[CANTIDAD - 1], vertices[1]);
+  TEST_ASSERT_FALSE(s.activo());
+}
+
+void test_descartados_dentro_de_la_tolerancia() {
+  // Recta, esquina, arco de 90° con radio de 60 m y una ondulación de 3 m
+  static VerticeTrayecto puntos[MAX_PUNTOS], vertices[MAX_PUNTOS];
+  uint16_t cantidad = 0;
+  double norte = 0, este = 0;
+  for (uint16_t i = 0; i < 40; i++, norte += 6.0) {
+    puntos[cantidad] = punto(norte, este, cantidad);
+    cantidad++;
+  }
+  for (uint16_t i = 0; i < 40; i++, este += 6.0) {
+    puntos[cantidad] = punto(norte, este, cantidad);
+    cantidad++;
+  }
+  double centroNorte = norte - 60.0, centroEste = este;
+  for (uint16_t i = 0; i <= 30; i++) {
+    double angulo = (i * 3.0) * M_PI / 180.0;
+    puntos[cantidad] = punto(centroNorte + 60.0 * cos(angulo), centroEste + 60.0 * sin(angulo), cantidad);
+    cantidad++;
+  }
+  norte = centroNorte;
+  este = centroEste + 60.0;
+  for (uint16_t i = 1; i <= 80; i++) {
+    puntos[cantidad] = punto(norte - 6.0 * i, este + 3.0 * sin(i * 0.5), cantidad);
+    cantidad++;
+  }
+
+  SimplificadorTrayecto s(CONFIG);
+  uint16_t n = simplificar(s, puntos, cantidad, vertices);
+  TEST_ASSERT_TRUE(n >= 4);
+  TEST_ASSERT_TRUE(n < cantidad / 4);
+  mismoPunto(puntos[0], vertices[0]);
+  mismoPunto(puntos[cantidad - 1], vertices[n - 1]);
+
+  // Los vértices son puntos de entrada, en orden, y cada punto de entrada
+  // queda dentro de la tolerancia del segmento que lo cubre
+  uint16_t segmento = 0;
+  double peor = 0;
+  for (uint16_t i = 0; i < cantidad; i++) {
+    while (segmento + 1 < n - 1 && puntos[i].tiempoMs > vertices[segmento + 1].tiempoMs) segmento++;
+    double d = distanciaASegmento(puntos[i], vertices[segmento], vertices[segmento + 1]);
+    if (d > peor) peor = d;
+  }
+  for (uint16_t v = 0; v < n; v++) {
+    uint16_t i = (uint16_t)vertices[v].tiempoGps;
+    mismoPunto(puntos[i], vertices[v]);
+  }
+  TEST_ASSERT_TRUE(peor <= CONFIG.toleranciaMetros + 0.01);
+}
+
+void test_primero_y_ultimo_con_un_solo_punto() {
+  SimplificadorTrayecto s(CONFIG);
+  VerticeTrayecto primero = punto(0, 0, 0);
+  VerticeTrayecto v;
+  s.iniciar(primero);
+  // Sin puntos después del ancla no hay vértice final que agregar
+  TEST_ASSERT_FALSE(s.cerrar(v));
+
+  s.iniciar(primero);
+  VerticeTrayecto segundo = punto(3.0, 1.0, 1);
+  TEST_ASSERT_FALSE(s.agregar(segundo, v));
+  TEST_ASSERT_TRUE(s.cerrar(v));
+  mismoPunto(segundo, v);
+}
+
+void test_recta_larga_emite_cada_intervalo() {
+  ConfigSimplificador config = CONFIG;
+  config.maxIntervaloMs = 30000;
+  static VerticeTrayecto puntos[MAX_PUNTOS], vertices[MAX_PUNTOS];
+  const uint16_t CANTIDAD = 121;
+  for (uint16_t i = 0; i < CANTIDAD; i++) {
+    puntos[i] = punto(10.0 * i, 0, i);
+  }
+  SimplificadorTrayecto s(config);
+  uint16_t n = simplificar(s, puntos, CANTIDAD, vertices);
+  // Ancla, el punto anterior al que cumple los 30 s (cada 29 s) y el final
+  TEST_ASSERT_EQUAL_UINT16(6, n);
+  TEST_ASSERT_EQUAL_UINT32(puntos[29].tiempoMs, vertices[1].tiempoMs);
+  for (uint16_t v = 1; v < n; v++) {
+    TEST_ASSERT_TRUE(vertices[v].tiempoMs - vertices[v - 1].tiempoMs <= config.maxIntervaloMs);
+  }
+  mismoPunto(puntos[CANTIDAD - 1], vertices[n - 1]);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_colineales_quedan_en_los_extremos);
+  RUN_TEST(test_descartados_dentro_de_la_tolerancia);
+  RUN_TEST(test_primero_y_ultimo_con_un_solo_punto);
+  RUN_TEST(test_recta_larga_emite_cada_intervalo);
+  return UNITY_END();
+}
@@ -0,0 +1,80 @@
+// ====== Tests de lib/SimuladorGPS ======
+// El recorrido del Dispositivo de Testeo: la espiral arranca al norte del
+// punto base y se abre con el tiempo, los rangos de velocidad y satélites, y
+// la detección de giros de prueba.
+
+#include <unity.h>
+
+#include <SimuladorGPS.h>
+
+#include <math.h>
+
+static const double LAT_BASE = -31.4201;
+static const double LON_BASE = -64.1888;
+
+void setUp() {}
+void tearDown() {}
+
+void test_arranca_al_norte_del_punto_base() {
+  SimuladorGPS s(LAT_BASE, LON_BASE);
+  MuestraSimulada m = s.muestra(0);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-12, LAT_BASE + 0.001, m.lat);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-12, LON_BASE, m.lon);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-12, 0.0, m.rumbo);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-12, 15.0, m.velocidad);
+  TEST_ASSERT_EQUAL_INT(8, m.satelites);
+}
+
+void test_la_espiral_se_abre() {
+  SimuladorGPS s(LAT_BASE, LON_BASE);
+  // Un cuarto de vuelta (45 s): al este del punto base, 0,45° más lejos
+  MuestraSimulada m = s.muestra(45000);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 90.0, m.rumbo);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, LAT_BASE, m.lat);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, LON_BASE + 0.001 + 0.45, m.lon);
+}
+
+void test_rangos_de_velocidad_y_satelites() {
+  SimuladorGPS s(LAT_BASE, LON_BASE);
+  for (uint32_t t = 0; t < 3600000; t += 1000) {
+    MuestraSimulada m = s.muestra(t);
+    TEST_ASSERT_TRUE(m.velocidad >= 5.0 && m.velocidad <= 25.0);
+    TEST_ASSERT_TRUE(m.satelites >= 5 && m.satelites <= 11);
+    TEST_ASSERT_TRUE(m.rumbo >= 0.0 && m.rumbo < 360.0);
+  }
+}
+
+void test_la_espiral_no_da_giros() {
+  SimuladorGPS s(LAT_BASE, LON_BASE);
+  for (uint32_t t = 0; t < 3600000; t += 1000) {
+    TEST_ASSERT_FALSE(s.giro(s.muestra(t)));
+  }
+}
+
+void test_giro_con_tres_cambios_seguidos() {
+  SimuladorGPS s(LAT_BASE, LON_BASE);
+  MuestraSimulada m = {LAT_BASE, LON_BASE, 0.0, 20.0, 8};
+  TEST_ASSERT_FALSE(s.giro(m));
+  m.rumbo = 40;
+  TEST_ASSERT_FALSE(s.giro(m));
+  m.rumbo = 80;
+  TEST_ASSERT_FALSE(s.giro(m));
+  m.rumbo = 120;
+  TEST_ASSERT_TRUE(s.giro(m));
+  // Despacio no cuenta aunque el rumbo cambie
+  m.velocidad = 3.0;
+  for (int i = 0; i < 5; i++) {
+    m.rumbo = fmod(m.rumbo + 45.0, 360.0);
+    TEST_ASSERT_FALSE(s.giro(m));
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_arranca_al_norte_del_punto_base);
+  RUN_TEST(test_la_espiral_se_abre);
+  RUN_TEST(test_rangos_de_velocidad_y_satelites);
+  RUN_TEST(test_la_espiral_no_da_giros);
+  RUN_TEST(test_giro_con_tres_cambios_seguidos);
+  return UNITY_END();
+}
@@ -0,0 +1,184 @@
+// ====== Tests de lib/TramaBinaria ======
+// Ida y vuelta de cada trama con los tamaños documentados en TramaBinaria.h
+// y el lote con deltas en varint zigzag; los tiempos del lote no derivan
+// aunque cada intervalo quede a mitad de una centésima.
+
+#include <unity.h>
+
+#include <TramaBinaria.h>
+
+void setUp() {}
+void tearDown() {}
+
+static TramaMapeo mapeo() {
+  TramaMapeo m = {123456, 7, gradosAE7(-31.4201234), gradosAE7(-64.1888765), aCentesimas(42.37),
+                  aCentesimas(271.5), 13452199, 987654, 9, false};
+  return m;
+}
+
+void test_punto_ida_y_vuelta() {
+  uint8_t buffer[TRAMA_MAX_BYTES];
+  TramaMapeo m = mapeo();
+  TEST_ASSERT_EQUAL_size_t(28, codificarPunto(m, buffer, sizeof(buffer)));
+  Trama t;
+  TEST_ASSERT_EQUAL_INT(TRAMA_OK, decodificarTrama(buffer, 28, t));
+  TEST_ASSERT_EQUAL_INT(TRAMA_PUNTO, t.tipo);
+  TEST_ASSERT_EQUAL_UINT32(m.seq, t.mapeo.seq);
+  TEST_ASSERT_EQUAL_UINT16(m.calle, t.mapeo.calle);
+  TEST_ASSERT_EQUAL_INT32(m.latE7, t.mapeo.latE7);
+  TEST_ASSERT_EQUAL_INT32(m.lonE7, t.mapeo.lonE7);
+  TEST_ASSERT_EQUAL_UINT16(4237, t.mapeo.velocidadCentiKmh);
+  TEST_ASSERT_EQUAL_UINT16(27150, t.mapeo.rumboCentiGrados);
+  TEST_ASSERT_EQUAL_UINT32(m.tiempoGps, t.mapeo.tiempoGps);
+  TEST_ASSERT_EQUAL_UINT8(9, t.mapeo.satelites);
+  TEST_ASSERT_FALSE(t.mapeo.precisionBaja);
+}
+
+void test_tamanos_documentados() {
+  uint8_t buffer[TRAMA_MAX_BYTES];
+  TramaMapeo m = mapeo();
+  TramaDiagnostico d = {1000, 7, true, true, false, 3, 1000, 2, 0};
+  TEST_ASSERT_EQUAL_size_t(24, codificarInicio(m, buffer, sizeof(buffer)));
+  TEST_ASSERT_EQUAL_size_t(11, codificarFin(m, buffer, sizeof(buffer)));
+  TEST_ASSERT_EQUAL_size_t(20, codificarUbicacion(m, buffer, sizeof(buffer)));
+  TEST_ASSERT_EQUAL_size_t(22, codificarDiagnostico(d, buffer, sizeof(buffer)));
+  TEST_ASSERT_EQUAL_size_t(0, codificarPunto(m, buffer, 27));
+}
+
+void test_rechaza_version_y_largo() {
+  uint8_t buffer[TRAMA_MAX_BYTES];
+  size_t largo = codificarPunto(mapeo(), buffer, sizeof(buffer));
+  Trama t;
+  TEST_ASSERT_EQUAL_INT(TRAMA_CORTA, decodificarTrama(buffer, largo - 1, t));
+  buffer[0] = (uint8_t)((TRAMA_VERSION + 1) << 4 | TRAMA_PUNTO);
+  TEST_ASSERT_EQUAL_INT(TRAMA_VERSION_DESCONOCIDA, decodificarTrama(buffer, largo, t));
+}
+
+void test_lote_ida_y_vuelta() {
+  PuntoLote puntos[20];
+  for (int i = 0; i < 20; i++) {
+    puntos[i].latE6 = -31420000 + i * 87 - (i % 3) * 5;
+    puntos[i].lonE6 = -64180000 - i * 41;
+    puntos[i].tiempoMs = 5000 + i * 1000;
+  }
+  uint8_t buffer[TRAMA_LOTE_MAX_BYTES];
+  size_t largo = codificarLote(42, 3, puntos, 20, buffer, sizeof(buffer));
+  TEST_ASSERT_TRUE(largo > 0 && largo < 20 + 19 * 7);
+
+  PuntoLote leidos[20];
+  TEST_ASSERT_EQUAL_UINT8(20, decodificarPuntosLote(buffer, largo, leidos, 20));
+  for (int i = 0; i < 20; i++) {
+    TEST_ASSERT_EQUAL_INT32(puntos[i].latE6, leidos[i].latE6);
+    TEST_ASSERT_EQUAL_INT32(puntos[i].lonE6, leidos[i].lonE6);
+    TEST_ASSERT_EQUAL_UINT32(puntos[i].tiempoMs, leidos[i].tiempoMs);
+  }
+}
+
+void test_lote_tiempos_sin_deriva() {
+  // Intervalos de 1005 ms: redondeados uno por uno daban 1010 ms y el último
+  // punto llegaba 95 ms corrido
+  PuntoLote puntos[20];
+  for (int i = 0; i < 20; i++) {
+    puntos[i].latE6 = -31420000 + i * 87;
+    puntos[i].lonE6 = -64180000;
+    puntos[i].tiempoMs = 5003 + i * 1005;
+  }
+  uint8_t buffer[TRAMA_LOTE_MAX_BYTES];
+  size_t largo = codificarLote(42, 3, puntos, 20, buffer, sizeof(buffer));
+  PuntoLote leidos[20];
+  TEST_ASSERT_EQUAL_UINT8(20, decodificarPuntosLote(buffer, largo, leidos, 20));
+  for (int i = 0; i < 20; i++) {
+    TEST_ASSERT_UINT32_WITHIN(5, puntos[i].tiempoMs, leidos[i].tiempoMs);
+  }
+}
+
+void test_fin_con_tramos_conocidos() {
+  uint8_t buffer[64];
+  TramaMapeo m = mapeo();
+  const uint32_t tramos[3] = {5, 300, 70000};
+  size_t largo = codificarFin(m, buffer, sizeof(buffer), tramos, 3);
+  TEST_ASSERT_EQUAL_size_t(11 + 1 + 1 + 2 + 3, largo);
+  Trama t;
+  TEST_ASSERT_EQUAL_INT(TRAMA_OK, decodificarTrama(buffer, largo, t));
+  TEST_ASSERT_EQUAL_INT(TRAMA_FIN, t.tipo);
+  TEST_ASSERT_EQUAL_UINT16(m.calle, t.mapeo.calle);
+  uint32_t leidos[8];
+  TEST_ASSERT_EQUAL_UINT8(3, decodificarTramosFin(buffer, largo, leidos, 8));
+  for (uint8_t i = 0; i < 3; i++) TEST_ASSERT_EQUAL_UINT32(tramos[i], leidos[i]);
+
+  // Sin tramos es la trama de siempre; sin lugar para los tramos, 0
+  TEST_ASSERT_EQUAL_UINT8(0, decodificarTramosFin(buffer, 11, leidos, 8));
+  TEST_ASSERT_EQUAL_size_t(0, codificarFin(m, buffer, 14, tramos, 3));
+}
+
+void test_resumen_ida_y_vuelta() {
+  uint8_t buffer[64];
+  TramaResumen r = {};
+  r.seq = 77;
+  r.calle = 12;
+  r.timestamp = 600000;
+  r.viaje = true;
+  r.final = true;
+  r.distanciaM = 15234;
+  r.duracionS = 1800;
+  r.detenidoS = 240;
+  r.velocidadMaxCentiKmh = aCentesimas(72.5);
+  r.paradas = 3;
+  r.aceleraciones = 1;
+  r.frenadas = 2;
+  r.rangos = 3;
+  r.rangoS[0] = 240;
+  r.rangoS[1] = 60;
+  r.rangoS[2] = 1500;
+  size_t largo = codificarResumen(r, buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL_size_t(32 + 1 + 2 + 1 + 2, largo);
+  Trama t;
+  TEST_ASSERT_EQUAL_INT(TRAMA_OK, decodificarTrama(buffer, largo, t));
+  TEST_ASSERT_EQUAL_INT(TRAMA_RESUMEN, t.tipo);
+  TEST_ASSERT_EQUAL_UINT32(77, t.resumen.seq);
+  TEST_ASSERT_EQUAL_UINT16(12, t.resumen.calle);
+  TEST_ASSERT_TRUE(t.resumen.viaje);
+  TEST_ASSERT_TRUE(t.resumen.final);
+  TEST_ASSERT_EQUAL_UINT32(15234, t.resumen.distanciaM);
+  TEST_ASSERT_EQUAL_UINT32(240, t.resumen.detenidoS);
+  TEST_ASSERT_EQUAL_UINT16(7250, t.resumen.velocidadMaxCentiKmh);
+  TEST_ASSERT_EQUAL_UINT16(2, t.resumen.frenadas);
+  TEST_ASSERT_EQUAL_UINT8(3, t.resumen.rangos);
+  TEST_ASSERT_EQUAL_UINT32(1500, t.resumen.rangoS[2]);
+
+  // El de una calle no lleva rangos
+  r.viaje = false;
+  r.final = false;
+  r.rangos = 0;
+  TEST_ASSERT_EQUAL_size_t(32, codificarResumen(r, buffer, sizeof(buffer)));
+  TEST_ASSERT_EQUAL_INT(TRAMA_OK, decodificarTrama(buffer, 32, t));
+  TEST_ASSERT_FALSE(t.resumen.viaje);
+  TEST_ASSERT_EQUAL_UINT8(0, t.resumen.rangos);
+  TEST_ASSERT_EQUAL_INT(TRAMA_CORTA, decodificarTrama(buffer, 31, t));
+}
+
+void test_zigzag_y_varint() {
+  TEST_ASSERT_EQUAL_UINT32(0, zigzag(0));
+  TEST_ASSERT_EQUAL_UINT32(1, zigzag(-1));
+  TEST_ASSERT_EQUAL_UINT32(2, zigzag(1));
+  TEST_ASSERT_EQUAL_INT32(-2147483647 - 1, deszigzag(zigzag(-2147483647 - 1)));
+  uint8_t buffer[5];
+  uint32_t v = 0;
+  TEST_ASSERT_EQUAL_size_t(5, escribirVarint(0xFFFFFFFF, buffer, sizeof(buffer)));
+  TEST_ASSERT_EQUAL_size_t(5, leerVarint(buffer, 5, v));
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, v);
+  TEST_ASSERT_EQUAL_size_t(0, escribirVarint(300, buffer, 1));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_punto_ida_y_vuelta);
+  RUN_TEST(test_tamanos_documentados);
+  RUN_TEST(test_rechaza_version_y_largo);
+  RUN_TEST(test_lote_ida_y_vuelta);
+  RUN_TEST(test_lote_tiempos_sin_deriva);
+  RUN_TEST(test_fin_con_tramos_conocidos);
+  RUN_TEST(test_resumen_ida_y_vuelta);
+  RUN_TEST(test_zigzag_y_varint);
+  return UNITY_END();
+}
@@ -0,0 +1,100 @@
+// ====== Tests de lib/VentanaGPS ======
+// Las estadísticas incrementales contra el recálculo directo de la ventana,
+// la media circular del rumbo y el descarte de saltos.
+
+#include <unity.h>
+
+#include <VentanaGPS.h>
+
+#include <math.h>
+
+static const ConfigVentanaGPS CONFIG = {150.0f, 25.0f, 5};
+static const ConfigVentanaGPS SIN_DESCARTE = {150.0f, 25.0f, 0};
+
+void setUp() {}
+void tearDown() {}
+
+static MuestraGPS muestra(double lat, double lon, float rumbo, float velocidad, uint32_t tiempoMs) {
+  MuestraGPS m = {lat, lon, rumbo, velocidad, 8, tiempoMs / 10, tiempoMs};
+  return m;
+}
+
+void test_media_igual_al_recalculo() {
+  VentanaGPSFija<10> ventana(SIN_DESCARTE);
+  for (int i = 0; i < 37; i++) {
+    ventana.agregar(muestra(-31.42 + i * 1e-5, -64.18 - i * 2e-5, 90, 20.0f + (i % 7), i * 1000));
+  }
+  TEST_ASSERT_EQUAL_UINT16(10, ventana.cantidad());
+  double lat = 0, lon = 0, vel = 0;
+  float minima = 1e9f, maxima = -1e9f;
+  for (uint16_t e = 0; e < ventana.cantidad(); e++) {
+    const MuestraGPS& m = ventana.muestra(e);
+    lat += m.lat;
+    lon += m.lon;
+    vel += m.velocidad;
+    minima = fminf(minima, m.velocidad);
+    maxima = fmaxf(maxima, m.velocidad);
+  }
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, lat / 10, ventana.latitudMedia());
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, lon / 10, ventana.longitudMedia());
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, vel / 10, ventana.velocidadMedia());
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, minima, ventana.velocidadMinima());
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, maxima, ventana.velocidadMaxima());
+}
+
+void test_muestra_cero_es_la_mas_reciente() {
+  VentanaGPSFija<4> ventana(SIN_DESCARTE);
+  for (uint32_t i = 1; i <= 6; i++) {
+    ventana.agregar(muestra(-31.42, -64.18, 0, 10, i * 1000));
+  }
+  TEST_ASSERT_EQUAL_UINT32(6000, ventana.muestra(0).tiempoMs);
+  TEST_ASSERT_EQUAL_UINT32(3000, ventana.muestra(3).tiempoMs);
+}
+
+void test_rumbo_medio_circular() {
+  VentanaGPSFija<4> ventana(SIN_DESCARTE);
+  ventana.agregar(muestra(-31.42, -64.18, 359, 10, 0));
+  ventana.agregar(muestra(-31.42, -64.18, 1, 10, 1000));
+  double rumbo = ventana.rumboMedio();
+  TEST_ASSERT_TRUE(rumbo < 0.01 || rumbo > 359.99);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-3, 1.0, ventana.longitudResultante());
+
+  VentanaGPSFija<4> opuestos(SIN_DESCARTE);
+  opuestos.agregar(muestra(-31.42, -64.18, 0, 10, 0));
+  opuestos.agregar(muestra(-31.42, -64.18, 180, 10, 1000));
+  TEST_ASSERT_DOUBLE_WITHIN(1e-6, 0.0, opuestos.longitudResultante());
+}
+
+// A 36 km/h en 1 s se recorren 10 m: 500 m es un salto, 15 m no
+void test_descarta_saltos_imposibles() {
+  VentanaGPSFija<8> ventana(CONFIG);
+  const double GRADO = 111194.93;
+  TEST_ASSERT_TRUE(ventana.agregar(muestra(-31.42, -64.18, 0, 36, 0)));
+  TEST_ASSERT_TRUE(ventana.agregar(muestra(-31.42 + 15 / GRADO, -64.18, 0, 36, 1000)));
+  TEST_ASSERT_FALSE(ventana.agregar(muestra(-31.42 + 515 / GRADO, -64.18, 0, 36, 2000)));
+  TEST_ASSERT_EQUAL_UINT32(1, ventana.rechazadas());
+  TEST_ASSERT_EQUAL_UINT16(2, ventana.cantidad());
+}
+
+// Después de maxRechazosSeguidos el equipo realmente se movió
+void test_acepta_tras_rechazos_seguidos() {
+  VentanaGPSFija<8> ventana(CONFIG);
+  const double GRADO = 111194.93;
+  ventana.agregar(muestra(-31.42, -64.18, 0, 10, 0));
+  uint32_t intentos = 0;
+  while (!ventana.agregar(muestra(-31.42 + 2000 / GRADO, -64.18, 0, 10, (intentos + 1) * 1000))) {
+    intentos++;
+    TEST_ASSERT_TRUE(intentos <= CONFIG.maxRechazosSeguidos);
+  }
+  TEST_ASSERT_TRUE(intentos > 0);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_media_igual_al_recalculo);
+  RUN_TEST(test_muestra_cero_es_la_mas_reciente);
+  RUN_TEST(test_rumbo_medio_circular);
+  RUN_TEST(test_descarta_saltos_imposibles);
+  RUN_TEST(test_acepta_tras_rechazos_seguidos);
+  return UNITY_END();
+}
@@ -5,6 +5,7 @@ import os
 from psycopg2.extras import RealDictCursor
 import time
 import sys
+from collections import deque
 
 # Configuración de MQTT desde variables de entorno
 MQTT_SERVER = os.environ.get("MQTT_SERVER", "mosquitto_proyecto")
@@ -29,6 +30,28 @@ TOLERANCIA_METROS = 10.0
 # Un diccionario para mapear el ID del dispositivo con el ID de la calle que está mapeando
 vehiculo_a_calle = {}
 
+# Secuencias recientes por dispositivo. El firmware reenvía desde su cola en
+# flash lo que no pudo publicar y, tras un reinicio, puede repetir algunos
+# mensajes ya entregados; el campo "seq" no se repite nunca en un equipo.
+VENTANA_SECUENCIAS = 4096
+secuencias_vistas = {}
+
+def es_reenvio(payload):
+    """True si el mensaje ya se procesó (mismo dispositivo y misma secuencia)."""
+    seq = payload.get("seq")
+    dispositivo = payload.get("device_id") or payload.get("vehiculo_id")
+    if seq is None or dispositivo is None:
+        return False
+    vistas = secuencias_vistas.setdefault(dispositivo, (set(), deque()))
+    conjunto, orden = vistas
+    if seq in conjunto:
+        return True
+    conjunto.add(seq)
+    orden.append(seq)
+    if len(orden) > VENTANA_SECUENCIAS:
+        conjunto.discard(orden.popleft())
+    return False
+
 def conectar_db():
     """Establece una conexión con la base de datos PostGIS."""
     try:
@@ -58,6 +81,10 @@ def on_message(client, userdata, msg):
         payload = json.loads(msg.payload.decode("utf-8"))
         print(f"Mensaje en {msg.topic}: {payload}")
 
+        if es_reenvio(payload):
+            print(f"Mensaje repetido (seq={payload.get('seq')}), descartando.")
+            return
+
         if msg.topic == MQTT_TOPIC_MAPEO:
             procesar_mapeo(payload)
         elif msg.topic == MQTT_TOPIC_VEHICULOS:
@@ -67,15 +94,51 @@ def on_message(client, userdata, msg):
     except Exception as e:
         print(f"Error procesando el mensaje: {e}", file=sys.stderr)
 
+def decodificar_polyline(texto, precision=1e5):
+    """Decodifica una 'encoded polyline' de Google en una lista de (lat, lon)."""
+    valores = []
+    actual = desplazamiento = 0
+    for caracter in texto:
+        b = ord(caracter) - 63
+        actual |= (b & 0x1F) << desplazamiento
+        desplazamiento += 5
+        if b < 0x20:
+            valores.append(~(actual >> 1) if actual & 1 else actual >> 1)
+            actual = desplazamiento = 0
+    puntos = []
+    lat = lon = 0
+    for i in range(0, len(valores) - 1, 2):
+        lat += valores[i]
+        lon += valores[i + 1]
+        puntos.append((lat / precision, lon / precision))
+    return puntos
+
+def procesar_lote(payload):
+    """Expande un lote de puntos (firmware con LOGIOT_LOTES) en mensajes 'punto'."""
+    for lat, lon in decodificar_polyline(payload.get("polyline", "")):
+        punto = dict(payload, tipo="punto", lat=lat, lon=lon)
+        punto.setdefault("vehiculo_id", payload.get("device_id"))
+        procesar_mapeo(punto)
+
 def procesar_mapeo(payload):
     """Maneja la lógica de unificación y refinamiento de calles."""
     tipo = payload.get("tipo")
-    id_dispositivo = payload.get("vehiculo_id")
+    if tipo == "lote":
+        procesar_lote(payload)
+        return
+    if tipo == "viaje":
+        # Resumen calculado en el equipo (firmware con LOGIOT_RESUMEN_VIAJE)
+        print(f"Resumen de viaje de {payload.get('device_id')}: {payload.get('resumen')}")
+        return
+    id_dispositivo = payload.get("vehiculo_id") or payload.get("device_id")
     id_calle_dispositivo = payload.get("id")
     lat = payload.get("lat")
     lon = payload.get("lon")
     
-    if not all([tipo, id_dispositivo, id_calle_dispositivo, lat, lon]):
+    if not all([tipo, id_dispositivo, id_calle_dispositivo]):
+        print("Datos de mapeo incompletos, descartando.")
+        return
+    if tipo in ("inicio", "punto") and None in (lat, lon):
         print("Datos de mapeo incompletos, descartando.")
         return
 
@@ -125,9 +188,27 @@ def procesar_mapeo(payload):
                     print(f"Advertencia: No se encontró la calle {id_calle_final} para actualizar.")
 
             elif tipo == "fin":
+                # Geometría simplificada en el equipo: reemplaza a la armada punto a punto,
+                # pero solo si la calle es la del equipo. Si el inicio se unificó con una
+                # calle existente, la polyline cubre solo este tramo y pisaría la geometría
+                # entera; ahí se conservan los puntos ya agregados con ST_AddPoint.
+                puntos = decodificar_polyline(payload.get("polyline", ""))
+                id_calle_final = vehiculo_a_calle.get(id_dispositivo)
+                if id_calle_final and id_calle_final != id_calle_dispositivo:
+                    print(f"Calle {id_calle_final} unificada: se conservan sus puntos, sin reemplazar la geometría")
+                elif id_calle_final and len(puntos) >= 2:
+                    linea = ", ".join(f"{lon_v} {lat_v}" for lat_v, lon_v in puntos)
+                    cursor.execute("""
+                        UPDATE calles
+                        SET geom = ST_SetSRID(ST_GeomFromText(%s), 4326)
+                        WHERE id = %s;
+                    """, (f"LINESTRING({linea})", id_calle_final))
+                    print(f"Geometría de {id_calle_final} reemplazada ({len(puntos)} vértices)")
                 if id_dispositivo in vehiculo_a_calle:
                     del vehiculo_a_calle[id_dispositivo]
                 print(f"Mapeo de calle {id_calle_dispositivo} finalizado.")
+                if "resumen" in payload:
+                    print(f"Resumen de {id_calle_dispositivo}: {payload['resumen']}")
 
             conn.commit()
         except Exception as e: